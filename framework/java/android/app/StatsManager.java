@@ -54,6 +54,7 @@ import java.io.IOException;
 import java.nio.BufferOverflowException;
 import java.nio.ByteBuffer;
 import java.util.ArrayList;
+import java.util.Collections;
 import java.util.List;
 import java.util.concurrent.Executor;
 
@@ -858,6 +859,10 @@ public final class StatsManager {
     private static class StatsQueryCallbackInternal extends IStatsQueryCallback.Stub {
         OutcomeReceiver<StatsCursor, StatsQueryException> queryCallback;
         Executor mExecutor;
+        // Accumulates chunks of a streamed query result until the last chunk arrives. Oneway
+        // calls on the same binder object are serialized, so no synchronization is needed.
+        private final ArrayList<String> mChunkedQueryData = new ArrayList<>();
+        private int mChunkedRowCount = 0;
 
         StatsQueryCallbackInternal(OutcomeReceiver<StatsCursor, StatsQueryException> queryCallback,
                 @NonNull @CallbackExecutor Executor executor) {
@@ -884,12 +889,42 @@ public final class StatsManager {
             }
         }
 
+        @Override
+        public void sendResultChunk(String[] queryData, String[] columnNames, int[] columnTypes,
+                int rowCount, boolean isLastChunk) {
+            if (!SdkLevel.isAtLeastU()) {
+                throw new IllegalStateException(
+                        "StatsManager#query is not available before Android U");
+            }
+            Collections.addAll(mChunkedQueryData, queryData);
+            mChunkedRowCount += rowCount;
+            if (!isLastChunk) {
+                return;
+            }
+            final String[] allQueryData = mChunkedQueryData.toArray(new String[0]);
+            final int totalRowCount = mChunkedRowCount;
+            mChunkedQueryData.clear();
+            mChunkedRowCount = 0;
+            final long token = Binder.clearCallingIdentity();
+            try {
+                mExecutor.execute(() -> {
+                    StatsCursor cursor = new StatsCursor(allQueryData, columnNames, columnTypes,
+                            totalRowCount);
+                    queryCallback.onResult(cursor);
+                });
+            } finally {
+                Binder.restoreCallingIdentity(token);
+            }
+        }
+
         @Override
         public void sendFailure(String error) {
             if (!SdkLevel.isAtLeastU()) {
                 throw new IllegalStateException(
                         "StatsManager#query is not available before Android U");
             }
+            mChunkedQueryData.clear();
+            mChunkedRowCount = 0;
             final long token = Binder.clearCallingIdentity();
             try {
                 mExecutor.execute(() -> {
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2021 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "kll.h"
+
+namespace dist_proc {
+namespace aggregation {
+
+namespace {
+
+std::vector<int64_t> MakeValues(int64_t num_values) {
+    std::vector<int64_t> values;
+    values.reserve(num_values);
+    for (int64_t i = 0; i < num_values; i++) {
+        values.push_back((i * 2654435761) % 1000000);
+    }
+    return values;
+}
+
+static void BM_KllAddOneByOne(benchmark::State& state) {
+    const std::vector<int64_t> values = MakeValues(state.range(0));
+    for (auto _ : state) {
+        std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+        for (int64_t value : values) {
+            aggregator->Add(value);
+        }
+        benchmark::DoNotOptimize(aggregator);
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_KllAddOneByOne)->Arg(100)->Arg(1000)->Arg(10000);
+
+static void BM_KllAddBatch(benchmark::State& state) {
+    const std::vector<int64_t> values = MakeValues(state.range(0));
+    for (auto _ : state) {
+        std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+        aggregator->AddBatch(values.data(), values.size());
+        benchmark::DoNotOptimize(aggregator);
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_KllAddBatch)->Arg(100)->Arg(1000)->Arg(10000);
+
+}  // namespace
+
+}  // namespace aggregation
+}  // namespace dist_proc
+
+BENCHMARK_MAIN();
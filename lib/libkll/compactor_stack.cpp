@@ -66,6 +66,22 @@ void CompactorStack::Add(const int64_t value) {
     }
 }
 
+void CompactorStack::AddBatch(const int64_t* values, size_t num_values) {
+    if (num_values == 0) {
+        return;
+    }
+    if (sampler_ == nullptr) {
+        compactors_[0].insert(compactors_[0].end(), values, values + num_values);
+        num_items_in_compactors_ += static_cast<int>(num_values);
+        CompactStack();
+    } else {
+        // The sampler subsamples items one at a time; there is nothing to amortize.
+        for (size_t i = 0; i < num_values; i++) {
+            sampler_->Add(values[i]);
+        }
+    }
+}
+
 // Adds an item to the compactor stack with weight >= 1.
 // Does nothing if weight <= 0.
 void CompactorStack::AddWithWeight(int64_t value, int weight) {
@@ -92,6 +108,28 @@ void CompactorStack::AddWithWeight(int64_t value, int weight) {
     }
 }
 
+void CompactorStack::MergeFrom(const CompactorStack& other) {
+    while (compactors_.size() < other.compactors_.size()) {
+        AddLevel();
+    }
+    for (size_t level = 0; level < other.compactors_.size(); level++) {
+        const std::vector<int64_t>& src = other.compactors_[level];
+        if (!src.empty()) {
+            compactors_[level].insert(compactors_[level].end(), src.begin(), src.end());
+            num_items_in_compactors_ += static_cast<int>(src.size());
+        }
+    }
+    if (other.sampler_ != nullptr) {
+        const auto item_and_weight = other.sampler_->sampled_item_and_weight();
+        if (item_and_weight.has_value()) {
+            // AddWithWeight compacts the stack itself.
+            AddWithWeight(item_and_weight->first, item_and_weight->second);
+            return;
+        }
+    }
+    CompactStack();
+}
+
 void CompactorStack::SortCompactorContents() {
     for (std::vector<int64_t>& compactor : compactors_) {
         std::sort(compactor.begin(), compactor.end());
@@ -151,7 +189,13 @@ void CompactorStack::CompactLevel(int level) {
         AddLevel();
     }
     Halve(&compactors_[level], &compactors_[level + 1]);
-    std::vector<int64_t>().swap(compactors_[level]);
+    // Keep the emptied level's buffer for reuse by future additions, so that
+    // repeated compactions of the same level do not reallocate. Buffers that
+    // have grown far past the level's target capacity are released instead.
+    const int target_capacity = TargetCapacityAtLevel(level);
+    if (static_cast<int>(compactors_[level].capacity()) > 2 * target_capacity) {
+        std::vector<int64_t>().swap(compactors_[level]);
+    }
 }
 
 // To compact the items in a compactor to roughly half the size,
@@ -161,6 +205,7 @@ void CompactorStack::Halve(std::vector<int64_t>* down_compactor,
                            std::vector<int64_t>* up_compactor) {
     std::sort(down_compactor->begin(), down_compactor->end());
     double half_of_items = down_compactor->size() / static_cast<double>(2);
+    up_compactor->reserve(up_compactor->size() + (down_compactor->size() + 1) / 2);
     bool keep_even_items = (random_->UnbiasedUniform(2) == 0);
     num_items_in_compactors_ -= static_cast<int>(keep_even_items ? std::floor(half_of_items)
                                                                  : std::ceil(half_of_items));
@@ -222,6 +267,18 @@ int CompactorStack::lowest_active_level() const {
     return sampler_ ? sampler_->num_replaced_levels() : 0;
 }
 
+int64_t CompactorStack::MemoryFootprint() const {
+    int64_t footprint = sizeof(CompactorStack);
+    footprint += compactors_.capacity() * sizeof(std::vector<int64_t>);
+    for (const std::vector<int64_t>& compactor : compactors_) {
+        footprint += compactor.capacity() * sizeof(int64_t);
+    }
+    if (sampler_ != nullptr) {
+        footprint += sizeof(KllSampler);
+    }
+    return footprint;
+}
+
 }  // namespace internal
 }  // namespace aggregation
 }  // namespace dist_proc
@@ -46,10 +46,19 @@ public:
 
     void Add(const int64_t value);
 
+    // Adds a batch of items to the compactor stack in one pass, deferring
+    // compaction until the whole batch has been appended.
+    void AddBatch(const int64_t* values, size_t num_values);
+
     // Adds an item to the compactor stack with weight >= 1.
     // Does nothing if weight <= 0.
     void AddWithWeight(int64_t value, int weight);
 
+    // Merges the contents of another compactor stack into this one. Items are
+    // copied level by level so they keep their weight, and a single compaction
+    // pass runs once everything has been appended.
+    void MergeFrom(const CompactorStack& other);
+
     // Ensures that the contents of each compactor are sorted.
     void SortCompactorContents();
 
@@ -62,6 +71,10 @@ public:
 
     int num_stored_items() const;
 
+    // Approximate number of bytes of memory held by the compactor stack,
+    // including buffer capacity retained for reuse between compactions.
+    int64_t MemoryFootprint() const;
+
     std::optional<std::pair<const int64_t, int64_t>> sampled_item_and_weight() const;
 
     // Returns the lowest active level in the compactor stack, which is identical
@@ -48,10 +48,28 @@ public:
     int64_t num_stored_values() const {
         return compactor_stack_.num_stored_items();
     }
+    // Approximate number of bytes of memory held by the aggregator.
+    int64_t MemoryFootprint() const {
+        return sizeof(KllQuantile) + compactor_stack_.MemoryFootprint() +
+               (owned_random_ != nullptr ? sizeof(MTRandomGenerator) : 0);
+    }
     // Reset the aggregator to its state just after construction.
     void Reset();
     void Add(int64_t value);
 
+    // Adds all values in [values, values + num_values) to the aggregator.
+    // Equivalent to calling Add() on each value in turn, but compaction of the
+    // underlying sketch is amortized over the whole batch, which is
+    // substantially cheaper when values arrive in bursts.
+    void AddBatch(const int64_t* values, size_t num_values);
+
+    // Merges the contents of another aggregator into this one, as if all items
+    // added to 'other' had been added here, without re-ingesting raw values.
+    // Stored items keep their level in the compactor stack and thus their
+    // weight, so approximation guarantees carry over to the merged sketch.
+    // 'other' is left unchanged and must not be this aggregator.
+    void Merge(const KllQuantile& other);
+
     // Adds a value to the aggregator with multiplicity 'weight' (same as adding
     // the value with Add(value) 'weight' times). Does nothing if weight <= 0.
     //
@@ -68,6 +86,14 @@ public:
     // Not safe to be called concurrently.
     zetasketch::android::AggregatorStateProto SerializeToProto();
 
+    // Serializes the aggregator state into 'output', reusing whatever capacity
+    // the string already holds. Returns the number of bytes written. Produces
+    // the same bytes as serializing the proto returned by SerializeToProto(),
+    // but callers streaming many sketches into a report can reuse one scratch
+    // buffer instead of allocating a fresh one per sketch.
+    // Not safe to be called concurrently.
+    size_t SerializeToString(std::string* output);
+
     bool IsSamplerOn() const {
         return compactor_stack_.IsSamplerOn();
     }
@@ -16,6 +16,7 @@
 
 #include "kll.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 
@@ -52,6 +53,27 @@ void KllQuantile::Add(const int64_t value) {
     num_values_++;
 }
 
+void KllQuantile::AddBatch(const int64_t* values, size_t num_values) {
+    if (num_values == 0) {
+        return;
+    }
+    compactor_stack_.AddBatch(values, num_values);
+    const auto [min_it, max_it] = std::minmax_element(values, values + num_values);
+    UpdateMin(*min_it);
+    UpdateMax(*max_it);
+    num_values_ += num_values;
+}
+
+void KllQuantile::Merge(const KllQuantile& other) {
+    if (other.num_values_ == 0) {
+        return;
+    }
+    compactor_stack_.MergeFrom(other.compactor_stack_);
+    UpdateMin(other.min_);
+    UpdateMax(other.max_);
+    num_values_ += other.num_values_;
+}
+
 void KllQuantile::AddWeighted(int64_t value, int weight) {
     if (weight > 0) {
         compactor_stack_.AddWithWeight(value, weight);
@@ -114,6 +136,12 @@ AggregatorStateProto KllQuantile::SerializeToProto() {
     return aggregator_state;
 }
 
+size_t KllQuantile::SerializeToString(std::string* output) {
+    const AggregatorStateProto aggregator_state = SerializeToProto();
+    aggregator_state.SerializeToString(output);
+    return output->size();
+}
+
 void KllQuantile::UpdateMin(int64_t value) {
     if (num_values_ == 0 || min_ > value) {
         min_ = value;
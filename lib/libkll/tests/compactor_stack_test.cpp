@@ -129,6 +129,24 @@ TEST_F(KllQuantileUseSamplerTest, ZeroCapacityAfterReplacedWithSampler) {
     }
 }
 
+TEST(CompactorStackMemoryFootprintTest, CoversStoredItemsAndShrinksOnReset) {
+    MTRandomGenerator random;
+    CompactorStack compactor_stack(100, 100, &random);
+    const int64_t empty_footprint = compactor_stack.MemoryFootprint();
+    EXPECT_GE(empty_footprint, static_cast<int64_t>(sizeof(CompactorStack)));
+
+    for (int i = 0; i < 10000; i++) {
+        compactor_stack.Add(i);
+    }
+    const int64_t grown_footprint = compactor_stack.MemoryFootprint();
+    EXPECT_GE(grown_footprint,
+              static_cast<int64_t>(sizeof(CompactorStack)) +
+                      compactor_stack.num_stored_items() * static_cast<int64_t>(sizeof(int64_t)));
+
+    compactor_stack.Reset();
+    EXPECT_LT(compactor_stack.MemoryFootprint(), grown_footprint);
+}
+
 TEST_F(KllQuantileUseSamplerTest, NumStoredItemsWithSampledItem) {
     CompactorStack compactor_stack(10, 10, &random_);
     for (int i = 0; i < 2000; i++) {
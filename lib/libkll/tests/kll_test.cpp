@@ -145,6 +145,86 @@ TEST(KllQuantileSerializationTest, QuantilesProtoFieldsAreCorrectlyPopulatedNonD
     EXPECT_EQ(quantiles_state.compactors_size(), 1);
 }
 
+TEST(KllQuantileTest, AddBatchMatchesRepeatedAdd) {
+    std::unique_ptr<KllQuantile> batched = KllQuantile::Create();
+    std::unique_ptr<KllQuantile> unbatched = KllQuantile::Create();
+
+    std::vector<int64_t> values;
+    for (int i = 0; i < 5000; i++) {
+        values.push_back((i * 37) % 251);
+    }
+    batched->AddBatch(values.data(), values.size());
+    for (int64_t value : values) {
+        unbatched->Add(value);
+    }
+
+    EXPECT_EQ(batched->num_values(), unbatched->num_values());
+    EXPECT_EQ(batched->num_values(), 5000);
+
+    // The sketches themselves differ by the random halving choices, but the
+    // exact summaries must agree.
+    AggregatorStateProto batched_state = batched->SerializeToProto();
+    AggregatorStateProto unbatched_state = unbatched->SerializeToProto();
+    const KllQuantilesStateProto& batched_quantiles =
+            batched_state.GetExtension(kll_quantiles_state);
+    const KllQuantilesStateProto& unbatched_quantiles =
+            unbatched_state.GetExtension(kll_quantiles_state);
+    EXPECT_EQ(batched_state.num_values(), unbatched_state.num_values());
+    EXPECT_EQ(batched_quantiles.min(), unbatched_quantiles.min());
+    EXPECT_EQ(batched_quantiles.max(), unbatched_quantiles.max());
+}
+
+TEST(KllQuantileTest, MergeCombinesAggregators) {
+    std::unique_ptr<KllQuantile> first = KllQuantile::Create();
+    std::unique_ptr<KllQuantile> second = KllQuantile::Create();
+    std::unique_ptr<KllQuantile> combined = KllQuantile::Create();
+    for (int i = 1; i <= 1000; i++) {
+        first->Add(i);
+        combined->Add(i);
+    }
+    for (int i = 1001; i <= 2000; i++) {
+        second->Add(i);
+        combined->Add(i);
+    }
+
+    first->Merge(*second);
+
+    EXPECT_EQ(first->num_values(), 2000);
+    AggregatorStateProto merged_state = first->SerializeToProto();
+    AggregatorStateProto combined_state = combined->SerializeToProto();
+    const KllQuantilesStateProto& merged_quantiles =
+            merged_state.GetExtension(kll_quantiles_state);
+    const KllQuantilesStateProto& combined_quantiles =
+            combined_state.GetExtension(kll_quantiles_state);
+    EXPECT_EQ(merged_state.num_values(), combined_state.num_values());
+    EXPECT_EQ(merged_quantiles.min(), combined_quantiles.min());
+    EXPECT_EQ(merged_quantiles.max(), combined_quantiles.max());
+}
+
+TEST(KllQuantileTest, MergeWithEmptyAggregatorIsANoOp) {
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    std::unique_ptr<KllQuantile> empty = KllQuantile::Create();
+    for (int i = 1; i <= 10; i++) {
+        aggregator->Add(i);
+    }
+
+    aggregator->Merge(*empty);
+    EXPECT_EQ(aggregator->num_values(), 10);
+
+    empty->Merge(*aggregator);
+    EXPECT_EQ(empty->num_values(), 10);
+    AggregatorStateProto state = empty->SerializeToProto();
+    const KllQuantilesStateProto& quantiles_state = state.GetExtension(kll_quantiles_state);
+    EXPECT_EQ(quantiles_state.min(), "\x1");
+    EXPECT_EQ(quantiles_state.max(), "\xA");
+}
+
+TEST(KllQuantileTest, AddBatchWithNoValuesIsANoOp) {
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    aggregator->AddBatch(nullptr, 0);
+    EXPECT_EQ(aggregator->num_values(), 0);
+}
+
 TEST(KllQuantileSerializationTest, EmptyQuantilesProto) {
     std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
 
@@ -171,6 +251,43 @@ TEST(KllQuantileSerializationTest, EmptyQuantilesProto) {
     EXPECT_EQ(quantiles_state.compactors_size(), 0);
     ASSERT_FALSE(quantiles_state.has_sampler());
 }
+
+TEST(KllQuantileSerializationTest, SerializeToStringMatchesSerializeToProto) {
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    for (int i = 0; i < 500; i++) {
+        aggregator->Add(i);
+    }
+
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    std::string expected;
+    aggregator_state.SerializeToString(&expected);
+
+    std::string serialized;
+    EXPECT_EQ(aggregator->SerializeToString(&serialized), expected.size());
+    EXPECT_EQ(serialized, expected);
+}
+
+TEST(KllQuantileSerializationTest, SerializeToStringReusesScratchBuffer) {
+    std::unique_ptr<KllQuantile> big = KllQuantile::Create();
+    for (int i = 0; i < 5000; i++) {
+        big->Add(i);
+    }
+    std::unique_ptr<KllQuantile> small = KllQuantile::Create();
+    small->Add(42);
+
+    std::string scratch;
+    big->SerializeToString(&scratch);
+    const size_t capacity_after_big = scratch.capacity();
+
+    // Serializing a smaller sketch into the same buffer keeps its capacity.
+    const size_t small_size = small->SerializeToString(&scratch);
+    EXPECT_EQ(scratch.size(), small_size);
+    EXPECT_GE(scratch.capacity(), capacity_after_big);
+
+    std::string expected;
+    small->SerializeToProto().SerializeToString(&expected);
+    EXPECT_EQ(scratch, expected);
+}
 }  // namespace
 
 }  // namespace aggregation
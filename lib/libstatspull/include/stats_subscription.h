@@ -95,6 +95,25 @@ int32_t AStatsManager_addSubscription(const uint8_t* _Nonnull subscription_confi
                                       void* _Nullable cookie)
         __INTRODUCED_IN(__STATSD_SUBS_MIN_API__);
 
+/**
+ * Configures batched data delivery for an existing subscription.
+ *
+ * While batching is enabled, payloads delivered with reason
+ * ASTATSMANAGER_SUBSCRIPTION_CALLBACK_REASON_STATSD_INITIATED are accumulated and handed to the
+ * callback as one larger payload once max_batch_bytes have been buffered or max_delay_millis have
+ * passed since the first buffered payload, whichever comes first. Flush and subscription-end
+ * callbacks always deliver pending batched data first. High-rate subscriptions wake the subscriber
+ * process correspondingly less often.
+ *
+ * \param subscription_id ID of the subscription to configure.
+ * \param max_batch_bytes batch size threshold in bytes triggering delivery. Pass 0 to disable
+ *        batching (the default): every payload is delivered as it arrives.
+ * \param max_delay_millis longest time a buffered payload may wait before delivery.
+ */
+void AStatsManager_configureSubscriptionBatching(int32_t subscription_id, size_t max_batch_bytes,
+                                                 int64_t max_delay_millis)
+        __INTRODUCED_IN(__STATSD_SUBS_MIN_API__);
+
 /**
  * Removes an existing subscription.
  * This will trigger a flush of the remaining subscription data through
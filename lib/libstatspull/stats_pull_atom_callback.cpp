@@ -24,6 +24,8 @@
 #include <stats_event.h>
 #include <stats_pull_atom_callback.h>
 
+#include <chrono>
+#include <functional>
 #include <map>
 #include <queue>
 #include <thread>
@@ -101,6 +103,84 @@ void AStatsManager_PullAtomMetadata_getAdditiveFields(AStatsManager_PullAtomMeta
     std::copy(metadata->additive_fields.begin(), metadata->additive_fields.end(), fields);
 }
 
+/**
+ * @brief Runs pull callbacks on per-atom worker threads instead of the binder
+ * threads servicing onPullAtom, so one slow pull does not stall pulls of other
+ * atoms registered by the same process and statsd gets parallel completions
+ * from multi-atom providers.
+ *
+ * Mirrors the CallbackOperationsHandler threading approach: each atom's worker
+ * is started lazily and exits once its queue drains.
+ */
+class PullTaskDispatcher {
+    struct AtomTaskQueue {
+        std::queue<std::function<void()>> tasks;
+        bool threadAlive = false;
+        std::thread workThread;
+    };
+
+public:
+    ~PullTaskDispatcher() {
+        // collect the worker handles under the lock, join without it so
+        // finishing workers can re-acquire it to mark themselves done
+        std::vector<std::thread> threads;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            for (auto& [atomTag, atomQueue] : mAtomQueues) {
+                if (atomQueue.workThread.joinable()) {
+                    threads.push_back(std::move(atomQueue.workThread));
+                }
+            }
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    static PullTaskDispatcher& getInstance() {
+        static PullTaskDispatcher dispatcher;
+        return dispatcher;
+    }
+
+    void enqueue(int32_t atomTag, std::function<void()> task) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        // std::map node stability keeps the queue pointer valid for the worker
+        AtomTaskQueue& atomQueue = mAtomQueues[atomTag];
+        atomQueue.tasks.push(std::move(task));
+        if (!atomQueue.threadAlive) {
+            atomQueue.threadAlive = true;
+            if (atomQueue.workThread.joinable()) {
+                atomQueue.workThread.join();
+            }
+            atomQueue.workThread =
+                    std::thread(&PullTaskDispatcher::processTasks, this, &atomQueue);
+        }
+    }
+
+private:
+    PullTaskDispatcher() {
+    }
+
+    void processTasks(AtomTaskQueue* atomQueue) {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                if (atomQueue->tasks.empty()) {
+                    atomQueue->threadAlive = false;
+                    return;
+                }
+                task = std::move(atomQueue->tasks.front());
+                atomQueue->tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::mutex mMutex;
+    std::map<int32_t, AtomTaskQueue> mAtomQueues;
+};
+
 class StatsPullAtomCallbackInternal : public BnPullAtomCallback {
   public:
     StatsPullAtomCallbackInternal(const AStatsManager_PullAtomCallback callback, void* cookie,
@@ -114,6 +194,35 @@ class StatsPullAtomCallbackInternal : public BnPullAtomCallback {
 
     Status onPullAtom(int32_t atomTag,
                       const std::shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        // Hand the pull off to the atom's worker and release the binder thread
+        // right away. The deadline mirrors the timeout after which statsd stops
+        // waiting for this pull.
+        const auto deadline =
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(mTimeoutMillis);
+        std::shared_ptr<StatsPullAtomCallbackInternal> self = ref<StatsPullAtomCallbackInternal>();
+        PullTaskDispatcher::getInstance().enqueue(
+                atomTag, [self, atomTag, resultReceiver, deadline] {
+                    self->pullAndReport(atomTag, resultReceiver, deadline);
+                });
+        return Status::ok();
+    }
+
+    int64_t getCoolDownMillis() const { return mCoolDownMillis; }
+    int64_t getTimeoutMillis() const { return mTimeoutMillis; }
+    const std::vector<int32_t>& getAdditiveFields() const { return mAdditiveFields; }
+
+  private:
+    void pullAndReport(int32_t atomTag,
+                       const std::shared_ptr<IPullAtomResultReceiver>& resultReceiver,
+                       const std::chrono::steady_clock::time_point deadline) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            // statsd already gave up on this pull while the task sat behind a
+            // slow one - skip the client callback and just fail the receiver
+            std::vector<StatsEventParcel> emptyParcels;
+            resultReceiver->pullFinished(atomTag, /*success=*/false, emptyParcels);
+            return;
+        }
+
         AStatsEventList statsEventList;
         int successInt = mCallback(atomTag, &statsEventList, mCookie);
         bool success = successInt == AStatsManager_PULL_SUCCESS;
@@ -143,14 +252,8 @@ class StatsPullAtomCallbackInternal : public BnPullAtomCallback {
         for (int i = 0; i < statsEventList.data.size(); i++) {
             AStatsEvent_release(statsEventList.data[i]);
         }
-        return Status::ok();
     }
 
-    int64_t getCoolDownMillis() const { return mCoolDownMillis; }
-    int64_t getTimeoutMillis() const { return mTimeoutMillis; }
-    const std::vector<int32_t>& getAdditiveFields() const { return mAdditiveFields; }
-
-  private:
     const AStatsManager_PullAtomCallback mCallback;
     void* mCookie;
     const int64_t mCoolDownMillis;
@@ -22,7 +22,9 @@
 #include <stats_subscription.h>
 
 #include <atomic>
+#include <chrono>
 #include <map>
+#include <thread>
 #include <vector>
 
 using Status = ::ndk::ScopedAStatus;
@@ -52,6 +54,15 @@ public:
 
     Status onSubscriptionData(const StatsSubscriptionCallbackReason reason,
                               const std::vector<uint8_t>& subscriptionPayload) override {
+        if (reason == StatsSubscriptionCallbackReason::STATSD_INITIATED &&
+            bufferPayload(subscriptionPayload)) {
+            // buffered for batched delivery
+            return Status::ok();
+        }
+
+        // flush any batched data first so the client sees payloads in order
+        deliverBatchedPayload();
+
         std::vector<uint8_t> mutablePayload = subscriptionPayload;
         mCallback(mSubscriptionId, static_cast<AStatsManager_SubscriptionCallbackReason>(reason),
                   mutablePayload.data(), mutablePayload.size(), mCookie);
@@ -77,11 +88,81 @@ public:
         return mSubscriptionParamsBytes;
     }
 
+    void configureBatching(const size_t maxBatchBytes, const int64_t maxDelayMs) {
+        std::lock_guard<std::mutex> lock(mBatchMutex);
+        mMaxDelayMs = maxDelayMs;
+        mMaxBatchBytes.store(maxBatchBytes, std::memory_order_relaxed);
+    }
+
 private:
+    /**
+     * @brief Buffers the payload for batched delivery if batching is enabled.
+     *
+     * Serialized SubscriptionResults protos concatenate into one valid proto,
+     * so buffered payloads are appended back to back and handed to the client
+     * as a single callback once mMaxBatchBytes accumulate or mMaxDelayMs pass.
+     *
+     * @return false if batching is disabled and the caller should deliver the
+     *         payload directly
+     */
+    bool bufferPayload(const std::vector<uint8_t>& payload) {
+        // lock-free bail-out keeps the default per-chunk delivery path untouched
+        if (mMaxBatchBytes.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+
+        bool deliverNow = false;
+        bool scheduleFlush = false;
+        int64_t maxDelayMs = 0;
+        {
+            std::lock_guard<std::mutex> lock(mBatchMutex);
+            mBatchedPayload.insert(mBatchedPayload.end(), payload.begin(), payload.end());
+            if (mBatchedPayload.size() >= mMaxBatchBytes.load(std::memory_order_relaxed)) {
+                deliverNow = true;
+            } else if (!mFlushScheduled) {
+                mFlushScheduled = true;
+                scheduleFlush = true;
+                maxDelayMs = mMaxDelayMs;
+            }
+        }
+
+        if (deliverNow) {
+            deliverBatchedPayload();
+        } else if (scheduleFlush) {
+            // the shared_ptr keeps the subscription alive until the delayed flush runs
+            std::shared_ptr<Subscription> self = ref<Subscription>();
+            std::thread([self, maxDelayMs] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(maxDelayMs));
+                self->deliverBatchedPayload();
+            }).detach();
+        }
+        return true;
+    }
+
+    void deliverBatchedPayload() {
+        std::vector<uint8_t> payload;
+        {
+            std::lock_guard<std::mutex> lock(mBatchMutex);
+            payload.swap(mBatchedPayload);
+            mFlushScheduled = false;
+        }
+        if (!payload.empty()) {
+            mCallback(mSubscriptionId, ASTATSMANAGER_SUBSCRIPTION_CALLBACK_REASON_STATSD_INITIATED,
+                      payload.data(), payload.size(), mCookie);
+        }
+    }
+
     const int32_t mSubscriptionId;
     const std::vector<uint8_t> mSubscriptionParamsBytes;
     const AStatsManager_SubscriptionCallback mCallback;
     void* mCookie;
+
+    // Batched delivery state; mMaxBatchBytes == 0 means batching is disabled.
+    std::atomic<size_t> mMaxBatchBytes = 0;
+    std::mutex mBatchMutex;
+    int64_t mMaxDelayMs = 0;
+    std::vector<uint8_t> mBatchedPayload;
+    bool mFlushScheduled = false;
 };
 
 // forward declare so it can be referenced in StatsProvider constructor.
@@ -147,6 +228,16 @@ int32_t AStatsManager_addSubscription(const uint8_t* subscription_config, const
     return subscriptionId;
 }
 
+void AStatsManager_configureSubscriptionBatching(const int32_t subscription_id,
+                                                 const size_t max_batch_bytes,
+                                                 const int64_t max_delay_millis) {
+    std::shared_ptr<Subscription> subscription = getBinderCallbackForSubscription(subscription_id);
+    if (subscription == nullptr) {
+        return;
+    }
+    subscription->configureBatching(max_batch_bytes, max_delay_millis);
+}
+
 void AStatsManager_removeSubscription(const int32_t subscription_id) {
     std::shared_ptr<Subscription> subscription = getBinderCallbackForSubscription(subscription_id);
     if (subscription == nullptr) {
@@ -83,6 +83,27 @@ void AStatsEvent_build(AStatsEvent* event);
  */
 int AStatsEvent_write(AStatsEvent* event);
 
+/**
+ * Writes a group of StatsEvents to the stats log as one transaction.
+ *
+ * The events travel in a single datagram, so statsd receives and enqueues the
+ * whole group together: either every event is accepted or every event is
+ * dropped on queue overflow, and correlated atoms are never split. Intended
+ * for clients that log several atoms per logical state change; it also costs
+ * one socket write instead of one per event.
+ *
+ * The combined group must fit in one push datagram. If it does not (or the
+ * group holds more than 127 events), each event is written individually
+ * instead: no data is lost, but the group atomicity guarantee is.
+ *
+ * Returns the socket write result as AStatsEvent_write does; on the
+ * individual-write fallback, returns the worst (smallest) per-event result.
+ *
+ * After calling this, AStatsEvent_release must be called on every event, and
+ * is the only function that can be safely called on them.
+ */
+int AStatsEvent_writeGroup(AStatsEvent** events, size_t numEvents);
+
 /**
  * Frees the memory held by this StatsEvent.
  *
@@ -98,6 +119,15 @@ void AStatsEvent_release(AStatsEvent* event);
  **/
 void AStatsEvent_setAtomId(AStatsEvent* event, uint32_t atomId);
 
+/**
+ * Reserves capacity for at least numBytes of additional field data.
+ *
+ * Optional hint for pullers building large events (e.g. big byte arrays): the
+ * buffer grows once up front instead of repeatedly while fields are appended.
+ * Capacity is capped at the maximum pulled event payload size.
+ **/
+void AStatsEvent_reserve(AStatsEvent* event, size_t numBytes);
+
 /**
  * Writes an int32_t field to this StatsEvent.
  **/
@@ -64,7 +64,28 @@ int write_buffer_to_statsd(void* buffer, size_t size, uint32_t atomId) {
         }
         return ret;
     }
-    return write_buffer_to_statsd_impl(buffer, size, atomId, true);
+    int ret = write_buffer_to_statsd_impl(buffer, size, atomId, false);
+    if (ret == -EAGAIN) {
+        // statsd is not keeping up with the socket. Hand the event to the worker
+        // queue, which retries with backoff off the caller's thread, instead of
+        // dropping it here.
+        if (write_buffer_to_statsd_queue(buffer, size, atomId)) {
+            return 1;
+        }
+        note_log_drop(kQueueOverflowErrorCode, atomId);
+        return ret;
+    }
+    if (ret < 0) {
+        note_log_drop(ret, atomId);
+    }
+    return ret;
+}
+
+int get_statsd_writer_outq_bytes() {
+    if (statsdLoggerWrite.getOutqBytes == NULL) {
+        return -ENOTSUP;
+    }
+    return (*statsdLoggerWrite.getOutqBytes)();
 }
 
 int write_buffer_to_statsd_impl(void* buffer, size_t size, uint32_t atomId, bool doNoteDrop) {
@@ -85,6 +106,49 @@ int write_buffer_to_statsd_impl(void* buffer, size_t size, uint32_t atomId, bool
     return ret;
 }
 
+int write_buffer_batch_to_statsd_impl(const struct stats_payload* payloads, size_t count,
+                                      bool doNoteDrop) {
+    if (count == 0) {
+        return 0;
+    }
+    // The single-event path owns the lazy writer initialization; route batches
+    // through it one event at a time until the transport is up.
+    if (__write_to_statsd == __write_to_statsd_init) {
+        int ret = write_buffer_to_statsd_impl(payloads[0].buffer, payloads[0].size,
+                                              payloads[0].atomId, doNoteDrop);
+        return ret > 0 ? 1 : ret;
+    }
+
+    // count is capped by the caller's batch size, so the VLA stays small.
+    struct iovec vecs[2 * count];
+    for (size_t i = 0; i < count; i++) {
+        vecs[2 * i].iov_base = (void*)&kStatsEventTag;
+        vecs[2 * i].iov_len = sizeof(kStatsEventTag);
+        vecs[2 * i + 1].iov_base = payloads[i].buffer;
+        vecs[2 * i + 1].iov_len = payloads[i].size;
+    }
+
+    int save_errno = errno;
+    struct timespec ts;
+#if defined(__ANDROID__)
+    clock_gettime(CLOCK_REALTIME, &ts);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    ts.tv_sec = tv.tv_sec;
+    ts.tv_nsec = tv.tv_usec * 1000;
+#endif
+
+    int ret = (*statsdLoggerWrite.writeBatch)(&ts, vecs, 2, count);
+    errno = save_errno;
+
+    if (ret < 0 && doNoteDrop) {
+        note_log_drop(ret, payloads[0].atomId);
+    }
+
+    return ret;
+}
+
 static int __write_to_stats_daemon(struct iovec* vec, size_t nr) {
     int save_errno;
     struct timespec ts;
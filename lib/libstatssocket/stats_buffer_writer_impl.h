@@ -25,4 +25,24 @@ __BEGIN_DECLS
 
 int write_buffer_to_statsd_impl(void* buffer, size_t size, uint32_t atomId, bool doNoteDrop);
 
+struct stats_payload {
+    void* buffer;
+    size_t size;
+    uint32_t atomId;
+};
+
+/**
+ * Writes up to count serialized events as one socket batch. Returns the number of
+ * events fully handed to the socket (which may be fewer than count on partial
+ * failure), or a negative errno when none were written.
+ */
+int write_buffer_batch_to_statsd_impl(const struct stats_payload* payloads, size_t count,
+                                      bool doNoteDrop);
+
+/**
+ * Bytes written to the statsd socket but not yet read by the daemon, or a
+ * negative errno when the socket is down or the kernel cannot report it.
+ */
+int get_statsd_writer_outq_bytes();
+
 __END_DECLS
@@ -19,8 +19,8 @@
 #include <private/android_filesystem_config.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
-#include <queue>
 #include <thread>
 
 #include "stats_buffer_writer_impl.h"
@@ -58,7 +58,7 @@ bool BufferWriterQueue::pushToQueue(const Cmd& cmd) {
             // error code
             return false;
         }
-        mCmdQueue.push(cmd);
+        mCmdQueue.push_back(cmd);
     }
     mCondition.notify_one();
     return true;
@@ -91,39 +91,58 @@ void BufferWriterQueue::drainQueue() {
     std::unique_lock<std::mutex> lock(mMutex);
     while (!mCmdQueue.empty()) {
         free(mCmdQueue.front().buffer);
-        mCmdQueue.pop();
+        mCmdQueue.pop_front();
     }
 }
 
 void BufferWriterQueue::processCommands() {
     while (true) {
-        // temporary local thread copy
-        Cmd cmd;
+        // temporary local thread copies; commands stay in the queue until written
+        std::vector<Cmd> batch;
         {
             std::unique_lock<std::mutex> lock(mMutex);
             if (mCmdQueue.empty()) {
                 mCondition.wait(lock, [this] { return !this->mCmdQueue.empty(); });
             }
-            cmd = mCmdQueue.front();
+            if (mCmdQueue.size() < kMaxBatchSize && mCmdQueue.front().buffer != NULL) {
+                // Give a burst a moment to accumulate so it goes out as one batch.
+                mCondition.wait_for(lock, std::chrono::milliseconds(kBatchFlushDeadlineMs),
+                                    [this] { return mCmdQueue.size() >= kMaxBatchSize; });
+            }
+            for (const Cmd& cmd : mCmdQueue) {
+                // null buffer ptr used as a marker of the termination request
+                if (cmd.buffer == NULL || batch.size() >= kMaxBatchSize) {
+                    break;
+                }
+                batch.push_back(cmd);
+            }
         }
 
-        if (cmd.buffer == NULL) {
-            // null buffer ptr used as a marker of the termination request
+        if (batch.empty()) {
+            // the front of the queue is the termination marker
             return;
         }
 
-        const bool writeSuccess = handleCommand(cmd);
-        if (writeSuccess) {
-            // no event drop is observed otherwise command remains in the queue
+        if (!mDoTerminate && isSocketBackpressured()) {
+            // The daemon-side queue is near capacity: the write would only bounce
+            // with EAGAIN. Wait for statsd to drain; the commands stay queued.
+            std::this_thread::sleep_for(std::chrono::milliseconds(mRetryDelayMs));
+            mRetryDelayMs = std::min(mRetryDelayMs * 2, kMaxDelayOnFailedWriteMs);
+            continue;
+        }
+
+        const size_t numWritten = handleCommandBatch(batch);
+        if (numWritten > 0) {
+            // no event drop is observed otherwise commands remain in the queue
             // and worker thread will try to log later on
 
             // call free() explicitly here to free memory before the mutex lock
-            free(cmd.buffer);
+            for (size_t i = 0; i < numWritten; i++) {
+                free(batch[i].buffer);
+            }
             {
                 std::unique_lock<std::mutex> lock(mMutex);
-                // this will lead to Cmd destructor call which will be no-op since now the
-                // buffer is NULL
-                mCmdQueue.pop();
+                mCmdQueue.erase(mCmdQueue.begin(), mCmdQueue.begin() + numWritten);
             }
         }
         // TODO (b/258003151): add logging info about retry count
@@ -133,19 +152,45 @@ void BufferWriterQueue::processCommands() {
         }
 
         // attempt to enforce the logging frequency constraints
-        // in case of failed write due to socket overflow the sleep can be longer
-        // to not overload socket continuously
-        if (!writeSuccess) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(kDelayOnFailedWriteMs));
+        // in case of failed write due to socket overflow the delay grows
+        // exponentially to not overload the socket continuously
+        if (numWritten < batch.size()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(mRetryDelayMs));
+            mRetryDelayMs = std::min(mRetryDelayMs * 2, kMaxDelayOnFailedWriteMs);
+        } else {
+            mRetryDelayMs = kDelayOnFailedWriteMs;
         }
     }
 }
 
+bool BufferWriterQueue::isSocketBackpressured() const {
+    // Negative values mean the socket is down or the kernel cannot report the
+    // occupancy; let the write path surface the actual error in that case.
+    return get_statsd_writer_outq_bytes() >= kSocketOutqBackpressureBytes;
+}
+
 bool BufferWriterQueue::handleCommand(const Cmd& cmd) const {
     // skip log drop if occurs, since the atom remains in the queue and write will be retried
     return write_buffer_to_statsd_impl(cmd.buffer, cmd.size, cmd.atomId, /*doNoteDrop*/ false) > 0;
 }
 
+size_t BufferWriterQueue::handleCommandBatch(const std::vector<Cmd>& cmds) const {
+    if (cmds.size() == 1) {
+        return handleCommand(cmds.front()) ? 1 : 0;
+    }
+    // cmds.size() is capped by kMaxBatchSize
+    stats_payload payloads[cmds.size()];
+    for (size_t i = 0; i < cmds.size(); i++) {
+        payloads[i].buffer = cmds[i].buffer;
+        payloads[i].size = cmds[i].size;
+        payloads[i].atomId = cmds[i].atomId;
+    }
+    // skip log drop if occurs, since the atoms remain in the queue and writes will be retried
+    const int ret =
+            write_buffer_batch_to_statsd_impl(payloads, cmds.size(), /*doNoteDrop*/ false);
+    return ret > 0 ? ret : 0;
+}
+
 bool write_buffer_to_statsd_queue(const uint8_t* buffer, size_t size, uint32_t atomId) {
     static BufferWriterQueue queue;
     return queue.write(buffer, size, atomId);
@@ -19,13 +19,23 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#include <queue>
+#include <deque>
 #include <thread>
+#include <vector>
 
 class BufferWriterQueue {
 public:
     constexpr static int kDelayOnFailedWriteMs = 5;
+    // Failed writes double the retry delay up to this cap; a successful write resets it.
+    constexpr static int kMaxDelayOnFailedWriteMs = 80;
     constexpr static int kQueueMaxSizeLimit = 4800;  // 2X max_dgram_qlen
+    // Most events the worker sends per batched syscall.
+    constexpr static size_t kMaxBatchSize = 32;
+    // How long the worker lets a burst accumulate before flushing a partial batch.
+    constexpr static int kBatchFlushDeadlineMs = 1;
+    // Unread socket bytes above which a write is considered doomed to EAGAIN;
+    // 3/4 of the 2MB send buffer the writer requests on the socket.
+    constexpr static int kSocketOutqBackpressureBytes = 3 * (2 * 1024 * 1024) / 4;
 
     BufferWriterQueue();
     virtual ~BufferWriterQueue();
@@ -44,11 +54,22 @@ public:
 
     virtual bool handleCommand(const Cmd& cmd) const;
 
+    // Sends the commands as one socket batch; returns how many of them (counted
+    // from the front) were written. Single commands go through handleCommand.
+    virtual size_t handleCommandBatch(const std::vector<Cmd>& cmds) const;
+
+    // Whether the daemon-side socket queue is so full that a write would only
+    // bounce with EAGAIN. Probed before each batch to back off pre-emptively.
+    virtual bool isSocketBackpressured() const;
+
 private:
     std::condition_variable mCondition;
     mutable std::mutex mMutex;
-    std::queue<Cmd> mCmdQueue;
+    std::deque<Cmd> mCmdQueue;
     std::atomic_bool mDoTerminate = false;
+    // Current retry delay, worker thread only; grows exponentially while writes
+    // keep failing (or the socket stays backpressured) and resets on success.
+    int mRetryDelayMs = kDelayOnFailedWriteMs;
     std::thread mWorkThread;
 
     static Cmd createWriteBufferCmd(const uint8_t* buffer, size_t size, uint32_t atomId);
@@ -16,6 +16,7 @@
 
 #include "include/stats_event.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -37,6 +38,7 @@
 /* LIMITS */
 #define MAX_ANNOTATION_COUNT 15
 #define MAX_BYTE_VALUE 127  // parsing side requires that lengths fit in 7 bits
+#define MAX_GROUP_EVENTS MAX_BYTE_VALUE
 
 /* ERRORS */
 #define ERROR_NO_TIMESTAMP 0x1
@@ -81,18 +83,56 @@ struct AStatsEvent {
     uint32_t errors;
     bool built;
     size_t bufSize;
+    // Links released events in the thread-local pool; unused while an event is
+    // owned by the caller.
+    struct AStatsEvent* pooledNext;
 };
 
+// Cap on released events kept per thread for reuse by AStatsEvent_obtain. Kept
+// small: hot logging threads rarely hold more than a couple of events at once.
+#define MAX_POOLED_EVENTS 4
+
+static __thread AStatsEvent* eventPool = NULL;
+static __thread uint32_t eventPoolSize = 0;
+
+static pthread_key_t eventPoolKey;
+static pthread_once_t eventPoolKeyOnce = PTHREAD_ONCE_INIT;
+
+// Runs at thread exit (the thread-local pool is still accessible then) so pooled
+// events do not outlive their thread.
+static void free_event_pool(void* unused) {
+    (void)unused;
+    while (eventPool != NULL) {
+        AStatsEvent* event = eventPool;
+        eventPool = event->pooledNext;
+        free(event->buf);
+        free(event);
+    }
+    eventPoolSize = 0;
+}
+
+static void create_event_pool_key() {
+    pthread_key_create(&eventPoolKey, free_event_pool);
+}
+
 AStatsEvent* AStatsEvent_obtain() {
-    AStatsEvent* event = malloc(sizeof(AStatsEvent));
+    AStatsEvent* event = eventPool;
+    if (event != NULL) {
+        eventPool = event->pooledNext;
+        eventPoolSize--;
+    } else {
+        event = malloc(sizeof(AStatsEvent));
+        event->bufSize = MAX_PUSH_EVENT_PAYLOAD;
+        // The append functions only ever read bytes they have already written, so
+        // the buffer does not need to be zeroed up front.
+        event->buf = (uint8_t*)malloc(event->bufSize);
+    }
     event->lastFieldPos = 0;
     event->numBytesWritten = 2;  // reserve first 2 bytes for root event type and number of elements
     event->numElements = 0;
     event->atomId = 0;
     event->errors = 0;
     event->built = false;
-    event->bufSize = MAX_PUSH_EVENT_PAYLOAD;
-    event->buf = (uint8_t*)calloc(event->bufSize, 1);
 
     event->buf[0] = OBJECT_TYPE;
     AStatsEvent_writeInt64(event, get_elapsed_realtime_ns());  // write the timestamp
@@ -101,6 +141,19 @@ AStatsEvent* AStatsEvent_obtain() {
 }
 
 void AStatsEvent_release(AStatsEvent* event) {
+    // Only push-sized buffers are pooled, so the pool never hoards the large
+    // buffers grown for pulled events.
+    if (eventPoolSize < MAX_POOLED_EVENTS && event->bufSize == MAX_PUSH_EVENT_PAYLOAD) {
+        if (eventPool == NULL) {
+            // Arm the thread-exit cleanup the first time this thread pools an event.
+            pthread_once(&eventPoolKeyOnce, create_event_pool_key);
+            pthread_setspecific(eventPoolKey, event);
+        }
+        event->pooledNext = eventPool;
+        eventPool = event;
+        eventPoolSize++;
+        return;
+    }
     free(event->buf);
     free(event);
 }
@@ -116,6 +169,28 @@ void AStatsEvent_setAtomId(AStatsEvent* event, uint32_t atomId) {
     AStatsEvent_writeInt32(event, atomId);
 }
 
+void AStatsEvent_reserve(AStatsEvent* event, size_t numBytes) {
+    size_t totalBytesNeeded = event->numBytesWritten + numBytes;
+    if (totalBytesNeeded > MAX_PULL_EVENT_PAYLOAD) {
+        totalBytesNeeded = MAX_PULL_EVENT_PAYLOAD;
+    }
+    if (totalBytesNeeded <= event->bufSize) {
+        return;
+    }
+
+    // grow with the same doubling progression as overflows() so a reserve
+    // followed by incremental appends lands on the same buffer sizes
+    do {
+        event->bufSize *= 2;
+    } while (event->bufSize <= totalBytesNeeded);
+
+    if (event->bufSize > MAX_PULL_EVENT_PAYLOAD) {
+        event->bufSize = MAX_PULL_EVENT_PAYLOAD;
+    }
+
+    event->buf = (uint8_t*)realloc(event->buf, event->bufSize);
+}
+
 // Overwrites the timestamp populated in AStatsEvent_obtain with a custom
 // timestamp. Should only be called from test code.
 void AStatsEvent_overwriteTimestamp(AStatsEvent* event, uint64_t timestampNs) {
@@ -272,14 +347,14 @@ static bool writeArrayMetadata(AStatsEvent* event, size_t numElements, uint8_t e
     return true;
 }
 
+// Fixed-width elements are serialized back to back, so whole arrays go through
+// a single bounds check and one wide copy instead of a per-element append.
 void AStatsEvent_writeInt32Array(AStatsEvent* event, const int32_t* elements, size_t numElements) {
     if (!writeArrayMetadata(event, numElements, INT32_TYPE)) {
         return;
     }
 
-    for (size_t i = 0; i < numElements; i++) {
-        append_int32(event, elements[i]);
-    }
+    append_byte_array(event, (const uint8_t*)elements, numElements * sizeof(int32_t));
 }
 
 void AStatsEvent_writeInt64Array(AStatsEvent* event, const int64_t* elements, size_t numElements) {
@@ -287,9 +362,7 @@ void AStatsEvent_writeInt64Array(AStatsEvent* event, const int64_t* elements, si
         return;
     }
 
-    for (size_t i = 0; i < numElements; i++) {
-        append_int64(event, elements[i]);
-    }
+    append_byte_array(event, (const uint8_t*)elements, numElements * sizeof(int64_t));
 }
 
 void AStatsEvent_writeFloatArray(AStatsEvent* event, const float* elements, size_t numElements) {
@@ -297,9 +370,7 @@ void AStatsEvent_writeFloatArray(AStatsEvent* event, const float* elements, size
         return;
     }
 
-    for (size_t i = 0; i < numElements; i++) {
-        append_float(event, elements[i]);
-    }
+    append_byte_array(event, (const uint8_t*)elements, numElements * sizeof(float));
 }
 
 void AStatsEvent_writeBoolArray(AStatsEvent* event, const bool* elements, size_t numElements) {
@@ -307,9 +378,8 @@ void AStatsEvent_writeBoolArray(AStatsEvent* event, const bool* elements, size_t
         return;
     }
 
-    for (size_t i = 0; i < numElements; i++) {
-        append_bool(event, elements[i]);
-    }
+    // bool elements are serialized as single bytes with the same representation
+    append_byte_array(event, (const uint8_t*)elements, numElements * sizeof(bool));
 }
 
 void AStatsEvent_writeStringArray(AStatsEvent* event, const char* const* elements,
@@ -416,3 +486,45 @@ int AStatsEvent_write(AStatsEvent* event) {
     build_internal(event, true /* push */);
     return write_buffer_to_statsd(event->buf, event->numBytesWritten, event->atomId);
 }
+
+// A group datagram is framed as:
+//   LIST_TYPE | event count | per event: uint32_t payload size + payload
+// The LIST_TYPE root byte distinguishes group frames from single events,
+// whose payload always starts with OBJECT_TYPE. (*FORMAT MUST BE IN SYNC
+// WITH StatsSocketListener::processGroupMessage*)
+int AStatsEvent_writeGroup(AStatsEvent** events, size_t numEvents) {
+    if (numEvents == 0) return 0;
+    if (numEvents == 1) return AStatsEvent_write(events[0]);
+
+    size_t totalSize = 2;  // group root type + event count
+    for (size_t i = 0; i < numEvents; i++) {
+        build_internal(events[i], true /* push */);
+        totalSize += sizeof(uint32_t) + events[i]->numBytesWritten;
+    }
+
+    if (numEvents > MAX_GROUP_EVENTS || totalSize > MAX_PUSH_EVENT_PAYLOAD) {
+        // The group does not fit in one datagram. Write the events
+        // individually so nothing is lost, at the cost of group atomicity.
+        int worst = 0;
+        for (size_t i = 0; i < numEvents; i++) {
+            int result = write_buffer_to_statsd(events[i]->buf, events[i]->numBytesWritten,
+                                                events[i]->atomId);
+            if (i == 0 || result < worst) worst = result;
+        }
+        return worst;
+    }
+
+    uint8_t buf[MAX_PUSH_EVENT_PAYLOAD];
+    buf[0] = LIST_TYPE;
+    buf[1] = (uint8_t)numEvents;
+    size_t pos = 2;
+    for (size_t i = 0; i < numEvents; i++) {
+        const uint32_t eventSize = (uint32_t)events[i]->numBytesWritten;
+        memcpy(&buf[pos], &eventSize, sizeof(eventSize));
+        pos += sizeof(eventSize);
+        memcpy(&buf[pos], events[i]->buf, eventSize);
+        pos += eventSize;
+    }
+    // Socket loss accounting attributes the datagram to the first atom.
+    return write_buffer_to_statsd(buf, pos, events[0]->atomId);
+}
@@ -23,6 +23,30 @@
 #include "stats_statsdsocketlog.h"
 #include "utils.h"
 
+namespace {
+
+// error is never 0 by the note_log_drop() contract (negative errno values or
+// positive internal codes), so a packed key can not collide with the free
+// slot marker 0
+uint64_t makeKey(int32_t error, int32_t atomId) {
+    return ((uint64_t)(uint32_t)error << 32) | (uint32_t)atomId;
+}
+
+// Releases the table back to the registry when the owner thread exits so it
+// can be recycled - not yet drained counts are preserved and picked up by the
+// next dump or the next owner thread
+struct ThreadLossStatsRef {
+    StatsSocketLossReporter::ThreadLossStats* table = nullptr;
+
+    ~ThreadLossStatsRef() {
+        if (table != nullptr) {
+            table->mInUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+}  // namespace
+
 StatsSocketLossReporter::StatsSocketLossReporter() : mUid(getuid()) {
 }
 
@@ -54,24 +78,75 @@ void StatsSocketLossReporter::noteDrop(int32_t error, int32_t atomId) {
 
     if (atomId == STATS_SOCKET_LOSS_REPORTED) {
         // avoid self counting due to write to socket might fail during dumpAtomsLossStats()
-        // also due to mutex is not re-entrant and is already locked by dumpAtomsLossStats() API,
-        // return to avoid deadlock
-        // alternative is to consider std::recursive_mutex
         return;
     }
 
-    std::unique_lock<std::mutex> lock(mMutex);
+    // account the drop in the calling thread's own lock-free table - the shared
+    // mLossInfo map and its mutex are touched only by the dump path
+    getThreadLossStats()->noteDrop(makeKey(error, atomId));
+}
 
-    // using unordered_map is more CPU efficient vs vectors, however will require some
-    // postprocessing before writing into the socket
-    const LossInfoKey key = std::make_pair(error, atomId);
-    auto counterIt = mLossInfo.find(key);
-    if (counterIt != mLossInfo.end()) {
-        ++counterIt->second;
-    } else if (mLossInfo.size() < kMaxAtomTagsCount) {
-        mLossInfo[key] = 1;
-    } else {
-        mOverflowCounter++;
+void StatsSocketLossReporter::ThreadLossStats::noteDrop(uint64_t key) {
+    for (size_t i = 0; i < kSlotsPerThread; i++) {
+        uint64_t slotKey = mKeys[i].load(std::memory_order_acquire);
+        if (slotKey == 0) {
+            // this thread is the only keys writer - claim the free slot
+            mKeys[i].store(key, std::memory_order_release);
+            slotKey = key;
+        }
+        if (slotKey == key) {
+            mCounts[i].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    mOverflowCounter.fetch_add(1, std::memory_order_relaxed);
+}
+
+StatsSocketLossReporter::ThreadLossStats* StatsSocketLossReporter::getThreadLossStats() {
+    thread_local ThreadLossStatsRef ref;
+    if (ref.table == nullptr) {
+        // single registry lookup per thread lifetime, all subsequent drops are lock-free
+        std::unique_lock<std::mutex> lock(mTablesMutex);
+        for (auto& table : mTables) {
+            bool expected = false;
+            if (table->mInUse.compare_exchange_strong(expected, true)) {
+                ref.table = table.get();
+                break;
+            }
+        }
+        if (ref.table == nullptr) {
+            mTables.push_back(std::make_unique<ThreadLossStats>());
+            mTables.back()->mInUse = true;
+            ref.table = mTables.back().get();
+        }
+    }
+    return ref.table;
+}
+
+void StatsSocketLossReporter::drainThreadLossStatsLocked() {
+    std::unique_lock<std::mutex> lock(mTablesMutex);
+    for (auto& table : mTables) {
+        for (size_t i = 0; i < ThreadLossStats::kSlotsPerThread; i++) {
+            const uint64_t key = table->mKeys[i].load(std::memory_order_acquire);
+            if (key == 0) {
+                // slots are claimed front to back and keys are never erased
+                break;
+            }
+            const int32_t count = table->mCounts[i].exchange(0, std::memory_order_relaxed);
+            if (count == 0) {
+                continue;
+            }
+            const LossInfoKey lossKey = std::make_pair((int32_t)(key >> 32), (int32_t)key);
+            auto counterIt = mLossInfo.find(lossKey);
+            if (counterIt != mLossInfo.end()) {
+                counterIt->second += count;
+            } else if (mLossInfo.size() < kMaxAtomTagsCount) {
+                mLossInfo[lossKey] = count;
+            } else {
+                mOverflowCounter += count;
+            }
+        }
+        mOverflowCounter += table->mOverflowCounter.exchange(0, std::memory_order_relaxed);
     }
 }
 
@@ -90,6 +165,10 @@ void StatsSocketLossReporter::dumpAtomsLossStats(bool forceDump) {
 
     // intention to hold mutex here during the stats_write() to avoid data copy overhead
     std::unique_lock<std::mutex> lock(mMutex);
+
+    // fold the per-thread lock-free tables into the merged map
+    drainThreadLossStatsLocked();
+
     if (mLossInfo.size() == 0) {
         return;
     }
@@ -119,14 +198,20 @@ void StatsSocketLossReporter::dumpAtomsLossStats(bool forceDump) {
 
         mFirstTsNanos.store(0, std::memory_order_relaxed);
         mLastTsNanos.store(0, std::memory_order_relaxed);
+
+        // the digest made it out - hold off for the long interval so a flapping
+        // socket does not turn every reconnect into another digest atom
+        startCooldownTimer(currentRealtimeTsNanos, kSuccessCoolDownTimerDurationNanos);
+        return;
     }
     // since the delay before next attempt is significantly larger than this API call
     // duration it is ok to have correctness of timestamp in a range of 10us
-    startCooldownTimer(currentRealtimeTsNanos);
+    startCooldownTimer(currentRealtimeTsNanos, kCoolDownTimerDurationNanos);
 }
 
-void StatsSocketLossReporter::startCooldownTimer(int64_t elapsedRealtimeNanos) {
-    mCooldownTimerFinishAtNanos = elapsedRealtimeNanos + kCoolDownTimerDurationNanos;
+void StatsSocketLossReporter::startCooldownTimer(int64_t elapsedRealtimeNanos,
+                                                 int64_t durationNanos) {
+    mCooldownTimerFinishAtNanos = elapsedRealtimeNanos + durationNanos;
 }
 
 bool StatsSocketLossReporter::isCooldownTimerActive(int64_t elapsedRealtimeNanos) const {
@@ -20,8 +20,10 @@
 #include <stdint.h>
 
 #include <atomic>
+#include <memory>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 class StatsSocketLossReporter {
 public:
@@ -29,6 +31,31 @@ public:
 
     void noteDrop(int32_t error, int32_t atomId);
 
+    /**
+     * @brief Fixed-size loss counters table owned by a single writer thread
+     *
+     * noteDrop() updates only the calling thread's table, so failing writer
+     * threads never serialize on a shared lock while statsd is unavailable.
+     * The dump path concurrently drains counts with atomic exchanges.
+     * Tables are recycled when their owner thread exits.
+     */
+    struct ThreadLossStats {
+        constexpr static size_t kSlotsPerThread = 32;
+
+        // packs [error, tag] via makeKey(), 0 marks a free slot;
+        // slots are claimed front to back and keys are never erased
+        std::atomic<uint64_t> mKeys[kSlotsPerThread] = {};
+        std::atomic<int32_t> mCounts[kSlotsPerThread] = {};
+
+        // counts drops which did not fit into the table
+        std::atomic<int32_t> mOverflowCounter = 0;
+
+        // true while some live thread owns this table
+        std::atomic<bool> mInUse = false;
+
+        void noteDrop(uint64_t key);
+    };
+
     /**
      * @brief Dump loss info into statsd as a STATS_SOCKET_LOSS_REPORTED atom instance
      *
@@ -43,9 +70,12 @@ public:
 private:
     StatsSocketLossReporter();
 
-    void startCooldownTimer(int64_t elapsedRealtimeNanos);
+    void startCooldownTimer(int64_t elapsedRealtimeNanos, int64_t durationNanos);
     bool isCooldownTimerActive(int64_t elapsedRealtimeNanos) const;
 
+    ThreadLossStats* getThreadLossStats();
+    void drainThreadLossStatsLocked();
+
     const int32_t mUid;
     std::atomic_int64_t mFirstTsNanos = 0;
     std::atomic_int64_t mLastTsNanos = 0;
@@ -58,8 +88,16 @@ private:
     // 100 * 12 + 8 + 8 + 4 ~ 1.2kB
     const size_t kMaxAtomTagsCount = 100;
 
+    // Applied after a failed dump so pending loss info is retried promptly
+    // once the socket looks healthy again
     const int64_t kCoolDownTimerDurationNanos = 10 * 1000 * 1000;  // 10ms
 
+    // Applied after a successful dump. Under socket flapping every reconnect
+    // used to re-emit a digest, amplifying the load on the struggling socket;
+    // with this interval the digest keeps accumulating client-side and is
+    // emitted at most once per interval
+    const int64_t kSuccessCoolDownTimerDurationNanos = 10LL * 1000 * 1000 * 1000;  // 10s
+
     struct HashPair final {
         template <class TFirst, class TSecond>
         size_t operator()(const std::pair<TFirst, TSecond>& p) const noexcept {
@@ -70,14 +108,20 @@ private:
         }
     };
 
-    // guards access to below mLossInfo
+    // guards access to below mLossInfo, taken only on the dump path
     mutable std::mutex mMutex;
 
     using LossInfoKey = std::pair<int, int>;  // [error, tag]
 
-    // Represents loss info as a counter per [error, tag] pair
+    // Represents merged loss info as a counter per [error, tag] pair,
+    // preserved between dump attempts when the socket write fails
     std::unordered_map<LossInfoKey, int, HashPair> mLossInfo;
 
-    // tracks guardrail kMaxAtomTagsCount hit count
+    // tracks guardrail kMaxAtomTagsCount & kSlotsPerThread hit count
     int32_t mOverflowCounter = 0;
+
+    // guards the registry of per-thread tables, taken once per thread
+    // lifetime plus on every dump
+    std::mutex mTablesMutex;
+    std::vector<std::unique_ptr<ThreadLossStats>> mTables;
 };
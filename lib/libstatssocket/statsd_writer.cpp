@@ -26,6 +26,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/uio.h>
@@ -33,6 +35,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+
 #include "stats_socket_loss_reporter.h"
 #include "utils.h"
 
@@ -76,8 +82,11 @@ static int statsdAvailable();
 static int statsdOpen();
 static void statsdClose();
 static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr);
+static int statsdWriteBatch(struct timespec* ts, struct iovec* vec, size_t nrPerMsg,
+                            size_t numMsgs);
 static void statsdNoteDrop(int error, int tag);
 static int statsdIsClosed();
+static int statsdGetOutqBytes();
 
 struct android_log_transport_write statsdLoggerWrite = {
         .name = "statsd",
@@ -86,8 +95,10 @@ struct android_log_transport_write statsdLoggerWrite = {
         .open = statsdOpen,
         .close = statsdClose,
         .write = statsdWrite,
+        .writeBatch = statsdWriteBatch,
         .noteDrop = statsdNoteDrop,
         .isClosed = statsdIsClosed,
+        .getOutqBytes = statsdGetOutqBytes,
 };
 
 /* log_init_lock assumed */
@@ -179,6 +190,24 @@ static int statsdIsClosed() {
     return 0;
 }
 
+static int statsdGetOutqBytes() {
+#ifdef SIOCOUTQ
+    int sock = atomic_load(&statsdLoggerWrite.sock);
+    if (sock < 0) {
+        return sock;
+    }
+    // On a unix datagram socket this reports the bytes sitting in the
+    // receiver's queue that statsd has not read yet.
+    int outqBytes = 0;
+    if (ioctl(sock, SIOCOUTQ, &outqBytes) < 0) {
+        return -errno;
+    }
+    return outqBytes;
+#else
+    return -ENOTSUP;
+#endif
+}
+
 static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
     ssize_t ret;
     int sock;
@@ -313,3 +342,56 @@ static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
 
     return ret;
 }
+
+static int statsdWriteBatch(struct timespec* ts, struct iovec* vec, size_t nrPerMsg,
+                            size_t numMsgs) {
+    int sock = atomic_load(&statsdLoggerWrite.sock);
+    if (sock < 0 || numMsgs == 1) {
+        // statsdWrite owns the reconnect handling and the dropped-events preamble;
+        // route single messages and the not-connected case through it.
+        int ret = statsdWrite(ts, vec, nrPerMsg);
+        return ret > 0 ? 1 : ret;
+    }
+
+    // One datagram per message: the per-log header followed by the caller's iovecs.
+    // numMsgs is capped by the caller's batch size, so the VLAs stay small.
+    android_log_header_t headers[numMsgs];
+    struct iovec newVec[numMsgs * (nrPerMsg + 1)];
+    struct mmsghdr msgs[numMsgs];
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t m = 0; m < numMsgs; m++) {
+        headers[m].tid = android::base::GetThreadId();
+        headers[m].realtime.tv_sec = ts->tv_sec;
+        headers[m].realtime.tv_nsec = ts->tv_nsec;
+        headers[m].id = LOG_ID_STATS;
+
+        struct iovec* msgVec = &newVec[m * (nrPerMsg + 1)];
+        msgVec[0].iov_base = (unsigned char*)&headers[m];
+        msgVec[0].iov_len = sizeof(headers[m]);
+        for (size_t i = 0; i < nrPerMsg; i++) {
+            msgVec[1 + i] = vec[m * nrPerMsg + i];
+        }
+        msgs[m].msg_hdr.msg_iov = msgVec;
+        msgs[m].msg_hdr.msg_iovlen = nrPerMsg + 1;
+    }
+
+    // MSG_NOSIGNAL: a disconnected daemon surfaces as -ENOTCONN below instead
+    // of raising SIGPIPE in the logging process.
+    int ret = TEMP_FAILURE_RETRY(sendmmsg(sock, msgs, numMsgs, MSG_NOSIGNAL));
+    if (ret < 0) {
+        ret = -errno;
+        switch (ret) {
+            case -ENOTCONN:
+            case -ECONNREFUSED:
+            case -ENOENT:
+                // Retry the first message through the single-log path, which
+                // re-establishes the connection; the caller resends the rest.
+                ret = statsdWrite(ts, vec, nrPerMsg);
+                return ret > 0 ? 1 : ret;
+            default:
+                return ret;
+        }
+    }
+    // sendmmsg stops at the first message that fails; report how many went through.
+    return ret;
+}
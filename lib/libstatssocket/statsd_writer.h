@@ -40,10 +40,15 @@ struct android_log_transport_write {
     void (*close)();    /* free up resources */
     /* write log to transport, returns number of bytes propagated, or -errno */
     int (*write)(struct timespec* ts, struct iovec* vec, size_t nr);
+    /* write a batch of numMsgs logs of nrPerMsg iovecs each in one syscall,
+     * returns the number of logs propagated, or -errno when none were */
+    int (*writeBatch)(struct timespec* ts, struct iovec* vec, size_t nrPerMsg, size_t numMsgs);
     /* note one log drop */
     void (*noteDrop)(int error, int tag);
     /* checks if the socket is closed */
     int (*isClosed)();
+    /* bytes written to the socket but not yet read by the daemon, or -errno */
+    int (*getOutqBytes)();
 };
 
 __END_DECLS
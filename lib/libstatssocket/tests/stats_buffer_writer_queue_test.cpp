@@ -17,6 +17,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <chrono>
 
 #include "stats_buffer_writer_queue_impl.h"
@@ -42,6 +43,25 @@ public:
     BasicBufferWriterQueueMock() = default;
     MOCK_METHOD(bool, handleCommand, (const BasicBufferWriterQueueMock::Cmd& cmd),
                 (const override));
+
+    // bypass the batched socket write so the tests keep per-command semantics
+    size_t handleCommandBatch(const std::vector<Cmd>& cmds) const override {
+        size_t written = 0;
+        for (const Cmd& cmd : cmds) {
+            if (!handleCommand(cmd)) {
+                break;
+            }
+            written++;
+        }
+        return written;
+    }
+
+    // controllable stand-in for the SIOCOUTQ probe on the real socket
+    bool isSocketBackpressured() const override {
+        return mBackpressured;
+    }
+
+    std::atomic_bool mBackpressured = false;
 };
 
 typedef StrictMock<BasicBufferWriterQueueMock> BufferWriterQueueMock;
@@ -128,6 +148,35 @@ TEST(StatsBufferWriterQueueTest, TestSleepOnOverflow) {
     }
 }
 
+TEST(StatsBufferWriterQueueTest, TestBackpressureDefersWrites) {
+    AStatsEvent* event = generateTestEvent();
+
+    size_t eventBufferSize = 0;
+    const uint8_t* buffer = AStatsEvent_getBuffer(event, &eventBufferSize);
+    EXPECT_GE(eventBufferSize, 0);
+    EXPECT_TRUE(buffer != nullptr);
+
+    const uint32_t atomId = AStatsEvent_getAtomId(event);
+
+    BufferWriterQueueMock queue;
+    queue.mBackpressured = true;
+    EXPECT_CALL(queue, handleCommand(_)).WillRepeatedly(Return(true));
+
+    const bool addedToQueue = queue.write(buffer, eventBufferSize, atomId);
+    AStatsEvent_release(event);
+    EXPECT_TRUE(addedToQueue);
+
+    // to yeld to the queue worker thread
+    std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_MS));
+    // no write should be attempted while the socket looks backpressured
+    EXPECT_EQ(queue.getQueueSize(), 1);
+
+    queue.mBackpressured = false;
+    // the worker re-probes after at most kMaxDelayOnFailedWriteMs
+    std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_MS));
+    EXPECT_EQ(queue.getQueueSize(), 0);
+}
+
 TEST(StatsBufferWriterQueueTest, TestTerminateNonEmptyQueue) {
     AStatsEvent* event = generateTestEvent();
 
@@ -638,6 +638,42 @@ TEST(StatsEventTest, TestLargePull) {
     AStatsEvent_release(event);
 }
 
+TEST(StatsEventTest, TestReserveLargePull) {
+    const uint32_t atomId = 100;
+    const vector<uint8_t> bytes(10 * 1024 /* number of elements */, 1 /* value of each element */);
+    const int writeCount = 4;  // Number of times to write bytes in the event.
+    const int64_t startTime = android::elapsedRealtimeNano();
+
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, atomId);
+
+    // Reserve the full payload up front so the buffer grows once instead of
+    // per byte array write.
+    AStatsEvent_reserve(event, writeCount * (bytes.size() + sizeof(uint32_t) + 1));
+
+    for (int i = 0; i < writeCount; i++) {
+        AStatsEvent_writeByteArray(event, bytes.data(), bytes.size());
+    }
+    AStatsEvent_build(event);
+    int64_t endTime = android::elapsedRealtimeNano();
+
+    size_t bufferSize;
+    uint8_t* buffer = AStatsEvent_getBuffer(event, &bufferSize);
+    uint8_t* bufferEnd = buffer + bufferSize;
+
+    checkMetadata(&buffer, writeCount, startTime, endTime, atomId);
+
+    // Check all instances of bytes have been written.
+    for (int i = 0; i < writeCount; i++) {
+        checkTypeHeader(&buffer, BYTE_ARRAY_TYPE);
+        checkByteArray(&buffer, bytes);
+    }
+
+    EXPECT_EQ(buffer, bufferEnd);  // Ensure that we have read the entire buffer.
+    EXPECT_EQ(AStatsEvent_getErrors(event), 0);
+    AStatsEvent_release(event);
+}
+
 TEST(StatsEventTest, TestAtomIdInvalidPositionError) {
     AStatsEvent* event = AStatsEvent_obtain();
     AStatsEvent_writeInt32(event, 0);
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "stats_event.h"
+#include "stats_log_util.h"
+#include "tests/statsd_test_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+static void createAttributionChainEvent(LogEvent* event) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, 10);
+    AStatsEvent_overwriteTimestamp(statsEvent, 100000);
+
+    std::vector<int> attributionUids = {100, 200};
+    std::vector<string> attributionTags = {"LOCATION", "LOCATION"};
+    writeAttribution(statsEvent, attributionUids, attributionTags);
+
+    AStatsEvent_writeString(statsEvent, "wakelock_tag");
+    AStatsEvent_writeInt32(statsEvent, 1);
+
+    parseStatsEventToLogEvent(statsEvent, event);
+}
+
+static void createPrimitivesEvent(LogEvent* event) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, 20);
+    AStatsEvent_overwriteTimestamp(statsEvent, 100000);
+
+    AStatsEvent_writeInt32(statsEvent, 123);
+    AStatsEvent_writeInt64(statsEvent, 1234567890123L);
+    AStatsEvent_writeFloat(statsEvent, 3.2f);
+    AStatsEvent_writeString(statsEvent, "subsystem");
+    AStatsEvent_writeInt32(statsEvent, -1);
+
+    parseStatsEventToLogEvent(statsEvent, event);
+}
+
+// Serializes an atom with a depth-two attribution chain, the shape that dominates
+// report payloads. The first iteration compiles the serialization plan; the steady
+// state replays it.
+static void BM_WriteAtomAttributionChain(benchmark::State& state) {
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    createAttributionChainEvent(&event);
+
+    for (auto _ : state) {
+        android::util::ProtoOutputStream protoOutput;
+        writeFieldValueTreeToStream(event.GetTagId(), event.getValues(), &protoOutput);
+        benchmark::DoNotOptimize(protoOutput.size());
+    }
+}
+BENCHMARK(BM_WriteAtomAttributionChain);
+
+// Serializes a flat atom of primitive fields.
+static void BM_WriteAtomPrimitives(benchmark::State& state) {
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    createPrimitivesEvent(&event);
+
+    for (auto _ : state) {
+        android::util::ProtoOutputStream protoOutput;
+        writeFieldValueTreeToStream(event.GetTagId(), event.getValues(), &protoOutput);
+        benchmark::DoNotOptimize(protoOutput.size());
+    }
+}
+BENCHMARK(BM_WriteAtomPrimitives);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -13,10 +13,15 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <utils/JenkinsHash.h>
+
 #include <cstdlib>
 #include <ctime>
+#include <string>
 #include <vector>
 
+#include "FieldValue.h"
+#include "HashableDimensionKey.h"
 #include "benchmark/benchmark.h"
 
 namespace android {
@@ -56,8 +61,121 @@ void benchmarkStdFillForVector(std::vector<ContainerType>& vec, int capacity) {
     benchmark::DoNotOptimize(resultInt);
 }
 
+// Representative sliced-metric key: numFields - 1 int fields plus one string field
+// (uid, ..., process name).
+HashableDimensionKey createDimensionKey(int numFields) {
+    HashableDimensionKey key;
+    int pos[] = {1, 1, 1};
+    Field field(10, pos, 2);
+    for (int i = 0; i < numFields - 1; i++) {
+        key.addValue(FieldValue(field, Value((int32_t)(10000 + i))));
+    }
+    key.addValue(FieldValue(field, Value(std::string("com.android.example.process"))));
+    return key;
+}
+
+// All-INT key of the given arity: the shape that selects a typed comparator bundle.
+HashableDimensionKey createIntDimensionKey(int numFields, int lastValue) {
+    HashableDimensionKey key;
+    int pos[] = {1, 1, 1};
+    Field field(10, pos, 2);
+    for (int i = 0; i < numFields - 1; i++) {
+        key.addValue(FieldValue(field, Value((int32_t)(10000 + i))));
+    }
+    key.addValue(FieldValue(field, Value((int32_t)lastValue)));
+    return key;
+}
+
+// The previous hashDimension implementation: one JenkinsHashMix round per word.
+android::hash_t hashDimensionJenkins(const HashableDimensionKey& value) {
+    android::hash_t hash = 0;
+    for (const auto& fieldValue : value.getValues()) {
+        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getField()));
+        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getTag()));
+        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mValue.getType()));
+        switch (fieldValue.mValue.getType()) {
+            case INT:
+                hash = android::JenkinsHashMix(hash,
+                                               android::hash_type(fieldValue.mValue.int_value));
+                break;
+            case LONG:
+                hash = android::JenkinsHashMix(hash,
+                                               android::hash_type(fieldValue.mValue.long_value));
+                break;
+            case STRING:
+                hash = android::JenkinsHashMix(hash, static_cast<uint32_t>(std::hash<std::string>()(
+                                                             fieldValue.mValue.str_value)));
+                break;
+            case FLOAT:
+                hash = android::JenkinsHashMix(hash,
+                                               android::hash_type(fieldValue.mValue.float_value));
+                break;
+            default:
+                break;
+        }
+    }
+    return android::JenkinsHashWhiten(hash);
+}
+
 }  //  namespace
 
+static void BM_HashDimensionJenkins(benchmark::State& state) {
+    const HashableDimensionKey key = createDimensionKey(state.range(0));
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(hashDimensionJenkins(key));
+    }
+}
+BENCHMARK(BM_HashDimensionJenkins)->Arg(1)->Arg(2)->Arg(3)->Arg(4);
+
+static void BM_HashDimensionStride(benchmark::State& state) {
+    const HashableDimensionKey key = createDimensionKey(state.range(0));
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(hashDimension(key));
+    }
+}
+BENCHMARK(BM_HashDimensionStride)->Arg(1)->Arg(2)->Arg(3)->Arg(4);
+
+// Int-only keys select the typed hasher bundle instead of the generic packing loop.
+static void BM_HashDimensionTypedIntKey(benchmark::State& state) {
+    const HashableDimensionKey key = createIntDimensionKey(state.range(0), 99999);
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(hashDimension(key));
+    }
+}
+BENCHMARK(BM_HashDimensionTypedIntKey)->Arg(1)->Arg(2)->Arg(3)->Arg(4);
+
+// Equality of keys that share a hash bucket but differ in the last value: the common
+// probe miss. Int-only keys run the typed branch-free comparator.
+static void BM_DimensionKeyEqualsTypedIntKey(benchmark::State& state) {
+    const HashableDimensionKey key1 = createIntDimensionKey(state.range(0), 99998);
+    const HashableDimensionKey key2 = createIntDimensionKey(state.range(0), 99999);
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(key1 == key2);
+    }
+}
+BENCHMARK(BM_DimensionKeyEqualsTypedIntKey)->Arg(1)->Arg(2)->Arg(3)->Arg(4);
+
+// Same comparison through the generic path: a trailing string value disqualifies the key
+// from the typed bundles.
+static void BM_DimensionKeyEqualsGeneric(benchmark::State& state) {
+    const HashableDimensionKey key1 = createDimensionKey(state.range(0));
+    const HashableDimensionKey key2 = createDimensionKey(state.range(0));
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(key1 == key2);
+    }
+}
+BENCHMARK(BM_DimensionKeyEqualsGeneric)->Arg(1)->Arg(2)->Arg(3)->Arg(4);
+
+// Ordered-container comparison (std::map of dimension keys) on the typed path.
+static void BM_DimensionKeyLessTypedIntKey(benchmark::State& state) {
+    const HashableDimensionKey key1 = createIntDimensionKey(state.range(0), 99998);
+    const HashableDimensionKey key2 = createIntDimensionKey(state.range(0), 99999);
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(key1 < key2);
+    }
+}
+BENCHMARK(BM_DimensionKeyLessTypedIntKey)->Arg(1)->Arg(2)->Arg(3)->Arg(4);
+
 static void BM_BasicVectorBoolUsage(benchmark::State& state) {
     const int capacity = state.range(0);
     std::vector<bool> vec(capacity);
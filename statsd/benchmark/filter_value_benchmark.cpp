@@ -67,6 +67,103 @@ static void BM_FilterValue(benchmark::State& state) {
 
 BENCHMARK(BM_FilterValue);
 
+// Extraction of a top-level field through the generic mask-matching scan.
+static void BM_FilterValueTopLevel(benchmark::State& state) {
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    FieldMatcher field_matcher;
+    createLogEventAndMatcher(&event, &field_matcher);
+
+    FieldMatcher top_level_matcher;
+    top_level_matcher.set_field(1);
+    top_level_matcher.add_child()->set_field(2);
+
+    std::vector<Matcher> matchers;
+    translateFieldMatcher(top_level_matcher, &matchers);
+
+    while (state.KeepRunning()) {
+        HashableDimensionKey output;
+        filterValues(matchers, event.getValues(), &output);
+    }
+}
+
+BENCHMARK(BM_FilterValueTopLevel);
+
+// Same extraction replayed from a FieldExtractionPlan by direct indexing.
+static void BM_FilterValuePlanned(benchmark::State& state) {
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    FieldMatcher field_matcher;
+    createLogEventAndMatcher(&event, &field_matcher);
+
+    FieldMatcher top_level_matcher;
+    top_level_matcher.set_field(1);
+    top_level_matcher.add_child()->set_field(2);
+
+    std::vector<Matcher> matchers;
+    translateFieldMatcher(top_level_matcher, &matchers);
+    FieldExtractionPlan plan(matchers);
+
+    while (state.KeepRunning()) {
+        HashableDimensionKey output;
+        plan.extract(event.getValues(), &output);
+    }
+}
+
+BENCHMARK(BM_FilterValuePlanned);
+
+static Metric2State createStateLink(FieldMatcher field_matcher) {
+    Metric2State stateLink;
+    stateLink.stateAtomId = 27;
+    translateFieldMatcher(field_matcher, &stateLink.metricFields);
+    field_matcher.set_field(stateLink.stateAtomId);
+    translateFieldMatcher(field_matcher, &stateLink.stateFields);
+    return stateLink;
+}
+
+// What-dimension and state primary key extracted with one pass per link.
+static void BM_FilterValueSeparatePasses(benchmark::State& state) {
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    FieldMatcher field_matcher;
+    createLogEventAndMatcher(&event, &field_matcher);
+
+    std::vector<Matcher> matchers;
+    translateFieldMatcher(field_matcher, &matchers);
+    const Metric2State stateLink = createStateLink(field_matcher);
+
+    while (state.KeepRunning()) {
+        HashableDimensionKey output;
+        filterValues(matchers, event.getValues(), &output);
+        std::map<int32_t, HashableDimensionKey> statePrimaryKeys;
+        getDimensionForState(event.getValues(), stateLink,
+                             &statePrimaryKeys[stateLink.stateAtomId]);
+        benchmark::DoNotOptimize(statePrimaryKeys);
+    }
+}
+
+BENCHMARK(BM_FilterValueSeparatePasses);
+
+// Same extraction through filterValuesFused: one pass over the event's values.
+static void BM_FilterValueFused(benchmark::State& state) {
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    FieldMatcher field_matcher;
+    createLogEventAndMatcher(&event, &field_matcher);
+
+    std::vector<Matcher> matchers;
+    translateFieldMatcher(field_matcher, &matchers);
+    const Metric2State stateLink = createStateLink(field_matcher);
+    const std::vector<Metric2Condition> noConditionLinks;
+    const std::vector<Metric2State> stateLinks = {stateLink};
+
+    while (state.KeepRunning()) {
+        HashableDimensionKey output;
+        std::map<int32_t, HashableDimensionKey> statePrimaryKeys;
+        filterValuesFused(matchers, noConditionLinks, stateLinks, event.getValues(), &output,
+                          nullptr, &statePrimaryKeys);
+        benchmark::DoNotOptimize(statePrimaryKeys);
+    }
+}
+
+BENCHMARK(BM_FilterValueFused);
+
 }  //  namespace statsd
 }  //  namespace os
 }  //  namespace android
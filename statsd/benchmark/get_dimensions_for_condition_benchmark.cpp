@@ -13,11 +13,13 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <map>
 #include <vector>
 
 #include "FieldValue.h"
 #include "HashableDimensionKey.h"
 #include "benchmark/benchmark.h"
+#include "condition/SlicedConditionStateMap.h"
 #include "logd/LogEvent.h"
 #include "stats_event.h"
 #include "stats_log_util.h"
@@ -71,6 +73,112 @@ static void BM_GetDimensionInCondition(benchmark::State& state) {
 
 BENCHMARK(BM_GetDimensionInCondition);
 
+// Same shape of link but on top-level fields, where ConditionLinkPlan can cache
+// the gather plan per atom id instead of re-running the matcher scan per event.
+static void createTopLevelLogEventAndLink(LogEvent* event, Metric2Condition* link) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, 1);
+    AStatsEvent_overwriteTimestamp(statsEvent, 100000);
+
+    AStatsEvent_writeInt32(statsEvent, 10001);
+    AStatsEvent_writeString(statsEvent, "LOCATION");
+    AStatsEvent_writeInt64(statsEvent, 990);
+
+    parseStatsEventToLogEvent(statsEvent, event);
+
+    link->conditionId = 1;
+
+    FieldMatcher field_matcher;
+    field_matcher.set_field(event->GetTagId());
+    field_matcher.add_child()->set_field(1);
+
+    translateFieldMatcher(field_matcher, &link->metricFields);
+    field_matcher.set_field(event->GetTagId() + 1);
+    translateFieldMatcher(field_matcher, &link->conditionFields);
+}
+
+static void BM_GetDimensionInConditionTopLevel(benchmark::State& state) {
+    Metric2Condition link;
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    createTopLevelLogEventAndLink(&event, &link);
+
+    while (state.KeepRunning()) {
+        HashableDimensionKey output;
+        getDimensionForCondition(event.getValues(), link, &output);
+    }
+}
+
+BENCHMARK(BM_GetDimensionInConditionTopLevel);
+
+static void BM_ConditionLinkPlanTopLevel(benchmark::State& state) {
+    Metric2Condition link;
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    createTopLevelLogEventAndLink(&event, &link);
+    ConditionLinkPlan plan(link);
+
+    while (state.KeepRunning()) {
+        HashableDimensionKey output;
+        plan.resolve(event.getValues(), &output);
+    }
+}
+
+BENCHMARK(BM_ConditionLinkPlanTopLevel);
+
+// Keys shaped like a by-uid sliced condition: one int field per dimension.
+static std::vector<HashableDimensionKey> createUidDimensionKeys(int count) {
+    std::vector<HashableDimensionKey> keys;
+    keys.reserve(count);
+    int pos[] = {1, 0, 0};
+    for (int i = 0; i < count; i++) {
+        HashableDimensionKey key;
+        key.addValue(FieldValue(Field(1, pos, 0), Value(10000 + i)));
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// Compares sliced-condition state layouts: red-black tree (std::map) vs the
+// open-addressing SlicedConditionStateMap used by SimpleConditionTracker.
+template <typename MapType>
+static void runSlicedConditionStateBenchmark(benchmark::State& state) {
+    const std::vector<HashableDimensionKey> keys = createUidDimensionKeys(state.range(0));
+
+    while (state.KeepRunning()) {
+        MapType slicedState;
+        // Start events.
+        for (const HashableDimensionKey& key : keys) {
+            slicedState[key]++;
+        }
+        // Lookups, as done when reporting existing condition values.
+        int started = 0;
+        for (const HashableDimensionKey& key : keys) {
+            auto it = slicedState.find(key);
+            if (it != slicedState.end() && it->second > 0) {
+                started++;
+            }
+        }
+        // Stop events erase the entries again.
+        for (const HashableDimensionKey& key : keys) {
+            auto it = slicedState.find(key);
+            if (it != slicedState.end()) {
+                slicedState.erase(it);
+            }
+        }
+        benchmark::DoNotOptimize(started);
+    }
+}
+
+static void BM_SlicedConditionStateStdMap(benchmark::State& state) {
+    runSlicedConditionStateBenchmark<std::map<HashableDimensionKey, int>>(state);
+}
+
+BENCHMARK(BM_SlicedConditionStateStdMap)->Arg(100)->Arg(1000)->Arg(5000);
+
+static void BM_SlicedConditionStateFlatMap(benchmark::State& state) {
+    runSlicedConditionStateBenchmark<SlicedConditionStateMap>(state);
+}
+
+BENCHMARK(BM_SlicedConditionStateFlatMap)->Arg(100)->Arg(1000)->Arg(5000);
 
 }  //  namespace statsd
 }  //  namespace os
@@ -30,6 +30,63 @@ static void BM_StatsEventObtain(benchmark::State& state) {
 }
 BENCHMARK(BM_StatsEventObtain);
 
+static void BM_StatsEventBuild(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        AStatsEvent* event = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(event, 100);
+        AStatsEvent_writeInt32(event, 1);
+        AStatsEvent_writeInt64(event, 0x123456789);
+        AStatsEvent_build(event);
+        size_t size;
+        benchmark::DoNotOptimize(AStatsEvent_getBuffer(event, &size));
+        AStatsEvent_release(event);
+    }
+}
+BENCHMARK(BM_StatsEventBuild);
+
+static void BM_StatsEventObtainExceedingPool(benchmark::State& state) {
+    // Holding more live events than the per-thread pool retains forces fresh
+    // allocations, approximating the pre-pool malloc-per-event cost for contrast
+    // with BM_StatsEventObtain.
+    constexpr int kBatch = 8;
+    AStatsEvent* events[kBatch];
+    while (state.KeepRunning()) {
+        for (int i = 0; i < kBatch; i++) {
+            events[i] = AStatsEvent_obtain();
+        }
+        benchmark::DoNotOptimize(events);
+        for (int i = 0; i < kBatch; i++) {
+            AStatsEvent_release(events[i]);
+        }
+    }
+}
+BENCHMARK(BM_StatsEventObtainExceedingPool);
+
+static void BM_StatsEventByteArrayBuild(benchmark::State& state) {
+    // Large pulled atom shape: a few sizable byte arrays, with and without the
+    // up-front capacity reservation (arg 0/1).
+    const bool reserve = state.range(0) != 0;
+    constexpr size_t kChunkSize = 10 * 1024;
+    constexpr int kChunks = 4;
+    std::vector<uint8_t> chunk(kChunkSize, 1);
+    while (state.KeepRunning()) {
+        AStatsEvent* event = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(event, 10100);
+        if (reserve) {
+            AStatsEvent_reserve(event, kChunks * (kChunkSize + sizeof(uint32_t) + 1));
+        }
+        for (int i = 0; i < kChunks; i++) {
+            AStatsEvent_writeByteArray(event, chunk.data(), chunk.size());
+        }
+        AStatsEvent_build(event);
+        size_t size;
+        benchmark::DoNotOptimize(AStatsEvent_getBuffer(event, &size));
+        AStatsEvent_release(event);
+    }
+    state.SetBytesProcessed(state.iterations() * kChunks * kChunkSize);
+}
+BENCHMARK(BM_StatsEventByteArrayBuild)->Arg(0)->Arg(1);
+
 static void BM_StatsWrite(benchmark::State& state) {
     int32_t parent_uid = 0;
     int32_t isolated_uid = 100;
@@ -105,3 +105,35 @@ BENCHMARK(BM_RemoveTrailingNumbersCRegex)->RangeMultiplier(2)->RangePair(0, 20,
 //     }
 // }
 // BENCHMARK(BM_RemoveTrailingNumbersRe2)->RangeMultiplier(2)->RangePair(0, 20, 0, 20);
+
+// Same pattern written with an interval bound, which the anchored-class fast
+// path does not recognize, so this measures the regexec() fallback against
+// BM_RemoveTrailingNumbersCRegex above.
+static void BM_RemoveTrailingNumbersCRegexPosix(benchmark::State& state) {
+    unique_ptr<Regex> re = Regex::create(R"([0-9]{1,}$)");
+    const string prefix(state.range(0), 'a' + rand() % 26);
+    const string suffix(state.range(1), '0' + rand() % 10);
+    const string input = prefix + suffix;
+    for (auto _ : state) {
+        string str = input;
+        benchmark::DoNotOptimize(re->replace(str, ""));
+    }
+}
+BENCHMARK(BM_RemoveTrailingNumbersCRegexPosix)->RangeMultiplier(2)->RangePair(0, 20, 0, 20);
+
+// Cache-hit cost of the process-wide compiled-pattern cache, which is what the
+// matcher path pays per event instead of a full regcomp().
+static void BM_RegexCreateShared(benchmark::State& state) {
+    shared_ptr<Regex> held = Regex::createShared(R"([0-9]+$)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Regex::createShared(R"([0-9]+$)"));
+    }
+}
+BENCHMARK(BM_RegexCreateShared);
+
+static void BM_RegexCreateUncached(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Regex::create(R"([0-9]+$)"));
+    }
+}
+BENCHMARK(BM_RegexCreateUncached);
@@ -181,7 +181,7 @@ std::string Value::toString() const {
         case DOUBLE:
             return std::to_string(double_value) + "[D]";
         case STRING:
-            return str_value + "[S]";
+            return std::string(str_value) + "[S]";
         case STORAGE:
             return "bytes of size " + std::to_string(storage_value.size()) + "[ST]";
         default:
@@ -559,34 +559,40 @@ size_t getSize(const std::vector<FieldValue>& fieldValues) {
     return totalSize;
 }
 
-bool shouldKeepSample(const FieldValue& sampleFieldValue, int shardOffset, int shardCount) {
-    int hashValue = 0;
+bool computeSampleHash(const FieldValue& sampleFieldValue, int* hash) {
     switch (sampleFieldValue.mValue.type) {
         case INT:
-            hashValue = Hash32(reinterpret_cast<const char*>(&sampleFieldValue.mValue.int_value),
-                               sizeof(sampleFieldValue.mValue.int_value));
-            break;
+            *hash = Hash32(reinterpret_cast<const char*>(&sampleFieldValue.mValue.int_value),
+                           sizeof(sampleFieldValue.mValue.int_value));
+            return true;
         case LONG:
-            hashValue = Hash32(reinterpret_cast<const char*>(&sampleFieldValue.mValue.long_value),
-                               sizeof(sampleFieldValue.mValue.long_value));
-            break;
+            *hash = Hash32(reinterpret_cast<const char*>(&sampleFieldValue.mValue.long_value),
+                           sizeof(sampleFieldValue.mValue.long_value));
+            return true;
         case FLOAT:
-            hashValue = Hash32(reinterpret_cast<const char*>(&sampleFieldValue.mValue.float_value),
-                               sizeof(sampleFieldValue.mValue.float_value));
-            break;
+            *hash = Hash32(reinterpret_cast<const char*>(&sampleFieldValue.mValue.float_value),
+                           sizeof(sampleFieldValue.mValue.float_value));
+            return true;
         case DOUBLE:
-            hashValue = Hash32(reinterpret_cast<const char*>(&sampleFieldValue.mValue.double_value),
-                               sizeof(sampleFieldValue.mValue.double_value));
-            break;
+            *hash = Hash32(reinterpret_cast<const char*>(&sampleFieldValue.mValue.double_value),
+                           sizeof(sampleFieldValue.mValue.double_value));
+            return true;
         case STRING:
-            hashValue = Hash32(sampleFieldValue.mValue.str_value);
-            break;
+            *hash = Hash32(sampleFieldValue.mValue.str_value);
+            return true;
         case STORAGE:
-            hashValue = Hash32((const char*)sampleFieldValue.mValue.storage_value.data(),
-                               sampleFieldValue.mValue.storage_value.size());
-            break;
-        default:
+            *hash = Hash32((const char*)sampleFieldValue.mValue.storage_value.data(),
+                           sampleFieldValue.mValue.storage_value.size());
             return true;
+        default:
+            return false;
+    }
+}
+
+bool shouldKeepSample(const FieldValue& sampleFieldValue, int shardOffset, int shardCount) {
+    int hashValue = 0;
+    if (!computeSampleHash(sampleFieldValue, &hashValue)) {
+        return true;
     }
     return (hashValue + shardOffset) % shardCount == 0;
 }
@@ -16,6 +16,7 @@
 #pragma once
 
 #include "src/statsd_config.pb.h"
+#include "utils/InternTable.h"
 
 namespace android {
 namespace os {
@@ -33,6 +34,9 @@ const int32_t kClearAllPositionMatcherMask = 0xffff00ff;
 
 enum Type { UNKNOWN, INT, LONG, FLOAT, DOUBLE, STRING, STORAGE };
 
+using InternedString = InternedHandle<std::string>;
+using InternedBytes = InternedHandle<std::vector<uint8_t>>;
+
 int32_t getEncodedField(int32_t pos[], int32_t depth, bool includeDepth);
 
 int32_t encodeMatcherMask(int32_t mask[], int32_t depth);
@@ -338,8 +342,12 @@ struct Value {
         float float_value;
         double double_value;
     };
-    std::string str_value;
-    std::vector<uint8_t> storage_value;
+    // String and byte-array payloads live in the process-wide InternTable; the
+    // members here are one-word refcounted handles, so >80% of fields (numeric
+    // ones) no longer pay for string bookkeeping, mValues vectors pack densely,
+    // and copying a string Value during dimension extraction is a refcount bump.
+    InternedString str_value;
+    InternedBytes storage_value;
 
     Type type;
 
@@ -481,6 +489,12 @@ bool subsetDimensions(const std::vector<Matcher>& dimension_a,
 // the size is computed at runtime using the actual contents stored in the FieldValue.
 size_t getSize(const std::vector<FieldValue>& fieldValues);
 
+// Computes the raw sample hash for the value and writes it to hash, returning false for
+// value types that cannot be hashed (which always pass sampling). The hash depends only
+// on the value, not on the shard offset or shard count, so callers may memoize it across
+// events and across shard-count changes.
+bool computeSampleHash(const FieldValue& sampleFieldValue, int* hash);
+
 bool shouldKeepSample(const FieldValue& sampleFieldValue, int shardOffset, int shardCount);
 
 }  // namespace statsd
@@ -18,6 +18,9 @@
 
 #include "HashableDimensionKey.h"
 #include "FieldValue.h"
+#include "hash.h"
+
+#include <string.h>
 
 namespace android {
 namespace os {
@@ -95,61 +98,164 @@ static void populateStatsDimensionsValueParcelChildren(StatsDimensionsValueParce
 
 StatsDimensionsValueParcel HashableDimensionKey::toStatsDimensionsValueParcel() const {
     StatsDimensionsValueParcel root;
-    if (mValues.size() == 0) {
+    const vector<FieldValue>& values = getValues();
+    if (values.size() == 0) {
         return root;
     }
 
-    root.field = mValues[0].mField.getTag();
+    root.field = values[0].mField.getTag();
     root.valueType = STATS_DIMENSIONS_VALUE_TUPLE_TYPE;
 
     // Children of the root correspond to top-level (depth = 0) FieldValues.
     int childDepth = 0;
     int childPrefix = 0;
     size_t index = 0;
-    populateStatsDimensionsValueParcelChildren(root, childDepth, childPrefix, mValues, index);
+    populateStatsDimensionsValueParcelChildren(root, childDepth, childPrefix, values, index);
 
     return root;
 }
 
+namespace {
+
+constexpr size_t kDimensionHashBufferSize = 256;
+
+// Appends a trivially copyable value to the packing buffer, flushing through Hash64Fast with
+// hash chaining when the buffer is full (keys rarely exceed one buffer in practice).
+template <typename T>
+inline void packForHash(char* buffer, size_t& len, uint64_t& hash, const T& value) {
+    if (len + sizeof(T) > kDimensionHashBufferSize) {
+        hash = Hash64Fast(buffer, len, hash);
+        len = 0;
+    }
+    memcpy(buffer + len, &value, sizeof(T));
+    len += sizeof(T);
+}
+
+// Bits above the per-value type nibbles that hold the value count.
+constexpr int kSignatureSizeShift = 4 * kMaxSignatureValues;
+
+// The signature of a key with [arity] values that are all INT.
+constexpr uint64_t intOnlySignature(size_t arity) {
+    uint64_t signature = static_cast<uint64_t>(arity) << kSignatureSizeShift;
+    for (size_t i = 0; i < arity; i++) {
+        signature |= static_cast<uint64_t>(INT) << (4 * i);
+    }
+    return signature;
+}
+
+// Appends a word to the packing buffer without the flush check of packForHash; typed
+// hashers bound their buffer size at compile time.
+inline void packWord(char* buffer, size_t& len, int32_t value) {
+    memcpy(buffer + len, &value, sizeof(value));
+    len += sizeof(value);
+}
+
+// Typed operations for all-INT keys of fixed arity. The loops unroll completely and the
+// value-type switches of the generic FieldValue operators disappear; equality accumulates
+// with & so the common miss (same hash bucket, different uid) stays branch-free.
+
+template <size_t N>
+bool intKeyEquals(const vector<FieldValue>& a, const vector<FieldValue>& b) {
+    int equal = 1;
+    for (size_t i = 0; i < N; i++) {
+        equal &= static_cast<int>(a[i].mField.getTag() == b[i].mField.getTag());
+        equal &= static_cast<int>(a[i].mField.getField() == b[i].mField.getField());
+        equal &= static_cast<int>(a[i].mValue.int_value == b[i].mValue.int_value);
+    }
+    return equal != 0;
+}
+
+template <size_t N>
+bool intKeyLess(const vector<FieldValue>& a, const vector<FieldValue>& b) {
+    for (size_t i = 0; i < N; i++) {
+        if (a[i].mField.getTag() != b[i].mField.getTag()) {
+            return a[i].mField.getTag() < b[i].mField.getTag();
+        }
+        if (a[i].mField.getField() != b[i].mField.getField()) {
+            return a[i].mField.getField() < b[i].mField.getField();
+        }
+        if (a[i].mValue.int_value != b[i].mValue.int_value) {
+            return a[i].mValue.int_value < b[i].mValue.int_value;
+        }
+    }
+    return false;
+}
+
+template <size_t N>
+android::hash_t intKeyHash(const vector<FieldValue>& values) {
+    // Packs the identical byte stream to the generic hashDimension path (field, tag,
+    // type, payload per value), so typed and generic hashes of the same key agree.
+    char buffer[N * 4 * sizeof(int32_t)];
+    size_t len = 0;
+    for (size_t i = 0; i < N; i++) {
+        packWord(buffer, len, values[i].mField.getField());
+        packWord(buffer, len, values[i].mField.getTag());
+        packWord(buffer, len, static_cast<int32_t>(INT));
+        packWord(buffer, len, values[i].mValue.int_value);
+    }
+    const uint64_t hash = Hash64Fast(buffer, len, 0);
+    return static_cast<android::hash_t>(hash ^ (hash >> 32));
+}
+
+}  // namespace
+
+const DimensionKeyOps* selectDimensionKeyOps(uint64_t typeSignature) {
+    static constexpr DimensionKeyOps kIntKeyOps[kMaxTypedDimensionOpsArity] = {
+            {&intKeyEquals<1>, &intKeyLess<1>, &intKeyHash<1>},
+            {&intKeyEquals<2>, &intKeyLess<2>, &intKeyHash<2>},
+            {&intKeyEquals<3>, &intKeyLess<3>, &intKeyHash<3>},
+            {&intKeyEquals<4>, &intKeyLess<4>, &intKeyHash<4>},
+    };
+    const uint64_t arity = typeSignature >> kSignatureSizeShift;
+    if (arity == 0 || arity > kMaxTypedDimensionOpsArity ||
+        typeSignature != intOnlySignature(arity)) {
+        return nullptr;
+    }
+    return &kIntKeyOps[arity - 1];
+}
+
 android::hash_t hashDimension(const HashableDimensionKey& value) {
-    android::hash_t hash = 0;
+    if (const DimensionKeyOps* ops = selectDimensionKeyOps(value.getTypeSignature())) {
+        return ops->hash(value.getValues());
+    }
+    // Pack the key into one contiguous buffer and run the stride-based hash over it once,
+    // instead of folding every word through a separate JenkinsHashMix round.
+    char buffer[kDimensionHashBufferSize];
+    size_t len = 0;
+    uint64_t hash = 0;
     for (const auto& fieldValue : value.getValues()) {
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getField()));
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getTag()));
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mValue.getType()));
+        packForHash(buffer, len, hash, fieldValue.mField.getField());
+        packForHash(buffer, len, hash, fieldValue.mField.getTag());
+        packForHash(buffer, len, hash, static_cast<int32_t>(fieldValue.mValue.getType()));
         switch (fieldValue.mValue.getType()) {
             case INT:
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.int_value));
+                packForHash(buffer, len, hash, fieldValue.mValue.int_value);
                 break;
             case LONG:
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.long_value));
+                packForHash(buffer, len, hash, fieldValue.mValue.long_value);
                 break;
             case STRING:
-                hash = android::JenkinsHashMix(hash, static_cast<uint32_t>(std::hash<std::string>()(
-                                                             fieldValue.mValue.str_value)));
+                // Variable-length payloads contribute a fixed-size digest to the stream.
+                packForHash(buffer, len, hash, Hash64Fast(fieldValue.mValue.str_value));
                 break;
-            case FLOAT: {
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.float_value));
+            case FLOAT:
+                packForHash(buffer, len, hash, fieldValue.mValue.float_value);
                 break;
-            }
-            case DOUBLE: {
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.double_value));
+            case DOUBLE:
+                packForHash(buffer, len, hash, fieldValue.mValue.double_value);
                 break;
-            }
-            case STORAGE: {
-                hash = android::JenkinsHashMixBytes(hash, fieldValue.mValue.storage_value.data(),
-                                                    fieldValue.mValue.storage_value.size());
+            case STORAGE:
+                packForHash(buffer, len, hash,
+                            Hash64Fast(reinterpret_cast<const char*>(
+                                               fieldValue.mValue.storage_value.data()),
+                                       fieldValue.mValue.storage_value.size()));
                 break;
-            }
             default:
                 break;
         }
     }
-    return JenkinsHashWhiten(hash);
+    hash = Hash64Fast(buffer, len, hash);
+    return static_cast<android::hash_t>(hash ^ (hash >> 32));
 }
 
 bool filterValues(const Matcher& matcherField, const vector<FieldValue>& values,
@@ -169,6 +275,7 @@ bool filterValues(const Matcher& matcherField, const vector<FieldValue>& values,
 bool filterValues(const vector<Matcher>& matcherFields, const vector<FieldValue>& values,
                   HashableDimensionKey* output) {
     size_t num_matches = 0;
+    output->reserve(matcherFields.size());
     for (const auto& value : values) {
         for (size_t i = 0; i < matcherFields.size(); ++i) {
             const auto& matcher = matcherFields[i];
@@ -189,6 +296,7 @@ bool filterValues(const vector<Matcher>& dimKeyMatcherFields,
                   HashableDimensionKey& key, vector<int>& valueIndices) {
     size_t key_num_matches = 0;
     size_t value_num_matches = 0;
+    key.reserve(dimKeyMatcherFields.size());
     for (size_t i = 0; i < values.size(); ++i) {
         const FieldValue& value = values[i];
         for (const auto& matcher : dimKeyMatcherFields) {
@@ -210,10 +318,262 @@ bool filterValues(const vector<Matcher>& dimKeyMatcherFields,
     return value_num_matches == valueMatcherFields.size();
 }
 
+namespace {
+
+// Appends [value] to [output] with the tag/field rewriting filterValues performs.
+inline void addFilteredValue(const FieldValue& value, const Matcher& matcher,
+                             HashableDimensionKey* output) {
+    output->addValue(value);
+    const size_t index = output->getValues().size() - 1;
+    output->mutableValue(index)->mField.setTag(value.mField.getTag());
+    output->mutableValue(index)->mField.setField(value.mField.getField() & matcher.mMask);
+}
+
+// Rewrites a fully matched link dimension to the linked atom's field ids, as
+// getDimensionForCondition and getDimensionForState do after filtering.
+inline void rewriteLinkedFields(const vector<Matcher>& linkedFields, HashableDimensionKey* key) {
+    if (key->getValues().size() != linkedFields.size()) {
+        return;
+    }
+    for (size_t i = 0; i < linkedFields.size(); i++) {
+        key->mutableValue(i)->mField.setField(linkedFields[i].mMatcher.getField());
+        key->mutableValue(i)->mField.setTag(linkedFields[i].mMatcher.getTag());
+    }
+}
+
+}  // namespace
+
+void filterValuesFused(const vector<Matcher>& dimensionMatchers,
+                       const vector<Metric2Condition>& conditionLinks,
+                       const vector<Metric2State>& stateLinks, const vector<FieldValue>& values,
+                       HashableDimensionKey* dimensionKey,
+                       std::map<int64_t, HashableDimensionKey>* conditionDimensions,
+                       std::map<int32_t, HashableDimensionKey>* statePrimaryKeys) {
+    if (!dimensionMatchers.empty()) {
+        dimensionKey->reserve(dimensionMatchers.size());
+    }
+    // Entries must exist even when nothing matches, mirroring the map accesses of the
+    // unfused path.
+    for (const auto& link : conditionLinks) {
+        (*conditionDimensions)[link.conditionId];
+    }
+    for (const auto& link : stateLinks) {
+        (*statePrimaryKeys)[link.stateAtomId];
+    }
+
+    for (const auto& value : values) {
+        for (const auto& matcher : dimensionMatchers) {
+            if (value.mField.matches(matcher)) {
+                addFilteredValue(value, matcher, dimensionKey);
+            }
+        }
+        for (const auto& link : conditionLinks) {
+            for (const auto& matcher : link.metricFields) {
+                if (value.mField.matches(matcher)) {
+                    addFilteredValue(value, matcher, &(*conditionDimensions)[link.conditionId]);
+                }
+            }
+        }
+        for (const auto& link : stateLinks) {
+            for (const auto& matcher : link.metricFields) {
+                if (value.mField.matches(matcher)) {
+                    addFilteredValue(value, matcher, &(*statePrimaryKeys)[link.stateAtomId]);
+                }
+            }
+        }
+    }
+
+    for (const auto& link : conditionLinks) {
+        rewriteLinkedFields(link.conditionFields, &(*conditionDimensions)[link.conditionId]);
+    }
+    for (const auto& link : stateLinks) {
+        rewriteLinkedFields(link.stateFields, &(*statePrimaryKeys)[link.stateAtomId]);
+    }
+}
+
+namespace {
+
+// Depth 0 fields appear at most once per event and at a fixed position for a given atom, so
+// their matched indices can be cached. Anything deeper sits inside a repeated or nested field
+// whose element count varies per event.
+bool areMatchersCacheable(const vector<Matcher>& matchers) {
+    for (const Matcher& matcher : matchers) {
+        if (matcher.getMatcher().getDepth() != 0) {
+            return false;
+        }
+    }
+    return !matchers.empty();
+}
+
+}  // namespace
+
+FieldExtractionPlan::FieldExtractionPlan(const vector<Matcher>& matchers)
+    : mMatchers(matchers), mCacheable(areMatchersCacheable(matchers)) {
+}
+
+bool FieldExtractionPlan::extract(const vector<FieldValue>& values, HashableDimensionKey* output) {
+    if (!mCacheable || values.empty()) {
+        return filterValues(mMatchers, values, output);
+    }
+    Plan& plan = mPlans[values[0].mField.getTag()];
+    if (replay(plan, values, output)) {
+        return !plan.entries.empty();
+    }
+    // First event of this atom id, or its layout shifted: scan generically and rebuild the plan
+    // so subsequent events replay it.
+    rebuild(plan, values);
+    return filterValues(mMatchers, values, output);
+}
+
+bool FieldExtractionPlan::replay(const Plan& plan, const vector<FieldValue>& values,
+                                 HashableDimensionKey* output) const {
+    if (values.size() != plan.fieldLayout.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i].mField.getField() != plan.fieldLayout[i]) {
+            return false;
+        }
+    }
+    if (plan.entries.empty()) {
+        return true;
+    }
+    output->reserve(plan.entries.size());
+    size_t num_matches = 0;
+    for (const auto& entry : plan.entries) {
+        output->addValue(values[entry.first]);
+        output->mutableValue(num_matches)->mField.setField(entry.second);
+        num_matches++;
+    }
+    return true;
+}
+
+void FieldExtractionPlan::rebuild(Plan& plan, const vector<FieldValue>& values) const {
+    plan.fieldLayout.clear();
+    plan.entries.clear();
+    plan.fieldLayout.reserve(values.size());
+    for (const FieldValue& value : values) {
+        plan.fieldLayout.push_back(value.mField.getField());
+    }
+    for (int32_t i = 0; i < (int32_t)values.size(); ++i) {
+        for (const Matcher& matcher : mMatchers) {
+            if (values[i].mField.matches(matcher)) {
+                plan.entries.push_back({i, values[i].mField.getField() & matcher.mMask});
+            }
+        }
+    }
+}
+
+ValueIndexPlan::ValueIndexPlan(const vector<Matcher>& matchers)
+    : mMatchers(matchers), mCacheable(areMatchersCacheable(matchers)) {
+}
+
+void ValueIndexPlan::resolve(const vector<FieldValue>& values, vector<int32_t>& indices) {
+    if (!mCacheable || values.empty()) {
+        scan(values, indices);
+        return;
+    }
+    Plan& plan = mPlans[values[0].mField.getTag()];
+    bool layoutMatches = values.size() == plan.fieldLayout.size();
+    for (size_t i = 0; layoutMatches && i < values.size(); ++i) {
+        layoutMatches = values[i].mField.getField() == plan.fieldLayout[i];
+    }
+    if (layoutMatches) {
+        indices.assign(plan.indices.begin(), plan.indices.end());
+        return;
+    }
+    // First event of this atom id, or its layout shifted: scan generically and rebuild
+    // the plan so subsequent events replay it.
+    plan.fieldLayout.clear();
+    plan.fieldLayout.reserve(values.size());
+    for (const FieldValue& value : values) {
+        plan.fieldLayout.push_back(value.mField.getField());
+    }
+    scan(values, indices);
+    plan.indices.assign(indices.begin(), indices.end());
+}
+
+void ValueIndexPlan::scan(const vector<FieldValue>& values, vector<int32_t>& indices) const {
+    indices.assign(mMatchers.size(), -1);
+    for (size_t m = 0; m < mMatchers.size(); ++m) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i].mField.matches(mMatchers[m])) {
+                indices[m] = (int32_t)i;
+                break;
+            }
+        }
+    }
+}
+
+ConditionLinkPlan::ConditionLinkPlan(const Metric2Condition& link)
+    : mLink(link), mCacheable(areMatchersCacheable(link.metricFields)) {
+}
+
+void ConditionLinkPlan::resolve(const vector<FieldValue>& eventValues,
+                                HashableDimensionKey* conditionDimension) {
+    if (!mCacheable || eventValues.empty()) {
+        getDimensionForCondition(eventValues, mLink, conditionDimension);
+        return;
+    }
+    Plan& plan = mPlans[eventValues[0].mField.getTag()];
+    bool layoutMatches = eventValues.size() == plan.fieldLayout.size();
+    for (size_t i = 0; layoutMatches && i < eventValues.size(); ++i) {
+        layoutMatches = eventValues[i].mField.getField() == plan.fieldLayout[i];
+    }
+    if (layoutMatches) {
+        conditionDimension->reserve(plan.entries.size());
+        size_t num_matches = 0;
+        for (const Entry& entry : plan.entries) {
+            conditionDimension->addValue(eventValues[entry.sourceIndex]);
+            conditionDimension->mutableValue(num_matches)->mField.setField(entry.field);
+            conditionDimension->mutableValue(num_matches)->mField.setTag(entry.tag);
+            num_matches++;
+        }
+        return;
+    }
+    // First event of this atom id, or its layout shifted: resolve generically and
+    // rebuild the plan so subsequent events replay it.
+    getDimensionForCondition(eventValues, mLink, conditionDimension);
+    plan.fieldLayout.clear();
+    plan.entries.clear();
+    plan.fieldLayout.reserve(eventValues.size());
+    for (const FieldValue& value : eventValues) {
+        plan.fieldLayout.push_back(value.mField.getField());
+    }
+    // Record where each output value came from, in the same values-outer order the
+    // generic match uses, then read the final field/tag off the resolved output so
+    // the rewrite step is baked into the plan.
+    for (int32_t i = 0; i < (int32_t)eventValues.size(); ++i) {
+        for (const Matcher& matcher : mLink.metricFields) {
+            if (eventValues[i].mField.matches(matcher)) {
+                plan.entries.push_back(Entry{i, 0, 0});
+            }
+        }
+    }
+    const vector<FieldValue>& resolved = conditionDimension->getValues();
+    if (resolved.size() != plan.entries.size()) {
+        // The caller passed a non-empty key; nothing sound to cache.
+        plan.fieldLayout.clear();
+        plan.entries.clear();
+        return;
+    }
+    for (size_t i = 0; i < plan.entries.size(); ++i) {
+        plan.entries[i].field = resolved[i].mField.getField();
+        plan.entries[i].tag = resolved[i].mField.getTag();
+    }
+}
+
 bool filterPrimaryKey(const std::vector<FieldValue>& values, HashableDimensionKey* output) {
     size_t num_matches = 0;
     const int32_t simpleFieldMask = 0xff7f0000;
     const int32_t attributionUidFieldMask = 0xff7f7f7f;
+    size_t numPrimary = 0;
+    for (const auto& value : values) {
+        if (value.mAnnotations.isPrimaryField()) {
+            numPrimary++;
+        }
+    }
+    output->reserve(numPrimary);
     for (const auto& value : values) {
         if (value.mAnnotations.isPrimaryField()) {
             output->addValue(value);
@@ -229,6 +589,7 @@ bool filterPrimaryKey(const std::vector<FieldValue>& values, HashableDimensionKe
 
 void filterGaugeValues(const std::vector<Matcher>& matcherFields,
                        const std::vector<FieldValue>& values, std::vector<FieldValue>* output) {
+    output->reserve(matcherFields.size());
     for (const auto& field : matcherFields) {
         for (const auto& value : values) {
             if (value.mField.matches(field)) {
@@ -332,31 +693,132 @@ bool LessThan(const vector<FieldValue>& s1, const vector<FieldValue>& s2) {
     return false;
 }
 
+const std::vector<FieldValue> HashableDimensionKey::kEmptyValues;
+
+android::hash_t HashableDimensionKey::getHash() const {
+    if (!mHashValid) {
+        mHash = hashDimension(*this);
+        mHashValid = true;
+    }
+    return mHash;
+}
+
+uint64_t HashableDimensionKey::getTypeSignature() const {
+    if (!mTypeSignatureValid) {
+        const vector<FieldValue>& values = getValues();
+        if (values.size() > kMaxSignatureValues) {
+            mTypeSignature = kNoTypedSignature;
+        } else {
+            uint64_t signature = static_cast<uint64_t>(values.size()) << kSignatureSizeShift;
+            for (size_t i = 0; i < values.size(); i++) {
+                signature |= static_cast<uint64_t>(values[i].mValue.getType()) << (4 * i);
+            }
+            mTypeSignature = signature;
+        }
+        mTypeSignatureValid = true;
+    }
+    return mTypeSignature;
+}
+
+void HashableDimensionKey::intern() {
+    if (mValues == nullptr || mValues->empty()) {
+        // Canonical form of an empty key is no storage at all.
+        mValues = nullptr;
+        return;
+    }
+    mValues = DimensionKeyPool::getInstance().intern(mValues, getHash());
+}
+
+DimensionKeyPool& DimensionKeyPool::getInstance() {
+    static DimensionKeyPool pool;
+    return pool;
+}
+
+std::shared_ptr<std::vector<FieldValue>> DimensionKeyPool::intern(
+        const std::shared_ptr<std::vector<FieldValue>>& values, android::hash_t hash) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<std::weak_ptr<std::vector<FieldValue>>>& bucket = mPool[hash];
+    std::shared_ptr<std::vector<FieldValue>> result;
+    for (auto it = bucket.begin(); it != bucket.end();) {
+        std::shared_ptr<std::vector<FieldValue>> entry = it->lock();
+        if (entry == nullptr) {
+            it = bucket.erase(it);
+            continue;
+        }
+        if (result == nullptr && *entry == *values) {
+            result = entry;
+        }
+        it++;
+    }
+    if (result == nullptr) {
+        bucket.push_back(values);
+        result = values;
+    }
+    return result;
+}
+
+size_t DimensionKeyPool::size() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t count = 0;
+    for (const auto& [hash, bucket] : mPool) {
+        for (const auto& entry : bucket) {
+            if (!entry.expired()) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
 bool HashableDimensionKey::operator!=(const HashableDimensionKey& that) const {
     return !((*this) == that);
 }
 
 bool HashableDimensionKey::operator==(const HashableDimensionKey& that) const {
+    // Interned keys share storage, making equality a pointer compare.
+    if (mValues == that.mValues) {
+        return true;
+    }
+    // Cheap prefilter: keys probing a hash map have their hash memoized already, and keys
+    // with different hashes cannot be equal.
+    if (mHashValid && that.mHashValid && mHash != that.mHash) {
+        return false;
+    }
+    const uint64_t signature = getTypeSignature();
+    if (signature != that.getTypeSignature()) {
+        // Signatures encode arity and element types, both of which equal keys share.
+        return false;
+    }
+    if (const DimensionKeyOps* ops = selectDimensionKeyOps(signature)) {
+        return ops->equals(getValues(), that.getValues());
+    }
     // according to http://go/cppref/cpp/container/vector/operator_cmp
-    return mValues == that.mValues;
+    return getValues() == that.getValues();
 };
 
 bool HashableDimensionKey::operator<(const HashableDimensionKey& that) const {
+    const uint64_t signature = getTypeSignature();
+    if (signature == that.getTypeSignature()) {
+        if (const DimensionKeyOps* ops = selectDimensionKeyOps(signature)) {
+            return ops->less(getValues(), that.getValues());
+        }
+    }
     return LessThan(getValues(), that.getValues());
 };
 
 bool HashableDimensionKey::contains(const HashableDimensionKey& that) const {
-    if (mValues.size() < that.getValues().size()) {
+    const vector<FieldValue>& myValues = getValues();
+    if (myValues.size() < that.getValues().size()) {
         return false;
     }
 
-    if (mValues.size() == that.getValues().size()) {
+    if (myValues.size() == that.getValues().size()) {
         return (*this) == that;
     }
 
     for (const auto& value : that.getValues()) {
         bool found = false;
-        for (const auto& myValue : mValues) {
+        for (const auto& myValue : myValues) {
             if (value.mField == myValue.mField && value.mValue == myValue.mValue) {
                 found = true;
                 break;
@@ -372,7 +834,7 @@ bool HashableDimensionKey::contains(const HashableDimensionKey& that) const {
 
 string HashableDimensionKey::toString() const {
     std::string output;
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         output += StringPrintf("(%d)%#x->%s ", value.mField.getTag(), value.mField.getField(),
                                value.mValue.toString().c_str());
     }
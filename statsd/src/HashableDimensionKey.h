@@ -18,6 +18,11 @@
 
 #include <aidl/android/os/StatsDimensionsValueParcel.h>
 #include <utils/JenkinsHash.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "android-base/stringprintf.h"
 #include "FieldValue.h"
@@ -50,35 +55,102 @@ struct Metric2State {
     std::vector<Matcher> stateFields;
 };
 
+// Comparator/hasher bundle whose operations are compiled for one fixed dimension type
+// signature, so they run without the per-element runtime type switches of the generic
+// FieldValue operators. Bundles exist for the dominant key shapes (all-INT values up to
+// kMaxTypedDimensionOpsArity fields, e.g. uid or uid-plus-enum slicing); everything else
+// uses the generic path. Selected via selectDimensionKeyOps() from a key's memoized type
+// signature, so the selection cost is paid once per key rather than once per comparison.
+struct DimensionKeyOps {
+    bool (*equals)(const std::vector<FieldValue>& a, const std::vector<FieldValue>& b);
+    bool (*less)(const std::vector<FieldValue>& a, const std::vector<FieldValue>& b);
+    android::hash_t (*hash)(const std::vector<FieldValue>& values);
+};
+
+// Largest arity with a dedicated template instantiation.
+inline constexpr size_t kMaxTypedDimensionOpsArity = 4;
+
+// Largest key size a type signature can encode; bigger keys get kNoTypedSignature.
+inline constexpr size_t kMaxSignatureValues = 12;
+
+// Sentinel signature for keys too large to encode. Only assigned to keys with more than
+// kMaxSignatureValues values, so two keys with different signatures are never equal.
+inline constexpr uint64_t kNoTypedSignature = ~0ull;
+
+// Returns the bundle compiled for the given type signature, or nullptr when no
+// specialization exists for that shape.
+const DimensionKeyOps* selectDimensionKeyOps(uint64_t typeSignature);
+
 class HashableDimensionKey {
 public:
-    explicit HashableDimensionKey(const std::vector<FieldValue>& values) {
-        mValues = values;
+    explicit HashableDimensionKey(const std::vector<FieldValue>& values)
+        : mValues(std::make_shared<std::vector<FieldValue>>(values)) {
     }
 
     HashableDimensionKey() {};
 
-    HashableDimensionKey(const HashableDimensionKey& that) : mValues(that.getValues()){};
+    HashableDimensionKey(const HashableDimensionKey& that)
+        : mValues(that.mValues),
+          mHash(that.mHash),
+          mHashValid(that.mHashValid),
+          mTypeSignature(that.mTypeSignature),
+          mTypeSignatureValid(that.mTypeSignatureValid){};
+
+    HashableDimensionKey& operator=(const HashableDimensionKey& from) = default;
 
     inline void addValue(const FieldValue& value) {
-        mValues.push_back(value);
+        mHashValid = false;
+        mTypeSignatureValid = false;
+        detach();
+        mValues->push_back(value);
+    }
+
+    // Pre-sizes the backing storage. Key construction sites know how many values will match
+    // (one per dimension matcher in the common case), so reserving up front turns the growth
+    // reallocations of repeated addValue() calls into a single exact-size allocation.
+    inline void reserve(size_t size) {
+        detach();
+        mValues->reserve(size);
     }
 
     inline const std::vector<FieldValue>& getValues() const {
-        return mValues;
+        return mValues != nullptr ? *mValues : kEmptyValues;
     }
 
     inline std::vector<FieldValue>* mutableValues() {
-        return &mValues;
+        mHashValid = false;
+        mTypeSignatureValid = false;
+        detach();
+        return mValues.get();
     }
 
     inline FieldValue* mutableValue(size_t i) {
-        if (i >= 0 && i < mValues.size()) {
-            return &(mValues[i]);
+        if (mValues != nullptr && i < mValues->size()) {
+            mHashValid = false;
+            mTypeSignatureValid = false;
+            detach();
+            return &((*mValues)[i]);
         }
         return nullptr;
     }
 
+    // Replaces the backing storage with the canonical copy from the process-wide pool, so
+    // every container that later copies this key (sliced counters, duration tracker maps,
+    // anomaly past buckets) shares a single allocation per distinct key.
+    void intern();
+
+    // Returns the hash of all FieldValues, computing and memoizing it on first use. Keys are
+    // immutable once constructed in practice, so repeated map probes reuse the stored hash;
+    // the mutating accessors above invalidate it.
+    android::hash_t getHash() const;
+
+    // Returns the key's packed type signature: the value count in the top bits and one
+    // 4-bit ValueType code per value below, or kNoTypedSignature for keys with more than
+    // kMaxSignatureValues values. Memoized like the hash; feed it to
+    // selectDimensionKeyOps() to pick a typed comparator bundle. Two keys with different
+    // signatures are never equal.
+    uint64_t getTypeSignature() const;
+
     StatsDimensionsValueParcel toStatsDimensionsValueParcel() const;
 
     std::string toString() const;
@@ -92,7 +164,55 @@ public:
     bool contains(const HashableDimensionKey& that) const;
 
 private:
-    std::vector<FieldValue> mValues;
+    // Clones the backing storage if it is shared (or missing), preserving copy-on-write
+    // semantics: mutating one copy of a key never affects the others.
+    inline void detach() {
+        if (mValues == nullptr) {
+            mValues = std::make_shared<std::vector<FieldValue>>();
+        } else if (mValues.use_count() > 1) {
+            mValues = std::make_shared<std::vector<FieldValue>>(*mValues);
+        }
+    }
+
+    static const std::vector<FieldValue> kEmptyValues;
+
+    // Shared between copies of the same key until one of them is mutated. Null for an empty
+    // key (DEFAULT_DIMENSION_KEY and friends) to keep default construction allocation-free.
+    std::shared_ptr<std::vector<FieldValue>> mValues;
+
+    // Memoized hashDimension result; only meaningful while mHashValid is true. mutable so the
+    // hash can be computed lazily from const contexts (std::hash, operator==).
+    mutable android::hash_t mHash = 0;
+    mutable bool mHashValid = false;
+
+    // Memoized getTypeSignature() result; only meaningful while mTypeSignatureValid is
+    // true. Invalidated by the same mutating accessors as the hash.
+    mutable uint64_t mTypeSignature = 0;
+    mutable bool mTypeSignatureValid = false;
+};
+
+// Process-wide deduplication pool for dimension-key storage. The pool holds weak references:
+// an entry lives exactly as long as some HashableDimensionKey still uses it, so no explicit
+// eviction is needed. Guarded by an internal mutex since metric producers run under their own
+// per-config locks.
+class DimensionKeyPool {
+public:
+    static DimensionKeyPool& getInstance();
+
+    // Returns the canonical storage equal to *values, registering values as canonical if no
+    // equal entry exists. Expired entries encountered on the way are pruned.
+    std::shared_ptr<std::vector<FieldValue>> intern(
+            const std::shared_ptr<std::vector<FieldValue>>& values, android::hash_t hash);
+
+    // Number of live entries, for logging and tests.
+    size_t size() const;
+
+private:
+    DimensionKeyPool() = default;
+
+    mutable std::mutex mMutex;
+    std::unordered_map<android::hash_t, std::vector<std::weak_ptr<std::vector<FieldValue>>>>
+            mPool;
 };
 
 class MetricDimensionKey {
@@ -162,6 +282,140 @@ private:
     HashableDimensionKey mAtomFieldValues;
 };
 
+/**
+ * Replays a fixed matcher set against events by direct indexing instead of per-event mask
+ * matching.
+ *
+ * Atom schemas are fixed, so for top-level (depth 0) fields the layout of
+ * LogEvent::getValues() is the same for every event of a given atom, and the positions the
+ * matchers hit can be resolved once when the config is parsed instead of re-derived with mask
+ * arithmetic on every event. The plan records the matched value indices and rewritten field ids
+ * from the first event of each atom id, and verifies the cached layout with a flat field-id
+ * comparison before replaying; if the layout shifted, it falls back to the generic scan and
+ * rebuilds the plan. Matcher sets reaching into repeated or nested fields (attribution chains,
+ * FIRST/LAST/ALL positions) hit positions that genuinely vary per event, so they always take
+ * the generic scan.
+ */
+class FieldExtractionPlan {
+public:
+    FieldExtractionPlan() : mCacheable(false){};
+
+    explicit FieldExtractionPlan(const std::vector<Matcher>& matchers);
+
+    // Same output and return value as filterValues(matchers, values, output).
+    bool extract(const std::vector<FieldValue>& values, HashableDimensionKey* output);
+
+private:
+    struct Plan {
+        // Field ids of every value in the event the plan was built from, in order.
+        std::vector<int32_t> fieldLayout;
+        // (index into the event's values, position-rewritten field id) per matched value.
+        std::vector<std::pair<int32_t, int32_t>> entries;
+    };
+
+    bool replay(const Plan& plan, const std::vector<FieldValue>& values,
+                HashableDimensionKey* output) const;
+
+    void rebuild(Plan& plan, const std::vector<FieldValue>& values) const;
+
+    std::vector<Matcher> mMatchers;
+
+    // False when any matcher reaches below the top level of the atom.
+    bool mCacheable;
+
+    // Concrete extraction plans keyed by atom id.
+    std::unordered_map<int32_t, Plan> mPlans;
+};
+
+/**
+ * Resolves a fixed matcher set to direct indices into an event's FieldValue storage.
+ *
+ * Same caching strategy as FieldExtractionPlan: depth-0 matchers hit the same positions
+ * for every event of a given atom, so the indices are resolved once per atom id and only
+ * verified with a flat field-id comparison thereafter. Aggregation loops that read a
+ * value per matcher per event (value/KLL metrics folding pulled batches) then do direct
+ * loads instead of re-running mask matching on every access. Each matcher resolves to
+ * the first value it matches, mirroring the generic scan.
+ */
+class ValueIndexPlan {
+public:
+    ValueIndexPlan() : mCacheable(false){};
+
+    explicit ValueIndexPlan(const std::vector<Matcher>& matchers);
+
+    // Fills indices[i] with the position in [values] of the first value matched by
+    // matcher i, or -1 when it matched nothing. [indices] is resized to the matcher
+    // count.
+    void resolve(const std::vector<FieldValue>& values, std::vector<int32_t>& indices);
+
+private:
+    struct Plan {
+        // Field ids of every value in the event the plan was built from, in order.
+        std::vector<int32_t> fieldLayout;
+        // Matched value index per matcher, -1 for unmatched.
+        std::vector<int32_t> indices;
+    };
+
+    // The generic per-matcher scan, also used to (re)build a plan.
+    void scan(const std::vector<FieldValue>& values, std::vector<int32_t>& indices) const;
+
+    std::vector<Matcher> mMatchers;
+
+    // False when any matcher reaches below the top level of the atom.
+    bool mCacheable;
+
+    // Concrete index plans keyed by atom id.
+    std::unordered_map<int32_t, Plan> mPlans;
+};
+
+/**
+ * Caches the per-atom resolution of one Metric2Condition link.
+ *
+ * The link structure is fixed at config time, and depth-0 fields of a given atom sit
+ * at fixed positions, so both the matched value indices and the final (condition
+ * atom) field and tag each value is rewritten to can be computed once per atom id.
+ * Per-event resolution is then a flat layout check plus a fixed gather loop, with
+ * the same semantics as getDimensionForCondition. Falls back to the generic path
+ * when a link matcher reaches below the top level or an event's layout shifts.
+ */
+class ConditionLinkPlan {
+public:
+    ConditionLinkPlan() : mCacheable(false){};
+
+    explicit ConditionLinkPlan(const Metric2Condition& link);
+
+    // Fills [conditionDimension], which must be empty, from [eventValues]; same
+    // semantics as getDimensionForCondition(eventValues, link, conditionDimension).
+    void resolve(const std::vector<FieldValue>& eventValues,
+                 HashableDimensionKey* conditionDimension);
+
+private:
+    struct Entry {
+        // Position in the event's FieldValue vector.
+        int32_t sourceIndex;
+        // Field and tag the gathered value ends up with: the condition atom's when
+        // every link field matched, the metric atom's masked field otherwise.
+        int32_t field;
+        int32_t tag;
+    };
+
+    struct Plan {
+        // Field ids of every value in the event the plan was built from, in order.
+        std::vector<int32_t> fieldLayout;
+        std::vector<Entry> entries;
+    };
+
+    Metric2Condition mLink;
+
+    // False when any link matcher reaches below the top level of the atom.
+    bool mCacheable;
+
+    // Concrete gather plans keyed by atom id.
+    std::unordered_map<int32_t, Plan> mPlans;
+};
+
+// Computes the hash of the key's FieldValues from scratch. Most callers should prefer
+// HashableDimensionKey::getHash(), which memoizes the result.
 android::hash_t hashDimension(const HashableDimensionKey& key);
 
 /**
@@ -217,6 +471,29 @@ bool filterValues(const std::vector<Matcher>& dimKeyMatcherFields,
  * these 2 events should be mapped to the same dimension.  So we will remove the original position
  * from the dimension key for the uid field (by applying 0x80 bit mask).
  */
+/**
+ * Fused single-pass extraction of everything a metric needs from one event.
+ *
+ * Fills, in one scan over [values]:
+ *  - [dimensionKey] from [dimensionMatchers], with the same field rewriting as filterValues
+ *  - one condition dimension per entry of [conditionLinks], keyed by condition id, with the
+ *    same semantics as getDimensionForCondition
+ *  - one state primary key per entry of [stateLinks], keyed by state atom id, with the same
+ *    semantics as getDimensionForState
+ *
+ * The separate helpers each rescan the whole FieldValue vector, so metrics sliced by
+ * condition and state paid for one full walk per link; this walks the values once.
+ *
+ * [conditionDimensions] and [statePrimaryKeys] may be null when the corresponding link list
+ * is empty.
+ */
+void filterValuesFused(const std::vector<Matcher>& dimensionMatchers,
+                       const std::vector<Metric2Condition>& conditionLinks,
+                       const std::vector<Metric2State>& stateLinks,
+                       const std::vector<FieldValue>& values, HashableDimensionKey* dimensionKey,
+                       std::map<int64_t, HashableDimensionKey>* conditionDimensions,
+                       std::map<int32_t, HashableDimensionKey>* statePrimaryKeys);
+
 bool filterPrimaryKey(const std::vector<FieldValue>& values, HashableDimensionKey* output);
 
 /**
@@ -272,15 +549,15 @@ bool linked(const std::vector<Metric2State>& stateLinks, const int32_t stateAtom
 template <>
 struct std::hash<android::os::statsd::HashableDimensionKey> {
     std::size_t operator()(const android::os::statsd::HashableDimensionKey& key) const {
-        return hashDimension(key);
+        return key.getHash();
     }
 };
 
 template <>
 struct std::hash<android::os::statsd::MetricDimensionKey> {
     std::size_t operator()(const android::os::statsd::MetricDimensionKey& key) const {
-        android::hash_t hash = hashDimension(key.getDimensionKeyInWhat());
-        hash = android::JenkinsHashMix(hash, hashDimension(key.getStateValuesKey()));
+        android::hash_t hash = key.getDimensionKeyInWhat().getHash();
+        hash = android::JenkinsHashMix(hash, key.getStateValuesKey().getHash());
         return android::JenkinsHashWhiten(hash);
     }
 };
@@ -288,7 +565,7 @@ struct std::hash<android::os::statsd::MetricDimensionKey> {
 template <>
 struct std::hash<android::os::statsd::AtomDimensionKey> {
     std::size_t operator()(const android::os::statsd::AtomDimensionKey& key) const {
-        android::hash_t hash = hashDimension(key.getAtomFieldValues());
+        android::hash_t hash = key.getAtomFieldValues().getHash();
         hash = android::JenkinsHashMix(hash, key.getAtomTag());
         return android::JenkinsHashWhiten(hash);
     }
@@ -21,21 +21,31 @@
 
 #include <android-base/file.h>
 #include <cutils/multiuser.h>
+#include <malloc.h>
 #include <src/active_config_list.pb.h>
 #include <src/experiment_ids.pb.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include "StatsService.h"
 #include "android-base/stringprintf.h"
 #include "external/StatsPullerManager.h"
 #include "flags/FlagProvider.h"
 #include "guardrail/StatsdStats.h"
+#include "hash.h"
 #include "logd/LogEvent.h"
+#include "logd/LogEventPool.h"
 #include "metrics/CountMetricProducer.h"
 #include "state/StateManager.h"
 #include "stats_log_util.h"
 #include "stats_util.h"
 #include "statslog_statsd.h"
 #include "storage/StorageManager.h"
+#include "utils/MemoryAccounting.h"
+#include "utils/ProtoStreamPool.h"
+#include "utils/StatsTrace.h"
+#include "utils/WorkerPool.h"
 
 using namespace android;
 using android::base::StringPrintf;
@@ -89,6 +99,14 @@ constexpr const char* kPermissionUsage = "android.permission.PACKAGE_USAGE_STATS
 // Cool down period for writing data to disk to avoid overwriting files.
 #define WRITE_DATA_COOL_DOWN_SEC 15
 
+// Chunk size for streaming restricted metric query results. Kept well under the 1 MB binder
+// transaction limit, with headroom for the column metadata sent alongside every chunk.
+constexpr size_t kQueryChunkSizeBytes = 512 * 1024;
+
+// After this many records the metadata checkpoint journal is rewritten as a single
+// full snapshot, bounding both the on-disk size and the startup replay work.
+constexpr size_t kMetadataJournalCompactionThreshold = 8;
+
 StatsLogProcessor::StatsLogProcessor(
         const sp<UidMap>& uidMap, const sp<StatsPullerManager>& pullerManager,
         const sp<AlarmMonitor>& anomalyAlarmMonitor, const sp<AlarmMonitor>& periodicAlarmMonitor,
@@ -118,6 +136,8 @@ StatsLogProcessor::StatsLogProcessor(
 }
 
 StatsLogProcessor::~StatsLogProcessor() {
+    flushPendingDataWrites();
+    waitForPendingDbMaintenance();
 }
 
 static void flushProtoToBuffer(ProtoOutputStream& proto, vector<uint8_t>* outData) {
@@ -143,24 +163,51 @@ void StatsLogProcessor::processFiredAnomalyAlarmsLocked(
 void StatsLogProcessor::onPeriodicAlarmFired(
         const int64_t timestampNs,
         unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>>& alarmSet) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     for (const auto& itr : mMetricsManagers) {
         itr.second->onPeriodicAlarmFired(timestampNs, alarmSet);
     }
 }
 
+int32_t StatsLogProcessor::getHostUidOrSelfCached(const int32_t uid) const {
+    const uint64_t generation = mUidMap->getIsolatedUidMapGeneration();
+    if (generation != mIsolatedUidCacheGeneration) {
+        // Isolated uids changed; drop every cached translation.
+        mIsolatedUidCache.fill(IsolatedUidCacheSlot{});
+        mIsolatedUidCacheGeneration = generation;
+    }
+    IsolatedUidCacheSlot& slot =
+            mIsolatedUidCache[static_cast<uint32_t>(uid) % kIsolatedUidCacheSlots];
+    if (slot.uid == uid) {
+        return slot.hostUid;
+    }
+    const int32_t hostUid = mUidMap->getHostUidOrSelf(uid);
+    slot.uid = uid;
+    slot.hostUid = hostUid;
+    return hostUid;
+}
+
 void StatsLogProcessor::mapIsolatedUidToHostUidIfNecessaryLocked(LogEvent* event) const {
     if (std::pair<size_t, size_t> indexRange; event->hasAttributionChain(&indexRange)) {
         vector<FieldValue>* const fieldValues = event->getMutableValues();
         for (size_t i = indexRange.first; i <= indexRange.second; i++) {
             FieldValue& fieldValue = fieldValues->at(i);
             if (isAttributionUidField(fieldValue)) {
-                const int hostUid = mUidMap->getHostUidOrSelf(fieldValue.mValue.int_value);
-                fieldValue.mValue.setInt(hostUid);
+                fieldValue.mValue.setInt(getHostUidOrSelfCached(fieldValue.mValue.int_value));
             }
         }
     } else {
-        mapIsolatedUidsToHostUidInLogEvent(mUidMap, *event);
+        // Same walk as mapIsolatedUidsToHostUidInLogEvent, but through the ingestion
+        // cache instead of one UidMap snapshot lookup per uid field.
+        uint8_t remainingUidCount = event->getNumUidFields();
+        vector<FieldValue>* const fieldValues = event->getMutableValues();
+        for (auto it = fieldValues->begin();
+             it != fieldValues->end() && remainingUidCount > 0; ++it) {
+            if (isUidField(*it)) {
+                it->mValue.setInt(getHostUidOrSelfCached(it->mValue.int_value));
+                remainingUidCount--;
+            }
+        }
     }
 }
 
@@ -375,7 +422,7 @@ vector<int64_t> StatsLogProcessor::processWatchdogRollbackOccurred(const int32_t
 }
 
 void StatsLogProcessor::resetConfigs() {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     resetConfigsLocked(getElapsedRealtimeNs());
 }
 
@@ -392,7 +439,25 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event) {
 }
 
 void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::mutex> ingestionLock(mEventIngestionMutex);
+    OnLogEventIngestionLocked(event, elapsedRealtimeNs);
+}
+
+void StatsLogProcessor::OnLogEvents(const std::vector<std::unique_ptr<LogEvent>>& events) {
+    // One ingestion-lock acquisition and one clock read for the whole batch.
+    const int64_t elapsedRealtimeNs = getElapsedRealtimeNs();
+    std::lock_guard<std::mutex> ingestionLock(mEventIngestionMutex);
+    for (const auto& event : events) {
+        OnLogEventIngestionLocked(event.get(), elapsedRealtimeNs);
+    }
+}
+
+void StatsLogProcessor::OnLogEventIngestionLocked(LogEvent* event, int64_t elapsedRealtimeNs) {
+    mLastEventProcessedNs.store(elapsedRealtimeNs, std::memory_order_relaxed);
+    // Materialize FieldValues for events parsed lazily on the ingestion path.
+    if (event->hasDeferredBody()) {
+        event->parseDeferredBody();
+    }
 
     // Tell StatsdStats about new event
     const int64_t eventElapsedTimeNs = event->GetElapsedTimestampNs();
@@ -405,7 +470,8 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
     }
 
     // Hard-coded logic to update train info on disk and fill in any information
-    // this log event may be missing.
+    // this log event may be missing. Serialized by mEventIngestionMutex and touching
+    // only its own disk state, so it runs before any metrics lock is taken.
     if (atomId == util::BINARY_PUSH_STATE_CHANGED) {
         onBinaryPushStateChangedEventLocked(event);
     }
@@ -416,23 +482,38 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
         onWatchdogRollbackOccurredLocked(event);
     }
 
-    if (mPrintAllLogs) {
+    bool printLog = false;
+    bool ttlExpired = false;
+    bool metricsEmpty = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(mMetricsMutex);
+        printLog = mPrintAllLogs;
+        ttlExpired = anyConfigTtlExpiredLocked(eventElapsedTimeNs);
+        metricsEmpty = mMetricsManagers.empty();
+    }
+    if (printLog) {
         ALOGI("%s", event->ToString().c_str());
     }
-    resetIfConfigTtlExpiredLocked(eventElapsedTimeNs);
+    if (ttlExpired) {
+        // Resetting a config tears the manager down and rebuilds it, so it needs the
+        // brief global phase.
+        std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
+        resetIfConfigTtlExpiredLocked(eventElapsedTimeNs);
+    }
 
     // Hard-coded logic to update the isolated uid's in the uid-map.
     // The field numbers need to be currently updated by hand with atoms.proto
     if (atomId == util::ISOLATED_UID_CHANGED) {
         onIsolatedUidChangedEventLocked(*event);
     } else {
-        // Map the isolated uid to host uid if necessary.
+        // Map the isolated uid to host uid if necessary, through the ingestion-side
+        // translation cache.
         mapIsolatedUidToHostUidIfNecessaryLocked(event);
     }
 
     StateManager::getInstance().onLogEvent(*event);
 
-    if (mMetricsManagers.empty()) {
+    if (metricsEmpty) {
         return;
     }
 
@@ -447,6 +528,9 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
         }
     }
     if (fireAlarm) {
+        // Fired anomaly alarms mutate trackers across configs; run them in the
+        // global phase.
+        std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
         informAnomalyAlarmFiredLocked(NanoToMillis(elapsedRealtimeNs));
     }
 
@@ -456,45 +540,72 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
         mLastPullerCacheClearTimeSec = curTimeSec;
     }
 
-    flushRestrictedDataIfNecessaryLocked(elapsedRealtimeNs);
-    enforceDataTtlsIfNecessaryLocked(getWallClockNs(), elapsedRealtimeNs);
-    enforceDbGuardrailsIfNecessaryLocked(getWallClockNs(), elapsedRealtimeNs);
+    runPeriodicTasksIfNecessary(getWallClockNs(), elapsedRealtimeNs);
+
+    // Apply any app upgrades whose coalescing window has closed before this
+    // event reaches the metrics, so its bucket attribution sees the splits.
+    flushPendingAppUpgradesIfDue(elapsedRealtimeNs);
 
     if (!validateAppBreadcrumbEvent(*event)) {
         return;
     }
 
     std::unordered_set<int> uidsWithActiveConfigsChanged;
-    std::unordered_map<int, std::vector<int64_t>> activeConfigsPerUid;
 
-    // pass the event to metrics managers.
-    for (auto& pair : mMetricsManagers) {
-        if (event->isRestricted() && !pair.second->hasRestrictedMetricsDelegate()) {
-            continue;
-        }
-        int uid = pair.first.GetUid();
-        int64_t configId = pair.first.GetId();
-        bool isPrevActive = pair.second->isActive();
-        pair.second->onLogEvent(*event);
-        bool isCurActive = pair.second->isActive();
-        // Map all active configs by uid.
-        if (isCurActive) {
-            auto activeConfigs = activeConfigsPerUid.find(uid);
-            if (activeConfigs != activeConfigsPerUid.end()) {
-                activeConfigs->second.push_back(configId);
-            } else {
-                vector<int64_t> newActiveConfigs;
-                newActiveConfigs.push_back(configId);
-                activeConfigsPerUid[uid] = newActiveConfigs;
-            }
+    // pass the event to metrics managers, holding each config's shard only while that
+    // manager consumes the event so dumps of other configs proceed concurrently.
+    std::shared_lock<std::shared_mutex> lock(mMetricsMutex);
+
+    // Shard lock held by the caller.
+    const auto consumeEvent = [&](const ConfigKey& key, MetricsManager& metricsManager) {
+        bool isPrevActive = metricsManager.isActive();
+        {
+            STATSD_TRACE_SCOPE_ID("MetricsManager::onLogEvent", key.GetId());
+            ScopedMemoryTag memoryTag(MemoryAccounting::kMetrics);
+            const int64_t onLogEventStartNs = getElapsedRealtimeNs();
+            metricsManager.onLogEvent(*event);
+            StatsdStats::getInstance().noteOnLogEventLatency(getElapsedRealtimeNs() -
+                                                             onLogEventStartNs);
         }
+        bool isCurActive = metricsManager.isActive();
         // The activation state of this config changed.
         if (isPrevActive != isCurActive) {
-            VLOG("Active status changed for uid  %d", uid);
-            uidsWithActiveConfigsChanged.insert(uid);
-            StatsdStats::getInstance().noteActiveStatusChanged(pair.first, isCurActive);
+            VLOG("Active status changed for uid  %d", key.GetUid());
+            uidsWithActiveConfigsChanged.insert(key.GetUid());
+            StatsdStats::getInstance().noteActiveStatusChanged(key, isCurActive);
+        }
+        flushIfNecessaryLocked(key, metricsManager);
+    };
+
+    // Route the event through the atom interest index so the fan-out touches only
+    // managers with a matcher for this tag id; every other manager would drop the
+    // event at its own 1st filter anyway.
+    const auto routeIt = mAtomInterestIndex.find(atomId);
+    if (routeIt != mAtomInterestIndex.end()) {
+        for (const auto& [key, metricsManager] : routeIt->second) {
+            if (event->isRestricted() && !metricsManager->hasRestrictedMetricsDelegate()) {
+                continue;
+            }
+            std::lock_guard<std::mutex> shardLock(configShardFor(key));
+            consumeEvent(key, *metricsManager);
         }
-        flushIfNecessaryLocked(pair.first, *(pair.second));
+    }
+
+    // Managers whose config gates metrics behind activations still need to observe
+    // every event's timestamp while an activation is live, so it expires (and the
+    // activation broadcast below fires) on time.
+    for (const auto& [key, metricsManager] : mManagersWithActivations) {
+        if (metricsManager->interestedInAtom(atomId)) {
+            continue;  // already handled by the routed pass above
+        }
+        if (event->isRestricted() && !metricsManager->hasRestrictedMetricsDelegate()) {
+            continue;
+        }
+        std::lock_guard<std::mutex> shardLock(configShardFor(key));
+        if (!metricsManager->hasLiveActivations()) {
+            continue;
+        }
+        consumeEvent(key, *metricsManager);
     }
 
     // Don't use the event timestamp for the guardrail.
@@ -509,24 +620,21 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
                 return;
             }
         }
-        auto activeConfigs = activeConfigsPerUid.find(uid);
-        if (activeConfigs != activeConfigsPerUid.end()) {
-            if (mSendActivationBroadcast(uid, activeConfigs->second)) {
-                VLOG("StatsD sent activation notice for uid %d", uid);
-                mLastActivationBroadcastTimes[uid] = elapsedRealtimeNs;
-            }
-        } else {
-            std::vector<int64_t> emptyActiveConfigs;
-            if (mSendActivationBroadcast(uid, emptyActiveConfigs)) {
-                VLOG("StatsD sent EMPTY activation notice for uid %d", uid);
-                mLastActivationBroadcastTimes[uid] = elapsedRealtimeNs;
-            }
+        // Activation changes are rare, so the per-uid active list is computed
+        // here on demand instead of being accumulated during the fan-out (which
+        // no longer visits every manager).
+        std::vector<int64_t> activeConfigs;
+        GetActiveConfigsLocked(uid, activeConfigs);
+        if (mSendActivationBroadcast(uid, activeConfigs)) {
+            VLOG("StatsD sent activation notice with %d configs for uid %d",
+                 (int)activeConfigs.size(), uid);
+            mLastActivationBroadcastTimes[uid] = elapsedRealtimeNs;
         }
     }
 }
 
 void StatsLogProcessor::GetActiveConfigs(const int uid, vector<int64_t>& outActiveConfigs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     GetActiveConfigsLocked(uid, outActiveConfigs);
 }
 
@@ -542,7 +650,10 @@ void StatsLogProcessor::GetActiveConfigsLocked(const int uid, vector<int64_t>& o
 void StatsLogProcessor::OnConfigUpdated(const int64_t timestampNs, const int64_t wallClockNs,
                                         const ConfigKey& key, const StatsdConfig& config,
                                         bool modularUpdate) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    // A config push is one of the triggers at which cached server flag values may
+    // change, so re-read them before parsing the config against the flags.
+    FlagProvider::getInstance().refreshServerFlagCache();
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     WriteDataToDiskLocked(key, timestampNs, wallClockNs, CONFIG_UPDATED, NO_TIME_CONSTRAINTS);
     OnConfigUpdatedLocked(timestampNs, key, config, modularUpdate);
 }
@@ -552,9 +663,80 @@ void StatsLogProcessor::OnConfigUpdated(const int64_t timestampNs, const ConfigK
     OnConfigUpdated(timestampNs, getWallClockNs(), key, config, modularUpdate);
 }
 
+void StatsLogProcessor::OnConfigsLoadedFromDisk(const int64_t timestampNs,
+                                                const std::map<ConfigKey, StatsdConfig>& configs) {
+    if (configs.empty()) {
+        return;
+    }
+    std::vector<const std::pair<const ConfigKey, StatsdConfig>*> work;
+    work.reserve(configs.size());
+    for (const auto& entry : configs) {
+        work.push_back(&entry);
+    }
+    // Flattening a config into matchers, conditions and producers is CPU-bound and
+    // independent per config, so the managers are built outside mMetricsMutex on a pool
+    // of worker threads. Each manager is published as soon as it is ready, so the first
+    // configs start processing events without waiting for the rest.
+    std::atomic<size_t> nextWorkIndex(0);
+    auto worker = [&] {
+        ScopedMemoryTag memoryTag(MemoryAccounting::kMetrics);
+        for (size_t i = nextWorkIndex.fetch_add(1); i < work.size();
+             i = nextWorkIndex.fetch_add(1)) {
+            const ConfigKey& key = work[i]->first;
+            const StatsdConfig& config = work[i]->second;
+            sp<MetricsManager> manager =
+                    new MetricsManager(key, config, mTimeBaseNs, timestampNs, mUidMap,
+                                       mPullerManager, mAnomalyAlarmMonitor, mPeriodicAlarmMonitor);
+            const bool configValid = manager->isConfigValid();
+            if (configValid) {
+                manager->init();
+                manager->refreshTtl(timestampNs);
+            }
+            // Statsd just restarted, so no MetricsManager exists for the key yet and there
+            // is no in-memory data to persist; the rest mirrors OnConfigUpdatedLocked().
+            std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
+            if (!configValid) {
+                ALOGE("StatsdConfig NOT valid");
+                mUidMap->OnConfigRemoved(key);
+                continue;
+            }
+            if (manager->hasRestrictedMetricsDelegate()) {
+                mSendRestrictedMetricsBroadcast(key, manager->getRestrictedMetricsDelegate(),
+                                                manager->getAllMetricIds());
+                string err;
+                if (!dbutils::updateDeviceInfoTable(key, err)) {
+                    ALOGE("Failed to create device_info table for configKey %s, err: %s",
+                          key.ToString().c_str(), err.c_str());
+                    StatsdStats::getInstance().noteDeviceInfoTableCreationFailed(key);
+                }
+                // The uidmap is not stored in the sqlite db, so restricted configs do not
+                // need uid map changes tracked.
+                mUidMap->OnConfigRemoved(key);
+            } else {
+                mUidMap->OnConfigUpdated(key);
+            }
+            mMetricsManagers[key] = manager;
+            updateLogEventFilterLocked();
+        }
+    };
+    const size_t threadCount = std::min(
+            work.size(), static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::thread> pool;
+    pool.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        pool.emplace_back(worker);
+    }
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
+
 void StatsLogProcessor::OnConfigUpdatedLocked(const int64_t timestampNs, const ConfigKey& key,
                                               const StatsdConfig& config, bool modularUpdate) {
     VLOG("Updated configuration for key %s", key.ToString().c_str());
+    ScopedMemoryTag memoryTag(MemoryAccounting::kMetrics);
+    // Cached active-config bytes describe the outgoing manager's activation state.
+    mActiveConfigSegments.erase(key);
     const auto& it = mMetricsManagers.find(key);
     bool configValid = false;
     if (isAtLeastU() && it != mMetricsManagers.end()) {
@@ -634,17 +816,19 @@ void StatsLogProcessor::OnConfigUpdatedLocked(const int64_t timestampNs, const C
 }
 
 size_t StatsLogProcessor::GetMetricsSize(const ConfigKey& key) const {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::shared_lock<std::shared_mutex> lock(mMetricsMutex);
     auto it = mMetricsManagers.find(key);
     if (it == mMetricsManagers.end()) {
         ALOGW("Config source %s does not exist", key.ToString().c_str());
         return 0;
     }
+    std::lock_guard<std::mutex> shardLock(configShardFor(key));
     return it->second->byteSize();
 }
 
 void StatsLogProcessor::dumpStates(int out, bool verbose) const {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
+    MemoryAccounting::dump(out);
     dprintf(out, "MetricsManager count: %lu\n", (unsigned long)mMetricsManagers.size());
     for (const auto& metricsManager : mMetricsManagers) {
         metricsManager.second->dumpStates(out, verbose);
@@ -659,12 +843,27 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      const bool include_current_partial_bucket,
                                      const bool erase_data, const DumpReportReason dumpReportReason,
                                      const DumpLatency dumpLatency, ProtoOutputStream* proto) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    STATSD_TRACE_SCOPE_ID("StatsLogProcessor::onDumpReport", key.GetId());
+    ScopedMemoryTag memoryTag(MemoryAccounting::kReports);
+    const int64_t dumpStartNs = getElapsedRealtimeNs();
 
-    auto it = mMetricsManagers.find(key);
-    if (it != mMetricsManagers.end() && it->second->hasRestrictedMetricsDelegate()) {
-        VLOG("Unexpected call to StatsLogProcessor::onDumpReport for restricted metrics.");
-        return;
+    // Queued app-upgrade bucket splits must land before the report snapshot.
+    flushPendingAppUpgrades();
+
+    // Dumps serialize against each other here, so the disk-history phase below can run
+    // without mMetricsMutex and event ingestion only blocks for the in-memory phase.
+    std::lock_guard<std::mutex> dumpLock(mDumpReportMutex);
+
+    bool keepFile = false;
+    {
+        // Both flags are fixed at config creation, so the shared lock is enough.
+        std::shared_lock<std::shared_mutex> lock(mMetricsMutex);
+        auto it = mMetricsManagers.find(key);
+        if (it != mMetricsManagers.end() && it->second->hasRestrictedMetricsDelegate()) {
+            VLOG("Unexpected call to StatsLogProcessor::onDumpReport for restricted metrics.");
+            return;
+        }
+        keepFile = it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory();
     }
 
     // Start of ConfigKey.
@@ -674,44 +873,76 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
     proto->end(configKeyToken);
     // End of ConfigKey.
 
-    bool keepFile = false;
-    if (it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory()) {
-        keepFile = true;
-    }
+    // Reports handed to the background writer must be on disk before the directory
+    // scan below, or data queued by a recent config update would be lost.
+    flushPendingDataWrites();
 
     // Then, check stats-data directory to see there's any file containing
-    // ConfigMetricsReport from previous shutdowns to concatenate to reports.
+    // ConfigMetricsReport from previous shutdowns to concatenate to reports. These files
+    // are only touched under mDumpReportMutex (or with mMetricsMutex held on the shutdown
+    // write path), so the metrics lock is not needed for this I/O.
     StorageManager::appendConfigMetricsReport(
             key, proto, erase_data && !keepFile /* should remove file after appending it */,
             dumpReportReason == ADB_DUMP /*if caller is adb*/);
 
-    if (it != mMetricsManagers.end()) {
-        // This allows another broadcast to be sent within the rate-limit period if we get close to
-        // filling the buffer again soon.
-        mLastBroadcastTimes.erase(key);
-
-        vector<uint8_t> buffer;
-        onConfigMetricsReportLocked(key, dumpTimeStampNs, wallClockNs,
-                                    include_current_partial_bucket, erase_data, dumpReportReason,
-                                    dumpLatency, false /* is this data going to be saved on disk */,
-                                    &buffer);
-        proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
-                     reinterpret_cast<char*>(buffer.data()), buffer.size());
-    } else {
-        ALOGW("Config source %s does not exist", key.ToString().c_str());
-    }
+    int32_t reportNumber = 0;
+    {
+        // In-memory phase: shared lock plus this config's shard, so ingestion and
+        // dumps for other configs keep running while this report is assembled.
+        std::shared_lock<std::shared_mutex> lock(mMetricsMutex);
+        std::lock_guard<std::mutex> shardLock(configShardFor(key));
+        auto it = mMetricsManagers.find(key);
+        if (it != mMetricsManagers.end()) {
+            // This allows another broadcast to be sent within the rate-limit period if we get
+            // close to filling the buffer again soon.
+            {
+                std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+                mConfigBookkeeping[key].lastBroadcastTimeNs = 0;
+            }
 
-    if (erase_data) {
-        ++mDumpReportNumbers[key];
+            if (erase_data && keepFile) {
+                // The local-history file needs a contiguous copy of the report, so
+                // materialize it once and splice the bytes into the caller's stream.
+                vector<uint8_t> buffer;
+                onConfigMetricsReportLocked(key, dumpTimeStampNs, wallClockNs,
+                                            include_current_partial_bucket, erase_data,
+                                            dumpReportReason, dumpLatency,
+                                            false /* is this data going to be saved on disk */,
+                                            &buffer);
+                proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
+                             reinterpret_cast<char*>(buffer.data()), buffer.size());
+            } else {
+                // Stream the report straight into the caller's stream. This avoids
+                // both the temporary ConfigMetricsReport buffer and the nested-message
+                // byte copy, so peak memory is one serialized report instead of three.
+                uint64_t reportsToken =
+                        proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS);
+                onConfigMetricsReportLocked(key, dumpTimeStampNs, wallClockNs,
+                                            include_current_partial_bucket, erase_data,
+                                            dumpReportReason, dumpLatency,
+                                            false /* is this data going to be saved on disk */,
+                                            proto);
+                proto->end(reportsToken);
+            }
+        } else {
+            ALOGW("Config source %s does not exist", key.ToString().c_str());
+        }
+
+        std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+        ConfigBookkeeping& bookkeeping = mConfigBookkeeping[key];
+        if (erase_data) {
+            ++bookkeeping.dumpReportNumber;
+        }
+        reportNumber = bookkeeping.dumpReportNumber;
     }
-    proto->write(FIELD_TYPE_INT32 | FIELD_ID_REPORT_NUMBER, mDumpReportNumbers[key]);
+    proto->write(FIELD_TYPE_INT32 | FIELD_ID_REPORT_NUMBER, reportNumber);
 
     proto->write(FIELD_TYPE_INT32 | FIELD_ID_STATSD_STATS_ID,
                  StatsdStats::getInstance().getStatsdStatsId());
     if (erase_data) {
-        StatsdStats::getInstance().noteMetricsReportSent(key, proto->size(),
-                                                         mDumpReportNumbers[key]);
+        StatsdStats::getInstance().noteMetricsReportSent(key, proto->size(), reportNumber);
     }
+    StatsdStats::getInstance().noteDumpReportLatency(getElapsedRealtimeNs() - dumpStartNs);
 }
 
 /*
@@ -722,12 +953,12 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      const bool include_current_partial_bucket,
                                      const bool erase_data, const DumpReportReason dumpReportReason,
                                      const DumpLatency dumpLatency, vector<uint8_t>* outData) {
-    ProtoOutputStream proto;
+    PooledProtoStream proto = ProtoStreamPool::getInstance().borrow();
     onDumpReport(key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data,
-                 dumpReportReason, dumpLatency, &proto);
+                 dumpReportReason, dumpLatency, proto.get());
 
     if (outData != nullptr) {
-        flushProtoToBuffer(proto, outData);
+        flushProtoToBuffer(*proto, outData);
         VLOG("output data size %zu", outData->size());
     }
 }
@@ -745,13 +976,13 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
 }
 
 /*
- * onConfigMetricsReportLocked dumps serialized ConfigMetricsReport into outData.
+ * onConfigMetricsReportLocked streams one serialized ConfigMetricsReport into proto.
  */
 void StatsLogProcessor::onConfigMetricsReportLocked(
         const ConfigKey& key, const int64_t dumpTimeStampNs, const int64_t wallClockNs,
         const bool include_current_partial_bucket, const bool erase_data,
         const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
-        const bool dataSavedOnDisk, vector<uint8_t>* buffer) {
+        const bool dataSavedOnDisk, ProtoOutputStream* proto) {
     // We already checked whether key exists in mMetricsManagers in
     // WriteDataToDisk.
     auto it = mMetricsManagers.find(key);
@@ -769,50 +1000,76 @@ void StatsLogProcessor::onConfigMetricsReportLocked(
 
     std::set<string> str_set;
 
-    ProtoOutputStream tempProto;
     // First, fill in ConfigMetricsReport using current data on memory, which
     // starts from filling in StatsLogReport's.
     it->second->onDumpReport(dumpTimeStampNs, wallClockNs, include_current_partial_bucket,
-                             erase_data, dumpLatency, &str_set, &tempProto);
+                             erase_data, dumpLatency, &str_set, proto);
 
     // Fill in UidMap if there is at least one metric to report.
     // This skips the uid map if it's an empty config.
     if (it->second->getNumMetrics() > 0) {
-        uint64_t uidMapToken = tempProto.start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
+        uint64_t uidMapToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
         mUidMap->appendUidMap(dumpTimeStampNs, key, it->second->versionStringsInReport(),
                               it->second->installerInReport(),
                               it->second->packageCertificateHashSizeBytes(),
-                              it->second->hashStringInReport() ? &str_set : nullptr, &tempProto);
-        tempProto.end(uidMapToken);
+                              it->second->hashStringInReport() ? &str_set : nullptr, proto);
+        proto->end(uidMapToken);
     }
 
     // Fill in the timestamps.
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
-                    (long long)lastReportTimeNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
-                    (long long)dumpTimeStampNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
-                    (long long)lastReportWallClockNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
-                    (long long)wallClockNs);
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
+                 (long long)lastReportTimeNs);
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
+                 (long long)dumpTimeStampNs);
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
+                 (long long)lastReportWallClockNs);
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
+                 (long long)wallClockNs);
     // Dump report reason
-    tempProto.write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
+    proto->write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
 
+    // With a persistent string dictionary only the delta over earlier uploads
+    // is serialized; non-erasing dumps do not advance the dictionary.
+    if (it->second->persistStringDictionaryInReport()) {
+        it->second->filterReportedStrings(&str_set, /*commit=*/erase_data);
+    }
     for (const auto& str : str_set) {
-        tempProto.write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
+        proto->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
     }
 
     // Data corrupted reason
-    writeDataCorruptedReasons(tempProto);
+    writeDataCorruptedReasons(*proto);
+}
 
-    flushProtoToBuffer(tempProto, buffer);
+/*
+ * onConfigMetricsReportLocked dumps serialized ConfigMetricsReport into buffer.
+ */
+void StatsLogProcessor::onConfigMetricsReportLocked(
+        const ConfigKey& key, const int64_t dumpTimeStampNs, const int64_t wallClockNs,
+        const bool include_current_partial_bucket, const bool erase_data,
+        const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+        const bool dataSavedOnDisk, vector<uint8_t>* buffer) {
+    PooledProtoStream tempProto = ProtoStreamPool::getInstance().borrow();
+    onConfigMetricsReportLocked(key, dumpTimeStampNs, wallClockNs,
+                                include_current_partial_bucket, erase_data, dumpReportReason,
+                                dumpLatency, dataSavedOnDisk, tempProto.get());
+    flushProtoToBuffer(*tempProto, buffer);
+    if (buffer->empty()) {
+        // The config is unknown or restricted; nothing was serialized.
+        return;
+    }
 
     // save buffer to disk if needed
-    if (erase_data && !dataSavedOnDisk && it->second->shouldPersistLocalHistory()) {
+    auto it = mMetricsManagers.find(key);
+    if (erase_data && !dataSavedOnDisk && it != mMetricsManagers.end() &&
+        it->second->shouldPersistLocalHistory()) {
         VLOG("save history to disk");
         string file_name = StorageManager::getDataHistoryFileName((long)getWallClockSec(),
                                                                   key.GetUid(), key.GetId());
-        StorageManager::writeFile(file_name.c_str(), buffer->data(), buffer->size());
+        // History copies are debug data; losing one to a crash is acceptable,
+        // so skip the sync and let the kernel write it back lazily.
+        StorageManager::writeCompressedFile(file_name.c_str(), buffer->data(), buffer->size(),
+                                            StorageManager::WriteDurability::LAZY);
     }
 }
 
@@ -834,6 +1091,15 @@ void StatsLogProcessor::resetConfigsLocked(const int64_t timestampNs,
     }
 }
 
+bool StatsLogProcessor::anyConfigTtlExpiredLocked(const int64_t eventTimeNs) const {
+    for (const auto& pair : mMetricsManagers) {
+        if (pair.second != nullptr && !pair.second->isInTtl(eventTimeNs)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void StatsLogProcessor::resetIfConfigTtlExpiredLocked(const int64_t eventTimeNs) {
     std::vector<ConfigKey> configKeysTtlExpired;
     for (auto it = mMetricsManagers.begin(); it != mMetricsManagers.end(); it++) {
@@ -849,7 +1115,7 @@ void StatsLogProcessor::resetIfConfigTtlExpiredLocked(const int64_t eventTimeNs)
 }
 
 void StatsLogProcessor::OnConfigRemoved(const ConfigKey& key) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     auto it = mMetricsManagers.find(key);
     if (it != mMetricsManagers.end()) {
         WriteDataToDiskLocked(key, getElapsedRealtimeNs(), getWallClockNs(), CONFIG_REMOVED,
@@ -862,11 +1128,24 @@ void StatsLogProcessor::OnConfigRemoved(const ConfigKey& key) {
         mMetricsManagers.erase(it);
         mUidMap->OnConfigRemoved(key);
     }
+    mActiveConfigSegments.erase(key);
     StatsdStats::getInstance().noteConfigRemoved(key);
 
-    mLastBroadcastTimes.erase(key);
-    mLastByteSizeTimes.erase(key);
-    mDumpReportNumbers.erase(key);
+    {
+        std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+        const auto bookkeepingIt = mConfigBookkeeping.find(key);
+        if (bookkeepingIt != mConfigBookkeeping.end()) {
+            if (bookkeepingIt->second.hasOnDiskData) {
+                // A report may still be sitting on disk for this key; keep that fact
+                // and reset the rest of the bookkeeping.
+                ConfigBookkeeping fresh;
+                fresh.hasOnDiskData = true;
+                bookkeepingIt->second = fresh;
+            } else {
+                mConfigBookkeeping.erase(bookkeepingIt);
+            }
+        }
+    }
 
     int uid = key.GetUid();
     bool lastConfigForUid = true;
@@ -887,16 +1166,86 @@ void StatsLogProcessor::OnConfigRemoved(const ConfigKey& key) {
     updateLogEventFilterLocked();
 }
 
-// TODO(b/267501143): Add unit tests when metric producer is ready
-void StatsLogProcessor::enforceDataTtlsIfNecessaryLocked(const int64_t wallClockNs,
-                                                         const int64_t elapsedRealtimeNs) {
-    if (!isAtLeastU()) {
+void StatsLogProcessor::runPeriodicTasksIfNecessary(const int64_t wallClockNs,
+                                                    const int64_t elapsedRealtimeNs) {
+    // The gate fields only ever advance, and only under the exclusive lock, so a
+    // stale unlocked read at worst defers the work to the next event. This keeps
+    // the common case free of the exclusive lock.
+    const bool restrictedDue =
+            isAtLeastU() &&
+            (elapsedRealtimeNs - mLastFlushRestrictedTime >=
+                     StatsdStats::kMinFlushRestrictedPeriodNs ||
+             elapsedRealtimeNs - mLastTtlTime >= StatsdStats::kMinTtlCheckPeriodNs);
+    const bool guardrailDue = elapsedRealtimeNs - mLastDbGuardrailEnforcementTime >=
+                              StatsdStats::kMinDbGuardrailEnforcementPeriodNs;
+    if (!restrictedDue && !guardrailDue) {
         return;
     }
-    if (elapsedRealtimeNs - mLastTtlTime < StatsdStats::kMinTtlCheckPeriodNs) {
+
+    // The ttl and guardrail sweeps issue sqlite deletes and scan the restricted-data
+    // dir; run them on the WorkerPool so that I/O never blocks ingestion. The
+    // exclusive section below only flushes staged events, snapshots the restricted
+    // managers and advances the gate fields, so a sweep is claimed by exactly one
+    // event thread.
+    vector<sp<MetricsManager>> ttlManagers;
+    bool enforceGuardrails = false;
+    {
+        std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
+        flushRestrictedDataIfNecessaryLocked(elapsedRealtimeNs);
+        if (isAtLeastU() &&
+            elapsedRealtimeNs - mLastTtlTime >= StatsdStats::kMinTtlCheckPeriodNs) {
+            for (const auto& itr : mMetricsManagers) {
+                if (itr.second->hasRestrictedMetricsDelegate()) {
+                    ttlManagers.push_back(itr.second);
+                }
+            }
+            mLastTtlTime = elapsedRealtimeNs;
+        }
+        if (elapsedRealtimeNs - mLastDbGuardrailEnforcementTime >=
+            StatsdStats::kMinDbGuardrailEnforcementPeriodNs) {
+            enforceGuardrails = true;
+            mLastDbGuardrailEnforcementTime = elapsedRealtimeNs;
+        }
+    }
+    if (ttlManagers.empty() && !enforceGuardrails) {
         return;
     }
-    enforceDataTtlsLocked(wallClockNs, elapsedRealtimeNs);
+
+    {
+        std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+        mPendingDbMaintenanceCount++;
+    }
+    // The task only touches the maintenance bookkeeping at the end, and
+    // ~StatsLogProcessor drains pending maintenance, so the captured this stays valid.
+    WorkerPool::getInstance().enqueue([this, ttlManagers = std::move(ttlManagers),
+                                       enforceGuardrails, wallClockNs] {
+        for (const sp<MetricsManager>& metricsManager : ttlManagers) {
+            // The shared lock lets ingestion proceed while excluding config updates,
+            // which mutate the producer list this walks. Re-check membership under it:
+            // enforcing ttls on a removed config would recreate the db file its
+            // removal just deleted.
+            std::shared_lock<std::shared_mutex> lock(mMetricsMutex);
+            const auto it = mMetricsManagers.find(metricsManager->getConfigKey());
+            if (it == mMetricsManagers.end() || it->second != metricsManager) {
+                continue;
+            }
+            metricsManager->enforceRestrictedDataTtls(wallClockNs);
+        }
+        if (enforceGuardrails) {
+            StorageManager::enforceDbGuardrails(STATS_RESTRICTED_DATA_DIR, wallClockNs / NS_PER_SEC,
+                                                StatsdStats::kMaxFileSize);
+        }
+        std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+        mPendingDbMaintenanceCount--;
+        if (mPendingDbMaintenanceCount == 0) {
+            mPendingDbMaintenanceDoneCV.notify_all();
+        }
+    });
+}
+
+void StatsLogProcessor::waitForPendingDbMaintenance() {
+    std::unique_lock<std::mutex> lock(mPendingWritesMutex);
+    mPendingDbMaintenanceDoneCV.wait(lock, [this] { return mPendingDbMaintenanceCount == 0; });
 }
 
 void StatsLogProcessor::flushRestrictedDataIfNecessaryLocked(const int64_t elapsedRealtimeNs) {
@@ -914,7 +1263,7 @@ void StatsLogProcessor::querySql(const string& sqlQuery, const int32_t minSqlCli
                                  const shared_ptr<IStatsQueryCallback>& callback,
                                  const int64_t configId, const string& configPackage,
                                  const int32_t callingUid) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     string err = "";
 
     if (!isAtLeastU()) {
@@ -971,38 +1320,36 @@ void StatsLogProcessor::querySql(const string& sqlQuery, const int32_t minSqlCli
     flushRestrictedDataLocked(elapsedRealtimeNs);
     enforceDataTtlsLocked(getWallClockNs(), elapsedRealtimeNs);
 
-    std::vector<std::vector<std::string>> rows;
+    // Stream rows out of sqlite in size-capped chunks so peak memory stays bounded regardless
+    // of the result size. Results that fit in a single chunk keep going through sendResults;
+    // larger ones are delivered incrementally through sendResultChunk.
     std::vector<int32_t> columnTypes;
     std::vector<string> columnNames;
-    if (!dbutils::query(*(keysToQuery.begin()), sqlQuery, rows, columnTypes, columnNames, err)) {
-        callback->sendFailure(StringPrintf("failed to query db %s:", err.c_str()));
+    bool firstChunk = true;
+    bool callbackFailed = false;
+    const dbutils::QueryChunkHandler chunkHandler = [&](vector<string>& queryData,
+                                                        const int32_t rowCount,
+                                                        const bool isLastChunk) {
+        const auto status =
+                firstChunk && isLastChunk
+                        ? callback->sendResults(queryData, columnNames, columnTypes, rowCount)
+                        : callback->sendResultChunk(queryData, columnNames, columnTypes, rowCount,
+                                                    isLastChunk);
+        firstChunk = false;
+        callbackFailed = !status.isOk();
+        return !callbackFailed;
+    };
+    if (!dbutils::queryStreamed(*(keysToQuery.begin()), sqlQuery, kQueryChunkSizeBytes,
+                                chunkHandler, columnTypes, columnNames, err)) {
+        if (!callbackFailed) {
+            callback->sendFailure(StringPrintf("failed to query db %s:", err.c_str()));
+        }
         StatsdStats::getInstance().noteQueryRestrictedMetricFailed(
                 configId, configPackage, keysToQuery.begin()->GetUid(), callingUid,
                 InvalidQueryReason(QUERY_FAILURE), err.c_str());
         return;
     }
 
-    vector<string> queryData;
-    queryData.reserve(rows.size() * columnNames.size());
-    // TODO(b/268415904): avoid this vector transformation.
-    if (columnNames.size() != columnTypes.size()) {
-        callback->sendFailure("Inconsistent row sizes");
-        StatsdStats::getInstance().noteQueryRestrictedMetricFailed(
-                configId, configPackage, keysToQuery.begin()->GetUid(), callingUid,
-                InvalidQueryReason(INCONSISTENT_ROW_SIZE));
-    }
-    for (size_t i = 0; i < rows.size(); ++i) {
-        if (rows[i].size() != columnNames.size()) {
-            callback->sendFailure("Inconsistent row sizes");
-            StatsdStats::getInstance().noteQueryRestrictedMetricFailed(
-                    configId, configPackage, keysToQuery.begin()->GetUid(), callingUid,
-                    InvalidQueryReason(INCONSISTENT_ROW_SIZE));
-            return;
-        }
-        queryData.insert(std::end(queryData), std::make_move_iterator(std::begin(rows[i])),
-                         std::make_move_iterator(std::end(rows[i])));
-    }
-    callback->sendResults(queryData, columnNames, columnTypes, rows.size());
     StatsdStats::getInstance().noteQueryRestrictedMetricSucceed(
             configId, configPackage, keysToQuery.begin()->GetUid(), callingUid,
             /*queryLatencyNs=*/getElapsedRealtimeNs() - elapsedRealtimeNs);
@@ -1046,7 +1393,7 @@ void StatsLogProcessor::EnforceDataTtls(const int64_t wallClockNs,
     if (!isAtLeastU()) {
         return;
     }
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     enforceDataTtlsLocked(wallClockNs, elapsedRealtimeNs);
 }
 
@@ -1071,7 +1418,7 @@ void StatsLogProcessor::enforceDbGuardrailsIfNecessaryLocked(const int64_t wallC
 
 void StatsLogProcessor::fillRestrictedMetrics(const int64_t configId, const string& configPackage,
                                               const int32_t delegateUid, vector<int64_t>* output) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
 
     set<int32_t> configPackageUids;
     const auto& uidMapItr = UidMap::sAidToUidMapping.find(configPackage);
@@ -1103,9 +1450,13 @@ void StatsLogProcessor::flushRestrictedDataLocked(const int64_t elapsedRealtimeN
 void StatsLogProcessor::flushIfNecessaryLocked(const ConfigKey& key,
                                                MetricsManager& metricsManager) {
     int64_t elapsedRealtimeNs = getElapsedRealtimeNs();
-    auto lastCheckTime = mLastByteSizeTimes.find(key);
-    if (lastCheckTime != mLastByteSizeTimes.end()) {
-        if (elapsedRealtimeNs - lastCheckTime->second < StatsdStats::kMinByteSizeCheckPeriodNs) {
+    {
+        std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+        const auto bookkeepingIt = mConfigBookkeeping.find(key);
+        if (bookkeepingIt != mConfigBookkeeping.end() &&
+            bookkeepingIt->second.lastByteSizeCheckTimeNs != 0 &&
+            elapsedRealtimeNs - bookkeepingIt->second.lastByteSizeCheckTimeNs <
+                    StatsdStats::kMinByteSizeCheckPeriodNs) {
             return;
         }
     }
@@ -1113,7 +1464,6 @@ void StatsLogProcessor::flushIfNecessaryLocked(const ConfigKey& key,
     // We suspect that the byteSize() computation is expensive, so we set a rate limit.
     size_t totalBytes = metricsManager.byteSize();
 
-    mLastByteSizeTimes[key] = elapsedRealtimeNs;
     const size_t kBytesPerConfig = metricsManager.hasRestrictedMetricsDelegate()
                                            ? StatsdStats::kBytesPerRestrictedConfigTriggerFlush
                                            : metricsManager.getTriggerGetDataBytes();
@@ -1123,12 +1473,18 @@ void StatsLogProcessor::flushIfNecessaryLocked(const ConfigKey& key,
         metricsManager.dropData(elapsedRealtimeNs);
         StatsdStats::getInstance().noteDataDropped(key, totalBytes);
         VLOG("StatsD had to toss out metrics for %s", key.ToString().c_str());
-    } else if ((totalBytes > kBytesPerConfig) ||
-               (mOnDiskDataConfigs.find(key) != mOnDiskDataConfigs.end())) {
-        // Request to dump if:
-        // 1. in memory data > threshold   OR
-        // 2. config has old data report on disk.
-        requestDump = true;
+    }
+    {
+        std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+        ConfigBookkeeping& bookkeeping = mConfigBookkeeping[key];
+        bookkeeping.lastByteSizeCheckTimeNs = elapsedRealtimeNs;
+        if (totalBytes <= metricsManager.getMaxMetricsBytes() &&
+            ((totalBytes > kBytesPerConfig) || bookkeeping.hasOnDiskData)) {
+            // Request to dump if:
+            // 1. in memory data > threshold   OR
+            // 2. config has old data report on disk.
+            requestDump = true;
+        }
     }
 
     if (requestDump) {
@@ -1137,19 +1493,24 @@ void StatsLogProcessor::flushIfNecessaryLocked(const ConfigKey& key,
             // No need to send broadcast for restricted metrics.
             return;
         }
-        // Send broadcast so that receivers can pull data.
-        auto lastBroadcastTime = mLastBroadcastTimes.find(key);
-        if (lastBroadcastTime != mLastBroadcastTimes.end()) {
-            if (elapsedRealtimeNs - lastBroadcastTime->second <
-                    StatsdStats::kMinBroadcastPeriodNs) {
+        {
+            std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+            // Send broadcast so that receivers can pull data.
+            const auto bookkeepingIt = mConfigBookkeeping.find(key);
+            if (bookkeepingIt != mConfigBookkeeping.end() &&
+                bookkeepingIt->second.lastBroadcastTimeNs != 0 &&
+                elapsedRealtimeNs - bookkeepingIt->second.lastBroadcastTimeNs <
+                        StatsdStats::kMinBroadcastPeriodNs) {
                 VLOG("StatsD would've sent a broadcast but the rate limit stopped us.");
                 return;
             }
         }
         if (mSendBroadcast(key)) {
-            mOnDiskDataConfigs.erase(key);
+            std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+            ConfigBookkeeping& bookkeeping = mConfigBookkeeping[key];
+            bookkeeping.hasOnDiskData = false;
             VLOG("StatsD triggered data fetch for %s", key.ToString().c_str());
-            mLastBroadcastTimes[key] = elapsedRealtimeNs;
+            bookkeeping.lastBroadcastTimeNs = elapsedRealtimeNs;
             StatsdStats::getInstance().noteBroadcastSent(key);
         }
     }
@@ -1159,6 +1520,7 @@ void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key, const int64_
                                               const int64_t wallClockNs,
                                               const DumpReportReason dumpReportReason,
                                               const DumpLatency dumpLatency) {
+    STATSD_TRACE_SCOPE_ID("StatsLogProcessor::WriteDataToDisk", key.GetId());
     if (mMetricsManagers.find(key) == mMetricsManagers.end() ||
         !mMetricsManagers.find(key)->second->shouldWriteToDisk()) {
         return;
@@ -1173,14 +1535,51 @@ void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key, const int64_
                                 dumpReportReason, dumpLatency, true, &buffer);
     string file_name =
             StorageManager::getDataFileName((long)getWallClockSec(), key.GetUid(), key.GetId());
-    StorageManager::writeFile(file_name.c_str(), buffer.data(), buffer.size());
+    if (dumpLatency == FAST) {
+        // Shutdown-adjacent callers: the file must be on disk before the dump
+        // finishes. FAST dumps write one report per config, so skip the
+        // per-file sync here and let the all-configs caller group-commit the
+        // whole batch with a single directory sync.
+        StorageManager::writeCompressedFile(file_name.c_str(), buffer.data(), buffer.size(),
+                                            StorageManager::WriteDurability::BATCHED);
+    } else {
+        // Config updates, resets and adb-triggered saves can tolerate the write
+        // landing a moment later; keep only the serialization under mMetricsMutex.
+        enqueueDataWrite(std::move(file_name), std::move(buffer));
+    }
 
     // We were able to write the ConfigMetricsReport to disk, so we should trigger collection ASAP.
-    mOnDiskDataConfigs.insert(key);
+    std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+    mConfigBookkeeping[key].hasOnDiskData = true;
+}
+
+void StatsLogProcessor::enqueueDataWrite(string fileName, vector<uint8_t> buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+        mPendingWriteCount++;
+    }
+    // The task only touches the pending-write bookkeeping after the file write, and
+    // ~StatsLogProcessor flushes pending writes, so the captured this stays valid.
+    WorkerPool::getInstance().enqueue(
+            [this, fileName = std::move(fileName), buffer = std::move(buffer)] {
+                StorageManager::writeCompressedFile(fileName.c_str(), buffer.data(), buffer.size());
+                std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+                mPendingWriteCount--;
+                if (mPendingWriteCount == 0) {
+                    mPendingWritesDoneCV.notify_all();
+                }
+            });
+}
+
+void StatsLogProcessor::flushPendingDataWrites() {
+    // Writes enqueued after this call may still be in flight, which is fine: callers
+    // only need the ones they observed being queued.
+    std::unique_lock<std::mutex> lock(mPendingWritesMutex);
+    mPendingWritesDoneCV.wait(lock, [this] { return mPendingWriteCount == 0; });
 }
 
 void StatsLogProcessor::SaveActiveConfigsToDisk(int64_t currentTimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     const int64_t timeNs = getElapsedRealtimeNs();
     // Do not write to disk if we already have in the last few seconds.
     if (static_cast<unsigned long long> (timeNs) <
@@ -1207,7 +1606,7 @@ void StatsLogProcessor::SaveActiveConfigsToDisk(int64_t currentTimeNs) {
 
 void StatsLogProcessor::SaveMetadataToDisk(int64_t currentWallClockTimeNs,
                                            int64_t systemElapsedTimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     // Do not write to disk if we already have in the last few seconds.
     if (static_cast<unsigned long long> (systemElapsedTimeNs) <
             mLastMetadataWriteNs + WRITE_DATA_COOL_DOWN_SEC * NS_PER_SEC) {
@@ -1217,27 +1616,64 @@ void StatsLogProcessor::SaveMetadataToDisk(int64_t currentWallClockTimeNs,
     }
     mLastMetadataWriteNs = systemElapsedTimeNs;
 
-    metadata::StatsMetadataList metadataList;
-    WriteMetadataToProtoLocked(
-            currentWallClockTimeNs, systemElapsedTimeNs, &metadataList);
-
-    string file_name = StringPrintf("%s/metadata", STATS_METADATA_DIR);
-    StorageManager::deleteFile(file_name.c_str());
+    // Serialize each config's metadata separately so unchanged configs can be
+    // skipped: only entries whose bytes differ from the last checkpoint are
+    // appended to the journal.
+    metadata::StatsMetadataList dirtyList;
+    std::unordered_map<ConfigKey, uint64_t> currentHashes;
+    for (const auto& pair : mMetricsManagers) {
+        metadata::StatsMetadata statsMetadata;
+        if (!pair.second->writeMetadataToProto(currentWallClockTimeNs, systemElapsedTimeNs,
+                                               &statsMetadata)) {
+            continue;
+        }
+        std::string bytes;
+        statsMetadata.SerializeToString(&bytes);
+        const uint64_t hash = Hash64Fast(bytes);
+        currentHashes[pair.first] = hash;
+        const auto lastIt = mMetadataCheckpointHashes.find(pair.first);
+        if (lastIt != mMetadataCheckpointHashes.end() && lastIt->second == hash) {
+            // Unchanged since the last checkpoint.
+            continue;
+        }
+        *dirtyList.add_stats_metadata() = std::move(statsMetadata);
+    }
+    mMetadataCheckpointHashes = std::move(currentHashes);
 
-    if (metadataList.stats_metadata_size() == 0) {
-        // Skip the write if we have nothing to write.
+    if (dirtyList.stats_metadata_size() == 0) {
+        // Skip the write if nothing changed since the last checkpoint.
         return;
     }
 
-    std::string data;
-    metadataList.SerializeToString(&data);
-    StorageManager::writeFile(file_name.c_str(), data.c_str(), data.size());
+    const string journalName = StringPrintf("%s/metadata_journal", STATS_METADATA_DIR);
+    std::string record;
+    if (mMetadataJournalRecords >= kMetadataJournalCompactionThreshold) {
+        // Compact: replace the accumulated journal with one record holding every
+        // config's metadata, so startup never replays an unbounded tail.
+        metadata::StatsMetadataList fullList;
+        WriteMetadataToProtoLocked(currentWallClockTimeNs, systemElapsedTimeNs, &fullList);
+        fullList.SerializeToString(&record);
+        StorageManager::deleteFile(journalName.c_str());
+        mMetadataJournalRecords = 0;
+    } else {
+        dirtyList.SerializeToString(&record);
+    }
+
+    // Frame the record with its length so startup can replay records in order and
+    // stop cleanly at a tail torn by an interrupted shutdown.
+    const uint32_t recordSize = record.size();
+    std::string framed;
+    framed.reserve(sizeof(recordSize) + record.size());
+    framed.append(reinterpret_cast<const char*>(&recordSize), sizeof(recordSize));
+    framed.append(record);
+    StorageManager::appendFile(journalName.c_str(), framed.data(), framed.size());
+    mMetadataJournalRecords++;
 }
 
 void StatsLogProcessor::WriteMetadataToProto(int64_t currentWallClockTimeNs,
                                              int64_t systemElapsedTimeNs,
                                              metadata::StatsMetadataList* metadataList) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     WriteMetadataToProtoLocked(currentWallClockTimeNs, systemElapsedTimeNs, metadataList);
 }
 
@@ -1257,38 +1693,58 @@ void StatsLogProcessor::WriteMetadataToProtoLocked(int64_t currentWallClockTimeN
 
 void StatsLogProcessor::LoadMetadataFromDisk(int64_t currentWallClockTimeNs,
                                              int64_t systemElapsedTimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
+
+    // Monolithic file written by versions that predate the checkpoint journal.
     string file_name = StringPrintf("%s/metadata", STATS_METADATA_DIR);
-    int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
-    if (-1 == fd) {
-        VLOG("Attempt to read %s but failed", file_name.c_str());
-        StorageManager::deleteFile(file_name.c_str());
-        return;
-    }
     string content;
-    if (!android::base::ReadFdToString(fd, &content)) {
-        ALOGE("Attempt to read %s but failed", file_name.c_str());
-        close(fd);
-        StorageManager::deleteFile(file_name.c_str());
-        return;
+    if (StorageManager::readFileToString(file_name.c_str(), &content)) {
+        metadata::StatsMetadataList statsMetadataList;
+        if (statsMetadataList.ParseFromString(content)) {
+            SetMetadataStateLocked(statsMetadataList, currentWallClockTimeNs,
+                                   systemElapsedTimeNs);
+        } else {
+            ALOGE("Attempt to read %s but failed; failed to metadata", file_name.c_str());
+        }
     }
+    StorageManager::deleteFile(file_name.c_str());
 
-    close(fd);
-
-    metadata::StatsMetadataList statsMetadataList;
-    if (!statsMetadataList.ParseFromString(content)) {
-        ALOGE("Attempt to read %s but failed; failed to metadata", file_name.c_str());
-        StorageManager::deleteFile(file_name.c_str());
-        return;
+    // Replay the checkpoint journal in append order; a later record overrides an
+    // earlier one for the same config.
+    const string journalName = StringPrintf("%s/metadata_journal", STATS_METADATA_DIR);
+    content.clear();
+    if (StorageManager::readFileToString(journalName.c_str(), &content)) {
+        size_t offset = 0;
+        int replayedRecords = 0;
+        while (offset + sizeof(uint32_t) <= content.size()) {
+            uint32_t recordSize;
+            memcpy(&recordSize, content.data() + offset, sizeof(recordSize));
+            offset += sizeof(recordSize);
+            if (offset + recordSize > content.size()) {
+                // Tail torn by an interrupted append; keep what replayed so far.
+                ALOGW("Truncated metadata journal record in %s", journalName.c_str());
+                break;
+            }
+            metadata::StatsMetadataList record;
+            if (record.ParseFromArray(content.data() + offset, recordSize)) {
+                SetMetadataStateLocked(record, currentWallClockTimeNs, systemElapsedTimeNs);
+                replayedRecords++;
+            } else {
+                ALOGE("Failed to parse metadata journal record in %s", journalName.c_str());
+            }
+            offset += recordSize;
+        }
+        VLOG("Replayed %d metadata journal records", replayedRecords);
     }
-    SetMetadataStateLocked(statsMetadataList, currentWallClockTimeNs, systemElapsedTimeNs);
-    StorageManager::deleteFile(file_name.c_str());
+    StorageManager::deleteFile(journalName.c_str());
+    mMetadataJournalRecords = 0;
+    mMetadataCheckpointHashes.clear();
 }
 
 void StatsLogProcessor::SetMetadataState(const metadata::StatsMetadataList& statsMetadataList,
                                          int64_t currentWallClockTimeNs,
                                          int64_t systemElapsedTimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     SetMetadataStateLocked(statsMetadataList, currentWallClockTimeNs, systemElapsedTimeNs);
 }
 
@@ -1311,7 +1767,7 @@ void StatsLogProcessor::SetMetadataStateLocked(
 
 void StatsLogProcessor::WriteActiveConfigsToProtoOutputStream(
         int64_t currentTimeNs, const DumpReportReason reason, ProtoOutputStream* proto) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     WriteActiveConfigsToProtoOutputStreamLocked(currentTimeNs, reason, proto);
 }
 
@@ -1319,14 +1775,43 @@ void StatsLogProcessor::WriteActiveConfigsToProtoOutputStreamLocked(
         int64_t currentTimeNs,  const DumpReportReason reason, ProtoOutputStream* proto) {
     for (const auto& pair : mMetricsManagers) {
         const sp<MetricsManager>& metricsManager = pair.second;
-        uint64_t configToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                                     FIELD_ID_ACTIVE_CONFIG_LIST_CONFIG);
-        metricsManager->writeActiveConfigToProtoOutputStream(currentTimeNs, reason, proto);
-        proto->end(configToken);
+        if (!metricsManager->hasMetricActivations()) {
+            // Nothing to persist: loading ignores configs without saved activations, so
+            // the entry carrying just the config key can be omitted.
+            continue;
+        }
+        const int64_t activationVersion = metricsManager->getActivationVersion();
+        const auto segmentIt = mActiveConfigSegments.find(pair.first);
+        if (segmentIt != mActiveConfigSegments.end() &&
+            segmentIt->second.activationVersion == activationVersion &&
+            segmentIt->second.reason == reason) {
+            // Activation state is unchanged since the cached segment was built and the
+            // bytes carry no remaining TTLs, so they are still valid verbatim.
+            proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                 FIELD_ID_ACTIVE_CONFIG_LIST_CONFIG,
+                         segmentIt->second.bytes.data(), segmentIt->second.bytes.size());
+            continue;
+        }
+        ProtoOutputStream segmentProto;
+        const bool timeDependent = metricsManager->writeActiveConfigToProtoOutputStream(
+                currentTimeNs, reason, &segmentProto);
+        std::string segmentBytes;
+        segmentProto.serializeToString(&segmentBytes);
+        proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                             FIELD_ID_ACTIVE_CONFIG_LIST_CONFIG,
+                     segmentBytes.data(), segmentBytes.size());
+        if (!timeDependent) {
+            mActiveConfigSegments[pair.first] =
+                    ActiveConfigSegment{std::move(segmentBytes), activationVersion, reason};
+        } else {
+            // Remaining TTLs make the bytes specific to currentTimeNs; drop any stale
+            // cached segment and rebuild on the next save.
+            mActiveConfigSegments.erase(pair.first);
+        }
     }
 }
 void StatsLogProcessor::LoadActiveConfigsFromDisk() {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     string file_name = StringPrintf("%s/active_metrics", STATS_ACTIVE_METRIC_DIR);
     int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
     if (-1 == fd) {
@@ -1357,7 +1842,7 @@ void StatsLogProcessor::LoadActiveConfigsFromDisk() {
 
 void StatsLogProcessor::SetConfigsActiveState(const ActiveConfigList& activeConfigList,
                                                     int64_t currentTimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::shared_lock<std::shared_mutex> lock(mMetricsMutex);
     SetConfigsActiveStateLocked(activeConfigList, currentTimeNs);
 }
 
@@ -1372,6 +1857,9 @@ void StatsLogProcessor::SetConfigsActiveStateLocked(const ActiveConfigList& acti
             continue;
         }
         VLOG("Setting active config %s", key.ToString().c_str());
+        // Taking the shard is redundant for the exclusive-phase caller
+        // (LoadActiveConfigsFromDisk) but required for the shared-mode one.
+        std::lock_guard<std::mutex> shardLock(configShardFor(key));
         it->second->loadActiveConfig(config, currentTimeNs);
     }
     VLOG("Successfully loaded %d active configs.", activeConfigList.config_size());
@@ -1381,6 +1869,7 @@ void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportR
                                               const DumpLatency dumpLatency,
                                               const int64_t elapsedRealtimeNs,
                                               const int64_t wallClockNs) {
+    STATSD_TRACE_SCOPE("StatsLogProcessor::WriteDataToDisk");
     // Do not write to disk if we already have in the last few seconds.
     // This is to avoid overwriting files that would have the same name if we
     //   write twice in the same second.
@@ -1395,21 +1884,58 @@ void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportR
         WriteDataToDiskLocked(pair.first, elapsedRealtimeNs, wallClockNs, dumpReportReason,
                               dumpLatency);
     }
+    if (dumpLatency == FAST) {
+        // FAST report files were written without per-file syncs; make the
+        // whole batch durable with one directory sync (one journal commit)
+        // before shutdown proceeds.
+        StorageManager::syncDataDirectory();
+    }
 }
 
 void StatsLogProcessor::WriteDataToDisk(const DumpReportReason dumpReportReason,
                                         const DumpLatency dumpLatency,
                                         const int64_t elapsedRealtimeNs,
                                         const int64_t wallClockNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    // Persisted data must include any bucket splits still waiting out their
+    // coalescing window.
+    flushPendingAppUpgrades();
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     WriteDataToDiskLocked(dumpReportReason, dumpLatency, elapsedRealtimeNs, wallClockNs);
 }
 
 void StatsLogProcessor::informPullAlarmFired(const int64_t timestampNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    // Pulled data lands directly in MetricProducers, which lock themselves, so the
+    // shared lock is enough: pull delivery no longer waits behind a slow dump.
+    std::shared_lock<std::shared_mutex> lock(mMetricsMutex);
     mPullerManager->OnAlarmFired(timestampNs);
 }
 
+void StatsLogProcessor::trimMemoryIfIdle(const int64_t elapsedRealtimeNs) {
+    if (elapsedRealtimeNs - mLastEventProcessedNs.load(std::memory_order_relaxed) <
+        kTrimIdleThresholdNs) {
+        return;
+    }
+
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
+    if (elapsedRealtimeNs - mLastTrimElapsedNs < kTrimMinIntervalNs) {
+        return;
+    }
+    mLastTrimElapsedNs = elapsedRealtimeNs;
+
+    VLOG("Running idle memory trim");
+    for (const auto& [key, metricsManager] : mMetricsManagers) {
+        metricsManager->trimMemory();
+    }
+    mUidMap->trimMemory();
+    LogEventPool::getInstance().trim();
+    StatsdStats::getInstance().trimMemory();
+#ifdef __ANDROID__
+    // Hand freed-but-retained pages back to the OS so RSS settles to the
+    // pre-burst baseline instead of pinning the high-water mark.
+    mallopt(M_PURGE, 0);
+#endif
+}
+
 int64_t StatsLogProcessor::getLastReportTimeNs(const ConfigKey& key) {
     auto it = mMetricsManagers.find(key);
     if (it == mMetricsManagers.end()) {
@@ -1421,17 +1947,78 @@ int64_t StatsLogProcessor::getLastReportTimeNs(const ConfigKey& key) {
 
 void StatsLogProcessor::notifyAppUpgrade(const int64_t eventTimeNs, const string& apk,
                                          const int uid, const int64_t version) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
     VLOG("Received app upgrade");
+    bool applyNow = false;
+    {
+        std::lock_guard<std::mutex> pendingLock(mPendingUpgradeMutex);
+        if (mPendingAppUpgrades.empty() &&
+            eventTimeNs - mLastAppUpgradeFlushNs >= kAppUpgradeCoalesceWindowNs) {
+            // Quiet period: a lone upgrade pays no extra latency.
+            mLastAppUpgradeFlushNs = eventTimeNs;
+            applyNow = true;
+        } else {
+            // Mid-burst: queue it, to be applied with the rest of the batch in
+            // one locked pass when the window closes.
+            mPendingAppUpgrades.push_back({eventTimeNs, apk, uid, version});
+            if (mPendingUpgradeDeadlineNs.load(std::memory_order_relaxed) == 0) {
+                mPendingUpgradeDeadlineNs.store(mLastAppUpgradeFlushNs + kAppUpgradeCoalesceWindowNs,
+                                                std::memory_order_relaxed);
+            }
+            if (eventTimeNs < mPendingUpgradeDeadlineNs.load(std::memory_order_relaxed)) {
+                return;
+            }
+            // The window already closed; flush the batch below.
+        }
+    }
+    if (!applyNow) {
+        flushPendingAppUpgrades();
+        return;
+    }
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     StateManager::getInstance().notifyAppChanged(apk, mUidMap);
     for (const auto& it : mMetricsManagers) {
         it.second->notifyAppUpgrade(eventTimeNs, apk, uid, version);
     }
 }
 
+void StatsLogProcessor::flushPendingAppUpgrades() {
+    std::vector<PendingAppUpgrade> pending;
+    {
+        std::lock_guard<std::mutex> pendingLock(mPendingUpgradeMutex);
+        if (mPendingAppUpgrades.empty()) {
+            return;
+        }
+        pending.swap(mPendingAppUpgrades);
+        mLastAppUpgradeFlushNs = pending.back().eventTimeNs;
+        mPendingUpgradeDeadlineNs.store(0, std::memory_order_relaxed);
+    }
+    // One exclusive-lock acquisition covers the whole batch. Each upgrade keeps
+    // its own timestamp, so the bucket splits land exactly where immediate
+    // delivery would have put them.
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
+    for (const PendingAppUpgrade& upgrade : pending) {
+        StateManager::getInstance().notifyAppChanged(upgrade.apk, mUidMap);
+        for (const auto& it : mMetricsManagers) {
+            it.second->notifyAppUpgrade(upgrade.eventTimeNs, upgrade.apk, upgrade.uid,
+                                        upgrade.version);
+        }
+    }
+}
+
+void StatsLogProcessor::flushPendingAppUpgradesIfDue(const int64_t elapsedRealtimeNs) {
+    const int64_t deadlineNs = mPendingUpgradeDeadlineNs.load(std::memory_order_relaxed);
+    if (deadlineNs == 0 || elapsedRealtimeNs < deadlineNs) {
+        return;
+    }
+    flushPendingAppUpgrades();
+}
+
 void StatsLogProcessor::notifyAppRemoved(const int64_t eventTimeNs, const string& apk,
                                          const int uid) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    // Removals are rare enough to stay synchronous; apply any queued upgrades
+    // first so app changes are still delivered in order.
+    flushPendingAppUpgrades();
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     VLOG("Received app removed");
     StateManager::getInstance().notifyAppChanged(apk, mUidMap);
     for (const auto& it : mMetricsManagers) {
@@ -1440,7 +2027,7 @@ void StatsLogProcessor::notifyAppRemoved(const int64_t eventTimeNs, const string
 }
 
 void StatsLogProcessor::onUidMapReceived(const int64_t eventTimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     VLOG("Received uid map");
     StateManager::getInstance().updateLogSources(mUidMap);
     for (const auto& it : mMetricsManagers) {
@@ -1449,7 +2036,7 @@ void StatsLogProcessor::onUidMapReceived(const int64_t eventTimeNs) {
 }
 
 void StatsLogProcessor::onStatsdInitCompleted(const int64_t elapsedTimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
     VLOG("Received boot completed signal");
     for (const auto& it : mMetricsManagers) {
         it.second->onStatsdInitCompleted(elapsedTimeNs);
@@ -1457,8 +2044,8 @@ void StatsLogProcessor::onStatsdInitCompleted(const int64_t elapsedTimeNs) {
 }
 
 void StatsLogProcessor::noteOnDiskData(const ConfigKey& key) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
-    mOnDiskDataConfigs.insert(key);
+    std::lock_guard<std::mutex> bookkeepingLock(mConfigBookkeepingMutex);
+    mConfigBookkeeping[key].hasOnDiskData = true;
 }
 
 void StatsLogProcessor::setAnomalyAlarm(const int64_t elapsedTimeMillis) {
@@ -1471,6 +2058,24 @@ void StatsLogProcessor::cancelAnomalyAlarm() {
     mNextAnomalyAlarmTime = 0;
 }
 
+void StatsLogProcessor::serviceDueAnomalyAlarms(const int64_t elapsedRealtimeNs,
+                                                const uint32_t slackSec) {
+    const int64_t horizonNs = elapsedRealtimeNs + static_cast<int64_t>(slackSec) * NS_PER_SEC;
+    {
+        // Same gate as the ingestion path: only go to the alarm monitor when the
+        // soonest anomaly alarm actually falls within the horizon.
+        std::lock_guard<std::mutex> anomalyLock(mAnomalyAlarmMutex);
+        if (mNextAnomalyAlarmTime == 0 || MillisToNano(mNextAnomalyAlarmTime) > horizonNs) {
+            return;
+        }
+        mNextAnomalyAlarmTime = 0;
+    }
+    VLOG("coalescing anomaly alarms within %u sec of wakeup at %lld", slackSec,
+         (long long)elapsedRealtimeNs);
+    std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
+    informAnomalyAlarmFiredLocked(NanoToMillis(horizonNs));
+}
+
 void StatsLogProcessor::informAnomalyAlarmFiredLocked(const int64_t elapsedTimeMillis) {
     VLOG("StatsService::informAlarmForSubscriberTriggeringFired was called");
     unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> alarmSet =
@@ -1494,8 +2099,18 @@ LogEventFilter::AtomIdSet StatsLogProcessor::getDefaultAtomIdSet() {
     return allAtomIds;
 }
 
-void StatsLogProcessor::updateLogEventFilterLocked() const {
+LogEventFilter::AtomIdSet StatsLogProcessor::getDefaultHighPriorityAtomIdSet() {
+    // Atoms whose loss hurts correctness or crash investigations dispropor-
+    // tionately; they may occupy the reserved queue headroom during storms.
+    LogEventFilter::AtomIdSet highPriorityAtomIds{
+            util::BINARY_PUSH_STATE_CHANGED, util::ISOLATED_UID_CHANGED,
+            util::WATCHDOG_ROLLBACK_OCCURRED, util::ANOMALY_DETECTED};
+    return highPriorityAtomIds;
+}
+
+void StatsLogProcessor::updateLogEventFilterLocked() {
     VLOG("StatsLogProcessor: Updating allAtomIds");
+    rebuildAtomRoutingTableLocked();
     LogEventFilter::AtomIdSet allAtomIds = getDefaultAtomIdSet();
     for (const auto& metricsManager : mMetricsManagers) {
         metricsManager.second->addAllAtomIds(allAtomIds);
@@ -1505,6 +2120,30 @@ void StatsLogProcessor::updateLogEventFilterLocked() const {
     mLogEventFilter->setAtomIds(std::move(allAtomIds), this);
 }
 
+void StatsLogProcessor::rebuildAtomRoutingTableLocked() {
+    mAtomInterestIndex.clear();
+    mManagersWithActivations.clear();
+    LogEventFilter::AtomIdSet atomIds;
+    for (const auto& [key, metricsManager] : mMetricsManagers) {
+        atomIds.clear();
+        metricsManager->addAllAtomIds(atomIds);
+        for (const int atomId : atomIds) {
+            mAtomInterestIndex[atomId].emplace_back(key, metricsManager);
+        }
+        if (metricsManager->hasMetricActivations()) {
+            mManagersWithActivations.emplace_back(key, metricsManager);
+        }
+    }
+    // Alert detection latency is the primary SLO; order each atom's fan-out list
+    // so configs with anomaly trackers consume the event before bulk analytics
+    // configs do.
+    for (auto& [atomId, managers] : mAtomInterestIndex) {
+        std::stable_partition(managers.begin(), managers.end(), [](const auto& entry) {
+            return entry.second->hasAnomalyTrackers();
+        });
+    }
+}
+
 void StatsLogProcessor::writeDataCorruptedReasons(ProtoOutputStream& proto) {
     if (StatsdStats::getInstance().hasEventQueueOverflow()) {
         proto.write(FIELD_TYPE_INT32 | FIELD_COUNT_REPEATED | FIELD_ID_DATA_CORRUPTED_REASON,
@@ -20,6 +20,11 @@
 #include <gtest/gtest_prod.h>
 #include <stdio.h>
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <shared_mutex>
+#include <thread>
 #include <unordered_map>
 
 #include "config/ConfigListener.h"
@@ -51,11 +56,22 @@ public:
 
     void OnLogEvent(LogEvent* event);
 
+    // Processes a batch of events under a single mMetricsMutex acquisition.
+    void OnLogEvents(const std::vector<std::unique_ptr<LogEvent>>& events);
+
     void OnConfigUpdated(const int64_t timestampNs, int64_t wallClockNs, const ConfigKey& key,
                          const StatsdConfig& config, bool modularUpdate = true);
     // For testing only.
     void OnConfigUpdated(const int64_t timestampNs, const ConfigKey& key,
                          const StatsdConfig& config, bool modularUpdate = true);
+
+    // Builds the MetricsManagers for all configs read from disk at startup. Initialization
+    // is CPU-bound and independent per config, so the managers are constructed on a
+    // temporary pool of worker threads and published into mMetricsManagers as each one
+    // completes, instead of one at a time through OnConfigUpdated.
+    void OnConfigsLoadedFromDisk(int64_t timestampNs,
+                                 const std::map<ConfigKey, StatsdConfig>& configs) override;
+
     void OnConfigRemoved(const ConfigKey& key);
 
     size_t GetMetricsSize(const ConfigKey& key) const;
@@ -144,10 +160,19 @@ public:
 
     void informPullAlarmFired(const int64_t timestampNs);
 
+    // Runs the idle maintenance pass: when no event has been ingested for
+    // kTrimIdleThresholdNs, shrinks over-provisioned containers across the
+    // metric producers, the uid map, statsd stats, and the event pool, then
+    // asks the allocator to return freed pages so RSS settles back to its
+    // pre-burst baseline. Rate limited to once per kTrimMinIntervalNs and
+    // piggybacked on the periodic StatsCompanion alarms, so it costs no
+    // dedicated wakeup and never runs while events are flowing.
+    void trimMemoryIfIdle(int64_t elapsedRealtimeNs);
+
     int64_t getLastReportTimeNs(const ConfigKey& key);
 
     inline void setPrintLogs(bool enabled) {
-        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        std::lock_guard<std::shared_mutex> lock(mMetricsMutex);
         mPrintAllLogs = enabled;
         // Turning on print logs turns off pushed event filtering to enforce
         // complete log event buffer parsing
@@ -161,6 +186,11 @@ public:
 
     void cancelAnomalyAlarm();
 
+    // Services anomaly alarms that are due, or fall due within slackSec, while the
+    // device is already awake for another statsd alarm. Riding the existing wakeup
+    // coalesces alarms that would otherwise wait for the next logged event.
+    void serviceDueAnomalyAlarms(const int64_t elapsedRealtimeNs, const uint32_t slackSec);
+
     void querySql(const string& sqlQuery, const int32_t minSqlClientVersion,
                   const optional<vector<uint8_t>>& policyConfig,
                   const shared_ptr<aidl::android::os::IStatsQueryCallback>& callback,
@@ -172,6 +202,10 @@ public:
     /* Returns pre-defined list of atoms to parse by LogEventFilter */
     static LogEventFilter::AtomIdSet getDefaultAtomIdSet();
 
+    // Atoms that keep reserved headroom in the event queue on overflow, see
+    // LogEventQueue::setHighPriorityAtomIds().
+    static LogEventFilter::AtomIdSet getDefaultHighPriorityAtomIdSet();
+
 private:
     // For testing only.
     inline sp<AlarmMonitor> getAnomalyAlarmMonitor() const {
@@ -182,25 +216,134 @@ private:
         return mPeriodicAlarmMonitor;
     }
 
-    mutable mutex mMetricsMutex;
+    // Two-level locking for the metrics state. mMetricsMutex held exclusively is the
+    // brief global phase: it guards the mMetricsManagers map structure itself and is
+    // taken for config add/remove/reset and the whole-map maintenance paths. Everything
+    // per-config runs with mMetricsMutex held shared plus the config's shard from
+    // mConfigShardMutexes, so a slow dump of config A no longer blocks event delivery
+    // or pull delivery for config B.
+    //
+    // Invariant: per-config MetricsManager state is only mutated while holding either
+    // the exclusive lock, or the shared lock plus that key's shard. MetricProducers
+    // lock themselves, so read-mostly paths that go straight to producers (pulls) only
+    // need the shared lock.
+    //
+    // Lock order: mEventIngestionMutex -> mDumpReportMutex -> mMetricsMutex ->
+    // shard mutex -> mConfigBookkeepingMutex / mPendingWritesMutex.
+    mutable std::shared_mutex mMetricsMutex;
+
+    // Shard mutexes keyed by ConfigKey hash; see mMetricsMutex. Sized to keep
+    // false sharing between unrelated configs unlikely while the table stays small.
+    static constexpr size_t kConfigShardCount = 8;
+
+    mutable std::array<std::mutex, kConfigShardCount> mConfigShardMutexes;
+
+    std::mutex& configShardFor(const ConfigKey& key) const {
+        return mConfigShardMutexes[std::hash<ConfigKey>()(key) % kConfigShardCount];
+    }
+
+    // Serializes event ingestion against itself so event ordering and the
+    // ingestion-only fields (mLargestTimestampSeen, mLastPullerCacheClearTimeSec,
+    // mLastActivationBroadcastTimes, ...) stay single-writer while dumps and pulls
+    // for other configs proceed concurrently.
+    mutable mutex mEventIngestionMutex;
+
+    // Direct-mapped cache for the per-event isolated-uid translation. Isolated-uid
+    // lookups are highly repetitive within event bursts, so the common repeat hit
+    // costs one array probe instead of a UidMap snapshot load and hash lookup. The
+    // whole cache is dropped when the UidMap's isolated-uid generation changes.
+    // Guarded by mEventIngestionMutex; mutable because translation happens on the
+    // const mapIsolatedUidToHostUidIfNecessaryLocked path.
+    struct IsolatedUidCacheSlot {
+        int32_t uid = -1;
+        int32_t hostUid = -1;
+    };
+    static constexpr size_t kIsolatedUidCacheSlots = 64;
+    mutable std::array<IsolatedUidCacheSlot, kIsolatedUidCacheSlots> mIsolatedUidCache;
+    mutable uint64_t mIsolatedUidCacheGeneration = 0;
+
+    // Guards mConfigBookkeeping, which is touched by concurrent shared-mode holders
+    // working on different keys. Held only for the container operation itself, never
+    // across calls out.
+    mutable mutex mConfigBookkeepingMutex;
+
+    // Serializes dump reports against each other so their disk-history phase can run
+    // without mMetricsMutex; event ingestion then only blocks while the in-memory report
+    // is assembled. Always acquired before mMetricsMutex, never while holding it.
+    mutable mutex mDumpReportMutex;
 
     // Guards mNextAnomalyAlarmTime. A separate mutex is needed because alarms are set/cancelled
     // in the onLogEvent code path, which is locked by mMetricsMutex.
     // DO NOT acquire mMetricsMutex while holding mAnomalyAlarmMutex. This can lead to a deadlock.
     mutable mutex mAnomalyAlarmMutex;
 
+    // Coalescing of app-upgrade notifications from the UidMap. During a
+    // multi-app update session every upgrade used to take the exclusive lock
+    // and split partial buckets on its own. Now the first upgrade after a quiet
+    // period is applied immediately, and the rest of the burst is queued and
+    // applied for all affected apps in a single exclusive-lock pass once the
+    // window closes. Each queued upgrade keeps its own notification timestamp,
+    // so the resulting bucket splits are unchanged; only the lock traffic is.
+    static constexpr int64_t kAppUpgradeCoalesceWindowNs = 500 * 1000000LL;  // 500ms
+
+    struct PendingAppUpgrade {
+        int64_t eventTimeNs;
+        std::string apk;
+        int uid;
+        int64_t version;
+    };
+
+    // Guards mPendingAppUpgrades and mLastAppUpgradeFlushNs. Held only for the
+    // queue operation itself, never while the metrics managers are notified.
+    mutable mutex mPendingUpgradeMutex;
+
+    std::vector<PendingAppUpgrade> mPendingAppUpgrades;
+
+    // Elapsed time of the last upgrade pass (immediate or batched).
+    int64_t mLastAppUpgradeFlushNs = 0;
+
+    // Deadline by which the queued upgrades must be applied; 0 when nothing is
+    // queued. Atomic so the ingestion path can poll it without a lock.
+    std::atomic<int64_t> mPendingUpgradeDeadlineNs{0};
+
     std::unordered_map<ConfigKey, sp<MetricsManager>> mMetricsManagers;
 
-    std::unordered_map<ConfigKey, int64_t> mLastBroadcastTimes;
+    // Routing table for the ingestion fan-out: atom id -> managers whose config has
+    // a matcher for that atom, so an event is handed only to interested managers
+    // instead of probing every entry of mMetricsManagers. Values alias entries of
+    // mMetricsManagers; the table is rebuilt under the exclusive lock whenever the
+    // config set changes (the same points that refresh the LogEventFilter atom set)
+    // and read under the shared lock.
+    std::unordered_map<int, std::vector<std::pair<ConfigKey, sp<MetricsManager>>>>
+            mAtomInterestIndex;
 
-    // Last time we sent a broadcast to this uid that the active configs had changed.
-    std::unordered_map<int, int64_t> mLastActivationBroadcastTimes;
+    // Managers whose config gates metrics behind activations. They also observe
+    // events for atoms they have no matcher for, so live activations expire on
+    // time. Maintained together with mAtomInterestIndex.
+    std::vector<std::pair<ConfigKey, sp<MetricsManager>>> mManagersWithActivations;
+
+    // Per-config rate-limit and dump bookkeeping, consolidated into one slot per key
+    // so the paths that consult several of these fields per event batch or per dump
+    // probe a single map instead of parallel containers. A timestamp of 0 means
+    // "never", matching the absent-key semantics the separate maps had.
+    struct ConfigBookkeeping {
+        // Last time a get-data broadcast was sent for this config.
+        int64_t lastBroadcastTimeNs = 0;
+
+        // Last time the bytes consumed by this config were checked.
+        int64_t lastByteSizeCheckTimeNs = 0;
 
-    // Tracks when we last checked the bytes consumed for each config key.
-    std::unordered_map<ConfigKey, int64_t> mLastByteSizeTimes;
+        // Number of times this config has been dumped.
+        int32_t dumpReportNumber = 0;
 
-    // Tracks the number of times a config with a specified config key has been dumped.
-    std::unordered_map<ConfigKey, int32_t> mDumpReportNumbers;
+        // Whether this config has a metric report on disk.
+        bool hasOnDiskData = false;
+    };
+
+    std::unordered_map<ConfigKey, ConfigBookkeeping> mConfigBookkeeping;
+
+    // Last time we sent a broadcast to this uid that the active configs had changed.
+    std::unordered_map<int, int64_t> mLastActivationBroadcastTimes;
 
     // Tracks when we last checked the ttl for restricted metrics.
     int64_t mLastTtlTime;
@@ -211,8 +354,22 @@ private:
     // Tracks when we last checked db guardrails.
     int64_t mLastDbGuardrailEnforcementTime;
 
-    // Tracks which config keys has metric reports on disk
-    std::set<ConfigKey> mOnDiskDataConfigs;
+    // Guards the pending-write queue and the writer-thread state below. Never held
+    // while doing file I/O; acquired after mMetricsMutex when both are needed.
+    mutable mutex mPendingWritesMutex;
+
+    // Number of report writes handed to the WorkerPool that have not landed on disk
+    // yet; flushPendingDataWrites() waits for it to drop to zero.
+    int mPendingWriteCount = 0;
+
+    std::condition_variable mPendingWritesDoneCV;
+
+    // Number of background db maintenance sweeps (restricted ttls, db guardrails)
+    // handed to the WorkerPool that have not finished yet; guarded by
+    // mPendingWritesMutex, waitForPendingDbMaintenance() waits for it to drop to zero.
+    int mPendingDbMaintenanceCount = 0;
+
+    std::condition_variable mPendingDbMaintenanceDoneCV;
 
     sp<UidMap> mUidMap;  // Reference to the UidMap to lookup app name and version for each uid.
 
@@ -226,6 +383,15 @@ private:
 
     void OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs);
 
+    // Runs with mEventIngestionMutex held; takes mMetricsMutex shared for the
+    // delivery loop and upgrades to exclusive only for the rare maintenance work
+    // (config TTL reset, fired anomaly alarms, periodic restricted-data tasks).
+    void OnLogEventIngestionLocked(LogEvent* event, int64_t elapsedRealtimeNs);
+
+    // Returns whether any config's TTL has expired, so the caller can decide to
+    // take the exclusive lock and reset. Requires at least the shared lock.
+    bool anyConfigTtlExpiredLocked(const int64_t eventTimeNs) const;
+
     void resetIfConfigTtlExpiredLocked(const int64_t eventTimeNs);
 
     void OnConfigUpdatedLocked(const int64_t currentTimestampNs, const ConfigKey& key,
@@ -255,18 +421,44 @@ private:
                                const DumpReportReason dumpReportReason,
                                const DumpLatency dumpLatency);
 
+    // Hands a serialized report to the shared WorkerPool. Used by the non-shutdown
+    // disk writes so file I/O happens off mMetricsMutex; the FAST (shutdown) path
+    // writes synchronously instead.
+    void enqueueDataWrite(std::string fileName, vector<uint8_t> buffer);
+
+    // Waits until every enqueued report has been written, so subsequent reads of the
+    // stats-data directory see all of them.
+    void flushPendingDataWrites();
+
+    // Streams one serialized ConfigMetricsReport into the caller's proto, which avoids
+    // materializing the report as a separate contiguous buffer.
     void onConfigMetricsReportLocked(
             const ConfigKey& key, int64_t dumpTimeStampNs, int64_t wallClockNs,
             const bool include_current_partial_bucket, const bool erase_data,
             const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
             /*if dataSavedToDisk is true, it indicates the caller will write the data to disk
              (e.g., before reboot). So no need to further persist local history.*/
-            const bool dataSavedToDisk, vector<uint8_t>* proto);
+            const bool dataSavedToDisk, ProtoOutputStream* proto);
+
+    // Same, but materialized into buffer for the callers that need contiguous bytes
+    // (disk writes and local history persistence).
+    void onConfigMetricsReportLocked(
+            const ConfigKey& key, int64_t dumpTimeStampNs, int64_t wallClockNs,
+            const bool include_current_partial_bucket, const bool erase_data,
+            const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+            const bool dataSavedToDisk, vector<uint8_t>* buffer);
 
-    /* Check if it is time enforce data ttls for restricted metrics, and if it is, enforce ttls
-     * on all restricted metrics. */
-    void enforceDataTtlsIfNecessaryLocked(const int64_t wallClockNs,
-                                          const int64_t elapsedRealtimeNs);
+    // Runs the time-gated restricted-data tasks when any of them is due, taking the
+    // exclusive lock only in that case. Staged restricted events are flushed inline,
+    // but the ttl and db guardrail sweeps - which issue sqlite deletes and scan the
+    // restricted-data dir - are handed to the WorkerPool so their storage I/O never
+    // runs on the ingestion path. Called from the ingestion path without
+    // mMetricsMutex held.
+    void runPeriodicTasksIfNecessary(const int64_t wallClockNs, const int64_t elapsedRealtimeNs);
+
+    // Waits until every enqueued ttl/guardrail sweep has finished, so subsequent
+    // reads of the restricted dbs see their effects.
+    void waitForPendingDbMaintenance();
 
     // Enforces ttls on all restricted metrics.
     void enforceDataTtlsLocked(const int64_t wallClockNs, int64_t elapsedRealtimeNs);
@@ -287,6 +479,11 @@ private:
     // Maps the isolated uid in the log event to host uid if the log event contains uid fields.
     void mapIsolatedUidToHostUidIfNecessaryLocked(LogEvent* event) const;
 
+    // Translates one uid through the direct-mapped isolated-uid cache, falling back to
+    // the UidMap snapshot on a miss. Only called on the event ingestion path, so the
+    // cache state is guarded by mEventIngestionMutex.
+    int32_t getHostUidOrSelfCached(int32_t uid) const;
+
     // Handler over the isolated uid change event.
     void onIsolatedUidChangedEventLocked(const LogEvent& event);
 
@@ -324,8 +521,20 @@ private:
 
     void flushRestrictedDataIfNecessaryLocked(const int64_t elapsedRealtimeNs);
 
-    /* Tells LogEventFilter about atom ids to parse */
-    void updateLogEventFilterLocked() const;
+    /* Tells LogEventFilter about atom ids to parse and refreshes the routing table */
+    void updateLogEventFilterLocked();
+
+    // Rebuilds mAtomInterestIndex and mManagersWithActivations from the current
+    // mMetricsManagers. Requires the exclusive lock (or construction).
+    void rebuildAtomRoutingTableLocked();
+
+    // Applies every queued app upgrade in one exclusive-lock pass, preserving
+    // each upgrade's own notification timestamp. No-op when nothing is queued.
+    void flushPendingAppUpgrades();
+
+    // Cheap unlocked poll for the ingestion path: flushes the queued upgrades
+    // once the coalescing window has closed.
+    void flushPendingAppUpgradesIfDue(int64_t elapsedRealtimeNs);
 
     void writeDataCorruptedReasons(ProtoOutputStream& proto);
 
@@ -354,15 +563,47 @@ private:
 
     int64_t mLastPullerCacheClearTimeSec = 0;
 
+    // Idle maintenance pass tuning: trim only after ingestion has been quiet
+    // for the threshold, and at most once per interval.
+    static constexpr int64_t kTrimIdleThresholdNs = 5 * 60 * NS_PER_SEC;
+    static constexpr int64_t kTrimMinIntervalNs = 30 * 60 * NS_PER_SEC;
+
+    // Elapsed-realtime time of the last ingested event, written on the
+    // ingestion path and read (approximately) by the idle trim check.
+    std::atomic<int64_t> mLastEventProcessedNs{0};
+
+    // Last time the idle maintenance pass ran. Guarded by mMetricsMutex.
+    int64_t mLastTrimElapsedNs = 0;
+
     // Last time we wrote data to disk.
     int64_t mLastWriteTimeNs = 0;
 
     // Last time we wrote active metrics to disk.
     int64_t mLastActiveMetricsWriteNs = 0;
 
+    // Cached serialized ActiveConfig submessage per config, reused by the active-config
+    // save paths when the config's activation state is unchanged since the bytes were
+    // built. Only time-independent segments are cached: bytes embedding a remaining
+    // activation TTL depend on the save time and are always rebuilt. Guarded by
+    // mMetricsMutex (exclusive).
+    struct ActiveConfigSegment {
+        std::string bytes;
+        int64_t activationVersion;
+        DumpReportReason reason;
+    };
+    std::unordered_map<ConfigKey, ActiveConfigSegment> mActiveConfigSegments;
+
     //Last time we wrote metadata to disk.
     int64_t mLastMetadataWriteNs = 0;
 
+    // Per-config hash of the last checkpointed metadata bytes; a config whose
+    // metadata is unchanged is skipped by the next SaveMetadataToDisk().
+    std::unordered_map<ConfigKey, uint64_t> mMetadataCheckpointHashes;
+
+    // Number of records appended to the metadata checkpoint journal since the
+    // last compaction (or load, which consumes the journal).
+    size_t mMetadataJournalRecords = 0;
+
     // The time for the next anomaly alarm for alerts.
     int64_t mNextAnomalyAlarmTime = 0;
 
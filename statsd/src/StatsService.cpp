@@ -22,8 +22,10 @@
 #include <android-base/file.h>
 #include <android-base/strings.h>
 #include <android/binder_ibinder_platform.h>
+#include <cutils/ashmem.h>
 #include <cutils/multiuser.h>
 #include <private/android_filesystem_config.h>
+#include <sys/mman.h>
 #include <src/statsd_config.pb.h>
 #include <src/uid_data.pb.h>
 #include <statslog_statsd.h>
@@ -39,10 +41,13 @@
 #include "config/ConfigManager.h"
 #include "flags/FlagProvider.h"
 #include "guardrail/StatsdStats.h"
+#include "logd/LogEventPool.h"
+#include "socket/SocketPayloadCapture.h"
 #include "stats_log_util.h"
 #include "storage/StorageManager.h"
 #include "subscriber/SubscriberReporter.h"
 #include "utils/DbUtils.h"
+#include "utils/ThreadPolicy.h"
 
 using namespace android;
 
@@ -229,6 +234,10 @@ StatsService::StatsService(const sp<UidMap>& uidMap, shared_ptr<LogEventQueue> q
     init_system_properties();
 
     if (mEventQueue != nullptr) {
+        // Crash/rollback-adjacent atoms keep reserved queue headroom so they
+        // survive benign atom storms that fill the base queue limit.
+        mEventQueue->setHighPriorityAtomIds(StatsLogProcessor::getDefaultHighPriorityAtomIdSet());
+        mParsePool = std::make_unique<LogEventParsePool>();
         mLogsReaderThread = std::make_unique<std::thread>([this] { readLogs(); });
     }
 }
@@ -243,24 +252,36 @@ StatsService::~StatsService() {
 
 /* Runs on a dedicated thread to process pushed events. */
 void StatsService::readLogs() {
+    ThreadPolicy::getInstance().applyRole(ThreadRole::EVENT_READER);
     // Read forever..... long live statsd
     while (1) {
-        // Block until an event is available.
-        auto event = mEventQueue->waitPop();
+        // Block until at least one event is available, then drain the backlog
+        // so the per-batch costs (wakeup, mMetricsMutex) are paid once.
+        auto events = mEventQueue->waitPopAll();
+        // Deep backlogs temporarily move this thread onto the big cores.
+        ThreadPolicy::getInstance().noteEventReaderQueueDepth(events.size());
 
         // Below flag will be set when statsd is exiting and log event will be pushed to break
-        // out of waitPop.
+        // out of waitPopAll.
         if (mIsStopRequested) {
             break;
         }
 
-        // Pass it to StatsLogProcess to all configs/metrics
+        // Materialize deferred event bodies across the parse pool workers;
+        // events keep their batch positions so delivery order is unchanged.
+        mParsePool->parseBatch(events);
+
+        // Pass the batch to StatsLogProcess to all configs/metrics
         // At this point, the LogEventQueue is not blocked, so that the socketListener
         // can read events from the socket and write to buffer to avoid data drop.
-        mProcessor->OnLogEvent(event.get());
-        // The ShellSubscriber is only used by shell for local debugging.
-        if (mShellSubscriber != nullptr) {
-            mShellSubscriber->onLogEvent(*event);
+        mProcessor->OnLogEvents(events);
+        for (auto& event : events) {
+            // The ShellSubscriber is only used by shell for local debugging.
+            if (mShellSubscriber != nullptr) {
+                mShellSubscriber->onLogEvent(*event);
+            }
+            // Recycle the event so steady-state ingestion stays allocation-free.
+            LogEventPool::getInstance().release(std::move(event));
         }
     }
 }
@@ -320,20 +341,67 @@ status_t StatsService::dump(int fd, const char** args, uint32_t numArgs) {
     return NO_ERROR;
 }
 
+// How long a formatted stats snapshot stays fresh. Within the window, dump requests
+// copy the ready buffer without touching the stats or processor locks.
+constexpr int64_t kStatsSnapshotFreshNs = 5 * NS_PER_SEC;
+
 /**
  * Write debugging data about statsd in text or proto format.
  */
 void StatsService::dumpStatsdStats(int out, bool verbose, bool proto) {
     if (proto) {
+        // Machine-readable binary snapshot, used by periodic health polling.
         vector<uint8_t> data;
         StatsdStats::getInstance().dumpStats(&data, false); // does not reset statsdStats.
-        for (size_t i = 0; i < data.size(); i ++) {
-            dprintf(out, "%c", data[i]);
+        if (!data.empty()) {
+            android::base::WriteFully(out, data.data(), data.size());
         }
-    } else {
-        StatsdStats::getInstance().dumpStats(out);
-        mProcessor->dumpStates(out, verbose);
+        return;
+    }
+
+    std::shared_ptr<const string> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mStatsSnapshotMutex);
+        const int64_t nowNs = getElapsedRealtimeNs();
+        if (mStatsSnapshot == nullptr || mStatsSnapshotVerbose != verbose ||
+            nowNs - mStatsSnapshotElapsedNs > kStatsSnapshotFreshNs) {
+            std::shared_ptr<const string> fresh = formatStatsdStatsSnapshot(verbose);
+            if (fresh == nullptr) {
+                // No memory fd available; format straight to the caller like before.
+                StatsdStats::getInstance().dumpStats(out);
+                mProcessor->dumpStates(out, verbose);
+                return;
+            }
+            mStatsSnapshot = std::move(fresh);
+            mStatsSnapshotElapsedNs = nowNs;
+            mStatsSnapshotVerbose = verbose;
+        }
+        snapshot = mStatsSnapshot;
     }
+    // Stream outside the snapshot lock: the caller fd may be a slow pipe, and
+    // concurrent dump requests can copy the same ready buffer meanwhile.
+    android::base::WriteFully(out, snapshot->data(), snapshot->size());
+}
+
+std::shared_ptr<const std::string> StatsService::formatStatsdStatsSnapshot(bool verbose) {
+    android::base::unique_fd memFd(memfd_create("statsd_stats_dump", MFD_CLOEXEC));
+    if (memFd.get() < 0) {
+        return nullptr;
+    }
+    // The dprintf-based formatters write to memory here, so the stats and processor
+    // locks are held for memory-speed writes only, never for the caller's fd.
+    StatsdStats::getInstance().dumpStats(memFd.get());
+    mProcessor->dumpStates(memFd.get(), verbose);
+
+    const off_t size = lseek(memFd.get(), 0, SEEK_END);
+    if (size < 0 || lseek(memFd.get(), 0, SEEK_SET) != 0) {
+        return nullptr;
+    }
+    auto buffer = std::make_shared<string>(size, '\0');
+    if (!android::base::ReadFully(memFd.get(), buffer->data(), buffer->size())) {
+        return nullptr;
+    }
+    return buffer;
 }
 
 /**
@@ -422,6 +490,10 @@ status_t StatsService::handleShellCommand(int in, int out, int err, const char**
             return cmd_print_logs(out, utf8Args);
         }
 
+        if (!utf8Args[0].compare(String8("log-capture"))) {
+            return cmd_log_socket_capture(out, utf8Args);
+        }
+
         if (!utf8Args[0].compare(String8("send-active-configs"))) {
             return cmd_trigger_active_config_broadcast(out, utf8Args);
         }
@@ -560,6 +632,12 @@ void StatsService::print_cmd_help(int out) {
     dprintf(out, "usage: adb shell cmd stats print-logs\n");
     dprintf(out, "  Requires root privileges.\n");
     dprintf(out, "  Can be disabled by calling adb shell cmd stats print-logs 0\n");
+    dprintf(out, "\n");
+    dprintf(out, "usage: adb shell cmd stats log-capture start [FILE]\n");
+    dprintf(out, "usage: adb shell cmd stats log-capture stop\n");
+    dprintf(out, "  Records raw socket payloads with timestamps into FILE (default\n");
+    dprintf(out, "  /data/misc/stats-service/socket-capture.bin) for replay with\n");
+    dprintf(out, "  statsd_trace_replay. Requires root on an eng/userdebug build.\n");
 }
 
 status_t StatsService::cmd_trigger_broadcast(int out, Vector<String8>& args) {
@@ -757,14 +835,12 @@ status_t StatsService::cmd_dump_report(int out, const Vector<String8>& args) {
             name.assign(args[2].c_str(), args[2].size());
         }
         if (good) {
-            vector<uint8_t> data;
+            ProtoOutputStream output;
             mProcessor->onDumpReport(ConfigKey(uid, StrToInt64(name)), getElapsedRealtimeNs(),
                                      getWallClockNs(), includeCurrentBucket, eraseData, ADB_DUMP,
-                                     NO_TIME_CONSTRAINTS, &data);
+                                     NO_TIME_CONSTRAINTS, &output);
             if (proto) {
-                for (size_t i = 0; i < data.size(); i ++) {
-                    dprintf(out, "%c", data[i]);
-                }
+                output.flush(out);
             } else {
                 dprintf(out, "Non-proto stats data dump not currently supported.\n");
             }
@@ -959,6 +1035,34 @@ status_t StatsService::cmd_print_logs(int out, const Vector<String8>& args) {
     return NO_ERROR;
 }
 
+status_t StatsService::cmd_log_socket_capture(int out, const Vector<String8>& args) {
+    Status status = checkUid(AID_ROOT);
+    if (!status.isOk()) {
+        return PERMISSION_DENIED;
+    }
+    if (!mEngBuild) {
+        dprintf(out, "Socket capture is only available on eng/userdebug builds.\n");
+        return PERMISSION_DENIED;
+    }
+    if (args.size() >= 2 && !args[1].compare(String8("start"))) {
+        const string path = args.size() >= 3 ? string(args[2].c_str())
+                                             : "/data/misc/stats-service/socket-capture.bin";
+        if (!SocketPayloadCapture::getInstance().start(path)) {
+            dprintf(out, "Failed to start socket capture (already running or bad path).\n");
+            return UNKNOWN_ERROR;
+        }
+        dprintf(out, "Capturing socket payloads to %s\n", path.c_str());
+        return NO_ERROR;
+    }
+    if (args.size() >= 2 && !args[1].compare(String8("stop"))) {
+        SocketPayloadCapture::getInstance().stop();
+        dprintf(out, "Socket capture stopped.\n");
+        return NO_ERROR;
+    }
+    print_cmd_help(out);
+    return NO_ERROR;
+}
+
 bool StatsService::getUidFromArgs(const Vector<String8>& args, size_t uidArgIndex, int32_t& uid) {
     return getUidFromString(args[uidArgIndex].c_str(), uid);
 }
@@ -993,7 +1097,7 @@ Status StatsService::informAllUidData(const ScopedFileDescriptor& fd) {
         return exception(EX_ILLEGAL_ARGUMENT, "Error parsing proto stream for UidData.");
     }
 
-    mUidMap->updateMap(getElapsedRealtimeNs(), uidData);
+    mUidMap->updateMap(getElapsedRealtimeNs(), std::move(uidData));
     mBootCompleteTrigger.markComplete(kUidMapReceivedTag);
     VLOG("StatsService::informAllUidData UidData proto parsed successfully.");
     return Status::ok();
@@ -1030,7 +1134,16 @@ Status StatsService::informAlarmForSubscriberTriggeringFired() {
     ENFORCE_UID(AID_SYSTEM);
 
     VLOG("StatsService::informAlarmForSubscriberTriggeringFired was called");
-    int64_t currentTimeSec = getElapsedRealtimeSec();
+    // The binder thread returns immediately; the timestamp is captured here so
+    // queueing delay does not shift the alarm's own clock.
+    const int64_t currentTimeSec = getElapsedRealtimeSec();
+    mServiceDispatchQueue.enqueue(DispatchQueue::Priority::kHigh, [this, currentTimeSec] {
+        informAlarmForSubscriberTriggeringFiredInternal(currentTimeSec);
+    });
+    return Status::ok();
+}
+
+void StatsService::informAlarmForSubscriberTriggeringFiredInternal(const int64_t currentTimeSec) {
     std::unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> alarmSet =
             mPeriodicAlarmMonitor->popSoonerThan(static_cast<uint32_t>(currentTimeSec));
     if (alarmSet.size() > 0) {
@@ -1039,18 +1152,35 @@ Status StatsService::informAlarmForSubscriberTriggeringFired() {
     } else {
         ALOGW("Cannot find an periodic alarm that fired. Perhaps it was recently cancelled.");
     }
-    return Status::ok();
+    // The device is awake for this alarm anyway; let imminent anomaly alarms ride
+    // the same wakeup instead of waiting for the next logged event.
+    mProcessor->serviceDueAnomalyAlarms(currentTimeSec * NS_PER_SEC,
+                                        StatsdStats::kAlarmCoalescingSlackSec);
 }
 
 Status StatsService::informPollAlarmFired() {
     ENFORCE_UID(AID_SYSTEM);
 
     VLOG("StatsService::informPollAlarmFired was called");
-    mProcessor->informPullAlarmFired(getElapsedRealtimeNs());
-    VLOG("StatsService::informPollAlarmFired succeeded");
+    const int64_t elapsedRealtimeNs = getElapsedRealtimeNs();
+    mServiceDispatchQueue.enqueue(DispatchQueue::Priority::kHigh, [this, elapsedRealtimeNs] {
+        informPollAlarmFiredInternal(elapsedRealtimeNs);
+    });
     return Status::ok();
 }
 
+void StatsService::informPollAlarmFiredInternal(const int64_t elapsedRealtimeNs) {
+    mProcessor->informPullAlarmFired(elapsedRealtimeNs);
+    // Pull alarms are the most common statsd wakeup; coalesce imminent anomaly
+    // alarms onto them as well.
+    mProcessor->serviceDueAnomalyAlarms(elapsedRealtimeNs,
+                                        StatsdStats::kAlarmCoalescingSlackSec);
+    // The device is awake and no event is being ingested more often than not
+    // when this alarm fires after a quiet period; reclaim burst-time memory.
+    mProcessor->trimMemoryIfIdle(elapsedRealtimeNs);
+    VLOG("StatsService::informPollAlarmFired succeeded");
+}
+
 Status StatsService::systemRunning() {
     ENFORCE_UID(AID_SYSTEM);
 
@@ -1063,6 +1193,8 @@ Status StatsService::systemRunning() {
 Status StatsService::informDeviceShutdown() {
     ENFORCE_UID(AID_SYSTEM);
     VLOG("StatsService::informDeviceShutdown");
+    // Land any queued config pushes and alarm work before persisting state.
+    waitForServiceDispatcher();
     onStatsdInitCompletedHandlerTermination();
     int64_t elapsedRealtimeNs = getElapsedRealtimeNs();
     int64_t wallClockNs = getWallClockNs();
@@ -1127,10 +1259,20 @@ void StatsService::onStatsdInitCompleted() {
         }
     }
 
+    // Boot is settled: take a fresh snapshot of the server flags so runtime flag
+    // queries keep being served from the cache.
+    FlagProvider::getInstance().refreshServerFlagCache();
+
     mProcessor->onStatsdInitCompleted(getElapsedRealtimeNs());
 }
 
+void StatsService::waitForServiceDispatcher() {
+    mServiceDispatchQueue.waitForIdle();
+}
+
 void StatsService::Startup() {
+    // Sweep temp files orphaned by a crash during an atomic report-file commit.
+    StorageManager::deleteOrphanedTempFiles();
     mConfigManager->Startup();
     int64_t wallClockNs = getWallClockNs();
     int64_t elapsedRealtimeNs = getElapsedRealtimeNs();
@@ -1177,15 +1319,23 @@ Status StatsService::getData(int64_t key, const int32_t callingUid, vector<uint8
 Status StatsService::getDataFd(int64_t key, const int32_t callingUid,
                                const ScopedFileDescriptor& fd) {
     ENFORCE_UID(AID_SYSTEM);
-    vector<uint8_t> reportData;
-    getDataChecked(key, callingUid, &reportData);
+    VLOG("StatsService::getDataFd with Uid %i", callingUid);
+    ConfigKey configKey(callingUid, key);
+    // Serialize into the proto's chunked buffer and flush the chunks to the fd, so
+    // the report is never materialized as one contiguous byte vector.
+    // The dump latency does not matter here since we do not include the current bucket, we do not
+    // need to pull any new data anyhow.
+    ProtoOutputStream proto;
+    mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(), getWallClockNs(),
+                             false /* include_current_bucket*/, true /* erase_data */,
+                             GET_DATA_CALLED, FAST, &proto);
 
-    if (reportData.size() >= std::numeric_limits<int32_t>::max()) {
+    if (proto.size() >= std::numeric_limits<int32_t>::max()) {
         ALOGE("Report size is infeasible big and can not be returned");
         return exception(EX_ILLEGAL_STATE, "Report size is infeasible big.");
     }
 
-    const uint32_t bytesToWrite = static_cast<uint32_t>(reportData.size());
+    const uint32_t bytesToWrite = static_cast<uint32_t>(proto.size());
     VLOG("StatsService::getDataFd report size %d", bytesToWrite);
 
     // write 4 bytes of report size for correct buffer allocation
@@ -1193,7 +1343,7 @@ Status StatsService::getDataFd(int64_t key, const int32_t callingUid,
     if (!android::base::WriteFully(fd.get(), &bytesToWriteBE, sizeof(uint32_t))) {
         return exception(EX_ILLEGAL_STATE, "Failed to write report data size to file descriptor");
     }
-    if (!android::base::WriteFully(fd.get(), reportData.data(), reportData.size())) {
+    if (!proto.flush(fd.get())) {
         return exception(EX_ILLEGAL_STATE, "Failed to write report data to file descriptor");
     }
 
@@ -1201,6 +1351,65 @@ Status StatsService::getDataFd(int64_t key, const int32_t callingUid,
     return Status::ok();
 }
 
+Status StatsService::getDataShmem(int64_t key, const int32_t callingUid,
+                                  ScopedFileDescriptor* output) {
+    ENFORCE_UID(AID_SYSTEM);
+    VLOG("StatsService::getDataShmem with Uid %i", callingUid);
+    ConfigKey configKey(callingUid, key);
+    // Serialize into the proto's chunked buffer first; its exact byte count sizes the
+    // ashmem region and the chunks are then written straight into the mapping. The
+    // report never exists as one contiguous private buffer, and the payload never
+    // rides in a binder transaction or through a pipe.
+    // The dump latency does not matter here since we do not include the current bucket, we do not
+    // need to pull any new data anyhow.
+    ProtoOutputStream proto;
+    mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(), getWallClockNs(),
+                             false /* include_current_bucket*/, true /* erase_data */,
+                             GET_DATA_CALLED, FAST, &proto);
+
+    if (proto.size() >= std::numeric_limits<int32_t>::max()) {
+        ALOGE("Report size is infeasible big and can not be returned");
+        return exception(EX_ILLEGAL_STATE, "Report size is infeasible big.");
+    }
+
+    const size_t reportSize = proto.size();
+    VLOG("StatsService::getDataShmem report size %zu", reportSize);
+
+    // ashmem regions cannot be empty; hand back a page-backed region of the report
+    // size rounded up by the kernel, but the caller sizes its read from the region
+    // size it requested, which equals the report size for non-empty reports.
+    const int rawFd = ashmem_create_region("statsd_report", reportSize == 0 ? 1 : reportSize);
+    if (rawFd < 0) {
+        return exception(EX_ILLEGAL_STATE, "Failed to allocate shared memory for report");
+    }
+    ScopedFileDescriptor shmemFd(rawFd);
+
+    if (reportSize > 0) {
+        void* region =
+                mmap(nullptr, reportSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmemFd.get(), 0);
+        if (region == MAP_FAILED) {
+            return exception(EX_ILLEGAL_STATE, "Failed to map shared memory for report");
+        }
+        uint8_t* writePos = static_cast<uint8_t*>(region);
+        sp<android::util::ProtoReader> reader = proto.data();
+        while (reader->readBuffer() != nullptr) {
+            const size_t toRead = reader->currentToRead();
+            memcpy(writePos, reader->readBuffer(), toRead);
+            writePos += toRead;
+            reader->move(toRead);
+        }
+        munmap(region, reportSize);
+    }
+
+    // Seal the region read-only before handing it to the caller.
+    if (ashmem_set_prot_region(shmemFd.get(), PROT_READ) < 0) {
+        return exception(EX_ILLEGAL_STATE, "Failed to seal report shared memory read-only");
+    }
+
+    *output = std::move(shmemFd);
+    return Status::ok();
+}
+
 void StatsService::getDataChecked(int64_t key, const int32_t callingUid, vector<uint8_t>* output) {
     VLOG("StatsService::getData with Uid %i", callingUid);
     ConfigKey configKey(callingUid, key);
@@ -1222,11 +1431,20 @@ Status StatsService::addConfiguration(int64_t key, const vector <uint8_t>& confi
                                       const int32_t callingUid) {
     ENFORCE_UID(AID_SYSTEM);
 
-    if (addConfigurationChecked(callingUid, key, config)) {
-        return Status::ok();
-    } else {
-        return exception(EX_ILLEGAL_ARGUMENT, "Could not parse malformatted StatsdConfig.");
+    // Parse on the binder thread so malformed configs are still rejected
+    // synchronously; the metrics-lock work of applying the config runs on the
+    // dispatch queue, behind any queued alarm notifications.
+    ConfigKey configKey(callingUid, key);
+    auto cfg = std::make_shared<StatsdConfig>();
+    if (config.size() > 0) {  // If the config is empty, skip parsing.
+        if (!cfg->ParseFromArray(&config[0], config.size())) {
+            return exception(EX_ILLEGAL_ARGUMENT, "Could not parse malformatted StatsdConfig.");
+        }
     }
+    mServiceDispatchQueue.enqueue(DispatchQueue::Priority::kDefault, [this, configKey, cfg] {
+        mConfigManager->UpdateConfig(configKey, *cfg);
+    });
+    return Status::ok();
 }
 
 bool StatsService::addConfigurationChecked(int uid, int64_t key, const vector<uint8_t>& config) {
@@ -1288,8 +1506,11 @@ Status StatsService::removeActiveConfigsChangedOperation(const int32_t callingUi
 Status StatsService::removeConfiguration(int64_t key, const int32_t callingUid) {
     ENFORCE_UID(AID_SYSTEM);
 
+    // Queued at the same priority as addConfiguration so a removal can never
+    // overtake a pending push of the same config.
     ConfigKey configKey(callingUid, key);
-    mConfigManager->RemoveConfig(configKey);
+    mServiceDispatchQueue.enqueue(DispatchQueue::Priority::kDefault,
+                                  [this, configKey] { mConfigManager->RemoveConfig(configKey); });
     return Status::ok();
 }
 
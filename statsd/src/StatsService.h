@@ -31,10 +31,12 @@
 #include "anomaly/AlarmMonitor.h"
 #include "config/ConfigManager.h"
 #include "external/StatsPullerManager.h"
+#include "logd/LogEventParsePool.h"
 #include "logd/LogEventQueue.h"
 #include "packages/UidMap.h"
 #include "shell/ShellSubscriber.h"
 #include "statscompanion_util.h"
+#include "utils/DispatchQueue.h"
 #include "utils/MultiConditionTrigger.h"
 
 using namespace android;
@@ -84,6 +86,13 @@ public:
     virtual Status informOnePackageRemoved(const string& app, int32_t uid);
     virtual Status informDeviceShutdown();
 
+    /**
+     * Blocks until all service work enqueued on the dispatch queue so far has
+     * run. Used on shutdown so queued config pushes land before data is
+     * persisted, and by tests to observe the effect of oneway entry points.
+     */
+    void waitForServiceDispatcher();
+
     /**
      * Called right before we start processing events.
      */
@@ -109,6 +118,14 @@ public:
     virtual Status getDataFd(int64_t key, const int32_t callingUid,
                              const ScopedFileDescriptor& fd) override;
 
+    /**
+     * Binder call for clients to request data in an ashmem region. The report is
+     * serialized straight into the returned read-only region, so it is never copied
+     * into a binder transaction and is not subject to the transaction size limit.
+     */
+    virtual Status getDataShmem(int64_t key, const int32_t callingUid,
+                                ScopedFileDescriptor* output) override;
+
     /**
      * Binder call for clients to get metadata across all configs in statsd.
      */
@@ -281,6 +298,13 @@ private:
      */
     void dumpStatsdStats(int outFd, bool verbose, bool proto);
 
+    /**
+     * Formats the text statsdStats dump into a memory-backed buffer, holding the stats
+     * and processor locks only for memory-speed writes. Returns nullptr when no memory
+     * fd could be created.
+     */
+    std::shared_ptr<const std::string> formatStatsdStatsSnapshot(bool verbose);
+
     /**
      * Print usage information for the commands
      */
@@ -361,6 +385,12 @@ private:
      */
     status_t cmd_print_logs(int outFd, const Vector<String8>& args);
 
+    /**
+     * Start or stop recording raw socket payloads for later replay. Only
+     * available on eng/userdebug builds.
+     */
+    status_t cmd_log_socket_capture(int outFd, const Vector<String8>& args);
+
     /**
      * Implementation for request data for the configuration key.
      */
@@ -389,6 +419,13 @@ private:
      */
     bool addConfigurationChecked(int uid, int64_t key, const vector<uint8_t>& config);
 
+    /**
+     * Dispatch-queue bodies of the oneway alarm notifications, with the
+     * timestamps captured on the binder thread at enqueue time.
+     */
+    void informAlarmForSubscriberTriggeringFiredInternal(int64_t currentTimeSec);
+    void informPollAlarmFiredInternal(int64_t elapsedRealtimeNs);
+
     /**
      * Update a configuration.
      */
@@ -468,11 +505,26 @@ private:
      * Mutex for setting the shell subscriber
      */
     mutable mutex mShellSubscriberMutex;
+
+    /**
+     * Preformatted text statsdStats dump, swapped whole under mStatsSnapshotMutex so
+     * dump requests arriving while it is fresh copy a ready buffer instead of
+     * re-formatting under the stats and processor locks. Bugreports and periodic
+     * health polling hit this path back to back.
+     */
+    std::shared_ptr<const std::string> mStatsSnapshot;
+    int64_t mStatsSnapshotElapsedNs = 0;
+    bool mStatsSnapshotVerbose = false;
+    mutable mutex mStatsSnapshotMutex;
     shared_ptr<LogEventQueue> mEventQueue;
     std::shared_ptr<LogEventFilter> mLogEventFilter;
 
     std::unique_ptr<std::thread> mLogsReaderThread;
 
+    // Parallel parse stage between the event queue and the processor, see
+    // LogEventParsePool.
+    std::unique_ptr<LogEventParsePool> mParsePool;
+
     std::condition_variable mStatsdInitCompletedHandlerTerminationFlag;
     std::mutex mStatsdInitCompletedHandlerTerminationFlagMutex;
     /**
@@ -490,6 +542,14 @@ private:
 
     const int mInitEventDelaySecs;
 
+    /**
+     * Runs work handed off by oneway binder entry points. Alarm notifications
+     * are enqueued at high priority so they jump ahead of queued config
+     * pushes. Declared last so it is drained and stopped before the members
+     * its tasks reference are destroyed.
+     */
+    DispatchQueue mServiceDispatchQueue;
+
     friend class StatsServiceConfigTest;
     friend class StatsServiceStatsdInitTest;
     friend class RestrictedConfigE2ETest;
@@ -45,7 +45,7 @@ void AlarmMonitor::setStatsCompanionService(
         return;
     }
     VLOG("Creating link to statsCompanionService");
-    const sp<const InternalAlarm> top = mPq.top();
+    const sp<const InternalAlarm> top = mWheel.top();
     if (top != nullptr) {
         updateRegisteredAlarmTime_l(top->timestampSec);
     }
@@ -64,7 +64,7 @@ void AlarmMonitor::add(const sp<const InternalAlarm>& alarm) {
     }
     // TODO(b/110563466): Ensure that refractory period is respected.
     VLOG("Adding alarm with time %u", alarm->timestampSec);
-    mPq.push(alarm);
+    mWheel.push(alarm);
     if (mRegisteredAlarmTimeSec < 1 ||
         alarm->timestampSec + mMinUpdateTimeSec < mRegisteredAlarmTimeSec) {
         updateRegisteredAlarmTime_l(alarm->timestampSec);
@@ -78,41 +78,92 @@ void AlarmMonitor::remove(const sp<const InternalAlarm>& alarm) {
         return;
     }
     VLOG("Removing alarm with time %u", alarm->timestampSec);
-    bool wasPresent = mPq.remove(alarm);
+    bool wasPresent = mWheel.remove(alarm);
     if (!wasPresent) return;
-    if (mPq.empty()) {
+    if (mWheel.empty()) {
         VLOG("Queue is empty. Cancel any alarm.");
         cancelRegisteredAlarmTime_l();
         return;
     }
-    uint32_t soonestAlarmTimeSec = mPq.top()->timestampSec;
+    uint32_t soonestAlarmTimeSec = mWheel.top()->timestampSec;
     VLOG("Soonest alarm is %u", soonestAlarmTimeSec);
     if (soonestAlarmTimeSec > mRegisteredAlarmTimeSec + mMinUpdateTimeSec) {
         updateRegisteredAlarmTime_l(soonestAlarmTimeSec);
     }
 }
 
-// More efficient than repeatedly calling remove(mPq.top()) since it batches the
-// updates to the registered alarm.
+void AlarmMonitor::addBatch(const std::vector<sp<const InternalAlarm>>& alarms) {
+    std::lock_guard<std::mutex> lock(mLock);
+    uint32_t soonestAddedSec = UINT32_MAX;
+    for (const sp<const InternalAlarm>& alarm : alarms) {
+        if (alarm == nullptr) {
+            ALOGW("Asked to add a null alarm.");
+            continue;
+        }
+        if (alarm->timestampSec < 1) {
+            // forbidden since a timestamp 0 is used to indicate no alarm registered
+            ALOGW("Asked to add a 0-time alarm.");
+            continue;
+        }
+        VLOG("Adding alarm with time %u", alarm->timestampSec);
+        mWheel.push(alarm);
+        if (alarm->timestampSec < soonestAddedSec) {
+            soonestAddedSec = alarm->timestampSec;
+        }
+    }
+    if (soonestAddedSec == UINT32_MAX) {
+        return;
+    }
+    // Reconcile the registered alarm once for the whole batch.
+    if (mRegisteredAlarmTimeSec < 1 ||
+        soonestAddedSec + mMinUpdateTimeSec < mRegisteredAlarmTimeSec) {
+        updateRegisteredAlarmTime_l(soonestAddedSec);
+    }
+}
+
+void AlarmMonitor::removeBatch(const std::vector<sp<const InternalAlarm>>& alarms) {
+    std::lock_guard<std::mutex> lock(mLock);
+    bool removedAny = false;
+    for (const sp<const InternalAlarm>& alarm : alarms) {
+        if (alarm == nullptr) {
+            ALOGW("Asked to remove a null alarm.");
+            continue;
+        }
+        VLOG("Removing alarm with time %u", alarm->timestampSec);
+        removedAny |= mWheel.remove(alarm);
+    }
+    if (!removedAny) {
+        return;
+    }
+    if (mWheel.empty()) {
+        VLOG("Queue is empty. Cancel any alarm.");
+        cancelRegisteredAlarmTime_l();
+        return;
+    }
+    uint32_t soonestAlarmTimeSec = mWheel.top()->timestampSec;
+    VLOG("Soonest alarm is %u", soonestAlarmTimeSec);
+    if (soonestAlarmTimeSec > mRegisteredAlarmTimeSec + mMinUpdateTimeSec) {
+        updateRegisteredAlarmTime_l(soonestAlarmTimeSec);
+    }
+}
+
+// More efficient than repeatedly calling remove() on each expired alarm since the wheel
+// pops whole slots and the updates to the registered alarm are batched.
 unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> AlarmMonitor::popSoonerThan(
         uint32_t timestampSec) {
     VLOG("Removing alarms with time <= %u", timestampSec);
     unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> oldAlarms;
     std::lock_guard<std::mutex> lock(mLock);
 
-    for (sp<const InternalAlarm> t = mPq.top(); t != nullptr && t->timestampSec <= timestampSec;
-        t = mPq.top()) {
-        oldAlarms.insert(t);
-        mPq.pop();  // remove t
-    }
+    mWheel.pop_sooner_than(timestampSec, &oldAlarms);
     // Always update registered alarm time (if anything has changed).
     if (!oldAlarms.empty()) {
-        if (mPq.empty()) {
+        if (mWheel.empty()) {
             VLOG("Queue is empty. Cancel any alarm.");
             cancelRegisteredAlarmTime_l();
         } else {
             // Always update the registered alarm in this case (unlike remove()).
-            updateRegisteredAlarmTime_l(mPq.top()->timestampSec);
+            updateRegisteredAlarmTime_l(mWheel.top()->timestampSec);
         }
     }
     return oldAlarms;
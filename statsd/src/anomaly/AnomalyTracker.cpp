@@ -30,12 +30,18 @@
 #include <statslog_statsd.h>
 #include <time.h>
 
+#include <algorithm>
+
 namespace android {
 namespace os {
 namespace statsd {
 
+// Burst alerts have no num_buckets, so clamp at 0 rather than letting the
+// past-bucket vector be sized from -1.
 AnomalyTracker::AnomalyTracker(const Alert& alert, const ConfigKey& configKey)
-        : mAlert(alert), mConfigKey(configKey), mNumOfPastBuckets(mAlert.num_buckets() - 1) {
+        : mAlert(alert),
+          mConfigKey(configKey),
+          mNumOfPastBuckets(std::max(mAlert.num_buckets() - 1, 0)) {
     VLOG("AnomalyTracker() called");
     resetStorage();  // initialization
 }
@@ -50,10 +56,14 @@ void AnomalyTracker::onConfigUpdated() {
 
 void AnomalyTracker::resetStorage() {
     VLOG("resetStorage() called.");
-    mPastBuckets.clear();
+    mDimIndex.clear();
+    mDimKeys.clear();
+    mDimSums.clear();
+    mDimNonZeroBuckets.clear();
+    mFreeDimIds.clear();
+    mBucketValues.clear();
     // Excludes the current bucket.
-    mPastBuckets.resize(mNumOfPastBuckets);
-    mSumOverPastBuckets.clear();
+    mBucketValues.resize(mNumOfPastBuckets);
 }
 
 size_t AnomalyTracker::index(int64_t bucketNum) const {
@@ -80,11 +90,9 @@ void AnomalyTracker::advanceMostRecentBucketTo(const int64_t bucketNum) {
         return;
     }
 
-    // Clear out space by emptying out old mPastBuckets[i] values and update mSumOverPastBuckets.
+    // Clear out space by zeroing the rotated-out columns, which also updates the sums.
     for (int64_t i = mMostRecentBucketNum + 1; i <= bucketNum; i++) {
-        const int idx = index(i);
-        subtractBucketFromSum(mPastBuckets[idx]);
-        mPastBuckets[idx] = nullptr;  // release (but not clear) the old bucket.
+        clearBucketColumn(index(i));
     }
     mMostRecentBucketNum = bucketNum;
 }
@@ -97,25 +105,11 @@ void AnomalyTracker::addPastBucket(const MetricDimensionKey& key, const int64_t
         return;
     }
 
-    const int bucketIndex = index(bucketNum);
-    if (bucketNum <= mMostRecentBucketNum && (mPastBuckets[bucketIndex] != nullptr)) {
-        // We need to insert into an already existing past bucket.
-        std::shared_ptr<DimToValMap>& bucket = mPastBuckets[bucketIndex];
-        auto itr = bucket->find(key);
-        if (itr != bucket->end()) {
-            // Old entry already exists; update it.
-            subtractValueFromSum(key, itr->second);
-            itr->second = bucketValue;
-        } else {
-            bucket->insert({key, bucketValue});
-        }
-        mSumOverPastBuckets[key] += bucketValue;
-    } else {
-        // Bucket does not exist yet (in future or was never made), so we must make it.
-        std::shared_ptr<DimToValMap> bucket = std::make_shared<DimToValMap>();
-        bucket->insert({key, bucketValue});
-        addPastBucket(bucket, bucketNum);
+    if (bucketNum > mMostRecentBucketNum) {
+        // Clear space for the new bucket to be at bucketNum.
+        advanceMostRecentBucketTo(bucketNum);
     }
+    setBucketValue(index(bucketNum), key, bucketValue);
 }
 
 void AnomalyTracker::addPastBucket(const std::shared_ptr<DimToValMap>& bucket,
@@ -126,45 +120,105 @@ void AnomalyTracker::addPastBucket(const std::shared_ptr<DimToValMap>& bucket,
         return;
     }
 
-    if (bucketNum <= mMostRecentBucketNum) {
-        // We are updating an old bucket, not adding a new one.
-        subtractBucketFromSum(mPastBuckets[index(bucketNum)]);
-    } else {
+    if (bucketNum > mMostRecentBucketNum) {
         // Clear space for the new bucket to be at bucketNum.
         advanceMostRecentBucketTo(bucketNum);
     }
-    mPastBuckets[index(bucketNum)] = bucket;
-    addBucketToSum(bucket);
+    const size_t bucketIndex = index(bucketNum);
+    // The given bucket replaces whatever was stored for bucketNum.
+    clearBucketColumn(bucketIndex);
+    if (bucket != nullptr) {
+        for (const auto& keyValuePair : *bucket) {
+            setBucketValue(bucketIndex, keyValuePair.first, keyValuePair.second);
+        }
+    }
 }
 
-void AnomalyTracker::subtractBucketFromSum(const shared_ptr<DimToValMap>& bucket) {
-    if (bucket == nullptr) {
+void AnomalyTracker::addPastBucket(const std::vector<FlushedSlice>& slices,
+                                   const int64_t bucketNum) {
+    VLOG("addPastBucket(slices) called.");
+    if (mNumOfPastBuckets == 0 ||
+            bucketNum < 0 || bucketNum <= mMostRecentBucketNum - mNumOfPastBuckets) {
         return;
     }
-    for (const auto& keyValuePair : *bucket) {
-        subtractValueFromSum(keyValuePair.first, keyValuePair.second);
+
+    if (bucketNum > mMostRecentBucketNum) {
+        // Clear space for the new bucket to be at bucketNum.
+        advanceMostRecentBucketTo(bucketNum);
+    }
+    const size_t bucketIndex = index(bucketNum);
+    // The given bucket replaces whatever was stored for bucketNum.
+    clearBucketColumn(bucketIndex);
+    for (const FlushedSlice& slice : slices) {
+        setBucketValue(bucketIndex, *slice.key, slice.value);
     }
 }
 
-void AnomalyTracker::subtractValueFromSum(const MetricDimensionKey& key,
-                                          const int64_t bucketValue) {
-    auto itr = mSumOverPastBuckets.find(key);
-    if (itr == mSumOverPastBuckets.end()) {
+int32_t AnomalyTracker::internDimension(const MetricDimensionKey& key) {
+    int32_t dimId;
+    if (!mFreeDimIds.empty()) {
+        dimId = mFreeDimIds.back();
+        mFreeDimIds.pop_back();
+        mDimKeys[dimId] = key;
+    } else {
+        dimId = static_cast<int32_t>(mDimKeys.size());
+        mDimKeys.push_back(key);
+        mDimSums.push_back(0);
+        mDimNonZeroBuckets.push_back(0);
+    }
+    mDimIndex[key] = dimId;
+    return dimId;
+}
+
+void AnomalyTracker::releaseDimensionIfEmpty(const int32_t dimId) {
+    if (mDimNonZeroBuckets[dimId] != 0) {
         return;
     }
-    itr->second -= bucketValue;
-    if (itr->second == 0) {
-        mSumOverPastBuckets.erase(itr);
+    const auto itr = mDimIndex.find(mDimKeys[dimId]);
+    if (itr != mDimIndex.end()) {
+        mDimIndex.erase(itr);
     }
+    mDimKeys[dimId] = MetricDimensionKey();
+    mFreeDimIds.push_back(dimId);
 }
 
-void AnomalyTracker::addBucketToSum(const shared_ptr<DimToValMap>& bucket) {
-    if (bucket == nullptr) {
+void AnomalyTracker::setBucketValue(const size_t bucketIndex, const MetricDimensionKey& key,
+                                    const int64_t value) {
+    const auto itr = mDimIndex.find(key);
+    if (itr == mDimIndex.end() && value == 0) {
+        return;  // 0 is represented by not being stored.
+    }
+    const int32_t dimId = (itr != mDimIndex.end()) ? itr->second : internDimension(key);
+    std::vector<int64_t>& column = mBucketValues[bucketIndex];
+    const int64_t oldValue =
+            (static_cast<size_t>(dimId) < column.size()) ? column[dimId] : 0;
+    if (value == oldValue) {
         return;
     }
-    // For each dimension present in the bucket, add its value to its corresponding sum.
-    for (const auto& keyValuePair : *bucket) {
-        mSumOverPastBuckets[keyValuePair.first] += keyValuePair.second;
+    if (static_cast<size_t>(dimId) >= column.size()) {
+        column.resize(mDimKeys.size(), 0);
+    }
+    column[dimId] = value;
+    mDimSums[dimId] += value - oldValue;
+    if (oldValue == 0) {
+        mDimNonZeroBuckets[dimId]++;
+    } else if (value == 0) {
+        mDimNonZeroBuckets[dimId]--;
+        releaseDimensionIfEmpty(dimId);
+    }
+}
+
+void AnomalyTracker::clearBucketColumn(const size_t bucketIndex) {
+    std::vector<int64_t>& column = mBucketValues[bucketIndex];
+    for (size_t dimId = 0; dimId < column.size(); dimId++) {
+        const int64_t value = column[dimId];
+        if (value == 0) {
+            continue;
+        }
+        column[dimId] = 0;
+        mDimSums[dimId] -= value;
+        mDimNonZeroBuckets[dimId]--;
+        releaseDimensionIfEmpty(static_cast<int32_t>(dimId));
     }
 }
 
@@ -176,18 +230,18 @@ int64_t AnomalyTracker::getPastBucketValue(const MetricDimensionKey& key,
         return 0;
     }
 
-    const auto& bucket = mPastBuckets[index(bucketNum)];
-    if (bucket == nullptr) {
+    const auto itr = mDimIndex.find(key);
+    if (itr == mDimIndex.end()) {
         return 0;
     }
-    const auto& itr = bucket->find(key);
-    return itr == bucket->end() ? 0 : itr->second;
+    const std::vector<int64_t>& column = mBucketValues[index(bucketNum)];
+    return (static_cast<size_t>(itr->second) < column.size()) ? column[itr->second] : 0;
 }
 
 int64_t AnomalyTracker::getSumOverPastBuckets(const MetricDimensionKey& key) const {
-    const auto& itr = mSumOverPastBuckets.find(key);
-    if (itr != mSumOverPastBuckets.end()) {
-        return itr->second;
+    const auto itr = mDimIndex.find(key);
+    if (itr != mDimIndex.end()) {
+        return mDimSums[itr->second];
     }
     return 0;
 }
@@ -212,7 +266,12 @@ void AnomalyTracker::declareAnomaly(const int64_t timestampNs, int64_t metricId,
     }
 
     // TODO(b/110564268): This should also take in the const MetricDimensionKey& key?
-    util::stats_write(util::ANOMALY_DETECTED, mConfigKey.GetUid(), mConfigKey.GetId(), mAlert.id());
+    // Self-telemetry is load-shed when the event queue is backed up, so an
+    // alert storm during overload does not compete with client atoms.
+    if (StatsdStats::getInstance().shouldLogInternalAtom(util::ANOMALY_DETECTED)) {
+        util::stats_write(util::ANOMALY_DETECTED, mConfigKey.GetUid(), mConfigKey.GetId(),
+                          mAlert.id());
+    }
 
     if (mAlert.probability_of_informing() < 1 &&
         ((float)rand() / (float)RAND_MAX) >= mAlert.probability_of_informing()) {
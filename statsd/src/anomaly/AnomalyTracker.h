@@ -27,6 +27,7 @@
 #include "src/statsd_config.pb.h"    // Alert
 #include "src/statsd_metadata.pb.h"  // AlertMetadata
 #include "stats_util.h"              // HashableDimensionKey and DimToValMap
+#include "utils/FlatHashMap.h"
 
 namespace android {
 namespace os {
@@ -57,6 +58,20 @@ public:
     // buckets with 0s.
     void addPastBucket(const std::shared_ptr<DimToValMap>& bucket, const int64_t bucketNum);
 
+    // One flushed slice as handed over by the owning producer: a borrowed key
+    // plus the bucket value. The key pointer is only valid for the duration of
+    // the addPastBucket call; the tracker copies what it needs to retain.
+    struct FlushedSlice {
+        const MetricDimensionKey* key;
+        int64_t value;
+    };
+
+    // Same semantics as the DimToValMap overload, over a read-only view of the
+    // slices the producer just flushed. Producers with several alerts build
+    // the view once per bucket flush and hand the same vector to every
+    // tracker, instead of re-walking their bucket structures per tracker.
+    void addPastBucket(const std::vector<FlushedSlice>& slices, int64_t bucketNum);
+
     // Inserts (or replaces) the bucket entry for the given bucketNum at the given key to be the
     // given bucketValue. If the bucket does not exist, it will be created.
     // Also, advances to bucketNum (if not in the past), effectively filling any intervening
@@ -109,6 +124,11 @@ public:
         return mNumOfPastBuckets;
     }
 
+    // Returns the number of dimensions currently holding data in the past buckets.
+    inline size_t trackedDimensionCount() const {
+        return mDimIndex.size();
+    }
+
     std::pair<optional<InvalidConfigReason>, uint64_t> getProtoHash() const;
 
     // Sets an alarm for the given timestamp.
@@ -129,6 +149,20 @@ public:
         return;  // The base AnomalyTracker class doesn't have alarms.
     }
 
+    // Starts buffering alarm registrations: startAlarm()/stopAlarm() calls up to
+    // the matching commitAlarmBatch() update local state only, and the pending
+    // AlarmMonitor changes are applied in one batch at commit. Used around code
+    // that touches many sliced alarms for one event, e.g. a condition change
+    // fanning out to every duration tracker.
+    virtual void beginAlarmBatch() {
+        return;  // The base AnomalyTracker class doesn't have alarms.
+    }
+
+    // Commits the alarm registrations buffered since beginAlarmBatch().
+    virtual void commitAlarmBatch() {
+        return;  // The base AnomalyTracker class doesn't have alarms.
+    }
+
     // Declares an anomaly for each alarm in firedAlarms that belongs to this AnomalyTracker,
     // and removes it from firedAlarms. Does NOT remove the alarm from the AlarmMonitor.
     virtual void informAlarmsFired(
@@ -169,13 +203,32 @@ protected:
     // for the anomaly detection (since the current bucket is not in the past).
     const int mNumOfPastBuckets;
 
-    // Values for each of the past mNumOfPastBuckets buckets. Always of size mNumOfPastBuckets.
-    // mPastBuckets[i] can be null, meaning that no data is present in that bucket.
-    std::vector<shared_ptr<DimToValMap>> mPastBuckets;
-
-    // Cached sum over all existing buckets in mPastBuckets.
-    // Its buckets never contain entries of 0.
-    DimToValMap mSumOverPastBuckets;
+    // Past bucket values are stored structure-of-arrays: each dimension key is interned
+    // to a small integer id, and mBucketValues keeps one value column per circular bucket
+    // index, indexed by dimension id. Rotation is then a sequential walk of one column
+    // and detection is a single id lookup, with no per-bucket map allocation.
+    //
+    // A dimension id stays assigned while any bucket holds a nonzero value for it and is
+    // recycled through mFreeDimIds once all its values rotate out, so the columns stay
+    // bounded by the number of live dimensions. Value 0 is never stored explicitly
+    // (values are non-negative), which keeps "sum == 0" and "untracked" equivalent.
+
+    // Dimension key -> interned dimension id. Open-addressed so the per-event
+    // detection path avoids chasing node pointers.
+    FlatHashMap<MetricDimensionKey, int32_t> mDimIndex;
+
+    // Dimension id -> key, sum over all past buckets, and number of buckets with a
+    // nonzero value. Indexed in lockstep; slots of recycled ids are all zero.
+    std::vector<MetricDimensionKey> mDimKeys;
+    std::vector<int64_t> mDimSums;
+    std::vector<int32_t> mDimNonZeroBuckets;
+
+    // Recycled dimension ids available for reuse.
+    std::vector<int32_t> mFreeDimIds;
+
+    // One value column per circular bucket index; always of size mNumOfPastBuckets.
+    // Columns grow lazily, so an id at or past a column's size reads as 0.
+    std::vector<std::vector<int64_t>> mBucketValues;
 
     // The bucket number of the last added bucket.
     int64_t mMostRecentBucketNum = -1;
@@ -191,15 +244,19 @@ protected:
     //   [mMostRecentBucketNum - mNumOfPastBuckets + 1, bucketNum - mNumOfPastBuckets].
     void advanceMostRecentBucketTo(int64_t bucketNum);
 
-    // Add the information in the given bucket to mSumOverPastBuckets.
-    void addBucketToSum(const shared_ptr<DimToValMap>& bucket);
+    // Returns the id interned for the key, assigning one (recycled if possible) on
+    // first use.
+    int32_t internDimension(const MetricDimensionKey& key);
+
+    // Recycles the id if no bucket holds a nonzero value for it anymore.
+    void releaseDimensionIfEmpty(int32_t dimId);
 
-    // Subtract the information in the given bucket from mSumOverPastBuckets
-    // and remove any items with value 0.
-    void subtractBucketFromSum(const shared_ptr<DimToValMap>& bucket);
+    // Sets the value for the key in the given column, keeping mDimSums and
+    // mDimNonZeroBuckets in step. A value of 0 for an untracked key is a no-op.
+    void setBucketValue(size_t bucketIndex, const MetricDimensionKey& key, int64_t value);
 
-    // From mSumOverPastBuckets[key], subtracts bucketValue, removing it if it is now 0.
-    void subtractValueFromSum(const MetricDimensionKey& key, int64_t bucketValue);
+    // Zeroes one value column, subtracting each nonzero entry from its dimension's sum.
+    void clearBucketColumn(size_t bucketIndex);
 
     // Returns true if in the refractory period, else false.
     bool isInRefractoryPeriod(int64_t timestampNs, const MetricDimensionKey& key) const;
@@ -216,6 +273,7 @@ protected:
 
     FRIEND_TEST(AnomalyTrackerTest, TestConsecutiveBuckets);
     FRIEND_TEST(AnomalyTrackerTest, TestSparseBuckets);
+    FRIEND_TEST(AnomalyTrackerTest, TestAddPastBucketFlushedSlices);
     FRIEND_TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced);
     FRIEND_TEST(AnomalyDurationDetectionE2eTest, TestDurationMetric_SUM_single_bucket);
     FRIEND_TEST(AnomalyDurationDetectionE2eTest, TestDurationMetric_SUM_partial_bucket);
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "BurstTracker.h"
+
+#include "stats_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+// Caps the number of concurrently tracked dimension slices so a high
+// cardinality burst_dimensions cannot grow rings without bound. Events for
+// slices beyond the cap are dropped for burst detection purposes.
+constexpr size_t kMaxTrackedDimensions = 500;
+
+}  // namespace
+
+BurstTracker::BurstTracker(const Alert& alert, const ConfigKey& configKey)
+    : AnomalyTracker(alert, configKey),
+      mWindowNs(alert.window_millis() * 1000000LL),
+      mRetainedTimestamps(alert.num_occurrences() - 1) {
+    if (alert.has_burst_dimensions()) {
+        translateFieldMatcher(alert.burst_dimensions(), &mDimensions);
+    }
+}
+
+void BurstTracker::resetStorage() {
+    AnomalyTracker::resetStorage();
+    mRings.clear();
+}
+
+MetricDimensionKey BurstTracker::extractDimensionKey(const LogEvent& event) const {
+    if (mDimensions.empty()) {
+        return DEFAULT_METRIC_DIMENSION_KEY;
+    }
+    HashableDimensionKey dimensionKey;
+    filterValues(mDimensions, event.getValues(), &dimensionKey);
+    return MetricDimensionKey(dimensionKey, DEFAULT_DIMENSION_KEY);
+}
+
+void BurstTracker::noteMatchedEvent(const LogEvent& event) {
+    const int64_t eventTimeNs = event.GetElapsedTimestampNs();
+    const MetricDimensionKey key = extractDimensionKey(event);
+
+    auto it = mRings.find(key);
+    if (it == mRings.end()) {
+        if (mRings.size() >= kMaxTrackedDimensions) {
+            return;
+        }
+        it = mRings.emplace(key, TimestampRing()).first;
+        it->second.timestampsNs.resize(mRetainedTimestamps, 0);
+    }
+    TimestampRing& ring = it->second;
+
+    // With the ring full, ring.timestampsNs[ring.next] is the timestamp of the
+    // (num_occurrences - 1)-th previous event: this event completes a burst iff
+    // that predecessor is still inside the window. declareAnomaly() applies the
+    // refractory period and informs the subscribers.
+    if (ring.full && eventTimeNs - ring.timestampsNs[ring.next] <= mWindowNs) {
+        declareAnomaly(eventTimeNs, mAlert.atom_matcher_id(), key, mAlert.num_occurrences());
+    }
+
+    ring.timestampsNs[ring.next] = eventTimeNs;
+    ring.next = (ring.next + 1) % mRetainedTimestamps;
+    if (ring.next == 0) {
+        ring.full = true;
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
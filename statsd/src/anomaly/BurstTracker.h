@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtest/gtest_prod.h>
+
+#include <vector>
+
+#include "AnomalyTracker.h"
+#include "FieldValue.h"
+#include "logd/LogEvent.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Watches an AtomMatcher directly and declares an anomaly when at least
+// num_occurrences matched events arrive within window_millis for one
+// burst_dimensions slice. Detection is O(1) per event: each slice keeps a
+// ring buffer of the last (num_occurrences - 1) event timestamps, so a burst
+// check is a single comparison against the oldest retained timestamp.
+// Declared anomalies flow through the regular AnomalyTracker refractory and
+// subscriber machinery. This replaces the 1-second bucket configurations
+// previously needed to approximate burst alerts, which multiplied bucket
+// rotation work across producers and still missed sub-second bursts.
+class BurstTracker : public AnomalyTracker {
+public:
+    BurstTracker(const Alert& alert, const ConfigKey& configKey);
+
+    // Processes one event matched by the watched AtomMatcher; declares an
+    // anomaly if the event completes a burst for its dimension slice.
+    void noteMatchedEvent(const LogEvent& event);
+
+protected:
+    void resetStorage() override;
+
+private:
+    // Circular buffer of the last (num_occurrences - 1) event timestamps of
+    // one dimension slice. Once full, `next` points at the oldest entry.
+    struct TimestampRing {
+        std::vector<int64_t> timestampsNs;
+        size_t next = 0;
+        bool full = false;
+    };
+
+    MetricDimensionKey extractDimensionKey(const LogEvent& event) const;
+
+    const int64_t mWindowNs;
+
+    // num_occurrences - 1: the event that completes the burst is not stored
+    // before the check, so only its predecessors need retaining.
+    const size_t mRetainedTimestamps;
+
+    // Dimension fields the burst is sliced by; empty means one global ring.
+    std::vector<Matcher> mDimensions;
+
+    std::unordered_map<MetricDimensionKey, TimestampRing> mRings;
+
+    FRIEND_TEST(BurstTrackerTest, TestBurstWithinWindow);
+    FRIEND_TEST(BurstTrackerTest, TestNoBurstOutsideWindow);
+    FRIEND_TEST(BurstTrackerTest, TestSlicedBursts);
+    FRIEND_TEST(BurstTrackerTest, TestRefractoryPeriod);
+    FRIEND_TEST(BurstTrackerTest, TestDimensionGuardrail);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -18,6 +18,9 @@
 #include "Log.h"
 
 #include "DurationAnomalyTracker.h"
+
+#include <algorithm>
+
 #include "guardrail/StatsdStats.h"
 
 namespace android {
@@ -45,15 +48,13 @@ void DurationAnomalyTracker::startAlarm(const MetricDimensionKey& dimensionKey,
     }
 
     auto itr = mAlarms.find(dimensionKey);
-    if (itr != mAlarms.end() && mAlarmMonitor != nullptr) {
-        mAlarmMonitor->remove(itr->second);
+    if (itr != mAlarms.end()) {
+        noteAlarmRemoved(itr->second);
     }
 
     sp<const InternalAlarm> alarm = new InternalAlarm{timestampSec};
     mAlarms[dimensionKey] = alarm;
-    if (mAlarmMonitor != nullptr) {
-        mAlarmMonitor->add(alarm);
-    }
+    noteAlarmAdded(alarm);
 }
 
 void DurationAnomalyTracker::stopAlarm(const MetricDimensionKey& dimensionKey,
@@ -69,19 +70,59 @@ void DurationAnomalyTracker::stopAlarm(const MetricDimensionKey& dimensionKey,
                        mAlert.trigger_if_sum_gt() + (timestampNs / NS_PER_SEC) -
                                itr->second->timestampSec);
     }
-    if (mAlarmMonitor != nullptr) {
-        mAlarmMonitor->remove(itr->second);
-    }
+    noteAlarmRemoved(itr->second);
     mAlarms.erase(dimensionKey);
 }
 
 void DurationAnomalyTracker::cancelAllAlarms() {
+    for (const auto& itr : mAlarms) {
+        noteAlarmRemoved(itr.second);
+    }
+    mAlarms.clear();
+}
+
+void DurationAnomalyTracker::noteAlarmAdded(const sp<const InternalAlarm>& alarm) {
+    if (mBatchingAlarms) {
+        mPendingAlarmAdds.push_back(alarm);
+    } else if (mAlarmMonitor != nullptr) {
+        mAlarmMonitor->add(alarm);
+    }
+}
+
+void DurationAnomalyTracker::noteAlarmRemoved(const sp<const InternalAlarm>& alarm) {
+    if (!mBatchingAlarms) {
+        if (mAlarmMonitor != nullptr) {
+            mAlarmMonitor->remove(alarm);
+        }
+        return;
+    }
+    // If the alarm was added in this same batch it never reached the monitor;
+    // dropping the pending add cancels it, and keeps the commit from removing a
+    // not-yet-present alarm and then re-adding it.
+    auto pending = std::find(mPendingAlarmAdds.begin(), mPendingAlarmAdds.end(), alarm);
+    if (pending != mPendingAlarmAdds.end()) {
+        mPendingAlarmAdds.erase(pending);
+        return;
+    }
+    mPendingAlarmRemoves.push_back(alarm);
+}
+
+void DurationAnomalyTracker::beginAlarmBatch() {
+    mBatchingAlarms = true;
+}
+
+void DurationAnomalyTracker::commitAlarmBatch() {
+    mBatchingAlarms = false;
     if (mAlarmMonitor != nullptr) {
-        for (const auto& itr : mAlarms) {
-            mAlarmMonitor->remove(itr.second);
+        if (!mPendingAlarmRemoves.empty()) {
+            mAlarmMonitor->removeBatch(mPendingAlarmRemoves);
+        }
+        if (!mPendingAlarmAdds.empty()) {
+            mAlarmMonitor->addBatch(mPendingAlarmAdds);
         }
     }
-    mAlarms.clear();
+    mPendingAlarmRemoves.clear();
+    mPendingAlarmAdds.clear();
 }
 
 void DurationAnomalyTracker::informAlarmsFired(
@@ -44,6 +44,12 @@ public:
     // Stop all the alarms owned by this tracker. Does not declare any anomalies.
     void cancelAllAlarms() override;
 
+    // See AnomalyTracker. The caller is responsible for pairing every
+    // beginAlarmBatch() with a commitAlarmBatch(); alarms buffered in between
+    // are not registered with the AlarmMonitor until commit.
+    void beginAlarmBatch() override;
+    void commitAlarmBatch() override;
+
     // Declares an anomaly for each alarm in firedAlarms that belongs to this DurationAnomalyTracker
     // and removes it from firedAlarms. The AlarmMonitor is not informed.
     // Note that this will generally be called from a different thread from the other functions;
@@ -67,6 +73,21 @@ protected:
     // Anomaly alarm monitor.
     sp<AlarmMonitor> mAlarmMonitor;
 
+    // Registers the alarm with the monitor, or buffers it while a batch is open.
+    void noteAlarmAdded(const sp<const InternalAlarm>& alarm);
+
+    // Unregisters the alarm from the monitor, or buffers the cancellation while
+    // a batch is open. An alarm both added and removed inside the same batch
+    // never reaches the monitor at all.
+    void noteAlarmRemoved(const sp<const InternalAlarm>& alarm);
+
+    // True between beginAlarmBatch() and commitAlarmBatch().
+    bool mBatchingAlarms = false;
+
+    // AlarmMonitor changes buffered while mBatchingAlarms is set.
+    std::vector<sp<const InternalAlarm>> mPendingAlarmAdds;
+    std::vector<sp<const InternalAlarm>> mPendingAlarmRemoves;
+
     FRIEND_TEST(OringDurationTrackerTest, TestPredictAnomalyTimestamp);
     FRIEND_TEST(OringDurationTrackerTest, TestAnomalyDetectionExpiredAlarm);
     FRIEND_TEST(OringDurationTrackerTest, TestAnomalyDetectionFiredAlarm);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "SubscriberDispatcher.h"
+
+#include "external/Perfetto.h"
+#include "subscriber/IncidentdReporter.h"
+#include "subscriber/SubscriberReporter.h"
+#include "utils/ThreadPolicy.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+SubscriberDispatcher& SubscriberDispatcher::getInstance() {
+    static SubscriberDispatcher dispatcher;
+    return dispatcher;
+}
+
+SubscriberDispatcher::~SubscriberDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopRequested = true;
+    }
+    mCondition.notify_one();
+    if (mWorkerStarted) {
+        mWorker.join();
+    }
+}
+
+void SubscriberDispatcher::dispatch(const Subscription& subscription, const int64_t ruleId,
+                                    const int64_t metricId, const MetricDimensionKey& dimensionKey,
+                                    const int64_t metricValue, const ConfigKey& configKey) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPending.push_back(
+                {subscription, ruleId, metricId, dimensionKey, metricValue, configKey});
+        // The worker is started on first use so that processes which never trigger a
+        // subscriber do not pay for a thread.
+        if (!mWorkerStarted) {
+            mWorker = std::thread([this] { workerLoop(); });
+            mWorkerStarted = true;
+        }
+    }
+    mCondition.notify_one();
+}
+
+void SubscriberDispatcher::workerLoop() {
+    ThreadPolicy::getInstance().applyRole(ThreadRole::BACKGROUND_WORKER);
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] { return mStopRequested || !mPending.empty(); });
+        if (mPending.empty()) {
+            // Stop requested and nothing left to deliver.
+            return;
+        }
+        // Drain the whole backlog in one swap, then deliver without the lock so
+        // enqueueing never waits on receiver work.
+        std::vector<PendingTrigger> batch;
+        batch.swap(mPending);
+        lock.unlock();
+        for (const PendingTrigger& trigger : batch) {
+            deliver(trigger);
+        }
+        lock.lock();
+    }
+}
+
+void SubscriberDispatcher::deliver(const PendingTrigger& trigger) {
+    const Subscription& subscription = trigger.subscription;
+    switch (subscription.subscriber_information_case()) {
+        case Subscription::SubscriberInformationCase::kIncidentdDetails:
+            if (!GenerateIncidentReport(subscription.incidentd_details(), trigger.ruleId,
+                                        trigger.metricId, trigger.dimensionKey,
+                                        trigger.metricValue, trigger.configKey)) {
+                ALOGW("Failed to generate incident report.");
+            }
+            break;
+        case Subscription::SubscriberInformationCase::kPerfettoDetails:
+            if (!CollectPerfettoTraceAndUploadToDropbox(subscription.perfetto_details(),
+                                                        subscription.id(), trigger.ruleId,
+                                                        trigger.configKey)) {
+                ALOGW("Failed to generate perfetto traces.");
+            }
+            break;
+        case Subscription::SubscriberInformationCase::kBroadcastSubscriberDetails:
+            SubscriberReporter::getInstance().alertBroadcastSubscriber(
+                    trigger.configKey, subscription, trigger.dimensionKey);
+            break;
+        default:
+            break;
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
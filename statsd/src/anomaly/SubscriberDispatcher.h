@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "HashableDimensionKey.h"
+#include "config/ConfigKey.h"
+#include "src/statsd_config.pb.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Delivers triggered subscriptions to their receivers on a dedicated worker
+ * thread, so that anomaly declaration on the metric hot path never blocks on
+ * incidentd, perfetto or a subscriber's broadcast binder call.
+ *
+ * Enqueueing only appends the trigger record to the pending list under a
+ * briefly-held lock and wakes the worker; all receiver work happens on the
+ * worker thread, outside any metric lock.
+ */
+class SubscriberDispatcher {
+public:
+    static SubscriberDispatcher& getInstance();
+
+    SubscriberDispatcher(const SubscriberDispatcher&) = delete;
+    SubscriberDispatcher& operator=(const SubscriberDispatcher&) = delete;
+
+    // Queues one triggered subscription for delivery. Non-blocking.
+    void dispatch(const Subscription& subscription, int64_t ruleId, int64_t metricId,
+                  const MetricDimensionKey& dimensionKey, int64_t metricValue,
+                  const ConfigKey& configKey);
+
+private:
+    struct PendingTrigger {
+        Subscription subscription;
+        int64_t ruleId;
+        int64_t metricId;
+        MetricDimensionKey dimensionKey;
+        int64_t metricValue;
+        ConfigKey configKey;
+    };
+
+    SubscriberDispatcher() = default;
+    ~SubscriberDispatcher();
+
+    // Performs the receiver-specific work for one trigger. Worker thread only.
+    void deliver(const PendingTrigger& trigger);
+
+    void workerLoop();
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<PendingTrigger> mPending;
+    bool mStopRequested = false;
+    bool mWorkerStarted = false;
+    std::thread mWorker;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/RefBase.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "anomaly/indexed_priority_queue.h"  // SpHash
+
+using namespace android;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Hierarchical timer wheel for generic type AA, keyed on AA::timestampSec.
+ *
+ * Holds the same elements as a min priority queue of alarms, but insert and cancel are O(1)
+ * instead of O(log n): an element lands in one of four levels of 256 slots by how far its
+ * timestamp lies from the wheel's current time (1 s, 256 s, ~18 h, ~194 d of horizon per
+ * slot), and expiry pops whole slots as the wheel advances, cascading coarser slots into
+ * finer ones at window boundaries. With thousands of concurrent sliced duration alarms this
+ * keeps per-start/stop alarm maintenance constant-time and batches expirations.
+ *
+ * @tparam AA must expose a [const uint32_t timestampSec] member (seconds since epoch).
+ */
+template <class AA>
+class timer_wheel {
+public:
+    /** Adds a into the wheel. If already present or a==nullptr, does nothing. */
+    void push(sp<const AA> a);
+
+    /*
+     * Removes a from the wheel. If not present or a==nullptr, does nothing.
+     * Returns true if a had been present (and is now removed), else false.
+     */
+    bool remove(sp<const AA> a);
+
+    /** Returns whether the wheel contains a (not just a copy of a, but a itself). */
+    bool contains(sp<const AA> a) const;
+
+    /** Returns the element with the soonest timestampSec. Returns nullptr iff empty(). */
+    sp<const AA> top() const;
+
+    /**
+     * Removes all elements with timestampSec <= timestampSec and inserts them into out,
+     * advancing the wheel's current time to just past timestampSec. The given timestamps
+     * must be non-decreasing across calls (they are wall-clock "now" at each firing).
+     */
+    void pop_sooner_than(uint32_t timestampSec,
+                         std::unordered_set<sp<const AA>, SpHash<AA>>* out);
+
+    bool empty() const {
+        return mSize == 0;
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+private:
+    static constexpr int kLevels = 4;
+    static constexpr uint32_t kSlotBits = 8;
+    static constexpr uint32_t kSlotsPerLevel = 1 << kSlotBits;
+    static constexpr uint32_t kSlotMask = kSlotsPerLevel - 1;
+    // Location value for elements that were already due when pushed.
+    static constexpr uint16_t kOverdue = 0xffff;
+
+    static uint16_t locationOf(int level, uint32_t index) {
+        return static_cast<uint16_t>((level << kSlotBits) | index);
+    }
+
+    /** Files a with timestampSec >= mBaseSec into the slot its distance selects. */
+    void place(const sp<const AA>& a) {
+        const uint32_t delta = a->timestampSec - mBaseSec;
+        int level = 0;
+        while (level < kLevels - 1 && (delta >> (kSlotBits * (level + 1))) != 0) {
+            level++;
+        }
+        const uint32_t index = (a->timestampSec >> (kSlotBits * level)) & kSlotMask;
+        mSlots[level][index].push_back(a);
+        mLocations[a.get()] = locationOf(level, index);
+        mLevelCount[level]++;
+    }
+
+    /**
+     * Redistributes coarser slots into finer ones when mBaseSec crosses their window
+     * boundary. Must be called whenever (mBaseSec & kSlotMask) == 0. Works top-down so
+     * elements cascading out of level N can land in the level N-1 slot being refilled.
+     */
+    void cascade() {
+        int maxLevel = 0;
+        for (int level = 1; level < kLevels; level++) {
+            if ((mBaseSec & ((1u << (kSlotBits * level)) - 1)) == 0) {
+                maxLevel = level;
+            }
+        }
+        for (int level = maxLevel; level >= 1; level--) {
+            const uint32_t index = (mBaseSec >> (kSlotBits * level)) & kSlotMask;
+            std::vector<sp<const AA>> pending;
+            pending.swap(mSlots[level][index]);
+            mLevelCount[level] -= pending.size();
+            for (const sp<const AA>& a : pending) {
+                place(a);
+            }
+        }
+    }
+
+    /** Collects an entire slot (or the overdue list) into out and drops the locations. */
+    void collectSlot(std::vector<sp<const AA>>& slot,
+                     std::unordered_set<sp<const AA>, SpHash<AA>>* out) {
+        for (const sp<const AA>& a : slot) {
+            mLocations.erase(a.get());
+            out->insert(a);
+            mSize--;
+        }
+        slot.clear();
+    }
+
+    std::vector<sp<const AA>> mSlots[kLevels][kSlotsPerLevel];
+
+    /** Elements pushed with a timestamp before mBaseSec; drained by pop_sooner_than. */
+    std::vector<sp<const AA>> mOverdue;
+
+    /** Current slot of each live element, so remove() is a map lookup plus a short scan. */
+    std::unordered_map<const AA*, uint16_t> mLocations;
+
+    /** Live elements per level; lets the wheel skip empty windows when advancing. */
+    size_t mLevelCount[kLevels] = {};
+
+    /** The wheel's current time: every wheel element has timestampSec >= mBaseSec. */
+    uint32_t mBaseSec = 0;
+
+    size_t mSize = 0;
+};
+
+template <class AA>
+void timer_wheel<AA>::push(sp<const AA> a) {
+    if (a == nullptr || contains(a)) {
+        return;
+    }
+    if (mSize == 0) {
+        // Nothing pending between the old base and now; rebase so the new element sits in
+        // the finest level instead of forcing a long advance later.
+        mBaseSec = a->timestampSec;
+    }
+    mSize++;
+    if (a->timestampSec < mBaseSec) {
+        mOverdue.push_back(a);
+        mLocations[a.get()] = kOverdue;
+        return;
+    }
+    place(a);
+}
+
+template <class AA>
+bool timer_wheel<AA>::remove(sp<const AA> a) {
+    if (a == nullptr) {
+        return false;
+    }
+    auto it = mLocations.find(a.get());
+    if (it == mLocations.end()) {
+        return false;
+    }
+    std::vector<sp<const AA>>* slot;
+    if (it->second == kOverdue) {
+        slot = &mOverdue;
+    } else {
+        const int level = it->second >> kSlotBits;
+        slot = &mSlots[level][it->second & kSlotMask];
+        mLevelCount[level]--;
+    }
+    for (size_t i = 0; i < slot->size(); i++) {
+        if ((*slot)[i] == a) {
+            (*slot)[i] = std::move(slot->back());
+            slot->pop_back();
+            break;
+        }
+    }
+    mLocations.erase(it);
+    mSize--;
+    return true;
+}
+
+template <class AA>
+bool timer_wheel<AA>::contains(sp<const AA> a) const {
+    return a != nullptr && mLocations.find(a.get()) != mLocations.end();
+}
+
+template <class AA>
+sp<const AA> timer_wheel<AA>::top() const {
+    sp<const AA> soonest = nullptr;
+    for (const sp<const AA>& a : mOverdue) {
+        if (soonest == nullptr || a->timestampSec < soonest->timestampSec) {
+            soonest = a;
+        }
+    }
+    if (soonest != nullptr) {
+        return soonest;
+    }
+    // Elements cascade to finer levels only at window boundaries, so between boundaries a
+    // coarse slot can briefly hold a sooner timestamp than a fine one; each level's first
+    // occupied slot (in wraparound order from the wheel's position, which is timestamp
+    // order within a level) yields a candidate and the overall minimum wins.
+    for (int level = 0; level < kLevels; level++) {
+        if (mLevelCount[level] == 0) {
+            continue;
+        }
+        const uint32_t start = (mBaseSec >> (kSlotBits * level)) & kSlotMask;
+        for (uint32_t offset = 0; offset < kSlotsPerLevel; offset++) {
+            const std::vector<sp<const AA>>& slot = mSlots[level][(start + offset) & kSlotMask];
+            if (slot.empty()) {
+                continue;
+            }
+            for (const sp<const AA>& a : slot) {
+                if (soonest == nullptr || a->timestampSec < soonest->timestampSec) {
+                    soonest = a;
+                }
+            }
+            break;
+        }
+    }
+    return soonest;
+}
+
+template <class AA>
+void timer_wheel<AA>::pop_sooner_than(uint32_t timestampSec,
+                                      std::unordered_set<sp<const AA>, SpHash<AA>>* out) {
+    for (size_t i = 0; i < mOverdue.size();) {
+        if (mOverdue[i]->timestampSec <= timestampSec) {
+            mLocations.erase(mOverdue[i].get());
+            out->insert(mOverdue[i]);
+            mSize--;
+            mOverdue[i] = std::move(mOverdue.back());
+            mOverdue.pop_back();
+        } else {
+            i++;
+        }
+    }
+    while (mBaseSec <= timestampSec) {
+        if (mSize == mOverdue.size()) {
+            // The wheel proper is empty; nothing left to expire before timestampSec.
+            mBaseSec = timestampSec + 1;
+            return;
+        }
+        if ((mBaseSec & kSlotMask) == 0) {
+            cascade();
+        }
+        if (mLevelCount[0] == 0) {
+            // Skip to the end of this empty 256 s window (or to the target if closer).
+            const uint32_t windowEnd = (mBaseSec | kSlotMask) + 1;
+            if (windowEnd == 0 || windowEnd > timestampSec) {
+                mBaseSec = timestampSec + 1;
+                return;
+            }
+            mBaseSec = windowEnd;
+            continue;
+        }
+        std::vector<sp<const AA>>& slot = mSlots[0][mBaseSec & kSlotMask];
+        mLevelCount[0] -= slot.size();
+        collectSlot(slot, out);
+        mBaseSec++;
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
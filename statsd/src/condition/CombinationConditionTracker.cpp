@@ -36,7 +36,7 @@ CombinationConditionTracker::~CombinationConditionTracker() {
 }
 
 optional<InvalidConfigReason> CombinationConditionTracker::init(
-        const vector<Predicate>& allConditionConfig,
+        const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionConfig,
         const vector<sp<ConditionTracker>>& allConditionTrackers,
         const unordered_map<int64_t, int>& conditionIdIndexMap, vector<uint8_t>& stack,
         vector<ConditionState>& conditionCache) {
@@ -62,7 +62,7 @@ optional<InvalidConfigReason> CombinationConditionTracker::init(
     // mark this node as visited in the recursion stack.
     stack[mIndex] = true;
 
-    Predicate_Combination combinationCondition = allConditionConfig[mIndex].combination();
+    const Predicate_Combination& combinationCondition = allConditionConfig[mIndex].combination();
     optional<InvalidConfigReason> invalidConfigReason;
 
     if (!combinationCondition.has_operation()) {
@@ -134,7 +134,7 @@ optional<InvalidConfigReason> CombinationConditionTracker::init(
 }
 
 optional<InvalidConfigReason> CombinationConditionTracker::onConfigUpdated(
-        const vector<Predicate>& allConditionProtos, const int index,
+        const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionProtos, const int index,
         const vector<sp<ConditionTracker>>& allConditionTrackers,
         const unordered_map<int64_t, int>& atomMatchingTrackerMap,
         const unordered_map<int64_t, int>& conditionTrackerMap) {
@@ -144,7 +144,7 @@ optional<InvalidConfigReason> CombinationConditionTracker::onConfigUpdated(
     mChildren.clear();
     mUnSlicedChildren.clear();
     mSlicedChildren.clear();
-    Predicate_Combination combinationCondition = allConditionProtos[mIndex].combination();
+    const Predicate_Combination& combinationCondition = allConditionProtos[mIndex].combination();
     optional<InvalidConfigReason> invalidConfigReason;
 
     for (const int64_t child : combinationCondition.predicate()) {
@@ -200,7 +200,7 @@ void CombinationConditionTracker::isConditionMet(
 }
 
 void CombinationConditionTracker::evaluateCondition(
-        const LogEvent& event, const std::vector<MatchingState>& eventMatcherValues,
+        const LogEvent& event, const MatchingStateBitset& eventMatcherValues,
         const std::vector<sp<ConditionTracker>>& mAllConditions,
         std::vector<ConditionState>& nonSlicedConditionCache,
         std::vector<uint8_t>& conditionChangedCache) {
@@ -209,10 +209,27 @@ void CombinationConditionTracker::evaluateCondition(
         return;
     }
 
+    // Dirty check: when none of the matchers this subtree depends on matched the event, no
+    // descendant state can have changed, so reuse the cached result instead of recursing.
+    // For deep condition nests this prunes every branch the event does not touch.
+    if (mLastConditionCache != ConditionState::kNotEvaluated &&
+        !isAffectedByEvent(eventMatcherValues)) {
+        nonSlicedConditionCache[mIndex] = mLastConditionCache;
+        conditionChangedCache[mIndex] = false;
+        return;
+    }
+
     for (const int childIndex : mChildren) {
         // So far, this is fine as there is at most one child having sliced output.
         if (nonSlicedConditionCache[childIndex] == ConditionState::kNotEvaluated) {
             const sp<ConditionTracker>& child = mAllConditions[childIndex];
+            // Clean children report their cached value without re-evaluation.
+            if (child->getLastConditionCache() != ConditionState::kNotEvaluated &&
+                !child->isAffectedByEvent(eventMatcherValues)) {
+                nonSlicedConditionCache[childIndex] = child->getLastConditionCache();
+                conditionChangedCache[childIndex] = false;
+                continue;
+            }
             child->evaluateCondition(event, eventMatcherValues, mAllConditions,
                                      nonSlicedConditionCache, conditionChangedCache);
         }
@@ -220,6 +237,17 @@ void CombinationConditionTracker::evaluateCondition(
 
     ConditionState newCondition =
             evaluateCombinationCondition(mChildren, mLogicalOperation, nonSlicedConditionCache);
+
+    // The combination result is reusable only when every child reported a reusable value;
+    // a sliced child that just handled a matched event reports a per-dimension state instead.
+    bool childrenStable = true;
+    for (const int childIndex : mChildren) {
+        if (mAllConditions[childIndex]->getLastConditionCache() == ConditionState::kNotEvaluated) {
+            childrenStable = false;
+            break;
+        }
+    }
+    mLastConditionCache = childrenStable ? newCondition : ConditionState::kNotEvaluated;
     if (!mSliced) {
         bool nonSlicedChanged = (mUnSlicedPartCondition != newCondition);
         mUnSlicedPartCondition = newCondition;
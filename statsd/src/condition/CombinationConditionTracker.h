@@ -31,19 +31,19 @@ public:
     ~CombinationConditionTracker();
 
     optional<InvalidConfigReason> init(
-            const std::vector<Predicate>& allConditionConfig,
+            const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionConfig,
             const std::vector<sp<ConditionTracker>>& allConditionTrackers,
             const std::unordered_map<int64_t, int>& conditionIdIndexMap,
             std::vector<uint8_t>& stack, std::vector<ConditionState>& conditionCache) override;
 
     optional<InvalidConfigReason> onConfigUpdated(
-            const std::vector<Predicate>& allConditionProtos, int index,
+            const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionProtos, int index,
             const std::vector<sp<ConditionTracker>>& allConditionTrackers,
             const std::unordered_map<int64_t, int>& atomMatchingTrackerMap,
             const std::unordered_map<int64_t, int>& conditionTrackerMap) override;
 
     void evaluateCondition(const LogEvent& event,
-                           const std::vector<MatchingState>& eventMatcherValues,
+                           const MatchingStateBitset& eventMatcherValues,
                            const std::vector<sp<ConditionTracker>>& mAllConditions,
                            std::vector<ConditionState>& conditionCache,
                            std::vector<uint8_t>& changedCache) override;
@@ -79,6 +79,10 @@ public:
 
     bool IsSimpleCondition() const  override { return false; }
 
+    const std::vector<int>& getChildConditionIndexes() const override {
+        return mChildren;
+    }
+
     bool IsChangedDimensionTrackable() const  override {
         return mLogicalOperation == LogicalOperation::AND && mSlicedChildren.size() == 1;
     }
@@ -87,7 +91,7 @@ public:
         const std::vector<sp<ConditionTracker>>& allConditions,
         const vector<Matcher>& dimensions) const override;
 
-    const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(
+    const SlicedConditionStateMap* getSlicedDimensionMap(
             const std::vector<sp<ConditionTracker>>& allConditions) const override {
         if (mSlicedChildren.size() == 1) {
             return allConditions[mSlicedChildren.front()]->getSlicedDimensionMap(allConditions);
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "condition/ConditionTimer.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * A shared, append-only log of one condition's transitions.
+ *
+ * Many metrics in a config commonly gate on the same condition (screen state,
+ * charging, ...). Updating every producer's ConditionTimer eagerly turns one
+ * condition toggle into N timer updates. Instead, MetricsManager records each
+ * transition here once, and every subscribed timer replays the edges it has
+ * not consumed yet right before it closes a bucket. The replay performs
+ * exactly the updates the eager path would have, in the same order, so bucket
+ * durations and delayed-close corrections are unchanged.
+ *
+ * Like ConditionTimer, this class is *NOT* thread safe; the owner serializes
+ * access the same way it serializes metric updates.
+ */
+class ConditionTimeline {
+public:
+    explicit ConditionTimeline(bool initState) : mCurrentState(initState) {
+    }
+
+    void onConditionChanged(bool newState, int64_t timestampNs) {
+        if (newState == mCurrentState) {
+            return;
+        }
+        mCurrentState = newState;
+        mEdges.push_back({timestampNs, newState});
+    }
+
+    // Registers a subscriber positioned at the current end of the log and
+    // returns its cursor id. Cursors live as long as the timeline does.
+    int createCursor() {
+        mCursors.push_back(mFirstEdgeIndex + mEdges.size());
+        return static_cast<int>(mCursors.size()) - 1;
+    }
+
+    // Replays the edges with timestamp <= upToNs that this cursor has not
+    // consumed yet into timer, then drops the edges every cursor is past.
+    void replayInto(int cursorId, int64_t upToNs, ConditionTimer& timer) {
+        uint64_t& cursor = mCursors[cursorId];
+        while (cursor - mFirstEdgeIndex < mEdges.size() &&
+               mEdges[cursor - mFirstEdgeIndex].timestampNs <= upToNs) {
+            const Edge& edge = mEdges[cursor - mFirstEdgeIndex];
+            timer.onConditionChanged(edge.state, edge.timestampNs);
+            cursor++;
+        }
+        pruneConsumed();
+    }
+
+private:
+    struct Edge {
+        int64_t timestampNs;
+        bool state;
+    };
+
+    void pruneConsumed() {
+        uint64_t minCursor = mCursors[0];
+        for (const uint64_t cursor : mCursors) {
+            minCursor = std::min(minCursor, cursor);
+        }
+        while (mFirstEdgeIndex < minCursor && !mEdges.empty()) {
+            mEdges.pop_front();
+            mFirstEdgeIndex++;
+        }
+    }
+
+    std::deque<Edge> mEdges;
+
+    // Logical index of mEdges.front(). Cursors hold logical indexes, so
+    // pruning the front of the deque does not invalidate them.
+    uint64_t mFirstEdgeIndex = 0;
+
+    std::vector<uint64_t> mCursors;
+
+    bool mCurrentState;
+};
+
+/**
+ * A ConditionTimer that can defer its updates to a shared ConditionTimeline.
+ *
+ * Standalone (the default, and the only mode unit tests exercise), it behaves
+ * exactly like the ConditionTimer it wraps. Once attached to a timeline by
+ * MetricsManager, per-event onConditionChanged() calls become no-ops -- the
+ * timeline recorded the transition once for all subscribers -- and the wrapped
+ * timer catches up from the shared log when a bucket is closed.
+ *
+ * Attaching is only valid when the updates this timer would have received
+ * eagerly are exactly the transitions the timeline records: the metric is
+ * always active and its condition is not sliced.
+ */
+class LazyConditionTimer {
+public:
+    explicit LazyConditionTimer(bool initCondition, int64_t bucketStartNs)
+        : mTimer(initCondition, bucketStartNs) {
+    }
+
+    void attach(const std::shared_ptr<ConditionTimeline>& timeline) {
+        mTimeline = timeline;
+        mCursorId = timeline->createCursor();
+    }
+
+    // Brings the wrapped timer fully up to date and returns to eager mode.
+    // Used on config update, when the owning MetricsManager rebuilds its
+    // timelines and stops appending to the old ones.
+    void detach() {
+        if (mTimeline == nullptr) {
+            return;
+        }
+        mTimeline->replayInto(mCursorId, INT64_MAX, mTimer);
+        mTimeline = nullptr;
+        mCursorId = -1;
+    }
+
+    void onConditionChanged(bool newCondition, int64_t timestampNs) {
+        if (mTimeline != nullptr) {
+            // The owning MetricsManager already appended this transition.
+            return;
+        }
+        mTimer.onConditionChanged(newCondition, timestampNs);
+    }
+
+    ConditionTimer::ConditionDurationInfo newBucketStart(int64_t eventTimeNs,
+                                                         int64_t nextBucketStartNs) {
+        if (mTimeline != nullptr) {
+            mTimeline->replayInto(mCursorId, eventTimeNs, mTimer);
+        }
+        return mTimer.newBucketStart(eventTimeNs, nextBucketStartNs);
+    }
+
+    bool currentCondition() const {
+        return mTimer.mCondition;
+    }
+
+    // Tests assert against the wrapped timer's fields directly.
+    operator const ConditionTimer&() const {
+        return mTimer;
+    }
+
+private:
+    ConditionTimer mTimer;
+
+    std::shared_ptr<ConditionTimeline> mTimeline;
+
+    int mCursorId = -1;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
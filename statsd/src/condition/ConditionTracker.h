@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "condition/SlicedConditionStateMap.h"
 #include "condition/condition_util.h"
 #include "src/statsd_config.pb.h"
 #include "matchers/AtomMatchingTracker.h"
@@ -37,6 +38,7 @@ public:
           mInitialized(false),
           mTrackerIndex(),
           mUnSlicedPartCondition(ConditionState::kUnknown),
+          mLastConditionCache(ConditionState::kNotEvaluated),
           mSliced(false),
           mProtoHash(protoHash){};
 
@@ -47,7 +49,8 @@ public:
     // indicate whether the initialization is successful. (2) makes unit test easier.
     // This function can also be called on config updates, in which case it does nothing other than
     // fill the condition cache with the current condition.
-    // allConditionConfig: the list of all Predicate config from statsd_config.
+    // allConditionConfig: the Predicate protos from the StatsdConfig, referenced in place so that
+    //                     initialization does not copy them.
     // allConditionTrackers: the list of all ConditionTrackers (this is needed because we may also
     //                       need to call init() on child conditions)
     // conditionIdIndexMap: the mapping from condition id to its index.
@@ -55,7 +58,7 @@ public:
     // conditionCache: tracks initial conditions of all ConditionTrackers. returns the
     //                        current condition if called on a config update.
     virtual optional<InvalidConfigReason> init(
-            const std::vector<Predicate>& allConditionConfig,
+            const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionConfig,
             const std::vector<sp<ConditionTracker>>& allConditionTrackers,
             const std::unordered_map<int64_t, int>& conditionIdIndexMap,
             std::vector<uint8_t>& stack, std::vector<ConditionState>& conditionCache) = 0;
@@ -73,11 +76,13 @@ public:
     // conditionTrackerMap: map of condition tracker id to index after the config update.
     // returns whether or not the update is successful.
     virtual optional<InvalidConfigReason> onConfigUpdated(
-            const std::vector<Predicate>& allConditionProtos, int index,
+            const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionProtos, int index,
             const std::vector<sp<ConditionTracker>>& allConditionTrackers,
             const std::unordered_map<int64_t, int>& atomMatchingTrackerMap,
             const std::unordered_map<int64_t, int>& conditionTrackerMap) {
         mIndex = index;
+        // Matcher indices may have moved; the cached result is no longer trustworthy.
+        mLastConditionCache = ConditionState::kNotEvaluated;
         return nullopt;
     }
 
@@ -92,7 +97,7 @@ public:
     //                   If the condition has dimension, then any sub condition changes will report
     //                   conditionChanged.
     virtual void evaluateCondition(const LogEvent& event,
-                                   const std::vector<MatchingState>& eventMatcherValues,
+                                   const MatchingStateBitset& eventMatcherValues,
                                    const std::vector<sp<ConditionTracker>>& mAllConditions,
                                    std::vector<ConditionState>& conditionCache,
                                    std::vector<uint8_t>& conditionChanged) = 0;
@@ -120,6 +125,13 @@ public:
         mSliced = mSliced | sliced;
     }
 
+    // Indexes of the child conditions evaluateCondition() may recurse into (and
+    // whose condition cache entries it may fill). Empty for simple conditions.
+    virtual const std::vector<int>& getChildConditionIndexes() const {
+        static const std::vector<int> kNoChildren;
+        return kNoChildren;
+    }
+
     inline bool isSliced() const {
         return mSliced;
     }
@@ -137,13 +149,19 @@ public:
         return mProtoHash;
     }
 
-    virtual const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(
+    virtual const SlicedConditionStateMap* getSlicedDimensionMap(
             const std::vector<sp<ConditionTracker>>& allConditions) const = 0;
 
     virtual bool IsChangedDimensionTrackable() const = 0;
 
     virtual bool IsSimpleCondition() const = 0;
 
+    // The state reported for a dimension key that has no entry in the sliced state map.
+    // Only meaningful for simple conditions; combinations have no single initial value.
+    virtual ConditionState getInitialValue() const {
+        return ConditionState::kNotEvaluated;
+    }
+
     virtual bool equalOutputDimensions(
         const std::vector<sp<ConditionTracker>>& allConditions,
         const vector<Matcher>& dimensions) const = 0;
@@ -153,6 +171,26 @@ public:
         return mUnSlicedPartCondition;
     }
 
+    // Returns true if any of the matchers this tracker (transitively) depends on matched the
+    // event. When false, the event provably cannot change this tracker's state, so the cached
+    // condition (if valid) can be reused without re-evaluating the subtree.
+    inline bool isAffectedByEvent(const MatchingStateBitset& eventMatcherValues) const {
+        for (const int matcherIndex : mTrackerIndex) {
+            if (matcherIndex >= 0 && matcherIndex < static_cast<int>(eventMatcherValues.size()) &&
+                eventMatcherValues[matcherIndex] == MatchingState::kMatched) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The value the most recent evaluateCondition() wrote to the non-sliced condition cache,
+    // or kNotEvaluated when that value cannot be reproduced without re-evaluating (e.g. a
+    // sliced tracker just reported a per-dimension state, or the config was updated).
+    inline ConditionState getLastConditionCache() const {
+        return mLastConditionCache;
+    }
+
 protected:
     const int64_t mConditionId;
 
@@ -174,6 +212,11 @@ protected:
     // condition of the unsliced part of the combination condition.
     ConditionState mUnSlicedPartCondition;
 
+    // Result of the most recent evaluation, used by CombinationConditionTracker to skip
+    // re-evaluating subtrees that the current event cannot affect. kNotEvaluated means the
+    // cached value is invalid and the tracker must be evaluated normally.
+    ConditionState mLastConditionCache;
+
     bool mSliced;
 
     // Hash of the Predicate's proto bytes from StatsdConfig.
@@ -23,14 +23,67 @@ using std::vector;
 
 ConditionState ConditionWizard::query(const int index, const ConditionKey& parameters,
                                       const bool isPartialLink) {
+    std::lock_guard<std::mutex> lock(mQueryCacheMutex);
+    const uint64_t generation = getConditionStateGeneration();
+    if (generation != mQueryCacheGeneration) {
+        mQueryCache.clear();
+        mQueryCacheGeneration = generation;
+    }
+
+    const auto cacheKey = std::make_tuple(index, isPartialLink, parameters);
+    const auto cachedIt = mQueryCache.find(cacheKey);
+    if (cachedIt != mQueryCache.end()) {
+        return cachedIt->second;
+    }
+
     vector<ConditionState> cache(mAllConditions.size(), ConditionState::kNotEvaluated);
 
     mAllConditions[index]->isConditionMet(
         parameters, mAllConditions, isPartialLink,
         cache);
+    mQueryCache[cacheKey] = cache[index];
     return cache[index];
 }
 
+ConditionBatchProbe ConditionWizard::batchQuery(const int conditionIndex,
+                                                const bool isPartialLink) {
+    ConditionBatchProbe probe;
+    probe.mWizard = this;
+    probe.mIndex = conditionIndex;
+    probe.mIsPartialLink = isPartialLink;
+    probe.mGeneration = getConditionStateGeneration();
+    // Only a simple condition queried with full links resolves to a single lookup in the
+    // tracker's dimension map; partial links need the subset scan and combinations need
+    // the recursive evaluation, both of which query() already handles.
+    if (!isPartialLink && conditionIndex >= 0 && conditionIndex < (int)mAllConditions.size() &&
+        mAllConditions[conditionIndex]->IsSimpleCondition()) {
+        const sp<ConditionTracker>& tracker = mAllConditions[conditionIndex];
+        probe.mSlices = tracker->getSlicedDimensionMap(mAllConditions);
+        probe.mConditionId = tracker->getConditionId();
+        probe.mInitialValue = tracker->getInitialValue();
+    }
+    return probe;
+}
+
+ConditionState ConditionBatchProbe::query(const ConditionKey& conditionParameters) const {
+    if (mSlices == nullptr || getConditionStateGeneration() != mGeneration) {
+        return mWizard->query(mIndex, conditionParameters, mIsPartialLink);
+    }
+    const auto pair = conditionParameters.find(mConditionId);
+    if (pair == conditionParameters.end()) {
+        return mWizard->query(mIndex, conditionParameters, mIsPartialLink);
+    }
+    // Mirrors the full-link branch of SimpleConditionTracker::isConditionMet().
+    ConditionState conditionState = mInitialValue;
+    const auto startedCountIt = mSlices->find(pair->second);
+    if (startedCountIt != mSlices->end()) {
+        conditionState = conditionState |
+                         (startedCountIt->second > 0 ? ConditionState::kTrue
+                                                     : ConditionState::kFalse);
+    }
+    return conditionState;
+}
+
 const set<HashableDimensionKey>* ConditionWizard::getChangedToTrueDimensions(
         const int index) const {
     return mAllConditions[index]->getChangedToTrueDimensions(mAllConditions);
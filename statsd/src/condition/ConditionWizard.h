@@ -17,6 +17,10 @@
 #ifndef CONDITION_WIZARD_H
 #define CONDITION_WIZARD_H
 
+#include <map>
+#include <mutex>
+#include <tuple>
+
 #include "ConditionTracker.h"
 #include "condition_util.h"
 #include "stats_util.h"
@@ -25,6 +29,39 @@ namespace android {
 namespace os {
 namespace statsd {
 
+class ConditionWizard;
+
+// Read-only probe over one condition's sliced state, snapshotted once per batch by
+// ConditionWizard::batchQuery(). When a pull delivers thousands of per-uid rows the
+// condition state cannot change mid-batch, so resolving it through query() per row
+// repeats the same link rebuilding and cache bookkeeping; with a probe, a simple
+// sliced condition with full links costs one hash lookup per row. Any other shape,
+// or a condition mutation after the snapshot (detected through the global
+// condition-state generation), transparently falls back to ConditionWizard::query().
+// The probe must not outlive the wizard it came from.
+class ConditionBatchProbe {
+public:
+    ConditionState query(const ConditionKey& conditionParameters) const;
+
+private:
+    friend class ConditionWizard;
+
+    ConditionBatchProbe() = default;
+
+    ConditionWizard* mWizard = nullptr;
+    int mIndex = -1;
+    bool mIsPartialLink = false;
+
+    // Condition-state generation the snapshot was taken at.
+    uint64_t mGeneration = 0;
+
+    // Direct view into the tracker's sliced dimension map; nullptr when the condition
+    // cannot be probed directly (combination tracker or partial links).
+    const SlicedConditionStateMap* mSlices = nullptr;
+    int64_t mConditionId = 0;
+    ConditionState mInitialValue = ConditionState::kNotEvaluated;
+};
+
 // Held by MetricProducer, to query a condition state with input defined in MetricConditionLink.
 class ConditionWizard : public virtual RefBase {
 public:
@@ -42,6 +79,11 @@ public:
     virtual ConditionState query(const int conditionIndex, const ConditionKey& conditionParameters,
                                  const bool isPartialLink);
 
+    // Snapshots what is needed to resolve the condition at [conditionIndex] for a batch
+    // of rows processed while the condition state cannot change (e.g. one pull's worth
+    // of events). See ConditionBatchProbe.
+    virtual ConditionBatchProbe batchQuery(const int conditionIndex, const bool isPartialLink);
+
     virtual const std::set<HashableDimensionKey>* getChangedToTrueDimensions(const int index) const;
     virtual const std::set<HashableDimensionKey>* getChangedToFalseDimensions(
             const int index) const;
@@ -54,12 +96,24 @@ public:
         return mAllConditions[index]->getUnSlicedPartConditionState();
     }
 
-    const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(const int index) const {
+    const SlicedConditionStateMap* getSlicedDimensionMap(const int index) const {
         return mAllConditions[index]->getSlicedDimensionMap(mAllConditions);
     }
 
 private:
     std::vector<sp<ConditionTracker>> mAllConditions;
+
+    // Memoized query() results, keyed by (conditionIndex, isPartialLink, conditionParameters).
+    // Many metrics within one config share a condition tracker and dimension links, so while
+    // a single event is processed the sliced-condition resolution is computed once and every
+    // other querying metric gets the cached value. The cache is dropped whenever the global
+    // condition-state generation changes (any tracker mutated its state).
+    std::map<std::tuple<int, bool, ConditionKey>, ConditionState> mQueryCache;
+
+    // Generation of the condition state mQueryCache was computed against.
+    uint64_t mQueryCacheGeneration = 0;
+
+    std::mutex mQueryCacheMutex;
 };
 
 }  // namespace statsd
@@ -42,6 +42,7 @@ SimpleConditionTracker::SimpleConditionTracker(
         translateFieldMatcher(simplePredicate.dimensions(), &mOutputDimensions);
         if (mOutputDimensions.size() > 0) {
             mSliced = true;
+            mOutputDimensionsPlan = FieldExtractionPlan(mOutputDimensions);
         }
         mContainANYPositionInInternalDimensions = HasPositionANY(simplePredicate.dimensions());
     }
@@ -57,7 +58,7 @@ SimpleConditionTracker::~SimpleConditionTracker() {
 }
 
 optional<InvalidConfigReason> SimpleConditionTracker::init(
-        const vector<Predicate>& allConditionConfig,
+        const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionConfig,
         const vector<sp<ConditionTracker>>& allConditionTrackers,
         const unordered_map<int64_t, int>& conditionIdIndexMap, vector<uint8_t>& stack,
         vector<ConditionState>& conditionCache) {
@@ -76,7 +77,7 @@ optional<InvalidConfigReason> SimpleConditionTracker::init(
 }
 
 optional<InvalidConfigReason> SimpleConditionTracker::onConfigUpdated(
-        const vector<Predicate>& allConditionProtos, const int index,
+        const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionProtos, const int index,
         const vector<sp<ConditionTracker>>& allConditionTrackers,
         const unordered_map<int64_t, int>& atomMatchingTrackerMap,
         const unordered_map<int64_t, int>& conditionTrackerMap) {
@@ -146,6 +147,9 @@ void SimpleConditionTracker::dumpState() {
 
 void SimpleConditionTracker::handleStopAll(std::vector<ConditionState>& conditionCache,
                                            std::vector<uint8_t>& conditionChangedCache) {
+    // Invalidates memoized ConditionWizard queries.
+    bumpConditionStateGeneration();
+
     // Unless the default condition is false, and there was nothing started, otherwise we have
     // triggered a condition change.
     conditionChangedCache[mIndex] =
@@ -162,6 +166,7 @@ void SimpleConditionTracker::handleStopAll(std::vector<ConditionState>& conditio
     mInitialValue = ConditionState::kFalse;
     mSlicedConditionState.clear();
     conditionCache[mIndex] = ConditionState::kFalse;
+    mLastConditionCache = ConditionState::kNotEvaluated;
 }
 
 bool SimpleConditionTracker::hitGuardRail(const HashableDimensionKey& newKey) const {
@@ -186,6 +191,9 @@ bool SimpleConditionTracker::hitGuardRail(const HashableDimensionKey& newKey) co
 void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& outputKey,
                                                   bool matchStart, ConditionState* conditionCache,
                                                   bool* conditionChangedCache) {
+    // Invalidates memoized ConditionWizard queries.
+    bumpConditionStateGeneration();
+
     bool changed = false;
     auto outputIt = mSlicedConditionState.find(outputKey);
     ConditionState newCondition;
@@ -266,7 +274,7 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
 }
 
 void SimpleConditionTracker::evaluateCondition(const LogEvent& event,
-                                               const vector<MatchingState>& eventMatcherValues,
+                                               const MatchingStateBitset& eventMatcherValues,
                                                const vector<sp<ConditionTracker>>& mAllConditions,
                                                vector<ConditionState>& conditionCache,
                                                vector<uint8_t>& conditionChangedCache) {
@@ -323,6 +331,9 @@ void SimpleConditionTracker::evaluateCondition(const LogEvent& event,
                         itr->second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
             }
         }
+        // This is the stable view of the condition: it only depends on the sliced state and
+        // the initial value, so parents may reuse it until a matched event mutates the state.
+        mLastConditionCache = conditionCache[mIndex];
         return;
     }
 
@@ -334,7 +345,7 @@ void SimpleConditionTracker::evaluateCondition(const LogEvent& event,
                              &overallChanged);
     } else if (!mContainANYPositionInInternalDimensions) {
         HashableDimensionKey outputValue;
-        filterValues(mOutputDimensions, event.getValues(), &outputValue);
+        mOutputDimensionsPlan.extract(event.getValues(), &outputValue);
 
         // If this event has multiple nodes in the attribution chain,  this log event probably will
         // generate multiple dimensions. If so, we will find if the condition changes for any
@@ -348,6 +359,9 @@ void SimpleConditionTracker::evaluateCondition(const LogEvent& event,
     }
     conditionCache[mIndex] = overallState;
     conditionChangedCache[mIndex] = overallChanged;
+    // For sliced conditions the matched path reports a per-dimension state, not the overall
+    // "any slice true" view that the unmatched path reports, so it cannot be reused.
+    mLastConditionCache = mSliced ? ConditionState::kNotEvaluated : overallState;
 }
 
 void SimpleConditionTracker::isConditionMet(
@@ -36,19 +36,19 @@ public:
     ~SimpleConditionTracker();
 
     optional<InvalidConfigReason> init(
-            const std::vector<Predicate>& allConditionConfig,
+            const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionConfig,
             const std::vector<sp<ConditionTracker>>& allConditionTrackers,
             const std::unordered_map<int64_t, int>& conditionIdIndexMap,
             std::vector<uint8_t>& stack, std::vector<ConditionState>& conditionCache) override;
 
     optional<InvalidConfigReason> onConfigUpdated(
-            const std::vector<Predicate>& allConditionProtos, int index,
+            const ::google::protobuf::RepeatedPtrField<Predicate>& allConditionProtos, int index,
             const std::vector<sp<ConditionTracker>>& allConditionTrackers,
             const std::unordered_map<int64_t, int>& atomMatchingTrackerMap,
             const std::unordered_map<int64_t, int>& conditionTrackerMap) override;
 
     void evaluateCondition(const LogEvent& event,
-                           const std::vector<MatchingState>& eventMatcherValues,
+                           const MatchingStateBitset& eventMatcherValues,
                            const std::vector<sp<ConditionTracker>>& mAllConditions,
                            std::vector<ConditionState>& conditionCache,
                            std::vector<uint8_t>& changedCache) override;
@@ -76,7 +76,7 @@ public:
         }
     }
 
-    const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(
+    const SlicedConditionStateMap* getSlicedDimensionMap(
             const std::vector<sp<ConditionTracker>>& allConditions) const override {
         return &mSlicedConditionState;
     }
@@ -85,6 +85,10 @@ public:
 
     bool IsSimpleCondition() const  override { return true; }
 
+    ConditionState getInitialValue() const override {
+        return mInitialValue;
+    }
+
     bool equalOutputDimensions(
         const std::vector<sp<ConditionTracker>>& allConditions,
         const vector<Matcher>& dimensions) const override {
@@ -109,12 +113,15 @@ private:
 
     std::vector<Matcher> mOutputDimensions;
 
+    // Cached extraction plan for mOutputDimensions; see FieldExtractionPlan.
+    FieldExtractionPlan mOutputDimensionsPlan;
+
     bool mContainANYPositionInInternalDimensions;
 
     std::set<HashableDimensionKey> mLastChangedToTrueDimensions;
     std::set<HashableDimensionKey> mLastChangedToFalseDimensions;
 
-    std::map<HashableDimensionKey, int> mSlicedConditionState;
+    SlicedConditionStateMap mSlicedConditionState;
 
     void setMatcherIndices(const SimplePredicate& predicate,
                            const std::unordered_map<int64_t, int>& logTrackerMap);
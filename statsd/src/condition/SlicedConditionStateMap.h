@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "HashableDimensionKey.h"
+#include "utils/FlatHashMap.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Maps a sliced condition's dimension key to its start count.
+ *
+ * Flat open-addressing storage; see FlatHashMap for the layout rationale. Iteration order
+ * is unspecified, unlike the std::map this replaced; no current caller relies on sorted
+ * order. get_dimensions_for_condition_benchmark.cpp compares this layout against std::map.
+ */
+using SlicedConditionStateMap = FlatHashMap<HashableDimensionKey, int>;
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -18,6 +18,8 @@
 
 #include "condition_util.h"
 
+#include <atomic>
+
 #include "../matchers/matcher_util.h"
 #include "ConditionTracker.h"
 #include "src/statsd_config.pb.h"
@@ -29,6 +31,17 @@ namespace statsd {
 
 using std::vector;
 
+namespace {
+std::atomic<uint64_t> sConditionStateGeneration(0);
+}  // namespace
+
+uint64_t getConditionStateGeneration() {
+    return sConditionStateGeneration.load(std::memory_order_acquire);
+}
+
+void bumpConditionStateGeneration() {
+    sConditionStateGeneration.fetch_add(1, std::memory_order_release);
+}
 
 ConditionState evaluateCombinationCondition(const std::vector<int>& children,
                                             const LogicalOperation& operation,
@@ -17,6 +17,7 @@
 #ifndef CONDITION_UTIL_H
 #define CONDITION_UTIL_H
 
+#include <cstdint>
 #include <vector>
 #include "../matchers/matcher_util.h"
 #include "src/statsd_config.pb.h"
@@ -39,6 +40,13 @@ ConditionState evaluateCombinationCondition(const std::vector<int>& children,
                                             const std::vector<ConditionState>& conditionCache);
 
 ConditionState convertInitialValue(const SimplePredicate_InitialValue& initialValue);
+
+// Global generation counter for condition state. Bumped by condition trackers whenever
+// they mutate their (sliced) state, so ConditionWizard can memoize query() results for
+// the current event and drop them as soon as any condition may have changed, without
+// explicit plumbing from MetricsManager.
+uint64_t getConditionStateGeneration();
+void bumpConditionStateGeneration();
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -20,6 +20,8 @@
 
 #include <utils/RefBase.h>
 
+#include <map>
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -39,6 +41,18 @@ public:
     virtual void OnConfigUpdated(int64_t timestampNs, const ConfigKey& key,
                                  const StatsdConfig& config, bool modularUpdate = true) = 0;
 
+    /**
+     * All saved configurations were read from disk at startup. The default
+     * implementation delivers them one at a time through OnConfigUpdated;
+     * listeners may override it to process the batch more efficiently.
+     */
+    virtual void OnConfigsLoadedFromDisk(int64_t timestampNs,
+                                         const std::map<ConfigKey, StatsdConfig>& configs) {
+        for (const auto& [key, config] : configs) {
+            OnConfigUpdated(timestampNs, key, config);
+        }
+    }
+
     /**
      * A configuration was removed.
      */
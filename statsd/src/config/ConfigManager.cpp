@@ -21,6 +21,7 @@
 #include "storage/StorageManager.h"
 
 #include "guardrail/StatsdStats.h"
+#include "hash.h"
 #include "stats_log_util.h"
 #include "stats_util.h"
 #include "stats_log_util.h"
@@ -51,8 +52,22 @@ ConfigManager::~ConfigManager() {
 void ConfigManager::Startup() {
     map<ConfigKey, StatsdConfig> configsFromDisk;
     StorageManager::readConfigFromDisk(configsFromDisk);
-    for (const auto& config : configsFromDisk) {
-        UpdateConfig(config.first, config.second);
+    // The on-disk files are already canonical, so skip the re-serialization,
+    // duplicate-config comparison and file rewrite UpdateConfig does for pushed
+    // configs. Only the timestamp in each file name is refreshed, so age-based
+    // trimming restarts from this boot the way the old rewrite restarted it.
+    vector<sp<ConfigListener>> broadcastList;
+    {
+        lock_guard<mutex> lock(mMutex);
+        for (const auto& [key, config] : configsFromDisk) {
+            mConfigs[key.GetUid()].insert(key);
+            StorageManager::refreshConfigTimestamp(key);
+        }
+        broadcastList = mListeners;
+    }
+    const int64_t timestampNs = getElapsedRealtimeNs();
+    for (const sp<ConfigListener>& listener : broadcastList) {
+        listener->OnConfigsLoadedFromDisk(timestampNs, configsFromDisk);
     }
 }
 
@@ -85,15 +100,24 @@ void ConfigManager::UpdateConfig(const ConfigKey& key, const StatsdConfig& confi
             }
         }
 
-        // Check if it's a duplicate config.
-        if (uidIt != mConfigs.end() && uidIt->second.find(key) != uidIt->second.end() &&
-            StorageManager::hasIdenticalConfig(key, buffer)) {
-            // This is a duplicate config.
-            ALOGI("ConfigManager This is a duplicate config %s", key.ToString().c_str());
-            // Update saved file on disk. We still update timestamp of file when
-            // there exists a duplicate configuration to avoid garbage collection.
-            update_saved_configs_locked(key, buffer, numBytes);
-            return;
+        // Check if it's a duplicate config. The in-memory hash catches repeat pushes
+        // without touching disk; a key without a hash entry (loaded from disk at
+        // startup) is compared against the saved file instead.
+        const uint64_t configHash =
+                Hash64(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        if (uidIt != mConfigs.end() && uidIt->second.find(key) != uidIt->second.end()) {
+            const auto hashIt = mConfigHashes.find(key);
+            const bool isDuplicate = hashIt != mConfigHashes.end()
+                                             ? hashIt->second == configHash
+                                             : StorageManager::hasIdenticalConfig(key, buffer);
+            if (isDuplicate) {
+                ALOGI("ConfigManager This is a duplicate config %s", key.ToString().c_str());
+                // The saved file already holds these bytes; only refresh its timestamp
+                // so the duplicate push still protects it from garbage collection.
+                StorageManager::refreshConfigTimestamp(key);
+                mConfigHashes[key] = configHash;
+                return;
+            }
         }
 
         // Update saved file on disk.
@@ -101,6 +125,7 @@ void ConfigManager::UpdateConfig(const ConfigKey& key, const StatsdConfig& confi
 
         // Add to set.
         mConfigs[key.GetUid()].insert(key);
+        mConfigHashes[key] = configHash;
 
         broadcastList = mListeners;
     }
@@ -239,6 +264,7 @@ void ConfigManager::RemoveConfig(const ConfigKey& key) {
         if (uidIt != mConfigs.end() && uidIt->second.find(key) != uidIt->second.end()) {
             // Remove from map
             uidIt->second.erase(key);
+            mConfigHashes.erase(key);
 
             broadcastList = mListeners;
         }
@@ -274,6 +300,7 @@ void ConfigManager::RemoveConfigs(int uid) {
             // Remove from map
                 remove_saved_configs(*it);
                 removed.push_back(*it);
+                mConfigHashes.erase(*it);
         }
 
         mConfigs.erase(uidIt);
@@ -304,6 +331,7 @@ void ConfigManager::RemoveAllConfigs() {
             }
             uidIt = mConfigs.erase(uidIt);
         }
+        mConfigHashes.clear();
 
         broadcastList = mListeners;
     }
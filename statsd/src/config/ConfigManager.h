@@ -176,6 +176,15 @@ private:
      */
     std::map<int, std::set<ConfigKey>> mConfigs;
 
+    /**
+     * Content hash of the serialized config last accepted for each key. Lets a
+     * re-push of a byte-identical config be recognized in memory, without
+     * reading the saved file back from disk to compare. Keys loaded from disk
+     * at startup have no entry until their first re-push, which falls back to
+     * the on-disk comparison.
+     */
+    std::map<ConfigKey, uint64_t> mConfigHashes;
+
     /**
      * Each config key can be subscribed by up to one receiver, specified as IPendingIntentRef.
      */
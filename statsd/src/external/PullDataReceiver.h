@@ -38,6 +38,20 @@ class PullDataReceiver : virtual public RefBase{
   virtual void onDataPulled(const std::vector<std::shared_ptr<LogEvent>>& data,
                             PullResult pullResult, int64_t originalPullTimeNs) = 0;
 
+  /**
+   * Delivery for a scheduled pull, carrying the boundary the receiver registered
+   * for it. scheduledPullTimeNs is the registered pull time this alarm served;
+   * originalPullTimeNs is when the pulls were actually initiated, at or after it.
+   * Receivers that anchor buckets on their registered boundary can attribute the
+   * data there directly instead of re-deriving the boundary from the alarm time.
+   * The default forwards to onDataPulled.
+   */
+  virtual void onScheduledDataPulled(const std::vector<std::shared_ptr<LogEvent>>& data,
+                                     PullResult pullResult, int64_t originalPullTimeNs,
+                                     int64_t scheduledPullTimeNs) {
+      onDataPulled(data, pullResult, originalPullTimeNs);
+  }
+
   virtual bool isPullNeeded() const = 0;
 };
 
@@ -53,27 +53,48 @@ PullErrorCode StatsCallbackPuller::PullInternal(vector<shared_ptr<LogEvent>>* da
     shared_ptr<mutex> cv_mutex = make_shared<mutex>();
     shared_ptr<condition_variable> cv = make_shared<condition_variable>();
     shared_ptr<bool> pullFinish = make_shared<bool>(false);
+    shared_ptr<bool> pullTimeout = make_shared<bool>(false);
     shared_ptr<bool> pullSuccess = make_shared<bool>(false);
     shared_ptr<vector<shared_ptr<LogEvent>>> sharedData =
             make_shared<vector<shared_ptr<LogEvent>>>();
 
     shared_ptr<PullResultReceiver> resultReceiver = SharedRefBase::make<PullResultReceiver>(
-            [cv_mutex, cv, pullFinish, pullSuccess, sharedData](
+            [cv_mutex, cv, pullFinish, pullTimeout, pullSuccess, sharedData](
                     int32_t atomTag, bool success, const vector<StatsEventParcel>& output) {
                 // This is the result of the pull, executing in a statsd binder thread.
                 // The pull could have taken a long time, and we should only modify
                 // data (the output param) if the pointer is in scope and the pull did not time out.
                 {
                     lock_guard<mutex> lk(*cv_mutex);
+                    if (*pullTimeout) {
+                        // The waiter already gave up on this pull; parsing the payload
+                        // now would only burn cpu on data that gets discarded.
+                        return;
+                    }
+                    // Parse all events of the pull into one contiguous block and hand
+                    // out aliasing pointers into it, so a pull returning thousands of
+                    // atoms costs one allocation instead of one per event. The events
+                    // of a pull are cached and discarded together, so tying their
+                    // lifetimes to the block does not extend them.
+                    auto eventBlock = make_shared<vector<LogEvent>>();
+                    eventBlock->reserve(output.size());
+                    sharedData->reserve(output.size());
+                    // Rows of a pull share one schema, so the previous row's
+                    // parsed size is an exact capacity hint for the next row.
+                    size_t prevRowValueCount = 0;
                     for (const StatsEventParcel& parcel: output) {
-                        shared_ptr<LogEvent> event = make_shared<LogEvent>(/*uid=*/-1, /*pid=*/-1);
-                        bool valid = event->parseBuffer((uint8_t*)parcel.buffer.data(),
-                                                        parcel.buffer.size());
+                        eventBlock->emplace_back(/*uid=*/-1, /*pid=*/-1);
+                        LogEvent& event = eventBlock->back();
+                        event.reserveValueCapacity(prevRowValueCount);
+                        bool valid = event.parseBuffer((uint8_t*)parcel.buffer.data(),
+                                                       parcel.buffer.size());
                         if (valid) {
-                            sharedData->push_back(event);
+                            prevRowValueCount = event.size();
+                            sharedData->push_back(shared_ptr<LogEvent>(eventBlock, &event));
                         } else {
-                            StatsdStats::getInstance().noteAtomError(event->GetTagId(),
+                            StatsdStats::getInstance().noteAtomError(event.GetTagId(),
                                                                      /*pull=*/true);
+                            eventBlock->pop_back();
                         }
                     }
                     *pullSuccess = success;
@@ -100,6 +121,9 @@ PullErrorCode StatsCallbackPuller::PullInternal(vector<shared_ptr<LogEvent>>* da
         cv->wait_for(unique_lk, chrono::nanoseconds(mPullTimeoutNs),
                      [pullFinish] { return *pullFinish; });
         if (!*pullFinish) {
+            // Tell the result receiver not to bother parsing the payload if it shows
+            // up after all; nobody is waiting for it anymore.
+            *pullTimeout = true;
             // Note: The parent stats puller will also note that there was a timeout and that the
             // cache should be cleared. Once we migrate all pullers to this callback, we could
             // consolidate the logic.
@@ -18,6 +18,9 @@
 #include "Log.h"
 
 #include "StatsPuller.h"
+
+#include <algorithm>
+
 #include "StatsPullerManager.h"
 #include "guardrail/StatsdStats.h"
 #include "puller_util.h"
@@ -43,7 +46,28 @@ StatsPuller::StatsPuller(const int tagId, const int64_t coolDownNs, const int64_
 }
 
 PullErrorCode StatsPuller::Pull(const int64_t eventTimeNs,
-                                std::vector<std::shared_ptr<LogEvent>>* data) {
+                                std::vector<std::shared_ptr<LogEvent>>* data,
+                                const int64_t stalenessToleranceNs) {
+    // Fast path: serve repeat pulls from the published snapshot without taking
+    // mLock, so concurrent metrics sharing an atom don't serialize behind a
+    // pull in flight. The snapshot is immutable once published.
+    std::shared_ptr<const PullSnapshot> snapshot =
+            std::atomic_load_explicit(&mSnapshot, std::memory_order_acquire);
+    if (snapshot != nullptr) {
+        const int64_t windowNs = snapshot->goodData
+                                         ? std::max(mCoolDownNs, stalenessToleranceNs)
+                                         : mCoolDownNs;
+        if (snapshot->eventTimeNs == eventTimeNs ||
+            getElapsedRealtimeNs() - snapshot->pullTimeNs < windowNs) {
+            StatsdStats::getInstance().notePull(mTagId);
+            if (snapshot->goodData) {
+                (*data) = snapshot->data;
+                StatsdStats::getInstance().notePullFromCache(mTagId);
+            }
+            return snapshot->goodData ? PULL_SUCCESS : PULL_FAIL;
+        }
+    }
+
     lock_guard<std::mutex> lock(mLock);
     const int64_t elapsedTimeNs = getElapsedRealtimeNs();
     const int64_t systemUptimeMillis = getSystemUptimeMillis();
@@ -68,6 +92,7 @@ PullErrorCode StatsPuller::Pull(const int64_t eventTimeNs,
     PullErrorCode status = PullInternal(&mCachedData);
     mHasGoodData = (status == PULL_SUCCESS);
     if (!mHasGoodData) {
+        publishSnapshotLocked();
         return status;
     }
     const int64_t pullElapsedDurationNs = getElapsedRealtimeNs() - elapsedTimeNs;
@@ -82,6 +107,7 @@ PullErrorCode StatsPuller::Pull(const int64_t eventTimeNs,
                 mTagId, pullSystemUptimeDurationMillis, NanoToMillis(pullElapsedDurationNs));
         ALOGW("Pull for atom %d exceeds timeout %lld nano seconds.", mTagId,
               (long long)pullElapsedDurationNs);
+        publishSnapshotLocked();
         return PULL_FAIL;
     }
 
@@ -94,10 +120,27 @@ PullErrorCode StatsPuller::Pull(const int64_t eventTimeNs,
         StatsdStats::getInstance().noteEmptyData(mTagId);
     }
 
+    publishSnapshotLocked();
     (*data) = mCachedData;
     return PULL_SUCCESS;
 }
 
+int64_t StatsPuller::getCacheGeneration() const {
+    return mSnapshotGeneration.load(std::memory_order_acquire);
+}
+
+void StatsPuller::publishSnapshotLocked() {
+    auto snapshot = std::make_shared<PullSnapshot>();
+    snapshot->data = mCachedData;
+    snapshot->pullTimeNs = mLastPullTimeNs;
+    snapshot->eventTimeNs = mLastEventTimeNs;
+    snapshot->generation = mSnapshotGeneration.fetch_add(1, std::memory_order_relaxed) + 1;
+    snapshot->goodData = mHasGoodData;
+    std::atomic_store_explicit(&mSnapshot,
+                               std::shared_ptr<const PullSnapshot>(std::move(snapshot)),
+                               std::memory_order_release);
+}
+
 int StatsPuller::ForceClearCache() {
     return clearCache();
 }
@@ -112,6 +155,8 @@ int StatsPuller::clearCacheLocked() {
     mCachedData.clear();
     mLastPullTimeNs = 0;
     mLastEventTimeNs = 0;
+    std::atomic_store_explicit(&mSnapshot, std::shared_ptr<const PullSnapshot>(nullptr),
+                               std::memory_order_release);
     return ret;
 }
 
@@ -18,6 +18,8 @@
 
 #include <aidl/android/os/IStatsCompanionService.h>
 #include <utils/RefBase.h>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include "packages/UidMap.h"
@@ -49,7 +51,8 @@ public:
 
     // Pulls the most recent data.
     // The data may be served from cache if consecutive pulls come within
-    // predefined cooldown time.
+    // predefined cooldown time, or within stalenessToleranceNs of the last
+    // successful pull for metrics that declared a tolerance.
     // Returns PULL_SUCCESS if the pull was successful.
     // Returns PULL_DEAD_OBJECT if a dead object exception occurred when making a pull.
     // Returns PULL_FAIL when
@@ -57,7 +60,12 @@ public:
     //   2) pull takes longer than mPullTimeoutNs (intrinsic to puller)
     // If a metric wants to make any change to the data, like timestamps, it
     // should make a copy as this data may be shared with multiple metrics.
-    PullErrorCode Pull(const int64_t eventTimeNs, std::vector<std::shared_ptr<LogEvent>>* data);
+    PullErrorCode Pull(const int64_t eventTimeNs, std::vector<std::shared_ptr<LogEvent>>* data,
+                       const int64_t stalenessToleranceNs = 0);
+
+    // Monotonically increasing tag of the published cache snapshot. Bumped on
+    // every actual pull; unchanged when a request is served from cache.
+    int64_t getCacheGeneration() const;
 
     // Clear cache immediately
     int ForceClearCache();
@@ -113,10 +121,27 @@ private:
     //   3) clearCache is called.
     std::vector<std::shared_ptr<LogEvent>> mCachedData;
 
+    // Immutable, generation-tagged copy of the cache state. Published with
+    // release semantics after every pull (good or bad) so that repeat pulls
+    // within the cache window can be served without taking mLock.
+    struct PullSnapshot {
+        std::vector<std::shared_ptr<LogEvent>> data;
+        int64_t pullTimeNs = 0;
+        int64_t eventTimeNs = 0;
+        int64_t generation = 0;
+        bool goodData = false;
+    };
+
+    std::shared_ptr<const PullSnapshot> mSnapshot;
+
+    std::atomic<int64_t> mSnapshotGeneration{0};
+
     int clearCache();
 
     int clearCacheLocked();
 
+    void publishSnapshotLocked();
+
     static sp<UidMap> mUidMap;
 };
 
@@ -24,12 +24,15 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <thread>
 
 #include "../StatsService.h"
 #include "../logd/LogEvent.h"
 #include "../stats_log_util.h"
 #include "../statscompanion_util.h"
+#include "../utils/StatsTrace.h"
 #include "StatsCallbackPuller.h"
 #include "TrainInfoPuller.h"
 #include "statslog_statsd.h"
@@ -44,6 +47,21 @@ namespace statsd {
 // Values smaller than this may require to update the alarm.
 const int64_t NO_ALARM_UPDATE = INT64_MAX;
 
+// Cap on the worker threads used for the pulls sharing one alarm. Pulls mostly wait
+// on binder callbacks, so a handful of threads is enough to overlap the waits.
+const size_t kMaxPullThreads = 4;
+
+// Scheduled pulls share one alarm, set for the earliest due receiver and rounded up
+// onto this grid. Configs with co-prime bucket sizes (say 5 and 6 minutes) otherwise
+// interleave so the device wakes for nearly every due time; on the grid, receivers
+// whose due times fall within the same slot share one wakeup and one batch of pulls.
+// Pull intervals are already rounded to whole minutes at registration, so a one
+// minute grid delays any single pull by less than a minute, and the producers snap
+// late scheduled pulls back to the previous bucket end (see
+// NumericValueMetricProducer::onDataPulled), counting the delay in
+// StatsdStats::noteBucketBoundaryDelayNs.
+const int64_t kPullScheduleGridNs = 60 * (int64_t)NS_PER_SEC;
+
 StatsPullerManager::StatsPullerManager()
     : kAllPullAtomInfo({
               // TrainInfo.
@@ -54,63 +72,107 @@ StatsPullerManager::StatsPullerManager()
 
 bool StatsPullerManager::Pull(int tagId, const ConfigKey& configKey, const int64_t eventTimeNs,
                               vector<shared_ptr<LogEvent>>* data) {
+    return Pull(tagId, configKey, eventTimeNs, data, /*stalenessToleranceNs=*/0);
+}
+
+bool StatsPullerManager::Pull(int tagId, const ConfigKey& configKey, const int64_t eventTimeNs,
+                              vector<shared_ptr<LogEvent>>* data,
+                              const int64_t stalenessToleranceNs) {
+    STATSD_TRACE_SCOPE_ID("StatsPullerManager::Pull", tagId);
     std::lock_guard<std::mutex> _l(mLock);
-    return PullLocked(tagId, configKey, eventTimeNs, data);
+    return PullLocked(tagId, configKey, eventTimeNs, data, stalenessToleranceNs);
 }
 
 bool StatsPullerManager::Pull(int tagId, const vector<int32_t>& uids, const int64_t eventTimeNs,
                               vector<std::shared_ptr<LogEvent>>* data) {
+    return Pull(tagId, uids, eventTimeNs, data, /*stalenessToleranceNs=*/0);
+}
+
+bool StatsPullerManager::Pull(int tagId, const vector<int32_t>& uids, const int64_t eventTimeNs,
+                              vector<std::shared_ptr<LogEvent>>* data,
+                              const int64_t stalenessToleranceNs) {
+    STATSD_TRACE_SCOPE_ID("StatsPullerManager::Pull", tagId);
     std::lock_guard<std::mutex> _l(mLock);
-    return PullLocked(tagId, uids, eventTimeNs, data);
+    return PullLocked(tagId, uids, eventTimeNs, data, stalenessToleranceNs);
 }
 
 bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
-                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
-    vector<int32_t> uids;
+                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data,
+                                    const int64_t stalenessToleranceNs) {
+    VLOG("Initiating pulling %d", tagId);
+    const ResolvedPuller resolved = findPullerLocked(tagId, configKey);
+    if (resolved.puller == nullptr) {
+        return false;  // Return early since we don't know what to pull.
+    }
+    PullErrorCode status = resolved.puller->Pull(eventTimeNs, data, stalenessToleranceNs);
+    VLOG("pulled %zu items", data->size());
+    return handlePullResultLocked(tagId, resolved, status);
+}
+
+bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
+                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data,
+                                    const int64_t stalenessToleranceNs) {
+    VLOG("Initiating pulling %d", tagId);
+    const ResolvedPuller resolved = findPullerLocked(tagId, uids);
+    if (resolved.puller == nullptr) {
+        return false;  // Return early since we don't know what to pull.
+    }
+    PullErrorCode status = resolved.puller->Pull(eventTimeNs, data, stalenessToleranceNs);
+    VLOG("pulled %zu items", data->size());
+    return handlePullResultLocked(tagId, resolved, status);
+}
+
+StatsPullerManager::ResolvedPuller StatsPullerManager::findPullerLocked(
+        int tagId, const ConfigKey& configKey) {
     const auto& uidProviderIt = mPullUidProviders.find(configKey);
     if (uidProviderIt == mPullUidProviders.end()) {
         ALOGE("Error pulling tag %d. No pull uid provider for config key %s", tagId,
               configKey.ToString().c_str());
         StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
-        return false;
+        return {};
     }
     sp<PullUidProvider> pullUidProvider = uidProviderIt->second.promote();
     if (pullUidProvider == nullptr) {
         ALOGE("Error pulling tag %d, pull uid provider for config %s is gone.", tagId,
               configKey.ToString().c_str());
         StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
-        return false;
+        return {};
     }
-    uids = pullUidProvider->getPullAtomUids(tagId);
-    return PullLocked(tagId, uids, eventTimeNs, data);
+    return findPullerLocked(tagId, pullUidProvider->getPullAtomUids(tagId));
 }
 
-bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
-                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
-    VLOG("Initiating pulling %d", tagId);
+StatsPullerManager::ResolvedPuller StatsPullerManager::findPullerLocked(
+        int tagId, const vector<int32_t>& uids) {
     for (int32_t uid : uids) {
         PullerKey key = {.uid = uid, .atomTag = tagId};
         auto pullerIt = kAllPullAtomInfo.find(key);
         if (pullerIt != kAllPullAtomInfo.end()) {
-            PullErrorCode status = pullerIt->second->Pull(eventTimeNs, data);
-            VLOG("pulled %zu items", data->size());
-            if (status != PULL_SUCCESS) {
-                StatsdStats::getInstance().notePullFailed(tagId);
-            }
-            // If we received a dead object exception, it means the client process has died.
-            // We can remove the puller from the map.
-            if (status == PULL_DEAD_OBJECT) {
-                StatsdStats::getInstance().notePullerCallbackRegistrationChanged(
-                        tagId,
-                        /*registered=*/false);
-                kAllPullAtomInfo.erase(pullerIt);
-            }
-            return status == PULL_SUCCESS;
+            return {.uid = uid, .puller = pullerIt->second};
         }
     }
     StatsdStats::getInstance().notePullerNotFound(tagId);
     ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
-    return false;  // Return early since we don't know what to pull.
+    return {};
+}
+
+bool StatsPullerManager::handlePullResultLocked(int tagId, const ResolvedPuller& resolved,
+                                                PullErrorCode status) {
+    if (status != PULL_SUCCESS) {
+        StatsdStats::getInstance().notePullFailed(tagId);
+    }
+    // If we received a dead object exception, it means the client process has died.
+    // We can remove the puller from the map. Look it up again by key since another
+    // pull of the same atom may have already removed it.
+    if (status == PULL_DEAD_OBJECT) {
+        auto pullerIt = kAllPullAtomInfo.find({.uid = resolved.uid, .atomTag = tagId});
+        if (pullerIt != kAllPullAtomInfo.end() && pullerIt->second == resolved.puller) {
+            StatsdStats::getInstance().notePullerCallbackRegistrationChanged(
+                    tagId,
+                    /*registered=*/false);
+            kAllPullAtomInfo.erase(pullerIt);
+        }
+    }
+    return status == PULL_SUCCESS;
 }
 
 bool StatsPullerManager::PullerForMatcherExists(int tagId) const {
@@ -236,7 +298,9 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
                     receivers.push_back(&receiverInfo);
                 } else {
                     if (receiverInfo.nextPullTimeNs <= elapsedTimeNs) {
-                        receiverPtr->onDataPulled({}, PullResult::PULL_NOT_NEEDED, elapsedTimeNs);
+                        receiverPtr->onScheduledDataPulled({}, PullResult::PULL_NOT_NEEDED,
+                                                           elapsedTimeNs,
+                                                           receiverInfo.nextPullTimeNs);
                         int numBucketsAhead = (elapsedTimeNs - receiverInfo.nextPullTimeNs) /
                                               receiverInfo.intervalNs;
                         receiverInfo.nextPullTimeNs +=
@@ -250,32 +314,104 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
             }
         }
     }
-    for (const auto& pullInfo : needToPull) {
+    // Resolve each atom's puller up front so the pulls themselves can run in
+    // parallel: the workers below only touch their own task and the pullers, which
+    // serialize on their own per-puller lock, never the manager's maps.
+    struct PullTask {
+        int atomTag = 0;
+        ResolvedPuller resolved;
+        PullErrorCode status = PULL_FAIL;
         vector<shared_ptr<LogEvent>> data;
-        PullResult pullResult =
-                PullLocked(pullInfo.first->atomTag, pullInfo.first->configKey, elapsedTimeNs, &data)
-                        ? PullResult::PULL_RESULT_SUCCESS
-                        : PullResult::PULL_RESULT_FAIL;
-        if (pullResult == PullResult::PULL_RESULT_FAIL) {
-            VLOG("pull failed at %lld, will try again later", (long long)elapsedTimeNs);
+    };
+    // Coalesce entries that resolve to the same puller: when several configs pull the
+    // same atom at this alarm, pull it once and fan the same frozen snapshot out by
+    // reference to all of their receivers, instead of copying the cached data out of
+    // the puller once per config.
+    vector<PullTask> pullTasks;
+    pullTasks.reserve(needToPull.size());
+    vector<size_t> taskIndexForPull(needToPull.size());
+    std::map<PullerKey, size_t> taskIndexByPuller;
+    for (size_t i = 0; i < needToPull.size(); i++) {
+        const int atomTag = needToPull[i].first->atomTag;
+        ResolvedPuller resolved = findPullerLocked(atomTag, needToPull[i].first->configKey);
+        if (resolved.puller != nullptr) {
+            const auto [taskIt, inserted] = taskIndexByPuller.try_emplace(
+                    PullerKey{.uid = resolved.uid, .atomTag = atomTag}, pullTasks.size());
+            if (!inserted) {
+                taskIndexForPull[i] = taskIt->second;
+                continue;
+            }
         }
+        taskIndexForPull[i] = pullTasks.size();
+        pullTasks.push_back({atomTag, std::move(resolved)});
+    }
 
-        // Convention is to mark pull atom timestamp at request time.
-        // If we pull at t0, puller starts at t1, finishes at t2, and send back
-        // at t3, we mark t0 as its timestamp, which should correspond to its
-        // triggering event, such as condition change at t0.
-        // Here the triggering event is alarm fired from AlarmManager.
-        // In ValueMetricProducer and GaugeMetricProducer we do same thing
-        // when pull on condition change, etc.
-        for (auto& event : data) {
+    // Run the pulls with bounded parallelism so independent pullers' cool-down
+    // checks and binder waits overlap instead of serializing. Timeout and failure
+    // accounting is unchanged: timeouts are noted inside StatsPuller::Pull as before
+    // and failures in handlePullResultLocked once the workers are joined.
+    const auto runPull = [elapsedTimeNs](PullTask& task) {
+        if (task.resolved.puller != nullptr) {
+            VLOG("Initiating pulling %d", task.atomTag);
+            task.status = task.resolved.puller->Pull(elapsedTimeNs, &task.data);
+            VLOG("pulled %zu items", task.data.size());
+        }
+    };
+    const size_t numPullThreads = std::min(kMaxPullThreads, pullTasks.size());
+    if (numPullThreads <= 1) {
+        for (PullTask& task : pullTasks) {
+            runPull(task);
+        }
+    } else {
+        std::atomic<size_t> nextTask(0);
+        vector<std::thread> pullThreads;
+        pullThreads.reserve(numPullThreads);
+        for (size_t i = 0; i < numPullThreads; i++) {
+            pullThreads.emplace_back([&] {
+                for (size_t taskIndex = nextTask.fetch_add(1); taskIndex < pullTasks.size();
+                     taskIndex = nextTask.fetch_add(1)) {
+                    runPull(pullTasks[taskIndex]);
+                }
+            });
+        }
+        for (std::thread& pullThread : pullThreads) {
+            pullThread.join();
+        }
+    }
+
+    // Convention is to mark pull atom timestamp at request time.
+    // If we pull at t0, puller starts at t1, finishes at t2, and send back
+    // at t3, we mark t0 as its timestamp, which should correspond to its
+    // triggering event, such as condition change at t0.
+    // Here the triggering event is alarm fired from AlarmManager.
+    // In ValueMetricProducer and GaugeMetricProducer we do same thing
+    // when pull on condition change, etc.
+    for (PullTask& task : pullTasks) {
+        for (auto& event : task.data) {
             event->setElapsedTimestampNs(elapsedTimeNs);
             event->setLogdWallClockTimestampNs(wallClockNs);
         }
+    }
+
+    for (size_t i = 0; i < needToPull.size(); i++) {
+        const auto& pullInfo = needToPull[i];
+        PullTask& task = pullTasks[taskIndexForPull[i]];
+        const bool pullSuccess =
+                task.resolved.puller != nullptr &&
+                handlePullResultLocked(pullInfo.first->atomTag, task.resolved, task.status);
+        PullResult pullResult =
+                pullSuccess ? PullResult::PULL_RESULT_SUCCESS : PullResult::PULL_RESULT_FAIL;
+        if (pullResult == PullResult::PULL_RESULT_FAIL) {
+            VLOG("pull failed at %lld, will try again later", (long long)elapsedTimeNs);
+        }
 
         for (const auto& receiverInfo : pullInfo.second) {
             sp<PullDataReceiver> receiverPtr = receiverInfo->receiver.promote();
             if (receiverPtr != nullptr) {
-                receiverPtr->onDataPulled(data, pullResult, elapsedTimeNs);
+                // The registered pull time has not been advanced yet, so it is the
+                // exact boundary this delivery serves.
+                receiverPtr->onScheduledDataPulled(task.data, pullResult, elapsedTimeNs,
+                                                   receiverInfo->nextPullTimeNs);
                 // We may have just come out of a coma, compute next pull time.
                 int numBucketsAhead =
                         (elapsedTimeNs - receiverInfo->nextPullTimeNs) / receiverInfo->intervalNs;
@@ -287,6 +423,14 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
         }
     }
 
+    // Snap the alarm onto the shared schedule grid. The receivers' own schedules stay
+    // anchored to their bucket ends; only the wakeup is deferred to the next grid
+    // point, so everything due within the slot is pulled together.
+    if (minNextPullTimeNs != NO_ALARM_UPDATE) {
+        minNextPullTimeNs = ((minNextPullTimeNs + kPullScheduleGridNs - 1) / kPullScheduleGridNs) *
+                            kPullScheduleGridNs;
+    }
+
     VLOG("mNextPullTimeNs: %lld updated to %lld", (long long)mNextPullTimeNs,
          (long long)minNextPullTimeNs);
     mNextPullTimeNs = minNextPullTimeNs;
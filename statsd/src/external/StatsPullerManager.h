@@ -105,10 +105,18 @@ public:
     virtual bool Pull(int tagId, const ConfigKey& configKey, int64_t eventTimeNs,
                       vector<std::shared_ptr<LogEvent>>* data);
 
+    // Same as above, but allow the puller to serve a cached snapshot up to
+    // stalenessToleranceNs old instead of doing an actual pull.
+    virtual bool Pull(int tagId, const ConfigKey& configKey, int64_t eventTimeNs,
+                      vector<std::shared_ptr<LogEvent>>* data, int64_t stalenessToleranceNs);
+
     // Same as above, but directly specify the allowed uids to pull from.
     virtual bool Pull(int tagId, const vector<int32_t>& uids, int64_t eventTimeNs,
                       vector<std::shared_ptr<LogEvent>>* data);
 
+    virtual bool Pull(int tagId, const vector<int32_t>& uids, int64_t eventTimeNs,
+                      vector<std::shared_ptr<LogEvent>>* data, int64_t stalenessToleranceNs);
+
     // Clear pull data cache immediately.
     int ForceClearPullerCache();
 
@@ -153,10 +161,27 @@ private:
     std::map<ConfigKey, wp<PullUidProvider>> mPullUidProviders;
 
     bool PullLocked(int tagId, const ConfigKey& configKey, int64_t eventTimeNs,
-                    vector<std::shared_ptr<LogEvent>>* data);
+                    vector<std::shared_ptr<LogEvent>>* data, int64_t stalenessToleranceNs = 0);
 
     bool PullLocked(int tagId, const vector<int32_t>& uids, int64_t eventTimeNs,
-                    vector<std::shared_ptr<LogEvent>>* data);
+                    vector<std::shared_ptr<LogEvent>>* data, int64_t stalenessToleranceNs = 0);
+
+    // The puller resolved for one pull, together with the uid it is registered under
+    // so a dead puller can later be dropped from kAllPullAtomInfo.
+    struct ResolvedPuller {
+        int uid = -1;
+        sp<StatsPuller> puller;  // nullptr when no puller is registered.
+    };
+
+    // Resolves the puller for the given atom, noting missing uid providers or pullers
+    // in StatsdStats. Unlike Pull, does not invoke the puller, so the resolution can
+    // be done under mLock and the (possibly blocking) pulls run elsewhere.
+    ResolvedPuller findPullerLocked(int tagId, const ConfigKey& configKey);
+    ResolvedPuller findPullerLocked(int tagId, const vector<int32_t>& uids);
+
+    // Records the outcome of a pull in StatsdStats and removes the puller from the map
+    // if the client process died. Returns whether the pull succeeded.
+    bool handlePullResultLocked(int tagId, const ResolvedPuller& resolved, PullErrorCode status);
 
     // locks for data receiver and StatsCompanionService changes
     std::mutex mLock;
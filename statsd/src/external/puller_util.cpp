@@ -97,9 +97,27 @@ void mapAndMergeIsolatedUidsToHostUid(vector<shared_ptr<LogEvent>>& data, const
          });
 
     vector<shared_ptr<LogEvent>> mergedData;
-    const set<int> additiveFields(additiveFieldsVec.begin(), additiveFieldsVec.end());
     bool needMerge = true;
 
+    // Whether each value index holds a mergeable additive field. This depends only on the field
+    // layout, not on the values, and the sort above groups rows with identical layouts together,
+    // so the classification is computed once per layout run instead of resolving field positions
+    // against the additive-field list for every row pair.
+    vector<Field> classifiedLayout;
+    vector<bool> isAdditiveAtIndex;
+    const auto classifyLayout = [&](const vector<FieldValue>& values) {
+        classifiedLayout.resize(values.size());
+        isAdditiveAtIndex.assign(values.size(), false);
+        for (size_t p = 0; p < values.size(); p++) {
+            classifiedLayout[p] = values[p].mField;
+            // Repeated additive fields are treated as non-additive fields.
+            isAdditiveAtIndex[p] =
+                    !isPrimitiveRepeatedField(values[p].mField) &&
+                    find(additiveFieldsVec.begin(), additiveFieldsVec.end(),
+                         values[p].mField.getPosAtDepth(0)) != additiveFieldsVec.end();
+        }
+    };
+
     // 3. do the merge.
     // The loop invariant is this: for every event,
     // - check if it has a different length (means different attribution chains or repeated fields)
@@ -116,21 +134,28 @@ void mapAndMergeIsolatedUidsToHostUid(vector<shared_ptr<LogEvent>>& data, const
         }
         vector<FieldValue>* lhsValues = data[i]->getMutableValues();
         vector<FieldValue>* rhsValues = data[i + 1]->getMutableValues();
+        bool layoutMatches = classifiedLayout.size() == lhsValues->size();
+        if (layoutMatches) {
+            for (size_t p = 0; p < classifiedLayout.size(); p++) {
+                if (classifiedLayout[p] != (*lhsValues)[p].mField) {
+                    layoutMatches = false;
+                    break;
+                }
+            }
+        }
+        if (!layoutMatches) {
+            classifyLayout(*lhsValues);
+        }
         needMerge = true;
         for (int p = 0; p < (int)lhsValues->size(); p++) {
             if ((*lhsValues)[p].mField != (*rhsValues)[p].mField) {
                 needMerge = false;
                 break;
             }
-            if ((*lhsValues)[p].mValue != (*rhsValues)[p].mValue) {
-                int pos = (*lhsValues)[p].mField.getPosAtDepth(0);
-                // Differ on non-additive field, abort.
-                // Repeated additive fields are treated as non-additive fields.
-                if (isPrimitiveRepeatedField((*lhsValues)[p].mField) ||
-                    (additiveFields.find(pos) == additiveFields.end())) {
-                    needMerge = false;
-                    break;
-                }
+            // Differ on non-additive field, abort.
+            if (!isAdditiveAtIndex[p] && (*lhsValues)[p].mValue != (*rhsValues)[p].mValue) {
+                needMerge = false;
+                break;
             }
         }
         if (!needMerge) {
@@ -139,10 +164,7 @@ void mapAndMergeIsolatedUidsToHostUid(vector<shared_ptr<LogEvent>>& data, const
         }
         // This should be infrequent operation.
         for (int p = 0; p < (int)lhsValues->size(); p++) {
-            int pos = (*lhsValues)[p].mField.getPosAtDepth(0);
-            // Don't merge repeated fields.
-            if (!isPrimitiveRepeatedField((*lhsValues)[p].mField) &&
-                (additiveFields.find(pos) != additiveFields.end())) {
+            if (isAdditiveAtIndex[p]) {
                 (*rhsValues)[p].mValue += (*lhsValues)[p].mValue;
             }
         }
@@ -60,6 +60,13 @@ void FlagProvider::initBootFlags(const vector<string>& flags) {
     }
 }
 
+void FlagProvider::refreshServerFlagCache() {
+    std::lock_guard<std::mutex> lock(mFlagsMutex);
+    for (auto& [flagName, flagValue] : mServerFlagCache) {
+        flagValue = mGetServerFlagFunc(STATSD_NATIVE_NAMESPACE, flagName, FLAG_EMPTY);
+    }
+}
+
 void FlagProvider::overrideFlag(const string& flagName, const std::string& flagValue,
                                 const bool isBootFlag) {
     std::lock_guard<std::mutex> lock(mFlagsMutex);
@@ -76,6 +83,8 @@ void FlagProvider::overrideFuncsLocked(const IsAtLeastSFunc& isAtLeastSFunc,
                                        const GetServerFlagFunc& getServerFlagFunc) {
     mIsAtLeastSFunc = isAtLeastSFunc;
     mGetServerFlagFunc = getServerFlagFunc;
+    // Values read through the old func are stale now.
+    mServerFlagCache.clear();
 }
 
 string FlagProvider::getLocalFlagKey(const string& flagName, const bool isBootFlag) const {
@@ -95,7 +104,14 @@ string FlagProvider::getFlagStringInternal(const std::string& flagName,
         return mLocalFlags.at(localFlagKey);
     }
     if (!isBootFlag) {
-        return mGetServerFlagFunc(STATSD_NATIVE_NAMESPACE, flagName, defaultValue);
+        auto cacheIt = mServerFlagCache.find(flagName);
+        if (cacheIt == mServerFlagCache.end()) {
+            cacheIt = mServerFlagCache
+                              .emplace(flagName, mGetServerFlagFunc(STATSD_NATIVE_NAMESPACE,
+                                                                    flagName, FLAG_EMPTY))
+                              .first;
+        }
+        return cacheIt->second == FLAG_EMPTY ? defaultValue : cacheIt->second;
     }
     const auto& it = mBootFlags.find(flagName);
     return it == mBootFlags.end() ? defaultValue : it->second;
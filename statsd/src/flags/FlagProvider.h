@@ -40,6 +40,9 @@ const std::string STATSD_NATIVE_BOOT_NAMESPACE = "statsd_native_boot";
 
 const std::string STATSD_INIT_COMPLETED_NO_DELAY_FLAG = "statsd_init_completed_no_delay";
 
+const std::string THREAD_POLICY_ENABLED_FLAG = "thread_policy_enabled";
+const std::string THREAD_POLICY_ESCALATE_DEPTH_FLAG = "thread_policy_escalate_queue_depth";
+
 const std::string FLAG_TRUE = "true";
 const std::string FLAG_FALSE = "false";
 const std::string FLAG_EMPTY = "";
@@ -62,6 +65,12 @@ public:
     // Queries the boot flags. Should only be called once at boot.
     void initBootFlags(const std::vector<std::string>& flags);
 
+    // Re-reads every server flag that has been queried so far and stores the fresh
+    // values in the local cache. Between refreshes, flag queries are served from the
+    // cache instead of going to the property store, so flag changes take effect at
+    // the next refresh trigger (boot-complete or a config update), not immediately.
+    void refreshServerFlagCache();
+
 private:
     FlagProvider();
 
@@ -97,6 +106,12 @@ private:
     // Flag values to be locally overwritten. Only used in tests.
     std::unordered_map<std::string, std::string> mLocalFlags;
 
+    // Cached server (non-boot) flag values, keyed by flag name. FLAG_EMPTY stands for
+    // "not set, use the caller's default". Filled lazily on the first query per flag
+    // and re-read only by refreshServerFlagCache(), so steady-state queries never hit
+    // the property store. Mutable because queries are logically const.
+    mutable std::unordered_map<std::string, std::string> mServerFlagCache;
+
     mutable std::mutex mFlagsMutex;
 
     friend class ConfigUpdateE2eTest;
@@ -20,6 +20,8 @@
 
 #include <android/util/ProtoOutputStream.h>
 
+#include <algorithm>
+
 #include "../stats_log_util.h"
 #include "shell/ShellSubscriber.h"
 #include "statslog_statsd.h"
@@ -63,6 +65,9 @@ const int FIELD_ID_STATSD_STATS_ID = 22;
 const int FIELD_ID_SUBSCRIPTION_STATS = 23;
 const int FIELD_ID_SOCKET_LOSS_STATS = 24;
 const int FIELD_ID_QUEUE_STATS = 25;
+const int FIELD_ID_PIPELINE_LATENCY_HISTOGRAMS = 26;
+const int FIELD_ID_SELF_PROFILE_SNAPSHOT = 27;
+const int FIELD_ID_INTERNAL_ATOM_SAMPLING_STATS = 28;
 
 const int FIELD_ID_RESTRICTED_METRIC_QUERY_STATS_CALLING_UID = 1;
 const int FIELD_ID_RESTRICTED_METRIC_QUERY_STATS_CONFIG_ID = 2;
@@ -97,6 +102,33 @@ const int FIELD_ID_OVERFLOW_MIN_HISTORY = 3;
 const int FIELD_ID_QUEUE_MAX_SIZE_OBSERVED = 1;
 const int FIELD_ID_QUEUE_MAX_SIZE_OBSERVED_ELAPSED_NANOS = 2;
 
+const int FIELD_ID_PIPELINE_LATENCY_SOCKET_TO_QUEUE = 1;
+const int FIELD_ID_PIPELINE_LATENCY_QUEUE_WAIT = 2;
+const int FIELD_ID_PIPELINE_LATENCY_ON_LOG_EVENT = 3;
+const int FIELD_ID_PIPELINE_LATENCY_DUMP_REPORT = 4;
+
+// for SelfProfileSnapshot
+const int FIELD_ID_SELF_PROFILE_TRIGGER = 1;
+const int FIELD_ID_SELF_PROFILE_CAPTURE_TIME_SEC = 2;
+const int FIELD_ID_SELF_PROFILE_OVERFLOW_COUNT = 3;
+const int FIELD_ID_SELF_PROFILE_QUEUE_MAX_SIZE_OBSERVED = 4;
+const int FIELD_ID_SELF_PROFILE_SOCKET_TO_QUEUE_P50_NS = 5;
+const int FIELD_ID_SELF_PROFILE_SOCKET_TO_QUEUE_P99_NS = 6;
+const int FIELD_ID_SELF_PROFILE_QUEUE_WAIT_P50_NS = 7;
+const int FIELD_ID_SELF_PROFILE_QUEUE_WAIT_P99_NS = 8;
+const int FIELD_ID_SELF_PROFILE_ON_LOG_EVENT_P50_NS = 9;
+const int FIELD_ID_SELF_PROFILE_ON_LOG_EVENT_P99_NS = 10;
+const int FIELD_ID_SELF_PROFILE_TOP_ATOMS = 11;
+// for SelfProfileSnapshot.AtomCost
+const int FIELD_ID_SELF_PROFILE_TOP_ATOM_ID = 1;
+const int FIELD_ID_SELF_PROFILE_TOP_ATOM_LOG_COUNT = 2;
+
+// for InternalAtomSamplingStats
+const int FIELD_ID_INTERNAL_ATOM_SAMPLING_ATOM_ID = 1;
+const int FIELD_ID_INTERNAL_ATOM_SAMPLING_OCCURRENCE_COUNT = 2;
+const int FIELD_ID_INTERNAL_ATOM_SAMPLING_WRITTEN_COUNT = 3;
+const int FIELD_ID_INTERNAL_ATOM_SAMPLING_MAX_INTERVAL = 4;
+
 const int FIELD_ID_CONFIG_STATS_UID = 1;
 const int FIELD_ID_CONFIG_STATS_ID = 2;
 const int FIELD_ID_CONFIG_STATS_CREATION = 3;
@@ -207,7 +239,6 @@ const std::map<int, std::pair<size_t, size_t>> StatsdStats::kAtomDimensionKeySiz
 };
 
 StatsdStats::StatsdStats() : mStatsdStatsId(rand()) {
-    mPushedAtomStats.resize(kMaxPushedAtomId + 1);
     mStartTimeSec = getWallClockSec();
 }
 
@@ -346,10 +377,13 @@ void StatsdStats::noteDataDropped(const ConfigKey& key, const size_t totalBytes)
 }
 
 void StatsdStats::noteEventQueueOverflow(int64_t oldestEventTimestampNs, int32_t atomId,
-                                         bool isSkipped) {
+                                         bool isSkipped, bool isHighPriority) {
     lock_guard<std::mutex> lock(mLock);
 
     mOverflowCount++;
+    if (isHighPriority) {
+        mOverflowCountHighPriority++;
+    }
 
     int64_t history = getElapsedRealtimeNs() - oldestEventTimestampNs;
 
@@ -363,17 +397,182 @@ void StatsdStats::noteEventQueueOverflow(int64_t oldestEventTimestampNs, int32_t
 
     noteAtomLoggedLocked(atomId, isSkipped);
     noteAtomDroppedLocked(atomId);
+
+    // Self-profiling trigger: sustained overflow inside the counting window.
+    const int32_t nowSec = getWallClockSec();
+    if (nowSec - mSelfProfileOverflowWindowStartSec > kSelfProfileOverflowWindowSec) {
+        mSelfProfileOverflowWindowStartSec = nowSec;
+        mSelfProfileOverflowsInWindow = 0;
+    }
+    if (++mSelfProfileOverflowsInWindow >= kSelfProfileOverflowCountThreshold) {
+        mSelfProfileOverflowsInWindow = 0;
+        captureSelfProfileLocked(SELF_PROFILE_TRIGGER_QUEUE_OVERFLOW);
+    }
+}
+
+void StatsdStats::noteEventFastRejected() {
+    mEventFastRejectCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StatsdStats::noteEventThrottled() {
+    mEventThrottledCount.fetch_add(1, std::memory_order_relaxed);
 }
 
 void StatsdStats::noteEventQueueSize(int32_t size, int64_t eventTimestampNs) {
-    lock_guard<std::mutex> lock(mLock);
+    // Called on every queue push from the socket thread. In the common case the
+    // current size does not exceed the observed max and no lock is needed.
+    mEventQueueLatestSize.store(size, std::memory_order_relaxed);
+    if (size <= mEventQueueMaxSizeObserved.load(std::memory_order_relaxed)) {
+        return;
+    }
 
-    if (mEventQueueMaxSizeObserved < size) {
-        mEventQueueMaxSizeObserved = size;
+    lock_guard<std::mutex> lock(mLock);
+    if (mEventQueueMaxSizeObserved.load(std::memory_order_relaxed) < size) {
+        mEventQueueMaxSizeObserved.store(size, std::memory_order_relaxed);
         mEventQueueMaxSizeObservedElapsedNanos = eventTimestampNs;
     }
 }
 
+int32_t StatsdStats::getInternalAtomSamplingInterval() const {
+    const int32_t depth = mEventQueueLatestSize.load(std::memory_order_relaxed);
+    if (depth < kInternalAtomShedStartQueueSize) {
+        return 1;
+    }
+    int32_t interval = 2;
+    for (int32_t threshold = kInternalAtomShedStartQueueSize + kInternalAtomShedStepSize;
+         depth >= threshold && interval < kInternalAtomMaxSamplingInterval;
+         threshold += kInternalAtomShedStepSize) {
+        interval *= 2;
+    }
+    return interval;
+}
+
+bool StatsdStats::shouldLogInternalAtom(int32_t atomId) {
+    const int32_t interval = getInternalAtomSamplingInterval();
+
+    lock_guard<std::mutex> lock(mLock);
+    InternalAtomSamplingStats& stats = mInternalAtomSamplingStats[atomId];
+    stats.occurrenceCount++;
+    if (interval > stats.maxSamplingInterval) {
+        stats.maxSamplingInterval = interval;
+    }
+    if (stats.suppressedSinceWritten + 1 < interval) {
+        stats.suppressedSinceWritten++;
+        return false;
+    }
+    stats.suppressedSinceWritten = 0;
+    stats.writtenCount++;
+    return true;
+}
+
+void StatsdStats::noteSocketToQueueLatency(int64_t latencyNs) {
+    mSocketToQueueLatency.addSample(latencyNs);
+}
+
+void StatsdStats::noteQueueWaitLatency(int64_t latencyNs) {
+    mQueueWaitLatency.addSample(latencyNs);
+}
+
+void StatsdStats::noteOnLogEventLatency(int64_t latencyNs) {
+    mOnLogEventLatency.addSample(latencyNs);
+
+    // Self-profiling trigger: repeated slow per-config event processing. The
+    // fast path stays lock free; mLock is only taken once the slow-event count
+    // crosses the threshold.
+    if (latencyNs < kSelfProfileSlowEventThresholdNs) {
+        return;
+    }
+    if (mSelfProfileSlowEventCount.fetch_add(1, std::memory_order_relaxed) + 1 <
+        kSelfProfileSlowEventCountThreshold) {
+        return;
+    }
+    mSelfProfileSlowEventCount.store(0, std::memory_order_relaxed);
+    lock_guard<std::mutex> lock(mLock);
+    captureSelfProfileLocked(SELF_PROFILE_TRIGGER_ON_LOG_EVENT_LATENCY);
+}
+
+void StatsdStats::noteDumpReportLatency(int64_t latencyNs) {
+    mDumpReportLatency.addSample(latencyNs);
+}
+
+void StatsdStats::captureSelfProfileLocked(const int32_t trigger) {
+    const int32_t nowSec = getWallClockSec();
+    if (mLastSelfProfileSec != 0 && nowSec - mLastSelfProfileSec < kSelfProfileMinIntervalSec) {
+        return;
+    }
+    mLastSelfProfileSec = nowSec;
+
+    SelfProfileSnapshot snapshot;
+    snapshot.trigger = trigger;
+    snapshot.captureTimeSec = nowSec;
+    snapshot.overflowCount = mOverflowCount;
+    snapshot.eventQueueMaxSizeObserved =
+            mEventQueueMaxSizeObserved.load(std::memory_order_relaxed);
+    snapshot.socketToQueueP50Ns = mSocketToQueueLatency.approximatePercentileNs(0.5);
+    snapshot.socketToQueueP99Ns = mSocketToQueueLatency.approximatePercentileNs(0.99);
+    snapshot.queueWaitP50Ns = mQueueWaitLatency.approximatePercentileNs(0.5);
+    snapshot.queueWaitP99Ns = mQueueWaitLatency.approximatePercentileNs(0.99);
+    snapshot.onLogEventP50Ns = mOnLogEventLatency.approximatePercentileNs(0.5);
+    snapshot.onLogEventP99Ns = mOnLogEventLatency.approximatePercentileNs(0.99);
+
+    // Top pushed atoms by log count; the log counts are the best available proxy
+    // for per-atom processing cost. (logCount, atomId) pairs so the sort orders
+    // by count first.
+    std::vector<std::pair<int32_t, int32_t>> counts;
+    for (size_t i = 2; i < mPushedAtomStats.size(); i++) {
+        const int32_t count = mPushedAtomStats[i].logCount.load(std::memory_order_relaxed);
+        if (count > 0) {
+            counts.emplace_back(count, (int32_t)i);
+        }
+    }
+    for (const auto& [atomId, stats] : mNonPlatformPushedAtomStats) {
+        if (stats.logCount > 0) {
+            counts.emplace_back(stats.logCount, atomId);
+        }
+    }
+    const size_t topCount = std::min(counts.size(), kSelfProfileTopAtomCount);
+    std::partial_sort(counts.begin(), counts.begin() + topCount, counts.end(),
+                      [](const auto& lhs, const auto& rhs) { return lhs > rhs; });
+    for (size_t i = 0; i < topCount; i++) {
+        snapshot.topAtoms.push_back({counts[i].second, counts[i].first});
+    }
+
+    if (mSelfProfileSnapshots.size() >= kMaxSelfProfileSnapshots) {
+        mSelfProfileSnapshots.pop_front();
+    }
+    mSelfProfileSnapshots.push_back(std::move(snapshot));
+}
+
+int64_t StatsdStats::LatencyHistogram::sampleCount() const {
+    int64_t count = 0;
+    for (const auto& bucket : mBuckets) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+int64_t StatsdStats::LatencyHistogram::approximatePercentileNs(double percentile) const {
+    const int64_t total = sampleCount();
+    if (total == 0) {
+        return 0;
+    }
+    const int64_t rank = static_cast<int64_t>(total * percentile);
+    int64_t cumulative = 0;
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        cumulative += mBuckets[i].load(std::memory_order_relaxed);
+        if (cumulative > rank) {
+            return i == 0 ? 0 : (1LL << i);
+        }
+    }
+    return 1LL << (kNumBuckets - 1);
+}
+
+void StatsdStats::LatencyHistogram::reset() {
+    for (auto& bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
 void StatsdStats::noteAtomDroppedLocked(int32_t atomId) {
     constexpr int kMaxPushedAtomDroppedStatsSize = kMaxPushedAtomId + kMaxNonPlatformPushedAtoms;
     if (mPushedAtomDropsStats.size() < kMaxPushedAtomDroppedStatsSize ||
@@ -675,6 +874,15 @@ void StatsdStats::notePullExceedMaxDelay(int pullAtomId) {
 }
 
 void StatsdStats::noteAtomLogged(int atomId, int32_t /*timeSec*/, bool isSkipped) {
+    if (atomId >= 0 && atomId <= kMaxPushedAtomId) {
+        // Per-event fast path: a single indexed atomic increment, no lock.
+        mPushedAtomStats[atomId].logCount.fetch_add(1, std::memory_order_relaxed);
+        if (isSkipped) {
+            mPushedAtomStats[atomId].skipCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+
     lock_guard<std::mutex> lock(mLock);
 
     noteAtomLoggedLocked(atomId, isSkipped);
@@ -682,8 +890,10 @@ void StatsdStats::noteAtomLogged(int atomId, int32_t /*timeSec*/, bool isSkipped
 
 void StatsdStats::noteAtomLoggedLocked(int atomId, bool isSkipped) {
     if (atomId >= 0 && atomId <= kMaxPushedAtomId) {
-        mPushedAtomStats[atomId].logCount++;
-        mPushedAtomStats[atomId].skipCount += isSkipped;
+        mPushedAtomStats[atomId].logCount.fetch_add(1, std::memory_order_relaxed);
+        if (isSkipped) {
+            mPushedAtomStats[atomId].skipCount.fetch_add(1, std::memory_order_relaxed);
+        }
     } else {
         if (atomId < 0) {
             android_errorWriteLog(0x534e4554, "187957589");
@@ -1015,6 +1225,21 @@ void StatsdStats::noteSubscriptionPullThreadWakeup() {
     mSubscriptionPullThreadWakeupCount++;
 }
 
+void StatsdStats::noteWorkerPoolQueueDepth(size_t depth) {
+    lock_guard<std::mutex> lock(mLock);
+    mWorkerPoolMaxQueueDepth = std::max(mWorkerPoolMaxQueueDepth, static_cast<int32_t>(depth));
+}
+
+void StatsdStats::noteEventQueueResized(bool grew, size_t newQueueLimit) {
+    lock_guard<std::mutex> lock(mLock);
+    if (grew) {
+        mEventQueueGrowthCount++;
+    } else {
+        mEventQueueShrinkCount++;
+    }
+    mEventQueueCurrentLimit = static_cast<int32_t>(newQueueLimit);
+}
+
 StatsdStats::AtomMetricStats& StatsdStats::getAtomMetricStats(int64_t metricId) {
     auto atomMetricStatsIter = mAtomMetricStats.find(metricId);
     if (atomMetricStatsIter != mAtomMetricStats.end()) {
@@ -1029,21 +1254,49 @@ void StatsdStats::reset() {
     resetInternalLocked();
 }
 
+void StatsdStats::trimMemory() {
+    lock_guard<std::mutex> lock(mLock);
+    // resetInternalLocked() clears these maps but keeps their bucket arrays, so
+    // after a non-platform atom storm the tables can dwarf the live set.
+    if (mNonPlatformPushedAtomStats.bucket_count() >
+        2 * (mNonPlatformPushedAtomStats.size() + 1)) {
+        mNonPlatformPushedAtomStats.rehash(0);
+    }
+    if (mPushedAtomDropsStats.bucket_count() > 2 * (mPushedAtomDropsStats.size() + 1)) {
+        mPushedAtomDropsStats.rehash(0);
+    }
+}
+
 void StatsdStats::resetInternalLocked() {
     // Reset the historical data, but keep the active ConfigStats
     mStartTimeSec = getWallClockSec();
     mIceBox.clear();
-    std::fill(mPushedAtomStats.begin(), mPushedAtomStats.end(), PushedAtomStats());
+    for (AtomicPushedAtomStats& stats : mPushedAtomStats) {
+        stats.logCount = 0;
+        stats.skipCount = 0;
+    }
     mNonPlatformPushedAtomStats.clear();
     mAnomalyAlarmRegisteredStats = 0;
     mPeriodicAlarmRegisteredStats = 0;
     mSystemServerRestartSec.clear();
     mLogLossStats.clear();
     mOverflowCount = 0;
+    mOverflowCountHighPriority = 0;
+    mEventFastRejectCount = 0;
+    mEventThrottledCount = 0;
     mMinQueueHistoryNs = kInt64Max;
     mMaxQueueHistoryNs = 0;
     mEventQueueMaxSizeObserved = 0;
     mEventQueueMaxSizeObservedElapsedNanos = 0;
+    mSocketToQueueLatency.reset();
+    mQueueWaitLatency.reset();
+    mOnLogEventLatency.reset();
+    mDumpReportLatency.reset();
+    mSelfProfileSnapshots.clear();
+    mSelfProfileOverflowWindowStartSec = 0;
+    mSelfProfileOverflowsInWindow = 0;
+    mSelfProfileSlowEventCount = 0;
+    mInternalAtomSamplingStats.clear();
     for (auto& config : mConfigStats) {
         config.second->broadcast_sent_time_sec.clear();
         config.second->activation_time_sec.clear();
@@ -1100,6 +1353,9 @@ void StatsdStats::resetInternalLocked() {
     mPushedAtomDropsStats.clear();
     mRestrictedMetricQueryStats.clear();
     mSubscriptionPullThreadWakeupCount = 0;
+    mWorkerPoolMaxQueueDepth = 0;
+    mEventQueueGrowthCount = 0;
+    mEventQueueShrinkCount = 0;
 
     for (auto it = mSubscriptionStats.begin(); it != mSubscriptionStats.end();) {
         if (it->second.end_time_sec > 0) {
@@ -1156,6 +1412,17 @@ bool StatsdStats::hasSocketLoss() const {
     return !mLogLossStats.empty();
 }
 
+void StatsdStats::dumpLatencyHistogram(int out, const char* name,
+                                       const LatencyHistogram& histogram) {
+    const int64_t count = histogram.sampleCount();
+    if (count == 0) {
+        return;
+    }
+    dprintf(out, "%s: %lld samples, ~p50 %lld ns, ~p99 %lld ns\n", name, (long long)count,
+            (long long)histogram.approximatePercentileNs(0.5),
+            (long long)histogram.approximatePercentileNs(0.99));
+}
+
 void StatsdStats::dumpStats(int out) const {
     lock_guard<std::mutex> lock(mLock);
     time_t t = mStartTimeSec;
@@ -1346,8 +1613,8 @@ void StatsdStats::dumpStats(int out) const {
         if (mPushedAtomStats[i].logCount > 0) {
             dprintf(out,
                     "Atom %zu->(total count)%d, (error count)%d, (drop count)%d, (skip count)%d\n",
-                    i, mPushedAtomStats[i].logCount, getPushedAtomErrorsLocked((int)i),
-                    getPushedAtomDropsLocked((int)i), mPushedAtomStats[i].skipCount);
+                    i, mPushedAtomStats[i].logCount.load(), getPushedAtomErrorsLocked((int)i),
+                    getPushedAtomDropsLocked((int)i), mPushedAtomStats[i].skipCount.load());
         }
     }
     for (const auto& pair : mNonPlatformPushedAtomStats) {
@@ -1441,10 +1708,37 @@ void StatsdStats::dumpStats(int out) const {
     }
 
     dprintf(out, "********EventQueueOverflow stats***********\n");
-    dprintf(out, "Event queue overflow: %d; MaxHistoryNs: %lld; MinHistoryNs: %lld\n",
-            mOverflowCount, (long long)mMaxQueueHistoryNs, (long long)mMinQueueHistoryNs);
-    dprintf(out, "Event queue max size: %d; Observed at : %lld\n", mEventQueueMaxSizeObserved,
-            (long long)mEventQueueMaxSizeObservedElapsedNanos);
+    dprintf(out, "Event queue overflow: %d (high priority: %d); MaxHistoryNs: %lld; "
+            "MinHistoryNs: %lld\n",
+            mOverflowCount, mOverflowCountHighPriority, (long long)mMaxQueueHistoryNs,
+            (long long)mMinQueueHistoryNs);
+    dprintf(out, "Event queue max size: %d; Observed at : %lld\n",
+            mEventQueueMaxSizeObserved.load(), (long long)mEventQueueMaxSizeObservedElapsedNanos);
+    dprintf(out, "Socket fast-rejected events: %d\n", mEventFastRejectCount.load());
+    dprintf(out, "Socket throttled events: %d\n", mEventThrottledCount.load());
+
+    dumpLatencyHistogram(out, "Socket-to-queue latency", mSocketToQueueLatency);
+    dumpLatencyHistogram(out, "Queue-wait latency", mQueueWaitLatency);
+    dumpLatencyHistogram(out, "Per-config OnLogEvent latency", mOnLogEventLatency);
+    dumpLatencyHistogram(out, "Dump report latency", mDumpReportLatency);
+
+    if (!mSelfProfileSnapshots.empty()) {
+        dprintf(out, "********Self-profile snapshots***********\n");
+        for (const auto& snapshot : mSelfProfileSnapshots) {
+            dprintf(out,
+                    "Trigger %d at %s: overflow count %d, queue max size %d, "
+                    "socket-to-queue p50/p99 ns %lld/%lld, queue-wait p50/p99 ns %lld/%lld, "
+                    "OnLogEvent p50/p99 ns %lld/%lld\n",
+                    snapshot.trigger, buildTimeString(snapshot.captureTimeSec).c_str(),
+                    snapshot.overflowCount, snapshot.eventQueueMaxSizeObserved,
+                    (long long)snapshot.socketToQueueP50Ns, (long long)snapshot.socketToQueueP99Ns,
+                    (long long)snapshot.queueWaitP50Ns, (long long)snapshot.queueWaitP99Ns,
+                    (long long)snapshot.onLogEventP50Ns, (long long)snapshot.onLogEventP99Ns);
+            for (const auto& atomCost : snapshot.topAtoms) {
+                dprintf(out, "\tAtom %d logged %d times\n", atomCost.atomId, atomCost.logCount);
+            }
+        }
+    }
 
     if (mActivationBroadcastGuardrailStats.size() > 0) {
         dprintf(out, "********mActivationBroadcastGuardrail stats***********\n");
@@ -1457,6 +1751,13 @@ void StatsdStats::dumpStats(int out) const {
         dprintf(out, "\n");
     }
 
+    dprintf(out, "Worker pool max queue depth: %d\n", mWorkerPoolMaxQueueDepth);
+
+    if (mEventQueueGrowthCount > 0 || mEventQueueShrinkCount > 0 || mEventQueueCurrentLimit > 0) {
+        dprintf(out, "Event queue resizes: %d growths, %d shrinks, current limit %d\n",
+                mEventQueueGrowthCount, mEventQueueShrinkCount, mEventQueueCurrentLimit);
+    }
+
     dprintf(out, "********Atom Subscription stats***********\n");
     dprintf(out, "Pull thread wakeup count: %d\n", mSubscriptionPullThreadWakeupCount);
     for (const auto& [id, subStats] : mSubscriptionStats) {
@@ -1721,7 +2022,8 @@ void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
             uint64_t token =
                     proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM_STATS | FIELD_COUNT_REPEATED);
             proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_TAG, (int32_t)i);
-            proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_COUNT, mPushedAtomStats[i].logCount);
+            proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_COUNT,
+                        mPushedAtomStats[i].logCount.load());
             const int errors = getPushedAtomErrorsLocked(i);
             writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_ERROR_COUNT, errors,
                                      &proto);
@@ -1729,7 +2031,7 @@ void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
             writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_DROPS_COUNT, drops,
                                      &proto);
             writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_SKIP_COUNT,
-                                     mPushedAtomStats[i].skipCount, &proto);
+                                     mPushedAtomStats[i].skipCount.load(), &proto);
             proto.end(token);
         }
     }
@@ -1807,6 +2109,82 @@ void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
                 (long long)mEventQueueMaxSizeObservedElapsedNanos);
     proto.end(queueStatsToken);
 
+    // Pipeline latency histograms. Buckets are positional, so everything up to
+    // the last non-empty bucket is written; trailing empty buckets are trimmed.
+    const auto writeLatencyHistogram = [&proto](const LatencyHistogram& histogram, int fieldId) {
+        size_t lastNonEmpty = 0;
+        bool hasSamples = false;
+        for (size_t i = 0; i < LatencyHistogram::kNumBuckets; i++) {
+            if (histogram.bucketCount(i) > 0) {
+                lastNonEmpty = i;
+                hasSamples = true;
+            }
+        }
+        if (!hasSamples) {
+            return;
+        }
+        for (size_t i = 0; i <= lastNonEmpty; i++) {
+            proto.write(FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED | fieldId,
+                        (long long)histogram.bucketCount(i));
+        }
+    };
+    if (mSocketToQueueLatency.sampleCount() > 0 || mQueueWaitLatency.sampleCount() > 0 ||
+        mOnLogEventLatency.sampleCount() > 0 || mDumpReportLatency.sampleCount() > 0) {
+        uint64_t latencyToken =
+                proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_PIPELINE_LATENCY_HISTOGRAMS);
+        writeLatencyHistogram(mSocketToQueueLatency, FIELD_ID_PIPELINE_LATENCY_SOCKET_TO_QUEUE);
+        writeLatencyHistogram(mQueueWaitLatency, FIELD_ID_PIPELINE_LATENCY_QUEUE_WAIT);
+        writeLatencyHistogram(mOnLogEventLatency, FIELD_ID_PIPELINE_LATENCY_ON_LOG_EVENT);
+        writeLatencyHistogram(mDumpReportLatency, FIELD_ID_PIPELINE_LATENCY_DUMP_REPORT);
+        proto.end(latencyToken);
+    }
+
+    for (const auto& snapshot : mSelfProfileSnapshots) {
+        uint64_t token = proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_SELF_PROFILE_SNAPSHOT |
+                                     FIELD_COUNT_REPEATED);
+        proto.write(FIELD_TYPE_ENUM | FIELD_ID_SELF_PROFILE_TRIGGER, snapshot.trigger);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_SELF_PROFILE_CAPTURE_TIME_SEC,
+                    snapshot.captureTimeSec);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_SELF_PROFILE_OVERFLOW_COUNT,
+                    snapshot.overflowCount);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_SELF_PROFILE_QUEUE_MAX_SIZE_OBSERVED,
+                    snapshot.eventQueueMaxSizeObserved);
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_SELF_PROFILE_SOCKET_TO_QUEUE_P50_NS,
+                    (long long)snapshot.socketToQueueP50Ns);
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_SELF_PROFILE_SOCKET_TO_QUEUE_P99_NS,
+                    (long long)snapshot.socketToQueueP99Ns);
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_SELF_PROFILE_QUEUE_WAIT_P50_NS,
+                    (long long)snapshot.queueWaitP50Ns);
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_SELF_PROFILE_QUEUE_WAIT_P99_NS,
+                    (long long)snapshot.queueWaitP99Ns);
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_SELF_PROFILE_ON_LOG_EVENT_P50_NS,
+                    (long long)snapshot.onLogEventP50Ns);
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_SELF_PROFILE_ON_LOG_EVENT_P99_NS,
+                    (long long)snapshot.onLogEventP99Ns);
+        for (const auto& atomCost : snapshot.topAtoms) {
+            uint64_t atomToken = proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_SELF_PROFILE_TOP_ATOMS |
+                                             FIELD_COUNT_REPEATED);
+            proto.write(FIELD_TYPE_INT32 | FIELD_ID_SELF_PROFILE_TOP_ATOM_ID, atomCost.atomId);
+            proto.write(FIELD_TYPE_INT32 | FIELD_ID_SELF_PROFILE_TOP_ATOM_LOG_COUNT,
+                        atomCost.logCount);
+            proto.end(atomToken);
+        }
+        proto.end(token);
+    }
+
+    for (const auto& [atomId, samplingStats] : mInternalAtomSamplingStats) {
+        uint64_t token = proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_INTERNAL_ATOM_SAMPLING_STATS |
+                                     FIELD_COUNT_REPEATED);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_INTERNAL_ATOM_SAMPLING_ATOM_ID, atomId);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_INTERNAL_ATOM_SAMPLING_OCCURRENCE_COUNT,
+                    samplingStats.occurrenceCount);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_INTERNAL_ATOM_SAMPLING_WRITTEN_COUNT,
+                    samplingStats.writtenCount);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_INTERNAL_ATOM_SAMPLING_MAX_INTERVAL,
+                    samplingStats.maxSamplingInterval);
+        proto.end(token);
+    }
+
     for (const auto& restart : mSystemServerRestartSec) {
         proto.write(FIELD_TYPE_INT32 | FIELD_ID_SYSTEM_SERVER_RESTART | FIELD_COUNT_REPEATED,
                     restart);
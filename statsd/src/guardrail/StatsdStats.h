@@ -19,6 +19,8 @@
 #include <log/log_time.h>
 #include <src/guardrail/stats_log_enums.pb.h>
 
+#include <array>
+#include <atomic>
 #include <list>
 #include <mutex>
 #include <string>
@@ -204,6 +206,40 @@ public:
 
     const static int kMaxRestrictedConfigDbSizeCount = 20;
 
+    // Self-profiling: a snapshot of statsd's own health counters is captured when
+    // this many queue overflows happen within the window below, or when this many
+    // per-config OnLogEvent calls exceed the slow-event threshold. Snapshots are
+    // rate limited to one per minimum interval and kept in a ring buffer of the
+    // size below until the next statsd stats report.
+    const static int kSelfProfileOverflowCountThreshold = 25;
+
+    const static int kSelfProfileOverflowWindowSec = 60;
+
+    static const int64_t kSelfProfileSlowEventThresholdNs = 100 * 1000000LL;
+
+    const static int kSelfProfileSlowEventCountThreshold = 20;
+
+    const static int kSelfProfileMinIntervalSec = 10 * 60;
+
+    const static size_t kMaxSelfProfileSnapshots = 4;
+
+    const static size_t kSelfProfileTopAtomCount = 5;
+
+    // Internal-atom load shedding starts once the event queue holds this many
+    // events, and the sampling interval doubles per further step of depth up
+    // to the cap. The start sits below the queue's initial admission limit so
+    // shedding kicks in whenever clients are already feeling backpressure.
+    const static int kInternalAtomShedStartQueueSize = 5000;
+
+    const static int kInternalAtomShedStepSize = 5000;
+
+    const static int kInternalAtomMaxSamplingInterval = 256;
+
+    enum SelfProfileTrigger {
+        SELF_PROFILE_TRIGGER_QUEUE_OVERFLOW = 1,
+        SELF_PROFILE_TRIGGER_ON_LOG_EVENT_LATENCY = 2,
+    };
+
     // Max memory allowed for storing metrics per configuration. If this limit is exceeded, statsd
     // drops the metrics data in memory.
     static const size_t kDefaultMaxMetricsBytesPerConfig = 2 * 1024 * 1024;
@@ -230,6 +266,10 @@ public:
     // The number of deleted apps that are stored in the uid map.
     const static int kMaxDeletedAppsInUidMap = 100;
 
+    // The number of consecutive uid map reports that may omit the full snapshot and
+    // carry only change records before the map re-bases with a full snapshot again.
+    const static int kMaxUidMapDeltaReports = 10;
+
     /* Minimum period between two broadcasts in nanoseconds. */
     static const int64_t kMinBroadcastPeriodNs = 60 * NS_PER_SEC;
 
@@ -248,6 +288,11 @@ public:
     /* Minimum period between two activation broadcasts in nanoseconds. */
     static const int64_t kMinActivationBroadcastPeriodNs = 10 * NS_PER_SEC;
 
+    /* When the device is already awake for one statsd alarm, anomaly alarms due within
+     * this slack ride the same wakeup instead of waiting for the next logged event.
+     * Kept at the alarm registration granularity so anomaly precision is unchanged. */
+    static const uint32_t kAlarmCoalescingSlackSec = 5;
+
     // Maximum age (30 days) that files on disk can exist in seconds.
     static const int kMaxAgeSecond = 60 * 60 * 24 * 30;
 
@@ -612,11 +657,66 @@ public:
 
     /* Reports one event id has been dropped due to queue overflow, and the oldest event timestamp
      * in the queue */
-    void noteEventQueueOverflow(int64_t oldestEventTimestampNs, int32_t atomId, bool isSkipped);
+    void noteEventQueueOverflow(int64_t oldestEventTimestampNs, int32_t atomId, bool isSkipped,
+                                bool isHighPriority = false);
+
+    /**
+     * Records that a datagram was rejected by the atom id peek on the socket
+     * before credential processing and LogEvent construction.
+     */
+    void noteEventFastRejected();
+
+    /**
+     * Records that a datagram was dropped by the per-uid ingestion throttle on
+     * the socket before LogEvent construction.
+     */
+    void noteEventThrottled();
 
     /* Notes queue max size seen so far and associated timestamp */
     void noteEventQueueSize(int32_t size, int64_t eventTimestampNs);
 
+    /**
+     * Load-shedding gate for atoms statsd writes about itself (the
+     * util::stats_write call sites). Returns whether this occurrence should
+     * be written. Under normal load every occurrence passes; as the event
+     * queue fills, the sampling interval doubles per kInternalAtomShedStepSize
+     * of depth so self-telemetry cost stays bounded during the overloads it
+     * describes. Every occurrence is counted and the largest interval applied
+     * is recorded, both reported in the StatsdStatsReport, so fleet
+     * aggregation can rescale the written counts.
+     */
+    bool shouldLogInternalAtom(int32_t atomId);
+
+    /**
+     * Sampling interval currently in effect for internal atoms: one written
+     * occurrence stands for this many. Derived from the latest event queue
+     * depth reported through noteEventQueueSize().
+     */
+    int32_t getInternalAtomSamplingInterval() const;
+
+    /**
+     * Records the delay between an event's elapsed timestamp and the moment
+     * the event was inserted into the event queue.
+     */
+    void noteSocketToQueueLatency(int64_t latencyNs);
+
+    /**
+     * Records how long an event sat in the event queue before the consumer
+     * thread popped it.
+     */
+    void noteQueueWaitLatency(int64_t latencyNs);
+
+    /**
+     * Records how long one config (MetricsManager) took to process one event
+     * inside StatsLogProcessor::OnLogEvent.
+     */
+    void noteOnLogEventLatency(int64_t latencyNs);
+
+    /**
+     * Records the duration of one full onDumpReport call.
+     */
+    void noteDumpReportLatency(int64_t latencyNs);
+
     /**
      * Reports that the activation broadcast guardrail was hit for this uid. Namely, the broadcast
      * should have been sent, but instead was skipped due to hitting the guardrail.
@@ -706,6 +806,17 @@ public:
      */
     void noteSubscriptionPullThreadWakeup();
 
+    /**
+     * Report the WorkerPool task queue depth observed when a task was enqueued.
+     */
+    void noteWorkerPoolQueueDepth(size_t depth);
+
+    /**
+     * Report that the event queue resized its backing storage, and the
+     * admission limit it resized to.
+     */
+    void noteEventQueueResized(bool grew, size_t newQueueLimit);
+
     /**
      * Reset the historical stats. Including all stats in icebox, and the tracked stats about
      * metrics, matchers, and atoms. The active configs will be kept and StatsdStats will continue
@@ -713,6 +824,12 @@ public:
      */
     void reset();
 
+    /**
+     * Shrinks hash tables still sized for a past atom storm. Does not change
+     * any stats; called from the idle maintenance pass.
+     */
+    void trimMemory();
+
     /**
      * Output the stats in protobuf binary format to [buffer].
      *
@@ -830,18 +947,26 @@ private:
     std::list<std::shared_ptr<ConfigStats>> mIceBox;
 
     // Stores the number of times a pushed atom is logged and skipped (if skipped).
-    // The size of the vector is the largest pushed atom id in atoms.proto + 1. Atoms
-    // out of that range will be put in mNonPlatformPushedAtomStats.
-    // This is a vector, not a map because it will be accessed A LOT -- for each stats log.
-    struct PushedAtomStats {
-        int logCount = 0;
-        int skipCount = 0;
+    // The array covers every pushed atom id in atoms.proto; atoms out of that range
+    // will be put in mNonPlatformPushedAtomStats.
+    // This is a flat array of atomics, not a map, because it is accessed A LOT -- for
+    // each stats log -- and noteAtomLogged must be a single indexed increment that
+    // does not take mLock.
+    struct AtomicPushedAtomStats {
+        std::atomic<int> logCount = 0;
+        std::atomic<int> skipCount = 0;
     };
 
-    std::vector<PushedAtomStats> mPushedAtomStats;
+    std::array<AtomicPushedAtomStats, kMaxPushedAtomId + 1> mPushedAtomStats;
 
     // Stores the number of times a pushed atom is logged and skipped for atom ids above
     // kMaxPushedAtomId. The max size of the map is kMaxNonPlatformPushedAtoms.
+    // Guarded by mLock; large ids are the rare case.
+    struct PushedAtomStats {
+        int logCount = 0;
+        int skipCount = 0;
+    };
+
     std::unordered_map<int, PushedAtomStats> mNonPlatformPushedAtomStats;
 
     // Stores the number of times a pushed atom is dropped due to queue overflow event.
@@ -925,12 +1050,131 @@ private:
     // Total number of events that are lost due to queue overflow.
     int32_t mOverflowCount = 0;
 
+    // Subset of mOverflowCount for events in the high-priority lane, i.e.
+    // important events lost even with the reserved queue headroom.
+    int32_t mOverflowCountHighPriority = 0;
+
+    // Number of datagrams dropped by the socket-side atom id peek without
+    // LogEvent construction (filtered-out atoms).
+    // Updated on every rejected datagram, so it is an atomic incremented
+    // without taking mLock.
+    std::atomic<int32_t> mEventFastRejectCount = 0;
+
+    // Number of datagrams dropped by the per-uid ingestion throttle on the
+    // socket. Updated on every throttled datagram, so it is an atomic
+    // incremented without taking mLock.
+    std::atomic<int32_t> mEventThrottledCount = 0;
+
     // Max number of events stored into the queue seen so far.
-    int32_t mEventQueueMaxSizeObserved = 0;
+    // Checked on every queue push; the common no-new-max case reads this
+    // atomic without taking mLock. mLock is only taken to record a new max.
+    std::atomic<int32_t> mEventQueueMaxSizeObserved = 0;
 
-    // Event timestamp for associated max size hit.
+    // Event timestamp for associated max size hit. Guarded by mLock.
     int64_t mEventQueueMaxSizeObservedElapsedNanos = 0;
 
+    // Most recent queue depth reported by the socket thread; drives the
+    // internal-atom sampling interval. Written relaxed on every queue push.
+    std::atomic<int32_t> mEventQueueLatestSize = 0;
+
+    // Occurrence bookkeeping for one internal atom under load shedding, so a
+    // written occurrence can be scaled back up during aggregation.
+    struct InternalAtomSamplingStats {
+        int32_t occurrenceCount = 0;
+        int32_t writtenCount = 0;
+        int32_t maxSamplingInterval = 1;
+        // Occurrences suppressed since the last written one; the next
+        // occurrence is written once this reaches the current interval.
+        int32_t suppressedSinceWritten = 0;
+    };
+
+    // Guarded by mLock; only touched when an internal atom fires.
+    std::map<int32_t, InternalAtomSamplingStats> mInternalAtomSamplingStats;
+
+    // Fixed-size latency histogram with power-of-two buckets: bucket i counts
+    // samples with a latency in [2^i, 2^(i+1)) nanoseconds and the last bucket
+    // absorbs anything larger. Samples are relaxed atomic increments so the
+    // hot paths can record latencies without taking mLock.
+    class LatencyHistogram {
+    public:
+        static constexpr size_t kNumBuckets = 32;
+
+        void addSample(int64_t latencyNs) {
+            size_t bucket = 0;
+            if (latencyNs > 0) {
+                bucket = 63 - __builtin_clzll(static_cast<uint64_t>(latencyNs));
+                if (bucket >= kNumBuckets) {
+                    bucket = kNumBuckets - 1;
+                }
+            }
+            mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        int64_t bucketCount(size_t bucket) const {
+            return mBuckets[bucket].load(std::memory_order_relaxed);
+        }
+
+        int64_t sampleCount() const;
+
+        // Lower bound (in ns) of the bucket holding the given percentile, or 0
+        // when the histogram is empty. Bucket granularity is good enough for
+        // the human readable dump.
+        int64_t approximatePercentileNs(double percentile) const;
+
+        void reset();
+
+    private:
+        std::array<std::atomic<int64_t>, kNumBuckets> mBuckets = {};
+    };
+
+    // Pipeline hot-path latency histograms, fed by the note*Latency methods.
+    LatencyHistogram mSocketToQueueLatency;
+    LatencyHistogram mQueueWaitLatency;
+    LatencyHistogram mOnLogEventLatency;
+    LatencyHistogram mDumpReportLatency;
+
+    static void dumpLatencyHistogram(int out, const char* name, const LatencyHistogram& histogram);
+
+    // One automatically captured self-profile; see the kSelfProfile* thresholds.
+    struct SelfProfileSnapshot {
+        int32_t trigger;
+        int32_t captureTimeSec;
+        int32_t overflowCount;
+        int32_t eventQueueMaxSizeObserved;
+        int64_t socketToQueueP50Ns;
+        int64_t socketToQueueP99Ns;
+        int64_t queueWaitP50Ns;
+        int64_t queueWaitP99Ns;
+        int64_t onLogEventP50Ns;
+        int64_t onLogEventP99Ns;
+        struct AtomCost {
+            int32_t atomId;
+            int32_t logCount;
+        };
+        // Heaviest first, at most kSelfProfileTopAtomCount entries.
+        std::vector<AtomCost> topAtoms;
+    };
+
+    // Ring buffer of captured self-profiles, oldest first.
+    // The max size of the list is kMaxSelfProfileSnapshots.
+    std::list<SelfProfileSnapshot> mSelfProfileSnapshots;
+
+    // Wall clock second of the most recent self-profile capture, for rate limiting.
+    int32_t mLastSelfProfileSec = 0;
+
+    // Start of the current overflow counting window and the overflows seen in it.
+    int32_t mSelfProfileOverflowWindowStartSec = 0;
+
+    int32_t mSelfProfileOverflowsInWindow = 0;
+
+    // Number of slow OnLogEvent calls since the last capture. Incremented on the
+    // event processing thread without taking mLock.
+    std::atomic<int32_t> mSelfProfileSlowEventCount = 0;
+
+    // Captures a snapshot of the current health counters unless one was captured
+    // less than kSelfProfileMinIntervalSec ago.
+    void captureSelfProfileLocked(int32_t trigger);
+
     // Timestamps when we detect log loss, and the number of logs lost.
     std::list<LogLossStats> mLogLossStats;
 
@@ -972,6 +1216,15 @@ private:
 
     int32_t mSubscriptionPullThreadWakeupCount = 0;
 
+    // Deepest WorkerPool task queue observed since the last stats reset.
+    int32_t mWorkerPoolMaxQueueDepth = 0;
+
+    // Event queue adaptive sizing: resize counts since the last stats reset,
+    // and the admission limit after the most recent resize (0 = never resized).
+    int32_t mEventQueueGrowthCount = 0;
+    int32_t mEventQueueShrinkCount = 0;
+    int32_t mEventQueueCurrentLimit = 0;
+
     // Maps Subscription ID to the corresponding SubscriptionStats struct object.
     // Size of this map is capped by ShellSubscriber::kMaxSubscriptions.
     std::map<int32_t, SubscriptionStats> mSubscriptionStats;
@@ -42,6 +42,22 @@ inline uint64_t Hash64(const std::string& str) {
   return Hash64(str.data(), str.size());
 }
 
+// xxHash-style 64-bit hash tuned for the short keys statsd hashes on the hot path. Processes
+// 16-byte stripes through two independent accumulator lanes (no loop-carried dependency, so
+// the multiplies pipeline/vectorize) with a strong final avalanche.
+//
+// The output is NOT a stable contract: use it only for in-memory tables. Persisted or
+// uploaded values (UidMap report string hashes, for example) must keep using Hash64 above.
+extern uint64_t Hash64Fast(const char* data, size_t n, uint64_t seed);
+
+inline uint64_t Hash64Fast(const char* data, size_t n) {
+  return Hash64Fast(data, n, 0);
+}
+
+inline uint64_t Hash64Fast(const std::string& str) {
+  return Hash64Fast(str.data(), str.size());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "logd/LogEvent.h"
+#include "statslog_statsd.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Build-time schema table for atoms whose wire layout is fixed: a flat run of
+// primitive fields with no lists, attribution chains, or key-value pairs. The
+// schemas mirror the statslog_statsd.h write signatures, expressed in the
+// socket type ids from LogEvent.h so that parsing, serialization planning, and
+// the fast-parse kernels all validate against the same table instead of
+// rediscovering atom structure per event at runtime.
+//
+// Only add an atom here if its proto definition is frozen; the static_asserts
+// next to the fast-parse kernels in LogEvent.cpp keep the kernels and this
+// table from drifting apart.
+
+constexpr size_t kMaxRegisteredAtomFields = 4;
+
+struct AtomSchema {
+    int32_t atomId;
+    uint8_t numFields;
+    // Socket type ids (INT32_TYPE etc.), one per top-level field in order.
+    std::array<uint8_t, kMaxRegisteredAtomFields> fieldTypes;
+};
+
+constexpr AtomSchema kRegisteredAtomSchemas[] = {
+        // uid, label, state
+        {util::APP_BREADCRUMB_REPORTED, 3, {INT32_TYPE, INT32_TYPE, INT32_TYPE}},
+        // parent_uid, isolated_uid, event
+        {util::ISOLATED_UID_CHANGED, 3, {INT32_TYPE, INT32_TYPE, INT32_TYPE}},
+        // uid, config_id, alert_id
+        {util::ANOMALY_DETECTED, 3, {INT32_TYPE, INT64_TYPE, INT64_TYPE}},
+};
+
+// Returns the registered schema for the atom, or nullptr for atoms that keep
+// using runtime discovery. Constexpr so kernel/table agreement can be checked
+// at compile time; the table is small enough that a linear scan also stays
+// cheap at runtime.
+constexpr const AtomSchema* findAtomSchema(int32_t atomId) {
+    for (const AtomSchema& schema : kRegisteredAtomSchemas) {
+        if (schema.atomId == atomId) {
+            return &schema;
+        }
+    }
+    return nullptr;
+}
+
+// True iff the atom is registered with exactly the given field type ids.
+// Intended for static_asserts binding a parseFixedBody kernel to the table.
+template <uint8_t... kTypeIds>
+constexpr bool schemaMatches(int32_t atomId) {
+    const AtomSchema* schema = findAtomSchema(atomId);
+    if (schema == nullptr || schema->numFields != sizeof...(kTypeIds)) {
+        return false;
+    }
+    const uint8_t expected[] = {kTypeIds...};
+    for (uint8_t i = 0; i < schema->numFields; i++) {
+        if (schema->fieldTypes[i] != expected[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -23,10 +23,15 @@
 #include <android/binder_ibinder.h>
 #include <private/android_filesystem_config.h>
 
+#include <mutex>
+#include <unordered_map>
+
 #include "flags/FlagProvider.h"
+#include "logd/AtomSchemaRegistry.h"
 #include "stats_annotations.h"
 #include "stats_log_util.h"
 #include "statslog_statsd.h"
+#include "utils/Utf8.h"
 
 namespace android {
 namespace os {
@@ -51,12 +56,103 @@ uint8_t getNumAnnotations(uint8_t typeInfo) {
     return (typeInfo >> 4) & 0x0F;  // num annotations in upper 4 bytes
 }
 
+// Guardrails for the per-atom annotation schema cache; atoms exceeding them
+// simply keep the generic decode path.
+constexpr size_t kMaxAnnotationSchemaBytes = 128;
+constexpr size_t kMaxAnnotationSchemaBlocks = 16;
+
+// Guards the schemas map below. Taken once per parsed event for the lookup
+// plus once when an atom's schema is first published or invalidated.
+std::mutex sAnnotationSchemasMutex;
+
+// Keyed by atom id; a nullptr entry marks an atom whose annotation layout
+// diverged between events and must always use the generic decode path.
+std::unordered_map<int, std::shared_ptr<const LogEvent::AnnotationSchema>>& annotationSchemas() {
+    static auto* schemas =
+            new std::unordered_map<int, std::shared_ptr<const LogEvent::AnnotationSchema>>();
+    return *schemas;
+}
+
 }  // namespace
 
+bool LogEvent::lookupAnnotationSchema(int tagId, std::shared_ptr<const AnnotationSchema>* schema) {
+    std::lock_guard<std::mutex> lock(sAnnotationSchemasMutex);
+    const auto it = annotationSchemas().find(tagId);
+    if (it == annotationSchemas().end()) {
+        return false;
+    }
+    *schema = it->second;
+    return true;
+}
+
+void LogEvent::publishAnnotationSchema(int tagId, std::shared_ptr<const AnnotationSchema> schema) {
+    std::lock_guard<std::mutex> lock(sAnnotationSchemasMutex);
+    // first fully-valid event wins; also keeps nullptr (unstable) markers
+    annotationSchemas().emplace(tagId, std::move(schema));
+}
+
+void LogEvent::invalidateAnnotationSchema(int tagId) {
+    std::lock_guard<std::mutex> lock(sAnnotationSchemasMutex);
+    annotationSchemas()[tagId] = nullptr;
+}
+
 LogEvent::LogEvent(int32_t uid, int32_t pid)
     : mLogdTimestampNs(getWallClockNs()), mLogUid(uid), mLogPid(pid) {
 }
 
+void LogEvent::reset(int32_t uid, int32_t pid) {
+    mBuf = nullptr;
+    mRemainingLen = 0;
+    mValid = true;
+    mParsedHeaderOnly = false;
+    // clear() keeps the vector capacity so a recycled event does not
+    // reallocate for atoms of similar arity
+    mValues.clear();
+    mLogdTimestampNs = getWallClockNs();
+    mElapsedTimestampNs = 0;
+    mTagId = 0;
+    mLogUid = uid;
+    mLogPid = pid;
+    mTruncateTimestamp = false;
+    mResetState = -1;
+    mRestrictionCategory = CATEGORY_NO_RESTRICTION;
+    mNumUidFields = 0;
+    mAttributionChainStartIndex.reset();
+    mAttributionChainEndIndex.reset();
+    mExclusiveStateFieldIndex.reset();
+    mRetainedBody = nullptr;
+    mRetainedBodyNumElements = 0;
+    mAnnotationSchema = nullptr;
+    mAnnotationSchemaBuilder = nullptr;
+    mAnnotationSchemaBlock = 0;
+    mAnnotationSchemaMismatch = false;
+}
+
+void LogEvent::retainBodyBuffer(const BodyBufferInfo& bodyInfo) {
+    if (!mValid) {
+        return;
+    }
+    mRetainedBody = std::make_shared<const std::vector<uint8_t>>(
+            bodyInfo.buffer, bodyInfo.buffer + bodyInfo.bufferSize);
+    mRetainedBodyNumElements = bodyInfo.numElements;
+    // the body is present, its materialization is merely deferred
+    mParsedHeaderOnly = false;
+}
+
+bool LogEvent::parseDeferredBody() {
+    if (mRetainedBody == nullptr) {
+        return mValid;
+    }
+    // keep the buffer alive for the duration of the parse, then release it
+    const std::shared_ptr<const std::vector<uint8_t>> body = std::move(mRetainedBody);
+    BodyBufferInfo bodyInfo;
+    bodyInfo.buffer = body->data();
+    bodyInfo.bufferSize = body->size();
+    bodyInfo.numElements = mRetainedBodyNumElements;
+    mRetainedBodyNumElements = 0;
+    return parseBody(bodyInfo);
+}
+
 LogEvent::LogEvent(const string& trainName, int64_t trainVersionCode, bool requiresStaging,
                    bool rollbackEnabled, bool requiresLowLatencyMonitor, int32_t state,
                    const std::vector<uint8_t>& experimentIds, int32_t userId) {
@@ -112,6 +208,12 @@ void LogEvent::parseString(int32_t* pos, int32_t depth, bool* last, uint8_t numA
     }
 
     string value = string((char*)mBuf, numBytes);
+    // Validate once at parse time so every stored string is well-formed UTF-8
+    // and downstream serialization never has to re-check. The SWAR ASCII fast
+    // path makes this essentially free for package/class/tag names.
+    if (!isValidUtf8(value.data(), value.size())) {
+        sanitizeUtf8(value);
+    }
     mBuf += numBytes;
     mRemainingLen -= numBytes;
     addToValues(pos, depth, value, last);
@@ -420,12 +522,176 @@ void LogEvent::parseFieldRestrictionAnnotation(uint8_t annotationType) {
     return;
 }
 
+bool LogEvent::replayAnnotationBlock(uint8_t numAnnotations, std::optional<uint8_t> numElements,
+                                     std::optional<size_t> firstUidInChainIndex) {
+    const AnnotationSchema& schema = *mAnnotationSchema;
+    if (mAnnotationSchemaBlock >= schema.blocks.size()) {
+        return false;
+    }
+    const AnnotationSchema::Block& block = schema.blocks[mAnnotationSchemaBlock];
+    if (block.numAnnotations != numAnnotations || mRemainingLen < block.byteSize ||
+        memcmp(mBuf, schema.bytes.data() + block.byteOffset, block.byteSize) != 0) {
+        return false;
+    }
+
+    // byte-identical to the first fully-validated event of this atom - skip
+    // decoding and apply the pre-decoded operations
+    mBuf += block.byteSize;
+    mRemainingLen -= block.byteSize;
+    mAnnotationSchemaBlock++;
+
+    for (uint8_t i = 0; i < numAnnotations; i++) {
+        applyCachedAnnotation(schema.ops[block.opStart + i], numElements, firstUidInChainIndex);
+    }
+    return true;
+}
+
+// Applies one cached annotation operation. The annotation id, type and value
+// were validated when the schema was built and the bytes were proven identical
+// by replayAnnotationBlock(), so only the event-dependent checks (field
+// presence, types and indices) remain.
+void LogEvent::applyCachedAnnotation(const AnnotationSchema::Op& op,
+                                     std::optional<uint8_t> numElements,
+                                     std::optional<size_t> firstUidInChainIndex) {
+    switch (op.annotationId) {
+        case ASTATSLOG_ANNOTATION_ID_IS_UID: {
+            if (!numElements) {
+                numElements = 1;
+            }
+            if (numElements == 0) {
+                break;
+            }
+            if (numElements > mValues.size() || !checkPreviousValueType(INT)) {
+                mValid = false;
+                break;
+            }
+            const bool isUid = op.value != 0;
+            if (isUid) {
+                mNumUidFields += numElements.value();
+            }
+            for (int i = 1; i <= numElements; i++) {
+                mValues[mValues.size() - i].mAnnotations.setUidField(isUid);
+            }
+            break;
+        }
+        case ASTATSLOG_ANNOTATION_ID_TRUNCATE_TIMESTAMP:
+            if (!mValues.empty()) {
+                mValid = false;
+                break;
+            }
+            mTruncateTimestamp = op.value != 0;
+            break;
+        case ASTATSLOG_ANNOTATION_ID_PRIMARY_FIELD:
+            if (mValues.empty() || firstUidInChainIndex || numElements) {
+                mValid = false;
+                break;
+            }
+            mValues[mValues.size() - 1].mAnnotations.setPrimaryField(op.value != 0);
+            break;
+        case ASTATSLOG_ANNOTATION_ID_PRIMARY_FIELD_FIRST_UID:
+            if (mValues.empty() || !firstUidInChainIndex ||
+                mValues.size() < firstUidInChainIndex.value() + 1) {
+                mValid = false;
+                break;
+            }
+            mValues[firstUidInChainIndex.value()].mAnnotations.setPrimaryField(op.value != 0);
+            break;
+        case ASTATSLOG_ANNOTATION_ID_EXCLUSIVE_STATE:
+            if (mValues.empty() || !checkPreviousValueType(INT) || numElements) {
+                mValid = false;
+                break;
+            }
+            mExclusiveStateFieldIndex = mValues.size() - 1;
+            mValues[mValues.size() - 1].mAnnotations.setExclusiveState(op.value != 0);
+            break;
+        case ASTATSLOG_ANNOTATION_ID_TRIGGER_STATE_RESET:
+            if (mValues.empty() || !checkPreviousValueType(INT) || numElements) {
+                mValid = false;
+                break;
+            }
+            mResetState = op.value;
+            break;
+        case ASTATSLOG_ANNOTATION_ID_STATE_NESTED:
+            if (mValues.empty() || !checkPreviousValueType(INT) || numElements) {
+                mValid = false;
+                break;
+            }
+            mValues[mValues.size() - 1].mAnnotations.setNested(op.value != 0);
+            break;
+        case ASTATSLOG_ANNOTATION_ID_RESTRICTION_CATEGORY:
+            if (!mValues.empty()) {
+                mValid = false;
+                break;
+            }
+            mRestrictionCategory = static_cast<StatsdRestrictionCategory>(op.value);
+            break;
+        default:
+            // field restriction annotations are parsed but not stored
+            break;
+    }
+}
+
+void LogEvent::recordAnnotationOp(const uint8_t* opStart, uint8_t annotationId,
+                                  uint8_t annotationType) {
+    // the value bytes are whatever the annotation parser consumed past id+type
+    const size_t valueSize = (size_t)(mBuf - opStart) - 2;
+    int32_t value = 0;
+    if (valueSize == sizeof(uint8_t)) {
+        value = opStart[2];
+    } else if (valueSize == sizeof(int32_t)) {
+        memcpy(&value, opStart + 2, sizeof(int32_t));
+    } else {
+        // unexpected encoding - do not cache this atom's schema
+        mAnnotationSchemaBuilder = nullptr;
+        return;
+    }
+    mAnnotationSchemaBuilder->ops.push_back({annotationId, annotationType, value});
+}
+
+void LogEvent::recordAnnotationBlock(const uint8_t* blockStart, uint8_t numAnnotations) {
+    AnnotationSchema& schema = *mAnnotationSchemaBuilder;
+    const size_t blockSize = (size_t)(mBuf - blockStart);
+    if (schema.bytes.size() + blockSize > kMaxAnnotationSchemaBytes ||
+        schema.blocks.size() >= kMaxAnnotationSchemaBlocks) {
+        mAnnotationSchemaBuilder = nullptr;
+        return;
+    }
+    schema.blocks.push_back({(uint16_t)schema.bytes.size(), (uint16_t)blockSize,
+                             (uint16_t)(schema.ops.size() - numAnnotations), numAnnotations});
+    schema.bytes.insert(schema.bytes.end(), blockStart, blockStart + blockSize);
+}
+
+bool LogEvent::finishAnnotationSchema() {
+    if (mValid && mAnnotationSchemaBuilder != nullptr) {
+        publishAnnotationSchema(mTagId, std::move(mAnnotationSchemaBuilder));
+    }
+    mAnnotationSchemaBuilder = nullptr;
+    mAnnotationSchema = nullptr;
+    return mValid;
+}
+
 // firstUidInChainIndex is a default parameter that is only needed when parsing
 // annotations for attribution chains.
 // numElements is a default param that is only needed when parsing annotations for repeated fields
 void LogEvent::parseAnnotations(uint8_t numAnnotations, std::optional<uint8_t> numElements,
                                 std::optional<size_t> firstUidInChainIndex) {
+    if (numAnnotations == 0) {
+        return;
+    }
+
+    if (mAnnotationSchema != nullptr && !mAnnotationSchemaMismatch) {
+        if (replayAnnotationBlock(numAnnotations, numElements, firstUidInChainIndex)) {
+            return;
+        }
+        // the wire bytes diverged from the cached schema - decode this event
+        // the slow way and drop the cached entry
+        mAnnotationSchemaMismatch = true;
+        invalidateAnnotationSchema(mTagId);
+    }
+
+    const uint8_t* blockStart = mBuf;
     for (uint8_t i = 0; i < numAnnotations; i++) {
+        const uint8_t* opStart = mBuf;
         uint8_t annotationId = readNextValue<uint8_t>();
         uint8_t annotationType = readNextValue<uint8_t>();
 
@@ -480,6 +746,14 @@ void LogEvent::parseAnnotations(uint8_t numAnnotations, std::optional<uint8_t> n
                 mValid = false;
                 return;
         }
+
+        if (mAnnotationSchemaBuilder != nullptr && mValid) {
+            recordAnnotationOp(opStart, annotationId, annotationType);
+        }
+    }
+
+    if (mAnnotationSchemaBuilder != nullptr && mValid) {
+        recordAnnotationBlock(blockStart, numAnnotations);
     }
 }
 
@@ -524,6 +798,17 @@ LogEvent::BodyBufferInfo LogEvent::parseHeader(const uint8_t* buf, size_t len) {
     mTagId = readNextValue<int32_t>();
     numElements--;
 
+    // one cache lookup per event; annotation blocks then replay or record
+    // without further locking
+    std::shared_ptr<const AnnotationSchema> schema;
+    if (lookupAnnotationSchema(mTagId, &schema)) {
+        // a nullptr schema marks an unstable atom: plain decode, no recording
+        mAnnotationSchema = std::move(schema);
+        mAnnotationSchemaMismatch = (mAnnotationSchema == nullptr);
+    } else {
+        mAnnotationSchemaBuilder = std::make_shared<AnnotationSchema>();
+    }
+
     parseAnnotations(getNumAnnotations(typeInfo));  // atom-level annotations
 
     bodyInfo.numElements = numElements;
@@ -534,7 +819,114 @@ LogEvent::BodyBufferInfo LogEvent::parseHeader(const uint8_t* buf, size_t len) {
     return bodyInfo;
 }
 
+template <uint8_t kTypeId>
+bool LogEvent::parseFixedElement(int32_t* pos, bool* last, uint8_t numElements) {
+    const uint8_t typeInfo = readNextValue<uint8_t>();
+    if (getTypeId(typeInfo) != kTypeId) {
+        // schema drift - bail out to the generic loop
+        return false;
+    }
+    last[0] = (pos[0] == numElements);
+    if constexpr (kTypeId == INT32_TYPE) {
+        parseInt32(pos, /*depth=*/0, last, getNumAnnotations(typeInfo));
+    } else if constexpr (kTypeId == INT64_TYPE) {
+        parseInt64(pos, /*depth=*/0, last, getNumAnnotations(typeInfo));
+    } else if constexpr (kTypeId == FLOAT_TYPE) {
+        parseFloat(pos, /*depth=*/0, last, getNumAnnotations(typeInfo));
+    } else if constexpr (kTypeId == BOOL_TYPE) {
+        parseBool(pos, /*depth=*/0, last, getNumAnnotations(typeInfo));
+    } else if constexpr (kTypeId == STRING_TYPE) {
+        parseString(pos, /*depth=*/0, last, getNumAnnotations(typeInfo));
+    }
+    pos[0]++;
+    return mValid;
+}
+
+template <uint8_t... kTypeIds>
+bool LogEvent::parseFixedBody(const BodyBufferInfo& bodyInfo) {
+    constexpr uint8_t kNumFields = sizeof...(kTypeIds);
+    if (bodyInfo.numElements != kNumFields) {
+        return false;
+    }
+
+    // snapshot annotation-derived state so a mid-kernel schema mismatch can
+    // roll back cleanly before the generic loop re-parses
+    const bool truncateTimestamp = mTruncateTimestamp;
+    const int resetState = mResetState;
+    const StatsdRestrictionCategory restrictionCategory = mRestrictionCategory;
+    const size_t numUidFields = mNumUidFields;
+    const size_t annotationSchemaBlock = mAnnotationSchemaBlock;
+    const size_t annotationBytes =
+            mAnnotationSchemaBuilder != nullptr ? mAnnotationSchemaBuilder->bytes.size() : 0;
+    const size_t annotationOps =
+            mAnnotationSchemaBuilder != nullptr ? mAnnotationSchemaBuilder->ops.size() : 0;
+    const size_t annotationBlocks =
+            mAnnotationSchemaBuilder != nullptr ? mAnnotationSchemaBuilder->blocks.size() : 0;
+
+    mParsedHeaderOnly = false;
+    mBuf = bodyInfo.buffer;
+    mRemainingLen = (uint32_t)bodyInfo.bufferSize;
+    mValues.reserve(kNumFields);
+
+    int32_t pos[] = {1, 1, 1};
+    bool last[] = {false, false, false};
+
+    bool ok = true;
+    ((ok = ok && parseFixedElement<kTypeIds>(pos, last, kNumFields)), ...);
+
+    if (!ok || mRemainingLen != 0) {
+        mValues.clear();
+        mValid = true;
+        mTruncateTimestamp = truncateTimestamp;
+        mResetState = resetState;
+        mRestrictionCategory = restrictionCategory;
+        mNumUidFields = numUidFields;
+        mAttributionChainStartIndex.reset();
+        mAttributionChainEndIndex.reset();
+        mExclusiveStateFieldIndex.reset();
+        mAnnotationSchemaBlock = annotationSchemaBlock;
+        if (mAnnotationSchemaBuilder != nullptr) {
+            // drop annotation state recorded during the abandoned attempt so
+            // the generic loop does not record it twice
+            mAnnotationSchemaBuilder->bytes.resize(annotationBytes);
+            mAnnotationSchemaBuilder->ops.resize(annotationOps);
+            mAnnotationSchemaBuilder->blocks.resize(annotationBlocks);
+        }
+        mBuf = nullptr;
+        return false;
+    }
+
+    mBuf = nullptr;
+    return true;
+}
+
+bool LogEvent::tryFastParseBody(const BodyBufferInfo& bodyInfo) {
+    // Specialized straight-line kernels for fixed-schema atoms, selected by
+    // tag id after parseHeader(). Avoids the per-element type switch of the
+    // generic loop; field-level annotations are still handled by the shared
+    // parse helpers. Extend the table as fleet profiles evolve - any atom not
+    // listed (or whose wire layout stops matching) uses the generic loop.
+    // Each kernel's type pack is checked against AtomSchemaRegistry.h at
+    // compile time, so a new entry needs a matching schema row.
+    static_assert(schemaMatches<INT32_TYPE, INT32_TYPE, INT32_TYPE>(util::APP_BREADCRUMB_REPORTED));
+    static_assert(schemaMatches<INT32_TYPE, INT32_TYPE, INT32_TYPE>(util::ISOLATED_UID_CHANGED));
+    static_assert(schemaMatches<INT32_TYPE, INT64_TYPE, INT64_TYPE>(util::ANOMALY_DETECTED));
+    switch (mTagId) {
+        case util::APP_BREADCRUMB_REPORTED:  // uid, label, state
+        case util::ISOLATED_UID_CHANGED:     // parent_uid, isolated_uid, event
+            return parseFixedBody<INT32_TYPE, INT32_TYPE, INT32_TYPE>(bodyInfo);
+        case util::ANOMALY_DETECTED:  // uid, config_id, alert_id
+            return parseFixedBody<INT32_TYPE, INT64_TYPE, INT64_TYPE>(bodyInfo);
+        default:
+            return false;
+    }
+}
+
 bool LogEvent::parseBody(const BodyBufferInfo& bodyInfo) {
+    if (tryFastParseBody(bodyInfo)) {
+        return finishAnnotationSchema();
+    }
+
     mParsedHeaderOnly = false;
 
     mBuf = bodyInfo.buffer;
@@ -594,7 +986,7 @@ bool LogEvent::parseBody(const BodyBufferInfo& bodyInfo) {
 
     if (mRemainingLen != 0) mValid = false;
     mBuf = nullptr;
-    return mValid;
+    return finishAnnotationSchema();
 }
 
 // This parsing logic is tied to the encoding scheme used in StatsEvent.java and
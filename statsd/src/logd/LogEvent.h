@@ -115,6 +115,31 @@ public:
      */
     bool parseBody(const BodyBufferInfo& bodyInfo);
 
+    /**
+     * @brief Retains a refcounted copy of the atom body after parseHeader() so
+     * that field materialization can be deferred off the ingestion thread.
+     * The receive buffer itself is recycled in place by the socket listener,
+     * hence the single bounded copy; no FieldValue/std::string materialization
+     * happens until parseDeferredBody(). Events dropped before being consumed
+     * (e.g. on queue overflow) never pay the materialization cost.
+     */
+    void retainBodyBuffer(const BodyBufferInfo& bodyInfo);
+
+    /**
+     * @brief Returns true if a deferred body is retained and the FieldValues
+     * are not materialized yet
+     */
+    bool hasDeferredBody() const {
+        return mRetainedBody != nullptr;
+    }
+
+    /**
+     * @brief Materializes the FieldValues from the retained body buffer and
+     * releases it. No-op when no deferred body is present.
+     * \return validity of the event
+     */
+    bool parseDeferredBody();
+
     // Constructs a BinaryPushStateChanged LogEvent from API call.
     explicit LogEvent(const std::string& trainName, int64_t trainVersionCode, bool requiresStaging,
                       bool rollbackEnabled, bool requiresLowLatencyMonitor, int32_t state,
@@ -125,6 +150,14 @@ public:
 
     ~LogEvent() {}
 
+    /**
+     * Restores the event to its freshly constructed LogEvent(uid, pid) state
+     * so the object can be reused for parsing another atom. The FieldValue
+     * vector keeps its heap capacity, making reuse allocation-free for events
+     * of similar arity. See LogEventPool.
+     */
+    void reset(int32_t uid, int32_t pid);
+
     /**
      * Get the timestamp associated with this event.
      */
@@ -193,10 +226,33 @@ public:
         return mValues;
     }
 
+    /**
+     * Pre-sizes the FieldValue storage before parsing. parseBody() reserves
+     * the element count from the header, but attribution chains and repeated
+     * fields expand to more FieldValues than that, forcing regrowth. Rows of
+     * one pull share a schema, so callers parsing many rows can seed each row
+     * with the previous row's parsed size and get a single right-sized
+     * allocation per row.
+     */
+    void reserveValueCapacity(size_t numValues) {
+        mValues.reserve(numValues);
+    }
+
     std::vector<FieldValue>* getMutableValues() {
         return &mValues;
     }
 
+    // Serialized Atom submessage for this event, cached by the first metric producer that
+    // encodes it so producers in other configs can append the same buffer by reference
+    // instead of re-encoding the proto. Null until some producer caches it.
+    const std::shared_ptr<const std::vector<uint8_t>>& getCachedSerializedAtom() const {
+        return mSerializedAtom;
+    }
+
+    void cacheSerializedAtom(const std::shared_ptr<const std::vector<uint8_t>>& serialized) const {
+        mSerializedAtom = serialized;
+    }
+
     // Default value = false
     inline bool shouldTruncateTimestamp() const {
         return mTruncateTimestamp;
@@ -272,6 +328,22 @@ public:
     }
 
 private:
+    /**
+     * @brief Attempts a specialized straight-line parse for atoms with known
+     * fixed layouts, selected by tag id after parseHeader(). Returns true when
+     * a kernel fully parsed the body; on any schema mismatch all side effects
+     * are rolled back and the caller runs the generic per-element loop.
+     */
+    bool tryFastParseBody(const BodyBufferInfo& bodyInfo);
+
+    // Straight-line decode of a fixed sequence of top-level field types into
+    // the FieldValue vector, generated per layout from the type-id pack.
+    template <uint8_t... kTypeIds>
+    bool parseFixedBody(const BodyBufferInfo& bodyInfo);
+
+    template <uint8_t kTypeId>
+    bool parseFixedElement(int32_t* pos, bool* last, uint8_t numElements);
+
     void parseInt32(int32_t* pos, int32_t depth, bool* last, uint8_t numAnnotations);
     void parseInt64(int32_t* pos, int32_t depth, bool* last, uint8_t numAnnotations);
     void parseString(int32_t* pos, int32_t depth, bool* last, uint8_t numAnnotations);
@@ -282,6 +354,49 @@ private:
     void parseAttributionChain(int32_t* pos, int32_t depth, bool* last, uint8_t numAnnotations);
     void parseArray(int32_t* pos, int32_t depth, bool* last, uint8_t numAnnotations);
 
+    /**
+     * @brief Per-atom-id cache of annotation wire blocks and their decoded
+     * operations.
+     *
+     * Annotations are schema-level constants emitted by the logging codegen,
+     * so after the first fully-valid event of an atom the raw annotation byte
+     * blocks can be validated with a memcmp against the first-seen bytes and
+     * the pre-decoded operations applied without re-running the
+     * per-annotation dispatch and value reads. Any divergence permanently
+     * reverts the atom to the generic decode path.
+     */
+    struct AnnotationSchema {
+        struct Op {
+            uint8_t annotationId;
+            uint8_t annotationType;
+            int32_t value;
+        };
+        // One block per parseAnnotations() call that carried annotations, in
+        // stream order.
+        struct Block {
+            uint16_t byteOffset;
+            uint16_t byteSize;
+            uint16_t opStart;
+            uint8_t numAnnotations;
+        };
+        std::vector<uint8_t> bytes;
+        std::vector<Op> ops;
+        std::vector<Block> blocks;
+    };
+
+    static bool lookupAnnotationSchema(int tagId,
+                                       std::shared_ptr<const AnnotationSchema>* schema);
+    static void publishAnnotationSchema(int tagId, std::shared_ptr<const AnnotationSchema> schema);
+    static void invalidateAnnotationSchema(int tagId);
+
+    bool replayAnnotationBlock(uint8_t numAnnotations, std::optional<uint8_t> numElements,
+                               std::optional<size_t> firstUidInChainIndex);
+    void applyCachedAnnotation(const AnnotationSchema::Op& op, std::optional<uint8_t> numElements,
+                               std::optional<size_t> firstUidInChainIndex);
+    void recordAnnotationOp(const uint8_t* opStart, uint8_t annotationId, uint8_t annotationType);
+    void recordAnnotationBlock(const uint8_t* blockStart, uint8_t numAnnotations);
+    bool finishAnnotationSchema();
+
     void parseAnnotations(uint8_t numAnnotations, std::optional<uint8_t> numElements = std::nullopt,
                           std::optional<size_t> firstUidInChainIndex = std::nullopt);
     void parseIsUidAnnotation(uint8_t annotationType, std::optional<uint8_t> numElements);
@@ -381,6 +496,21 @@ private:
     std::optional<size_t> mAttributionChainStartIndex;
     std::optional<size_t> mAttributionChainEndIndex;
     std::optional<size_t> mExclusiveStateFieldIndex;
+
+    // Annotation schema replay/building state, only meaningful while parsing.
+    std::shared_ptr<const AnnotationSchema> mAnnotationSchema;
+    std::shared_ptr<AnnotationSchema> mAnnotationSchemaBuilder;
+    size_t mAnnotationSchemaBlock = 0;       // next schema block to replay
+    bool mAnnotationSchemaMismatch = false;  // event diverged, decode the slow way
+
+    // Refcounted copy of the atom body when materialization is deferred, see
+    // retainBodyBuffer()/parseDeferredBody().
+    std::shared_ptr<const std::vector<uint8_t>> mRetainedBody;
+    uint8_t mRetainedBodyNumElements = 0;
+
+    // See getCachedSerializedAtom(). Mutable because caching the encoding does not change
+    // the observable event.
+    mutable std::shared_ptr<const std::vector<uint8_t>> mSerializedAtom;
 };
 
 void writeExperimentIdsToProto(const std::vector<int64_t>& experimentIds, std::vector<uint8_t>* protoOut);
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "LogEventParsePool.h"
+
+#include <sys/prctl.h>
+
+#include <algorithm>
+
+#include "utils/ThreadPolicy.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+LogEventParsePool::LogEventParsePool()
+    : mNumWorkers(std::clamp((int)std::thread::hardware_concurrency() / 2, 1, kMaxWorkers)) {
+    mWorkers.reserve(mNumWorkers);
+    for (int i = 0; i < mNumWorkers; i++) {
+        mWorkers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+LogEventParsePool::~LogEventParsePool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShutdown = true;
+    }
+    mWorkAvailable.notify_all();
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void LogEventParsePool::parseBatch(std::vector<std::unique_ptr<LogEvent>>& events) {
+    if (events.size() < kMinBatchSizeForParallelParse) {
+        for (const auto& event : events) {
+            parseOne(event);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBatch = &events;
+        mBatchGeneration++;
+        mNextIndex.store(0, std::memory_order_relaxed);
+        mRemaining.store(events.size(), std::memory_order_relaxed);
+    }
+    mWorkAvailable.notify_all();
+
+    // the submitter steals work alongside the pool threads
+    size_t i;
+    while ((i = mNextIndex.fetch_add(1, std::memory_order_relaxed)) < events.size()) {
+        parseOne(events[i]);
+        mRemaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    // wait until every event is parsed and no worker still references the
+    // batch before handing the events downstream
+    std::unique_lock<std::mutex> lock(mMutex);
+    mBatchDone.wait(lock, [this] {
+        return mRemaining.load(std::memory_order_acquire) == 0 && mActiveWorkers == 0;
+    });
+    mBatch = nullptr;
+}
+
+void LogEventParsePool::workerLoop(int workerId) {
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "statsd.parse%d", workerId);
+        prctl(PR_SET_NAME, name);
+    }
+    ThreadPolicy::getInstance().applyRole(ThreadRole::PARSE_WORKER);
+
+    uint64_t lastGeneration = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mWorkAvailable.wait(lock, [this, lastGeneration] {
+            return mShutdown || (mBatch != nullptr && mBatchGeneration != lastGeneration);
+        });
+        if (mShutdown) {
+            return;
+        }
+        lastGeneration = mBatchGeneration;
+        std::vector<std::unique_ptr<LogEvent>>* batch = mBatch;
+        mActiveWorkers++;
+        lock.unlock();
+
+        size_t i;
+        while ((i = mNextIndex.fetch_add(1, std::memory_order_relaxed)) < batch->size()) {
+            parseOne((*batch)[i]);
+            mRemaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+
+        lock.lock();
+        mActiveWorkers--;
+        if (mActiveWorkers == 0 && mRemaining.load(std::memory_order_acquire) == 0) {
+            mBatchDone.notify_one();
+        }
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
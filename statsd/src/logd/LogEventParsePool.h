@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LogEvent.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Parallel parse stage between the socket listener and the processor thread.
+ *
+ * The ingestion path queues events with their body materialization deferred
+ * (see LogEvent::retainBodyBuffer). Before a drained batch is handed to
+ * StatsLogProcessor, this pool materializes the FieldValues across several
+ * worker threads plus the submitting thread, work-stealing style: all threads
+ * pull indices from a shared atomic cursor, so an expensive event does not
+ * stall the rest of the batch. Events stay at their batch positions, so the
+ * downstream per-config delivery order is unchanged.
+ *
+ * Small batches are parsed inline - thread handoff would cost more than it
+ * saves.
+ */
+class LogEventParsePool {
+public:
+    LogEventParsePool();
+    ~LogEventParsePool();
+
+    LogEventParsePool(const LogEventParsePool&) = delete;
+    LogEventParsePool& operator=(const LogEventParsePool&) = delete;
+
+    /**
+     * Materializes every deferred event in the batch. Blocks until the whole
+     * batch is parsed; the submitting thread participates in the work.
+     */
+    void parseBatch(std::vector<std::unique_ptr<LogEvent>>& events);
+
+private:
+    void workerLoop(int workerId);
+
+    static void parseOne(const std::unique_ptr<LogEvent>& event) {
+        if (event != nullptr && event->hasDeferredBody()) {
+            event->parseDeferredBody();
+        }
+    }
+
+    // Below this batch size the submitter parses inline.
+    static constexpr size_t kMinBatchSizeForParallelParse = 16;
+    // Upper bound on worker threads; the submitter is an extra participant.
+    static constexpr int kMaxWorkers = 3;
+
+    const int mNumWorkers;
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mBatchDone;
+
+    // Current batch state, all guarded by mMutex except the atomics used by
+    // the stealing loop.
+    std::vector<std::unique_ptr<LogEvent>>* mBatch = nullptr;
+    uint64_t mBatchGeneration = 0;
+    int mActiveWorkers = 0;
+    bool mShutdown = false;
+
+    std::atomic<size_t> mNextIndex = 0;
+    std::atomic<size_t> mRemaining = 0;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "LogEventPool.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+LogEventPool& LogEventPool::getInstance() {
+    static LogEventPool sInstance;
+    return sInstance;
+}
+
+std::unique_ptr<LogEvent> LogEventPool::acquire(int32_t uid, int32_t pid) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mPool.empty()) {
+            std::unique_ptr<LogEvent> event = std::move(mPool.back());
+            mPool.pop_back();
+            event->reset(uid, pid);
+            return event;
+        }
+    }
+    return std::make_unique<LogEvent>(uid, pid);
+}
+
+void LogEventPool::release(std::unique_ptr<LogEvent> event) {
+    if (event == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mPool.size() < kMaxPooledEvents) {
+        mPool.push_back(std::move(event));
+    }
+    // otherwise the event is destroyed on scope exit
+}
+
+void LogEventPool::trim() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPool.clear();
+    mPool.shrink_to_fit();
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
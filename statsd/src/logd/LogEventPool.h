@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "LogEvent.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Process-wide recycling pool for LogEvent objects on the ingestion hot path.
+ *
+ * StatsSocketListener allocates a LogEvent per datagram; at peak event rates
+ * that is hundreds of thousands of heap allocations per second. The pool keeps
+ * fully constructed events around after the processor thread is done with
+ * them, so steady-state ingestion performs no allocations: a recycled event
+ * keeps its FieldValue vector capacity (see LogEvent::reset()).
+ *
+ * acquire() and release() are thread safe; the critical section is a single
+ * vector push/pop so contention between the socket and the processor threads
+ * stays negligible.
+ */
+class LogEventPool {
+public:
+    static LogEventPool& getInstance();
+
+    /**
+     * Returns a LogEvent in the same state as a fresh LogEvent(uid, pid),
+     * recycled from the pool when one is available.
+     */
+    std::unique_ptr<LogEvent> acquire(int32_t uid, int32_t pid);
+
+    /**
+     * Returns an event to the pool after the consumer is done with it.
+     * Events beyond the pool capacity are simply destroyed, so transient
+     * bursts do not pin memory forever.
+     */
+    void release(std::unique_ptr<LogEvent> event);
+
+    /**
+     * Drops every pooled event, releasing buffers grown during bursts. The
+     * pool refills naturally from subsequent traffic; called from the idle
+     * maintenance pass.
+     */
+    void trim();
+
+private:
+    LogEventPool() = default;
+
+    // Bounds the memory pinned by the pool. Sized for the steady-state
+    // in-flight event count (queue occupancy stays near zero while the
+    // consumer keeps up); overflow events fall back to the allocator.
+    static constexpr size_t kMaxPooledEvents = 512;
+
+    mutable std::mutex mMutex;
+    std::vector<std::unique_ptr<LogEvent>> mPool;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
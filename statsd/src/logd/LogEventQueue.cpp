@@ -19,6 +19,13 @@
 
 #include "LogEventQueue.h"
 
+#include <algorithm>
+#include <thread>
+
+#include "guardrail/StatsdStats.h"
+#include "stats_log_util.h"
+#include "utils/StatsTrace.h"
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -26,38 +33,353 @@ namespace statsd {
 using std::unique_lock;
 using std::unique_ptr;
 
-unique_ptr<LogEvent> LogEventQueue::waitPop() {
-    std::unique_lock<std::mutex> lock(mMutex);
+namespace {
+
+size_t roundUpToPowerOfTwo(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // namespace
+
+LogEventQueue::LogEventQueue(size_t initialSize, size_t maxSize)
+    : mQueueLimit(std::min(std::max<size_t>(initialSize, 1), maxSize)),
+      // reserve ~10% headroom (at least one slot) for high-priority atoms
+      mHighPriorityLimit(mQueueLimit + std::max<size_t>(mQueueLimit / 10, 1)),
+      mCapacity(roundUpToPowerOfTwo(mHighPriorityLimit)),
+      mInitialQueueLimit(mQueueLimit),
+      mMaxQueueLimit(std::max(maxSize, mQueueLimit)),
+      mSlots(mCapacity),
+      mEnqueuePos(0),
+      mDequeuePos(0) {
+    for (size_t i = 0; i < mCapacity; i++) {
+        mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+        mSlots[i].mTimestampNs.store(0, std::memory_order_relaxed);
+        mSlots[i].mPushElapsedNs.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool LogEventQueue::tryPop(unique_ptr<LogEvent>& event, int64_t* pushElapsedNs) {
+    const size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    Slot& slot = mSlots[pos & (mCapacity - 1)];
+    const size_t seq = slot.mSequence.load(std::memory_order_acquire);
+    if (seq != pos + 1) {
+        // slot is not yet published by a producer - queue is empty
+        return false;
+    }
+    event = std::move(slot.mEvent);
+    if (pushElapsedNs != nullptr) {
+        *pushElapsedNs = slot.mPushElapsedNs.load(std::memory_order_relaxed);
+    }
+    // hand the slot back to producers for the next lap around the ring
+    slot.mSequence.store(pos + mCapacity, std::memory_order_release);
+    mDequeuePos.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+void LogEventQueue::producerEnter() {
+    while (true) {
+        mPushesInFlight.fetch_add(1, std::memory_order_acquire);
+        if (!mResizeInProgress.load(std::memory_order_acquire)) {
+            return;
+        }
+        // A resize is running on the consumer thread: back out so it can
+        // proceed, park on the resize mutex until it finishes, then retry.
+        mPushesInFlight.fetch_sub(1, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mResizeMutex);
+    }
+}
+
+void LogEventQueue::producerExit() {
+    mPushesInFlight.fetch_sub(1, std::memory_order_release);
+}
 
-    if (mQueue.empty()) {
-        mCondition.wait(lock, [this] { return !this->mQueue.empty(); });
+void LogEventQueue::applyResizeLocked(size_t newQueueLimit) {
+    if (newQueueLimit == mQueueLimit) {
+        return;
     }
 
-    unique_ptr<LogEvent> item = std::move(mQueue.front());
-    mQueue.pop();
+    std::lock_guard<std::mutex> lock(mResizeMutex);
+    mResizeInProgress.store(true, std::memory_order_release);
+    // Wait out pushes already past the gate; new producers observe the flag,
+    // back out and block on mResizeMutex. Pushes are short, so this spin is
+    // bounded by a few slot writes.
+    while (mPushesInFlight.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+
+    // Re-check occupancy now that producers are excluded: a burst may have
+    // raced in after the shrink decision was made.
+    const size_t occupancy = mEnqueuePos.load(std::memory_order_relaxed) -
+                             mDequeuePos.load(std::memory_order_relaxed);
+    if (occupancy > newQueueLimit) {
+        mResizeInProgress.store(false, std::memory_order_release);
+        return;
+    }
+
+    const bool grew = newQueueLimit > mQueueLimit;
+    const size_t newHighPriorityLimit = newQueueLimit + std::max<size_t>(newQueueLimit / 10, 1);
+    const size_t newCapacity = roundUpToPowerOfTwo(newHighPriorityLimit);
+    if (newCapacity != mCapacity) {
+        std::vector<Slot> newSlots(newCapacity);
+        for (size_t i = 0; i < newCapacity; i++) {
+            newSlots[i].mSequence.store(i, std::memory_order_relaxed);
+            newSlots[i].mTimestampNs.store(0, std::memory_order_relaxed);
+            newSlots[i].mPushElapsedNs.store(0, std::memory_order_relaxed);
+        }
+        // Re-thread queued events into the new ring in order. This runs on
+        // the consumer thread, so tryPop() is the regular consumer-side pop.
+        size_t newPos = 0;
+        unique_ptr<LogEvent> event;
+        int64_t pushTimeNs = 0;
+        while (tryPop(event, &pushTimeNs)) {
+            Slot& slot = newSlots[newPos];
+            slot.mTimestampNs.store(event->GetElapsedTimestampNs(), std::memory_order_relaxed);
+            slot.mPushElapsedNs.store(pushTimeNs, std::memory_order_relaxed);
+            slot.mEvent = std::move(event);
+            slot.mSequence.store(newPos + 1, std::memory_order_relaxed);
+            newPos++;
+        }
+        mSlots.swap(newSlots);
+        mEnqueuePos.store(newPos, std::memory_order_relaxed);
+        mDequeuePos.store(0, std::memory_order_relaxed);
+        mCapacity = newCapacity;
+    }
+    mQueueLimit = newQueueLimit;
+    mHighPriorityLimit = newHighPriorityLimit;
+
+    // The release store pairs with the acquire load in producerEnter(), so a
+    // producer admitted past the gate sees the new ring and limits.
+    mResizeInProgress.store(false, std::memory_order_release);
+    StatsdStats::getInstance().noteEventQueueResized(grew, newQueueLimit);
+}
+
+void LogEventQueue::maybeResize(bool empty) {
+    if (mGrowthRequested.exchange(false, std::memory_order_relaxed)) {
+        applyResizeLocked(std::min(mQueueLimit * 2, mMaxQueueLimit));
+    }
+    if (empty && mQueueLimit > mInitialQueueLimit &&
+        getElapsedRealtimeNs() - mLastPressureElapsedNs.load(std::memory_order_relaxed) >=
+                kShrinkAfterQuietNs) {
+        // The burst that grew the queue has long subsided - give the extra
+        // slots back before blocking.
+        applyResizeLocked(mInitialQueueLimit);
+    }
+}
+
+unique_ptr<LogEvent> LogEventQueue::waitPopImpl(int64_t* pushElapsedNs) {
+    unique_ptr<LogEvent> item;
+
+    maybeResize(/*empty=*/false);
+
+    if (tryPop(item, pushElapsedNs)) {
+        return item;
+    }
+
+    maybeResize(/*empty=*/true);
+
+    std::unique_lock<std::mutex> lock(mWaitMutex);
+    mConsumerWaiting.store(true, std::memory_order_release);
+    // re-check under the lock before blocking: a producer which published
+    // after the first tryPop() but before the flag was raised is observed here
+    while (!tryPop(item, pushElapsedNs)) {
+        mCondition.wait(lock);
+    }
+    mConsumerWaiting.store(false, std::memory_order_release);
 
     return item;
 }
 
-LogEventQueue::Result LogEventQueue::push(unique_ptr<LogEvent> item) {
+unique_ptr<LogEvent> LogEventQueue::waitPop() {
+    int64_t pushElapsedNs = 0;
+    unique_ptr<LogEvent> item = waitPopImpl(&pushElapsedNs);
+    StatsdStats::getInstance().noteQueueWaitLatency(getElapsedRealtimeNs() - pushElapsedNs);
+    return item;
+}
+
+std::vector<unique_ptr<LogEvent>> LogEventQueue::waitPopAll() {
+    std::vector<unique_ptr<LogEvent>> items;
+    std::vector<int64_t> pushTimesNs;
+
+    int64_t pushElapsedNs = 0;
+    unique_ptr<LogEvent> item = waitPopImpl(&pushElapsedNs);
+    // the slice starts after the blocking wait, so idle time waiting for
+    // producers is not attributed to the pop itself
+    STATSD_TRACE_SCOPE("LogEventQueue::popAll");
+    items.push_back(std::move(item));
+    pushTimesNs.push_back(pushElapsedNs);
+    // drain whatever else was published while the first event was awaited
+    while (tryPop(item, &pushElapsedNs)) {
+        items.push_back(std::move(item));
+        pushTimesNs.push_back(pushElapsedNs);
+    }
+
+    // one clock read covers the queue-wait samples for the whole batch
+    const int64_t nowNs = getElapsedRealtimeNs();
+    for (const int64_t pushTimeNs : pushTimesNs) {
+        StatsdStats::getInstance().noteQueueWaitLatency(nowNs - pushTimeNs);
+    }
+
+    return items;
+}
+
+LogEventQueue::Result LogEventQueue::pushImpl(unique_ptr<LogEvent> item, int64_t pushElapsedNs) {
     Result result;
-    {
-        std::unique_lock<std::mutex> lock(mMutex);
-        if (mQueue.size() < mQueueLimit) {
-            mQueue.push(std::move(item));
-            result.success = true;
-        } else {
-            // safe operation as queue must not be empty.
-            result.oldestTimestampNs = mQueue.front()->GetElapsedTimestampNs();
+
+    const auto highPriorityIds =
+            std::atomic_load_explicit(&mHighPriorityAtomIds, std::memory_order_acquire);
+    result.highPriority =
+            highPriorityIds != nullptr && highPriorityIds->count(item->GetTagId()) > 0;
+    const size_t laneLimit = result.highPriority ? mHighPriorityLimit : mQueueLimit;
+
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        if (pos - mDequeuePos.load(std::memory_order_acquire) >= laneLimit) {
+            // the queue is full - report the oldest queued timestamp from the
+            // slot-side copy, which stays valid under a concurrent pop
+            const size_t oldestPos = mDequeuePos.load(std::memory_order_relaxed);
+            result.oldestTimestampNs =
+                    mSlots[oldestPos & (mCapacity - 1)].mTimestampNs.load(std::memory_order_relaxed);
             result.success = false;
+            result.size = laneLimit;
+            if (mQueueLimit < mMaxQueueLimit) {
+                mGrowthRequested.store(true, std::memory_order_relaxed);
+            }
+            mLastPressureElapsedNs.store(pushElapsedNs, std::memory_order_relaxed);
+            return result;
         }
-        result.size = mQueue.size();
+
+        Slot& slot = mSlots[pos & (mCapacity - 1)];
+        const size_t seq = slot.mSequence.load(std::memory_order_acquire);
+        if (seq == pos) {
+            // the slot is free - claim it. CAS (rather than a plain store)
+            // keeps the rare secondary producer (e.g. stopReadingLogs())
+            // safe next to the socket thread.
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.mTimestampNs.store(item->GetElapsedTimestampNs(), std::memory_order_relaxed);
+                slot.mPushElapsedNs.store(pushElapsedNs, std::memory_order_relaxed);
+                slot.mEvent = std::move(item);
+                slot.mSequence.store(pos + 1, std::memory_order_release);
+                result.success = true;
+                result.size = pos + 1 - mDequeuePos.load(std::memory_order_relaxed);
+                const size_t size = static_cast<size_t>(result.size);
+                if (size * 2 >= laneLimit) {
+                    // the push time is already at hand - no extra clock read
+                    mLastPressureElapsedNs.store(pushElapsedNs, std::memory_order_relaxed);
+                    if (size * kGrowthDenominator >= mQueueLimit * kGrowthNumerator &&
+                        mQueueLimit < mMaxQueueLimit) {
+                        mGrowthRequested.store(true, std::memory_order_relaxed);
+                    }
+                }
+                return result;
+            }
+            // CAS failed - another producer claimed the slot, pos is refreshed
+        } else {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void LogEventQueue::setHighPriorityAtomIds(std::unordered_set<int> atomIds) {
+    std::atomic_store_explicit(
+            &mHighPriorityAtomIds,
+            std::shared_ptr<const std::unordered_set<int>>(
+                    std::make_shared<const std::unordered_set<int>>(std::move(atomIds))),
+            std::memory_order_release);
+}
+
+void LogEventQueue::wakeConsumer() {
+    if (mConsumerWaiting.load(std::memory_order_acquire)) {
+        // the lock pairs with the consumer's check-then-wait in waitPop() to
+        // close the lost-wakeup window; it is uncontended while the consumer
+        // is keeping up with the producers
+        std::lock_guard<std::mutex> lock(mWaitMutex);
+        mCondition.notify_one();
     }
+}
 
-    mCondition.notify_one();
+LogEventQueue::Result LogEventQueue::push(unique_ptr<LogEvent> item) {
+    STATSD_TRACE_SCOPE("LogEventQueue::push");
+    producerEnter();
+    Result result = pushImpl(std::move(item), getElapsedRealtimeNs());
+    producerExit();
+    if (result.success) {
+        wakeConsumer();
+    }
     return result;
 }
 
+std::vector<LogEventQueue::Result> LogEventQueue::pushBatch(
+        std::vector<unique_ptr<LogEvent>>& events) {
+    STATSD_TRACE_SCOPE_ID("LogEventQueue::pushBatch", static_cast<int64_t>(events.size()));
+    std::vector<Result> results;
+    results.reserve(events.size());
+    // one clock read stamps the push time for the whole batch
+    const int64_t pushElapsedNs = getElapsedRealtimeNs();
+    bool anyPushed = false;
+    producerEnter();
+    for (auto& event : events) {
+        results.push_back(pushImpl(std::move(event), pushElapsedNs));
+        anyPushed |= results.back().success;
+    }
+    producerExit();
+
+    // One wakeup is sufficient: waitPop() re-checks the emptiness predicate
+    // before blocking, so the consumer keeps draining without further signals.
+    if (anyPushed) {
+        wakeConsumer();
+    }
+    return results;
+}
+
+std::vector<LogEventQueue::Result> LogEventQueue::pushGroup(
+        std::vector<unique_ptr<LogEvent>>& events) {
+    STATSD_TRACE_SCOPE_ID("LogEventQueue::pushGroup", static_cast<int64_t>(events.size()));
+    std::vector<Result> results;
+    results.reserve(events.size());
+
+    producerEnter();
+    const size_t pending = mEnqueuePos.load(std::memory_order_relaxed) -
+                           mDequeuePos.load(std::memory_order_acquire);
+    if (pending + events.size() > mQueueLimit) {
+        // Not enough room for the whole group: reject every event so overflow
+        // can never split the group.
+        Result failure;
+        const size_t oldestPos = mDequeuePos.load(std::memory_order_relaxed);
+        failure.oldestTimestampNs =
+                mSlots[oldestPos & (mCapacity - 1)].mTimestampNs.load(std::memory_order_relaxed);
+        failure.size = mQueueLimit;
+        if (mQueueLimit < mMaxQueueLimit) {
+            mGrowthRequested.store(true, std::memory_order_relaxed);
+        }
+        mLastPressureElapsedNs.store(getElapsedRealtimeNs(), std::memory_order_relaxed);
+        producerExit();
+        results.assign(events.size(), failure);
+        for (auto& event : events) {
+            event.reset();
+        }
+        return results;
+    }
+
+    // The capacity check above only goes stale if another producer races in,
+    // which is limited to the rare shutdown path - the consumer side can only
+    // free space. The per-event pushes below therefore succeed together.
+    const int64_t pushElapsedNs = getElapsedRealtimeNs();
+    bool anyPushed = false;
+    for (auto& event : events) {
+        results.push_back(pushImpl(std::move(event), pushElapsedNs));
+        anyPushed |= results.back().success;
+    }
+    producerExit();
+    if (anyPushed) {
+        wakeConsumer();
+    }
+    return results;
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -18,9 +18,12 @@
 
 #include <gtest/gtest_prod.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <unordered_set>
+#include <vector>
 
 #include "LogEvent.h"
 
@@ -29,21 +32,51 @@ namespace os {
 namespace statsd {
 
 /**
- * A zero copy thread safe queue buffer for producing and consuming LogEvent.
+ * A thread safe queue buffer for producing and consuming LogEvent.
+ *
+ * Internally this is a lock-free ring buffer (bounded queue with per-slot
+ * sequence numbers) so that the socket ingestion thread never blocks on the
+ * consumer thread. The producer side is wait-free in steady state; the only
+ * lock is taken by the consumer when the queue is empty and it has to block,
+ * and by a producer for the matching wakeup notification.
+ *
+ * The admission limit adapts to load: the queue starts at an initial limit,
+ * doubles its backing storage up to a hard cap under sustained pressure, and
+ * falls back to the initial limit once the queue has been quiet for a while.
+ * Resizes are rare and always execute on the consumer thread, bracketed by a
+ * gate that briefly excludes producers (see applyResizeLocked()).
  */
 class LogEventQueue {
 public:
-    explicit LogEventQueue(size_t maxSize) : mQueueLimit(maxSize){};
+    /**
+     * Queue whose admission limit grows from initialSize up to maxSize under
+     * pressure and shrinks back to initialSize when idle.
+     */
+    LogEventQueue(size_t initialSize, size_t maxSize);
+
+    // Fixed-size queue: the limit stays at maxSize and never resizes.
+    explicit LogEventQueue(size_t maxSize) : LogEventQueue(maxSize, maxSize) {
+    }
 
     /**
      * Blocking read one event from the queue.
      */
     std::unique_ptr<LogEvent> waitPop();
 
+    /**
+     * Blocks until at least one event is available, then drains every event
+     * currently in the queue. Lets the consumer amortize its wakeup and
+     * downstream lock acquisitions over the whole backlog instead of paying
+     * them per event.
+     */
+    std::vector<std::unique_ptr<LogEvent>> waitPopAll();
+
     struct Result {
         bool success = false;
         int64_t oldestTimestampNs = 0;
         int32_t size = 0;
+        // whether the pushed event was classified into the high-priority lane
+        bool highPriority = false;
     };
 
     /**
@@ -53,14 +86,145 @@ public:
      */
     Result push(std::unique_ptr<LogEvent> event);
 
+    /**
+     * Puts a batch of LogEvents to the end of the queue, to amortize
+     * producer/consumer handoff over bursts. Events are appended in order and
+     * each event follows the same success/overflow contract as push().
+     * Per-event results are returned in the same order as the input events.
+     * At most one consumer wakeup is issued for the whole batch.
+     */
+    std::vector<Result> pushBatch(std::vector<std::unique_ptr<LogEvent>>& events);
+
+    /**
+     * Puts a group of LogEvents to the queue as one transaction. Admission is
+     * all-or-nothing: when the queue lacks room for the entire group, every
+     * event is rejected and reported as overflow, so a correlated atom group
+     * is never partially enqueued. The group is admitted against the regular
+     * queue limit; the high-priority headroom stays reserved for individual
+     * pushes. Per-event results are returned in input order and the events
+     * are consumed either way.
+     */
+    std::vector<Result> pushGroup(std::vector<std::unique_ptr<LogEvent>>& events);
+
+    /**
+     * Publishes the set of atom ids treated as high priority on overflow.
+     * Events with these tags may occupy reserved headroom above the regular
+     * queue limit, so an important push (e.g. a crash atom) still succeeds
+     * while a benign atom storm is rejected at the base limit. Thread safe;
+     * the set is published atomically and picked up by subsequent pushes.
+     */
+    void setHighPriorityAtomIds(std::unordered_set<int> atomIds);
+
+    /**
+     * Current number of events in the queue. The value is exact when no
+     * concurrent push/pop is in flight, otherwise a snapshot approximation.
+     */
+    size_t size() const {
+        return mEnqueuePos.load(std::memory_order_relaxed) -
+               mDequeuePos.load(std::memory_order_relaxed);
+    }
+
 private:
-    const size_t mQueueLimit;
+    // A ring buffer slot. The sequence number encodes slot state relative to
+    // the enqueue/dequeue positions: slots are handed back and forth between
+    // producers and the consumer without locking (Vyukov bounded queue).
+    struct Slot {
+        std::atomic<size_t> mSequence;
+        std::unique_ptr<LogEvent> mEvent;
+        // Elapsed timestamp of mEvent, written by the producer at push time so
+        // that a full-queue producer can report the oldest queued timestamp
+        // without dereferencing an event the consumer may concurrently pop.
+        std::atomic<int64_t> mTimestampNs;
+        // Elapsed-realtime time at which mEvent was pushed, so the consumer
+        // can report the queue-wait latency to StatsdStats on pop.
+        std::atomic<int64_t> mPushElapsedNs;
+    };
+
+    // Appends one event without issuing a consumer wakeup.
+    Result pushImpl(std::unique_ptr<LogEvent> event, int64_t pushElapsedNs);
+
+    // Non-blocking pop attempt, consumer thread only. On success optionally
+    // outputs the elapsed-realtime time at which the event was pushed.
+    bool tryPop(std::unique_ptr<LogEvent>& event, int64_t* pushElapsedNs = nullptr);
+
+    // Blocking read of one event; outputs the push time without recording the
+    // queue-wait latency, so batch callers can note it with one clock read.
+    std::unique_ptr<LogEvent> waitPopImpl(int64_t* pushElapsedNs);
+
+    // Wakes up the consumer if it is blocked in waitPop().
+    void wakeConsumer();
+
+    // Producer-side resize gate. Every push is bracketed by enter/exit; a
+    // producer that observes a resize in progress backs out and waits for it
+    // on mResizeMutex. Wait-free unless a resize is actually running.
+    void producerEnter();
+    void producerExit();
+
+    // Rebuilds the ring for the new limit with producers excluded. Consumer
+    // thread only. No-op when the limit is unchanged or when a concurrent
+    // burst left more events queued than the new limit would admit.
+    void applyResizeLocked(size_t newQueueLimit);
+
+    // Applies a pending growth request and, when the queue has drained and
+    // been quiet long enough, gives grown storage back. Called by the
+    // consumer at pop time; `empty` is true at the about-to-block point.
+    void maybeResize(bool empty);
+
+    // Admission limit of the regular lane. Written only inside
+    // applyResizeLocked() with producers excluded; the gate's acquire/release
+    // edges order those writes against producer reads.
+    size_t mQueueLimit;
+    // Limit for the high-priority lane: base limit plus reserved headroom
+    // that only high-priority atoms may occupy.
+    size_t mHighPriorityLimit;
+    // Ring capacity, mHighPriorityLimit rounded up to a power of two for
+    // cheap index masking. Occupancy is still bounded by the lane limits.
+    size_t mCapacity;
+
+    // Bounds for the adaptive limit. Equal for fixed-size queues, in which
+    // case the resize machinery stays entirely dormant.
+    const size_t mInitialQueueLimit;
+    const size_t mMaxQueueLimit;
+
+    // Set by producers when occupancy crosses kGrowthNumerator/kGrowthDenominator
+    // of the limit (or on overflow); consumed by maybeResize().
+    std::atomic_bool mGrowthRequested = false;
+    // Elapsed-realtime time of the last high-occupancy push, used to hold off
+    // shrinking while bursts are still arriving.
+    std::atomic<int64_t> mLastPressureElapsedNs = 0;
+
+    // Resize gate state (see producerEnter()).
+    std::atomic<int32_t> mPushesInFlight = 0;
+    std::atomic_bool mResizeInProgress = false;
+    std::mutex mResizeMutex;
+
+    // Request growth when occupancy reaches 3/4 of the admission limit.
+    static constexpr size_t kGrowthNumerator = 3;
+    static constexpr size_t kGrowthDenominator = 4;
+    // Shrink back once the queue drains and no high-occupancy push has been
+    // seen for this long.
+    static constexpr int64_t kShrinkAfterQuietNs = 5 * 60 * 1000000000LL;
+
+    // atom ids classified into the high-priority lane, published atomically
+    std::shared_ptr<const std::unordered_set<int>> mHighPriorityAtomIds;
+
+    std::vector<Slot> mSlots;
+
+    // Producer and consumer cursors on separate cache lines to avoid false
+    // sharing between the ingestion and the processing threads.
+    alignas(64) std::atomic<size_t> mEnqueuePos;
+    alignas(64) std::atomic<size_t> mDequeuePos;
+
+    // Blocking support for the consumer when the queue is drained. Producers
+    // only touch the mutex when mConsumerWaiting indicates the consumer is
+    // blocked (or about to block), which never happens while it is keeping up.
+    alignas(64) std::atomic_bool mConsumerWaiting = false;
     std::condition_variable mCondition;
-    std::mutex mMutex;
-    std::queue<std::unique_ptr<LogEvent>> mQueue;
+    std::mutex mWaitMutex;
 
     friend class SocketParseMessageTest;
 
+    FRIEND_TEST(LogEventQueue_test, TestIdleShrink);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessage);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageEmptySetExplicitSet);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterCompleteSet);
@@ -90,8 +90,10 @@ int main(int /*argc*/, char** /*argv*/) {
     // Initialize boot flags
     FlagProvider::getInstance().initBootFlags({STATSD_INIT_COMPLETED_NO_DELAY_FLAG});
 
-    std::shared_ptr<LogEventQueue> eventQueue =
-            std::make_shared<LogEventQueue>(50000); /*buffer limit. Buffer is NOT pre-allocated*/
+    // Start with a small buffer; the queue grows itself up to the hard cap
+    // under sustained pressure and shrinks back once the burst is over.
+    std::shared_ptr<LogEventQueue> eventQueue = std::make_shared<LogEventQueue>(
+            /*initialSize=*/6250, /*maxSize=*/50000);
 
     sp<UidMap> uidMap = UidMap::getInstance();
 
@@ -46,8 +46,8 @@ public:
 
     // Initialize this AtomMatchingTracker.
     // matcherIndex: index of this AtomMatchingTracker in allAtomMatchingTrackers.
-    // allAtomMatchers: the list of the AtomMatcher proto config. This is needed because we don't
-    //                  store the proto object in memory. We only need it during initilization.
+    // allAtomMatchers: the AtomMatcher protos from the StatsdConfig, referenced in place so that
+    //                  initialization does not copy them. We only need them during initilization.
     // allAtomMatchingTrackers: the list of the AtomMatchingTracker objects. It's a one-to-one
     //                          mapping with allAtomMatchers. This is needed because the
     //                          initialization is done recursively for
@@ -55,7 +55,7 @@ public:
     // stack: a bit map to record which matcher has been visited on the stack. This is for detecting
     //        circle dependency.
     virtual MatcherInitResult init(
-            int matcherIndex, const std::vector<AtomMatcher>& allAtomMatchers,
+            int matcherIndex, const ::google::protobuf::RepeatedPtrField<AtomMatcher>& allAtomMatchers,
             const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
             const std::unordered_map<int64_t, int>& matcherMap, std::vector<uint8_t>& stack) = 0;
 
@@ -78,7 +78,7 @@ public:
     // matcherTransformations: the cached transformations for all matchers for this event.
     virtual void onLogEvent(const LogEvent& event, int matcherIndex,
                             const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
-                            std::vector<MatchingState>& matcherResults,
+                            MatchingStateBitset& matcherResults,
                             std::vector<std::shared_ptr<LogEvent>>& matcherTransformations) = 0;
 
     // Get the tagIds that this matcher cares about. The combined collection is stored
@@ -88,6 +88,27 @@ public:
         return mAtomIds;
     }
 
+    // Returns the indices of the child matchers when this matcher combines other matchers, or
+    // nullptr for leaf matchers. Used by MetricsManager to flatten the matcher graph into
+    // per-tag-id evaluation programs at config load time.
+    virtual const std::vector<int>* getChildMatcherIndices() const {
+        return nullptr;
+    }
+
+    // Returns the logical operation applied over the child matchers. Only meaningful when
+    // getChildMatcherIndices() is non-null.
+    virtual LogicalOperation getLogicalOperation() const {
+        return LogicalOperation::LOGICAL_OPERATION_UNSPECIFIED;
+    }
+
+    // Returns whether every event with the given atom id matches this matcher, with no
+    // per-event evaluation and no transformation. Lets bulk ingestion paths for pulled
+    // data skip matcher dispatch for a whole batch when the atom id is already known.
+    // Conservative: false means "evaluate per event", not "never matches".
+    virtual bool matchesTrivially(int atomId) const {
+        return false;
+    }
+
     int64_t getId() const {
         return mId;
     }
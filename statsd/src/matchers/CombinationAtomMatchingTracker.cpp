@@ -38,7 +38,7 @@ CombinationAtomMatchingTracker::~CombinationAtomMatchingTracker() {
 }
 
 MatcherInitResult CombinationAtomMatchingTracker::init(
-        int matcherIndex, const vector<AtomMatcher>& allAtomMatchers,
+        int matcherIndex, const ::google::protobuf::RepeatedPtrField<AtomMatcher>& allAtomMatchers,
         const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
         const unordered_map<int64_t, int>& matcherMap, vector<uint8_t>& stack) {
     MatcherInitResult result{nullopt /* invalidConfigReason */,
@@ -52,7 +52,7 @@ MatcherInitResult CombinationAtomMatchingTracker::init(
     // mark this node as visited in the recursion stack.
     stack[matcherIndex] = true;
 
-    AtomMatcher_Combination matcher = allAtomMatchers[matcherIndex].combination();
+    const AtomMatcher_Combination& matcher = allAtomMatchers[matcherIndex].combination();
 
     // LogicalOperation is missing in the config
     if (!matcher.has_operation()) {
@@ -141,7 +141,7 @@ optional<InvalidConfigReason> CombinationAtomMatchingTracker::onConfigUpdated(
 void CombinationAtomMatchingTracker::onLogEvent(
         const LogEvent& event, int matcherIndex,
         const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
-        vector<MatchingState>& matcherResults,
+        MatchingStateBitset& matcherResults,
         vector<shared_ptr<LogEvent>>& matcherTransformations) {
     // this event has been processed.
     if (matcherResults[matcherIndex] != MatchingState::kNotComputed) {
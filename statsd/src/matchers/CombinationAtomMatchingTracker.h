@@ -31,7 +31,8 @@ class CombinationAtomMatchingTracker : public AtomMatchingTracker {
 public:
     CombinationAtomMatchingTracker(const int64_t id, const uint64_t protoHash);
 
-    MatcherInitResult init(int matcherIndex, const std::vector<AtomMatcher>& allAtomMatchers,
+    MatcherInitResult init(int matcherIndex,
+                           const ::google::protobuf::RepeatedPtrField<AtomMatcher>& allAtomMatchers,
                            const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
                            const std::unordered_map<int64_t, int>& matcherMap,
                            std::vector<uint8_t>& stack);
@@ -44,9 +45,17 @@ public:
 
     void onLogEvent(const LogEvent& event, int matcherIndex,
                     const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
-                    std::vector<MatchingState>& matcherResults,
+                    MatchingStateBitset& matcherResults,
                     std::vector<std::shared_ptr<LogEvent>>& matcherTransformations) override;
 
+    const std::vector<int>* getChildMatcherIndices() const override {
+        return &mChildren;
+    }
+
+    LogicalOperation getLogicalOperation() const override {
+        return mLogicalOperation;
+    }
+
 private:
     LogicalOperation mLogicalOperation;
 
@@ -23,7 +23,7 @@ MatchLogEventResult EventMatcherWizard::matchLogEvent(const LogEvent& event, int
     if (matcherIndex < 0 || matcherIndex >= (int)mAllEventMatchers.size()) {
         return {MatchingState::kNotComputed, nullptr};
     }
-    std::fill(mMatcherCache.begin(), mMatcherCache.end(), MatchingState::kNotComputed);
+    mMatcherCache.assign(mMatcherCache.size(), MatchingState::kNotComputed);
     std::fill(mMatcherTransformations.begin(), mMatcherTransformations.end(), nullptr);
     mAllEventMatchers[matcherIndex]->onLogEvent(event, matcherIndex, mAllEventMatchers,
                                                 mMatcherCache, mMatcherTransformations);
@@ -31,6 +31,13 @@ MatchLogEventResult EventMatcherWizard::matchLogEvent(const LogEvent& event, int
     return {mMatcherCache[matcherIndex], mMatcherTransformations[matcherIndex]};
 }
 
+bool EventMatcherWizard::matchesTrivially(int matcherIndex, int atomId) const {
+    if (matcherIndex < 0 || matcherIndex >= (int)mAllEventMatchers.size()) {
+        return false;
+    }
+    return mAllEventMatchers[matcherIndex]->matchesTrivially(atomId);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -39,9 +39,15 @@ public:
 
     MatchLogEventResult matchLogEvent(const LogEvent& event, int matcherIndex);
 
+    // Whether the given matcher matches every event with the given atom id, with no
+    // per-event evaluation or transformation. Checked once per pulled batch so the
+    // per-row matchLogEvent() dispatch can be skipped; see
+    // AtomMatchingTracker::matchesTrivially().
+    bool matchesTrivially(int matcherIndex, int atomId) const;
+
 private:
     std::vector<sp<AtomMatchingTracker>> mAllEventMatchers;
-    std::vector<MatchingState> mMatcherCache;
+    MatchingStateBitset mMatcherCache;
     std::vector<std::shared_ptr<LogEvent>> mMatcherTransformations;
 };
 
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "MatcherResultCache.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+MatcherResultCache& MatcherResultCache::getInstance() {
+    static MatcherResultCache cache;
+    return cache;
+}
+
+void MatcherResultCache::refreshEventLocked(const LogEvent& event) {
+    if (mEventPtr == &event && mEventTimestampNs == event.GetElapsedTimestampNs() &&
+        mEventTagId == event.GetTagId()) {
+        return;
+    }
+    mResults.clear();
+    mEventPtr = &event;
+    mEventTimestampNs = event.GetElapsedTimestampNs();
+    mEventTagId = event.GetTagId();
+}
+
+bool MatcherResultCache::lookup(uint64_t matcherProtoHash, const LogEvent& event, bool* matched,
+                                std::shared_ptr<LogEvent>* transformedEvent) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    refreshEventLocked(event);
+    const auto it = mResults.find(matcherProtoHash);
+    if (it == mResults.end()) {
+        return false;
+    }
+    *matched = it->second.matched;
+    *transformedEvent = it->second.transformedEvent;
+    return true;
+}
+
+void MatcherResultCache::store(uint64_t matcherProtoHash, const LogEvent& event, bool matched,
+                               const std::shared_ptr<LogEvent>& transformedEvent) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    refreshEventLocked(event);
+    mResults[matcherProtoHash] = {matched, transformedEvent};
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtest/gtest_prod.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "logd/LogEvent.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Process-wide cache of SimpleAtomMatcher evaluation results for the event currently
+ * being processed.
+ *
+ * Many shipped configs contain literally identical SimpleAtomMatcher definitions, so
+ * without interning each event is matched once per tracker that declares the matcher.
+ * SimpleAtomMatchingTracker keys its evaluation by the Hash64 of the SimpleAtomMatcher
+ * contents (the enclosing AtomMatcher's id is excluded), so repeated definitions are
+ * merged whether they appear under one id in several configs or under different ids —
+ * including several times within a single config. The first tracker to evaluate a
+ * given definition populates the cache and every other one reuses the result.
+ *
+ * Only leaf (simple) matchers are interned: a CombinationAtomMatcher proto references
+ * its children by id, so an identical combination proto does not guarantee identical
+ * child definitions across configs.
+ *
+ * Entries are valid for a single event only. The cache self-invalidates when it sees
+ * an event with a different identity, so callers do not need an explicit reset between
+ * events.
+ */
+class MatcherResultCache {
+public:
+    static MatcherResultCache& getInstance();
+
+    // Fetches the cached result of evaluating the simple matcher identified by
+    // matcherProtoHash against this event. Returns false when the matcher has not been
+    // evaluated for this event yet.
+    bool lookup(uint64_t matcherProtoHash, const LogEvent& event, bool* matched,
+                std::shared_ptr<LogEvent>* transformedEvent);
+
+    // Records the evaluation result of the simple matcher identified by matcherProtoHash
+    // for this event.
+    void store(uint64_t matcherProtoHash, const LogEvent& event, bool matched,
+               const std::shared_ptr<LogEvent>& transformedEvent);
+
+private:
+    MatcherResultCache() = default;
+
+    struct Entry {
+        bool matched;
+        std::shared_ptr<LogEvent> transformedEvent;
+    };
+
+    // Drops stale entries when the given event differs from the one the cache was
+    // populated for. Must be called with mMutex held.
+    void refreshEventLocked(const LogEvent& event);
+
+    mutable std::mutex mMutex;
+
+    // Identity of the event the cached results belong to. The pointer alone is not
+    // enough since pooled LogEvents are reused in place; the elapsed timestamp and tag
+    // id disambiguate a recycled allocation.
+    const LogEvent* mEventPtr = nullptr;
+    int64_t mEventTimestampNs = 0;
+    int mEventTagId = 0;
+
+    std::unordered_map<uint64_t, Entry> mResults;
+
+    FRIEND_TEST(MatcherResultCache_test, TestStoreAndLookup);
+    FRIEND_TEST(MatcherResultCache_test, TestInvalidatedByNewEvent);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -19,18 +19,40 @@
 
 #include "SimpleAtomMatchingTracker.h"
 
+#include "hash.h"
+#include "matchers/MatcherResultCache.h"
+
 namespace android {
 namespace os {
 namespace statsd {
 
 using std::shared_ptr;
+using std::string;
 using std::unordered_map;
 using std::vector;
 
+namespace {
+
+// Hashes the matcher definition without the enclosing AtomMatcher id. Falls back to
+// the full proto hash if serialization fails, which only costs cache sharing.
+uint64_t computeContentsHash(const SimpleAtomMatcher& matcher, const uint64_t protoHash) {
+    string serializedMatcher;
+    if (!matcher.SerializeToString(&serializedMatcher)) {
+        return protoHash;
+    }
+    return Hash64(serializedMatcher);
+}
+
+}  // namespace
+
 SimpleAtomMatchingTracker::SimpleAtomMatchingTracker(const int64_t id, const uint64_t protoHash,
                                                      const SimpleAtomMatcher& matcher,
                                                      const sp<UidMap>& uidMap)
-    : AtomMatchingTracker(id, protoHash), mMatcher(matcher), mUidMap(uidMap) {
+    : AtomMatchingTracker(id, protoHash),
+      mMatcher(matcher),
+      mContentsHash(computeContentsHash(mMatcher, protoHash)),
+      mStringMatcherIndex(buildStringMatcherIndex(mMatcher)),
+      mUidMap(uidMap) {
     if (!matcher.has_atom_id()) {
         mInitialized = false;
     } else {
@@ -43,7 +65,7 @@ SimpleAtomMatchingTracker::~SimpleAtomMatchingTracker() {
 }
 
 MatcherInitResult SimpleAtomMatchingTracker::init(
-        int matcherIndex, const vector<AtomMatcher>& allAtomMatchers,
+        int matcherIndex, const ::google::protobuf::RepeatedPtrField<AtomMatcher>& allAtomMatchers,
         const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
         const unordered_map<int64_t, int>& matcherMap, vector<uint8_t>& stack) {
     MatcherInitResult result{nullopt /* invalidConfigReason */,
@@ -78,7 +100,7 @@ optional<InvalidConfigReason> SimpleAtomMatchingTracker::onConfigUpdated(
 void SimpleAtomMatchingTracker::onLogEvent(
         const LogEvent& event, int matcherIndex,
         const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
-        vector<MatchingState>& matcherResults,
+        MatchingStateBitset& matcherResults,
         vector<shared_ptr<LogEvent>>& matcherTransformations) {
     if (matcherResults[matcherIndex] != MatchingState::kNotComputed) {
         VLOG("Matcher %lld already evaluated ", (long long)mId);
@@ -90,7 +112,20 @@ void SimpleAtomMatchingTracker::onLogEvent(
         return;
     }
 
-    auto [matched, transformedEvent] = matchesSimple(mUidMap, mMatcher, event);
+    // Identical matcher definitions share the same contents hash regardless of the ids
+    // they are declared under, so the first tracker to evaluate this definition for the
+    // event populates the process-wide cache and every other one — in this config or
+    // any other — reuses the result.
+    bool matched;
+    shared_ptr<LogEvent> transformedEvent;
+    MatcherResultCache& cache = MatcherResultCache::getInstance();
+    if (!cache.lookup(mContentsHash, event, &matched, &transformedEvent)) {
+        auto [simpleMatched, simpleTransformedEvent] =
+                matchesSimple(mUidMap, mMatcher, event, &mStringMatcherIndex, &mPositionalIndex);
+        matched = simpleMatched;
+        transformedEvent = std::move(simpleTransformedEvent);
+        cache.store(mContentsHash, event, matched, transformedEvent);
+    }
     matcherResults[matcherIndex] = matched ? MatchingState::kMatched : MatchingState::kNotMatched;
     VLOG("Stats SimpleAtomMatcher %lld matched? %d", (long long)mId, matched);
 
@@ -99,6 +134,13 @@ void SimpleAtomMatchingTracker::onLogEvent(
     }
 }
 
+bool SimpleAtomMatchingTracker::matchesTrivially(int atomId) const {
+    // With no field value matchers there is nothing to evaluate or transform per
+    // event: the atom id alone decides the match.
+    return mInitialized && mMatcher.field_value_matcher_size() == 0 &&
+           mAtomIds.find(atomId) != mAtomIds.end();
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -35,7 +35,8 @@ public:
 
     ~SimpleAtomMatchingTracker();
 
-    MatcherInitResult init(int matcherIndex, const std::vector<AtomMatcher>& allAtomMatchers,
+    MatcherInitResult init(int matcherIndex,
+                           const ::google::protobuf::RepeatedPtrField<AtomMatcher>& allAtomMatchers,
                            const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
                            const std::unordered_map<int64_t, int>& matcherMap,
                            std::vector<uint8_t>& stack) override;
@@ -46,11 +47,30 @@ public:
 
     void onLogEvent(const LogEvent& event, int matcherIndex,
                     const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
-                    std::vector<MatchingState>& matcherResults,
+                    MatchingStateBitset& matcherResults,
                     std::vector<std::shared_ptr<LogEvent>>& matcherTransformations) override;
 
+    bool matchesTrivially(int atomId) const override;
+
 private:
     const SimpleAtomMatcher mMatcher;
+
+    // Hash of the SimpleAtomMatcher contents alone, excluding the enclosing
+    // AtomMatcher's id (which mProtoHash covers). Matchers repeating the same
+    // definition under different ids — within one config or across configs —
+    // share one MatcherResultCache entry through this hash.
+    const uint64_t mContentsHash;
+
+    // Hash sets precomputed from mMatcher's large eq_any_string/neq_any_string lists.
+    // Keyed by sub-message address, so it must be built from (and never outlive) mMatcher.
+    const StringMatcherIndex mStringMatcherIndex;
+
+    // Field path resolutions memoized across events of this matcher's atom; populated
+    // lazily by matchesSimple(). Keyed by FieldValueMatcher addresses inside mMatcher,
+    // so like mStringMatcherIndex it must not outlive it. Safe without a lock because a
+    // tracker only runs on its own config's serialized event path.
+    PositionalIndex mPositionalIndex;
+
     const sp<UidMap> mUidMap;
 };
 
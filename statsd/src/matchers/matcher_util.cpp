@@ -20,6 +20,11 @@
 
 #include <fnmatch.h>
 
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
 #include "matchers/AtomMatchingTracker.h"
 #include "src/statsd_config.pb.h"
 #include "stats_util.h"
@@ -34,8 +39,88 @@ namespace android {
 namespace os {
 namespace statsd {
 
+namespace {
+
+// Memoizes one replace_string transformation. Field values like package names
+// repeat constantly, so after the first evaluation the transformation for a
+// value is an LRU lookup instead of a regex run. The stored result is nullopt
+// when the transformation leaves the value unchanged (no match or identity
+// replacement), which is also the common case worth remembering.
+class StringTransformMemo {
+public:
+    // Bounds memory per (pattern, replacement) pair; launcher-style workloads
+    // cycle through a few dozen distinct values.
+    static constexpr size_t kMaxEntries = 64;
+
+    StringTransformMemo(std::shared_ptr<Regex> re, string replacement)
+        : mRe(std::move(re)), mReplacement(std::move(replacement)) {
+    }
+
+    std::optional<string> transform(const string& input) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(input);
+        if (it != mEntries.end()) {
+            mRecency.splice(mRecency.begin(), mRecency, it->second);
+            return it->second->second;
+        }
+        string str = input;
+        std::optional<string> result;
+        if (mRe->replace(str, mReplacement) && str != input) {
+            result = std::move(str);
+        }
+        mRecency.emplace_front(input, result);
+        mEntries[input] = mRecency.begin();
+        if (mEntries.size() > kMaxEntries) {
+            mEntries.erase(mRecency.back().first);
+            mRecency.pop_back();
+        }
+        return result;
+    }
+
+private:
+    // Matchers for different configs can run concurrently, and memos are shared
+    // by pattern+replacement across configs.
+    std::mutex mMutex;
+    const std::shared_ptr<Regex> mRe;
+    const string mReplacement;
+    std::list<std::pair<string, std::optional<string>>> mRecency;
+    std::unordered_map<string, std::list<std::pair<string, std::optional<string>>>::iterator>
+            mEntries;
+};
+
+// Returns the process-wide memo for the given pattern and replacement, or
+// nullptr if the pattern does not compile.
+StringTransformMemo* getStringTransformMemo(const string& pattern, const string& replacement) {
+    static std::mutex memosMutex;
+    static auto* memos = new std::unordered_map<string, unique_ptr<StringTransformMemo>>();
+
+    string key = pattern;
+    key += '\x1f';  // cannot appear between a valid pattern and its replacement
+    key += replacement;
+
+    std::lock_guard<std::mutex> lock(memosMutex);
+    auto it = memos->find(key);
+    if (it != memos->end()) {
+        return it->second.get();
+    }
+    std::shared_ptr<Regex> re = Regex::createShared(pattern);
+    if (re == nullptr) {
+        return nullptr;
+    }
+    // Pattern/replacement pairs come from configs, so this stays small; reset it
+    // in the unlikely event config churn accumulates stale pairs.
+    if (memos->size() > 128) {
+        memos->clear();
+    }
+    auto inserted = memos->emplace(
+            std::move(key), std::make_unique<StringTransformMemo>(std::move(re), replacement));
+    return inserted.first->second.get();
+}
+
+}  // anonymous namespace
+
 bool combinationMatch(const vector<int>& children, const LogicalOperation& operation,
-                      const vector<MatchingState>& matcherResults) {
+                      const MatchingStateBitset& matcherResults) {
     bool matched;
     switch (operation) {
         case LogicalOperation::AND: {
@@ -134,13 +219,13 @@ static unique_ptr<LogEvent> getTransformedEvent(const FieldValueMatcher& matcher
         return nullptr;
     }
 
-    unique_ptr<Regex> re = Regex::create(matcher.replace_string().regex());
+    StringTransformMemo* memo = getStringTransformMemo(matcher.replace_string().regex(),
+                                                       matcher.replace_string().replacement());
 
-    if (re == nullptr) {
+    if (memo == nullptr) {
         return nullptr;
     }
 
-    const string& replacement = matcher.replace_string().replacement();
     unique_ptr<LogEvent> transformedEvent = nullptr;
     for (int i = start; i < end; i++) {
         const LogEvent& eventRef = transformedEvent == nullptr ? event : *transformedEvent;
@@ -148,8 +233,8 @@ static unique_ptr<LogEvent> getTransformedEvent(const FieldValueMatcher& matcher
         if (fieldValue.mValue.getType() != STRING) {
             continue;
         }
-        string str = fieldValue.mValue.str_value;
-        if (!re->replace(str, replacement) || str == fieldValue.mValue.str_value) {
+        std::optional<string> transformed = memo->transform(fieldValue.mValue.str_value);
+        if (!transformed.has_value()) {
             continue;
         }
 
@@ -157,7 +242,7 @@ static unique_ptr<LogEvent> getTransformedEvent(const FieldValueMatcher& matcher
         if (transformedEvent == nullptr) {
             transformedEvent = std::make_unique<LogEvent>(event);
         }
-        (*transformedEvent->getMutableValues())[i].mValue.str_value = str;
+        (*transformedEvent->getMutableValues())[i].mValue.str_value = std::move(*transformed);
     }
     return transformedEvent;
 }
@@ -283,8 +368,75 @@ static vector<pair<int, int>> computeRanges(const FieldValueMatcher& matcher,
     return ranges;
 }
 
+// Returns the precomputed hash set for strList, or nullptr when none was built (small
+// list, or caller did not supply an index).
+static const std::unordered_set<string>* getStringHashSet(
+        const StringMatcherIndex* stringMatcherIndex, const StringListMatcher& strList) {
+    if (stringMatcherIndex == nullptr) {
+        return nullptr;
+    }
+    const auto it = stringMatcherIndex->find(&strList);
+    return it != stringMatcherIndex->end() ? &it->second : nullptr;
+}
+
+// Whether the field matches any entry of the string list, probing the precomputed hash
+// set when one exists. Falls back to the linear tryMatchString scan for uid-annotated
+// fields, which match through UidMap package translation rather than raw equality.
+static bool tryMatchAnyString(const sp<UidMap>& uidMap, const FieldValue& fieldValue,
+                              const StringListMatcher& strList,
+                              const std::unordered_set<string>* strSet) {
+    if (strSet != nullptr && !isAttributionUidField(fieldValue) && !isUidField(fieldValue)) {
+        return fieldValue.mValue.getType() == STRING &&
+               strSet->find(fieldValue.mValue.str_value) != strSet->end();
+    }
+    for (const auto& str : strList.str_value()) {
+        if (tryMatchString(uidMap, fieldValue, str)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void buildStringMatcherIndexForFvm(const FieldValueMatcher& matcher,
+                                          StringMatcherIndex& index) {
+    switch (matcher.value_matcher_case()) {
+        case FieldValueMatcher::kMatchesTuple:
+            for (const FieldValueMatcher& subMatcher :
+                 matcher.matches_tuple().field_value_matcher()) {
+                buildStringMatcherIndexForFvm(subMatcher, index);
+            }
+            break;
+        case FieldValueMatcher::ValueMatcherCase::kEqAnyString:
+            if (matcher.eq_any_string().str_value_size() >= kMinStringsForHashSet) {
+                index[&matcher.eq_any_string()].insert(
+                        matcher.eq_any_string().str_value().begin(),
+                        matcher.eq_any_string().str_value().end());
+            }
+            break;
+        case FieldValueMatcher::ValueMatcherCase::kNeqAnyString:
+            if (matcher.neq_any_string().str_value_size() >= kMinStringsForHashSet) {
+                index[&matcher.neq_any_string()].insert(
+                        matcher.neq_any_string().str_value().begin(),
+                        matcher.neq_any_string().str_value().end());
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+StringMatcherIndex buildStringMatcherIndex(const SimpleAtomMatcher& simpleMatcher) {
+    StringMatcherIndex index;
+    for (const FieldValueMatcher& matcher : simpleMatcher.field_value_matcher()) {
+        buildStringMatcherIndexForFvm(matcher, index);
+    }
+    return index;
+}
+
 static MatchResult matchesSimple(const sp<UidMap>& uidMap, const FieldValueMatcher& matcher,
-                                 const LogEvent& event, int start, int end, int depth) {
+                                 const LogEvent& event, int start, int end, int depth,
+                                 const StringMatcherIndex* stringMatcherIndex,
+                                 PositionalIndex* positionalIndex) {
     if (depth > 2) {
         ALOGE("Depth >= 3 not supported");
         return {false, nullptr};
@@ -294,8 +446,26 @@ static MatchResult matchesSimple(const sp<UidMap>& uidMap, const FieldValueMatch
         return {false, nullptr};
     }
 
-    const vector<pair<int, int>> ranges =
-            computeRanges(matcher, event.getValues(), start, end, depth);
+    // Ranges depend only on the event's field layout, which the caller has already
+    // validated against the index, so a hit replays the resolution without scanning.
+    vector<pair<int, int>> scratchRanges;
+    const vector<pair<int, int>>* rangesPtr;
+    if (positionalIndex != nullptr) {
+        auto [it, inserted] =
+                positionalIndex->entries.try_emplace(std::make_tuple(&matcher, start, end));
+        if (inserted) {
+            int resolvedDepth = depth;
+            it->second.ranges = computeRanges(matcher, event.getValues(), start, end,
+                                              resolvedDepth);
+            it->second.depth = resolvedDepth;
+        }
+        rangesPtr = &it->second.ranges;
+        depth = it->second.depth;
+    } else {
+        scratchRanges = computeRanges(matcher, event.getValues(), start, end, depth);
+        rangesPtr = &scratchRanges;
+    }
+    const vector<pair<int, int>>& ranges = *rangesPtr;
 
     if (ranges.empty()) {
         // No such field found.
@@ -321,8 +491,9 @@ static MatchResult matchesSimple(const sp<UidMap>& uidMap, const FieldValueMatch
                 for (const auto& subMatcher : matcher.matches_tuple().field_value_matcher()) {
                     const LogEvent& eventRef =
                             transformedEvent == nullptr ? event : *transformedEvent;
-                    auto [hasMatched, newTransformedEvent] = matchesSimple(
-                            uidMap, subMatcher, eventRef, rangeStart, rangeEnd, depth);
+                    auto [hasMatched, newTransformedEvent] =
+                            matchesSimple(uidMap, subMatcher, eventRef, rangeStart, rangeEnd, depth,
+                                          stringMatcherIndex, positionalIndex);
                     if (newTransformedEvent != nullptr) {
                         transformedEvent = std::move(newTransformedEvent);
                     }
@@ -358,15 +529,9 @@ static MatchResult matchesSimple(const sp<UidMap>& uidMap, const FieldValueMatch
         }
         case FieldValueMatcher::ValueMatcherCase::kNeqAnyString: {
             const auto& str_list = matcher.neq_any_string();
+            const auto* strSet = getStringHashSet(stringMatcherIndex, str_list);
             for (int i = start; i < end; i++) {
-                bool notEqAll = true;
-                for (const auto& str : str_list.str_value()) {
-                    if (tryMatchString(uidMap, values[i], str)) {
-                        notEqAll = false;
-                        break;
-                    }
-                }
-                if (notEqAll) {
+                if (!tryMatchAnyString(uidMap, values[i], str_list, strSet)) {
                     return {true, std::move(transformedEvent)};
                 }
             }
@@ -374,11 +539,10 @@ static MatchResult matchesSimple(const sp<UidMap>& uidMap, const FieldValueMatch
         }
         case FieldValueMatcher::ValueMatcherCase::kEqAnyString: {
             const auto& str_list = matcher.eq_any_string();
+            const auto* strSet = getStringHashSet(stringMatcherIndex, str_list);
             for (int i = start; i < end; i++) {
-                for (const auto& str : str_list.str_value()) {
-                    if (tryMatchString(uidMap, values[i], str)) {
-                        return {true, std::move(transformedEvent)};
-                    }
+                if (tryMatchAnyString(uidMap, values[i], str_list, strSet)) {
+                    return {true, std::move(transformedEvent)};
                 }
             }
             return {false, std::move(transformedEvent)};
@@ -555,17 +719,50 @@ static MatchResult matchesSimple(const sp<UidMap>& uidMap, const FieldValueMatch
     }
 }
 
+// Keeps the positional index in sync with the event's field layout: cached entries
+// stay valid while the layout is unchanged, and a layout change (e.g. a different
+// attribution chain length) drops them so they are recomputed from this event. String
+// transformations never change the layout, so validating against the original event
+// covers the transformed copies too.
+static void syncPositionalIndexLayout(PositionalIndex& positionalIndex,
+                                      const vector<FieldValue>& values) {
+    const size_t count = values.size();
+    if (positionalIndex.layout.size() == count) {
+        bool same = true;
+        for (size_t i = 0; i < count; i++) {
+            if (positionalIndex.layout[i] != values[i].mField.getField()) {
+                same = false;
+                break;
+            }
+        }
+        if (same) {
+            return;
+        }
+    }
+    positionalIndex.entries.clear();
+    positionalIndex.layout.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        positionalIndex.layout[i] = values[i].mField.getField();
+    }
+}
+
 MatchResult matchesSimple(const sp<UidMap>& uidMap, const SimpleAtomMatcher& simpleMatcher,
-                          const LogEvent& event) {
+                          const LogEvent& event, const StringMatcherIndex* stringMatcherIndex,
+                          PositionalIndex* positionalIndex) {
     if (event.GetTagId() != simpleMatcher.atom_id()) {
         return {false, nullptr};
     }
 
+    if (positionalIndex != nullptr) {
+        syncPositionalIndexLayout(*positionalIndex, event.getValues());
+    }
+
     unique_ptr<LogEvent> transformedEvent = nullptr;
     for (const auto& matcher : simpleMatcher.field_value_matcher()) {
         const LogEvent& inputEvent = transformedEvent == nullptr ? event : *transformedEvent;
         auto [hasMatched, newTransformedEvent] =
-                matchesSimple(uidMap, matcher, inputEvent, 0, inputEvent.getValues().size(), 0);
+                matchesSimple(uidMap, matcher, inputEvent, 0, inputEvent.getValues().size(), 0,
+                              stringMatcherIndex, positionalIndex);
         if (newTransformedEvent != nullptr) {
             transformedEvent = std::move(newTransformedEvent);
         }
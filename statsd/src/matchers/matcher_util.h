@@ -18,6 +18,11 @@
 
 #include "logd/LogEvent.h"
 
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "src/statsd_config.pb.h"
 #include "packages/UidMap.h"
@@ -33,16 +38,158 @@ enum MatchingState {
     kMatched = 1,
 };
 
+/**
+ * Packed per-event matcher results. Two bit arrays (computed, matched) carry the same
+ * tri-state as a vector<MatchingState> in 2 bits per matcher instead of a 4-byte enum,
+ * so the per-event caches reset with a few word fills and copy between the matching,
+ * condition and metric fanout stages in register-sized moves.
+ *
+ * operator[] on a non-const bitset returns a proxy Reference so existing call sites can
+ * keep the familiar `results[i] = MatchingState::kMatched` / `results[i] == kMatched`
+ * syntax (same idiom as vector<bool>).
+ */
+class MatchingStateBitset {
+public:
+    MatchingStateBitset() = default;
+
+    MatchingStateBitset(size_t size, MatchingState state) {
+        assign(size, state);
+    }
+
+    class Reference {
+    public:
+        Reference(MatchingStateBitset& owner, size_t index) : mOwner(owner), mIndex(index) {
+        }
+
+        Reference& operator=(MatchingState state) {
+            mOwner.set(mIndex, state);
+            return *this;
+        }
+
+        operator MatchingState() const {
+            return mOwner.get(mIndex);
+        }
+
+    private:
+        MatchingStateBitset& mOwner;
+        const size_t mIndex;
+    };
+
+    MatchingState operator[](size_t index) const {
+        return get(index);
+    }
+
+    Reference operator[](size_t index) {
+        return Reference(*this, index);
+    }
+
+    MatchingState get(size_t index) const {
+        const size_t word = index >> 6;
+        const uint64_t bit = 1ull << (index & 63);
+        if (!(mComputed[word] & bit)) {
+            return MatchingState::kNotComputed;
+        }
+        return (mMatched[word] & bit) ? MatchingState::kMatched : MatchingState::kNotMatched;
+    }
+
+    void set(size_t index, MatchingState state) {
+        const size_t word = index >> 6;
+        const uint64_t bit = 1ull << (index & 63);
+        if (state == MatchingState::kNotComputed) {
+            mComputed[word] &= ~bit;
+            mMatched[word] &= ~bit;
+        } else {
+            mComputed[word] |= bit;
+            if (state == MatchingState::kMatched) {
+                mMatched[word] |= bit;
+            } else {
+                mMatched[word] &= ~bit;
+            }
+        }
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+    void clear() {
+        mSize = 0;
+        mComputed.clear();
+        mMatched.clear();
+    }
+
+    void assign(size_t size, MatchingState state) {
+        mSize = size;
+        const size_t numWords = (size + 63) >> 6;
+        mComputed.assign(numWords, state == MatchingState::kNotComputed ? 0 : ~0ull);
+        mMatched.assign(numWords, state == MatchingState::kMatched ? ~0ull : 0);
+    }
+
+    void push_back(MatchingState state) {
+        if ((mSize & 63) == 0) {
+            mComputed.push_back(0);
+            mMatched.push_back(0);
+        }
+        set(mSize++, state);
+    }
+
+private:
+    size_t mSize = 0;
+    std::vector<uint64_t> mComputed;
+    std::vector<uint64_t> mMatched;
+};
+
 struct MatchResult {
     bool matched;
     std::unique_ptr<LogEvent> transformedEvent;
 };
 
+// Minimum number of entries in an eq_any_string/neq_any_string list before a hash set is
+// precomputed for it. Below this, the linear scan over the proto list is cheaper than a
+// hash probe.
+constexpr int kMinStringsForHashSet = 10;
+
+// Precomputed hash sets for large eq_any_string/neq_any_string lists, keyed by the
+// address of the StringListMatcher sub-message inside the owning tracker's
+// SimpleAtomMatcher proto. Turns the per-value O(listSize * strlen) scan into a single
+// hash probe for plain string fields; uid-annotated fields still take the linear path
+// since they match through UidMap package translation.
+using StringMatcherIndex =
+        std::unordered_map<const StringListMatcher*, std::unordered_set<std::string>>;
+
+// Walks the (possibly nested) FieldValueMatchers of simpleMatcher and builds hash sets
+// for string lists with at least kMinStringsForHashSet entries. Called once at config
+// load; the returned index must not outlive simpleMatcher.
+StringMatcherIndex buildStringMatcherIndex(const SimpleAtomMatcher& simpleMatcher);
+
+// Memoized field path resolutions for one SimpleAtomMatcher. The [start, end) index
+// ranges a field path (with its FIRST/LAST/ANY/ALL position qualifier) resolves to in
+// the FieldValue vector depend only on the event's field layout — the sorted sequence
+// of encoded Field ids — never on the payload values, so once the first event of a
+// layout has been scanned, later events with the same layout skip the per-position mask
+// scans entirely. Repeated fields make the layout vary across events of one atom id
+// (e.g. attribution chains of different lengths); a layout change simply invalidates
+// and repopulates the cache at the cost of one ordinary scan.
+struct PositionalIndex {
+    struct Entry {
+        std::vector<std::pair<int, int>> ranges;
+        int depth;
+    };
+
+    // Encoded Field ids of the event the entries were computed from.
+    std::vector<int32_t> layout;
+    // Keyed by the FieldValueMatcher node plus the [start, end) window it was queried
+    // with; the same node is visited once per sub-range under Position::ANY.
+    std::map<std::tuple<const FieldValueMatcher*, int, int>, Entry> entries;
+};
+
 bool combinationMatch(const std::vector<int>& children, const LogicalOperation& operation,
-                      const std::vector<MatchingState>& matcherResults);
+                      const MatchingStateBitset& matcherResults);
 
 MatchResult matchesSimple(const sp<UidMap>& uidMap, const SimpleAtomMatcher& simpleMatcher,
-                          const LogEvent& wrapper);
+                          const LogEvent& wrapper,
+                          const StringMatcherIndex* stringMatcherIndex = nullptr,
+                          PositionalIndex* positionalIndex = nullptr);
 
 }  // namespace statsd
 }  // namespace os
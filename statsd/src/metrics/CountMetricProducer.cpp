@@ -127,6 +127,12 @@ CountMetricProducer::CountMetricProducer(
     mConditionTimer.onConditionChanged(mIsActive && mCondition == ConditionState::kTrue,
                                        mCurrentBucketStartTimeNs);
 
+    // Metrics that raise max_dimensions_per_bucket expect to run near their guardrail;
+    // pre-size the sliced counter so steady-state increments never rehash.
+    if (!mDimensionsInWhat.empty() && metric.has_max_dimensions_per_bucket()) {
+        mCurrentSlicedCounter->reserve(mDimensionHardLimit);
+    }
+
     VLOG("metric %lld created. bucket size %lld start_time: %lld", (long long)mMetricId,
          (long long)mBucketSizeNs, (long long)mTimeBaseNs);
 }
@@ -214,6 +220,7 @@ void CountMetricProducer::onSlicedConditionMayChangeLocked(bool overallCondition
 
 void CountMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mPastBuckets.clear();
+    mTotalSize = 0;
 }
 
 void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
@@ -278,31 +285,11 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
             writeStateToProto(state, protoOutput);
             protoOutput->end(stateToken);
         }
-        // Then fill bucket_info (CountBucketInfo).
+        // Then fill bucket_info (CountBucketInfo) by splicing the segments that were
+        // frozen when the buckets were flushed.
         for (const auto& bucket : counter.second) {
-            uint64_t bucketInfoToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
-            // Partial bucket.
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketStartNs));
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketEndNs));
-            } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
-            }
-            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_COUNT, (long long)bucket.mCount);
-
-            // We only write the condition timer value if the metric has a
-            // condition and isn't sliced by state or condition.
-            // TODO(b/268531179): Slice the condition timer by state and condition
-            if (mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
-                                   (long long)bucket.mConditionTrueNs);
-            }
-
-            protoOutput->end(bucketInfoToken);
+            protoOutput->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO,
+                               bucket.mFrozenBytes.data(), bucket.mFrozenBytes.size());
             VLOG("\t bucket [%lld - %lld] count: %lld", (long long)bucket.mBucketStartNs,
                  (long long)bucket.mBucketEndNs, (long long)bucket.mCount);
         }
@@ -313,6 +300,7 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
 
     if (erase_data) {
         mPastBuckets.clear();
+        mTotalSize = 0;
         mDimensionGuardrailHit = false;
     }
 }
@@ -321,6 +309,12 @@ void CountMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
     mPastBuckets.clear();
+    mTotalSize = 0;
+}
+
+void CountMetricProducer::trimMemoryLocked() {
+    mPastBuckets.shrink_to_fit();
+    mCurrentSlicedCounter->shrink_to_fit();
 }
 
 void CountMetricProducer::onConditionChangedLocked(const bool conditionMet,
@@ -436,6 +430,35 @@ bool CountMetricProducer::countPassesThreshold(const int64_t count) {
     }
 }
 
+// Serializes the bucket into its final CountBucketInfo wire representation.
+// Everything the encoding depends on is already final when a bucket is flushed,
+// so freezing here lets dumps concatenate the stored segments instead of
+// re-serializing them, and makes byteSizeLocked() exact for bucket data.
+void CountMetricProducer::freezeBucketLocked(CountBucket& bucket) {
+    ProtoOutputStream proto;
+    // Partial bucket.
+    if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+                    (long long)NanoToMillis(bucket.mBucketStartNs));
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+                    (long long)NanoToMillis(bucket.mBucketEndNs));
+    } else {
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                    (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+    }
+    proto.write(FIELD_TYPE_INT64 | FIELD_ID_COUNT, (long long)bucket.mCount);
+
+    // We only write the condition timer value if the metric has a
+    // condition and isn't sliced by state or condition.
+    // TODO(b/268531179): Slice the condition timer by state and condition
+    if (mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced) {
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
+                    (long long)bucket.mConditionTrueNs);
+    }
+
+    proto.serializeToString(&bucket.mFrozenBytes);
+}
+
 void CountMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
                                                    const int64_t nextBucketStartTimeNs) {
     int64_t fullBucketEndTimeNs = getCurrentBucketEndTimeNs();
@@ -454,8 +477,10 @@ void CountMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
     for (const auto& counter : *mCurrentSlicedCounter) {
         if (countPassesThreshold(counter.second)) {
             info.mCount = counter.second;
+            freezeBucketLocked(info);
             auto& bucketList = mPastBuckets[counter.first];
             bucketList.push_back(info);
+            mTotalSize += info.mFrozenBytes.size();
             VLOG("metric %lld, dump key value: %s -> %lld", (long long)mMetricId,
                  counter.first.toString().c_str(), (long long)counter.second);
         }
@@ -466,19 +491,28 @@ void CountMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
         // If we have finished a full bucket, then send this to anomaly tracker.
         if (eventTimeNs > fullBucketEndTimeNs) {
             // Accumulate partial buckets with current value and then send to anomaly tracker.
+            const DimToValMap* fullBucket;
             if (mCurrentFullCounters->size() > 0) {
                 for (const auto& keyValuePair : *mCurrentSlicedCounter) {
                     (*mCurrentFullCounters)[keyValuePair.first] += keyValuePair.second;
                 }
-                for (auto& tracker : mAnomalyTrackers) {
-                    tracker->addPastBucket(mCurrentFullCounters, mCurrentBucketNum);
-                }
-                mCurrentFullCounters = std::make_shared<DimToValMap>();
+                fullBucket = mCurrentFullCounters.get();
             } else {
                 // Skip aggregating the partial buckets since there's no previous partial bucket.
-                for (auto& tracker : mAnomalyTrackers) {
-                    tracker->addPastBucket(mCurrentSlicedCounter, mCurrentBucketNum);
-                }
+                fullBucket = mCurrentSlicedCounter.get();
+            }
+            // Build the read-only flush view once and hand the same vector to
+            // every tracker, rather than re-walking the map per tracker.
+            std::vector<AnomalyTracker::FlushedSlice> flushedSlices;
+            flushedSlices.reserve(fullBucket->size());
+            for (const auto& keyValuePair : *fullBucket) {
+                flushedSlices.push_back({&keyValuePair.first, keyValuePair.second});
+            }
+            for (auto& tracker : mAnomalyTrackers) {
+                tracker->addPastBucket(flushedSlices, mCurrentBucketNum);
+            }
+            if (fullBucket == mCurrentFullCounters.get()) {
+                mCurrentFullCounters = std::make_shared<DimToValMap>();
             }
         } else {
             // Accumulate partial bucket.
@@ -497,15 +531,11 @@ void CountMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
     mHasHitGuardrail = false;
 }
 
-// Rough estimate of CountMetricProducer buffer stored. This number will be
-// greater than actual data size as it contains each dimension of
-// CountMetricData is  duplicated.
+// Exact serialized size of the stored bucket segments, summed as buckets are
+// frozen at flush time. Per-dimension overhead (dimension paths/leaves) is not
+// included.
 size_t CountMetricProducer::byteSizeLocked() const {
-    size_t totalSize = 0;
-    for (const auto& pair : mPastBuckets) {
-        totalSize += pair.second.size() * kBucketSize;
-    }
-    return totalSize;
+    return mTotalSize;
 }
 
 void CountMetricProducer::onActiveStateChangedLocked(const int64_t eventTimeNs,
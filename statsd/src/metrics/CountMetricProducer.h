@@ -20,6 +20,7 @@
 #include <android/util/ProtoOutputStream.h>
 #include <gtest/gtest_prod.h>
 
+#include <string>
 #include <unordered_map>
 
 #include "MetricProducer.h"
@@ -39,6 +40,11 @@ struct CountBucket {
     int64_t mBucketEndNs;
     int64_t mCount;
     int64_t mConditionTrueNs;
+
+    // Wire-format CountBucketInfo segment, frozen when the bucket is flushed.
+    // Dump assembly splices these bytes verbatim, so re-generating a report
+    // after a failed upload costs no re-serialization.
+    std::string mFrozenBytes;
 };
 
 class CountMetricProducer : public MetricProducer {
@@ -63,6 +69,10 @@ public:
         return METRIC_TYPE_COUNT;
     }
 
+    bool supportsCoordinatedRotation() const override {
+        return true;
+    }
+
 protected:
     void onMatchedLogEventInternalLocked(
             const size_t matcherIndex, const MetricDimensionKey& eventKey,
@@ -93,6 +103,8 @@ private:
 
     void dropDataLocked(const int64_t dropTimeNs) override;
 
+    void trimMemoryLocked() override;
+
     // Util function to flush the old packet.
     void flushIfNeededLocked(int64_t newEventTime) override;
 
@@ -116,7 +128,11 @@ private:
             std::unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
             std::vector<int>& metricsWithActivation) override;
 
-    std::unordered_map<MetricDimensionKey, std::vector<CountBucket>> mPastBuckets;
+    FlatHashMap<MetricDimensionKey, std::vector<CountBucket>> mPastBuckets;
+
+    // Running byte size of the frozen bucket segments in mPastBuckets, maintained where
+    // buckets are added or cleared so that byteSizeLocked() is a constant-time read.
+    size_t mTotalSize = 0;
 
     // The current bucket (may be a partial bucket).
     std::shared_ptr<DimToValMap> mCurrentSlicedCounter = std::make_shared<DimToValMap>();
@@ -125,12 +141,12 @@ private:
     // partial bucket). This is only updated while flushing the current bucket.
     std::shared_ptr<DimToValMap> mCurrentFullCounters = std::make_shared<DimToValMap>();
 
-    static const size_t kBucketSize = sizeof(CountBucket{});
-
     bool hitGuardRailLocked(const MetricDimensionKey& newKey);
 
     bool countPassesThreshold(int64_t count);
 
+    void freezeBucketLocked(CountBucket& bucket);
+
     // Tracks if the dimension guardrail has been hit in the current report.
     bool mDimensionGuardrailHit;
 
@@ -143,6 +159,7 @@ private:
     FRIEND_TEST(CountMetricProducerTest, TestFirstBucket);
     FRIEND_TEST(CountMetricProducerTest, TestOneWeekTimeUnit);
     FRIEND_TEST(CountMetricProducerTest, TestSplitOnAppUpgradeDisabled);
+    FRIEND_TEST(CountMetricProducerTest, TestFrozenBucketSegments);
 
     FRIEND_TEST(CountMetricProducerTest_PartialBucket, TestSplitInCurrentBucket);
     FRIEND_TEST(CountMetricProducerTest_PartialBucket, TestSplitInNextBucket);
@@ -106,6 +106,7 @@ DurationMetricProducer::DurationMetricProducer(
 
     if (internalDimensions.has_field()) {
         translateFieldMatcher(internalDimensions, &mInternalDimensions);
+        mInternalDimensionsPlan = FieldExtractionPlan(mInternalDimensions);
         mContainANYPositionInInternalDimensions = HasPositionANY(internalDimensions);
     }
     if (mContainANYPositionInInternalDimensions) {
@@ -136,6 +137,7 @@ DurationMetricProducer::DurationMetricProducer(
                 mValid = false;
             }
             mMetric2ConditionLinks.push_back(mc);
+            mMetric2ConditionLinkPlans.emplace_back(mc);
         }
         mConditionSliced = true;
     }
@@ -160,6 +162,10 @@ DurationMetricProducer::DurationMetricProducer(
         mHasLinksToAllConditionDimensionsInTracker = mWizard->equalOutputDimensions(
                 mConditionTrackerIndex, mMetric2ConditionLinks.begin()->conditionFields);
     }
+    mTrackerContext = std::make_shared<DurationTrackerContext>(
+            mConfigKey, mMetricId, mWizard, mConditionTrackerIndex, mNested, mTimeBaseNs,
+            mBucketSizeNs, mConditionSliced, mHasLinksToAllConditionDimensionsInTracker,
+            mAnomalyTrackers);
     flushIfNeededLocked(startTimeNs);
     // Adjust start for partial bucket
     mCurrentBucketStartTimeNs = startTimeNs;
@@ -255,9 +261,10 @@ optional<InvalidConfigReason> DurationMetricProducer::onConfigUpdatedLocked(
         }
     }
 
-    for (const auto& it : mCurrentSlicedDurationTrackerMap) {
-        it.second->onConfigUpdated(wizard, mConditionTrackerIndex);
-    }
+    // All duration trackers share one context; update it once instead of per slice.
+    mTrackerContext->wizard = wizard;
+    mTrackerContext->conditionTrackerIndex = mConditionTrackerIndex;
+    mTrackerContext->anomalyTrackers.clear();
 
     return nullopt;
 }
@@ -270,7 +277,7 @@ void DurationMetricProducer::initTrueDimensions(const int whatIndex, const int64
     if (whatIndex == -1) {
         return;
     }
-    const map<HashableDimensionKey, int>* slicedWhatMap = mWizard->getSlicedDimensionMap(whatIndex);
+    const SlicedConditionStateMap* slicedWhatMap = mWizard->getSlicedDimensionMap(whatIndex);
     for (const auto& [internalDimKey, count] : *slicedWhatMap) {
         for (int i = 0; i < count; i++) {
             // Fake start events.
@@ -310,6 +317,7 @@ void DurationMetricProducer::addAnomalyTrackerLocked(sp<AnomalyTracker>& anomaly
                                                      const UpdateStatus& updateStatus,
                                                      const int64_t updateTimeNs) {
     mAnomalyTrackers.push_back(anomalyTracker);
+    mTrackerContext->anomalyTrackers.push_back(anomalyTracker);
     for (const auto& [_, durationTracker] : mCurrentSlicedDurationTrackerMap) {
         durationTracker->addAnomalyTracker(anomalyTracker, updateStatus, updateTimeNs);
     }
@@ -347,15 +355,11 @@ unique_ptr<DurationTracker> DurationMetricProducer::createDurationTracker(
         const MetricDimensionKey& eventKey) const {
     switch (mAggregationType) {
         case DurationMetric_AggregationType_SUM:
-            return make_unique<OringDurationTracker>(
-                    mConfigKey, mMetricId, eventKey, mWizard, mConditionTrackerIndex, mNested,
-                    mCurrentBucketStartTimeNs, mCurrentBucketNum, mTimeBaseNs, mBucketSizeNs,
-                    mConditionSliced, mHasLinksToAllConditionDimensionsInTracker, mAnomalyTrackers);
+            return make_unique<OringDurationTracker>(mTrackerContext, eventKey,
+                                                     mCurrentBucketStartTimeNs, mCurrentBucketNum);
         case DurationMetric_AggregationType_MAX_SPARSE:
-            return make_unique<MaxDurationTracker>(
-                    mConfigKey, mMetricId, eventKey, mWizard, mConditionTrackerIndex, mNested,
-                    mCurrentBucketStartTimeNs, mCurrentBucketNum, mTimeBaseNs, mBucketSizeNs,
-                    mConditionSliced, mHasLinksToAllConditionDimensionsInTracker, mAnomalyTrackers);
+            return make_unique<MaxDurationTracker>(mTrackerContext, eventKey,
+                                                   mCurrentBucketStartTimeNs, mCurrentBucketNum);
     }
 }
 
@@ -389,7 +393,7 @@ void DurationMetricProducer::onSlicedConditionMayChangeLocked_opt1(const int64_t
     // state based on the new unsliced condition state.
     if (dimensionsChangedToTrue == nullptr || dimensionsChangedToFalse == nullptr ||
         (dimensionsChangedToTrue->empty() && dimensionsChangedToFalse->empty())) {
-        const map<HashableDimensionKey, int>* slicedConditionMap =
+        const SlicedConditionStateMap* slicedConditionMap =
                 mWizard->getSlicedDimensionMap(mConditionTrackerIndex);
         for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
             HashableDimensionKey linkedConditionDimensionKey;
@@ -421,15 +425,24 @@ void DurationMetricProducer::onSlicedConditionMayChangeLocked_opt1(const int64_t
 }
 
 void DurationMetricProducer::onSlicedConditionMayChangeInternalLocked(const int64_t eventTimeNs) {
+    // A sliced condition change can start/stop an anomaly alarm per tracker;
+    // batch them so the alarm monitor is updated once, not once per dimension.
+    for (auto& anomalyTracker : mAnomalyTrackers) {
+        anomalyTracker->beginAlarmBatch();
+    }
+
     bool changeDimTrackable = mWizard->IsChangedDimensionTrackable(mConditionTrackerIndex);
     if (changeDimTrackable && mHasLinksToAllConditionDimensionsInTracker) {
         onSlicedConditionMayChangeLocked_opt1(eventTimeNs);
-        return;
+    } else {
+        // Now for each of the on-going event, check if the condition has changed for them.
+        for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
+            whatIt.second->onSlicedConditionMayChange(eventTimeNs);
+        }
     }
 
-    // Now for each of the on-going event, check if the condition has changed for them.
-    for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
-        whatIt.second->onSlicedConditionMayChange(eventTimeNs);
+    for (auto& anomalyTracker : mAnomalyTrackers) {
+        anomalyTracker->commitAlarmBatch();
     }
 }
 
@@ -487,9 +500,16 @@ void DurationMetricProducer::onConditionChangedLocked(const bool conditionMet,
     }
 
     flushIfNeededLocked(eventTime);
+    // Batch the per-tracker alarm starts/stops into one alarm monitor update.
+    for (auto& anomalyTracker : mAnomalyTrackers) {
+        anomalyTracker->beginAlarmBatch();
+    }
     for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
         whatIt.second->onConditionChanged(conditionMet, eventTime);
     }
+    for (auto& anomalyTracker : mAnomalyTrackers) {
+        anomalyTracker->commitAlarmBatch();
+    }
 
     mConditionTimer.onConditionChanged(mCondition, eventTime);
 }
@@ -498,11 +518,18 @@ void DurationMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
     mPastBuckets.clear();
+    mTotalSize = 0;
+}
+
+void DurationMetricProducer::trimMemoryLocked() {
+    shrinkMapIfOverProvisioned(mPastBuckets);
+    shrinkMapIfOverProvisioned(mCurrentSlicedDurationTrackerMap);
 }
 
 void DurationMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     flushIfNeededLocked(dumpTimeNs);
     mPastBuckets.clear();
+    mTotalSize = 0;
 }
 
 void DurationMetricProducer::onDumpReportLocked(
@@ -600,6 +627,7 @@ void DurationMetricProducer::onDumpReportLocked(
     protoOutput->end(protoToken);
     if (erase_data) {
         mPastBuckets.clear();
+        mTotalSize = 0;
     }
 }
 
@@ -633,10 +661,18 @@ void DurationMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
         }
     }
 
+    // The trackers above append past buckets directly; refresh the running byte-size
+    // total here, off the per-event path.
+    mTotalSize = 0;
+    for (const auto& pair : mPastBuckets) {
+        mTotalSize += pair.second.size() * kBucketSize;
+    }
+
     StatsdStats::getInstance().noteBucketCount(mMetricId);
     mCurrentBucketStartTimeNs = nextBucketStartTimeNs;
     // Reset mHasHitGuardrail boolean since bucket was reset
     mHasHitGuardrail = false;
+    mHasEvictedIdleDimensionsInBucket = false;
 }
 
 void DurationMetricProducer::dumpStatesLocked(int out, bool verbose) const {
@@ -684,6 +720,15 @@ void DurationMetricProducer::handleStartEvent(const MetricDimensionKey& eventKey
     const auto& whatKey = eventKey.getDimensionKeyInWhat();
     auto whatIt = mCurrentSlicedDurationTrackerMap.find(whatKey);
     if (whatIt == mCurrentSlicedDurationTrackerMap.end()) {
+        if (mCurrentSlicedDurationTrackerMap.size() + 1 > mDimensionHardLimit &&
+            !mHasEvictedIdleDimensionsInBucket) {
+            // At the hard limit every fresh dimension would be dropped for the rest of the
+            // bucket, even if most trackers are only holding finished durations. Flush once
+            // to a partial bucket: accumulated durations move to past buckets, trackers with
+            // nothing left are erased, and the freed slots let new dimensions aggregate.
+            flushCurrentBucketLocked(eventTimeNs, eventTimeNs);
+            mHasEvictedIdleDimensionsInBucket = true;
+        }
         if (hitGuardRailLocked(eventKey)) {
             return;
         }
@@ -701,7 +746,7 @@ void DurationMetricProducer::handleStartEvent(const MetricDimensionKey& eventKey
                               mDimensionHardLimit);
     } else {
         HashableDimensionKey dimensionKey = DEFAULT_DIMENSION_KEY;
-        filterValues(mInternalDimensions, eventValues, &dimensionKey);
+        mInternalDimensionsPlan.extract(eventValues, &dimensionKey);
         it->second->noteStart(dimensionKey, condition, eventTimeNs, conditionKeys,
                               mDimensionHardLimit);
     }
@@ -733,6 +778,11 @@ void DurationMetricProducer::handleMatchedLogEventValuesLocked(const size_t matc
 
     // Handles Stopall events.
     if ((int)matcherIndex == mStopAllIndex) {
+        // Stopping everything cancels an alarm per tracker; batch them into one
+        // alarm monitor update.
+        for (auto& anomalyTracker : mAnomalyTrackers) {
+            anomalyTracker->beginAlarmBatch();
+        }
         for (auto whatIt = mCurrentSlicedDurationTrackerMap.begin();
              whatIt != mCurrentSlicedDurationTrackerMap.end();) {
             whatIt->second->noteStopAll(eventTimeNs);
@@ -743,6 +793,9 @@ void DurationMetricProducer::handleMatchedLogEventValuesLocked(const size_t matc
                 whatIt++;
             }
         }
+        for (auto& anomalyTracker : mAnomalyTrackers) {
+            anomalyTracker->commitAlarmBatch();
+        }
         return;
     }
 
@@ -751,19 +804,19 @@ void DurationMetricProducer::handleMatchedLogEventValuesLocked(const size_t matc
     }
 
     HashableDimensionKey dimensionInWhat = DEFAULT_DIMENSION_KEY;
-    if (!mDimensionsInWhat.empty()) {
-        filterValues(mDimensionsInWhat, values, &dimensionInWhat);
-    }
 
     // Stores atom id to primary key pairs for each state atom that the metric is
     // sliced by.
     std::map<int, HashableDimensionKey> statePrimaryKeys;
 
-    // For states with primary fields, use MetricStateLinks to get the primary
-    // field values from the log event. These values will form a primary key
-    // that will be used to query StateTracker for the correct state value.
-    for (const auto& stateLink : mMetric2StateLinks) {
-        getDimensionForState(values, stateLink, &statePrimaryKeys[stateLink.stateAtomId]);
+    // One walk over the event's values fills the what-dimension and the state primary keys
+    // (MetricStateLinks) together, instead of rescanning the values once per link.
+    static const std::vector<Metric2Condition> noConditionLinks;
+    filterValuesFused(mDimensionsInWhat, noConditionLinks, mMetric2StateLinks, values,
+                      &dimensionInWhat, nullptr, &statePrimaryKeys);
+    if (!mDimensionsInWhat.empty()) {
+        // Canonicalize so duration trackers and anomaly buckets share one copy per key.
+        dimensionInWhat.intern();
     }
 
     // For each sliced state, query StateTracker for the state value using
@@ -805,7 +858,7 @@ void DurationMetricProducer::handleMatchedLogEventValuesLocked(const size_t matc
 
         HashableDimensionKey internalDimensionKey = DEFAULT_DIMENSION_KEY;
         if (!mInternalDimensions.empty()) {
-            filterValues(mInternalDimensions, values, &internalDimensionKey);
+            mInternalDimensionsPlan.extract(values, &internalDimensionKey);
         }
 
         auto whatIt = mCurrentSlicedDurationTrackerMap.find(dimensionInWhat);
@@ -822,8 +875,9 @@ void DurationMetricProducer::handleMatchedLogEventValuesLocked(const size_t matc
     bool condition;
     ConditionKey conditionKey;
     if (mConditionSliced) {
-        for (const auto& link : mMetric2ConditionLinks) {
-            getDimensionForCondition(values, link, &conditionKey[link.conditionId]);
+        for (size_t i = 0; i < mMetric2ConditionLinks.size(); i++) {
+            mMetric2ConditionLinkPlans[i].resolve(
+                    values, &conditionKey[mMetric2ConditionLinks[i].conditionId]);
         }
 
         auto conditionState =
@@ -842,11 +896,7 @@ void DurationMetricProducer::handleMatchedLogEventValuesLocked(const size_t matc
 }
 
 size_t DurationMetricProducer::byteSizeLocked() const {
-    size_t totalSize = 0;
-    for (const auto& pair : mPastBuckets) {
-        totalSize += pair.second.size() * kBucketSize;
-    }
-    return totalSize;
+    return mTotalSize;
 }
 
 }  // namespace statsd
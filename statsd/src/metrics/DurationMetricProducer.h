@@ -66,6 +66,10 @@ public:
         return METRIC_TYPE_DURATION;
     }
 
+    bool supportsCoordinatedRotation() const override {
+        return true;
+    }
+
 protected:
     void onMatchedLogEventLocked(const size_t matcherIndex, const LogEvent& event) override;
 
@@ -114,6 +118,8 @@ private:
 
     void dropDataLocked(const int64_t dropTimeNs) override;
 
+    void trimMemoryLocked() override;
+
     // Util function to flush the old packet.
     void flushIfNeededLocked(int64_t eventTime);
 
@@ -155,6 +161,18 @@ private:
     // The dimension from the atom predicate. e.g., uid, wakelock name.
     vector<Matcher> mInternalDimensions;
 
+    // Cached extraction plan for mInternalDimensions; see FieldExtractionPlan.
+    FieldExtractionPlan mInternalDimensionsPlan;
+
+    // One cached resolution plan per entry of mMetric2ConditionLinks, in the same
+    // order; see ConditionLinkPlan. Used on the per-event start path.
+    std::vector<ConditionLinkPlan> mMetric2ConditionLinkPlans;
+
+    // Running byte size of mPastBuckets. The duration trackers append buckets directly, so
+    // this is refreshed after each bucket flush rather than per append; byteSizeLocked()
+    // is then a constant-time read.
+    size_t mTotalSize = 0;
+
     bool mContainANYPositionInInternalDimensions;
 
     // This boolean is true iff When mInternalDimensions == mDimensionsInWhat
@@ -167,11 +185,18 @@ private:
     std::unordered_map<MetricDimensionKey, std::vector<DurationBucket>> mPastBuckets;
 
     // The duration trackers in the current bucket.
+    // Metric-wide configuration shared by all duration trackers of this metric.
+    std::shared_ptr<DurationTrackerContext> mTrackerContext;
+
     std::unordered_map<HashableDimensionKey, std::unique_ptr<DurationTracker>>
             mCurrentSlicedDurationTrackerMap;
 
     const size_t mDimensionHardLimit;
 
+    // Whether the hard dimension limit already triggered an eviction flush in the current
+    // bucket. Limits the partial-bucket flush in handleStartEvent to once per bucket.
+    bool mHasEvictedIdleDimensionsInBucket = false;
+
     // Helper function to create a duration tracker given the metric aggregation type.
     std::unique_ptr<DurationTracker> createDurationTracker(
             const MetricDimensionKey& eventKey) const;
@@ -188,6 +213,7 @@ private:
 
     FRIEND_TEST(DurationMetricProducerTest, TestSumDurationAppUpgradeSplitDisabled);
     FRIEND_TEST(DurationMetricProducerTest, TestClearCurrentSlicedTrackerMapWhenStop);
+    FRIEND_TEST(DurationMetricProducerTest, TestHardDimensionLimitEvictsIdleTrackers);
     FRIEND_TEST(DurationMetricProducerTest_PartialBucket, TestSumDuration);
     FRIEND_TEST(DurationMetricProducerTest_PartialBucket,
                 TestSumDurationWithSplitInFollowingBucket);
@@ -25,6 +25,7 @@
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "stats_log_util.h"
 #include "stats_util.h"
+#include "utils/ProtoStreamPool.h"
 
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
@@ -139,6 +140,10 @@ void EventMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
 }
 
+void EventMetricProducer::trimMemoryLocked() {
+    shrinkMapIfOverProvisioned(mAggregatedAtoms);
+}
+
 void EventMetricProducer::onSlicedConditionMayChangeLocked(bool overallCondition,
                                                            const int64_t eventTime) {
 }
@@ -174,18 +179,27 @@ void EventMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
     protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
     uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_EVENT_METRICS);
-    for (const auto& [atomDimensionKey, elapsedTimestampsNs] : mAggregatedAtoms) {
+    for (const auto& [atomDimensionKey, aggregated] : mAggregatedAtoms) {
         uint64_t wrapperToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         uint64_t aggregatedToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_AGGREGATED_ATOM);
 
-        uint64_t atomToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM);
-        writeFieldValueTreeToStream(atomDimensionKey.getAtomTag(),
-                                    atomDimensionKey.getAtomFieldValues().getValues(), protoOutput);
-        protoOutput->end(atomToken);
-        for (int64_t timestampNs : elapsedTimestampsNs) {
+        if (aggregated.serializedAtom != nullptr) {
+            // Append the pre-encoded Atom submessage by reference.
+            protoOutput->write(
+                    FIELD_TYPE_MESSAGE | FIELD_ID_ATOM,
+                    reinterpret_cast<const char*>(aggregated.serializedAtom->data()),
+                    aggregated.serializedAtom->size());
+        } else {
+            uint64_t atomToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM);
+            writeFieldValueTreeToStream(atomDimensionKey.getAtomTag(),
+                                        atomDimensionKey.getAtomFieldValues().getValues(),
+                                        protoOutput);
+            protoOutput->end(atomToken);
+        }
+        for (int64_t timestampNs : aggregated.elapsedTimestampsNs) {
             protoOutput->write(FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED | FIELD_ID_ATOM_TIMESTAMPS,
                                (long long)timestampNs);
         }
@@ -220,11 +234,21 @@ void EventMetricProducer::onMatchedLogEventInternalLocked(
     const int64_t elapsedTimeNs = truncateTimestampIfNecessary(event);
     AtomDimensionKey key(event.GetTagId(), HashableDimensionKey(event.getValues()));
 
-    std::vector<int64_t>& aggregatedTimestampsNs = mAggregatedAtoms[key];
-    if (aggregatedTimestampsNs.empty()) {
+    AggregatedAtom& aggregated = mAggregatedAtoms[key];
+    if (aggregated.elapsedTimestampsNs.empty()) {
+        // Encode the atom once per distinct key. If a producer in another config already
+        // encoded this event, reuse its buffer; otherwise encode and share it.
+        aggregated.serializedAtom = event.getCachedSerializedAtom();
+        if (aggregated.serializedAtom == nullptr) {
+            PooledProtoStream atomProto = ProtoStreamPool::getInstance().borrow();
+            writeFieldValueTreeToStream(key.getAtomTag(), key.getAtomFieldValues().getValues(),
+                                        atomProto.get());
+            aggregated.serializedAtom = serializeProtoLocked(*atomProto);
+            event.cacheSerializedAtom(aggregated.serializedAtom);
+        }
         mTotalSize += getSize(key.getAtomFieldValues().getValues());
     }
-    aggregatedTimestampsNs.push_back(elapsedTimeNs);
+    aggregated.elapsedTimestampsNs.push_back(elapsedTimeNs);
     mTotalSize += sizeof(int64_t); // Add the size of the event timestamp
 }
 
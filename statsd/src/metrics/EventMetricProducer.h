@@ -17,6 +17,7 @@
 #ifndef EVENT_METRIC_PRODUCER_H
 #define EVENT_METRIC_PRODUCER_H
 
+#include <memory>
 #include <unordered_map>
 
 #include <android/util/ProtoOutputStream.h>
@@ -91,13 +92,23 @@ private:
 
     void dropDataLocked(const int64_t dropTimeNs) override;
 
+    void trimMemoryLocked() override;
+
     // Internal function to calculate the current used bytes.
     size_t byteSizeLocked() const override;
 
     void dumpStatesLocked(int out, bool verbose) const override{};
 
     // Maps the field/value pairs of an atom to a list of timestamps used to deduplicate atoms.
-    std::unordered_map<AtomDimensionKey, std::vector<int64_t>> mAggregatedAtoms;
+    struct AggregatedAtom {
+        // Atom submessage encoded once when the key is first seen; shared through the
+        // LogEvent so producers in other configs append the same buffer instead of
+        // re-encoding it at dump time.
+        std::shared_ptr<const std::vector<uint8_t>> serializedAtom;
+        std::vector<int64_t> elapsedTimestampsNs;
+    };
+
+    std::unordered_map<AtomDimensionKey, AggregatedAtom> mAggregatedAtoms;
 
     const int mSamplingPercentage;
 };
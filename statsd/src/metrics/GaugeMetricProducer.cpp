@@ -20,8 +20,10 @@
 #include "GaugeMetricProducer.h"
 
 #include "guardrail/StatsdStats.h"
+#include "hash.h"
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "stats_log_util.h"
+#include "utils/ShardOffsetProvider.h"
 
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
@@ -50,6 +52,7 @@ const int FIELD_ID_BUCKET_SIZE = 10;
 const int FIELD_ID_DIMENSION_PATH_IN_WHAT = 11;
 const int FIELD_ID_IS_ACTIVE = 14;
 const int FIELD_ID_DIMENSION_GUARDRAIL_HIT = 17;
+const int FIELD_ID_DELTA_REPORT = 18;
 // for GaugeMetricDataWrapper
 const int FIELD_ID_DATA = 1;
 const int FIELD_ID_SKIPPED = 2;
@@ -97,11 +100,13 @@ GaugeMetricProducer::GaugeMetricProducer(
       mSamplingType(metric.sampling_type()),
       mMaxPullDelayNs(metric.max_pull_delay_sec() > 0 ? metric.max_pull_delay_sec() * NS_PER_SEC
                                                       : StatsdStats::kPullMaxDelayNs),
+      mPullStalenessToleranceNs(metric.pull_staleness_tolerance_millis() * 1000000),
       mDimensionSoftLimit(dimensionSoftLimit),
       mDimensionHardLimit(dimensionHardLimit),
       mGaugeAtomsPerDimensionLimit(metric.max_num_gauge_atoms_per_bucket()),
       mDimensionGuardrailHit(false),
-      mSamplingPercentage(metric.sampling_percentage()) {
+      mSamplingPercentage(metric.sampling_percentage()),
+      mReportChangedSlicesOnly(metric.report_changed_slices_only()) {
     mCurrentSlicedBucket = std::make_shared<DimToGaugeAtomsMap>();
     mCurrentSlicedBucketForAnomaly = std::make_shared<DimToValMap>();
     int64_t bucketSizeMills = 0;
@@ -240,6 +245,7 @@ void GaugeMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     flushIfNeededLocked(dumpTimeNs);
     mPastBuckets.clear();
     mSkippedBuckets.clear();
+    mTotalSize = 0;
 }
 
 void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
@@ -259,9 +265,30 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
 
     if (mPastBuckets.empty() && mSkippedBuckets.empty()) {
+        if (mReportChangedSlicesOnly && erase_data) {
+            // An empty report is complete by definition. Force the next report to
+            // be a full one so a consumer that dropped its per-slice state on the
+            // empty report converges again.
+            mLastReportedSliceHashes.clear();
+            mDumpsSinceFullReport = kDeltaReportResyncPeriodDumps;
+        }
         return;
     }
 
+    bool deltaReport = false;
+    if (mReportChangedSlicesOnly && erase_data) {
+        deltaReport = mDumpsSinceFullReport < kDeltaReportResyncPeriodDumps;
+        if (deltaReport) {
+            mDumpsSinceFullReport++;
+            protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_DELTA_REPORT, true);
+        } else {
+            // Periodic resync: report every slice and forget the per-slice hashes
+            // so slices that stopped reporting do not pin memory.
+            mLastReportedSliceHashes.clear();
+            mDumpsSinceFullReport = 1;
+        }
+    }
+
     if (mDimensionGuardrailHit) {
         protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_DIMENSION_GUARDRAIL_HIT,
                            mDimensionGuardrailHit);
@@ -303,6 +330,18 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     for (const auto& pair : mPastBuckets) {
         const MetricDimensionKey& dimensionKey = pair.first;
 
+        if (mReportChangedSlicesOnly && erase_data) {
+            const uint64_t sliceHash = computeSliceContentHash(pair.second);
+            if (deltaReport) {
+                const auto hashIt = mLastReportedSliceHashes.find(dimensionKey);
+                if (hashIt != mLastReportedSliceHashes.end() && hashIt->second == sliceHash) {
+                    // Same readings as the last report; the consumer keeps its copy.
+                    continue;
+                }
+            }
+            mLastReportedSliceHashes[dimensionKey] = sliceHash;
+        }
+
         VLOG("Gauge dimension key %s", dimensionKey.toString().c_str());
         uint64_t wrapperToken =
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
@@ -367,9 +406,26 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
         mPastBuckets.clear();
         mSkippedBuckets.clear();
         mDimensionGuardrailHit = false;
+        mTotalSize = 0;
     }
 }
 
+uint64_t GaugeMetricProducer::computeSliceContentHash(const std::vector<GaugeBucket>& buckets) {
+    // XOR within a bucket so the unordered aggregated-atom iteration order does
+    // not matter; mix across buckets so the sequence of readings does. Bucket
+    // boundaries and atom timestamps are deliberately excluded: a stable gauge
+    // must hash equal across reports even though its timestamps differ.
+    uint64_t hash = buckets.size();
+    for (const GaugeBucket& bucket : buckets) {
+        uint64_t bucketHash = bucket.mAggregatedAtoms.size();
+        for (const auto& [atomKey, elapsedTimestampsNs] : bucket.mAggregatedAtoms) {
+            bucketHash ^= atomKey.getAtomFieldValues().getHash();
+        }
+        hash = hash * 1000003ULL ^ bucketHash;
+    }
+    return hash;
+}
+
 void GaugeMetricProducer::prepareFirstBucketLocked() {
     if (mCondition == ConditionState::kTrue && mIsActive && mIsPulled && isRandomNSamples()) {
         pullAndMatchEventsLocked(mCurrentBucketStartTimeNs);
@@ -387,7 +443,8 @@ void GaugeMetricProducer::pullAndMatchEventsLocked(const int64_t timestampNs) {
             break;
         }
         case GaugeMetric::CONDITION_CHANGE_TO_TRUE:
-        case GaugeMetric::FIRST_N_SAMPLES: {
+        case GaugeMetric::FIRST_N_SAMPLES:
+        case GaugeMetric::RANDOM_N_SAMPLES: {
             triggerPuller = true;
             break;
         }
@@ -398,7 +455,12 @@ void GaugeMetricProducer::pullAndMatchEventsLocked(const int64_t timestampNs) {
         return;
     }
     vector<std::shared_ptr<LogEvent>> allData;
-    if (!mPullerManager->Pull(mPullTagId, mConfigKey, timestampNs, &allData)) {
+    const bool pullSuccess =
+            mPullStalenessToleranceNs > 0
+                    ? mPullerManager->Pull(mPullTagId, mConfigKey, timestampNs, &allData,
+                                           mPullStalenessToleranceNs)
+                    : mPullerManager->Pull(mPullTagId, mConfigKey, timestampNs, &allData);
+    if (!pullSuccess) {
         ALOGE("Gauge Stats puller failed for tag: %d at %lld", mPullTagId, (long long)timestampNs);
         return;
     }
@@ -409,14 +471,24 @@ void GaugeMetricProducer::pullAndMatchEventsLocked(const int64_t timestampNs) {
         StatsdStats::getInstance().notePullExceedMaxDelay(mPullTagId);
         return;
     }
+    const bool matchesAllRows = mEventMatcherWizard->matchesTrivially(mWhatMatcherIndex, mPullTagId);
     for (const auto& data : allData) {
-        const auto [matchResult, transformedEvent] =
-                mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex);
-        if (matchResult == MatchingState::kMatched) {
-            LogEvent localCopy = transformedEvent == nullptr ? *data : *transformedEvent;
-            localCopy.setElapsedTimestampNs(timestampNs);
-            onMatchedLogEventLocked(mWhatMatcherIndex, localCopy);
+        shared_ptr<LogEvent> transformedEvent;
+        if (matchesAllRows) {
+            if (data->GetTagId() != mPullTagId) {
+                continue;
+            }
+        } else {
+            auto [matchResult, matchedTransformedEvent] =
+                    mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex);
+            if (matchResult != MatchingState::kMatched) {
+                continue;
+            }
+            transformedEvent = std::move(matchedTransformedEvent);
         }
+        LogEvent localCopy = transformedEvent == nullptr ? *data : *transformedEvent;
+        localCopy.setElapsedTimestampNs(timestampNs);
+        onMatchedLogEventLocked(mWhatMatcherIndex, localCopy);
     }
 }
 
@@ -466,26 +538,63 @@ void GaugeMetricProducer::onSlicedConditionMayChangeLocked(bool overallCondition
     }  // else: Push mode. No need to proactively pull the gauge data.
 }
 
-std::shared_ptr<vector<FieldValue>> GaugeMetricProducer::getGaugeFields(const LogEvent& event) {
-    std::shared_ptr<vector<FieldValue>> gaugeFields;
+void GaugeMetricProducer::rebuildGatherPlan(const LogEvent& event) {
+    const vector<FieldValue>& values = event.getValues();
+    mGatherPlan.tagId = event.GetTagId();
+    mGatherPlan.fieldLayout.clear();
+    mGatherPlan.fieldLayout.reserve(values.size());
+    for (const FieldValue& value : values) {
+        mGatherPlan.fieldLayout.push_back(value.mField.getField());
+    }
+    // Same selection as the generic path: allowlist matches in matcher-major
+    // order (everything when the allowlist is empty), minus dimension fields.
+    mGatherPlan.gatherIndices.clear();
     if (mFieldMatchers.size() > 0) {
-        gaugeFields = std::make_shared<vector<FieldValue>>();
-        filterGaugeValues(mFieldMatchers, event.getValues(), gaugeFields.get());
+        for (const Matcher& matcher : mFieldMatchers) {
+            for (size_t i = 0; i < values.size(); i++) {
+                if (values[i].mField.matches(matcher)) {
+                    mGatherPlan.gatherIndices.push_back(i);
+                }
+            }
+        }
     } else {
-        gaugeFields = std::make_shared<vector<FieldValue>>(event.getValues());
+        for (size_t i = 0; i < values.size(); i++) {
+            mGatherPlan.gatherIndices.push_back(i);
+        }
     }
     // Trim all dimension fields from output. Dimensions will appear in output report and will
     // benefit from dictionary encoding. For large pulled atoms, this can give the benefit of
     // optional repeated field.
-    for (const auto& field : mDimensionsInWhat) {
-        for (auto it = gaugeFields->begin(); it != gaugeFields->end();) {
-            if (it->mField.matches(field)) {
-                it = gaugeFields->erase(it);
+    for (const Matcher& dimension : mDimensionsInWhat) {
+        for (auto it = mGatherPlan.gatherIndices.begin(); it != mGatherPlan.gatherIndices.end();) {
+            if (values[*it].mField.matches(dimension)) {
+                it = mGatherPlan.gatherIndices.erase(it);
             } else {
                 it++;
             }
         }
     }
+    mGatherPlan.valid = true;
+}
+
+std::shared_ptr<vector<FieldValue>> GaugeMetricProducer::getGaugeFields(const LogEvent& event) {
+    // Matching depends only on the field ids, so a row with the same flat
+    // layout as the plan's reference row selects exactly the same positions
+    // and the cached indices can be replayed as a straight gather.
+    const vector<FieldValue>& values = event.getValues();
+    bool planApplies = mGatherPlan.valid && mGatherPlan.tagId == event.GetTagId() &&
+                       mGatherPlan.fieldLayout.size() == values.size();
+    for (size_t i = 0; planApplies && i < values.size(); i++) {
+        planApplies = mGatherPlan.fieldLayout[i] == values[i].mField.getField();
+    }
+    if (!planApplies) {
+        rebuildGatherPlan(event);
+    }
+    auto gaugeFields = std::make_shared<vector<FieldValue>>();
+    gaugeFields->reserve(mGatherPlan.gatherIndices.size());
+    for (const int32_t index : mGatherPlan.gatherIndices) {
+        gaugeFields->push_back(values[index]);
+    }
     return gaugeFields;
 }
 
@@ -502,7 +611,16 @@ void GaugeMetricProducer::onDataPulled(const std::vector<std::shared_ptr<LogEven
         StatsdStats::getInstance().notePullExceedMaxDelay(mPullTagId);
         return;
     }
+    // All rows of a pull carry the same atom id, so when the what matcher imposes
+    // no field constraints the per-row matcher dispatch is skipped for the batch.
+    const bool matchesAllRows = mEventMatcherWizard->matchesTrivially(mWhatMatcherIndex, mPullTagId);
     for (const auto& data : allData) {
+        if (matchesAllRows) {
+            if (data->GetTagId() == mPullTagId) {
+                onMatchedLogEventLocked(mWhatMatcherIndex, *data);
+            }
+            continue;
+        }
         const auto [matchResult, transformedEvent] =
                 mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex);
         if (matchResult == MatchingState::kMatched) {
@@ -574,13 +692,37 @@ void GaugeMetricProducer::onMatchedLogEventInternalLocked(
     if (hitGuardRailLocked(eventKey)) {
         return;
     }
-    if ((*mCurrentSlicedBucket)[eventKey].size() >= mGaugeAtomsPerDimensionLimit) {
-        return;
+    std::vector<GaugeAtom>& gaugeAtoms = (*mCurrentSlicedBucket)[eventKey];
+    std::optional<size_t> replaceIndex;
+    if (gaugeAtoms.size() >= mGaugeAtomsPerDimensionLimit) {
+        if (mSamplingType != GaugeMetric::RANDOM_N_SAMPLES) {
+            return;
+        }
+        // Reservoir sampling: the nth atom of the bucket replaces a stored one with
+        // probability limit/n, keeping the stored atoms a uniform sample of the whole
+        // bucket. The slot is derived from the shard offset so the selection is
+        // consistent across devices in the same shard.
+        const int64_t numAtomsSeen = ++mCurrentBucketAtomsSeen[eventKey];
+        const uint32_t seed[3] = {ShardOffsetProvider::getInstance().getShardOffset(),
+                                  static_cast<uint32_t>(mMetricId),
+                                  static_cast<uint32_t>(numAtomsSeen)};
+        const size_t index =
+                Hash32(reinterpret_cast<const char*>(seed), sizeof(seed)) % numAtomsSeen;
+        if (index >= mGaugeAtomsPerDimensionLimit) {
+            return;
+        }
+        replaceIndex = index;
+    } else if (mSamplingType == GaugeMetric::RANDOM_N_SAMPLES) {
+        mCurrentBucketAtomsSeen[eventKey]++;
     }
 
     const int64_t truncatedElapsedTimestampNs = truncateTimestampIfNecessary(event);
     GaugeAtom gaugeAtom(getGaugeFields(event), truncatedElapsedTimestampNs);
-    (*mCurrentSlicedBucket)[eventKey].push_back(gaugeAtom);
+    if (replaceIndex.has_value()) {
+        gaugeAtoms[replaceIndex.value()] = gaugeAtom;
+    } else {
+        gaugeAtoms.push_back(gaugeAtom);
+    }
     // Anomaly detection on gauge metric only works when there is one numeric
     // field specified.
     if (mAnomalyTrackers.size() > 0) {
@@ -620,6 +762,7 @@ void GaugeMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
     mPastBuckets.clear();
+    mTotalSize = 0;
 }
 
 // When a new matched event comes in, we check if event falls into the current
@@ -668,6 +811,11 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
             }
             auto& bucketList = mPastBuckets[slice.first];
             bucketList.push_back(info);
+            for (const auto& [atomDimensionKey, elapsedTimestampsNs] : info.mAggregatedAtoms) {
+                mTotalSize += sizeof(FieldValue) *
+                              atomDimensionKey.getAtomFieldValues().getValues().size();
+                mTotalSize += sizeof(int64_t) * elapsedTimestampsNs.size();
+            }
             VLOG("Gauge gauge metric %lld, dump key value: %s", (long long)mMetricId,
                  slice.first.toString().c_str());
         }
@@ -696,6 +844,7 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
 
     StatsdStats::getInstance().noteBucketCount(mMetricId);
     mCurrentSlicedBucket = std::make_shared<DimToGaugeAtomsMap>();
+    mCurrentBucketAtomsSeen.clear();
     mCurrentBucketStartTimeNs = nextBucketStartTimeNs;
     mCurrentSkippedBucket.reset();
     // Reset mHasHitGuardrail boolean since bucket was reset
@@ -703,17 +852,7 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
 }
 
 size_t GaugeMetricProducer::byteSizeLocked() const {
-    size_t totalSize = 0;
-    for (const auto& pair : mPastBuckets) {
-        for (const auto& bucket : pair.second) {
-            for (const auto& [atomDimensionKey, elapsedTimestampsNs] : bucket.mAggregatedAtoms) {
-                totalSize += sizeof(FieldValue) *
-                             atomDimensionKey.getAtomFieldValues().getValues().size();
-                totalSize += sizeof(int64_t) * elapsedTimestampsNs.size();
-            }
-        }
-    }
-    return totalSize;
+    return mTotalSize;
 }
 
 }  // namespace statsd
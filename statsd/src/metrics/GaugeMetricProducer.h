@@ -106,6 +106,12 @@ public:
         return METRIC_TYPE_GAUGE;
     }
 
+    // Pushed gauges rotate like count metrics; pulled ones pull at the bucket
+    // boundary, so they stay on their own flush path.
+    bool supportsCoordinatedRotation() const override {
+        return !mIsPulled;
+    }
+
 protected:
     void onMatchedLogEventInternalLocked(
             const size_t matcherIndex, const MetricDimensionKey& eventKey,
@@ -164,7 +170,8 @@ private:
             std::vector<int>& metricsWithActivation) override;
 
     inline bool isRandomNSamples() const {
-        return (mTriggerAtomId == -1 && mSamplingType == GaugeMetric::FIRST_N_SAMPLES) ||
+        return (mTriggerAtomId == -1 && (mSamplingType == GaugeMetric::FIRST_N_SAMPLES ||
+                                         mSamplingType == GaugeMetric::RANDOM_N_SAMPLES)) ||
                mSamplingType == GaugeMetric::RANDOM_ONE_SAMPLE;
     }
 
@@ -188,9 +195,17 @@ private:
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
     std::unordered_map<MetricDimensionKey, std::vector<GaugeBucket>> mPastBuckets;
 
+    // Running byte size of mPastBuckets, maintained where buckets are appended or cleared so
+    // that byteSizeLocked() is a constant-time read.
+    size_t mTotalSize = 0;
+
     // The current partial bucket.
     std::shared_ptr<DimToGaugeAtomsMap> mCurrentSlicedBucket;
 
+    // Number of atoms seen per dimension in the current bucket, including ones not stored.
+    // Only maintained for RANDOM_N_SAMPLES, where it drives the reservoir selection.
+    std::unordered_map<MetricDimensionKey, int64_t> mCurrentBucketAtomsSeen;
+
     // The current full bucket for anomaly detection. This is updated to the latest value seen for
     // this slice (ie, for partial buckets, we use the last partial bucket in this full bucket).
     std::shared_ptr<DimToValMap> mCurrentSlicedBucketForAnomaly;
@@ -208,9 +223,32 @@ private:
 
     const int64_t mMaxPullDelayNs;
 
+    // If positive, pulls for this metric may be served from a cached snapshot
+    // up to this old instead of hitting the puller.
+    const int64_t mPullStalenessToleranceNs;
+
     // apply an allowlist on the original input
     std::shared_ptr<vector<FieldValue>> getGaugeFields(const LogEvent& event);
 
+    // Index gather plan for the gauge snapshot. Rows of one pull share the
+    // atom layout, so the positions selected by the allowlist plus dimension
+    // trim are resolved once and replayed as a straight index copy per row,
+    // instead of re-running mask matching and the trim erase loop on every
+    // row of a 3000-row pull. A row whose flat field layout differs from the
+    // plan's (repeated fields changing cardinality) rebuilds the plan from
+    // that row, so the output always matches the generic path.
+    struct GaugeFieldGatherPlan {
+        int32_t tagId = 0;
+        // Flat field ids of the row the plan was built from.
+        std::vector<int32_t> fieldLayout;
+        // Indices of the values to copy, in output order.
+        std::vector<int32_t> gatherIndices;
+        bool valid = false;
+    };
+    GaugeFieldGatherPlan mGatherPlan;
+
+    void rebuildGatherPlan(const LogEvent& event);
+
     // Util function to check whether the specified dimension hits the guardrail.
     bool hitGuardRailLocked(const MetricDimensionKey& newKey);
 
@@ -227,6 +265,27 @@ private:
 
     const int mSamplingPercentage;
 
+    // Whether data-erasing reports may omit slices whose gauge values did not
+    // change since the previous report (GaugeMetric.report_changed_slices_only).
+    const bool mReportChangedSlicesOnly;
+
+    // Every this many delta reports, a full report is emitted so consumers
+    // that missed a report converge back to the complete state.
+    static constexpr int32_t kDeltaReportResyncPeriodDumps = 10;
+
+    // Data-erasing dumps since the last full report. Starts at the resync
+    // period so the first report is always a full one.
+    int32_t mDumpsSinceFullReport = kDeltaReportResyncPeriodDumps;
+
+    // Per-slice hash of the gauge values carried by the last data-erasing report.
+    // A slice whose hash is unchanged is skipped in delta reports. Cleared on
+    // every full report so slices that stopped reporting do not pin memory.
+    std::unordered_map<MetricDimensionKey, uint64_t> mLastReportedSliceHashes;
+
+    // Hashes the gauge values (not bucket boundaries or timestamps) of a
+    // slice's past buckets, so stable readings hash equal across reports.
+    static uint64_t computeSliceContentHash(const std::vector<GaugeBucket>& buckets);
+
     FRIEND_TEST(GaugeMetricProducerTest, TestPulledEventsWithCondition);
     FRIEND_TEST(GaugeMetricProducerTest, TestPulledEventsWithSlicedCondition);
     FRIEND_TEST(GaugeMetricProducerTest, TestPulledEventsNoCondition);
@@ -235,8 +294,10 @@ private:
     FRIEND_TEST(GaugeMetricProducerTest, TestFirstBucket);
     FRIEND_TEST(GaugeMetricProducerTest, TestPullOnTrigger);
     FRIEND_TEST(GaugeMetricProducerTest, TestPullNWithoutTrigger);
+    FRIEND_TEST(GaugeMetricProducerTest, TestPullRandomNSamples);
     FRIEND_TEST(GaugeMetricProducerTest, TestRemoveDimensionInOutput);
     FRIEND_TEST(GaugeMetricProducerTest, TestPullDimensionalSampling);
+    FRIEND_TEST(GaugeMetricProducerTest, TestReportChangedSlicesOnly);
 
     FRIEND_TEST(GaugeMetricProducerTest_PartialBucket, TestPushedEvents);
     FRIEND_TEST(GaugeMetricProducerTest_PartialBucket, TestPulled);
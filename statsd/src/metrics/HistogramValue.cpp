@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HistogramValue.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+BinStarts generateLinearBins(float min, float max, int count) {
+    BinStarts bins(count + 1);
+    const float width = (max - min) / count;
+    for (int i = 0; i < count; i++) {
+        bins[i] = min + i * width;
+    }
+    // Set the last boundary explicitly so it is exactly max rather than the
+    // accumulated rounding of min + count * width.
+    bins[count] = max;
+    return bins;
+}
+
+BinStarts generateExponentialBins(float min, float max, int count) {
+    BinStarts bins(count + 1);
+    const float ratio = std::pow(max / min, 1.0f / count);
+    float boundary = min;
+    for (int i = 0; i < count; i++) {
+        bins[i] = boundary;
+        boundary *= ratio;
+    }
+    bins[count] = max;
+    return bins;
+}
+
+void HistogramValue::addValue(float value, const BinStarts& binStarts) {
+    if (mBinCounts.empty()) {
+        mBinCounts.resize(binStarts.size() + 1, 0);
+    }
+    // The bin index is the number of boundaries <= value: 0 is the underflow
+    // bin and binStarts.size() the overflow bin.
+    const size_t index =
+            std::upper_bound(binStarts.begin(), binStarts.end(), value) - binStarts.begin();
+    mBinCounts[index]++;
+}
+
+std::vector<int32_t> HistogramValue::getCompactedBinCounts() const {
+    std::vector<int32_t> compacted;
+    compacted.reserve(mBinCounts.size());
+    int32_t zeroRun = 0;
+    for (const int32_t count : mBinCounts) {
+        if (count == 0) {
+            zeroRun++;
+            continue;
+        }
+        if (zeroRun > 0) {
+            compacted.push_back(-zeroRun);
+            zeroRun = 0;
+        }
+        compacted.push_back(count);
+    }
+    // A trailing run of empty bins is dropped: the reader knows the bin count
+    // from the config and treats missing entries as empty.
+    return compacted;
+}
+
+bool HistogramValue::isEmpty() const {
+    return std::all_of(mBinCounts.begin(), mBinCounts.end(),
+                       [](const int32_t count) { return count == 0; });
+}
+
+size_t HistogramValue::getSize() const {
+    return mBinCounts.capacity() * sizeof(int32_t);
+}
+
+std::string HistogramValue::toString() const {
+    std::string result = "{";
+    for (size_t i = 0; i < mBinCounts.size(); i++) {
+        if (i > 0) {
+            result += ", ";
+        }
+        result += std::to_string(mBinCounts[i]);
+    }
+    return result + "}";
+}
+
+bool HistogramValue::operator==(const HistogramValue& other) const {
+    return mBinCounts == other.mBinCounts;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Boundaries of the finite bins of one histogram value field, strictly increasing.
+// An implicit underflow bin precedes the first boundary and an implicit overflow
+// bin follows the last one, so size() boundaries describe size() + 1 bins.
+using BinStarts = std::vector<float>;
+
+// Returns count + 1 boundaries splitting [min, max) into count equal-width bins.
+BinStarts generateLinearBins(float min, float max, int count);
+
+// Returns count + 1 boundaries splitting [min, max) into count bins whose widths
+// grow by a constant ratio. Requires min > 0.
+BinStarts generateExponentialBins(float min, float max, int count);
+
+// Fixed-bin histogram aggregate for one value field of a ValueMetric with
+// HISTOGRAM aggregation. Only the counts live here; the bin boundaries are
+// per-metric and owned by the producer, so a sliced metric pays for one copy
+// of the boundaries regardless of its dimension cardinality.
+class HistogramValue {
+public:
+    HistogramValue() = default;
+
+    // Counts value into the bin selected by binStarts. The counts array is
+    // lazily sized on first use so empty intervals stay allocation-free.
+    void addValue(float value, const BinStarts& binStarts);
+
+    // Bin counts in upload form: runs of consecutive empty bins are collapsed
+    // into a single negative entry holding the run length, and trailing empty
+    // bins are dropped entirely. See HistogramValue in stats_log.proto.
+    std::vector<int32_t> getCompactedBinCounts() const;
+
+    bool isEmpty() const;
+
+    // Heap bytes held by the counts array, for metric byte-size accounting.
+    size_t getSize() const;
+
+    std::string toString() const;
+
+    bool operator==(const HistogramValue& other) const;
+
+private:
+    std::vector<int32_t> mBinCounts;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "HistogramValueMetricProducer.h"
+
+#include "guardrail/StatsdStats.h"
+#include "stats_log_util.h"
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_INT32;
+using android::util::FIELD_TYPE_MESSAGE;
+using android::util::FIELD_TYPE_SINT32;
+using android::util::ProtoOutputStream;
+using std::nullopt;
+using std::optional;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// for StatsLogReport
+const int FIELD_ID_VALUE_METRICS = 7;
+// for ValueBucketInfo
+const int FIELD_ID_VALUE_INDEX = 1;
+const int FIELD_ID_VALUE_SAMPLESIZE = 4;
+const int FIELD_ID_VALUE_HISTOGRAM = 5;
+const int FIELD_ID_VALUES = 9;
+const int FIELD_ID_BUCKET_NUM = 4;
+const int FIELD_ID_START_BUCKET_ELAPSED_MILLIS = 5;
+const int FIELD_ID_END_BUCKET_ELAPSED_MILLIS = 6;
+const int FIELD_ID_CONDITION_TRUE_NS = 10;
+// for HistogramValue
+const int FIELD_ID_HISTOGRAM_COUNT = 1;
+
+HistogramValueMetricProducer::HistogramValueMetricProducer(
+        const ConfigKey& key, const ValueMetric& metric, const uint64_t protoHash,
+        vector<BinStarts> binStartsList, const PullOptions& pullOptions,
+        const BucketOptions& bucketOptions, const WhatOptions& whatOptions,
+        const ConditionOptions& conditionOptions, const StateOptions& stateOptions,
+        const ActivationOptions& activationOptions, const GuardrailOptions& guardrailOptions)
+    : ValueMetricProducer(metric.id(), key, protoHash, pullOptions, bucketOptions, whatOptions,
+                          conditionOptions, stateOptions, activationOptions, guardrailOptions),
+      mIncludeSampleSize(metric.include_sample_size()),
+      mBinStartsList(std::move(binStartsList)) {
+}
+
+HistogramValueMetricProducer::DumpProtoFields HistogramValueMetricProducer::getDumpProtoFields()
+        const {
+    return {FIELD_ID_VALUE_METRICS,
+            FIELD_ID_BUCKET_NUM,
+            FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+            FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+            FIELD_ID_CONDITION_TRUE_NS,
+            /*conditionCorrectionNsFieldId=*/nullopt};
+}
+
+void HistogramValueMetricProducer::writePastBucketAggregateToProto(
+        const int aggIndex, const HistogramValue& histogram, const int sampleSize,
+        ProtoOutputStream* const protoOutput) const {
+    uint64_t valueToken =
+            protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_VALUES);
+    protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_VALUE_INDEX, aggIndex);
+    if (mIncludeSampleSize) {
+        protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_VALUE_SAMPLESIZE, sampleSize);
+    }
+    uint64_t histogramToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_VALUE_HISTOGRAM);
+    for (const int32_t count : histogram.getCompactedBinCounts()) {
+        protoOutput->write(FIELD_TYPE_SINT32 | FIELD_COUNT_REPEATED | FIELD_ID_HISTOGRAM_COUNT,
+                           count);
+    }
+    protoOutput->end(histogramToken);
+    VLOG("\t\t histogram %d: %s", aggIndex, histogram.toString().c_str());
+    protoOutput->end(valueToken);
+}
+
+optional<float> getFloatValue(const FieldValue& fieldValue) {
+    switch (fieldValue.mValue.type) {
+        case INT:
+            return {(float)fieldValue.mValue.int_value};
+        case LONG:
+            return {(float)fieldValue.mValue.long_value};
+        case FLOAT:
+            return {fieldValue.mValue.float_value};
+        default:
+            return nullopt;
+    }
+}
+
+bool HistogramValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
+                                                   const MetricDimensionKey& eventKey,
+                                                   const LogEvent& event,
+                                                   vector<Interval>& intervals, Empty& empty) {
+    bool seenNewData = false;
+    // Resolve every value field to its index once per event; see ValueIndexPlan.
+    const vector<FieldValue>& values = event.getValues();
+    mFieldMatchersIndexPlan.resolve(values, mScratchValueIndices);
+    for (size_t i = 0; i < mFieldMatchers.size(); i++) {
+        Interval& interval = intervals[i];
+        interval.aggIndex = i;
+        const int32_t valueIndex = mScratchValueIndices[i];
+        const optional<float> valueOpt =
+                valueIndex < 0 ? nullopt : getFloatValue(values[valueIndex]);
+        if (!valueOpt) {
+            VLOG("Failed to get value %zu from event %s", i, event.ToString().c_str());
+            StatsdStats::getInstance().noteBadValueType(mMetricId);
+            return seenNewData;
+        }
+
+        seenNewData = true;
+        interval.aggregate.addValue(valueOpt.value(), mBinStartsList[i]);
+        interval.sampleSize += 1;
+    }
+    return seenNewData;
+}
+
+PastBucket<HistogramValue> HistogramValueMetricProducer::buildPartialBucket(
+        int64_t bucketEndTimeNs, vector<Interval>& intervals) {
+    PastBucket<HistogramValue> bucket;
+    bucket.mBucketStartNs = mCurrentBucketStartTimeNs;
+    bucket.mBucketEndNs = bucketEndTimeNs;
+    for (Interval& interval : intervals) {
+        if (interval.hasValue()) {
+            bucket.aggIndex.push_back(interval.aggIndex);
+            // Transfer ownership of the counts array from interval.aggregate to the
+            // bucket.aggregates vector; interval.aggregate is left empty.
+            bucket.aggregates.push_back(std::move(interval.aggregate));
+            interval.aggregate = HistogramValue();
+            if (mIncludeSampleSize) {
+                bucket.sampleSizes.push_back(interval.sampleSize);
+            }
+        }
+    }
+    return bucket;
+}
+
+size_t HistogramValueMetricProducer::computePastBucketSizeLocked(
+        const PastBucket<HistogramValue>& bucket) const {
+    size_t totalSize = kBucketSize;
+    static const size_t kIntSize = sizeof(int);
+    totalSize += bucket.aggIndex.size() * kIntSize;
+    if (!bucket.sampleSizes.empty()) {
+        totalSize += bucket.sampleSizes.size() * kIntSize;
+    }
+    for (const HistogramValue& aggregate : bucket.aggregates) {
+        totalSize += aggregate.getSize();
+    }
+    return totalSize;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+#include <gtest/gtest_prod.h>
+
+#include "HistogramValue.h"
+#include "ValueMetricProducer.h"
+#include "src/statsd_config.pb.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Aggregates values into config-declared fixed-bin histograms within buckets.
+// Selected for ValueMetrics with HISTOGRAM aggregation; reports land in the
+// value_metrics report section like every other ValueMetric. Compared to
+// slicing a CountMetric by bucketed value, the per-dimension cost is one flat
+// counts array instead of a HashableDimensionKey per bin.
+//
+// Only pushed atoms are supported: histograms aggregate individual samples, so
+// there is no meaningful diff between two pulled snapshots.
+class HistogramValueMetricProducer : public ValueMetricProducer<HistogramValue, Empty> {
+public:
+    HistogramValueMetricProducer(const ConfigKey& key, const ValueMetric& valueMetric,
+                                 const uint64_t protoHash,
+                                 std::vector<BinStarts> binStartsList,
+                                 const PullOptions& pullOptions,
+                                 const BucketOptions& bucketOptions,
+                                 const WhatOptions& whatOptions,
+                                 const ConditionOptions& conditionOptions,
+                                 const StateOptions& stateOptions,
+                                 const ActivationOptions& activationOptions,
+                                 const GuardrailOptions& guardrailOptions);
+
+    inline MetricType getMetricType() const override {
+        return METRIC_TYPE_VALUE;
+    }
+
+protected:
+private:
+    inline optional<int64_t> getConditionIdForMetric(const StatsdConfig& config,
+                                                     const int configIndex) const override {
+        const ValueMetric& metric = config.value_metric(configIndex);
+        return metric.has_condition() ? make_optional(metric.condition()) : nullopt;
+    }
+
+    inline int64_t getWhatAtomMatcherIdForMetric(const StatsdConfig& config,
+                                                 const int configIndex) const override {
+        return config.value_metric(configIndex).what();
+    }
+
+    inline ConditionLinks getConditionLinksForMetric(const StatsdConfig& config,
+                                                     const int configIndex) const override {
+        return config.value_metric(configIndex).links();
+    }
+
+    // Determine whether or not a LogEvent can be skipped.
+    inline bool canSkipLogEventLocked(
+            const MetricDimensionKey& eventKey, bool condition, int64_t eventTimeNs,
+            const std::map<int, HashableDimensionKey>& statePrimaryKeys) const override {
+        // Can only skip if the condition is false; histogram metrics are pushed only.
+        return !condition;
+    }
+
+    DumpProtoFields getDumpProtoFields() const override;
+
+    inline std::string aggregatedValueToString(const HistogramValue& histogram) const override {
+        return histogram.toString();
+    }
+
+    inline bool multipleBucketsSkipped(const int64_t numBucketsForward) const override {
+        // Always false because histogram metrics are pushed only.
+        return false;
+    }
+
+    // Histogram counts ownership is transferred to newly created PastBuckets from Intervals.
+    PastBucket<HistogramValue> buildPartialBucket(int64_t bucketEndTime,
+                                                  std::vector<Interval>& intervals) override;
+
+    void writePastBucketAggregateToProto(const int aggIndex, const HistogramValue& histogram,
+                                         const int sampleSize,
+                                         ProtoOutputStream* const protoOutput) const override;
+
+    bool aggregateFields(const int64_t eventTimeNs, const MetricDimensionKey& eventKey,
+                         const LogEvent& event, std::vector<Interval>& intervals,
+                         Empty& empty) override;
+
+    // Bytes contributed by a past bucket, including the histogram counts arrays.
+    size_t computePastBucketSizeLocked(
+            const PastBucket<HistogramValue>& bucket) const override;
+
+    const bool mIncludeSampleSize;
+
+    // Bin boundaries for each value field, in mFieldMatchers order. Parsed and
+    // validated from HistogramBinConfig at config time; shared by every
+    // dimension slice of the metric.
+    const std::vector<BinStarts> mBinStartsList;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -34,7 +34,6 @@ using android::util::ProtoOutputStream;
 using std::nullopt;
 using std::optional;
 using std::string;
-using zetasketch::android::AggregatorStateProto;
 
 namespace android {
 namespace os {
@@ -79,42 +78,41 @@ void KllMetricProducer::writePastBucketAggregateToProto(
             protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKETCHES);
     protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_SKETCH_INDEX, aggIndex);
 
-    // TODO(b/186737273): Serialize directly to ProtoOutputStream
-    const AggregatorStateProto& aggProto = kll->SerializeToProto();
-    const size_t numBytes = aggProto.ByteSizeLong();
-    const unique_ptr<char[]> buffer(new char[numBytes]);
-    aggProto.SerializeToArray(&buffer[0], numBytes);
-    protoOutput->write(FIELD_TYPE_BYTES | FIELD_ID_KLL_SKETCH, &buffer[0], numBytes);
+    // Serialize into the reusable scratch buffer instead of materializing a
+    // fresh heap buffer per sketch, so dumping hundreds of sliced sketches
+    // does not spike allocations at report time.
+    const size_t numBytes = kll->SerializeToString(&mSketchSerializationScratch);
+    protoOutput->write(FIELD_TYPE_BYTES | FIELD_ID_KLL_SKETCH, mSketchSerializationScratch.data(),
+                       numBytes);
 
     VLOG("\t\t sketch %d: %zu bytes", aggIndex, numBytes);
     protoOutput->end(sketchesToken);
 }
 
-optional<int64_t> getInt64ValueFromEvent(const LogEvent& event, const Matcher& matcher) {
-    for (const FieldValue& value : event.getValues()) {
-        if (value.mField.matches(matcher)) {
-            switch (value.mValue.type) {
-                case INT:
-                    return {value.mValue.int_value};
-                case LONG:
-                    return {value.mValue.long_value};
-                default:
-                    return nullopt;
-            }
-        }
+optional<int64_t> getInt64Value(const FieldValue& fieldValue) {
+    switch (fieldValue.mValue.type) {
+        case INT:
+            return {fieldValue.mValue.int_value};
+        case LONG:
+            return {fieldValue.mValue.long_value};
+        default:
+            return nullopt;
     }
-    return nullopt;
 }
 
 bool KllMetricProducer::aggregateFields(const int64_t eventTimeNs,
                                         const MetricDimensionKey& eventKey, const LogEvent& event,
                                         vector<Interval>& intervals, Empty& empty) {
     bool seenNewData = false;
+    // Resolve every value field to its index once per event; see ValueIndexPlan.
+    const vector<FieldValue>& values = event.getValues();
+    mFieldMatchersIndexPlan.resolve(values, mScratchValueIndices);
     for (size_t i = 0; i < mFieldMatchers.size(); i++) {
-        const Matcher& matcher = mFieldMatchers[i];
         Interval& interval = intervals[i];
         interval.aggIndex = i;
-        const optional<int64_t> valueOpt = getInt64ValueFromEvent(event, matcher);
+        const int32_t valueIndex = mScratchValueIndices[i];
+        const optional<int64_t> valueOpt =
+                valueIndex < 0 ? nullopt : getInt64Value(values[valueIndex]);
         if (!valueOpt) {
             VLOG("Failed to get value %zu from event %s", i, event.ToString().c_str());
             StatsdStats::getInstance().noteBadValueType(mMetricId);
@@ -151,20 +149,13 @@ PastBucket<unique_ptr<KllQuantile>> KllMetricProducer::buildPartialBucket(
     return bucket;
 }
 
-size_t KllMetricProducer::byteSizeLocked() const {
-    size_t totalSize = 0;
-    for (const auto& [_, buckets] : mPastBuckets) {
-        totalSize += buckets.size() * kBucketSize;
-        for (const auto& bucket : buckets) {
-            static const size_t kIntSize = sizeof(int);
-            totalSize += bucket.aggIndex.size() * kIntSize;
-            if (!bucket.aggregates.empty()) {
-                static const size_t kInt64Size = sizeof(int64_t);
-                // Assume sketch size is the same for all aggregations in a bucket.
-                totalSize += bucket.aggregates.size() * kInt64Size *
-                             bucket.aggregates[0]->num_stored_values();
-            }
-        }
+size_t KllMetricProducer::computePastBucketSizeLocked(
+        const PastBucket<unique_ptr<KllQuantile>>& bucket) const {
+    size_t totalSize = kBucketSize;
+    static const size_t kIntSize = sizeof(int);
+    totalSize += bucket.aggIndex.size() * kIntSize;
+    for (const unique_ptr<KllQuantile>& aggregate : bucket.aggregates) {
+        totalSize += aggregate->MemoryFootprint();
     }
     return totalSize;
 }
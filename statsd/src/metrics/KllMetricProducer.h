@@ -106,8 +106,14 @@ private:
                          const LogEvent& event, std::vector<Interval>& intervals,
                          Empty& empty) override;
 
-    // Internal function to calculate the current used bytes.
-    size_t byteSizeLocked() const override;
+    // Bytes contributed by a past bucket, including the KllQuantile sketch storage.
+    size_t computePastBucketSizeLocked(
+            const PastBucket<std::unique_ptr<KllQuantile>>& bucket) const override;
+
+    // Scratch buffer reused across the sketches of a single dump so that a
+    // report with many sliced sketches does not allocate per sketch. Only
+    // touched while holding mMutex (dumps hold the metric lock).
+    mutable std::string mSketchSerializationScratch;
 
     FRIEND_TEST(KllMetricProducerTest, TestByteSize);
     FRIEND_TEST(KllMetricProducerTest, TestPushedEventsWithoutCondition);
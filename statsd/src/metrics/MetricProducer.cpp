@@ -128,33 +128,35 @@ void MetricProducer::onMatchedLogEventLocked(const size_t matcherIndex, const Lo
         return;
     }
 
-    bool condition;
     ConditionKey conditionKey;
+
+    // Stores atom id to primary key pairs for each state atom that the metric is
+    // sliced by.
+    std::map<int32_t, HashableDimensionKey> statePrimaryKeys;
+
+    // One walk over the event's values fills the what-dimension, the sliced-condition
+    // dimensions (MetricConditionLinks), and the state primary keys (MetricStateLinks)
+    // together, instead of rescanning the values once per link.
+    static const std::vector<Metric2Condition> noConditionLinks;
+    HashableDimensionKey dimensionInWhat;
+    filterValuesFused(mDimensionsInWhat,
+                      mConditionSliced ? mMetric2ConditionLinks : noConditionLinks,
+                      mMetric2StateLinks, event.getValues(), &dimensionInWhat, &conditionKey,
+                      &statePrimaryKeys);
+
+    bool condition;
     if (mConditionSliced) {
-        for (const auto& link : mMetric2ConditionLinks) {
-            getDimensionForCondition(event.getValues(), link, &conditionKey[link.conditionId]);
-        }
         auto conditionState =
-            mWizard->query(mConditionTrackerIndex, conditionKey,
-                           !mHasLinksToAllConditionDimensionsInTracker);
+            mBatchConditionProbe.has_value()
+                    ? mBatchConditionProbe->query(conditionKey)
+                    : mWizard->query(mConditionTrackerIndex, conditionKey,
+                                     !mHasLinksToAllConditionDimensionsInTracker);
         condition = (conditionState == ConditionState::kTrue);
     } else {
         // TODO: The unknown condition state is not handled here, we should fix it.
         condition = mCondition == ConditionState::kTrue;
     }
 
-    // Stores atom id to primary key pairs for each state atom that the metric is
-    // sliced by.
-    std::map<int32_t, HashableDimensionKey> statePrimaryKeys;
-
-    // For states with primary fields, use MetricStateLinks to get the primary
-    // field values from the log event. These values will form a primary key
-    // that will be used to query StateTracker for the correct state value.
-    for (const auto& stateLink : mMetric2StateLinks) {
-        getDimensionForState(event.getValues(), stateLink,
-                             &statePrimaryKeys[stateLink.stateAtomId]);
-    }
-
     // For each sliced state, query StateTracker for the state value using
     // either the primary key from the previous step or the DEFAULT_DIMENSION_KEY.
     //
@@ -178,8 +180,10 @@ void MetricProducer::onMatchedLogEventLocked(const size_t matcherIndex, const Lo
         stateValuesKey.addValue(value);
     }
 
-    HashableDimensionKey dimensionInWhat;
-    filterValues(mDimensionsInWhat, event.getValues(), &dimensionInWhat);
+    // Canonicalize the key storage so the copies stored by sliced counters, duration
+    // trackers, and anomaly past buckets all share one allocation per distinct key.
+    dimensionInWhat.intern();
+    stateValuesKey.intern();
     MetricDimensionKey metricKey(dimensionInWhat, stateValuesKey);
     onMatchedLogEventInternalLocked(matcherIndex, metricKey, conditionKey, condition, event,
                                     statePrimaryKeys);
@@ -276,8 +280,9 @@ void MetricProducer::loadActiveMetricLocked(const ActiveMetric& activeMetric,
     }
 }
 
-void MetricProducer::writeActiveMetricToProtoOutputStream(
+bool MetricProducer::writeActiveMetricToProtoOutputStream(
         int64_t currentTimeNs, const DumpReportReason reason, ProtoOutputStream* proto) {
+    bool timeDependent = false;
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_ACTIVE_METRIC_ID, (long long)mMetricId);
     for (auto& it : mEventActivationMap) {
         const int atom_matcher_index = it.first;
@@ -300,6 +305,7 @@ void MetricProducer::writeActiveMetricToProtoOutputStream(
                     (long long)remainingTtlNs);
             proto->write(FIELD_TYPE_ENUM | FIELD_ID_ACTIVE_EVENT_ACTIVATION_STATE,
                     ActiveEventActivation::ACTIVE);
+            timeDependent = true;
 
         } else if (ActivationState::kActiveOnBoot == activation->state) {
             if (reason == DEVICE_SHUTDOWN || reason == TERMINATION_SIGNAL_RECEIVED) {
@@ -317,6 +323,7 @@ void MetricProducer::writeActiveMetricToProtoOutputStream(
         }
         proto->end(activationToken);
     }
+    return timeDependent;
 }
 
 void MetricProducer::queryStateValue(int32_t atomId, const HashableDimensionKey& queryKey,
@@ -381,8 +388,22 @@ bool MetricProducer::passesSampleCheckLocked(const vector<FieldValue>& values) c
     if (!filterValues(mSampledWhatFields[0], values, &sampleFieldValue)) {
         return true;
     }
-    return shouldKeepSample(sampleFieldValue, ShardOffsetProvider::getInstance().getShardOffset(),
-                            mShardCount);
+    // The raw hash depends only on the sampled value, so it is memoized across
+    // events; only the cheap shard modulo below runs per event, and the cache
+    // survives shard-count changes.
+    auto it = mSampleHashCache.find(sampleFieldValue.mValue);
+    if (it == mSampleHashCache.end()) {
+        int hashValue = 0;
+        if (!computeSampleHash(sampleFieldValue, &hashValue)) {
+            // Unhashable value types always pass, matching shouldKeepSample().
+            return true;
+        }
+        if (mSampleHashCache.size() >= kMaxSampleHashCacheSize) {
+            mSampleHashCache.clear();
+        }
+        it = mSampleHashCache.emplace(sampleFieldValue.mValue, hashValue).first;
+    }
+    return (it->second + ShardOffsetProvider::getInstance().getShardOffset()) % mShardCount == 0;
 }
 
 }  // namespace statsd
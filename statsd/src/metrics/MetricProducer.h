@@ -18,13 +18,15 @@
 #define METRIC_PRODUCER_H
 
 #include <src/active_config_list.pb.h>
+#include <stdio.h>
 #include <utils/RefBase.h>
 
+#include <map>
 #include <unordered_map>
 
 #include "HashableDimensionKey.h"
 #include "anomaly/AnomalyTracker.h"
-#include "condition/ConditionTimer.h"
+#include "condition/ConditionTimeline.h"
 #include "condition/ConditionWizard.h"
 #include "config/ConfigKey.h"
 #include "guardrail/StatsdStats.h"
@@ -34,6 +36,7 @@
 #include "src/statsd_metadata.pb.h"  // MetricMetadata
 #include "state/StateListener.h"
 #include "state/StateManager.h"
+#include "stats_log_util.h"
 #include "utils/DbUtils.h"
 #include "utils/ShardOffsetProvider.h"
 
@@ -191,6 +194,15 @@ public:
         notifyAppUpgrade(eventTimeNs);
     };
 
+    // Whether an app change (upgrade or removal) can affect what this metric's data
+    // means; see isSplitRelevantForAppUpgradeLocked(). MetricsManager consults this
+    // during its app-change fan-out so producers the change cannot touch skip the
+    // partial-bucket split entirely.
+    bool isSplitRelevantForAppUpgrade() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return isSplitRelevantForAppUpgradeLocked();
+    }
+
     /**
      * Force a partial bucket split on boot complete.
      */
@@ -199,9 +211,19 @@ public:
         flushLocked(eventTimeNs);
     }
     // Consume the parsed stats log entry that already matched the "what" of the metric.
+    // One in kCpuSampleInterval calls is also timed with the thread CPU clock so
+    // verbose dumpsys can attribute processing cost per metric; the common case
+    // pays only for a counter increment.
     void onMatchedLogEvent(const size_t matcherIndex, const LogEvent& event) {
         std::lock_guard<std::mutex> lock(mMutex);
-        onMatchedLogEventLocked(matcherIndex, event);
+        if ((++mMatchedEventCount & (kCpuSampleInterval - 1)) == 0) {
+            const int64_t startNs = getThreadCpuTimeNs();
+            onMatchedLogEventLocked(matcherIndex, event);
+            mSampledCpuTimeNs += getThreadCpuTimeNs() - startNs;
+            mSampledEventCount++;
+        } else {
+            onMatchedLogEventLocked(matcherIndex, event);
+        }
     }
 
     void onConditionChanged(const bool condition, int64_t eventTime) {
@@ -209,6 +231,28 @@ public:
         onConditionChangedLocked(condition, eventTime);
     }
 
+    // Rotates any completed full buckets. Called from MetricsManager's
+    // coordinated rotation phase when an event crosses the earliest bucket
+    // boundary, so every due metric rotates in one pass instead of each
+    // rotating lazily on its next matched event.
+    void flushIfNeeded(int64_t eventTimeNs) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        flushIfNeededLocked(eventTimeNs);
+    }
+
+    int64_t getNextBucketEndTimeNs() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return getCurrentBucketEndTimeNs();
+    }
+
+    // Whether the coordinated rotation phase may close this metric's full
+    // buckets as soon as time crosses the boundary. Only safe when an
+    // out-of-band flushIfNeeded() is indistinguishable from the one the metric
+    // would trigger itself: pushed aggregations with no end-of-bucket pull.
+    virtual bool supportsCoordinatedRotation() const {
+        return false;
+    }
+
     void onSlicedConditionMayChange(bool overallCondition, int64_t eventTime) {
         std::lock_guard<std::mutex> lock(mMutex);
         onSlicedConditionMayChangeLocked(overallCondition, eventTime);
@@ -219,6 +263,28 @@ public:
         return mConditionSliced;
     };
 
+    // Subscribes this metric's condition timer to a shared transition log so the
+    // per-event timer update becomes one append per condition change, shared by
+    // all subscribers. Only valid for always-active metrics whose condition is
+    // not sliced; see ConditionTimeline.
+    void attachConditionTimeline(const std::shared_ptr<ConditionTimeline>& timeline) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mConditionTimer.attach(timeline);
+    }
+
+    // Replays any pending shared transitions into the timer and returns it to
+    // eager updates. Called before the owning MetricsManager drops its timelines.
+    void detachConditionTimeline() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mConditionTimer.detach();
+    }
+
+    // The condition currently folded into the timer; seeds a new timeline's state.
+    bool getConditionTimerState() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mConditionTimer.currentCondition();
+    }
+
     void onStateChanged(const int64_t eventTimeNs, const int32_t atomId,
                         const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                         const FieldValue& newState){};
@@ -271,6 +337,9 @@ public:
 
     void dumpStates(int out, bool verbose) const {
         std::lock_guard<std::mutex> lock(mMutex);
+        if (verbose) {
+            dumpAccountingLocked(out);
+        }
         dumpStatesLocked(out, verbose);
     }
 
@@ -283,6 +352,14 @@ public:
         dropDataLocked(dropTimeNs);
     }
 
+    // Releases container capacity retained from past bursts (over-provisioned
+    // hash tables, vector slack) without touching any metric data. Called from
+    // the idle maintenance pass, so the work is never on the event path.
+    void trimMemory() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        trimMemoryLocked();
+    }
+
     void loadActiveMetric(const ActiveMetric& activeMetric, int64_t currentTimeNs) {
         std::lock_guard<std::mutex> lock(mMutex);
         loadActiveMetricLocked(activeMetric, currentTimeNs);
@@ -305,7 +382,10 @@ public:
 
     void flushIfExpire(int64_t elapsedTimestampNs);
 
-    void writeActiveMetricToProtoOutputStream(
+    // Returns true when the written bytes depend on currentTimeNs (an unexpired ACTIVE
+    // activation's remaining TTL was serialized), so callers know the output cannot be
+    // reused verbatim at a later save time.
+    bool writeActiveMetricToProtoOutputStream(
             int64_t currentTimeNs, const DumpReportReason reason, ProtoOutputStream* proto);
 
     virtual void enforceRestrictedDataTtl(sqlite3* db, int64_t wallClockNs){};
@@ -372,6 +452,11 @@ public:
 
     void setSamplingInfo(SamplingInfo samplingInfo) {
         std::lock_guard<std::mutex> lock(mMutex);
+        if (mSampledWhatFields != samplingInfo.sampledWhatFields) {
+            // Cached hashes are keyed by the old sampled field's values. A mere
+            // shard-count change keeps them valid.
+            mSampleHashCache.clear();
+        }
         mSampledWhatFields.swap(samplingInfo.sampledWhatFields);
         mShardCount = samplingInfo.shardCount;
     }
@@ -382,6 +467,22 @@ protected:
      */
     virtual void flushIfNeededLocked(int64_t eventTime){};
 
+    /**
+     * Shrinks over-provisioned containers. Subclasses override to compact the
+     * maps that grow with sliced dimensions; the default keeps nothing to trim.
+     */
+    virtual void trimMemoryLocked() {
+    }
+
+    // Rehashes a node-based hash map down to the minimum table for its current
+    // population when the bucket array still holds burst-time slack.
+    template <typename MapType>
+    static void shrinkMapIfOverProvisioned(MapType& map) {
+        if (map.bucket_count() > 2 * (map.size() + 1)) {
+            map.rehash(0);
+        }
+    }
+
     /**
      * For metrics that aggregate (ie, every metric producer except for EventMetricProducer),
      * we need to be able to flush the current buckets on demand (ie, end the current bucket and
@@ -406,6 +507,16 @@ protected:
         flushLocked(eventTimeNs);
     }
 
+    // An app change only alters how keyed data reads - a uid in a dimension maps to a new
+    // version mid-bucket - so a metric with no slicing at all keeps its meaning across the
+    // change and skips the partial-bucket split. Whether a sliced field is a uid is a
+    // runtime annotation that is not visible at config-parse time, so any sliced metric
+    // conservatively still splits.
+    bool isSplitRelevantForAppUpgradeLocked() const {
+        return !mDimensionsInWhat.empty() || mConditionSliced || !mMetric2StateLinks.empty() ||
+               !mSlicedStateAtoms.empty();
+    }
+
     /*
      * Individual metrics can implement their own business logic here. All pre-processing is done.
      *
@@ -441,6 +552,28 @@ protected:
     virtual void prepareFirstBucketLocked(){};
     virtual size_t byteSizeLocked() const = 0;
     virtual void dumpStatesLocked(int out, bool verbose) const = 0;
+
+    // Prints the per-metric accounting line (matched events, estimated CPU time
+    // scaled up from the sampled measurements, byte size, bucket number) and
+    // resets the counters so successive dumps show deltas.
+    void dumpAccountingLocked(int out) const {
+        if (mMatchedEventCount == 0) {
+            return;
+        }
+        const int64_t estimatedCpuUs =
+                mSampledEventCount > 0
+                        ? mSampledCpuTimeNs * mMatchedEventCount / mSampledEventCount / 1000
+                        : 0;
+        dprintf(out,
+                "Metric %lld: %lld matched events, ~%lld us cpu (%lld sampled), %lu bytes, "
+                "bucket %lld\n",
+                (long long)mMetricId, (long long)mMatchedEventCount, (long long)estimatedCpuUs,
+                (long long)mSampledEventCount, (unsigned long)byteSizeLocked(),
+                (long long)mCurrentBucketNum);
+        mMatchedEventCount = 0;
+        mSampledCpuTimeNs = 0;
+        mSampledEventCount = 0;
+    }
     virtual void dropDataLocked(const int64_t dropTimeNs) = 0;
     void loadActiveMetricLocked(const ActiveMetric& activeMetric, int64_t currentTimeNs);
     void activateLocked(int activationTrackerIndex, int64_t elapsedTimestampNs);
@@ -515,7 +648,7 @@ protected:
 
     ConditionState mCondition;
 
-    ConditionTimer mConditionTimer;
+    LazyConditionTimer mConditionTimer;
 
     int mConditionTrackerIndex;
 
@@ -524,6 +657,12 @@ protected:
 
     sp<ConditionWizard> mWizard;
 
+    // Snapshot of the sliced condition state, set by subclasses around a batch of rows
+    // that cannot interleave with condition changes (e.g. one pull's worth of events in
+    // NumericValueMetricProducer::accumulateEvents). While set, onMatchedLogEventLocked
+    // resolves the sliced condition through the probe instead of mWizard->query().
+    optional<ConditionBatchProbe> mBatchConditionProbe;
+
     bool mContainANYPositionInDimensionsInWhat;
 
     // Metrics slicing by primitive repeated field and/or position ALL need to use nested
@@ -577,6 +716,25 @@ protected:
 
     int mShardCount;
 
+    // Memoized raw sample hashes keyed by the sampled field's value, so repeated events
+    // for an already-decided dimension skip rehashing in passesSampleCheckLocked(). The
+    // raw hash does not depend on the shard count or offset, so a config update that only
+    // changes shard_count keeps the cache (and all retained shard assignments) intact;
+    // setSamplingInfo() clears it when the sampled field itself changes.
+    mutable std::map<Value, int> mSampleHashCache;
+
+    static const size_t kMaxSampleHashCacheSize = 512;
+
+    // Accounting surfaced by dumpAccountingLocked(); guarded by mMutex and
+    // mutable because the dump path is const and resets them.
+    mutable int64_t mMatchedEventCount = 0;
+    mutable int64_t mSampledCpuTimeNs = 0;
+    mutable int64_t mSampledEventCount = 0;
+
+    // Every Nth matched event is timed with the thread CPU clock. Power of two
+    // so the sample check is a mask instead of a division.
+    static constexpr int64_t kCpuSampleInterval = 32;
+
     FRIEND_TEST(CountMetricE2eTest, TestSlicedState);
     FRIEND_TEST(CountMetricE2eTest, TestSlicedStateWithMap);
     FRIEND_TEST(CountMetricE2eTest, TestMultipleSlicedStates);
@@ -20,6 +20,11 @@
 
 #include <private/android_filesystem_config.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
 #include "CountMetricProducer.h"
 #include "condition/CombinationConditionTracker.h"
 #include "condition/SimpleConditionTracker.h"
@@ -33,6 +38,7 @@
 #include "stats_log_util.h"
 #include "stats_util.h"
 #include "statslog_statsd.h"
+#include "utils/MemoryAccounting.h"
 #include "utils/DbUtils.h"
 
 using android::util::FIELD_COUNT_REPEATED;
@@ -53,6 +59,10 @@ namespace statsd {
 
 const int FIELD_ID_METRICS = 1;
 const int FIELD_ID_ANNOTATIONS = 7;
+
+// Cap on the number of threads serializing StatsLogReports during a dump; large configs
+// with deeply sliced metrics dominate dump latency, small ones don't need the fan-out.
+const size_t kMaxDumpThreads = 4;
 const int FIELD_ID_ANNOTATIONS_INT64 = 1;
 const int FIELD_ID_ANNOTATIONS_INT32 = 2;
 
@@ -96,11 +106,13 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
             mAllMetricProducers, mMetricProducerMap, mAllAnomalyTrackers, mAllPeriodicAlarmTrackers,
             mConditionToMetricMap, mTrackerToMetricMap, mTrackerToConditionMap,
             mActivationAtomTrackerToMetricMap, mDeactivationAtomTrackerToMetricMap,
-            mAlertTrackerMap, mMetricIndexesWithActivation, mStateProtoHashes, mNoReportMetricIds);
+            mAlertTrackerMap, mMatcherToBurstTrackers, mMetricIndexesWithActivation,
+            mStateProtoHashes, mNoReportMetricIds);
 
     mHashStringsInReport = config.hash_strings_in_metric_report();
     mVersionStringsInReport = config.version_strings_in_metric_report();
     mInstallerInReport = config.installer_in_metric_report();
+    mPersistStringDictionary = config.persist_string_dictionary_in_report();
 
     createAllLogSourcesFromConfig(config);
     setMaxMetricsBytesFromConfig(config);
@@ -113,6 +125,9 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
     }
     verifyGuardrailsAndUpdateStatsdStats();
     initializeConfigActiveStatus();
+    compileMatcherPrograms();
+    initTrackerIndexLists();
+    initConditionEvaluationScratch();
 }
 
 MetricsManager::~MetricsManager() {
@@ -149,6 +164,7 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
     unordered_map<int64_t, int> newMetricProducerMap;
     vector<sp<AnomalyTracker>> newAnomalyTrackers;
     unordered_map<int64_t, int> newAlertTrackerMap;
+    unordered_map<int, vector<sp<BurstTracker>>> newMatcherToBurstTrackers;
     vector<sp<AlarmTracker>> newPeriodicAlarmTrackers;
     mTagIdsToMatchersMap.clear();
     mConditionToMetricMap.clear();
@@ -167,8 +183,8 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
             newConditionTrackerMap, newMetricProducers, newMetricProducerMap, newAnomalyTrackers,
             newAlertTrackerMap, newPeriodicAlarmTrackers, mConditionToMetricMap,
             mTrackerToMetricMap, mTrackerToConditionMap, mActivationAtomTrackerToMetricMap,
-            mDeactivationAtomTrackerToMetricMap, mMetricIndexesWithActivation, newStateProtoHashes,
-            mNoReportMetricIds);
+            mDeactivationAtomTrackerToMetricMap, newMatcherToBurstTrackers,
+            mMetricIndexesWithActivation, newStateProtoHashes, mNoReportMetricIds);
     mAllAtomMatchingTrackers = newAtomMatchingTrackers;
     mAtomMatchingTrackerMap = newAtomMatchingTrackerMap;
     mAllConditionTrackers = newConditionTrackers;
@@ -178,6 +194,7 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
     mStateProtoHashes = newStateProtoHashes;
     mAllAnomalyTrackers = newAnomalyTrackers;
     mAlertTrackerMap = newAlertTrackerMap;
+    mMatcherToBurstTrackers = newMatcherToBurstTrackers;
     mAllPeriodicAlarmTrackers = newPeriodicAlarmTrackers;
 
     mTtlNs = config.has_ttl_in_seconds() ? config.ttl_in_seconds() * NS_PER_SEC : -1;
@@ -186,6 +203,10 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
     mHashStringsInReport = config.hash_strings_in_metric_report();
     mVersionStringsInReport = config.version_strings_in_metric_report();
     mInstallerInReport = config.installer_in_metric_report();
+    mPersistStringDictionary = config.persist_string_dictionary_in_report();
+    // Re-seed the consumer-side dictionary: the updated config may reach a
+    // consumer that has no uploads for it yet.
+    mUploadedReportStrings.clear();
     mWhitelistedAtomIds.clear();
     mWhitelistedAtomIds.insert(config.whitelisted_atom_ids().begin(),
                                config.whitelisted_atom_ids().end());
@@ -209,6 +230,11 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
 
     verifyGuardrailsAndUpdateStatsdStats();
     initializeConfigActiveStatus();
+    compileMatcherPrograms();
+    initTrackerIndexLists();
+    initConditionEvaluationScratch();
+    initConditionTimelines();
+    initCoordinatedRotation();
     return !mInvalidConfigReason.has_value();
 }
 
@@ -325,8 +351,12 @@ void MetricsManager::initializeConfigActiveStatus() {
     mIsAlwaysActive = (mMetricIndexesWithActivation.size() != mAllMetricProducers.size()) ||
                       (mAllMetricProducers.size() == 0);
     mIsActive = mIsAlwaysActive;
+    mActiveMetricsBitmap.assign((mAllMetricProducers.size() + 63) / 64, 0);
     for (int metric : mMetricIndexesWithActivation) {
-        mIsActive |= mAllMetricProducers[metric]->isActive();
+        if (mAllMetricProducers[metric]->isActive()) {
+            setMetricActiveBit(metric);
+            mIsActive = true;
+        }
     }
     VLOG("mIsActive is initialized to %d", mIsActive);
 }
@@ -336,9 +366,19 @@ void MetricsManager::initAllowedLogSources() {
     mAllowedLogSources.clear();
     mAllowedLogSources.insert(mAllowedUid.begin(), mAllowedUid.end());
 
+    mAllowedPkgIds.clear();
+    mHasUnresolvedAllowedPkg = false;
     for (const auto& pkg : mAllowedPkg) {
         auto uids = mUidMap->getAppUid(pkg);
         mAllowedLogSources.insert(uids.begin(), uids.end());
+        const int32_t pkgId = mUidMap->getPackageId(pkg);
+        if (pkgId >= 0) {
+            mAllowedPkgIds.insert(pkgId);
+        } else {
+            // Not installed yet; isAllowedPkg falls back to a string comparison for
+            // this entry until the package shows up in the uid map.
+            mHasUnresolvedAllowedPkg = true;
+        }
     }
     if (STATSD_DEBUG) {
         for (const auto& uid : mAllowedLogSources) {
@@ -365,14 +405,30 @@ bool MetricsManager::isConfigValid() const {
     return !mInvalidConfigReason.has_value();
 }
 
+bool MetricsManager::isAllowedPkg(const string& pkg) const {
+    // A package named in an app change notification has been interned by the uid
+    // map by the time the notification fires, so the common case is one integer
+    // set lookup.
+    const int32_t pkgId = mUidMap->getPackageId(pkg);
+    if (pkgId >= 0 && mAllowedPkgIds.find(pkgId) != mAllowedPkgIds.end()) {
+        return true;
+    }
+    return mHasUnresolvedAllowedPkg &&
+           std::find(mAllowedPkg.begin(), mAllowedPkg.end(), pkg) != mAllowedPkg.end();
+}
+
 void MetricsManager::notifyAppUpgrade(const int64_t eventTimeNs, const string& apk, const int uid,
                                       const int64_t version) {
-    // Inform all metric producers.
+    // Inform the metric producers the upgrade is relevant to. Unsliced metrics keep
+    // their meaning across an app change, so they skip the forced split; upgrade
+    // storms then only cost the producers that actually key data by the app.
     for (const auto& it : mAllMetricProducers) {
-        it->notifyAppUpgrade(eventTimeNs);
+        if (it->isSplitRelevantForAppUpgrade()) {
+            it->notifyAppUpgrade(eventTimeNs);
+        }
     }
     // check if we care this package
-    if (std::find(mAllowedPkg.begin(), mAllowedPkg.end(), apk) != mAllowedPkg.end()) {
+    if (isAllowedPkg(apk)) {
         // We will re-initialize the whole list because we don't want to keep the multi mapping of
         // UID<->pkg inside MetricsManager to reduce the memory usage.
         initAllowedLogSources();
@@ -387,12 +443,14 @@ void MetricsManager::notifyAppUpgrade(const int64_t eventTimeNs, const string& a
 }
 
 void MetricsManager::notifyAppRemoved(const int64_t eventTimeNs, const string& apk, const int uid) {
-    // Inform all metric producers.
+    // Inform the metric producers the removal is relevant to; see notifyAppUpgrade.
     for (const auto& it : mAllMetricProducers) {
-        it->notifyAppRemoved(eventTimeNs);
+        if (it->isSplitRelevantForAppUpgrade()) {
+            it->notifyAppRemoved(eventTimeNs);
+        }
     }
     // check if we care this package
-    if (std::find(mAllowedPkg.begin(), mAllowedPkg.end(), apk) != mAllowedPkg.end()) {
+    if (isAllowedPkg(apk)) {
         // We will re-initialize the whole list because we don't want to keep the multi mapping of
         // UID<->pkg inside MetricsManager to reduce the memory usage.
         initAllowedLogSources();
@@ -429,6 +487,8 @@ void MetricsManager::init() {
     for (const auto& producer : mAllMetricProducers) {
         producer->prepareFirstBucket();
     }
+    initConditionTimelines();
+    initCoordinatedRotation();
 }
 
 vector<int32_t> MetricsManager::getPullAtomUids(int32_t atomId) {
@@ -462,6 +522,12 @@ void MetricsManager::dropData(const int64_t dropTimeNs) {
     }
 }
 
+void MetricsManager::trimMemory() {
+    for (const auto& producer : mAllMetricProducers) {
+        producer->trimMemory();
+    }
+}
+
 void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs, const int64_t wallClockNs,
                                   const bool include_current_partial_bucket, const bool erase_data,
                                   const DumpLatency dumpLatency, std::set<string>* str_set,
@@ -473,22 +539,65 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs, const int64_t w
     }
     VLOG("=========================Metric Reports Start==========================");
     // one StatsLogReport per MetricProduer
+    std::vector<sp<MetricProducer>> dumpProducers;
+    dumpProducers.reserve(mAllMetricProducers.size());
     for (const auto& producer : mAllMetricProducers) {
         if (mNoReportMetricIds.find(producer->getMetricId()) == mNoReportMetricIds.end()) {
-            uint64_t token = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS);
-            if (mHashStringsInReport) {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                                       dumpLatency, str_set, protoOutput);
-            } else {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                                       dumpLatency, nullptr, protoOutput);
-            }
-            protoOutput->end(token);
+            dumpProducers.push_back(producer);
         } else {
             producer->clearPastBuckets(dumpTimeStampNs);
         }
     }
+
+    if (mHashStringsInReport || dumpProducers.size() <= 1) {
+        // Serial path: hashed-string reports share str_set across producers, so they
+        // cannot serialize concurrently.
+        for (const auto& producer : dumpProducers) {
+            uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                                FIELD_ID_METRICS);
+            producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
+                                   dumpLatency, mHashStringsInReport ? str_set : nullptr,
+                                   protoOutput);
+            protoOutput->end(token);
+        }
+    } else {
+        // Each producer guards its state with its own lock, so the StatsLogReports can be
+        // serialized concurrently into per-producer buffers and then concatenated as
+        // length-delimited segments — byte-identical to serializing them in place.
+        std::vector<std::unique_ptr<std::vector<uint8_t>>> buffers(dumpProducers.size());
+        std::atomic<size_t> nextProducer(0);
+        auto dumpWorker = [&]() {
+            for (size_t i = nextProducer.fetch_add(1); i < dumpProducers.size();
+                 i = nextProducer.fetch_add(1)) {
+                ProtoOutputStream stream;
+                dumpProducers[i]->onDumpReport(dumpTimeStampNs, include_current_partial_bucket,
+                                               erase_data, dumpLatency, nullptr, &stream);
+                buffers[i] = std::make_unique<std::vector<uint8_t>>(stream.size());
+                size_t pos = 0;
+                sp<android::util::ProtoReader> reader = stream.data();
+                while (reader->readBuffer() != nullptr) {
+                    size_t toRead = reader->currentToRead();
+                    std::memcpy(buffers[i]->data() + pos, reader->readBuffer(), toRead);
+                    pos += toRead;
+                    reader->move(toRead);
+                }
+            }
+        };
+        const size_t numThreads = std::min(kMaxDumpThreads, dumpProducers.size());
+        std::vector<std::thread> workers;
+        workers.reserve(numThreads - 1);
+        for (size_t i = 1; i < numThreads; i++) {
+            workers.emplace_back(dumpWorker);
+        }
+        dumpWorker();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (const auto& buffer : buffers) {
+            protoOutput->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS,
+                               reinterpret_cast<const char*>(buffer->data()), buffer->size());
+        }
+    }
     for (const auto& annotation : mAnnotations) {
         uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                                             FIELD_ID_ANNOTATIONS);
@@ -507,6 +616,25 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs, const int64_t w
     VLOG("=========================Metric Reports End==========================");
 }
 
+void MetricsManager::filterReportedStrings(std::set<string>* strSet, bool commit) {
+    if (mUploadedReportStrings.size() >= kMaxUploadedReportStrings) {
+        // The dictionary grew past its cap; drop it and keep this report's full
+        // string set. Later reports rebuild the dictionary from scratch.
+        mUploadedReportStrings.clear();
+        return;
+    }
+    for (auto strIt = strSet->begin(); strIt != strSet->end();) {
+        if (mUploadedReportStrings.find(*strIt) != mUploadedReportStrings.end()) {
+            strIt = strSet->erase(strIt);
+        } else {
+            if (commit) {
+                mUploadedReportStrings.insert(*strIt);
+            }
+            ++strIt;
+        }
+    }
+}
+
 bool MetricsManager::checkLogCredentials(const LogEvent& event) {
     if (mWhitelistedAtomIds.find(event.GetTagId()) != mWhitelistedAtomIds.end()) {
         return true;
@@ -526,6 +654,205 @@ bool MetricsManager::checkLogCredentials(const LogEvent& event) {
     return true;
 }
 
+void MetricsManager::compileMatcherStep(int tagId, int matcherIndex, vector<uint8_t>& visited,
+                                        vector<CompiledMatcherStep>& program) {
+    if (visited[matcherIndex]) {
+        return;
+    }
+    visited[matcherIndex] = true;
+
+    const sp<AtomMatchingTracker>& matcher = mAllAtomMatchingTrackers[matcherIndex];
+    const set<int>& atomIds = matcher->getAtomIds();
+    if (atomIds.find(tagId) == atomIds.end()) {
+        // The matcher can never match an event with this tag id. Fold the result to a
+        // constant so its subtree is never visited at runtime.
+        program.push_back({matcherIndex, CompiledMatcherStep::kConstNotMatched,
+                           LogicalOperation::LOGICAL_OPERATION_UNSPECIFIED, {}});
+        return;
+    }
+
+    const vector<int>* children = matcher->getChildMatcherIndices();
+    if (children == nullptr) {
+        program.push_back({matcherIndex, CompiledMatcherStep::kEvaluateMatcher,
+                           LogicalOperation::LOGICAL_OPERATION_UNSPECIFIED, {}});
+        return;
+    }
+
+    for (const int childIndex : *children) {
+        compileMatcherStep(tagId, childIndex, visited, program);
+    }
+    program.push_back(
+            {matcherIndex, CompiledMatcherStep::kCombine, matcher->getLogicalOperation(), *children});
+}
+
+void MetricsManager::compileMatcherPrograms() {
+    mCompiledMatcherPrograms.clear();
+    if (!isConfigValid()) {
+        return;
+    }
+    for (const auto& [tagId, matcherIndices] : mTagIdsToMatchersMap) {
+        vector<uint8_t> visited(mAllAtomMatchingTrackers.size(), false);
+        vector<CompiledMatcherStep>& program = mCompiledMatcherPrograms[tagId];
+        for (const int matcherIndex : matcherIndices) {
+            compileMatcherStep(tagId, matcherIndex, visited, program);
+        }
+    }
+}
+
+void MetricsManager::initTrackerIndexLists() {
+    const int matcherCount = mAllAtomMatchingTrackers.size();
+    const int conditionCount = mAllConditionTrackers.size();
+    mTrackerToMetricLists.assign(matcherCount, {});
+    mConditionToMetricLists.assign(conditionCount, {});
+    mTrackerToConditionEntries.clear();
+    mActivationTrackerToMetricEntries.clear();
+    mDeactivationTrackerToMetricEntries.clear();
+    if (!isConfigValid()) {
+        return;
+    }
+    for (const auto& [trackerIndex, metricList] : mTrackerToMetricMap) {
+        if (trackerIndex >= 0 && trackerIndex < matcherCount) {
+            mTrackerToMetricLists[trackerIndex] = metricList;
+        }
+    }
+    for (const auto& [conditionIndex, metricList] : mConditionToMetricMap) {
+        if (conditionIndex >= 0 && conditionIndex < conditionCount) {
+            mConditionToMetricLists[conditionIndex] = metricList;
+        }
+    }
+    mTrackerToConditionEntries.assign(mTrackerToConditionMap.begin(), mTrackerToConditionMap.end());
+    mActivationTrackerToMetricEntries.assign(mActivationAtomTrackerToMetricMap.begin(),
+                                             mActivationAtomTrackerToMetricMap.end());
+    mDeactivationTrackerToMetricEntries.assign(mDeactivationAtomTrackerToMetricMap.begin(),
+                                               mDeactivationAtomTrackerToMetricMap.end());
+    // Iteration order over an unordered_map is unspecified; sort so the
+    // per-event scans (and the fan-out they trigger) stay deterministic.
+    const auto byIndex = [](const std::pair<int, vector<int>>& lhs,
+                            const std::pair<int, vector<int>>& rhs) {
+        return lhs.first < rhs.first;
+    };
+    std::sort(mTrackerToConditionEntries.begin(), mTrackerToConditionEntries.end(), byIndex);
+    std::sort(mActivationTrackerToMetricEntries.begin(), mActivationTrackerToMetricEntries.end(),
+              byIndex);
+    std::sort(mDeactivationTrackerToMetricEntries.begin(),
+              mDeactivationTrackerToMetricEntries.end(), byIndex);
+}
+
+void MetricsManager::initConditionTimelines() {
+    // Detach first: on config update a preserved producer may still hold a
+    // cursor into a timeline this manager is about to stop appending to.
+    for (const auto& producer : mAllMetricProducers) {
+        producer->detachConditionTimeline();
+    }
+    mConditionTimelines.clear();
+    if (!isConfigValid()) {
+        return;
+    }
+
+    // Metrics with an activation fold the activation state into their timer, so
+    // the updates they need are not the raw condition transitions; they keep
+    // eager timers, as do metrics with sliced conditions.
+    const set<int> metricsWithActivation(mMetricIndexesWithActivation.begin(),
+                                         mMetricIndexesWithActivation.end());
+    for (const auto& [conditionIndex, metricList] : mConditionToMetricMap) {
+        std::shared_ptr<ConditionTimeline> timeline;
+        bool timelineState = false;
+        for (const int metricIndex : metricList) {
+            const sp<MetricProducer>& producer = mAllMetricProducers[metricIndex];
+            if (metricsWithActivation.count(metricIndex) > 0 || producer->isConditionSliced()) {
+                continue;
+            }
+            if (timeline == nullptr) {
+                // The first eligible producer seeds the timeline's current state.
+                timelineState = producer->getConditionTimerState();
+                timeline = std::make_shared<ConditionTimeline>(timelineState);
+            } else if (producer->getConditionTimerState() != timelineState) {
+                // A producer whose timer disagrees with the seed (possible only
+                // transiently around a config update) keeps its eager timer.
+                continue;
+            }
+            producer->attachConditionTimeline(timeline);
+        }
+        if (timeline != nullptr) {
+            mConditionTimelines[conditionIndex] = timeline;
+        }
+    }
+}
+
+void MetricsManager::initCoordinatedRotation() {
+    mCoordinatedRotationMetricIndexes.clear();
+    mNextCoordinatedRotationTimeNs = INT64_MAX;
+    if (!isConfigValid()) {
+        return;
+    }
+    // Metrics with an activation only rotate while active, and metrics that
+    // pull at the bucket boundary need their own flush sequencing; both stay on
+    // the lazy per-producer path.
+    const set<int> metricsWithActivation(mMetricIndexesWithActivation.begin(),
+                                         mMetricIndexesWithActivation.end());
+    for (int i = 0; i < (int)mAllMetricProducers.size(); i++) {
+        if (metricsWithActivation.count(i) > 0 ||
+            !mAllMetricProducers[i]->supportsCoordinatedRotation()) {
+            continue;
+        }
+        mCoordinatedRotationMetricIndexes.push_back(i);
+        mNextCoordinatedRotationTimeNs = std::min(
+                mNextCoordinatedRotationTimeNs, mAllMetricProducers[i]->getNextBucketEndTimeNs());
+    }
+}
+
+void MetricsManager::rotateFullBucketsIfNeeded(const int64_t eventTimeNs) {
+    if (eventTimeNs < mNextCoordinatedRotationTimeNs) {
+        return;
+    }
+    // Rotate every due metric in one cache-warm pass. Each flushIfNeeded() call
+    // is the same one the metric would have made lazily on its next matched
+    // event, so bucket boundaries and contents are unchanged; the work is just
+    // no longer smeared across later events while their handlers run.
+    int64_t nextRotationNs = INT64_MAX;
+    for (const int metricIndex : mCoordinatedRotationMetricIndexes) {
+        const sp<MetricProducer>& producer = mAllMetricProducers[metricIndex];
+        if (eventTimeNs >= producer->getNextBucketEndTimeNs()) {
+            producer->flushIfNeeded(eventTimeNs);
+        }
+        nextRotationNs = std::min(nextRotationNs, producer->getNextBucketEndTimeNs());
+    }
+    mNextCoordinatedRotationTimeNs = nextRotationNs;
+}
+
+void MetricsManager::initConditionEvaluationScratch() {
+    const size_t conditionCount = mAllConditionTrackers.size();
+    mScratchConditionCache.assign(conditionCount, ConditionState::kNotEvaluated);
+    mScratchConditionChanged.assign(conditionCount, false);
+    mScratchConditionAffected.assign(conditionCount, false);
+    mScratchConditionEvents.assign(conditionCount, nullptr);
+    mScratchAffectedConditions.clear();
+    mScratchAffectedConditions.reserve(conditionCount);
+    mConditionEvalFootprint.assign(conditionCount, {});
+    if (!isConfigValid()) {
+        return;
+    }
+    // DFS from each tracker across child links gathers every cache entry its
+    // evaluateCondition() can write, so the scratch reset after an event only
+    // touches those entries.
+    for (size_t i = 0; i < conditionCount; i++) {
+        vector<uint8_t> visited(conditionCount, false);
+        vector<int> stack = {(int)i};
+        visited[i] = true;
+        while (!stack.empty()) {
+            const int current = stack.back();
+            stack.pop_back();
+            mConditionEvalFootprint[i].push_back(current);
+            for (const int child : mAllConditionTrackers[current]->getChildConditionIndexes()) {
+                if (child >= 0 && child < (int)conditionCount && !visited[child]) {
+                    visited[child] = true;
+                    stack.push_back(child);
+                }
+            }
+        }
+    }
+}
+
 // Consume the stats log if it's interesting to this metric.
 void MetricsManager::onLogEvent(const LogEvent& event) {
     if (!isConfigValid()) {
@@ -541,21 +868,23 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
 
     bool isActive = mIsAlwaysActive;
 
-    // Set of metrics that are still active after flushing.
-    unordered_set<int> activeMetricsIndices;
-
-    // Update state of all metrics w/ activation conditions as of eventTimeNs.
-    for (int metricIndex : mMetricIndexesWithActivation) {
-        const sp<MetricProducer>& metric = mAllMetricProducers[metricIndex];
-        metric->flushIfExpire(eventTimeNs);
-        if (metric->isActive()) {
-            // If this metric w/ activation condition is still active after
-            // flushing, remember it.
-            activeMetricsIndices.insert(metricIndex);
+    // Update state of the still-active metrics w/ activation conditions as of
+    // eventTimeNs. Only metrics whose activation bit is set can have an activation
+    // to expire, so an all-zero bitmap skips the producer loop with a word test.
+    for (size_t word = 0; word < mActiveMetricsBitmap.size(); word++) {
+        uint64_t bits = mActiveMetricsBitmap[word];
+        while (bits != 0) {
+            const int metricIndex = (word << 6) + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            const sp<MetricProducer>& metric = mAllMetricProducers[metricIndex];
+            metric->flushIfExpire(eventTimeNs);
+            if (!metric->isActive()) {
+                clearMetricActiveBit(metricIndex);
+            }
         }
     }
 
-    mIsActive = isActive || !activeMetricsIndices.empty();
+    mIsActive = isActive || anyMetricActiveBitSet();
 
     const auto matchersIt = mTagIdsToMatchersMap.find(tagId);
 
@@ -573,26 +902,66 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
         return;
     }
 
-    vector<MatchingState> matcherCache(mAllAtomMatchingTrackers.size(),
-                                       MatchingState::kNotComputed);
+    MatchingStateBitset matcherCache(mAllAtomMatchingTrackers.size(),
+                                     MatchingState::kNotComputed);
     vector<shared_ptr<LogEvent>> matcherTransformations(matcherCache.size(), nullptr);
 
-    for (const auto& matcherIndex : matchersIt->second) {
-        mAllAtomMatchingTrackers[matcherIndex]->onLogEvent(event, matcherIndex,
-                                                           mAllAtomMatchingTrackers, matcherCache,
-                                                           matcherTransformations);
+    // Matcher-side allocations (transformed events and their field vectors)
+    // are charged separately from the metric producers below.
+    ScopedMemoryTag matcherMemoryTag(MemoryAccounting::kMatchers);
+
+    const auto programIt = mCompiledMatcherPrograms.find(tagId);
+    if (programIt != mCompiledMatcherPrograms.end()) {
+        // Evaluate the flattened program compiled for this tag id: children are ordered
+        // before their parents, so combination steps reduce to a combinationMatch() over
+        // cached child results instead of recursing through the tracker graph.
+        for (const CompiledMatcherStep& step : programIt->second) {
+            switch (step.kind) {
+                case CompiledMatcherStep::kEvaluateMatcher:
+                    mAllAtomMatchingTrackers[step.matcherIndex]->onLogEvent(
+                            event, step.matcherIndex, mAllAtomMatchingTrackers, matcherCache,
+                            matcherTransformations);
+                    break;
+                case CompiledMatcherStep::kCombine:
+                    matcherCache[step.matcherIndex] =
+                            combinationMatch(step.childMatcherIndices, step.operation, matcherCache)
+                                    ? MatchingState::kMatched
+                                    : MatchingState::kNotMatched;
+                    break;
+                case CompiledMatcherStep::kConstNotMatched:
+                    matcherCache[step.matcherIndex] = MatchingState::kNotMatched;
+                    break;
+            }
+        }
+    } else {
+        for (const auto& matcherIndex : matchersIt->second) {
+            mAllAtomMatchingTrackers[matcherIndex]->onLogEvent(event, matcherIndex,
+                                                               mAllAtomMatchingTrackers,
+                                                               matcherCache,
+                                                               matcherTransformations);
+        }
     }
 
+    // Everything from here on feeds the metric producers; charge it back to
+    // the metrics subsystem.
+    ScopedMemoryTag metricsMemoryTag(MemoryAccounting::kMetrics);
+
+    // Close any due full buckets before the event reaches a single producer, so
+    // every coordinated metric's own boundary check below is a pure backstop
+    // and the event lands directly in the fresh bucket.
+    rotateFullBucketsIfNeeded(eventTimeNs);
+
     // Set of metrics that received an activation cancellation.
     unordered_set<int> metricIndicesWithCanceledActivations;
 
     // Determine which metric activations received a cancellation and cancel them.
-    for (const auto& it : mDeactivationAtomTrackerToMetricMap) {
-        if (matcherCache[it.first] == MatchingState::kMatched) {
-            for (int metricIndex : it.second) {
-                mAllMetricProducers[metricIndex]->cancelEventActivation(it.first);
+    for (const auto& [trackerIndex, metricList] : mDeactivationTrackerToMetricEntries) {
+        if (matcherCache[trackerIndex] == MatchingState::kMatched) {
+            for (int metricIndex : metricList) {
+                mAllMetricProducers[metricIndex]->cancelEventActivation(trackerIndex);
                 metricIndicesWithCanceledActivations.insert(metricIndex);
             }
+            mActivationVersion++;
         }
     }
 
@@ -601,78 +970,94 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
         const sp<MetricProducer>& metric = mAllMetricProducers[metricIndex];
         metric->flushIfExpire(eventTimeNs);
         if (!metric->isActive()) {
-            activeMetricsIndices.erase(metricIndex);
+            clearMetricActiveBit(metricIndex);
         }
     }
 
-    isActive |= !activeMetricsIndices.empty();
-
+    isActive |= anyMetricActiveBitSet();
 
     // Determine which metric activations should be turned on and turn them on
-    for (const auto& it : mActivationAtomTrackerToMetricMap) {
-        if (matcherCache[it.first] == MatchingState::kMatched) {
-            for (int metricIndex : it.second) {
-                mAllMetricProducers[metricIndex]->activate(it.first, eventTimeNs);
-                isActive |= mAllMetricProducers[metricIndex]->isActive();
+    for (const auto& [trackerIndex, metricList] : mActivationTrackerToMetricEntries) {
+        if (matcherCache[trackerIndex] == MatchingState::kMatched) {
+            for (int metricIndex : metricList) {
+                mAllMetricProducers[metricIndex]->activate(trackerIndex, eventTimeNs);
+                if (mAllMetricProducers[metricIndex]->isActive()) {
+                    setMetricActiveBit(metricIndex);
+                    isActive = true;
+                }
             }
+            mActivationVersion++;
         }
     }
 
     mIsActive = isActive;
 
-    // A bitmap to see which ConditionTracker needs to be re-evaluated.
-    vector<uint8_t> conditionToBeEvaluated(mAllConditionTrackers.size(), false);
-    vector<shared_ptr<LogEvent>> conditionToTransformedLogEvents(mAllConditionTrackers.size(),
-                                                                 nullptr);
-
-    for (const auto& [matcherIndex, conditionList] : mTrackerToConditionMap) {
+    // Collect only the conditions reachable from matched matchers; everything else
+    // provably keeps its state for this event. The scratch arrays are persistent
+    // per-manager (onLogEvent is serialized per config), so no per-event allocation.
+    mScratchAffectedConditions.clear();
+    for (const auto& [matcherIndex, conditionList] : mTrackerToConditionEntries) {
         if (matcherCache[matcherIndex] == MatchingState::kMatched) {
             for (const int conditionIndex : conditionList) {
-                conditionToBeEvaluated[conditionIndex] = true;
-                conditionToTransformedLogEvents[conditionIndex] =
-                        matcherTransformations[matcherIndex];
+                if (!mScratchConditionAffected[conditionIndex]) {
+                    mScratchConditionAffected[conditionIndex] = true;
+                    mScratchAffectedConditions.push_back(conditionIndex);
+                }
+                mScratchConditionEvents[conditionIndex] = matcherTransformations[matcherIndex];
             }
         }
     }
 
-    vector<ConditionState> conditionCache(mAllConditionTrackers.size(),
-                                          ConditionState::kNotEvaluated);
-    // A bitmap to track if a condition has changed value.
-    vector<uint8_t> changedCache(mAllConditionTrackers.size(), false);
-    for (size_t i = 0; i < mAllConditionTrackers.size(); i++) {
-        if (!conditionToBeEvaluated[i]) {
-            continue;
+    if (!mScratchAffectedConditions.empty()) {
+        // Keep the original ascending evaluation order; combination trackers rely on
+        // children being visitable before/with their parents via recursion either way,
+        // but the metric fan-out order below is observable.
+        std::sort(mScratchAffectedConditions.begin(), mScratchAffectedConditions.end());
+        for (const int i : mScratchAffectedConditions) {
+            sp<ConditionTracker>& condition = mAllConditionTrackers[i];
+            const LogEvent& conditionEvent =
+                    mScratchConditionEvents[i] == nullptr ? event : *mScratchConditionEvents[i];
+            condition->evaluateCondition(conditionEvent, matcherCache, mAllConditionTrackers,
+                                         mScratchConditionCache, mScratchConditionChanged);
         }
-        sp<ConditionTracker>& condition = mAllConditionTrackers[i];
-        const LogEvent& conditionEvent = conditionToTransformedLogEvents[i] == nullptr
-                                                 ? event
-                                                 : *conditionToTransformedLogEvents[i];
-        condition->evaluateCondition(conditionEvent, matcherCache, mAllConditionTrackers,
-                                     conditionCache, changedCache);
-    }
 
-    for (size_t i = 0; i < mAllConditionTrackers.size(); i++) {
-        if (!changedCache[i]) {
-            continue;
-        }
-        auto it = mConditionToMetricMap.find(i);
-        if (it == mConditionToMetricMap.end()) {
-            continue;
+        for (const int i : mScratchAffectedConditions) {
+            if (!mScratchConditionChanged[i]) {
+                continue;
+            }
+            const vector<int>& metricList = mConditionToMetricLists[i];
+            for (auto metricIndex : metricList) {
+                // Metric cares about non sliced condition, and it's changed.
+                // Push the new condition to it directly.
+                if (!mAllMetricProducers[metricIndex]->isConditionSliced()) {
+                    mAllMetricProducers[metricIndex]->onConditionChanged(mScratchConditionCache[i],
+                                                                         eventTimeNs);
+                    // Metric cares about sliced conditions, and it may have changed. Send
+                    // notification, and the metric can query the sliced conditions that are
+                    // interesting to it.
+                } else {
+                    mAllMetricProducers[metricIndex]->onSlicedConditionMayChange(
+                            mScratchConditionCache[i], eventTimeNs);
+                }
+            }
+            const auto timelineIt = mConditionTimelines.find(i);
+            if (timelineIt != mConditionTimelines.end()) {
+                // Record the transition once for the metrics that replay it lazily.
+                // Appended after the eager notifications so a flush triggered by
+                // this very event does not consume the new edge a step early.
+                timelineIt->second->onConditionChanged(mScratchConditionCache[i], eventTimeNs);
+            }
         }
-        auto& metricList = it->second;
-        for (auto metricIndex : metricList) {
-            // Metric cares about non sliced condition, and it's changed.
-            // Push the new condition to it directly.
-            if (!mAllMetricProducers[metricIndex]->isConditionSliced()) {
-                mAllMetricProducers[metricIndex]->onConditionChanged(conditionCache[i],
-                                                                     eventTimeNs);
-                // Metric cares about sliced conditions, and it may have changed. Send
-                // notification, and the metric can query the sliced conditions that are
-                // interesting to it.
-            } else {
-                mAllMetricProducers[metricIndex]->onSlicedConditionMayChange(conditionCache[i],
-                                                                             eventTimeNs);
+
+        // Reset only the entries this event touched. Evaluating an affected tracker can
+        // also fill its (transitive) children's cache entries, so reset its footprint.
+        for (const int i : mScratchAffectedConditions) {
+            for (const int j : mConditionEvalFootprint[i]) {
+                mScratchConditionCache[j] = ConditionState::kNotEvaluated;
+                mScratchConditionChanged[j] = false;
             }
+            mScratchConditionAffected[i] = false;
+            mScratchConditionEvents[i] = nullptr;
         }
     }
     // For matched AtomMatchers, tell relevant metrics that a matched event has come.
@@ -680,17 +1065,21 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
         if (matcherCache[i] == MatchingState::kMatched) {
             StatsdStats::getInstance().noteMatcherMatched(mConfigKey,
                                                           mAllAtomMatchingTrackers[i]->getId());
-            auto it = mTrackerToMetricMap.find(i);
-            if (it == mTrackerToMetricMap.end()) {
-                continue;
-            }
-            auto& metricList = it->second;
+            const vector<int>& metricList = mTrackerToMetricLists[i];
             const LogEvent& metricEvent =
                     matcherTransformations[i] == nullptr ? event : *matcherTransformations[i];
             for (const int metricIndex : metricList) {
                 // pushed metrics are never scheduled pulls
                 mAllMetricProducers[metricIndex]->onMatchedLogEvent(i, metricEvent);
             }
+            if (!mMatcherToBurstTrackers.empty()) {
+                const auto burstIt = mMatcherToBurstTrackers.find(i);
+                if (burstIt != mMatcherToBurstTrackers.end()) {
+                    for (const sp<BurstTracker>& burstTracker : burstIt->second) {
+                        burstTracker->noteMatchedEvent(metricEvent);
+                    }
+                }
+            }
         }
     }
 }
@@ -725,6 +1114,7 @@ void MetricsManager::loadActiveConfig(const ActiveConfig& config, int64_t curren
         ALOGW("No active metric for config %s", mConfigKey.ToString().c_str());
         return;
     }
+    mActivationVersion++;
 
     for (int i = 0; i < config.metric_size(); i++) {
         const auto& activeMetric = config.metric(i);
@@ -737,23 +1127,29 @@ void MetricsManager::loadActiveConfig(const ActiveConfig& config, int64_t curren
                     StatsdStats::getInstance().noteActiveStatusChanged(mConfigKey,
                                                                        /*activate=*/ true);
                 }
-                mIsActive |= metric->isActive();
+                if (metric->isActive()) {
+                    setMetricActiveBit(metricIndex);
+                    mIsActive = true;
+                }
             }
         }
     }
 }
 
-void MetricsManager::writeActiveConfigToProtoOutputStream(
+bool MetricsManager::writeActiveConfigToProtoOutputStream(
         int64_t currentTimeNs, const DumpReportReason reason, ProtoOutputStream* proto) {
+    bool timeDependent = false;
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_ACTIVE_CONFIG_ID, (long long)mConfigKey.GetId());
     proto->write(FIELD_TYPE_INT32 | FIELD_ID_ACTIVE_CONFIG_UID, mConfigKey.GetUid());
     for (int metricIndex : mMetricIndexesWithActivation) {
         const auto& metric = mAllMetricProducers[metricIndex];
         const uint64_t metricToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                 FIELD_ID_ACTIVE_CONFIG_METRIC);
-        metric->writeActiveMetricToProtoOutputStream(currentTimeNs, reason, proto);
+        timeDependent |=
+                metric->writeActiveMetricToProtoOutputStream(currentTimeNs, reason, proto);
         proto->end(metricToken);
     }
+    return timeDependent;
 }
 
 bool MetricsManager::writeMetadataToProto(int64_t currentWallClockTimeNs,
@@ -17,10 +17,13 @@
 #pragma once
 
 #include <unordered_map>
+#include <utility>
 
 #include "anomaly/AlarmMonitor.h"
 #include "anomaly/AlarmTracker.h"
 #include "anomaly/AnomalyTracker.h"
+#include "anomaly/BurstTracker.h"
+#include "condition/ConditionTimeline.h"
 #include "condition/ConditionTracker.h"
 #include "config/ConfigKey.h"
 #include "external/StatsPullerManager.h"
@@ -56,6 +59,36 @@ public:
 
     bool checkLogCredentials(const LogEvent& event);
 
+    // Pre-screen for the ingestion fan-out: whether any matcher in this config
+    // can match an event with the given tag id. This is the same "1st filter"
+    // onLogEvent() applies internally, exposed so the processor can skip the
+    // per-config instrumentation for managers that would drop the event anyway.
+    // Safe to call without the config shard lock: mTagIdsToMatchersMap is only
+    // rebuilt during the exclusive config-update phase.
+    inline bool interestedInAtom(int tagId) const {
+        return mTagIdsToMatchersMap.find(tagId) != mTagIdsToMatchersMap.end();
+    }
+
+    // Whether some metric still has its activation bit set. Such managers need
+    // to observe every event's timestamp (even for uninteresting tags) so that
+    // activations expire on time. Callers must hold the config's shard lock.
+    inline bool hasLiveActivations() const {
+        return anyMetricActiveBitSet();
+    }
+
+    // Whether any metric in this config is gated behind an activation at all.
+    // Static for a given config, unlike hasLiveActivations().
+    inline bool hasMetricActivations() const {
+        return !mMetricIndexesWithActivation.empty();
+    }
+
+    // Whether this config carries any alerts. Such configs have latency-sensitive
+    // anomaly detection riding on the event path and are fanned out ahead of
+    // bulk analytics configs.
+    inline bool hasAnomalyTrackers() const {
+        return !mAllAnomalyTrackers.empty();
+    }
+
     virtual void onLogEvent(const LogEvent& event);
 
     void onAnomalyAlarmFired(
@@ -96,6 +129,17 @@ public:
         return mHashStringsInReport;
     };
 
+    inline bool persistStringDictionaryInReport() const {
+        return mHashStringsInReport && mPersistStringDictionary;
+    };
+
+    // Removes from strSet the strings already uploaded with an earlier report of this
+    // config, leaving only the dictionary delta to serialize. When commit is true (the
+    // report erases data, i.e. it is a real upload) the remaining strings are recorded
+    // as uploaded. Once the dictionary hits its cap it is dropped and the report keeps
+    // its full string set, so the consumer never misses a mapping.
+    void filterReportedStrings(std::set<std::string>* strSet, bool commit);
+
     inline bool versionStringsInReport() const {
         return mVersionStringsInReport;
     };
@@ -130,6 +174,10 @@ public:
 
     virtual void dropData(const int64_t dropTimeNs);
 
+    // Shrinks over-provisioned containers across the metric producers. Part of
+    // the idle maintenance pass; does not change any metric data.
+    void trimMemory();
+
     virtual void onDumpReport(const int64_t dumpTimeNs, int64_t wallClockNs,
                               const bool include_current_partial_bucket, const bool erase_data,
                               const DumpLatency dumpLatency, std::set<string>* str_set,
@@ -147,9 +195,18 @@ public:
 
     void loadActiveConfig(const ActiveConfig& config, int64_t currentTimeNs);
 
-    void writeActiveConfigToProtoOutputStream(
+    // Returns true when the written bytes depend on currentTimeNs (some metric serialized
+    // a remaining activation TTL); see MetricProducer::writeActiveMetricToProtoOutputStream.
+    bool writeActiveConfigToProtoOutputStream(
             int64_t currentTimeNs, const DumpReportReason reason, ProtoOutputStream* proto);
 
+    // Counter bumped whenever stored activation state may have changed (an activation or
+    // deactivation matcher fired, or saved activations were loaded). Lets the processor
+    // reuse a cached serialized active-config segment while the version is unchanged.
+    inline int64_t getActivationVersion() const {
+        return mActivationVersion;
+    }
+
     // Returns true if at least one piece of metadata is written.
     bool writeMetadataToProto(int64_t currentWallClockTimeNs,
                               int64_t systemElapsedTimeNs,
@@ -203,6 +260,16 @@ private:
     bool mHashStringsInReport = false;
     bool mVersionStringsInReport = false;
     bool mInstallerInReport = false;
+    bool mPersistStringDictionary = false;
+
+    // Hashed strings already uploaded with an earlier report of this config; see
+    // filterReportedStrings(). Reset on config update so the next report re-seeds
+    // the consumer-side dictionary.
+    std::set<std::string> mUploadedReportStrings;
+
+    // Cap on mUploadedReportStrings to bound its memory. Reaching it disables the
+    // delta encoding until the dictionary is rebuilt from a later full upload.
+    static constexpr size_t kMaxUploadedReportStrings = 5000;
     uint8_t mPackageCertificateHashSizeBytes;
 
     int64_t mTtlNs;
@@ -221,6 +288,16 @@ private:
     // The pkg log sources from StatsdConfig.
     std::vector<std::string> mAllowedPkg;
 
+    // Interned uid-map ids for the entries of mAllowedPkg, rebuilt by
+    // initAllowedLogSources, so app change notifications can test package
+    // membership with an integer lookup instead of string comparisons.
+    std::set<int32_t> mAllowedPkgIds;
+
+    // True if some entry of mAllowedPkg had no interned id when mAllowedPkgIds was
+    // rebuilt (i.e. the package was not installed yet); those entries still need a
+    // string comparison until the next rebuild.
+    bool mHasUnresolvedAllowedPkg = false;
+
     // The combined uid sources (after translating pkg name to uid).
     // Logs from uids that are not in the list will be ignored to avoid spamming.
     std::set<int32_t> mAllowedLogSources;
@@ -251,6 +328,33 @@ private:
     // All event tags that are interesting to config metrics matchers.
     std::unordered_map<int, std::vector<int>> mTagIdsToMatchersMap;
 
+    // One step of a flattened per-tag-id matcher evaluation program. Steps are
+    // ordered so that children always precede their parents, which lets
+    // onLogEvent fill the matcher cache in one linear pass instead of
+    // recursively dispatching through CombinationAtomMatchingTrackers.
+    struct CompiledMatcherStep {
+        enum Kind {
+            // Evaluate the tracker against the event (leaf matchers).
+            kEvaluateMatcher,
+            // Apply the logical operation over already-computed child results.
+            kCombine,
+            // The matcher can never match this tag id; constant-folded at
+            // compile time.
+            kConstNotMatched,
+        };
+
+        // Index into mAllAtomMatchingTrackers; also the destination slot in the
+        // matcher cache.
+        int matcherIndex;
+        Kind kind;
+        LogicalOperation operation;
+        std::vector<int> childMatcherIndices;
+    };
+
+    // Flattened evaluation programs compiled from mTagIdsToMatchersMap, keyed by
+    // event tag id. Rebuilt on config creation/update.
+    std::unordered_map<int, std::vector<CompiledMatcherStep>> mCompiledMatcherPrograms;
+
     // We only store the sp of AtomMatchingTracker, MetricProducer, and ConditionTracker in
     // MetricsManager. There are relationships between them, and the relationships are denoted by
     // index instead of pointers. The reasons for this are: (1) the relationship between them are
@@ -307,20 +411,102 @@ private:
     // Maps from ConditionTracker to MetricProducer
     std::unordered_map<int, std::vector<int>> mConditionToMetricMap;
 
+    // Metric indexes taking part in the coordinated bucket rotation phase, and
+    // the earliest upcoming full-bucket end among them (INT64_MAX when there
+    // are none). When an event crosses that boundary, every due metric rotates
+    // in one pass instead of each rotating lazily on its next matched event.
+    std::vector<int> mCoordinatedRotationMetricIndexes;
+
+    int64_t mNextCoordinatedRotationTimeNs = INT64_MAX;
+
+    // Static evaluation footprint per condition tracker: the tracker itself
+    // plus the transitive children its evaluateCondition() may write to the
+    // condition cache. Built once per config (re)build and used to reset only
+    // the scratch entries an event actually touched.
+    std::vector<std::vector<int>> mConditionEvalFootprint;
+
+    // Scratch buffers for onLogEvent's condition pass, persisted across events
+    // so the pass does not allocate four vectors sized by the number of
+    // condition trackers for every event. Entries touched while handling an
+    // event are restored to their idle values (kNotEvaluated / false / nullptr)
+    // before the pass ends, so each event still starts from a clean cache.
+    std::vector<ConditionState> mScratchConditionCache;
+    std::vector<uint8_t> mScratchConditionChanged;
+    std::vector<uint8_t> mScratchConditionAffected;
+    std::vector<std::shared_ptr<LogEvent>> mScratchConditionEvents;
+    std::vector<int> mScratchAffectedConditions;
+
+    // One shared transition log per ConditionTracker index, for the condition
+    // trackers that feed at least one always-active metric with an unsliced
+    // condition. A condition change is appended here once, after the eager
+    // notifications, and the subscribed metrics replay it into their own
+    // ConditionTimer when they close a bucket. See ConditionTimeline.
+    std::unordered_map<int, std::shared_ptr<ConditionTimeline>> mConditionTimelines;
+
     // Maps from life span triggering event to MetricProducers.
     std::unordered_map<int, std::vector<int>> mActivationAtomTrackerToMetricMap;
 
     // Maps deactivation triggering event to MetricProducers.
     std::unordered_map<int, std::vector<int>> mDeactivationAtomTrackerToMetricMap;
 
+    // Frozen views of the five fan-out maps above, rebuilt by
+    // initTrackerIndexLists() on config creation/update. The maps are keyed by
+    // dense tracker/condition indexes and are immutable between updates, so the
+    // event path indexes a flat vector (empty list = no entry) instead of
+    // probing a hash table, and iterates compact (index, metric list) pair
+    // vectors that hold only the populated activation entries. The maps stay
+    // the source of truth for creation/update, which fill them by reference.
+    std::vector<std::vector<int>> mTrackerToMetricLists;
+    std::vector<std::vector<int>> mConditionToMetricLists;
+    std::vector<std::pair<int, std::vector<int>>> mTrackerToConditionEntries;
+    std::vector<std::pair<int, std::vector<int>>> mActivationTrackerToMetricEntries;
+    std::vector<std::pair<int, std::vector<int>>> mDeactivationTrackerToMetricEntries;
+
     // Maps AlertIds to the index of the corresponding AnomalyTracker stored in mAllAnomalyTrackers.
     // The map is used in LoadMetadata to more efficiently lookup AnomalyTrackers from an AlertId.
     std::unordered_map<int64_t, int> mAlertTrackerMap;
 
+    // Maps an AtomMatchingTracker index to the burst alerts watching that matcher.
+    // Burst trackers are also held in mAllAnomalyTrackers for subscription and
+    // metadata handling; this map is the per-event dispatch path.
+    std::unordered_map<int, std::vector<sp<BurstTracker>>> mMatcherToBurstTrackers;
+
     std::vector<int> mMetricIndexesWithActivation;
 
+    // See getActivationVersion().
+    int64_t mActivationVersion = 0;
+
+    // Packed activation bitmap over mAllMetricProducers: bit i mirrors
+    // mAllMetricProducers[i]->isActive() for the metrics in
+    // mMetricIndexesWithActivation. Kept in sync on activation transitions so the
+    // per-event "is anything still active" check is a couple of word tests instead
+    // of a virtual isActive() call on every producer. A stale set bit is harmless
+    // (the producer loop just revisits and clears it); bits are only ever set on
+    // the activate()/loadActiveMetric() paths, which update the bitmap in place.
+    std::vector<uint64_t> mActiveMetricsBitmap;
+
+    inline void setMetricActiveBit(int metricIndex) {
+        mActiveMetricsBitmap[metricIndex >> 6] |= (uint64_t)1 << (metricIndex & 0x3f);
+    }
+
+    inline void clearMetricActiveBit(int metricIndex) {
+        mActiveMetricsBitmap[metricIndex >> 6] &= ~((uint64_t)1 << (metricIndex & 0x3f));
+    }
+
+    inline bool anyMetricActiveBitSet() const {
+        for (const uint64_t word : mActiveMetricsBitmap) {
+            if (word != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     void initAllowedLogSources();
 
+    // Returns true if the given package is one of the allowed log sources.
+    bool isAllowedPkg(const std::string& pkg) const;
+
     void initPullAtomSources();
 
     // Only called on config creation/update to initialize log sources from the config.
@@ -336,6 +522,41 @@ private:
     // Should be called on config creation/update.
     void initializeConfigActiveStatus();
 
+    // Flattens the matcher graphs reachable from each entry of
+    // mTagIdsToMatchersMap into mCompiledMatcherPrograms.
+    // Should be called on config creation/update, after the matchers are built.
+    void compileMatcherPrograms();
+
+    // Rebuilds the frozen direct-index views of the tracker/condition fan-out
+    // maps. Should be called on config creation/update, after the maps are
+    // populated.
+    void initTrackerIndexLists();
+
+    // Rebuilds mConditionTimelines and subscribes the eligible metrics to them.
+    // Detaches every producer first, so on config update no preserved producer
+    // is left holding a cursor into a log this manager no longer appends to.
+    // Should be called on config creation/update, after the first buckets are
+    // prepared.
+    void initConditionTimelines();
+
+    // Rebuilds mCoordinatedRotationMetricIndexes and the cached earliest bucket
+    // boundary. Should be called on config creation/update.
+    void initCoordinatedRotation();
+
+    // Sizes the condition-pass scratch buffers and builds
+    // mConditionEvalFootprint. Should be called on config creation/update,
+    // after the condition trackers are built.
+    void initConditionEvaluationScratch();
+
+    // Runs the coordinated rotation pass if eventTimeNs crossed the cached
+    // earliest bucket boundary; one branch per event otherwise.
+    void rotateFullBucketsIfNeeded(int64_t eventTimeNs);
+
+    // Appends the steps for the given matcher (children first) to the program
+    // being compiled for tagId. visited guards against emitting a matcher twice.
+    void compileMatcherStep(int tagId, int matcherIndex, std::vector<uint8_t>& visited,
+                            std::vector<CompiledMatcherStep>& program);
+
     // The metrics that don't need to be uploaded or even reported.
     std::set<int64_t> mNoReportMetricIds;
 
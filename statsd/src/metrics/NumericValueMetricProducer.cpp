@@ -60,6 +60,71 @@ const int FIELD_ID_CONDITION_CORRECTION_NS = 11;
 const Value ZERO_LONG((int64_t)0);
 const Value ZERO_DOUBLE(0.0);
 
+// Aggregation kernels specialized per (aggregation type, value type) pair. getDoubleOrLong()
+// normalizes every extracted value to LONG or DOUBLE and a given metric's value type does not
+// change, so aggregateFields() can run a kernel selected at construction instead of re-dispatching
+// on the Value union tag and the aggregation type for every event.
+template <typename RawType>
+RawType getRaw(const Value& value);
+
+template <>
+int64_t getRaw<int64_t>(const Value& value) {
+    return value.long_value;
+}
+
+template <>
+double getRaw<double>(const Value& value) {
+    return value.double_value;
+}
+
+template <typename RawType>
+void setRaw(Value& value, RawType raw);
+
+template <>
+void setRaw<int64_t>(Value& value, int64_t raw) {
+    value.long_value = raw;
+}
+
+template <>
+void setRaw<double>(Value& value, double raw) {
+    value.double_value = raw;
+}
+
+template <typename RawType>
+void aggregateSum(Value& aggregate, const Value& value) {
+    setRaw<RawType>(aggregate, getRaw<RawType>(aggregate) + getRaw<RawType>(value));
+}
+
+template <typename RawType>
+void aggregateMin(Value& aggregate, const Value& value) {
+    if (getRaw<RawType>(value) < getRaw<RawType>(aggregate)) {
+        setRaw<RawType>(aggregate, getRaw<RawType>(value));
+    }
+}
+
+template <typename RawType>
+void aggregateMax(Value& aggregate, const Value& value) {
+    if (getRaw<RawType>(value) > getRaw<RawType>(aggregate)) {
+        setRaw<RawType>(aggregate, getRaw<RawType>(value));
+    }
+}
+
+NumericValueMetricProducer::AggregationFn NumericValueMetricProducer::selectAggregationFn(
+        const ValueMetric::AggregationType aggregationType, const Type valueType) {
+    switch (aggregationType) {
+        case ValueMetric::SUM:
+            // for AVG, we add up and take average when flushing the bucket
+        case ValueMetric::AVG:
+            return valueType == LONG ? aggregateSum<int64_t> : aggregateSum<double>;
+        case ValueMetric::MIN:
+            return valueType == LONG ? aggregateMin<int64_t> : aggregateMin<double>;
+        case ValueMetric::MAX:
+            return valueType == LONG ? aggregateMax<int64_t> : aggregateMax<double>;
+        default:
+            return nullptr;
+    }
+}
+
 // ValueMetric has a minimum bucket size of 10min so that we don't pull too frequently
 NumericValueMetricProducer::NumericValueMetricProducer(
         const ConfigKey& key, const ValueMetric& metric, const uint64_t protoHash,
@@ -71,6 +136,9 @@ NumericValueMetricProducer::NumericValueMetricProducer(
                           conditionOptions, stateOptions, activationOptions, guardrailOptions),
       mUseAbsoluteValueOnReset(metric.use_absolute_value_on_reset()),
       mAggregationType(metric.aggregation_type()),
+      mLongAggregationFn(selectAggregationFn(metric.aggregation_type(), LONG)),
+      mDoubleAggregationFn(selectAggregationFn(metric.aggregation_type(), DOUBLE)),
+      mComputeRate(metric.aggregation_type() == ValueMetric::RATE),
       mIncludeSampleSize(metric.has_include_sample_size()
                                  ? metric.include_sample_size()
                                  : metric.aggregation_type() == ValueMetric_AggregationType_AVG),
@@ -80,7 +148,8 @@ NumericValueMetricProducer::NumericValueMetricProducer(
       mUseZeroDefaultBase(metric.use_zero_default_base()),
       mHasGlobalBase(false),
       mMaxPullDelayNs(metric.has_max_pull_delay_sec() ? metric.max_pull_delay_sec() * NS_PER_SEC
-                                                      : StatsdStats::kPullMaxDelayNs) {
+                                                      : StatsdStats::kPullMaxDelayNs),
+      mPullStalenessToleranceNs(metric.pull_staleness_tolerance_millis() * 1000000) {
     // TODO(b/186677791): Use initializer list to initialize mUploadThreshold.
     if (metric.has_threshold()) {
         mUploadThreshold = metric.threshold();
@@ -166,7 +235,12 @@ void NumericValueMetricProducer::prepareFirstBucketLocked() {
 
 void NumericValueMetricProducer::pullAndMatchEventsLocked(const int64_t timestampNs) {
     vector<shared_ptr<LogEvent>> allData;
-    if (!mPullerManager->Pull(mPullAtomId, mConfigKey, timestampNs, &allData)) {
+    const bool pullSuccess =
+            mPullStalenessToleranceNs > 0
+                    ? mPullerManager->Pull(mPullAtomId, mConfigKey, timestampNs, &allData,
+                                           mPullStalenessToleranceNs)
+                    : mPullerManager->Pull(mPullAtomId, mConfigKey, timestampNs, &allData);
+    if (!pullSuccess) {
         ALOGE("Stats puller failed for tag: %d at %lld", mPullAtomId, (long long)timestampNs);
         invalidateCurrentBucket(timestampNs, BucketDropReason::PULL_FAILED);
         return;
@@ -218,6 +292,33 @@ void NumericValueMetricProducer::onDataPulled(const std::vector<std::shared_ptr<
     flushIfNeededLocked(originalPullTimeNs);
 }
 
+void NumericValueMetricProducer::onScheduledDataPulled(
+        const std::vector<std::shared_ptr<LogEvent>>& allData, PullResult pullResult,
+        int64_t originalPullTimeNs, int64_t scheduledPullTimeNs) {
+    {
+        lock_guard<mutex> lock(mMutex);
+        if (mCondition == ConditionState::kTrue && pullResult == PullResult::PULL_RESULT_SUCCESS) {
+            const int64_t currentBucketEndTimeNs = getCurrentBucketEndTimeNs();
+            if (scheduledPullTimeNs == currentBucketEndTimeNs &&
+                originalPullTimeNs >= currentBucketEndTimeNs &&
+                originalPullTimeNs < currentBucketEndTimeNs + mBucketSizeNs) {
+                // The alarm service delivered the boundary this metric registered
+                // and the alarm was not so late that a whole bucket was skipped:
+                // attribute the data to that boundary directly. This is the
+                // steady state; onDataPulled's snapping arithmetic remains only
+                // for misaligned or deeply delayed deliveries.
+                const int64_t bucketEndTimeNs = currentBucketEndTimeNs - 1;
+                StatsdStats::getInstance().noteBucketBoundaryDelayNs(
+                        mMetricId, originalPullTimeNs - bucketEndTimeNs);
+                accumulateEvents(allData, originalPullTimeNs, bucketEndTimeNs);
+                flushIfNeededLocked(originalPullTimeNs);
+                return;
+            }
+        }
+    }
+    onDataPulled(allData, pullResult, originalPullTimeNs);
+}
+
 void NumericValueMetricProducer::combineValueFields(pair<LogEvent, vector<int>>& eventValues,
                                                     const LogEvent& newEvent,
                                                     const vector<int>& newValueIndices) const {
@@ -260,16 +361,45 @@ void NumericValueMetricProducer::accumulateEvents(const vector<shared_ptr<LogEve
         return;
     }
 
+    if (mComputeRate) {
+        // Every pull contributes one rate sample per key: the diff over the
+        // window since the previous pull. All pull paths (bucket boundary,
+        // condition change, alarm) funnel through here, so this is the single
+        // place the window advances.
+        mCurrentRateWindowNs =
+                mPrevPullElapsedTimeNs >= 0 ? eventElapsedTimeNs - mPrevPullElapsedTimeNs : 0;
+        mPrevPullElapsedTimeNs = eventElapsedTimeNs;
+    }
+
     mMatchedMetricDimensionKeys.clear();
+    if (mConditionSliced) {
+        // The condition state cannot change while this batch is dispatched, so snapshot
+        // the sliced condition once and resolve it per row with a direct probe instead
+        // of a full wizard query per pulled event.
+        mBatchConditionProbe = mWizard->batchQuery(
+                mConditionTrackerIndex, !mHasLinksToAllConditionDimensionsInTracker);
+    }
+    // All rows of a pull carry the same atom id, so when the what matcher imposes
+    // no field constraints the per-row matcher dispatch is skipped for the batch.
+    const bool matchesAllRows =
+            mEventMatcherWizard->matchesTrivially(mWhatMatcherIndex, mPullAtomId);
     if (mUseDiff) {
         // An extra aggregation step is needed to sum values with matching dimensions
         // before calculating the diff between sums of consecutive pulls.
         std::unordered_map<HashableDimensionKey, pair<LogEvent, vector<int>>> aggregateEvents;
         for (const auto& data : allData) {
-            const auto [matchResult, transformedEvent] =
-                    mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex);
-            if (matchResult != MatchingState::kMatched) {
-                continue;
+            shared_ptr<LogEvent> transformedEvent;
+            if (matchesAllRows) {
+                if (data->GetTagId() != mPullAtomId) {
+                    continue;
+                }
+            } else {
+                auto [matchResult, matchedTransformedEvent] =
+                        mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex);
+                if (matchResult != MatchingState::kMatched) {
+                    continue;
+                }
+                transformedEvent = std::move(matchedTransformedEvent);
             }
 
             // Get dimensions_in_what key and value indices.
@@ -298,15 +428,25 @@ void NumericValueMetricProducer::accumulateEvents(const vector<shared_ptr<LogEve
         }
     } else {
         for (const auto& data : allData) {
-            const auto [matchResult, transformedEvent] =
-                    mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex);
-            if (matchResult == MatchingState::kMatched) {
-                LogEvent localCopy = transformedEvent == nullptr ? *data : *transformedEvent;
-                localCopy.setElapsedTimestampNs(eventElapsedTimeNs);
-                onMatchedLogEventLocked(mWhatMatcherIndex, localCopy);
+            shared_ptr<LogEvent> transformedEvent;
+            if (matchesAllRows) {
+                if (data->GetTagId() != mPullAtomId) {
+                    continue;
+                }
+            } else {
+                auto [matchResult, matchedTransformedEvent] =
+                        mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex);
+                if (matchResult != MatchingState::kMatched) {
+                    continue;
+                }
+                transformedEvent = std::move(matchedTransformedEvent);
             }
+            LogEvent localCopy = transformedEvent == nullptr ? *data : *transformedEvent;
+            localCopy.setElapsedTimestampNs(eventElapsedTimeNs);
+            onMatchedLogEventLocked(mWhatMatcherIndex, localCopy);
         }
     }
+    mBatchConditionProbe.reset();
 
     // If a key that is:
     // 1. Tracked in mCurrentSlicedBucket and
@@ -365,30 +505,24 @@ bool NumericValueMetricProducer::hitFullBucketGuardRailLocked(const MetricDimens
     return false;
 }
 
-bool getDoubleOrLong(const LogEvent& event, const Matcher& matcher, Value& ret) {
-    for (const FieldValue& value : event.getValues()) {
-        if (value.mField.matches(matcher)) {
-            switch (value.mValue.type) {
-                case INT:
-                    ret.setLong(value.mValue.int_value);
-                    break;
-                case LONG:
-                    ret.setLong(value.mValue.long_value);
-                    break;
-                case FLOAT:
-                    ret.setDouble(value.mValue.float_value);
-                    break;
-                case DOUBLE:
-                    ret.setDouble(value.mValue.double_value);
-                    break;
-                default:
-                    return false;
-                    break;
-            }
-            return true;
-        }
+bool getDoubleOrLong(const FieldValue& fieldValue, Value& ret) {
+    switch (fieldValue.mValue.type) {
+        case INT:
+            ret.setLong(fieldValue.mValue.int_value);
+            break;
+        case LONG:
+            ret.setLong(fieldValue.mValue.long_value);
+            break;
+        case FLOAT:
+            ret.setDouble(fieldValue.mValue.float_value);
+            break;
+        case DOUBLE:
+            ret.setDouble(fieldValue.mValue.double_value);
+            break;
+        default:
+            return false;
     }
-    return false;
+    return true;
 }
 
 bool NumericValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
@@ -399,6 +533,10 @@ bool NumericValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
         VLOG("Resizing number of bases to %zu", mFieldMatchers.size());
         bases.resize(mFieldMatchers.size());
     }
+    if (mComputeRate && intervals.size() < kNumRateSlots * mFieldMatchers.size()) {
+        // Each value field owns three output slots (min/max/avg rate).
+        intervals.resize(kNumRateSlots * mFieldMatchers.size());
+    }
 
     // We only use anomaly detection under certain cases.
     // N.B.: The anomaly detection cases were modified in order to fix an issue with value metrics
@@ -408,13 +546,17 @@ bool NumericValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
     // Discussion here: http://ag/6124370.
     bool useAnomalyDetection = true;
     bool seenNewData = false;
+    // Resolve every value field to its index once per event: a flat layout check
+    // against the cached plan instead of a mask-matching scan per field matcher.
+    const vector<FieldValue>& values = event.getValues();
+    mFieldMatchersIndexPlan.resolve(values, mScratchValueIndices);
     for (size_t i = 0; i < mFieldMatchers.size(); i++) {
-        const Matcher& matcher = mFieldMatchers[i];
         Interval& interval = intervals[i];
         interval.aggIndex = i;
         optional<Value>& base = bases[i];
         Value value;
-        if (!getDoubleOrLong(event, matcher, value)) {
+        const int32_t valueIndex = mScratchValueIndices[i];
+        if (valueIndex < 0 || !getDoubleOrLong(values[valueIndex], value)) {
             VLOG("Failed to get value %zu from event %s", i, event.ToString().c_str());
             StatsdStats::getInstance().noteBadValueType(mMetricId);
             return seenNewData;
@@ -477,21 +619,42 @@ bool NumericValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
             value = diff;
         }
 
+        if (mComputeRate) {
+            // A zero window means there is no previous pull to rate against
+            // (first pull of the metric); counter resets were already skipped
+            // by the direction checks above.
+            if (mCurrentRateWindowNs > 0) {
+                const double diffValue =
+                        value.type == LONG ? (double)value.long_value : value.double_value;
+                aggregateRate(intervals, i, diffValue * NS_PER_SEC / mCurrentRateWindowNs);
+            }
+            continue;
+        }
+
         if (interval.hasValue()) {
-            switch (mAggregationType) {
-                case ValueMetric::SUM:
-                    // for AVG, we add up and take average when flushing the bucket
-                case ValueMetric::AVG:
-                    interval.aggregate += value;
-                    break;
-                case ValueMetric::MIN:
-                    interval.aggregate = min(value, interval.aggregate);
-                    break;
-                case ValueMetric::MAX:
-                    interval.aggregate = max(value, interval.aggregate);
-                    break;
-                default:
-                    break;
+            if (value.type == interval.aggregate.type) {
+                const AggregationFn aggregationFn =
+                        value.type == LONG ? mLongAggregationFn : mDoubleAggregationFn;
+                if (aggregationFn != nullptr) {
+                    aggregationFn(interval.aggregate, value);
+                }
+            } else {
+                // The value type changed mid-metric; fall back to the generic Value operators.
+                switch (mAggregationType) {
+                    case ValueMetric::SUM:
+                        // for AVG, we add up and take average when flushing the bucket
+                    case ValueMetric::AVG:
+                        interval.aggregate += value;
+                        break;
+                    case ValueMetric::MIN:
+                        interval.aggregate = min(value, interval.aggregate);
+                        break;
+                    case ValueMetric::MAX:
+                        interval.aggregate = max(value, interval.aggregate);
+                        break;
+                    default:
+                        break;
+                }
             }
         } else {
             interval.aggregate = value;
@@ -516,6 +679,31 @@ bool NumericValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
     return seenNewData;
 }
 
+void NumericValueMetricProducer::aggregateRate(vector<Interval>& intervals,
+                                               const size_t fieldIndex, const double rate) {
+    Interval& minInterval = intervals[kNumRateSlots * fieldIndex + kRateMinOffset];
+    minInterval.aggIndex = kNumRateSlots * fieldIndex + kRateMinOffset;
+    if (!minInterval.hasValue() || rate < minInterval.aggregate.double_value) {
+        minInterval.aggregate.setDouble(rate);
+    }
+    minInterval.sampleSize += 1;
+
+    Interval& maxInterval = intervals[kNumRateSlots * fieldIndex + kRateMaxOffset];
+    maxInterval.aggIndex = kNumRateSlots * fieldIndex + kRateMaxOffset;
+    if (!maxInterval.hasValue() || rate > maxInterval.aggregate.double_value) {
+        maxInterval.aggregate.setDouble(rate);
+    }
+    maxInterval.sampleSize += 1;
+
+    // The avg slot sums rates; getFinalValue() divides by the sample count when
+    // the bucket is flushed.
+    Interval& avgInterval = intervals[kNumRateSlots * fieldIndex + kRateAvgOffset];
+    avgInterval.aggIndex = kNumRateSlots * fieldIndex + kRateAvgOffset;
+    avgInterval.aggregate.setDouble(
+            (avgInterval.hasValue() ? avgInterval.aggregate.double_value : 0) + rate);
+    avgInterval.sampleSize += 1;
+}
+
 PastBucket<Value> NumericValueMetricProducer::buildPartialBucket(int64_t bucketEndTimeNs,
                                                                  vector<Interval>& intervals) {
     PastBucket<Value> bucket;
@@ -529,9 +717,10 @@ PastBucket<Value> NumericValueMetricProducer::buildPartialBucket(int64_t bucketE
     }
 
     for (const Interval& interval : intervals) {
-        // skip the output if the diff is zero
+        // skip the output if the diff is zero. A zero rate is real data, so
+        // RATE buckets always upload their slots.
         if (!interval.hasValue() ||
-            (mSkipZeroDiffOutput && mUseDiff && interval.aggregate.isZero())) {
+            (mSkipZeroDiffOutput && mUseDiff && !mComputeRate && interval.aggregate.isZero())) {
             continue;
         }
 
@@ -575,6 +764,9 @@ void NumericValueMetricProducer::appendToFullBucket(const bool isFullBucketReach
     }
 
     if (isFullBucketReached) {  // If full bucket, send to anomaly tracker.
+        // Build the read-only flush view once and hand the same vector to every
+        // tracker, rather than re-walking the sliced bucket per tracker.
+        std::vector<AnomalyTracker::FlushedSlice> flushedSlices;
         // Accumulate partial buckets with current value and then send to anomaly tracker.
         if (mCurrentFullBucket.size() > 0) {
             for (const auto& [metricDimensionKey, currentBucket] : mCurrentSlicedBucket) {
@@ -588,30 +780,30 @@ void NumericValueMetricProducer::appendToFullBucket(const bool isFullBucketReach
                     mCurrentFullBucket[metricDimensionKey] += interval.aggregate.long_value;
                 }
             }
+            flushedSlices.reserve(mCurrentFullBucket.size());
             for (const auto& [metricDimensionKey, value] : mCurrentFullBucket) {
-                for (auto& tracker : mAnomalyTrackers) {
-                    if (tracker != nullptr) {
-                        tracker->addPastBucket(metricDimensionKey, value, mCurrentBucketNum);
-                    }
-                }
+                flushedSlices.push_back({&metricDimensionKey, value});
             }
-            mCurrentFullBucket.clear();
         } else {
             // Skip aggregating the partial buckets since there's no previous partial bucket.
+            flushedSlices.reserve(mCurrentSlicedBucket.size());
             for (const auto& [metricDimensionKey, currentBucket] : mCurrentSlicedBucket) {
-                for (auto& tracker : mAnomalyTrackers) {
-                    if (tracker != nullptr && !currentBucket.intervals.empty()) {
-                        // TODO: fix this when anomaly can accept double values
-                        auto& interval = currentBucket.intervals[0];
-                        if (interval.hasValue()) {
-                            tracker->addPastBucket(metricDimensionKey,
-                                                   interval.aggregate.long_value,
-                                                   mCurrentBucketNum);
-                        }
-                    }
+                if (currentBucket.intervals.empty()) {
+                    continue;
                 }
+                // TODO: fix this when anomaly can accept double values
+                auto& interval = currentBucket.intervals[0];
+                if (interval.hasValue()) {
+                    flushedSlices.push_back({&metricDimensionKey, interval.aggregate.long_value});
+                }
+            }
+        }
+        for (auto& tracker : mAnomalyTrackers) {
+            if (tracker != nullptr) {
+                tracker->addPastBucket(flushedSlices, mCurrentBucketNum);
             }
         }
+        mCurrentFullBucket.clear();
     } else {
         // Accumulate partial bucket.
         for (const auto& [metricDimensionKey, currentBucket] : mCurrentSlicedBucket) {
@@ -626,15 +818,6 @@ void NumericValueMetricProducer::appendToFullBucket(const bool isFullBucketReach
     }
 }
 
-size_t NumericValueMetricProducer::byteSizeLocked() const {
-    size_t totalSize = 0;
-    for (const auto& [_, buckets] : mPastBuckets) {
-        totalSize += buckets.size() * kBucketSize;
-        // TODO(b/189283526): Add bytes used to store PastBucket.aggIndex vector
-    }
-    return totalSize;
-}
-
 bool NumericValueMetricProducer::valuePassesThreshold(const Interval& interval) const {
     if (mUploadThreshold == nullopt) {
         return true;
@@ -664,7 +847,11 @@ bool NumericValueMetricProducer::valuePassesThreshold(const Interval& interval)
 }
 
 Value NumericValueMetricProducer::getFinalValue(const Interval& interval) const {
-    if (mAggregationType != ValueMetric::AVG) {
+    // The avg rate slot accumulates the per-pull rate sum; divide it by the
+    // sample count here, the same way plain AVG is finalized.
+    const bool isAvg = mAggregationType == ValueMetric::AVG ||
+                       (mComputeRate && interval.aggIndex % kNumRateSlots == kRateAvgOffset);
+    if (!isAvg) {
         return interval.aggregate;
     } else {
         double sum = interval.aggregate.type == LONG ? (double)interval.aggregate.long_value
@@ -42,6 +42,14 @@ public:
     void onDataPulled(const std::vector<std::shared_ptr<LogEvent>>& allData, PullResult pullResult,
                       int64_t originalPullTimeNs) override;
 
+    // Scheduled delivery carrying the registered boundary. When it is exactly
+    // this metric's current bucket end and the alarm was not late enough to
+    // skip into a later bucket, the data is attributed to that boundary
+    // directly; anything else falls back to onDataPulled's snapping logic.
+    void onScheduledDataPulled(const std::vector<std::shared_ptr<LogEvent>>& allData,
+                               PullResult pullResult, int64_t originalPullTimeNs,
+                               int64_t scheduledPullTimeNs) override;
+
     // Determine if metric needs to pull
     bool isPullNeeded() const override {
         std::lock_guard<std::mutex> lock(mMutex);
@@ -131,6 +139,18 @@ private:
                          const LogEvent& event, std::vector<Interval>& intervals,
                          ValueBases& bases) override;
 
+    // Typed aggregation kernel folding a new value into an interval's running aggregate. One
+    // instantiation exists per (aggregation type, value type) pair; see selectAggregationFn().
+    using AggregationFn = void (*)(Value& aggregate, const Value& value);
+
+    static AggregationFn selectAggregationFn(const ValueMetric::AggregationType aggregationType,
+                                             const Type valueType);
+
+    // Folds one per-second rate sample into the three output slots (min/max/avg)
+    // reserved for the given value field. Only used with RATE aggregation.
+    void aggregateRate(std::vector<Interval>& intervals, const size_t fieldIndex,
+                       const double rate);
+
     void pullAndMatchEventsLocked(const int64_t timestampNs) override;
 
     DumpProtoFields getDumpProtoFields() const override;
@@ -139,9 +159,6 @@ private:
                                          const int sampleSize,
                                          ProtoOutputStream* const protoOutput) const override;
 
-    // Internal function to calculate the current used bytes.
-    size_t byteSizeLocked() const override;
-
     void combineValueFields(pair<LogEvent, vector<int>>& eventValues, const LogEvent& newEvent,
                             const vector<int>& newValueIndices) const;
 
@@ -149,6 +166,17 @@ private:
 
     const ValueMetric::AggregationType mAggregationType;
 
+    // Aggregation kernels for LONG and DOUBLE values, picked once from mAggregationType so that
+    // per-event aggregation is a single typed add/min/max without union tag dispatch.
+    const AggregationFn mLongAggregationFn;
+
+    const AggregationFn mDoubleAggregationFn;
+
+    // True for RATE aggregation: the diff between each pair of consecutive pulls
+    // becomes a per-second rate sample, and every value field expands into
+    // kNumRateSlots output slots instead of one.
+    const bool mComputeRate;
+
     const bool mIncludeSampleSize;
 
     const bool mUseDiff;
@@ -171,6 +199,24 @@ private:
 
     const int64_t mMaxPullDelayNs;
 
+    // If positive, pulls for this metric may be served from a cached snapshot
+    // up to this old instead of hitting the puller.
+    const int64_t mPullStalenessToleranceNs;
+
+    // Output slot layout per value field for RATE aggregation.
+    static constexpr int kNumRateSlots = 3;
+    static constexpr int kRateMinOffset = 0;
+    static constexpr int kRateMaxOffset = 1;
+    static constexpr int kRateAvgOffset = 2;
+
+    // Elapsed timestamp of the previous processed pull; the rate window of each
+    // pull is measured against it. -1 until the first pull is seen.
+    int64_t mPrevPullElapsedTimeNs = -1;
+
+    // Rate window of the pull batch currently being accumulated, or 0 when
+    // there is no previous pull to rate against.
+    int64_t mCurrentRateWindowNs = 0;
+
     // For anomaly detection.
     std::unordered_map<MetricDimensionKey, int64_t> mCurrentFullBucket;
 
@@ -200,6 +246,7 @@ private:
     FRIEND_TEST(NumericValueMetricProducerTest, TestPulledEventsTakeAbsoluteValueOnReset);
     FRIEND_TEST(NumericValueMetricProducerTest, TestPulledEventsTakeZeroOnReset);
     FRIEND_TEST(NumericValueMetricProducerTest, TestPulledEventsWithFiltering);
+    FRIEND_TEST(NumericValueMetricProducerTest, TestPulledRateAggregation);
     FRIEND_TEST(NumericValueMetricProducerTest, TestPulledWithAppUpgradeDisabled);
     FRIEND_TEST(NumericValueMetricProducerTest, TestPushedAggregateAvg);
     FRIEND_TEST(NumericValueMetricProducerTest, TestPushedAggregateMax);
@@ -214,6 +261,7 @@ private:
     FRIEND_TEST(NumericValueMetricProducerTest, TestResetBaseOnPullFailBeforeConditionChange);
     FRIEND_TEST(NumericValueMetricProducerTest, TestResetBaseOnPullTooLate);
     FRIEND_TEST(NumericValueMetricProducerTest, TestSampleSize);
+    FRIEND_TEST(NumericValueMetricProducerTest, TestScheduledPullAtRegisteredBoundary);
     FRIEND_TEST(NumericValueMetricProducerTest, TestSkipZeroDiffOutput);
     FRIEND_TEST(NumericValueMetricProducerTest, TestSkipZeroDiffOutputMultiValue);
     FRIEND_TEST(NumericValueMetricProducerTest, TestSlicedState);
@@ -55,13 +55,39 @@ void RestrictedEventMetricProducer::onMatchedLogEventInternalLocked(
     if (mRestrictedDataCategory != CATEGORY_UNKNOWN &&
         mRestrictedDataCategory != event.getRestrictionCategory()) {
         StatsdStats::getInstance().noteRestrictedMetricCategoryChanged(mConfigKey, mMetricId);
+        // Commit first so the table drop is not blocked by the open streaming
+        // transaction on the cached connection.
+        string err;
+        dbutils::commitEventStream(mConfigKey, err);
+        mHasUncommittedRows = false;
         deleteMetricTable();
-        mLogEvents.clear();
-        mTotalSize = 0;
     }
     mRestrictedDataCategory = event.getRestrictionCategory();
-    mLogEvents.push_back(event);
-    mTotalSize += getSize(event.getValues()) + sizeof(event);
+    if (!mIsMetricTableCreated) {
+        if (!dbutils::isEventCompatible(mConfigKey, mMetricId, event)) {
+            // Delete old data if schema changes
+            // TODO(b/268150038): report error to statsdstats
+            ALOGD("Detected schema change for metric %lld", (long long)mMetricId);
+            deleteMetricTable();
+        }
+        // TODO(b/271481944): add retry.
+        string err;
+        if (!dbutils::createTableIfNeededStreamed(mConfigKey, mMetricId, event, err)) {
+            ALOGE("Failed to create table for metric %lld", (long long)mMetricId);
+            StatsdStats::getInstance().noteRestrictedMetricTableCreationError(mConfigKey,
+                                                                              mMetricId);
+            return;
+        }
+        mIsMetricTableCreated = true;
+    }
+    string err;
+    if (!dbutils::insertEventStreamed(mConfigKey, mMetricId, event, err)) {
+        ALOGE("Failed to insert logEvent to table for metric %lld. err=%s", (long long)mMetricId,
+              err.c_str());
+        StatsdStats::getInstance().noteRestrictedMetricInsertError(mConfigKey, mMetricId);
+        return;
+    }
+    mHasUncommittedRows = true;
 }
 
 void RestrictedEventMetricProducer::onDumpReportLocked(
@@ -76,11 +102,19 @@ void RestrictedEventMetricProducer::onMetricRemove() {
     if (!mIsMetricTableCreated) {
         return;
     }
+    // Release the streaming transaction's writer lock so the drop can proceed.
+    string err;
+    dbutils::commitEventStream(mConfigKey, err);
+    mHasUncommittedRows = false;
     deleteMetricTable();
 }
 
 void RestrictedEventMetricProducer::enforceRestrictedDataTtl(sqlite3* db,
                                                              const int64_t wallClockNs) {
+    // The ttl delete runs on its own connection; commit any streamed rows first
+    // so it is not starved by the streaming transaction's writer lock.
+    string err;
+    dbutils::commitEventStream(mConfigKey, err);
     int32_t ttlInDays = RestrictedPolicyManager::getInstance().getRestrictedCategoryTtl(
             mRestrictedDataCategory);
     int64_t ttlTime = wallClockNs - ttlInDays * NS_PER_DAY;
@@ -92,44 +126,36 @@ void RestrictedEventMetricProducer::clearPastBucketsLocked(const int64_t dumpTim
 }
 
 void RestrictedEventMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
-    mLogEvents.clear();
-    mTotalSize = 0;
+    // Streamed rows are already bound into the metric table; committing them
+    // here lets the ttl sweep reclaim them instead of discarding the whole
+    // shared transaction, which could hold rows from other restricted metrics
+    // on this config.
+    string err;
+    dbutils::commitEventStream(mConfigKey, err);
+    mHasUncommittedRows = false;
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
 }
 
 void RestrictedEventMetricProducer::flushRestrictedData() {
     std::lock_guard<std::mutex> lock(mMutex);
-    if (mLogEvents.empty()) {
+    flushRestrictedDataLocked();
+}
+
+void RestrictedEventMetricProducer::flushRestrictedDataLocked() {
+    if (!mHasUncommittedRows) {
         return;
     }
     int64_t flushStartNs = getElapsedRealtimeNs();
-    if (!mIsMetricTableCreated) {
-        if (!dbutils::isEventCompatible(mConfigKey, mMetricId, mLogEvents[0])) {
-            // Delete old data if schema changes
-            // TODO(b/268150038): report error to statsdstats
-            ALOGD("Detected schema change for metric %lld", (long long)mMetricId);
-            deleteMetricTable();
-        }
-        // TODO(b/271481944): add retry.
-        if (!dbutils::createTableIfNeeded(mConfigKey, mMetricId, mLogEvents[0])) {
-            ALOGE("Failed to create table for metric %lld", (long long)mMetricId);
-            StatsdStats::getInstance().noteRestrictedMetricTableCreationError(mConfigKey,
-                                                                              mMetricId);
-            return;
-        }
-        mIsMetricTableCreated = true;
-    }
     string err;
-    if (!dbutils::insert(mConfigKey, mMetricId, mLogEvents, err)) {
-        ALOGE("Failed to insert logEvent to table for metric %lld. err=%s", (long long)mMetricId,
+    if (!dbutils::commitEventStream(mConfigKey, err)) {
+        ALOGE("Failed to commit streamed rows for metric %lld. err=%s", (long long)mMetricId,
               err.c_str());
         StatsdStats::getInstance().noteRestrictedMetricInsertError(mConfigKey, mMetricId);
     } else {
         StatsdStats::getInstance().noteRestrictedMetricFlushLatency(
                 mConfigKey, mMetricId, getElapsedRealtimeNs() - flushStartNs);
     }
-    mLogEvents.clear();
-    mTotalSize = 0;
+    mHasUncommittedRows = false;
 }
 
 bool RestrictedEventMetricProducer::writeMetricMetadataToProto(
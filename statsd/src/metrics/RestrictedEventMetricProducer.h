@@ -4,6 +4,7 @@
 #include <gtest/gtest_prod.h>
 
 #include "EventMetricProducer.h"
+#include "utils/DbUtils.h"
 #include "utils/RestrictedPolicyManager.h"
 
 namespace android {
@@ -54,11 +55,17 @@ private:
 
     void deleteMetricTable();
 
+    void flushRestrictedDataLocked();
+
     bool mIsMetricTableCreated = false;
 
     StatsdRestrictionCategory mRestrictedDataCategory;
 
-    vector<LogEvent> mLogEvents;
+    // Whether rows have been streamed into the db since the last flush. Rows
+    // are bound into the insert statement as they arrive, inside a long-lived
+    // transaction committed on the flush cadence, so nothing is retained in
+    // RAM between flushes.
+    bool mHasUncommittedRows = false;
 };
 
 }  // namespace statsd
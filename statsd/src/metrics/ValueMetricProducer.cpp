@@ -25,6 +25,7 @@
 
 #include "FieldValue.h"
 #include "HashableDimensionKey.h"
+#include "HistogramValue.h"
 #include "guardrail/StatsdStats.h"
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "stats_log_util.h"
@@ -86,7 +87,11 @@ ValueMetricProducer<AggregatedValue, DimExtras>::ValueMetricProducer(
       mEventMatcherWizard(whatOptions.matcherWizard),
       mPullerManager(pullOptions.pullerManager),
       mFieldMatchers(whatOptions.fieldMatchers),
+      mFieldMatchersIndexPlan(whatOptions.fieldMatchers),
       mPullAtomId(pullOptions.pullAtomId),
+      mPastBuckets(typename PastBucketMap<AggregatedValue>::allocator_type(
+              ArenaAllocator<std::pair<const MetricDimensionKey,
+                                       PastBucketColumns<AggregatedValue>>>(&mPastBucketArena))),
       mMinBucketSizeNs(bucketOptions.minBucketSizeNs),
       mDimensionSoftLimit(guardrailOptions.dimensionSoftLimit),
       mDimensionHardLimit(guardrailOptions.dimensionHardLimit),
@@ -282,11 +287,22 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::dropDataLocked(const int64
     clearPastBucketsLocked(dropTimeNs);
 }
 
+template <typename AggregatedValue, typename DimExtras>
+void ValueMetricProducer<AggregatedValue, DimExtras>::trimMemoryLocked() {
+    // mPastBuckets is arena-backed and released wholesale at dump time, so only
+    // the per-dimension tracking maps can hold burst-time slack.
+    shrinkMapIfOverProvisioned(mCurrentSlicedBucket);
+    shrinkMapIfOverProvisioned(mDimInfos);
+}
+
 template <typename AggregatedValue, typename DimExtras>
 void ValueMetricProducer<AggregatedValue, DimExtras>::clearPastBucketsLocked(
         const int64_t dumpTimeNs) {
-    mPastBuckets.clear();
+    // The map's own tables live in the arena, so rebuild it empty before releasing the chunks.
+    mPastBuckets = PastBucketMap<AggregatedValue>(mPastBuckets.get_allocator());
+    mPastBucketArena.reset();
     mSkippedBuckets.clear();
+    mTotalSize = 0;
 }
 
 template <typename AggregatedValue, typename DimExtras>
@@ -439,8 +455,10 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
 
     VLOG("metric %lld done with dump report...", (long long)mMetricId);
     if (eraseData) {
-        mPastBuckets.clear();
+        mPastBuckets = PastBucketMap<AggregatedValue>(mPastBuckets.get_allocator());
+        mPastBucketArena.reset();
         mSkippedBuckets.clear();
+        mTotalSize = 0;
     }
 }
 
@@ -815,8 +833,9 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::closeCurrentBucket(
                 bucket.mConditionCorrectionNs = globalConditionCorrectionNs;
             }
 
-            auto& bucketList = mPastBuckets[metricDimensionKey];
-            bucketList.push_back(std::move(bucket));
+            // Size the bucket before its aggregates are moved into the columnar store.
+            mTotalSize += computePastBucketSizeLocked(bucket);
+            mPastBuckets[metricDimensionKey].push_back(std::move(bucket));
         }
         if (!bucketHasData) {
             skipCurrentBucket(eventTimeNs, BucketDropReason::NO_DATA);
@@ -893,6 +912,7 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::initNextSlicedBucket(
 // Explicit template instantiations
 template class ValueMetricProducer<Value, vector<optional<Value>>>;
 template class ValueMetricProducer<unique_ptr<KllQuantile>, Empty>;
+template class ValueMetricProducer<HistogramValue, Empty>;
 
 }  // namespace statsd
 }  // namespace os
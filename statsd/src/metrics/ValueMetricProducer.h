@@ -19,6 +19,7 @@
 #include <gtest/gtest_prod.h>
 
 #include <optional>
+#include <scoped_allocator>
 
 #include "FieldValue.h"
 #include "HashableDimensionKey.h"
@@ -31,6 +32,7 @@
 #include "src/statsd_config.pb.h"
 #include "stats_log_util.h"
 #include "stats_util.h"
+#include "utils/ChunkArena.h"
 
 namespace android {
 namespace os {
@@ -58,6 +60,165 @@ struct PastBucket {
     int64_t mConditionCorrectionNs;
 };
 
+// Read-only span over one column of a PastBucketColumns row.
+template <typename T>
+struct BucketColumn {
+    const T* mData = nullptr;
+    size_t mCount = 0;
+
+    size_t size() const {
+        return mCount;
+    }
+    bool empty() const {
+        return mCount == 0;
+    }
+    const T& operator[](size_t index) const {
+        return mData[index];
+    }
+};
+
+// Columnar, append-only storage for the past buckets of one dimension. Instead of a
+// vector of PastBucket structs — each dragging three small heap vectors that mostly hold
+// a single element — the bucket fields are kept in parallel arrays and the aggregate
+// entries of all buckets are flattened into shared columns indexed by per-bucket offsets.
+// This cuts the per-datapoint overhead to a few scalars and lets onDumpReport serialize
+// with a linear scan. Rows are read back through View, which mirrors the PastBucket field
+// names.
+template <typename AggregatedValue>
+class PastBucketColumns {
+public:
+    using allocator_type = ArenaAllocator<AggregatedValue>;
+
+    explicit PastBucketColumns(const allocator_type& alloc)
+        : mStartNs(alloc),
+          mEndNs(alloc),
+          mConditionTrueNs(alloc),
+          mConditionCorrectionNs(alloc),
+          mAggOffsets(alloc),
+          mAggIndex(alloc),
+          mAggregates(alloc),
+          mSampleSizes(alloc) {
+        mAggOffsets.push_back(0);
+    }
+
+    // Read-only row view; field names match PastBucket so consumers read like before.
+    struct View {
+        int64_t mBucketStartNs;
+        int64_t mBucketEndNs;
+        int64_t mConditionTrueNs;
+        int64_t mConditionCorrectionNs;
+        BucketColumn<int> aggIndex;
+        BucketColumn<AggregatedValue> aggregates;
+        BucketColumn<int> sampleSizes;
+    };
+
+    void push_back(PastBucket<AggregatedValue>&& bucket) {
+        const size_t oldAggCount = mAggOffsets.back();
+        mStartNs.push_back(bucket.mBucketStartNs);
+        mEndNs.push_back(bucket.mBucketEndNs);
+        mConditionTrueNs.push_back(bucket.mConditionTrueNs);
+        mConditionCorrectionNs.push_back(bucket.mConditionCorrectionNs);
+        for (size_t i = 0; i < bucket.aggIndex.size(); i++) {
+            mAggIndex.push_back(bucket.aggIndex[i]);
+            mAggregates.push_back(std::move(bucket.aggregates[i]));
+        }
+        // The sample size column is only materialized when some bucket carries sample
+        // sizes; rows without them are zero-filled to keep the columns aligned.
+        if (!bucket.sampleSizes.empty()) {
+            mSampleSizes.resize(oldAggCount, 0);
+            mSampleSizes.insert(mSampleSizes.end(), bucket.sampleSizes.begin(),
+                                bucket.sampleSizes.end());
+        } else if (!mSampleSizes.empty()) {
+            mSampleSizes.resize(oldAggCount + bucket.aggIndex.size(), 0);
+        }
+        mAggOffsets.push_back(oldAggCount + bucket.aggIndex.size());
+    }
+
+    size_t size() const {
+        return mStartNs.size();
+    }
+
+    bool empty() const {
+        return mStartNs.empty();
+    }
+
+    View operator[](size_t index) const {
+        const uint32_t aggBegin = mAggOffsets[index];
+        const uint32_t aggCount = mAggOffsets[index + 1] - aggBegin;
+        const bool hasSampleSizes = !mSampleSizes.empty();
+        return View{mStartNs[index],
+                    mEndNs[index],
+                    mConditionTrueNs[index],
+                    mConditionCorrectionNs[index],
+                    {mAggIndex.data() + aggBegin, aggCount},
+                    {mAggregates.data() + aggBegin, aggCount},
+                    {hasSampleSizes ? mSampleSizes.data() + aggBegin : nullptr,
+                     hasSampleSizes ? aggCount : 0}};
+    }
+
+    View back() const {
+        return (*this)[size() - 1];
+    }
+
+    class const_iterator {
+    public:
+        const_iterator(const PastBucketColumns* columns, size_t index)
+            : mColumns(columns), mIndex(index) {
+        }
+        View operator*() const {
+            return (*mColumns)[mIndex];
+        }
+        const_iterator& operator++() {
+            ++mIndex;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const {
+            return mIndex == other.mIndex;
+        }
+        bool operator!=(const const_iterator& other) const {
+            return mIndex != other.mIndex;
+        }
+
+    private:
+        const PastBucketColumns* mColumns;
+        size_t mIndex;
+    };
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+private:
+    template <typename T>
+    using ColumnVector = std::vector<T, ArenaAllocator<T>>;
+
+    ColumnVector<int64_t> mStartNs;
+    ColumnVector<int64_t> mEndNs;
+    ColumnVector<int64_t> mConditionTrueNs;
+    ColumnVector<int64_t> mConditionCorrectionNs;
+    // mAggOffsets[i] is the first index of bucket i in the flattened aggregate columns;
+    // always holds size() + 1 entries so counts come from adjacent offsets.
+    ColumnVector<uint32_t> mAggOffsets;
+    ColumnVector<int> mAggIndex;
+    ColumnVector<AggregatedValue> mAggregates;
+    ColumnVector<int> mSampleSizes;
+};
+
+// Past buckets are append-only between dump reports and cleared wholesale, so their
+// storage — the map's tables and the per-dimension columns — comes from a per-producer
+// ChunkArena instead of the general heap. The scoped allocator threads the arena through
+// to the nested columns.
+template <typename AggregatedValue>
+using PastBucketMap = std::unordered_map<
+        MetricDimensionKey, PastBucketColumns<AggregatedValue>, std::hash<MetricDimensionKey>,
+        std::equal_to<MetricDimensionKey>,
+        std::scoped_allocator_adaptor<ArenaAllocator<
+                std::pair<const MetricDimensionKey, PastBucketColumns<AggregatedValue>>>>>;
+
 // Aggregates values within buckets.
 //
 // There are different events that might complete a bucket
@@ -132,6 +293,12 @@ public:
     void onStateChanged(int64_t eventTimeNs, int32_t atomId, const HashableDimensionKey& primaryKey,
                         const FieldValue& oldState, const FieldValue& newState) override;
 
+    // Pushed value metrics rotate like count metrics; pulled ones must pull at
+    // the bucket boundary first, so they stay on their own flush path.
+    bool supportsCoordinatedRotation() const override {
+        return !isPulled();
+    }
+
 protected:
     ValueMetricProducer(int64_t metricId, const ConfigKey& key, uint64_t protoHash,
                         const PullOptions& pullOptions, const BucketOptions& bucketOptions,
@@ -203,6 +370,8 @@ protected:
 
     void dropDataLocked(const int64_t dropTimeNs) override;
 
+    void trimMemoryLocked() override;
+
     // Calculate how many buckets are present between the current bucket and eventTimeNs.
     int64_t calcBucketsForwardCount(const int64_t eventTimeNs) const;
 
@@ -248,6 +417,13 @@ protected:
     // Value fields for matching.
     const std::vector<Matcher> mFieldMatchers;
 
+    // Cached matcher-to-index resolution for mFieldMatchers; see ValueIndexPlan.
+    // Guarded by mMutex like the aggregation state it feeds.
+    ValueIndexPlan mFieldMatchersIndexPlan;
+
+    // Scratch for the per-event resolved value indices; guarded by mMutex.
+    std::vector<int32_t> mScratchValueIndices;
+
     // Value fields for matching.
     std::set<HashableDimensionKey> mMatchedMetricDimensionKeys;
 
@@ -313,8 +489,16 @@ protected:
     // Tracks current state key and other information for each DimensionsInWhat key.
     std::unordered_map<HashableDimensionKey, DimensionsInWhatInfo> mDimInfos;
 
+    // Arena backing mPastBuckets; released wholesale whenever the past buckets are cleared.
+    // Declared before mPastBuckets so the container is destroyed first.
+    ChunkArena mPastBucketArena;
+
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
-    std::unordered_map<MetricDimensionKey, std::vector<PastBucket<AggregatedValue>>> mPastBuckets;
+    PastBucketMap<AggregatedValue> mPastBuckets;
+
+    // Running byte size of mPastBuckets, maintained where buckets are added or cleared so
+    // that byteSizeLocked() is a constant-time read.
+    size_t mTotalSize = 0;
 
     const int64_t mMinBucketSizeNs;
 
@@ -344,6 +528,17 @@ protected:
                                                  const int sampleSize,
                                                  ProtoOutputStream* const protoOutput) const = 0;
 
+    size_t byteSizeLocked() const override {
+        return mTotalSize;
+    }
+
+    // Bytes the given past bucket contributes to byteSizeLocked(), recorded once when the
+    // bucket is appended to mPastBuckets.
+    // TODO(b/189283526): Add bytes used to store PastBucket.aggIndex vector
+    virtual size_t computePastBucketSizeLocked(const PastBucket<AggregatedValue>& bucket) const {
+        return kBucketSize;
+    }
+
     static const size_t kBucketSize = sizeof(PastBucket<AggregatedValue>{});
 
     const size_t mDimensionSoftLimit;
@@ -71,37 +71,75 @@ struct DurationValues {
     DurationValues() : mDuration(0), mDurationFullBucket(0){};
 };
 
+// Metric-wide configuration shared by all duration trackers of one metric.
+// DurationMetricProducer owns one instance and hands every tracker a shared_ptr
+// to it, so each dimension slice only stores its own mutable state instead of a
+// copy of the metric-wide fields and anomaly tracker list.
+struct DurationTrackerContext {
+    DurationTrackerContext(const ConfigKey& configKey, const int64_t trackerId,
+                           const sp<ConditionWizard>& wizard, int conditionTrackerIndex,
+                           bool nested, int64_t startTimeNs, int64_t bucketSizeNs,
+                           bool conditionSliced, bool hasLinksToAllConditionDimensionsInTracker,
+                           const std::vector<sp<AnomalyTracker>>& anomalyTrackers)
+        : configKey(configKey),
+          trackerId(trackerId),
+          wizard(wizard),
+          conditionTrackerIndex(conditionTrackerIndex),
+          nested(nested),
+          startTimeNs(startTimeNs),
+          bucketSizeNs(bucketSizeNs),
+          conditionSliced(conditionSliced),
+          hasLinksToAllConditionDimensionsInTracker(hasLinksToAllConditionDimensionsInTracker),
+          anomalyTrackers(anomalyTrackers) {
+    }
+
+    const ConfigKey configKey;
+
+    const int64_t trackerId;
+
+    // Updated in place by the owning metric producer on config updates.
+    sp<ConditionWizard> wizard;
+
+    int conditionTrackerIndex;
+
+    const bool nested;
+
+    const int64_t startTimeNs;
+
+    const int64_t bucketSizeNs;
+
+    const bool conditionSliced;
+
+    const bool hasLinksToAllConditionDimensionsInTracker;
+
+    std::vector<sp<AnomalyTracker>> anomalyTrackers;
+};
+
 class DurationTracker {
 public:
+    DurationTracker(const std::shared_ptr<DurationTrackerContext>& context,
+                    const MetricDimensionKey& eventKey, int64_t currentBucketStartNs,
+                    int64_t currentBucketNum)
+        : mContext(context),
+          mEventKey(eventKey),
+          mCurrentBucketStartTimeNs(currentBucketStartNs),
+          mCurrentBucketNum(currentBucketNum),
+          mHasHitGuardrail(false){};
+
+    // Convenience constructor that builds a dedicated context for this tracker.
+    // Production code shares one context across all trackers of a metric.
     DurationTracker(const ConfigKey& key, const int64_t id, const MetricDimensionKey& eventKey,
                     const sp<ConditionWizard>& wizard, int conditionIndex, bool nesting,
                     int64_t currentBucketStartNs, int64_t currentBucketNum, int64_t startTimeNs,
                     int64_t bucketSizeNs, bool conditionSliced, bool fullLink,
                     const std::vector<sp<AnomalyTracker>>& anomalyTrackers)
-        : mConfigKey(key),
-          mTrackerId(id),
-          mEventKey(eventKey),
-          mWizard(wizard),
-          mConditionTrackerIndex(conditionIndex),
-          mBucketSizeNs(bucketSizeNs),
-          mNested(nesting),
-          mCurrentBucketStartTimeNs(currentBucketStartNs),
-          mCurrentBucketNum(currentBucketNum),
-          mStartTimeNs(startTimeNs),
-          mConditionSliced(conditionSliced),
-          mHasLinksToAllConditionDimensionsInTracker(fullLink),
-          mAnomalyTrackers(anomalyTrackers),
-          mHasHitGuardrail(false){};
+        : DurationTracker(std::make_shared<DurationTrackerContext>(
+                                  key, id, wizard, conditionIndex, nesting, startTimeNs,
+                                  bucketSizeNs, conditionSliced, fullLink, anomalyTrackers),
+                          eventKey, currentBucketStartNs, currentBucketNum){};
 
     virtual ~DurationTracker(){};
 
-    void onConfigUpdated(const sp<ConditionWizard>& wizard, int conditionTrackerIndex) {
-        sp<ConditionWizard> tmpWizard = mWizard;
-        mWizard = wizard;
-        mConditionTrackerIndex = conditionTrackerIndex;
-        mAnomalyTrackers.clear();
-    };
-
     virtual void noteStart(const HashableDimensionKey& key, bool condition, int64_t eventTime,
                            const ConditionKey& conditionKey, size_t dimensionHardLimit) = 0;
     virtual void noteStop(const HashableDimensionKey& key, int64_t eventTime,
@@ -142,9 +180,11 @@ public:
 
     virtual bool hasAccumulatedDuration() const = 0;
 
+    // Schedules alarms for a newly added anomaly tracker. The tracker itself is
+    // appended to the shared context by the owning metric producer, once per
+    // metric rather than once per slice.
     void addAnomalyTracker(sp<AnomalyTracker>& anomalyTracker, const UpdateStatus& updateStatus,
                            const int64_t updateTimeNs) {
-        mAnomalyTrackers.push_back(anomalyTracker);
         // Preserved anomaly trackers will have the correct alarm times.
         // New/replaced alerts will need to set alarms for pending durations, or may have already
         // fired if the full bucket duration is high enough.
@@ -163,12 +203,12 @@ protected:
     virtual bool hasStartedDuration() const = 0;
 
     int64_t getCurrentBucketEndTimeNs() const {
-        return mStartTimeNs + (mCurrentBucketNum + 1) * mBucketSizeNs;
+        return mContext->startTimeNs + (mCurrentBucketNum + 1) * mContext->bucketSizeNs;
     }
 
     // Starts the anomaly alarm.
     void startAnomalyAlarm(const int64_t eventTime) {
-        for (auto& anomalyTracker : mAnomalyTrackers) {
+        for (auto& anomalyTracker : mContext->anomalyTrackers) {
             if (anomalyTracker != nullptr) {
                 const int64_t alarmTimestampNs =
                     predictAnomalyTimestampNs(*anomalyTracker, eventTime);
@@ -181,7 +221,7 @@ protected:
 
     // Stops the anomaly alarm. If it should have already fired, declare the anomaly now.
     void stopAnomalyAlarm(const int64_t timestamp) {
-        for (auto& anomalyTracker : mAnomalyTrackers) {
+        for (auto& anomalyTracker : mContext->anomalyTrackers) {
             if (anomalyTracker != nullptr) {
                 anomalyTracker->stopAlarm(mEventKey, timestamp);
             }
@@ -190,7 +230,7 @@ protected:
 
     void addPastBucketToAnomalyTrackers(const MetricDimensionKey& eventKey, int64_t bucketValue,
                                         int64_t bucketNum) {
-        for (auto& anomalyTracker : mAnomalyTrackers) {
+        for (auto& anomalyTracker : mContext->anomalyTrackers) {
             if (anomalyTracker != nullptr) {
                 anomalyTracker->addPastBucket(eventKey, bucketValue, bucketNum);
             }
@@ -199,9 +239,9 @@ protected:
 
     void detectAndDeclareAnomaly(int64_t timestamp, int64_t currBucketNum,
                                  int64_t currentBucketValue) {
-        for (auto& anomalyTracker : mAnomalyTrackers) {
+        for (auto& anomalyTracker : mContext->anomalyTrackers) {
             if (anomalyTracker != nullptr) {
-                anomalyTracker->detectAndDeclareAnomaly(timestamp, currBucketNum, mTrackerId,
+                anomalyTracker->detectAndDeclareAnomaly(timestamp, currBucketNum, mContext->trackerId,
                                                         mEventKey, currentBucketValue);
             }
         }
@@ -210,7 +250,7 @@ protected:
     // Convenience to compute the current bucket's end time, which is always aligned with the
     // start time of the metric.
     int64_t getCurrentBucketEndTimeNs() {
-        return mStartTimeNs + (mCurrentBucketNum + 1) * mBucketSizeNs;
+        return mContext->startTimeNs + (mCurrentBucketNum + 1) * mContext->bucketSizeNs;
     }
 
     void setEventKey(const MetricDimensionKey& eventKey) {
@@ -242,21 +282,11 @@ protected:
         }
     }
 
-    // A reference to the DurationMetricProducer's config key.
-    const ConfigKey& mConfigKey;
-
-    const int64_t mTrackerId;
+    // Metric-wide configuration shared with all other trackers of this metric.
+    std::shared_ptr<DurationTrackerContext> mContext;
 
     MetricDimensionKey mEventKey;
 
-    sp<ConditionWizard> mWizard;
-
-    int mConditionTrackerIndex;
-
-    const int64_t mBucketSizeNs;
-
-    const bool mNested;
-
     int64_t mCurrentBucketStartTimeNs;
 
     // Recorded duration results for each state key in the current partial bucket.
@@ -264,14 +294,6 @@ protected:
 
     int64_t mCurrentBucketNum;
 
-    const int64_t mStartTimeNs;
-
-    const bool mConditionSliced;
-
-    bool mHasLinksToAllConditionDimensionsInTracker;
-
-    std::vector<sp<AnomalyTracker>> mAnomalyTrackers;
-
     mutable bool mHasHitGuardrail;
 
     FRIEND_TEST(OringDurationTrackerTest, TestPredictAnomalyTimestamp);
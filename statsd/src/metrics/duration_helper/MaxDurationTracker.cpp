@@ -24,6 +24,13 @@ namespace android {
 namespace os {
 namespace statsd {
 
+MaxDurationTracker::MaxDurationTracker(const std::shared_ptr<DurationTrackerContext>& context,
+                                       const MetricDimensionKey& eventKey,
+                                       int64_t currentBucketStartNs, int64_t currentBucketNum)
+    : DurationTracker(context, eventKey, currentBucketStartNs, currentBucketNum) {
+    mDuration = 0;
+}
+
 MaxDurationTracker::MaxDurationTracker(const ConfigKey& key, const int64_t id,
                                        const MetricDimensionKey& eventKey,
                                        const sp<ConditionWizard>& wizard, int conditionIndex,
@@ -47,15 +54,15 @@ bool MaxDurationTracker::hitGuardRail(const HashableDimensionKey& newKey,
     // 1. Report the tuple count if the tuple count > soft limit
     if (mInfos.size() >= StatsdStats::kDimensionKeySizeSoftLimit) {
         size_t newTupleCount = mInfos.size() + 1;
-        StatsdStats::getInstance().noteMetricDimensionSize(mConfigKey, mTrackerId, newTupleCount);
+        StatsdStats::getInstance().noteMetricDimensionSize(mContext->configKey, mContext->trackerId, newTupleCount);
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (newTupleCount > dimensionHardLimit) {
             if (!mHasHitGuardrail) {
                 ALOGE("MaxDurTracker %lld dropping data for dimension key %s",
-                      (long long)mTrackerId, newKey.toString().c_str());
+                      (long long)mContext->trackerId, newKey.toString().c_str());
                 mHasHitGuardrail = true;
             }
-            StatsdStats::getInstance().noteHardDimensionLimitReached(mTrackerId);
+            StatsdStats::getInstance().noteHardDimensionLimitReached(mContext->trackerId);
             return true;
         }
     }
@@ -71,7 +78,7 @@ void MaxDurationTracker::noteStart(const HashableDimensionKey& key, bool conditi
     }
 
     DurationInfo& duration = mInfos[key];
-    if (mConditionSliced) {
+    if (mContext->conditionSliced) {
         duration.conditionKeys = conditionKey;
     }
     VLOG("MaxDuration: key %s start condition %d", key.toString().c_str(), condition);
@@ -90,6 +97,7 @@ void MaxDurationTracker::noteStart(const HashableDimensionKey& key, bool conditi
             } else {
                 duration.state = DurationState::kStarted;
                 duration.lastStartTime = eventTime;
+                mStartedInfoCount++;
                 startAnomalyAlarm(eventTime);
             }
             duration.startCount = 1;
@@ -112,9 +120,10 @@ void MaxDurationTracker::noteStop(const HashableDimensionKey& key, const int64_t
             break;
         case DurationState::kStarted: {
             duration.startCount--;
-            if (forceStop || !mNested || duration.startCount <= 0) {
+            if (forceStop || !mContext->nested || duration.startCount <= 0) {
                 stopAnomalyAlarm(eventTime);
                 duration.state = DurationState::kStopped;
+                mStartedInfoCount--;
                 int64_t durationTime = eventTime - duration.lastStartTime;
                 VLOG("Max, key %s, Stop %lld %lld %lld", key.toString().c_str(),
                      (long long)duration.lastStartTime, (long long)eventTime,
@@ -131,7 +140,7 @@ void MaxDurationTracker::noteStop(const HashableDimensionKey& key, const int64_t
         }
         case DurationState::kPaused: {
             duration.startCount--;
-            if (forceStop || !mNested || duration.startCount <= 0) {
+            if (forceStop || !mContext->nested || duration.startCount <= 0) {
                 duration.state = DurationState::kStopped;
             }
             break;
@@ -150,12 +159,7 @@ void MaxDurationTracker::noteStop(const HashableDimensionKey& key, const int64_t
 }
 
 bool MaxDurationTracker::hasStartedDuration() const {
-    for (auto& pair : mInfos) {
-        if (pair.second.state == kStarted) {
-            return true;
-        }
-    }
-    return false;
+    return mStartedInfoCount > 0;
 }
 
 bool MaxDurationTracker::hasAccumulatedDuration() const {
@@ -165,11 +169,13 @@ bool MaxDurationTracker::hasAccumulatedDuration() const {
 }
 
 void MaxDurationTracker::noteStopAll(const int64_t eventTime) {
-    std::set<HashableDimensionKey> keys;
+    // Copy the keys out first: noteStop erases stopped entries from mInfos.
+    std::vector<HashableDimensionKey> keys;
+    keys.reserve(mInfos.size());
     for (const auto& pair : mInfos) {
-        keys.insert(pair.first);
+        keys.push_back(pair.first);
     }
-    for (auto& key : keys) {
+    for (const auto& key : keys) {
         noteStop(key, eventTime, true);
     }
 }
@@ -185,7 +191,7 @@ bool MaxDurationTracker::flushCurrentBucket(
     int64_t fullBucketEnd = getCurrentBucketEndTimeNs();
     int64_t currentBucketEndTimeNs;
     if (eventTimeNs >= fullBucketEnd) {
-        numBucketsForward = 1 + (eventTimeNs - fullBucketEnd) / mBucketSizeNs;
+        numBucketsForward = 1 + (eventTimeNs - fullBucketEnd) / mContext->bucketSizeNs;
         currentBucketEndTimeNs = fullBucketEnd;
     } else {
         // This must be a partial bucket.
@@ -219,7 +225,7 @@ bool MaxDurationTracker::flushCurrentBucket(
     }
 
     if (numBucketsForward > 0) {
-        mCurrentBucketStartTimeNs = fullBucketEnd + (numBucketsForward - 1) * mBucketSizeNs;
+        mCurrentBucketStartTimeNs = fullBucketEnd + (numBucketsForward - 1) * mContext->bucketSizeNs;
         mCurrentBucketNum += numBucketsForward;
     } else {  // We must be forming a partial bucket.
         mCurrentBucketStartTimeNs = eventTimeNs;
@@ -247,9 +253,9 @@ void MaxDurationTracker::onSlicedConditionMayChange(const int64_t timestamp) {
         if (pair.second.state == kStopped) {
             continue;
         }
-        ConditionState conditionState = mWizard->query(
-            mConditionTrackerIndex, pair.second.conditionKeys,
-            !mHasLinksToAllConditionDimensionsInTracker);
+        ConditionState conditionState = mContext->wizard->query(
+            mContext->conditionTrackerIndex, pair.second.conditionKeys,
+            !mContext->hasLinksToAllConditionDimensionsInTracker);
         bool conditionMet = (conditionState == ConditionState::kTrue);
 
         VLOG("key: %s, condition: %d", pair.first.toString().c_str(), conditionMet);
@@ -282,6 +288,7 @@ void MaxDurationTracker::noteConditionChanged(const HashableDimensionKey& key, b
             if (!conditionMet) {
                 stopAnomalyAlarm(timestamp);
                 it->second.state = DurationState::kPaused;
+                mStartedInfoCount--;
                 it->second.lastDuration += (timestamp - it->second.lastStartTime);
                 if (hasStartedDuration()) {
                     // In case any other dimensions are still started, we need to set the alarm.
@@ -299,6 +306,7 @@ void MaxDurationTracker::noteConditionChanged(const HashableDimensionKey& key, b
             if (conditionMet) {
                 it->second.state = DurationState::kStarted;
                 it->second.lastStartTime = timestamp;
+                mStartedInfoCount++;
                 startAnomalyAlarm(timestamp);
                 VLOG("MaxDurationTracker Key: %s Paused->Started", key.toString().c_str());
             }
@@ -28,6 +28,10 @@ namespace statsd {
 // they stop or bucket expires.
 class MaxDurationTracker : public DurationTracker {
 public:
+    MaxDurationTracker(const std::shared_ptr<DurationTrackerContext>& context,
+                       const MetricDimensionKey& eventKey, int64_t currentBucketStartNs,
+                       int64_t currentBucketNum);
+
     MaxDurationTracker(const ConfigKey& key, const int64_t id, const MetricDimensionKey& eventKey,
                        const sp<ConditionWizard>& wizard, int conditionIndex, bool nesting,
                        int64_t currentBucketStartNs, int64_t currentBucketNum, int64_t startTimeNs,
@@ -76,6 +80,11 @@ private:
 
     int64_t mDuration;  // current recorded duration result (for partial bucket)
 
+    // Number of mInfos entries currently in kStarted. Closed intervals already fold
+    // into mDuration and get erased eagerly, so this counter and mDuration together
+    // answer the per-stop and per-condition-change queries without scanning the map.
+    int mStartedInfoCount = 0;
+
     void noteConditionChanged(const HashableDimensionKey& key, bool conditionMet,
                               const int64_t timestamp);
 
@@ -16,6 +16,9 @@
 #define STATSD_DEBUG false
 #include "Log.h"
 #include "OringDurationTracker.h"
+
+#include <iterator>
+
 #include "guardrail/StatsdStats.h"
 
 namespace android {
@@ -24,6 +27,15 @@ namespace statsd {
 
 using std::pair;
 
+OringDurationTracker::OringDurationTracker(const std::shared_ptr<DurationTrackerContext>& context,
+                                           const MetricDimensionKey& eventKey,
+                                           int64_t currentBucketStartNs, int64_t currentBucketNum)
+    : DurationTracker(context, eventKey, currentBucketStartNs, currentBucketNum),
+      mStarted(),
+      mPaused() {
+    mLastStartTime = 0;
+}
+
 OringDurationTracker::OringDurationTracker(const ConfigKey& key, const int64_t id,
                                            const MetricDimensionKey& eventKey,
                                            const sp<ConditionWizard>& wizard, int conditionIndex,
@@ -49,15 +61,15 @@ bool OringDurationTracker::hitGuardRail(const HashableDimensionKey& newKey,
     }
     if (mConditionKeyMap.size() >= StatsdStats::kDimensionKeySizeSoftLimit) {
         size_t newTupleCount = mConditionKeyMap.size() + 1;
-        StatsdStats::getInstance().noteMetricDimensionSize(mConfigKey, mTrackerId, newTupleCount);
+        StatsdStats::getInstance().noteMetricDimensionSize(mContext->configKey, mContext->trackerId, newTupleCount);
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (newTupleCount > dimensionHardLimit) {
             if (!mHasHitGuardrail) {
                 ALOGE("OringDurTracker %lld dropping data for dimension key %s",
-                      (long long)mTrackerId, newKey.toString().c_str());
+                      (long long)mContext->trackerId, newKey.toString().c_str());
                 mHasHitGuardrail = true;
             }
-            StatsdStats::getInstance().noteHardDimensionLimitReached(mTrackerId);
+            StatsdStats::getInstance().noteHardDimensionLimitReached(mContext->trackerId);
             return true;
         }
     }
@@ -81,7 +93,7 @@ void OringDurationTracker::noteStart(const HashableDimensionKey& key, bool condi
         mPaused[key]++;
     }
 
-    if (mConditionSliced && mConditionKeyMap.find(key) == mConditionKeyMap.end()) {
+    if (mContext->conditionSliced && mConditionKeyMap.find(key) == mConditionKeyMap.end()) {
         mConditionKeyMap[key] = conditionKey;
     }
     VLOG("Oring: %s start, condition %d", key.toString().c_str(), condition);
@@ -93,7 +105,7 @@ void OringDurationTracker::noteStop(const HashableDimensionKey& key, const int64
     auto it = mStarted.find(key);
     if (it != mStarted.end()) {
         (it->second)--;
-        if (stopAll || !mNested || it->second <= 0) {
+        if (stopAll || !mContext->nested || it->second <= 0) {
             mStarted.erase(it);
             mConditionKeyMap.erase(key);
         }
@@ -112,7 +124,7 @@ void OringDurationTracker::noteStop(const HashableDimensionKey& key, const int64
     auto pausedIt = mPaused.find(key);
     if (pausedIt != mPaused.end()) {
         (pausedIt->second)--;
-        if (stopAll || !mNested || pausedIt->second <= 0) {
+        if (stopAll || !mContext->nested || pausedIt->second <= 0) {
             mPaused.erase(pausedIt);
             mConditionKeyMap.erase(key);
         }
@@ -155,7 +167,7 @@ bool OringDurationTracker::flushCurrentBucket(
 
     bool isFullBucket = eventTimeNs >= fullBucketEnd;
     if (isFullBucket) {
-        numBucketsForward = 1 + (eventTimeNs - fullBucketEnd) / mBucketSizeNs;
+        numBucketsForward = 1 + (eventTimeNs - fullBucketEnd) / mContext->bucketSizeNs;
         currentBucketEndTimeNs = fullBucketEnd;
     } else {
         // This must be a partial bucket.
@@ -198,16 +210,16 @@ bool OringDurationTracker::flushCurrentBucket(
         durationIt.second.mDuration = 0;
     }
     // Full bucket is only needed when we have anomaly trackers.
-    if (isFullBucket || mAnomalyTrackers.empty()) {
+    if (isFullBucket || mContext->anomalyTrackers.empty()) {
         mStateKeyDurationMap.clear();
     }
 
     if (mStarted.size() > 0) {
         for (int i = 1; i < numBucketsForward; i++) {
             DurationBucket info;
-            info.mBucketStartNs = fullBucketEnd + mBucketSizeNs * (i - 1);
-            info.mBucketEndNs = info.mBucketStartNs + mBucketSizeNs;
-            info.mDuration = mBucketSizeNs;
+            info.mBucketStartNs = fullBucketEnd + mContext->bucketSizeNs * (i - 1);
+            info.mBucketEndNs = info.mBucketStartNs + mContext->bucketSizeNs;
+            info.mDuration = mContext->bucketSizeNs;
             // Full duration buckets are attributed to the current stateKey.
             (*output)[mEventKey].push_back(info);
             // Safe to send these buckets to anomaly tracker since they must be full buckets.
@@ -222,7 +234,7 @@ bool OringDurationTracker::flushCurrentBucket(
     }
 
     if (numBucketsForward > 0) {
-        mCurrentBucketStartTimeNs = fullBucketEnd + (numBucketsForward - 1) * mBucketSizeNs;
+        mCurrentBucketStartTimeNs = fullBucketEnd + (numBucketsForward - 1) * mContext->bucketSizeNs;
         mCurrentBucketNum += numBucketsForward;
     } else {  // We must be forming a partial bucket.
         mCurrentBucketStartTimeNs = eventTimeNs;
@@ -234,9 +246,9 @@ bool OringDurationTracker::flushCurrentBucket(
     // If all stopped, then tell owner it's safe to remove this tracker on a full bucket.
     // On a partial bucket, only clear if no anomaly trackers, as full bucket duration is used
     // for anomaly detection.
-    // Note: Anomaly trackers can be added on config updates, in which case mAnomalyTrackers > 0 and
+    // Note: Anomaly trackers can be added on config updates, in which case mContext->anomalyTrackers > 0 and
     // the full bucket duration could be used, but this is very rare so it is okay to clear.
-    return mStarted.empty() && mPaused.empty() && (isFullBucket || mAnomalyTrackers.size() == 0);
+    return mStarted.empty() && mPaused.empty() && (isFullBucket || mContext->anomalyTrackers.size() == 0);
 }
 
 bool OringDurationTracker::flushIfNeeded(
@@ -249,8 +261,12 @@ bool OringDurationTracker::flushIfNeeded(
 }
 
 void OringDurationTracker::onSlicedConditionMayChange(const int64_t timestamp) {
-    vector<pair<HashableDimensionKey, int>> startedToPaused;
-    vector<pair<HashableDimensionKey, int>> pausedToStarted;
+    // Reuse the member scratch capacity; this runs for every tracker of the
+    // metric on each condition change.
+    vector<pair<HashableDimensionKey, int>>& startedToPaused = mStartedToPausedScratch;
+    vector<pair<HashableDimensionKey, int>>& pausedToStarted = mPausedToStartedScratch;
+    startedToPaused.clear();
+    pausedToStarted.clear();
     if (!mStarted.empty()) {
         for (auto it = mStarted.begin(); it != mStarted.end();) {
             const auto& key = it->first;
@@ -261,8 +277,8 @@ void OringDurationTracker::onSlicedConditionMayChange(const int64_t timestamp) {
                 continue;
             }
             ConditionState conditionState =
-                mWizard->query(mConditionTrackerIndex, condIt->second,
-                               !mHasLinksToAllConditionDimensionsInTracker);
+                mContext->wizard->query(mContext->conditionTrackerIndex, condIt->second,
+                               !mContext->hasLinksToAllConditionDimensionsInTracker);
             if (conditionState != ConditionState::kTrue) {
                 startedToPaused.push_back(*it);
                 it = mStarted.erase(it);
@@ -293,8 +309,8 @@ void OringDurationTracker::onSlicedConditionMayChange(const int64_t timestamp) {
                 continue;
             }
             ConditionState conditionState =
-                mWizard->query(mConditionTrackerIndex, mConditionKeyMap[key],
-                               !mHasLinksToAllConditionDimensionsInTracker);
+                mContext->wizard->query(mContext->conditionTrackerIndex, mConditionKeyMap[key],
+                               !mContext->hasLinksToAllConditionDimensionsInTracker);
             if (conditionState == ConditionState::kTrue) {
                 pausedToStarted.push_back(*it);
                 it = mPaused.erase(it);
@@ -312,8 +328,12 @@ void OringDurationTracker::onSlicedConditionMayChange(const int64_t timestamp) {
     if (mStarted.empty() && !pausedToStarted.empty()) {
         startAnomalyAlarm(timestamp);
     }
-    mStarted.insert(pausedToStarted.begin(), pausedToStarted.end());
-    mPaused.insert(startedToPaused.begin(), startedToPaused.end());
+    // Move the keys back in rather than copying them; the scratch vectors are
+    // cleared on the next call anyway.
+    mStarted.insert(std::make_move_iterator(pausedToStarted.begin()),
+                    std::make_move_iterator(pausedToStarted.end()));
+    mPaused.insert(std::make_move_iterator(startedToPaused.begin()),
+                   std::make_move_iterator(startedToPaused.end()));
 
     if (mStarted.empty()) {
         stopAnomalyAlarm(timestamp);
@@ -330,16 +350,26 @@ void OringDurationTracker::onConditionChanged(bool condition, const int64_t time
             if (mStarted.empty() && !mPaused.empty()) {
                 startAnomalyAlarm(timestamp);
             }
-            mStarted.insert(mPaused.begin(), mPaused.end());
-            mPaused.clear();
+            if (mStarted.empty()) {
+                // Common case: everything was paused; adopt the map wholesale
+                // instead of copying the keys over one by one.
+                mStarted.swap(mPaused);
+            } else {
+                mStarted.insert(mPaused.begin(), mPaused.end());
+                mPaused.clear();
+            }
         }
     } else {
         if (!mStarted.empty()) {
             VLOG("Condition false, all paused");
             mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
                     (timestamp - mLastStartTime);
-            mPaused.insert(mStarted.begin(), mStarted.end());
-            mStarted.clear();
+            if (mPaused.empty()) {
+                mPaused.swap(mStarted);
+            } else {
+                mPaused.insert(mStarted.begin(), mStarted.end());
+                mStarted.clear();
+            }
             detectAndDeclareAnomaly(
                     timestamp, mCurrentBucketNum,
                     getCurrentStateKeyDuration() + getCurrentStateKeyFullBucketDuration());
@@ -425,9 +455,9 @@ int64_t OringDurationTracker::predictAnomalyTimestampNs(const AnomalyTracker& an
         // 2. it is not within the refractory period.
         // 3. the alarm timestamp falls in this bucket. Otherwise we need to flush the past buckets,
         //    find the new alarm candidate timestamp and check these requirements again.
-        const int64_t bucketEndNs = currentBucketEndNs + futureBucketIdx * mBucketSizeNs;
+        const int64_t bucketEndNs = currentBucketEndNs + futureBucketIdx * mContext->bucketSizeNs;
         int64_t anomalyTimestampNs =
-            std::max(bucketEndNs - mBucketSizeNs + thresholdNs - pastNs, refractoryPeriodEndNs);
+            std::max(bucketEndNs - mContext->bucketSizeNs + thresholdNs - pastNs, refractoryPeriodEndNs);
         if (anomalyTimestampNs <= bucketEndNs) {
             return anomalyTimestampNs;
         }
@@ -437,7 +467,7 @@ int64_t OringDurationTracker::predictAnomalyTimestampNs(const AnomalyTracker& an
 
         // No valid alarm timestamp is found in this bucket. The clock moves to the end of the
         // bucket. Update the pastNs.
-        pastNs += mBucketSizeNs;
+        pastNs += mContext->bucketSizeNs;
         // 1. If the oldest past bucket is still in the past bucket window, we could fetch the past
         // bucket and erase it from pastNs.
         // 2. If the oldest past bucket is the current bucket, we should compute the
@@ -26,6 +26,10 @@ namespace statsd {
 // Tracks the "Or'd" duration -- if 2 durations are overlapping, they won't be double counted.
 class OringDurationTracker : public DurationTracker {
 public:
+    OringDurationTracker(const std::shared_ptr<DurationTrackerContext>& context,
+                         const MetricDimensionKey& eventKey, int64_t currentBucketStartNs,
+                         int64_t currentBucketNum);
+
     OringDurationTracker(const ConfigKey& key, const int64_t id, const MetricDimensionKey& eventKey,
                          const sp<ConditionWizard>& wizard, int conditionIndex, bool nesting,
                          int64_t currentBucketStartNs, int64_t currentBucketNum,
@@ -80,6 +84,12 @@ private:
     int64_t mLastStartTime;
     std::unordered_map<HashableDimensionKey, ConditionKey> mConditionKeyMap;
 
+    // Scratch storage for onSlicedConditionMayChange(), which runs once per condition
+    // change for every tracker of the metric. Kept as members so the capacity is
+    // reused across calls instead of reallocated each time.
+    std::vector<std::pair<HashableDimensionKey, int>> mStartedToPausedScratch;
+    std::vector<std::pair<HashableDimensionKey, int>> mPausedToStartedScratch;
+
     // return true if we should not allow newKey to be tracked because we are above the threshold
     bool hitGuardRail(const HashableDimensionKey& newKey, size_t dimensionHardLimit) const;
 
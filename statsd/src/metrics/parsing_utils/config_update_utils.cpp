@@ -126,8 +126,6 @@ optional<InvalidConfigReason> updateAtomMatchingTrackers(
         unordered_map<int64_t, int>& newAtomMatchingTrackerMap,
         vector<sp<AtomMatchingTracker>>& newAtomMatchingTrackers, set<int64_t>& replacedMatchers) {
     const int atomMatcherCount = config.atom_matcher_size();
-    vector<AtomMatcher> matcherProtos;
-    matcherProtos.reserve(atomMatcherCount);
     newAtomMatchingTrackers.reserve(atomMatcherCount);
     optional<InvalidConfigReason> invalidConfigReason;
 
@@ -140,7 +138,6 @@ optional<InvalidConfigReason> updateAtomMatchingTrackers(
                                                         matcher.id());
         }
         newAtomMatchingTrackerMap[matcher.id()] = i;
-        matcherProtos.push_back(matcher);
     }
 
     // For combination matchers, we need to determine if any children need to be updated.
@@ -171,7 +168,7 @@ optional<InvalidConfigReason> updateAtomMatchingTrackers(
                 const sp<AtomMatchingTracker>& tracker =
                         oldAtomMatchingTrackers[oldAtomMatchingTrackerIt->second];
                 invalidConfigReason =
-                        tracker->onConfigUpdated(matcherProtos[i], newAtomMatchingTrackerMap);
+                        tracker->onConfigUpdated(matcher, newAtomMatchingTrackerMap);
                 if (invalidConfigReason.has_value()) {
                     ALOGW("Config update failed for matcher %lld", (long long)id);
                     return invalidConfigReason;
@@ -204,7 +201,7 @@ optional<InvalidConfigReason> updateAtomMatchingTrackers(
     for (size_t matcherIndex = 0; matcherIndex < newAtomMatchingTrackers.size(); matcherIndex++) {
         auto& matcher = newAtomMatchingTrackers[matcherIndex];
         const auto [invalidConfigReason, _] =
-                matcher->init(matcherIndex, matcherProtos, newAtomMatchingTrackers,
+                matcher->init(matcherIndex, config.atom_matcher(), newAtomMatchingTrackers,
                               newAtomMatchingTrackerMap, cycleTracker);
         if (invalidConfigReason.has_value()) {
             return invalidConfigReason;
@@ -351,9 +348,7 @@ optional<InvalidConfigReason> updateConditions(
         vector<sp<ConditionTracker>>& newConditionTrackers,
         unordered_map<int, vector<int>>& trackerToConditionMap,
         vector<ConditionState>& conditionCache, set<int64_t>& replacedConditions) {
-    vector<Predicate> conditionProtos;
     const int conditionTrackerCount = config.predicate_size();
-    conditionProtos.reserve(conditionTrackerCount);
     newConditionTrackers.reserve(conditionTrackerCount);
     conditionCache.assign(conditionTrackerCount, ConditionState::kNotEvaluated);
     optional<InvalidConfigReason> invalidConfigReason;
@@ -366,7 +361,6 @@ optional<InvalidConfigReason> updateConditions(
                                                           condition.id());
         }
         newConditionTrackerMap[condition.id()] = i;
-        conditionProtos.push_back(condition);
     }
 
     vector<UpdateStatus> conditionsToUpdate(conditionTrackerCount, UPDATE_UNKNOWN);
@@ -424,7 +418,7 @@ optional<InvalidConfigReason> updateConditions(
     // Update indices of preserved predicates.
     for (const int conditionIndex : preservedConditions) {
         invalidConfigReason = newConditionTrackers[conditionIndex]->onConfigUpdated(
-                conditionProtos, conditionIndex, newConditionTrackers, atomMatchingTrackerMap,
+                config.predicate(), conditionIndex, newConditionTrackers, atomMatchingTrackerMap,
                 newConditionTrackerMap);
         if (invalidConfigReason.has_value()) {
             ALOGE("Failed to update condition %lld",
@@ -438,7 +432,7 @@ optional<InvalidConfigReason> updateConditions(
         const sp<ConditionTracker>& conditionTracker = newConditionTrackers[conditionIndex];
         // Calling init on preserved conditions is OK. It is needed to fill the condition cache.
         invalidConfigReason =
-                conditionTracker->init(conditionProtos, newConditionTrackers,
+                conditionTracker->init(config.predicate(), newConditionTrackers,
                                        newConditionTrackerMap, cycleTracker, conditionCache);
         if (invalidConfigReason.has_value()) {
             return invalidConfigReason;
@@ -1081,6 +1075,14 @@ optional<InvalidConfigReason> determineAlertUpdateStatus(
         const Alert& alert, const unordered_map<int64_t, int>& oldAlertTrackerMap,
         const vector<sp<AnomalyTracker>>& oldAnomalyTrackers, const set<int64_t>& replacedMetrics,
         UpdateStatus& updateStatus) {
+    // Burst alerts are always recreated: their matcher index may have shifted in
+    // the new config, and their in-flight ring state only spans a sub-second
+    // window, so preserving it is not worth tracking matcher replacement.
+    if (alert.has_atom_matcher_id()) {
+        updateStatus = UPDATE_REPLACE;
+        return nullopt;
+    }
+
     // Check if new alert.
     const auto& oldAnomalyTrackerIt = oldAlertTrackerMap.find(alert.id());
     if (oldAnomalyTrackerIt == oldAlertTrackerMap.end()) {
@@ -1116,15 +1118,17 @@ optional<InvalidConfigReason> determineAlertUpdateStatus(
     return nullopt;
 }
 
-optional<InvalidConfigReason> updateAlerts(const StatsdConfig& config, const int64_t currentTimeNs,
-                                           const unordered_map<int64_t, int>& metricProducerMap,
-                                           const set<int64_t>& replacedMetrics,
-                                           const unordered_map<int64_t, int>& oldAlertTrackerMap,
-                                           const vector<sp<AnomalyTracker>>& oldAnomalyTrackers,
-                                           const sp<AlarmMonitor>& anomalyAlarmMonitor,
-                                           vector<sp<MetricProducer>>& allMetricProducers,
-                                           unordered_map<int64_t, int>& newAlertTrackerMap,
-                                           vector<sp<AnomalyTracker>>& newAnomalyTrackers) {
+optional<InvalidConfigReason> updateAlerts(
+        const StatsdConfig& config, const ConfigKey& key, const int64_t currentTimeNs,
+        const unordered_map<int64_t, int>& metricProducerMap, const set<int64_t>& replacedMetrics,
+        const unordered_map<int64_t, int>& oldAlertTrackerMap,
+        const vector<sp<AnomalyTracker>>& oldAnomalyTrackers,
+        const sp<AlarmMonitor>& anomalyAlarmMonitor,
+        const unordered_map<int64_t, int>& atomMatchingTrackerMap,
+        vector<sp<MetricProducer>>& allMetricProducers,
+        unordered_map<int64_t, int>& newAlertTrackerMap,
+        vector<sp<AnomalyTracker>>& newAnomalyTrackers,
+        unordered_map<int, vector<sp<BurstTracker>>>& matcherToBurstTrackers) {
     int alertCount = config.alert_size();
     vector<UpdateStatus> alertUpdateStatuses(alertCount);
     optional<InvalidConfigReason> invalidConfigReason;
@@ -1170,8 +1174,9 @@ optional<InvalidConfigReason> updateAlerts(const StatsdConfig& config, const int
             case UPDATE_REPLACE:
             case UPDATE_NEW: {
                 optional<sp<AnomalyTracker>> anomalyTracker = createAnomalyTracker(
-                        alert, anomalyAlarmMonitor, alertUpdateStatuses[i], currentTimeNs,
-                        metricProducerMap, allMetricProducers, invalidConfigReason);
+                        alert, key, anomalyAlarmMonitor, alertUpdateStatuses[i], currentTimeNs,
+                        metricProducerMap, atomMatchingTrackerMap, allMetricProducers,
+                        matcherToBurstTrackers, invalidConfigReason);
                 if (!anomalyTracker) {
                     return invalidConfigReason;
                 }
@@ -1222,6 +1227,7 @@ optional<InvalidConfigReason> updateStatsdConfig(
         unordered_map<int, vector<int>>& trackerToConditionMap,
         unordered_map<int, vector<int>>& activationTrackerToMetricMap,
         unordered_map<int, vector<int>>& deactivationTrackerToMetricMap,
+        unordered_map<int, vector<sp<BurstTracker>>>& newMatcherToBurstTrackers,
         vector<int>& metricsWithActivation, map<int64_t, uint64_t>& newStateProtoHashes,
         set<int64_t>& noReportMetricIds) {
     set<int64_t> replacedMatchers;
@@ -1276,9 +1282,11 @@ optional<InvalidConfigReason> updateStatsdConfig(
         return invalidConfigReason;
     }
 
-    invalidConfigReason = updateAlerts(config, currentTimeNs, newMetricProducerMap, replacedMetrics,
-                                       oldAlertTrackerMap, oldAnomalyTrackers, anomalyAlarmMonitor,
-                                       newMetricProducers, newAlertTrackerMap, newAnomalyTrackers);
+    invalidConfigReason =
+            updateAlerts(config, key, currentTimeNs, newMetricProducerMap, replacedMetrics,
+                         oldAlertTrackerMap, oldAnomalyTrackers, anomalyAlarmMonitor,
+                         newAtomMatchingTrackerMap, newMetricProducers, newAlertTrackerMap,
+                         newAnomalyTrackers, newMatcherToBurstTrackers);
     if (invalidConfigReason.has_value()) {
         ALOGE("updateAlerts failed");
         return invalidConfigReason;
@@ -20,6 +20,7 @@
 
 #include "anomaly/AlarmMonitor.h"
 #include "anomaly/AlarmTracker.h"
+#include "anomaly/BurstTracker.h"
 #include "condition/ConditionTracker.h"
 #include "external/StatsPullerManager.h"
 #include "matchers/AtomMatchingTracker.h"
@@ -219,15 +220,17 @@ optional<InvalidConfigReason> determineAlertUpdateStatus(
 // [newAnomalyTrackers]: contains the list of sp to the AnomalyTrackers created.
 // Returns nullopt if successful and InvalidConfigReason if not.
 optional<InvalidConfigReason> updateAlerts(
-        const StatsdConfig& config, int64_t currentTimeNs,
+        const StatsdConfig& config, const ConfigKey& key, int64_t currentTimeNs,
         const std::unordered_map<int64_t, int>& metricProducerMap,
         const std::set<int64_t>& replacedMetrics,
         const std::unordered_map<int64_t, int>& oldAlertTrackerMap,
         const std::vector<sp<AnomalyTracker>>& oldAnomalyTrackers,
         const sp<AlarmMonitor>& anomalyAlarmMonitor,
+        const std::unordered_map<int64_t, int>& atomMatchingTrackerMap,
         std::vector<sp<MetricProducer>>& allMetricProducers,
         std::unordered_map<int64_t, int>& newAlertTrackerMap,
-        std::vector<sp<AnomalyTracker>>& newAnomalyTrackers);
+        std::vector<sp<AnomalyTracker>>& newAnomalyTrackers,
+        std::unordered_map<int, std::vector<sp<BurstTracker>>>& matcherToBurstTrackers);
 
 // Updates the existing MetricsManager from a new StatsdConfig.
 // Parameters are the members of MetricsManager. See MetricsManager for declaration.
@@ -260,6 +263,7 @@ optional<InvalidConfigReason> updateStatsdConfig(
         std::unordered_map<int, std::vector<int>>& trackerToConditionMap,
         std::unordered_map<int, std::vector<int>>& activationTrackerToMetricMap,
         std::unordered_map<int, std::vector<int>>& deactivationTrackerToMetricMap,
+        std::unordered_map<int, std::vector<sp<BurstTracker>>>& newMatcherToBurstTrackers,
         std::vector<int>& metricsWithActivation, std::map<int64_t, uint64_t>& newStateProtoHashes,
         std::set<int64_t>& noReportMetricIds);
 
@@ -21,7 +21,11 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+#include <functional>
+
 #include "FieldValue.h"
+#include "anomaly/BurstTracker.h"
 #include "condition/CombinationConditionTracker.h"
 #include "condition/SimpleConditionTracker.h"
 #include "external/StatsPullerManager.h"
@@ -34,6 +38,7 @@
 #include "metrics/DurationMetricProducer.h"
 #include "metrics/EventMetricProducer.h"
 #include "metrics/GaugeMetricProducer.h"
+#include "metrics/HistogramValueMetricProducer.h"
 #include "metrics/KllMetricProducer.h"
 #include "metrics/MetricProducer.h"
 #include "metrics/NumericValueMetricProducer.h"
@@ -876,6 +881,81 @@ optional<sp<MetricProducer>> createEventMetricProducerAndUpdateMetadata(
                                     eventDeactivationMap)};
 }
 
+// Caps the per-field bin count so one misconfigured histogram cannot inflate
+// every dimension slice of the metric.
+constexpr int kMaxHistogramBinCount = 100;
+
+optional<InvalidConfigReason> parseHistogramBinConfigs(const ValueMetric& metric,
+                                                       const size_t fieldCount,
+                                                       vector<BinStarts>& binStartsList) {
+    if ((size_t)metric.histogram_bin_configs_size() != fieldCount) {
+        ALOGE("expected one histogram bin config per value field in ValueMetric \"%lld\"",
+              (long long)metric.id());
+        return InvalidConfigReason(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_WRONG_BIN_CONFIG_COUNT,
+                                   metric.id());
+    }
+    binStartsList.reserve(fieldCount);
+    for (const HistogramBinConfig& binConfig : metric.histogram_bin_configs()) {
+        if (binConfig.has_generated_bins()) {
+            const HistogramBinConfig::GeneratedBins& generated = binConfig.generated_bins();
+            if (!generated.has_min() || !generated.has_max() || !generated.has_count() ||
+                generated.min() >= generated.max() || generated.count() < 1 ||
+                generated.count() > kMaxHistogramBinCount) {
+                ALOGE("invalid generated bins in ValueMetric \"%lld\"", (long long)metric.id());
+                return InvalidConfigReason(
+                        INVALID_CONFIG_REASON_VALUE_METRIC_HIST_INVALID_BIN_CONFIG, metric.id());
+            }
+            switch (generated.strategy()) {
+                case HistogramBinConfig::GeneratedBins::LINEAR:
+                    binStartsList.push_back(
+                            generateLinearBins(generated.min(), generated.max(),
+                                               generated.count()));
+                    break;
+                case HistogramBinConfig::GeneratedBins::EXPONENTIAL:
+                    if (generated.min() <= 0) {
+                        ALOGE("exponential bins need min > 0 in ValueMetric \"%lld\"",
+                              (long long)metric.id());
+                        return InvalidConfigReason(
+                                INVALID_CONFIG_REASON_VALUE_METRIC_HIST_INVALID_BIN_CONFIG,
+                                metric.id());
+                    }
+                    binStartsList.push_back(
+                            generateExponentialBins(generated.min(), generated.max(),
+                                                    generated.count()));
+                    break;
+                default:
+                    ALOGE("unknown bin strategy in ValueMetric \"%lld\"", (long long)metric.id());
+                    return InvalidConfigReason(
+                            INVALID_CONFIG_REASON_VALUE_METRIC_HIST_INVALID_BIN_CONFIG,
+                            metric.id());
+            }
+        } else if (binConfig.has_explicit_bins()) {
+            const HistogramBinConfig::ExplicitBins& explicitBins = binConfig.explicit_bins();
+            if (explicitBins.bin_size() < 1 || explicitBins.bin_size() > kMaxHistogramBinCount) {
+                ALOGE("invalid explicit bin count in ValueMetric \"%lld\"",
+                      (long long)metric.id());
+                return InvalidConfigReason(
+                        INVALID_CONFIG_REASON_VALUE_METRIC_HIST_INVALID_BIN_CONFIG, metric.id());
+            }
+            BinStarts binStarts(explicitBins.bin().begin(), explicitBins.bin().end());
+            if (std::adjacent_find(binStarts.begin(), binStarts.end(), std::greater_equal<float>()) !=
+                binStarts.end()) {
+                ALOGE("explicit bins not strictly increasing in ValueMetric \"%lld\"",
+                      (long long)metric.id());
+                return InvalidConfigReason(
+                        INVALID_CONFIG_REASON_VALUE_METRIC_HIST_INVALID_BIN_CONFIG, metric.id());
+            }
+            binStartsList.push_back(std::move(binStarts));
+        } else {
+            ALOGE("histogram bin config missing binning strategy in ValueMetric \"%lld\"",
+                  (long long)metric.id());
+            return InvalidConfigReason(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_INVALID_BIN_CONFIG,
+                                       metric.id());
+        }
+    }
+    return nullopt;
+}
+
 optional<sp<MetricProducer>> createNumericValueMetricProducerAndUpdateMetadata(
         const ConfigKey& key, const StatsdConfig& config, const int64_t timeBaseNs,
         const int64_t currentTimeNs, const sp<StatsPullerManager>& pullerManager,
@@ -1014,15 +1094,63 @@ optional<sp<MetricProducer>> createNumericValueMetricProducerAndUpdateMetadata(
                     ? optional<int64_t>(metric.condition_correction_threshold_nanos())
                     : nullopt;
 
-    sp<MetricProducer> metricProducer = new NumericValueMetricProducer(
-            key, metric, metricHash, {pullTagId, pullerManager},
-            {timeBaseNs, currentTimeNs, bucketSizeNs, metric.min_bucket_size_nanos(),
-             conditionCorrectionThresholdNs, getAppUpgradeBucketSplit(metric)},
-            {containsAnyPositionInDimensionsInWhat, shouldUseNestedDimensions, trackerIndex,
-             matcherWizard, metric.dimensions_in_what(), fieldMatchers},
-            {conditionIndex, metric.links(), initialConditionCache, wizard},
-            {metric.state_link(), slicedStateAtoms, stateGroupMap},
-            {eventActivationMap, eventDeactivationMap}, {dimensionSoftLimit, dimensionHardLimit});
+    sp<MetricProducer> metricProducer;
+    if (metric.aggregation_type() == ValueMetric::HISTOGRAM) {
+        // Histograms aggregate individual pushed samples; there is no meaningful
+        // diff between two pulled snapshots and no scalar to threshold on.
+        if (pullTagId != -1 || (metric.has_use_diff() && metric.use_diff()) ||
+            metric.has_threshold()) {
+            ALOGE("HISTOGRAM aggregation is pushed-only, without use_diff or threshold. "
+                  "ValueMetric \"%lld\"",
+                  (long long)metric.id());
+            invalidConfigReason = InvalidConfigReason(
+                    INVALID_CONFIG_REASON_VALUE_METRIC_HIST_UNSUPPORTED_OPTION, metric.id());
+            return nullopt;
+        }
+        vector<BinStarts> binStartsList;
+        invalidConfigReason = parseHistogramBinConfigs(metric, fieldMatchers.size(), binStartsList);
+        if (invalidConfigReason.has_value()) {
+            return nullopt;
+        }
+        metricProducer = new HistogramValueMetricProducer(
+                key, metric, metricHash, std::move(binStartsList), {pullTagId, pullerManager},
+                {timeBaseNs, currentTimeNs, bucketSizeNs, metric.min_bucket_size_nanos(),
+                 conditionCorrectionThresholdNs, getAppUpgradeBucketSplit(metric)},
+                {containsAnyPositionInDimensionsInWhat, shouldUseNestedDimensions, trackerIndex,
+                 matcherWizard, metric.dimensions_in_what(), fieldMatchers},
+                {conditionIndex, metric.links(), initialConditionCache, wizard},
+                {metric.state_link(), slicedStateAtoms, stateGroupMap},
+                {eventActivationMap, eventDeactivationMap},
+                {dimensionSoftLimit, dimensionHardLimit});
+    } else {
+        if (metric.histogram_bin_configs_size() > 0) {
+            ALOGE("histogram_bin_configs require HISTOGRAM aggregation. ValueMetric \"%lld\"",
+                  (long long)metric.id());
+            invalidConfigReason = InvalidConfigReason(
+                    INVALID_CONFIG_REASON_VALUE_METRIC_HIST_UNSUPPORTED_OPTION, metric.id());
+            return nullopt;
+        }
+        // RATE samples the diff between consecutive pulls, so it needs a pulled
+        // atom and the default diffing behavior.
+        if (metric.aggregation_type() == ValueMetric::RATE &&
+            (pullTagId == -1 || (metric.has_use_diff() && !metric.use_diff()))) {
+            ALOGE("RATE aggregation requires a diffed pulled atom. ValueMetric \"%lld\"",
+                  (long long)metric.id());
+            invalidConfigReason = InvalidConfigReason(
+                    INVALID_CONFIG_REASON_VALUE_METRIC_RATE_NOT_DIFFED_PULLED, metric.id());
+            return nullopt;
+        }
+        metricProducer = new NumericValueMetricProducer(
+                key, metric, metricHash, {pullTagId, pullerManager},
+                {timeBaseNs, currentTimeNs, bucketSizeNs, metric.min_bucket_size_nanos(),
+                 conditionCorrectionThresholdNs, getAppUpgradeBucketSplit(metric)},
+                {containsAnyPositionInDimensionsInWhat, shouldUseNestedDimensions, trackerIndex,
+                 matcherWizard, metric.dimensions_in_what(), fieldMatchers},
+                {conditionIndex, metric.links(), initialConditionCache, wizard},
+                {metric.state_link(), slicedStateAtoms, stateGroupMap},
+                {eventActivationMap, eventDeactivationMap},
+                {dimensionSoftLimit, dimensionHardLimit});
+    }
 
     SamplingInfo samplingInfo;
     if (metric.has_dimensional_sampling_info()) {
@@ -1343,11 +1471,34 @@ optional<sp<MetricProducer>> createGaugeMetricProducerAndUpdateMetadata(
 }
 
 optional<sp<AnomalyTracker>> createAnomalyTracker(
-        const Alert& alert, const sp<AlarmMonitor>& anomalyAlarmMonitor,
+        const Alert& alert, const ConfigKey& key, const sp<AlarmMonitor>& anomalyAlarmMonitor,
         const UpdateStatus& updateStatus, const int64_t currentTimeNs,
         const unordered_map<int64_t, int>& metricProducerMap,
+        const unordered_map<int64_t, int>& atomMatchingTrackerMap,
         vector<sp<MetricProducer>>& allMetricProducers,
+        unordered_map<int, vector<sp<BurstTracker>>>& matcherToBurstTrackers,
         optional<InvalidConfigReason>& invalidConfigReason) {
+    if (alert.has_atom_matcher_id()) {
+        // Burst alert: watches a matcher directly, not a metric.
+        if (alert.has_metric_id() || alert.num_occurrences() < 2 || alert.window_millis() <= 0) {
+            ALOGW("invalid burst alert \"%lld\": num_occurrences=%d window_millis=%lld",
+                  (long long)alert.id(), alert.num_occurrences(), (long long)alert.window_millis());
+            invalidConfigReason = createInvalidConfigReasonWithAlert(
+                    INVALID_CONFIG_REASON_ALERT_BURST_INVALID, alert.id());
+            return nullopt;
+        }
+        const auto& matcherItr = atomMatchingTrackerMap.find(alert.atom_matcher_id());
+        if (matcherItr == atomMatchingTrackerMap.end()) {
+            ALOGW("burst alert \"%lld\" has unknown matcher id: \"%lld\"", (long long)alert.id(),
+                  (long long)alert.atom_matcher_id());
+            invalidConfigReason = createInvalidConfigReasonWithAlert(
+                    INVALID_CONFIG_REASON_ALERT_BURST_MATCHER_NOT_FOUND, alert.id());
+            return nullopt;
+        }
+        sp<BurstTracker> burstTracker = new BurstTracker(alert, key);
+        matcherToBurstTrackers[matcherItr->second].push_back(burstTracker);
+        return {burstTracker};
+    }
     const auto& itr = metricProducerMap.find(alert.metric_id());
     if (itr == metricProducerMap.end()) {
         ALOGW("alert \"%lld\" has unknown metric id: \"%lld\"", (long long)alert.id(),
@@ -1387,9 +1538,7 @@ optional<InvalidConfigReason> initAtomMatchingTrackers(
         unordered_map<int64_t, int>& atomMatchingTrackerMap,
         vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
         unordered_map<int, vector<int>>& allTagIdsToMatchersMap) {
-    vector<AtomMatcher> matcherConfigs;
     const int atomMatcherCount = config.atom_matcher_size();
-    matcherConfigs.reserve(atomMatcherCount);
     allAtomMatchingTrackers.reserve(atomMatcherCount);
     optional<InvalidConfigReason> invalidConfigReason;
 
@@ -1407,14 +1556,13 @@ optional<InvalidConfigReason> initAtomMatchingTrackers(
                                                         logMatcher.id());
         }
         atomMatchingTrackerMap[logMatcher.id()] = i;
-        matcherConfigs.push_back(logMatcher);
     }
 
     vector<uint8_t> stackTracker2(allAtomMatchingTrackers.size(), false);
     for (size_t matcherIndex = 0; matcherIndex < allAtomMatchingTrackers.size(); matcherIndex++) {
         auto& matcher = allAtomMatchingTrackers[matcherIndex];
         const auto [invalidConfigReason, _] =
-                matcher->init(matcherIndex, matcherConfigs, allAtomMatchingTrackers,
+                matcher->init(matcherIndex, config.atom_matcher(), allAtomMatchingTrackers,
                               atomMatchingTrackerMap, stackTracker2);
         if (invalidConfigReason.has_value()) {
             return invalidConfigReason;
@@ -1448,9 +1596,7 @@ optional<InvalidConfigReason> initConditions(
         vector<sp<ConditionTracker>>& allConditionTrackers,
         unordered_map<int, std::vector<int>>& trackerToConditionMap,
         vector<ConditionState>& initialConditionCache) {
-    vector<Predicate> conditionConfigs;
     const int conditionTrackerCount = config.predicate_size();
-    conditionConfigs.reserve(conditionTrackerCount);
     allConditionTrackers.reserve(conditionTrackerCount);
     initialConditionCache.assign(conditionTrackerCount, ConditionState::kNotEvaluated);
     optional<InvalidConfigReason> invalidConfigReason;
@@ -1469,15 +1615,14 @@ optional<InvalidConfigReason> initConditions(
                                                           condition.id());
         }
         conditionTrackerMap[condition.id()] = i;
-        conditionConfigs.push_back(condition);
     }
 
     vector<uint8_t> stackTracker(allConditionTrackers.size(), false);
     for (size_t i = 0; i < allConditionTrackers.size(); i++) {
         auto& conditionTracker = allConditionTrackers[i];
         invalidConfigReason =
-                conditionTracker->init(conditionConfigs, allConditionTrackers, conditionTrackerMap,
-                                       stackTracker, initialConditionCache);
+                conditionTracker->init(config.predicate(), allConditionTrackers,
+                                       conditionTrackerMap, stackTracker, initialConditionCache);
         if (invalidConfigReason.has_value()) {
             return invalidConfigReason;
         }
@@ -1699,19 +1844,24 @@ optional<InvalidConfigReason> initMetrics(
     return nullopt;
 }
 
-optional<InvalidConfigReason> initAlerts(const StatsdConfig& config, const int64_t currentTimeNs,
+optional<InvalidConfigReason> initAlerts(const StatsdConfig& config, const ConfigKey& key,
+                                         const int64_t currentTimeNs,
                                          const unordered_map<int64_t, int>& metricProducerMap,
+                                         const unordered_map<int64_t, int>& atomMatchingTrackerMap,
                                          unordered_map<int64_t, int>& alertTrackerMap,
                                          const sp<AlarmMonitor>& anomalyAlarmMonitor,
                                          vector<sp<MetricProducer>>& allMetricProducers,
-                                         vector<sp<AnomalyTracker>>& allAnomalyTrackers) {
+                                         vector<sp<AnomalyTracker>>& allAnomalyTrackers,
+                                         unordered_map<int, vector<sp<BurstTracker>>>&
+                                                 matcherToBurstTrackers) {
     optional<InvalidConfigReason> invalidConfigReason;
     for (int i = 0; i < config.alert_size(); i++) {
         const Alert& alert = config.alert(i);
         alertTrackerMap.insert(std::make_pair(alert.id(), allAnomalyTrackers.size()));
         optional<sp<AnomalyTracker>> anomalyTracker = createAnomalyTracker(
-                alert, anomalyAlarmMonitor, UpdateStatus::UPDATE_NEW, currentTimeNs,
-                metricProducerMap, allMetricProducers, invalidConfigReason);
+                alert, key, anomalyAlarmMonitor, UpdateStatus::UPDATE_NEW, currentTimeNs,
+                metricProducerMap, atomMatchingTrackerMap, allMetricProducers,
+                matcherToBurstTrackers, invalidConfigReason);
         if (!anomalyTracker) {
             return invalidConfigReason;
         }
@@ -1767,8 +1917,10 @@ optional<InvalidConfigReason> initStatsdConfig(
         unordered_map<int, std::vector<int>>& trackerToConditionMap,
         unordered_map<int, std::vector<int>>& activationAtomTrackerToMetricMap,
         unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
-        unordered_map<int64_t, int>& alertTrackerMap, vector<int>& metricsWithActivation,
-        map<int64_t, uint64_t>& stateProtoHashes, set<int64_t>& noReportMetricIds) {
+        unordered_map<int64_t, int>& alertTrackerMap,
+        unordered_map<int, vector<sp<BurstTracker>>>& matcherToBurstTrackers,
+        vector<int>& metricsWithActivation, map<int64_t, uint64_t>& stateProtoHashes,
+        set<int64_t>& noReportMetricIds) {
     vector<ConditionState> initialConditionCache;
     unordered_map<int64_t, int> stateAtomIdMap;
     unordered_map<int64_t, unordered_map<int, int64_t>> allStateGroupMaps;
@@ -1814,8 +1966,10 @@ optional<InvalidConfigReason> initStatsdConfig(
         return invalidConfigReason;
     }
 
-    invalidConfigReason = initAlerts(config, currentTimeNs, metricProducerMap, alertTrackerMap,
-                                     anomalyAlarmMonitor, allMetricProducers, allAnomalyTrackers);
+    invalidConfigReason =
+            initAlerts(config, key, currentTimeNs, metricProducerMap, atomMatchingTrackerMap,
+                       alertTrackerMap, anomalyAlarmMonitor, allMetricProducers, allAnomalyTrackers,
+                       matcherToBurstTrackers);
     if (invalidConfigReason.has_value()) {
         ALOGE("initAlerts failed");
         return invalidConfigReason;
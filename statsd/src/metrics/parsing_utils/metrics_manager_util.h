@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "anomaly/AlarmTracker.h"
+#include "anomaly/BurstTracker.h"
 #include "condition/ConditionTracker.h"
 #include "external/StatsPullerManager.h"
 #include "matchers/AtomMatchingTracker.h"
@@ -218,10 +219,12 @@ optional<sp<MetricProducer>> createKllMetricProducerAndUpdateMetadata(
 // Creates an AnomalyTracker and adds it to the appropriate metric.
 // Returns an sp to the AnomalyTracker, or nullopt if there was an error.
 optional<sp<AnomalyTracker>> createAnomalyTracker(
-        const Alert& alert, const sp<AlarmMonitor>& anomalyAlarmMonitor,
+        const Alert& alert, const ConfigKey& key, const sp<AlarmMonitor>& anomalyAlarmMonitor,
         const UpdateStatus& updateStatus, int64_t currentTimeNs,
         const std::unordered_map<int64_t, int>& metricProducerMap,
+        const std::unordered_map<int64_t, int>& atomMatchingTrackerMap,
         std::vector<sp<MetricProducer>>& allMetricProducers,
+        std::unordered_map<int, std::vector<sp<BurstTracker>>>& matcherToBurstTrackers,
         optional<InvalidConfigReason>& invalidConfigReason);
 
 // Templated function for adding subscriptions to alarms or alerts. Returns nullopt if successful
@@ -383,8 +386,10 @@ optional<InvalidConfigReason> initStatsdConfig(
         std::unordered_map<int, std::vector<int>>& trackerToConditionMap,
         std::unordered_map<int, std::vector<int>>& activationAtomTrackerToMetricMap,
         std::unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
-        std::unordered_map<int64_t, int>& alertTrackerMap, std::vector<int>& metricsWithActivation,
-        std::map<int64_t, uint64_t>& stateProtoHashes, std::set<int64_t>& noReportMetricIds);
+        std::unordered_map<int64_t, int>& alertTrackerMap,
+        std::unordered_map<int, std::vector<sp<BurstTracker>>>& matcherToBurstTrackers,
+        std::vector<int>& metricsWithActivation, std::map<int64_t, uint64_t>& stateProtoHashes,
+        std::set<int64_t>& noReportMetricIds);
 
 }  // namespace statsd
 }  // namespace os
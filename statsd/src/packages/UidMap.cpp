@@ -20,6 +20,8 @@
 #include "stats_log_util.h"
 #include "guardrail/StatsdStats.h"
 #include "packages/UidMap.h"
+#include "utils/MemoryAccounting.h"
+#include "utils/WorkerPool.h"
 
 #include <inttypes.h>
 
@@ -70,10 +72,17 @@ const int FIELD_ID_CHANGE_PREV_VERSION_STRING = 9;
 const int FIELD_ID_CHANGE_NEW_VERSION_STRING_HASH = 10;
 const int FIELD_ID_CHANGE_PREV_VERSION_STRING_HASH = 11;
 
-UidMap::UidMap() : mBytesUsed(0) {
+UidMap::UidMap()
+    : mMap(std::make_shared<UidAppMap>()),
+      mIsolatedUidMap(std::make_shared<IsolatedUidMap>()),
+      mBytesUsed(0) {
 }
 
-UidMap::~UidMap() {}
+UidMap::~UidMap() {
+    // Deferred certificate hash batches capture a raw pointer to this map; let
+    // any in-flight batch finish before the members go away.
+    waitForPendingCertificateHashes();
+}
 
 sp<UidMap> UidMap::getInstance() {
     static sp<UidMap> sInstance = new UidMap();
@@ -81,10 +90,18 @@ sp<UidMap> UidMap::getInstance() {
 }
 
 bool UidMap::hasApp(int uid, const string& packageName) const {
-    lock_guard<mutex> lock(mMutex);
+    const std::shared_ptr<const UidAppMap> snapshot = getAppMapSnapshot();
+
+    const int32_t nameId = snapshot->nameTable.find(packageName);
+    if (nameId < 0) {
+        return false;
+    }
+    auto it = snapshot->apps.find(std::make_pair(uid, nameId));
+    return it != snapshot->apps.end() && !it->second.deleted;
+}
 
-    auto it = mMap.find(std::make_pair(uid, packageName));
-    return it != mMap.end() && !it->second.deleted;
+int32_t UidMap::getPackageId(const string& packageName) const {
+    return getAppMapSnapshot()->nameTable.find(packageName);
 }
 
 string UidMap::normalizeAppName(const string& appName) const {
@@ -94,63 +111,87 @@ string UidMap::normalizeAppName(const string& appName) const {
 }
 
 std::set<string> UidMap::getAppNamesFromUid(const int32_t uid, bool returnNormalized) const {
-    lock_guard<mutex> lock(mMutex);
-    return getAppNamesFromUidLocked(uid,returnNormalized);
-}
+    const std::shared_ptr<const UidAppMap> snapshot = getAppMapSnapshot();
 
-std::set<string> UidMap::getAppNamesFromUidLocked(const int32_t uid, bool returnNormalized) const {
     std::set<string> names;
-    for (const auto& kv : mMap) {
+    for (const auto& kv : snapshot->apps) {
         if (kv.first.first == uid && !kv.second.deleted) {
-            names.insert(returnNormalized ? normalizeAppName(kv.first.second) : kv.first.second);
+            const string& name = snapshot->nameTable.names[kv.first.second];
+            names.insert(returnNormalized ? normalizeAppName(name) : name);
         }
     }
     return names;
 }
 
 int64_t UidMap::getAppVersion(int uid, const string& packageName) const {
-    lock_guard<mutex> lock(mMutex);
+    const std::shared_ptr<const UidAppMap> snapshot = getAppMapSnapshot();
 
-    auto it = mMap.find(std::make_pair(uid, packageName));
-    if (it == mMap.end() || it->second.deleted) {
+    const int32_t nameId = snapshot->nameTable.find(packageName);
+    if (nameId < 0) {
+        return 0;
+    }
+    auto it = snapshot->apps.find(std::make_pair(uid, nameId));
+    if (it == snapshot->apps.end() || it->second.deleted) {
         return 0;
     }
     return it->second.versionCode;
 }
 
-void UidMap::updateMap(const int64_t timestamp, const UidData& uidData) {
+void UidMap::updateMap(const int64_t timestamp, UidData uidData) {
+    ScopedMemoryTag memoryTag(MemoryAccounting::kUidMap);
     wp<PackageInfoListener> broadcast = NULL;
+    uint64_t mapGeneration = 0;
+    bool hasCertificateHashes = false;
     {
         lock_guard<mutex> lock(mMutex);  // Exclusively lock for updates.
 
-        std::unordered_map<std::pair<int, string>, AppData, PairHash> deletedApps;
+        const std::shared_ptr<const UidAppMap> oldMap = getAppMapSnapshot();
+        auto newMap = std::make_shared<UidAppMap>();
+        // Keep the name table so already-assigned ids stay stable.
+        newMap->nameTable = oldMap->nameTable;
+        newMap->apps.reserve(uidData.app_info_size());
+        for (const auto& appInfo : uidData.app_info()) {
+            const int32_t nameId = newMap->nameTable.intern(appInfo.package_name());
+            // Certificate hashes are only read at report time, so copying them is
+            // left to applyCertificateHashes() on a worker thread instead of being
+            // paid here, where a full boot-time package list is processed.
+            newMap->apps[std::make_pair(appInfo.uid(), nameId)] =
+                    AppData(appInfo.version(), appInfo.version_string(), appInfo.installer(),
+                            /* certificateHash */ "");
+            hasCertificateHashes |= !appInfo.certificate_hash().empty();
+        }
 
-        // Copy all the deleted apps.
-        for (const auto& kv : mMap) {
+        // Carry the deleted markers over for any app that is still present.
+        for (const auto& kv : oldMap->apps) {
             if (kv.second.deleted) {
-                deletedApps[kv.first] = kv.second;
+                auto newMapIt = newMap->apps.find(kv.first);
+                if (newMapIt != newMap->apps.end()) {
+                    newMapIt->second = kv.second;
+                }
             }
         }
 
-        mMap.clear();
-        for (const auto& appInfo : uidData.app_info()) {
-            mMap[std::make_pair(appInfo.uid(), appInfo.package_name())] =
-                    AppData(appInfo.version(), appInfo.version_string(), appInfo.installer(),
-                            appInfo.certificate_hash());
-        }
+        std::atomic_store_explicit(&mMap, std::shared_ptr<const UidAppMap>(std::move(newMap)),
+                                   std::memory_order_release);
 
-        for (const auto& kv : deletedApps) {
-            auto mMapIt = mMap.find(kv.first);
-            if (mMapIt != mMap.end()) {
-                // Insert this deleted app back into the current map.
-                mMap[kv.first] = kv.second;
-            }
+        // A bulk replacement is not represented in mChanges, so reports that only have
+        // older state must be re-based onto a full snapshot.
+        mLastDeltaChainBreakNs = std::max(mLastDeltaChainBreakNs, timestamp);
+
+        mapGeneration = ++mMapGeneration;
+        if (hasCertificateHashes) {
+            mPendingCertificateHashBatches++;
         }
 
         ensureBytesUsedBelowLimit();
         StatsdStats::getInstance().setCurrentUidMapMemory(mBytesUsed);
         broadcast = mSubscriber;
     }
+    if (hasCertificateHashes) {
+        WorkerPool::getInstance().enqueue([this, mapGeneration, data = std::move(uidData)] {
+            applyCertificateHashes(mapGeneration, data);
+        });
+    }
     // To avoid invoking callback while holding the internal lock. we get a copy of the listener
     // and invoke the callback. It's still possible that after we copy the listener, it removes
     // itself before we call it. It's then the listener's job to handle it (expect the callback to
@@ -161,9 +202,45 @@ void UidMap::updateMap(const int64_t timestamp, const UidData& uidData) {
     }
 }
 
+void UidMap::applyCertificateHashes(const uint64_t mapGeneration, const UidData& uidData) {
+    ScopedMemoryTag memoryTag(MemoryAccounting::kUidMap);
+    lock_guard<mutex> lock(mMutex);
+    // A newer bulk update has been published since this batch was queued; its own
+    // deferred pass carries the current hashes, so this one is dropped whole.
+    if (mapGeneration == mMapGeneration) {
+        auto newMap = std::make_shared<UidAppMap>(*getAppMapSnapshot());
+        for (const auto& appInfo : uidData.app_info()) {
+            if (appInfo.certificate_hash().empty()) {
+                continue;
+            }
+            const int32_t nameId = newMap->nameTable.find(appInfo.package_name());
+            if (nameId < 0) {
+                continue;
+            }
+            auto it = newMap->apps.find(std::make_pair(appInfo.uid(), nameId));
+            // updateApp() may have published a fresher hash for this app already.
+            if (it != newMap->apps.end() && it->second.certificateHash.empty()) {
+                it->second.certificateHash = appInfo.certificate_hash();
+            }
+        }
+        std::atomic_store_explicit(&mMap, std::shared_ptr<const UidAppMap>(std::move(newMap)),
+                                   std::memory_order_release);
+    }
+    mPendingCertificateHashBatches--;
+    // Notified under the lock so a waiter (including the destructor) cannot
+    // observe a zero count and tear the map down before the notify runs.
+    mCertificateHashesApplied.notify_all();
+}
+
+void UidMap::waitForPendingCertificateHashes() const {
+    unique_lock<mutex> lock(mMutex);
+    mCertificateHashesApplied.wait(lock, [this] { return mPendingCertificateHashBatches == 0; });
+}
+
 void UidMap::updateApp(const int64_t timestamp, const string& appName, const int32_t uid,
                        const int64_t versionCode, const string& versionString,
                        const string& installer, const vector<uint8_t>& certificateHash) {
+    ScopedMemoryTag memoryTag(MemoryAccounting::kUidMap);
     wp<PackageInfoListener> broadcast = NULL;
 
     const string certificateHashString = string(certificateHash.begin(), certificateHash.end());
@@ -171,9 +248,10 @@ void UidMap::updateApp(const int64_t timestamp, const string& appName, const int
         lock_guard<mutex> lock(mMutex);
         int32_t prevVersion = 0;
         string prevVersionString = "";
-        auto key = std::make_pair(uid, appName);
-        auto it = mMap.find(key);
-        if (it != mMap.end()) {
+        auto newMap = std::make_shared<UidAppMap>(*getAppMapSnapshot());
+        auto key = std::make_pair(uid, newMap->nameTable.intern(appName));
+        auto it = newMap->apps.find(key);
+        if (it != newMap->apps.end()) {
             prevVersion = it->second.versionCode;
             prevVersionString = it->second.versionString;
             it->second.versionCode = versionCode;
@@ -189,8 +267,11 @@ void UidMap::updateApp(const int64_t timestamp, const string& appName, const int
             broadcast = mSubscriber;
         } else {
             // Otherwise, we need to add an app at this uid.
-            mMap[key] = AppData(versionCode, versionString, installer, certificateHashString);
+            newMap->apps[key] = AppData(versionCode, versionString, installer,
+                                        certificateHashString);
         }
+        std::atomic_store_explicit(&mMap, std::shared_ptr<const UidAppMap>(std::move(newMap)),
+                                   std::memory_order_release);
 
         mChanges.emplace_back(false, timestamp, appName, uid, versionCode, versionString,
                               prevVersion, prevVersionString);
@@ -216,6 +297,10 @@ void UidMap::ensureBytesUsedBelowLimit() {
     while (mBytesUsed > limit) {
         ALOGI("Bytes used %zu is above limit %zu, need to delete something", mBytesUsed, limit);
         if (mChanges.size() > 0) {
+            // Configs that have not reported this record yet lose it, so they must
+            // re-base onto a full snapshot.
+            mLastDeltaChainBreakNs =
+                    std::max(mLastDeltaChainBreakNs, mChanges.front().timestampNs);
             mBytesUsed -= kBytesChangeRecord;
             mChanges.pop_front();
             StatsdStats::getInstance().noteUidMapDropped(1);
@@ -223,6 +308,17 @@ void UidMap::ensureBytesUsedBelowLimit() {
     }
 }
 
+void UidMap::trimMemory() {
+    lock_guard<mutex> lock(mMutex);
+    auto newMap = std::make_shared<UidAppMap>(*getAppMapSnapshot());
+    // Copy construction right-sizes the hash tables for their current
+    // population; the interned name vector keeps its growth slack unless
+    // returned explicitly.
+    newMap->nameTable.names.shrink_to_fit();
+    std::atomic_store_explicit(&mMap, std::shared_ptr<const UidAppMap>(std::move(newMap)),
+                               std::memory_order_release);
+}
+
 void UidMap::removeApp(const int64_t timestamp, const string& app, const int32_t uid) {
     wp<PackageInfoListener> broadcast = NULL;
     {
@@ -230,9 +326,11 @@ void UidMap::removeApp(const int64_t timestamp, const string& app, const int32_t
 
         int64_t prevVersion = 0;
         string prevVersionString = "";
-        auto key = std::make_pair(uid, app);
-        auto it = mMap.find(key);
-        if (it != mMap.end() && !it->second.deleted) {
+        auto newMap = std::make_shared<UidAppMap>(*getAppMapSnapshot());
+        const int32_t nameId = newMap->nameTable.find(app);
+        auto key = std::make_pair(uid, nameId);
+        auto it = nameId >= 0 ? newMap->apps.find(key) : newMap->apps.end();
+        if (it != newMap->apps.end() && !it->second.deleted) {
             prevVersion = it->second.versionCode;
             prevVersionString = it->second.versionString;
             it->second.deleted = true;
@@ -242,9 +340,11 @@ void UidMap::removeApp(const int64_t timestamp, const string& app, const int32_t
             // Delete the oldest one.
             auto oldest = mDeletedApps.front();
             mDeletedApps.pop_front();
-            mMap.erase(oldest);
+            newMap->apps.erase(oldest);
             StatsdStats::getInstance().noteUidMapAppDeletionDropped();
         }
+        std::atomic_store_explicit(&mMap, std::shared_ptr<const UidAppMap>(std::move(newMap)),
+                                   std::memory_order_release);
         mChanges.emplace_back(true, timestamp, app, uid, 0, "", prevVersion, prevVersionString);
         mBytesUsed += kBytesChangeRecord;
         ensureBytesUsedBelowLimit();
@@ -267,29 +367,44 @@ void UidMap::setListener(const wp<PackageInfoListener>& listener) {
 void UidMap::assignIsolatedUid(int isolatedUid, int parentUid) {
     lock_guard<mutex> lock(mIsolatedMutex);
 
-    mIsolatedUidMap[isolatedUid] = parentUid;
+    auto newMap = std::make_shared<IsolatedUidMap>(*getIsolatedUidMapSnapshot());
+    (*newMap)[isolatedUid] = parentUid;
+    std::atomic_store_explicit(&mIsolatedUidMap,
+                               std::shared_ptr<const IsolatedUidMap>(std::move(newMap)),
+                               std::memory_order_release);
+    mIsolatedUidMapGeneration.fetch_add(1, std::memory_order_release);
 }
 
 void UidMap::removeIsolatedUid(int isolatedUid) {
     lock_guard<mutex> lock(mIsolatedMutex);
 
-    auto it = mIsolatedUidMap.find(isolatedUid);
-    if (it != mIsolatedUidMap.end()) {
-        mIsolatedUidMap.erase(it);
+    const std::shared_ptr<const IsolatedUidMap> oldMap = getIsolatedUidMapSnapshot();
+    if (oldMap->find(isolatedUid) == oldMap->end()) {
+        return;
     }
+    auto newMap = std::make_shared<IsolatedUidMap>(*oldMap);
+    newMap->erase(isolatedUid);
+    std::atomic_store_explicit(&mIsolatedUidMap,
+                               std::shared_ptr<const IsolatedUidMap>(std::move(newMap)),
+                               std::memory_order_release);
+    mIsolatedUidMapGeneration.fetch_add(1, std::memory_order_release);
 }
 
 int UidMap::getHostUidOrSelf(int uid) const {
-    lock_guard<mutex> lock(mIsolatedMutex);
+    // Per-event isolated uid translation; reads the snapshot without taking a lock.
+    const std::shared_ptr<const IsolatedUidMap> snapshot = getIsolatedUidMapSnapshot();
 
-    auto it = mIsolatedUidMap.find(uid);
-    if (it != mIsolatedUidMap.end()) {
+    auto it = snapshot->find(uid);
+    if (it != snapshot->end()) {
         return it->second;
     }
     return uid;
 }
 
 void UidMap::clearOutput() {
+    if (!mChanges.empty()) {
+        mLastDeltaChainBreakNs = std::max(mLastDeltaChainBreakNs, mChanges.back().timestampNs);
+    }
     mChanges.clear();
     // Also update the guardrail trackers.
     StatsdStats::getInstance().setUidMapChanges(0);
@@ -318,27 +433,18 @@ void UidMap::writeUidMapSnapshot(int64_t timestamp, bool includeVersionStrings,
                                  const std::set<int32_t>& interestingUids,
                                  map<string, int>* installerIndices, std::set<string>* str_set,
                                  ProtoOutputStream* proto) const {
-    lock_guard<mutex> lock(mMutex);
-
-    writeUidMapSnapshotLocked(timestamp, includeVersionStrings, includeInstaller,
-                              truncatedCertificateHashSize, interestingUids, installerIndices,
-                              str_set, proto);
-}
-
-void UidMap::writeUidMapSnapshotLocked(const int64_t timestamp, const bool includeVersionStrings,
-                                       const bool includeInstaller,
-                                       const uint8_t truncatedCertificateHashSize,
-                                       const std::set<int32_t>& interestingUids,
-                                       map<string, int>* installerIndices,
-                                       std::set<string>* str_set, ProtoOutputStream* proto) const {
+    // Reads an immutable snapshot, so no lock is needed even while
+    // StatsCompanionService is publishing an update.
+    const std::shared_ptr<const UidAppMap> snapshot = getAppMapSnapshot();
     int curInstallerIndex = 0;
 
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_SNAPSHOT_TIMESTAMP, (long long)timestamp);
-    for (const auto& [keyPair, appData] : mMap) {
-        const auto& [uid, packageName] = keyPair;
+    for (const auto& [keyPair, appData] : snapshot->apps) {
+        const auto& [uid, nameId] = keyPair;
         if (!interestingUids.empty() && interestingUids.find(uid) == interestingUids.end()) {
             continue;
         }
+        const string& packageName = snapshot->nameTable.names[nameId];
         uint64_t token = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                                       FIELD_ID_SNAPSHOT_PACKAGE_INFO);
         // Get installer index.
@@ -412,6 +518,12 @@ void UidMap::appendUidMap(const int64_t timestamp, const ConfigKey& key,
                           const bool includeVersionStrings, const bool includeInstaller,
                           const uint8_t truncatedCertificateHashSize, std::set<string>* str_set,
                           ProtoOutputStream* proto) {
+    if (truncatedCertificateHashSize > 0) {
+        // Certificate hashes from a bulk update land via a worker thread; this report
+        // is their consumer, so let any in-flight batch finish first. Must happen
+        // before mMutex is taken since the batch needs it to publish.
+        waitForPendingCertificateHashes();
+    }
     lock_guard<mutex> lock(mMutex);  // Lock for updates
 
     for (const ChangeRecord& record : mChanges) {
@@ -453,14 +565,27 @@ void UidMap::appendUidMap(const int64_t timestamp, const ConfigKey& key,
 
     map<string, int> installerIndices;
 
-    // Write snapshot from current uid map state.
-    uint64_t snapshotsToken =
-            proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SNAPSHOTS);
-    writeUidMapSnapshotLocked(timestamp, includeVersionStrings, includeInstaller,
-                              truncatedCertificateHashSize,
-                              std::set<int32_t>() /*empty uid set means including every uid*/,
-                              &installerIndices, str_set, proto);
-    proto->end(snapshotsToken);
+    // The snapshot can be omitted if the receiver already has a base snapshot and every
+    // change since that report is still present above, so the current state can be
+    // reconstructed from base + deltas. Re-base periodically so that a report lost in
+    // transit cannot orphan the delta chain indefinitely.
+    int32_t& deltaReports = mDeltaReportsPerConfigKey[key];
+    const bool writeSnapshot = mLastUpdatePerConfigKey[key] <= mLastDeltaChainBreakNs ||
+                               deltaReports >= StatsdStats::kMaxUidMapDeltaReports;
+
+    if (writeSnapshot) {
+        // Write snapshot from current uid map state.
+        uint64_t snapshotsToken =
+                proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SNAPSHOTS);
+        writeUidMapSnapshot(timestamp, includeVersionStrings, includeInstaller,
+                            truncatedCertificateHashSize,
+                            std::set<int32_t>() /*empty uid set means including every uid*/,
+                            &installerIndices, str_set, proto);
+        proto->end(snapshotsToken);
+        deltaReports = 0;
+    } else {
+        deltaReports++;
+    }
 
     vector<string> installers(installerIndices.size(), "");
     for (const auto& [installer, index] : installerIndices) {
@@ -502,10 +627,14 @@ void UidMap::appendUidMap(const int64_t timestamp, const ConfigKey& key,
 }
 
 void UidMap::printUidMap(int out, bool includeCertificateHash) const {
-    lock_guard<mutex> lock(mMutex);
+    if (includeCertificateHash) {
+        waitForPendingCertificateHashes();
+    }
+    const std::shared_ptr<const UidAppMap> snapshot = getAppMapSnapshot();
 
-    for (const auto& [keyPair, appData] : mMap) {
-        const auto& [uid, packageName] = keyPair;
+    for (const auto& [keyPair, appData] : snapshot->apps) {
+        const auto& [uid, nameId] = keyPair;
+        const string& packageName = snapshot->nameTable.names[nameId];
         if (!appData.deleted) {
             if (includeCertificateHash) {
                 const string& certificateHashHexString = toHexString(appData.certificateHash);
@@ -527,14 +656,19 @@ void UidMap::OnConfigUpdated(const ConfigKey& key) {
 
 void UidMap::OnConfigRemoved(const ConfigKey& key) {
     mLastUpdatePerConfigKey.erase(key);
+    mDeltaReportsPerConfigKey.erase(key);
 }
 
 set<int32_t> UidMap::getAppUid(const string& package) const {
-    lock_guard<mutex> lock(mMutex);
+    const std::shared_ptr<const UidAppMap> snapshot = getAppMapSnapshot();
 
     set<int32_t> results;
-    for (const auto& kv : mMap) {
-        if (kv.first.second == package && !kv.second.deleted) {
+    const int32_t nameId = snapshot->nameTable.find(package);
+    if (nameId < 0) {
+        return results;
+    }
+    for (const auto& kv : snapshot->apps) {
+        if (kv.first.second == nameId && !kv.second.deleted) {
             results.insert(kv.first.first);
         }
     }
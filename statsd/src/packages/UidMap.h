@@ -22,7 +22,10 @@
 #include <utils/RefBase.h>
 #include <utils/String16.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
@@ -99,7 +102,17 @@ public:
 
     static sp<UidMap> getInstance();
 
-    void updateMap(const int64_t timestamp, const UidData& uidData);
+    // Replaces the uid map state with the given package list. The uid/version data
+    // is published synchronously; certificate hashes are only consumed at report
+    // time, so they are filled into the snapshot by a background worker instead of
+    // being copied on the (boot-critical) update path. Takes the proto by value so
+    // the worker can own it; callers should std::move() it in.
+    void updateMap(const int64_t timestamp, UidData uidData);
+
+    // Blocks until every certificate hash batch deferred by updateMap() has been
+    // applied. Paths that read certificate hashes (reports, dumpsys) call this
+    // first; uid/version readers never need to.
+    void waitForPendingCertificateHashes() const;
 
     void updateApp(const int64_t timestamp, const string& appName, const int32_t uid,
                    const int64_t versionCode, const string& versionString, const string& installer,
@@ -135,6 +148,12 @@ public:
     // Returns the host uid if it exists. Otherwise, returns the same uid that was passed-in.
     virtual int getHostUidOrSelf(int uid) const;
 
+    // Generation of the isolated uid map, bumped on every assign/remove. Lets
+    // per-event translation caches detect staleness without loading the snapshot.
+    uint64_t getIsolatedUidMapGeneration() const {
+        return mIsolatedUidMapGeneration.load(std::memory_order_acquire);
+    }
+
     // Gets all snapshots and changes that have occurred since the last output.
     // If every config key has received a change or snapshot record, then this
     // record is deleted.
@@ -150,8 +169,19 @@ public:
     // Get currently cached value of memory used by UID map.
     size_t getBytesUsed() const;
 
+    // Republishes the app map snapshot with tightly sized containers, releasing
+    // capacity retained from install/uninstall bursts. Part of the idle
+    // maintenance pass; lock-free readers are unaffected since snapshots are
+    // immutable.
+    void trimMemory();
+
     virtual std::set<int32_t> getAppUid(const string& package) const;
 
+    // Returns the stable interned id for the given package name, or -1 if the
+    // package has never been seen by the uid map. An id never changes once
+    // assigned, so callers may cache it. Lock-free.
+    int32_t getPackageId(const string& packageName) const;
+
     // Write current PackageInfoSnapshot to ProtoOutputStream.
     // interestingUids: If not empty, only write the package info for these uids. If empty, write
     //                  package info for all uids.
@@ -164,37 +194,103 @@ public:
                              ProtoOutputStream* proto) const;
 
 private:
-    std::set<string> getAppNamesFromUidLocked(int32_t uid, bool returnNormalized) const;
     string normalizeAppName(const string& appName) const;
 
-    void writeUidMapSnapshotLocked(const int64_t timestamp, const bool includeVersionStrings,
-                                   const bool includeInstaller,
-                                   const uint8_t truncatedCertificateHashSize,
-                                   const std::set<int32_t>& interestingUids,
-                                   std::map<string, int>* installerIndices,
-                                   std::set<string>* str_set, ProtoOutputStream* proto) const;
+    // Worker-thread half of updateMap(): republishes the snapshot with the
+    // certificate hashes from the given package list filled in. Skips the whole
+    // batch if a newer bulk update has been published since (its own deferred pass
+    // supersedes this one), and never overwrites a hash that updateApp() set in
+    // the meantime.
+    void applyCertificateHashes(uint64_t mapGeneration, const UidData& uidData);
 
     mutable mutex mMutex;
     mutable mutex mIsolatedMutex;
 
-    struct PairHash {
-        size_t operator()(const std::pair<int, string>& p) const noexcept {
-            std::hash<std::string> hash_fn;
-            return hash_fn(std::to_string(p.first) + p.second);
+    // Interned package name table carried inside each snapshot. A name is assigned
+    // a small integer id the first time it is seen and keeps that id for the
+    // lifetime of the process, so ids are stable across snapshots.
+    struct PackageNameTable {
+        // Id to package name; the index is the interned id.
+        std::vector<string> names;
+        // Package name to id.
+        std::unordered_map<string, int32_t> ids;
+
+        // Returns the id for the given name, or -1 if it has never been interned.
+        int32_t find(const string& name) const {
+            const auto it = ids.find(name);
+            return it != ids.end() ? it->second : -1;
+        }
+
+        // Returns the id for the given name, interning it if needed.
+        int32_t intern(const string& name) {
+            const auto it = ids.find(name);
+            if (it != ids.end()) {
+                return it->second;
+            }
+            const int32_t id = static_cast<int32_t>(names.size());
+            names.push_back(name);
+            ids.emplace(name, id);
+            return id;
+        }
+    };
+
+    struct UidPackageIdHash {
+        size_t operator()(const std::pair<int, int32_t>& p) const noexcept {
+            return std::hash<uint64_t>{}((static_cast<uint64_t>(p.first) << 32) |
+                                         static_cast<uint32_t>(p.second));
         }
     };
-    // Maps uid and package name to application data.
-    std::unordered_map<std::pair<int, string>, AppData, PairHash> mMap;
+
+    // Maps (uid, interned package name id) to application data. Each distinct
+    // package name is stored once in the name table instead of once per uid that
+    // has it, and snapshot writers dedup names with an id lookup.
+    struct UidAppMap {
+        std::unordered_map<std::pair<int, int32_t>, AppData, UidPackageIdHash> apps;
+        PackageNameTable nameTable;
+    };
+
+    using IsolatedUidMap = std::unordered_map<int, int>;
+
+    // Returns the current (immutable) app map snapshot without taking any lock.
+    std::shared_ptr<const UidAppMap> getAppMapSnapshot() const {
+        return std::atomic_load_explicit(&mMap, std::memory_order_acquire);
+    }
+
+    // Returns the current (immutable) isolated uid map snapshot without taking any lock.
+    std::shared_ptr<const IsolatedUidMap> getIsolatedUidMapSnapshot() const {
+        return std::atomic_load_explicit(&mIsolatedUidMap, std::memory_order_acquire);
+    }
+
+    // Current uid map state. The pointed-to map is immutable: per-event readers
+    // (hasApp, getAppVersion, checkLogCredentials, ...) load the pointer atomically and
+    // never take mMutex. Writers hold mMutex, build a modified copy and publish it with
+    // an atomic store, so readers always see either the old or the new complete map.
+    std::shared_ptr<const UidAppMap> mMap;
 
     // Maps isolated uid to the parent uid. Any metrics for an isolated uid will instead contribute
-    // to the parent uid.
-    std::unordered_map<int, int> mIsolatedUidMap;
+    // to the parent uid. Published the same way as mMap: immutable snapshots swapped
+    // under mIsolatedMutex, read lock-free by the per-event uid translation.
+    std::shared_ptr<const IsolatedUidMap> mIsolatedUidMap;
+
+    // Bumped after each isolated uid map publish; see getIsolatedUidMapGeneration().
+    std::atomic<uint64_t> mIsolatedUidMapGeneration{0};
+
+    // Bumped on every bulk replacement from updateMap(), guarded by mMutex. Lets a
+    // deferred certificate hash batch detect that it has been superseded.
+    uint64_t mMapGeneration = 0;
+
+    // Number of certificate hash batches still queued on the worker pool; guarded
+    // by mMutex.
+    int mPendingCertificateHashBatches = 0;
+
+    // Signalled whenever a certificate hash batch finishes.
+    mutable std::condition_variable mCertificateHashesApplied;
 
     // Record the changes that can be provided with the uploads.
     std::list<ChangeRecord> mChanges;
 
-    // Store which uid and apps represent deleted ones.
-    std::list<std::pair<int, string>> mDeletedApps;
+    // Store which (uid, interned package name id) pairs represent deleted apps.
+    std::list<std::pair<int, int32_t>> mDeletedApps;
 
     // Notify StatsLogProcessor if there's an upgrade/removal in any app.
     wp<PackageInfoListener> mSubscriber;
@@ -204,6 +300,17 @@ private:
     // Value of -1 denotes this config key has never received an upload.
     std::unordered_map<ConfigKey, int64_t> mLastUpdatePerConfigKey;
 
+    // Number of consecutive reports per config key that omitted the full snapshot and carried
+    // only change records. Reset to 0 whenever a full snapshot is written, and capped by
+    // StatsdStats::kMaxUidMapDeltaReports so a lost report cannot orphan deltas forever.
+    std::unordered_map<ConfigKey, int32_t> mDeltaReportsPerConfigKey;
+
+    // Timestamp (ns) of the most recent event that broke the delta chain: a bulk map
+    // replacement from updateMap, a change record trimmed by the memory guardrail, or a
+    // forced clearOutput. Configs whose last report does not postdate this need a full
+    // snapshot, since change records alone cannot reconstruct the current map for them.
+    int64_t mLastDeltaChainBreakNs = 0;
+
     // Returns the minimum value from mConfigKeys.
     int64_t getMinimumTimestampNs();
 
@@ -226,7 +333,7 @@ private:
     FRIEND_TEST(UidMapTest, TestClearingOutput);
     FRIEND_TEST(UidMapTest, TestRemovedAppRetained);
     FRIEND_TEST(UidMapTest, TestRemovedAppOverGuardrail);
-    FRIEND_TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot);
+    FRIEND_TEST(UidMapTest, TestDeltaReportsAndRebase);
     FRIEND_TEST(UidMapTest, TestMemoryComputed);
     FRIEND_TEST(UidMapTest, TestMemoryGuardrail);
 };
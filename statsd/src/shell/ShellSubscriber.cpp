@@ -35,7 +35,7 @@ ShellSubscriber::~ShellSubscriber() {
     {
         std::unique_lock<std::mutex> lock(mMutex);
         mClientSet.clear();
-        updateLogEventFilterLocked();
+        onClientSetChangedLocked();
     }
     mThreadSleepCV.notify_one();
     if (mThread.joinable()) {
@@ -75,9 +75,16 @@ bool ShellSubscriber::startNewSubscription(const vector<uint8_t>& subscriptionCo
 bool ShellSubscriber::startNewSubscriptionLocked(unique_ptr<ShellSubscriberClient> client) {
     if (client == nullptr) return false;
 
+    ShellSubscriberClient* clientPtr = client.get();
+
     // Add new valid client to the client set
     mClientSet.insert(std::move(client));
-    updateLogEventFilterLocked();
+    onClientSetChangedLocked();
+
+    // Replay retained events so the new subscriber sees what immediately preceded it.
+    if (clientPtr->getRetentionInfo().has_value()) {
+        replayRetainedEventsLocked(clientPtr);
+    }
 
     // Only spawn one thread to manage pulling atoms and sending
     // heartbeats.
@@ -112,7 +119,7 @@ void ShellSubscriber::pullAndSendHeartbeats() {
                 VLOG("ShellSubscriber: removing client!");
                 (*clientIt)->onUnsubscribe();
                 clientIt = mClientSet.erase(clientIt);
-                updateLogEventFilterLocked();
+                onClientSetChangedLocked();
             }
         }
         if (mClientSet.empty()) {
@@ -134,9 +141,19 @@ void ShellSubscriber::onLogEvent(const LogEvent& event) {
     if (event.isRestricted()) {
         return;
     }
+    // Avoid taking the lock when there are no active subscriptions. An event racing
+    // with a new subscription may be missed, but events are not ordered with respect
+    // to subscription start anyway.
+    if (mClientCount.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
     std::unique_lock<std::mutex> lock(mMutex);
+    bool matchedRetentionClient = false;
     for (auto clientIt = mClientSet.begin(); clientIt != mClientSet.end();) {
-        (*clientIt)->onLogEvent(event);
+        const bool matched = (*clientIt)->onLogEvent(event);
+        if (matched && (*clientIt)->getRetentionInfo().has_value()) {
+            matchedRetentionClient = true;
+        }
         if ((*clientIt)->isAlive()) {
             ++clientIt;
         } else {
@@ -144,9 +161,18 @@ void ShellSubscriber::onLogEvent(const LogEvent& event) {
 
             (*clientIt)->onUnsubscribe();
             clientIt = mClientSet.erase(clientIt);
-            updateLogEventFilterLocked();
+            onClientSetChangedLocked();
         }
     }
+    if (matchedRetentionClient && mRetentionTimeMs > 0) {
+        // Retain a copy for replay to future subscribers. The copy shares the
+        // serialized-atom buffer cached on delivery, so this costs no re-encoding.
+        auto retained = std::make_shared<const LogEvent>(event);
+        const size_t sizeBytes = getSize(retained->getValues());
+        mRetainedEvents.push_back({event.GetElapsedTimestampNs(), sizeBytes, std::move(retained)});
+        mRetainedBytes += sizeBytes;
+        trimRetainedEventsLocked(getElapsedRealtimeNs());
+    }
 }
 
 void ShellSubscriber::flushSubscription(const shared_ptr<IStatsSubscriptionCallback>& callback) {
@@ -167,7 +193,7 @@ void ShellSubscriber::flushSubscription(const shared_ptr<IStatsSubscriptionCallb
                 // moves the iterator, skipping a value. This is fine because we do an early return
                 // before next iteration of the loop.
                 clientIt = mClientSet.erase(clientIt);
-                updateLogEventFilterLocked();
+                onClientSetChangedLocked();
             }
             return;
         }
@@ -189,7 +215,7 @@ void ShellSubscriber::unsubscribe(const shared_ptr<IStatsSubscriptionCallback>&
             // moves the iterator, skipping a value. This is fine because we do an early return
             // before next iteration of the loop.
             clientIt = mClientSet.erase(clientIt);
-            updateLogEventFilterLocked();
+            onClientSetChangedLocked();
             return;
         }
     }
@@ -205,6 +231,48 @@ void ShellSubscriber::updateLogEventFilterLocked() const {
     mLogEventFilter->setAtomIds(std::move(allAtomIds), this);
 }
 
+void ShellSubscriber::onClientSetChangedLocked() {
+    updateLogEventFilterLocked();
+    // Keep the lock-free client count in sync for the onLogEvent fast path.
+    mClientCount.store(mClientSet.size(), std::memory_order_relaxed);
+    mRetentionTimeMs = 0;
+    mRetentionMaxBytes = 0;
+    for (const auto& client : mClientSet) {
+        const auto& retention = client->getRetentionInfo();
+        if (retention.has_value()) {
+            mRetentionTimeMs = std::max(mRetentionTimeMs, retention->mRetentionTimeMs);
+            mRetentionMaxBytes = std::max(mRetentionMaxBytes, retention->mMaxBytes);
+        }
+    }
+    trimRetainedEventsLocked(getElapsedRealtimeNs());
+}
+
+void ShellSubscriber::trimRetainedEventsLocked(int64_t nowNs) {
+    if (mRetentionTimeMs == 0) {
+        mRetainedEvents.clear();
+        mRetainedBytes = 0;
+        return;
+    }
+    const int64_t oldestAllowedNs = nowNs - milliseconds_to_nanoseconds(mRetentionTimeMs);
+    while (!mRetainedEvents.empty() && (mRetainedBytes > mRetentionMaxBytes ||
+                                        mRetainedEvents.front().mTimestampNs < oldestAllowedNs)) {
+        mRetainedBytes -= mRetainedEvents.front().mSizeBytes;
+        mRetainedEvents.pop_front();
+    }
+}
+
+void ShellSubscriber::replayRetainedEventsLocked(ShellSubscriberClient* client) const {
+    const int64_t oldestAllowedNs =
+            getElapsedRealtimeNs() -
+            milliseconds_to_nanoseconds(client->getRetentionInfo()->mRetentionTimeMs);
+    for (const RetainedEvent& retained : mRetainedEvents) {
+        if (retained.mTimestampNs < oldestAllowedNs) {
+            continue;
+        }
+        client->onLogEvent(*retained.mEvent);
+    }
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
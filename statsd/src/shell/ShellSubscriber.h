@@ -18,7 +18,9 @@
 
 #include <aidl/android/os/IStatsSubscriptionCallback.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
 
@@ -93,6 +95,15 @@ private:
     /* Tells LogEventFilter about atom ids to parse */
     void updateLogEventFilterLocked() const;
 
+    /* Recomputes state derived from mClientSet after any addition or removal. */
+    void onClientSetChangedLocked();
+
+    /* Drops retained events that fall outside the current retention limits. */
+    void trimRetainedEventsLocked(int64_t nowNs);
+
+    /* Replays retained events within the client's retention window. */
+    void replayRetainedEventsLocked(ShellSubscriberClient* client) const;
+
     sp<UidMap> mUidMap;
 
     sp<StatsPullerManager> mPullerMgr;
@@ -104,6 +115,29 @@ private:
 
     std::set<unique_ptr<ShellSubscriberClient>> mClientSet;
 
+    // Mirrors mClientSet.size(). Read without the lock on the event path so that
+    // devices with no active shell subscriptions (the common case) pay only a
+    // relaxed atomic load per event instead of a mutex acquisition.
+    std::atomic<size_t> mClientCount = 0;
+
+    struct RetainedEvent {
+        int64_t mTimestampNs;
+        size_t mSizeBytes;
+        std::shared_ptr<const LogEvent> mEvent;
+    };
+
+    // Recent matched events kept for replay to new retention-enabled subscriptions,
+    // oldest first. Non-empty only while such a subscription is active. The retained
+    // LogEvent copies share the serialized-atom buffers populated on delivery, so
+    // replay reuses those bytes instead of re-encoding.
+    std::deque<RetainedEvent> mRetainedEvents;
+
+    size_t mRetainedBytes = 0;
+
+    // Widest limits across active retention-enabled subscriptions; zero when none.
+    int64_t mRetentionTimeMs = 0;
+    size_t mRetentionMaxBytes = 0;
+
     bool mThreadAlive = false;
 
     std::condition_variable mThreadSleepCV;
@@ -18,10 +18,14 @@
 
 #include "ShellSubscriberClient.h"
 
+#include <limits.h>
+#include <sys/uio.h>
+
 #include "FieldValue.h"
 #include "guardrail/StatsdStats.h"
 #include "matchers/matcher_util.h"
 #include "stats_log_util.h"
+#include "utils/ProtoStreamPool.h"
 
 using android::base::unique_fd;
 using Status = ::ndk::ScopedAStatus;
@@ -40,6 +44,7 @@ static int nextSubId = 0;
 struct ReadConfigResult {
     vector<SimpleAtomMatcher> pushedMatchers;
     vector<ShellSubscriberClient::PullInfo> pullInfo;
+    optional<ShellSubscriberClient::RetentionInfo> retention;
 };
 
 // Read and parse single config. There should only one config in the input.
@@ -75,9 +80,59 @@ static optional<ReadConfigResult> readConfig(const vector<uint8_t>& configBytes,
               pulled.matcher().atom_id());
     }
 
+    if (config.has_retention() && config.retention().retention_time_millis() > 0) {
+        const int64_t retentionTimeMs = min(config.retention().retention_time_millis(),
+                                            ShellSubscriberClient::kMaxRetentionTimeMs);
+        const size_t maxBytes =
+                config.retention().max_bytes() > 0
+                        ? min((size_t)config.retention().max_bytes(),
+                              ShellSubscriberClient::kMaxRetentionBytes)
+                        : ShellSubscriberClient::kMaxRetentionBytes;
+        result.retention = ShellSubscriberClient::RetentionInfo{retentionTimeMs, maxBytes};
+        ALOGD("ShellSubscriberClient: retention enabled for %lld ms, %zu bytes",
+              (long long)retentionTimeMs, maxBytes);
+    }
+
     return result;
 }
 
+// Serializes the contents of the proto stream into a contiguous buffer.
+static std::shared_ptr<const vector<uint8_t>> serializeProto(ProtoOutputStream& protoOutput) {
+    auto buffer = std::make_shared<vector<uint8_t>>(protoOutput.size());
+    size_t pos = 0;
+    sp<android::util::ProtoReader> reader = protoOutput.data();
+    while (reader->readBuffer() != NULL) {
+        size_t toRead = reader->currentToRead();
+        std::memcpy(buffer->data() + pos, reader->readBuffer(), toRead);
+        pos += toRead;
+        reader->move(toRead);
+    }
+    return buffer;
+}
+
+// Writes all iovec segments to the fd, advancing past partial writes so the payload
+// goes out in a single writev syscall in the common case.
+static bool writevFully(int fd, std::vector<iovec>& iov) {
+    size_t index = 0;
+    while (index < iov.size()) {
+        const int count = static_cast<int>(std::min<size_t>(iov.size() - index, IOV_MAX));
+        const ssize_t written = TEMP_FAILURE_RETRY(writev(fd, iov.data() + index, count));
+        if (written <= 0) {
+            return false;
+        }
+        size_t remaining = static_cast<size_t>(written);
+        while (index < iov.size() && remaining >= iov[index].iov_len) {
+            remaining -= iov[index].iov_len;
+            index++;
+        }
+        if (remaining > 0) {
+            iov[index].iov_base = static_cast<uint8_t*>(iov[index].iov_base) + remaining;
+            iov[index].iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
 ShellSubscriberClient::PullInfo::PullInfo(const SimpleAtomMatcher& matcher, int64_t startTimeMs,
                                           int64_t intervalMs,
                                           const std::vector<std::string>& packages,
@@ -93,7 +148,8 @@ ShellSubscriberClient::ShellSubscriberClient(
         int id, int out, const std::shared_ptr<IStatsSubscriptionCallback>& callback,
         const std::vector<SimpleAtomMatcher>& pushedMatchers,
         const std::vector<PullInfo>& pulledInfo, int64_t timeoutSec, int64_t startTimeSec,
-        const sp<UidMap>& uidMap, const sp<StatsPullerManager>& pullerMgr)
+        const sp<UidMap>& uidMap, const sp<StatsPullerManager>& pullerMgr,
+        const std::optional<RetentionInfo>& retention)
     : mId(id),
       mUidMap(uidMap),
       mPullerMgr(pullerMgr),
@@ -103,6 +159,7 @@ ShellSubscriberClient::ShellSubscriberClient(
       mCallback(callback),
       mTimeoutSec(timeoutSec),
       mStartTimeSec(startTimeSec),
+      mRetention(retention),
       mLastWriteMs(startTimeSec * 1000),
       mCacheSize(0){};
 
@@ -138,7 +195,8 @@ unique_ptr<ShellSubscriberClient> ShellSubscriberClient::create(
 
     return make_unique<ShellSubscriberClient>(
             nextSubId++, out, /*callback=*/nullptr, readConfigResult->pushedMatchers,
-            readConfigResult->pullInfo, timeoutSec, startTimeSec, uidMap, pullerMgr);
+            readConfigResult->pullInfo, timeoutSec, startTimeSec, uidMap, pullerMgr,
+            readConfigResult->retention);
 }
 
 unique_ptr<ShellSubscriberClient> ShellSubscriberClient::create(
@@ -170,7 +228,7 @@ unique_ptr<ShellSubscriberClient> ShellSubscriberClient::create(
                                                        readConfigResult->pullInfo.size());
     return make_unique<ShellSubscriberClient>(
             id, /*out=*/-1, callback, readConfigResult->pushedMatchers, readConfigResult->pullInfo,
-            /*timeoutSec=*/-1, startTimeSec, uidMap, pullerMgr);
+            /*timeoutSec=*/-1, startTimeSec, uidMap, pullerMgr, readConfigResult->retention);
 }
 
 bool ShellSubscriberClient::writeEventToProtoIfMatched(const LogEvent& event,
@@ -182,11 +240,28 @@ bool ShellSubscriberClient::writeEventToProtoIfMatched(const LogEvent& event,
     }
     const LogEvent& eventRef = transformedEvent == nullptr ? event : *transformedEvent;
 
-    // Cache atom event in mProtoOut.
-    uint64_t atomToken = mProtoOut.start(util::FIELD_TYPE_MESSAGE | util::FIELD_COUNT_REPEATED |
-                                         FIELD_ID_SHELL_DATA__ATOM);
-    eventRef.ToProto(mProtoOut);
-    mProtoOut.end(atomToken);
+    // Cache atom event in mProtoOut. Untransformed events are serialized once into a
+    // shared refcounted buffer on the LogEvent itself, so additional subscribers (and
+    // EventMetricProducers) reuse the bytes instead of re-encoding the field value tree.
+    // Transformed events are client-specific and cannot share the cache.
+    if (transformedEvent == nullptr) {
+        std::shared_ptr<const vector<uint8_t>> serializedAtom = event.getCachedSerializedAtom();
+        if (serializedAtom == nullptr) {
+            PooledProtoStream atomProto = ProtoStreamPool::getInstance().borrow();
+            event.ToProto(*atomProto);
+            serializedAtom = serializeProto(*atomProto);
+            event.cacheSerializedAtom(serializedAtom);
+        }
+        mProtoOut.write(util::FIELD_TYPE_MESSAGE | util::FIELD_COUNT_REPEATED |
+                                FIELD_ID_SHELL_DATA__ATOM,
+                        reinterpret_cast<const char*>(serializedAtom->data()),
+                        serializedAtom->size());
+    } else {
+        uint64_t atomToken = mProtoOut.start(util::FIELD_TYPE_MESSAGE | util::FIELD_COUNT_REPEATED |
+                                             FIELD_ID_SHELL_DATA__ATOM);
+        eventRef.ToProto(mProtoOut);
+        mProtoOut.end(atomToken);
+    }
 
     const int64_t timestampNs = truncateTimestampIfNecessary(eventRef);
     mProtoOut.write(util::FIELD_TYPE_INT64 | util::FIELD_COUNT_REPEATED |
@@ -200,13 +275,14 @@ bool ShellSubscriberClient::writeEventToProtoIfMatched(const LogEvent& event,
 }
 
 // Called by ShellSubscriber when a pushed event occurs
-void ShellSubscriberClient::onLogEvent(const LogEvent& event) {
+bool ShellSubscriberClient::onLogEvent(const LogEvent& event) {
     for (const auto& matcher : mPushedMatchers) {
         if (writeEventToProtoIfMatched(event, matcher, mUidMap)) {
             flushProtoIfNeeded();
-            break;
+            return true;
         }
     }
+    return false;
 }
 
 void ShellSubscriberClient::flushProtoIfNeeded() {
@@ -311,14 +387,20 @@ void ShellSubscriberClient::writePulledAtomsLocked(const vector<shared_ptr<LogEv
 // because the read end of the pipe has closed, change the client status so
 // the manager knows the subscription is no longer active
 void ShellSubscriberClient::attemptWriteToPipeLocked() {
-    const size_t dataSize = mProtoOut.size();
-    // First, write the payload size.
-    if (!android::base::WriteFully(mDupOut, &dataSize, sizeof(dataSize))) {
-        mClientAlive = false;
-        return;
+    size_t dataSize = mProtoOut.size();
+    // Gather the payload size header and the cached proto segments into one writev
+    // call instead of issuing a write per ProtoOutputStream buffer.
+    std::vector<iovec> iov;
+    iov.push_back({&dataSize, sizeof(dataSize)});
+    if (dataSize > 0) {  // The payload is empty for heartbeats.
+        sp<android::util::ProtoReader> reader = mProtoOut.data();
+        while (reader->readBuffer() != NULL) {
+            size_t toRead = reader->currentToRead();
+            iov.push_back({const_cast<uint8_t*>(reader->readBuffer()), toRead});
+            reader->move(toRead);
+        }
     }
-    // Then, write the payload if this is not just a heartbeat.
-    if (dataSize > 0 && !mProtoOut.flush(mDupOut.get())) {
+    if (!writevFully(mDupOut.get(), iov)) {
         mClientAlive = false;
         return;
     }
@@ -23,6 +23,7 @@
 #include <private/android_filesystem_config.h>
 
 #include <memory>
+#include <optional>
 
 #include "external/StatsPullerManager.h"
 #include "logd/LogEvent.h"
@@ -53,6 +54,13 @@ public:
         const std::vector<int32_t> mPullUids;
     };
 
+    // Retention window requested by this subscription, parsed from
+    // ShellSubscription.retention and clamped to the guardrails below.
+    struct RetentionInfo {
+        int64_t mRetentionTimeMs;
+        size_t mMaxBytes;
+    };
+
     static std::unique_ptr<ShellSubscriberClient> create(int in, int out, int64_t timeoutSec,
                                                          int64_t startTimeSec,
                                                          const sp<UidMap>& uidMap,
@@ -69,9 +77,11 @@ public:
                                    const std::vector<SimpleAtomMatcher>& pushedMatchers,
                                    const std::vector<PullInfo>& pulledInfo, int64_t timeoutSec,
                                    int64_t startTimeSec, const sp<UidMap>& uidMap,
-                                   const sp<StatsPullerManager>& pullerMgr);
+                                   const sp<StatsPullerManager>& pullerMgr,
+                                   const std::optional<RetentionInfo>& retention = std::nullopt);
 
-    void onLogEvent(const LogEvent& event);
+    // Returns true if the event matched one of this subscription's pushed matchers.
+    bool onLogEvent(const LogEvent& event);
 
     int64_t pullAndSendHeartbeatsIfNeeded(int64_t nowSecs, int64_t nowMillis, int64_t nowNanos);
 
@@ -96,9 +106,17 @@ public:
 
     void addAllAtomIds(LogEventFilter::AtomIdSet& allAtomIds) const;
 
+    const std::optional<RetentionInfo>& getRetentionInfo() const {
+        return mRetention;
+    }
+
     // Minimum pull interval for callback subscriptions.
     static constexpr int64_t kMinCallbackPullIntervalMs = 60'000;  // 60 seconds.
 
+    // Guardrails for EventRetentionConfig.
+    static constexpr int64_t kMaxRetentionTimeMs = 60'000;  // 60 seconds.
+    static constexpr size_t kMaxRetentionBytes = 512 * 1024;  // 512 KB
+
     // Minimum sleep for the pull thread for callback subscriptions.
     static constexpr int64_t kMinCallbackSleepIntervalMs = 2000;  // 2 seconds.
 private:
@@ -143,6 +161,8 @@ private:
 
     const int64_t mStartTimeSec;
 
+    const std::optional<RetentionInfo> mRetention;
+
     bool mClientAlive = true;
 
     int64_t mLastWriteMs;
@@ -18,10 +18,13 @@
 
 #include <gtest/gtest_prod.h>
 
+#include <algorithm>
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace android {
 namespace os {
@@ -52,11 +55,53 @@ public:
         return mLogsFilteringEnabled;
     }
 
+    /**
+     * Immutable filter snapshot published by setAtomIds(): a dense bitset
+     * indexed by atom id, so membership is a couple of loads with no hashing.
+     * Snapshots are never mutated after publication (RCU-style), readers hold
+     * a refcount on the one they last observed.
+     */
+    class FilterSnapshot {
+    public:
+        FilterSnapshot() = default;
+
+        explicit FilterSnapshot(const T& ids) {
+            int maxId = -1;
+            for (const int id : ids) {
+                maxId = std::max(maxId, id);
+            }
+            mBits.resize(maxId < 0 ? 0 : (maxId >> 6) + 1, 0);
+            for (const int id : ids) {
+                if (id >= 0) {
+                    mBits[id >> 6] |= uint64_t(1) << (id & 63);
+                    mCount++;
+                }
+            }
+        }
+
+        bool contains(int atomId) const {
+            const size_t word = size_t(atomId) >> 6;
+            if (atomId < 0 || word >= mBits.size()) {
+                return false;
+            }
+            return (mBits[word] >> (atomId & 63)) & 1;
+        }
+
+        size_t size() const {
+            return mCount;
+        }
+
+    private:
+        std::vector<uint64_t> mBits;
+        size_t mCount = 0;
+    };
+
     /**
      * @brief Tests atom id with list of interesting atoms
      *        If Logs filtering is disabled - assume all atoms in use
-     *        Most of the time should be non-blocking call - only in case when setAtomIds() was
-     *        called the call will be blocking due to atom list needs to be synced up
+     *        Lock-free: reads go against the locally cached immutable snapshot,
+     *        which is refreshed from the published one only after setAtomIds()
+     *        was called - no mutex is taken even across updates
      * @param atomId
      * @return true if atom is used by any of consumer or filtering is disabled
      */
@@ -65,13 +110,13 @@ public:
             return true;
         }
 
-        // check if there is an updated set of interesting atom ids
-        if (mLocalSetUpdateCounter != mSetUpdateCounter.load(std::memory_order_relaxed)) {
-            std::lock_guard<std::mutex> guard(mTagIdsMutex);
-            mLocalSetUpdateCounter = mSetUpdateCounter.load(std::memory_order_relaxed);
-            mLocalTagIds.swap(mTagIds);
+        // check if there is an updated snapshot of interesting atom ids
+        const int counter = mSetUpdateCounter.load(std::memory_order_acquire);
+        if (mLocalSetUpdateCounter != counter) {
+            mLocalSetUpdateCounter = counter;
+            mLocalSnapshot = std::atomic_load_explicit(&mSnapshot, std::memory_order_acquire);
         }
-        return mLocalTagIds.find(atomId) != mLocalTagIds.end();
+        return mLocalSnapshot->contains(atomId);
     }
 
     typedef const void* ConsumerId;
@@ -96,7 +141,12 @@ public:
         for (const auto& [_, atomIds] : mTagIdsPerConsumer) {
             mTagIds.insert(atomIds.begin(), atomIds.end());
         }
-        mSetUpdateCounter.fetch_add(1, std::memory_order_relaxed);
+        // publish a fresh immutable snapshot; readers pick it up lazily
+        std::atomic_store_explicit(&mSnapshot,
+                                   std::shared_ptr<const FilterSnapshot>(
+                                           std::make_shared<const FilterSnapshot>(mTagIds)),
+                                   std::memory_order_release);
+        mSetUpdateCounter.fetch_add(1, std::memory_order_release);
     }
 
 private:
@@ -106,8 +156,16 @@ private:
 
     mutable std::mutex mTagIdsMutex;
     std::unordered_map<ConsumerId, AtomIdSet> mTagIdsPerConsumer;
-    mutable AtomIdSet mTagIds;
-    mutable AtomIdSet mLocalTagIds;
+    AtomIdSet mTagIds;
+
+    // currently published snapshot, swapped atomically by setAtomIds()
+    std::shared_ptr<const FilterSnapshot> mSnapshot = std::make_shared<const FilterSnapshot>();
+    // reader-side cache of the last observed snapshot, see isAtomInUse()
+    mutable std::shared_ptr<const FilterSnapshot> mLocalSnapshot = mSnapshot;
+
+    size_t localSetSizeForTest() const {
+        return mLocalSnapshot->size();
+    }
 
     friend class LogEventFilterTest;
 
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "SocketPayloadCapture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+SocketPayloadCapture& SocketPayloadCapture::getInstance() {
+    static SocketPayloadCapture* instance = new SocketPayloadCapture();
+    return *instance;
+}
+
+bool SocketPayloadCapture::start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFd >= 0) {
+        ALOGW("Socket payload capture already running");
+        return false;
+    }
+    const int fd = TEMP_FAILURE_RETRY(
+            open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR));
+    if (fd < 0) {
+        ALOGE("Failed to open socket capture file %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    const uint32_t magic = kFileMagic;
+    if (TEMP_FAILURE_RETRY(write(fd, &magic, sizeof(magic))) != (ssize_t)sizeof(magic)) {
+        ALOGE("Failed to write socket capture header: %s", strerror(errno));
+        close(fd);
+        return false;
+    }
+    mFd = fd;
+    mWrittenBytes = sizeof(magic);
+    mEnabled.store(true, std::memory_order_release);
+    ALOGI("Socket payload capture started: %s", path.c_str());
+    return true;
+}
+
+void SocketPayloadCapture::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    stopLocked();
+}
+
+void SocketPayloadCapture::stopLocked() {
+    if (mFd < 0) {
+        return;
+    }
+    mEnabled.store(false, std::memory_order_release);
+    close(mFd);
+    mFd = -1;
+    ALOGI("Socket payload capture stopped after %zu bytes", mWrittenBytes);
+}
+
+void SocketPayloadCapture::capture(const uint8_t* data, uint32_t len,
+                                   int64_t elapsedRealtimeNs) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFd < 0) {
+        // Lost the race with stop(); the relaxed gate check is best-effort.
+        return;
+    }
+    const size_t recordSize = sizeof(elapsedRealtimeNs) + sizeof(len) + len;
+    if (mWrittenBytes + recordSize > kMaxCaptureBytes) {
+        ALOGW("Socket payload capture hit the %zu byte cap", kMaxCaptureBytes);
+        stopLocked();
+        return;
+    }
+    if (TEMP_FAILURE_RETRY(write(mFd, &elapsedRealtimeNs, sizeof(elapsedRealtimeNs))) !=
+                (ssize_t)sizeof(elapsedRealtimeNs) ||
+        TEMP_FAILURE_RETRY(write(mFd, &len, sizeof(len))) != (ssize_t)sizeof(len) ||
+        TEMP_FAILURE_RETRY(write(mFd, data, len)) != (ssize_t)len) {
+        ALOGE("Failed to write socket capture record: %s", strerror(errno));
+        stopLocked();
+        return;
+    }
+    mWrittenBytes += recordSize;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
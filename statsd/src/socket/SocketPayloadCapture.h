@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Debug-only recorder for raw statsd socket datagrams, enabled through the
+ * "log-capture" shell command on eng/userdebug builds. Captured traces make
+ * partner-reported CPU regressions reproducible: the statsd_trace_replay tool
+ * feeds the file back through the socket at original or accelerated pacing.
+ *
+ * File format (all fields little-endian):
+ *   uint32_t magic ("STC1")
+ * followed by one record per datagram:
+ *   int64_t  captureElapsedRealtimeNs
+ *   uint32_t payloadLen
+ *   uint8_t  payload[payloadLen]   // full datagram, including android_log_header_t
+ */
+class SocketPayloadCapture {
+public:
+    static SocketPayloadCapture& getInstance();
+
+    /* Starts recording into the given file, truncating it. Returns false if the
+     * file cannot be opened or a capture is already running. */
+    bool start(const std::string& path);
+
+    /* Stops recording and closes the file. Safe to call when not recording. */
+    void stop();
+
+    /* Cheap gate for the socket read loop; capture() is only called when true. */
+    inline bool isEnabled() const {
+        return mEnabled.load(std::memory_order_relaxed);
+    }
+
+    /* Appends one datagram record. Stops the capture when the size cap is hit. */
+    void capture(const uint8_t* data, uint32_t len, int64_t elapsedRealtimeNs);
+
+    static constexpr uint32_t kFileMagic = 0x31435453;  // "STC1"
+
+    // Upper bound on the capture file size so a forgotten capture cannot fill
+    // /data/misc/stats-service.
+    static constexpr size_t kMaxCaptureBytes = 64 * 1024 * 1024;
+
+private:
+    SocketPayloadCapture() = default;
+
+    void stopLocked();
+
+    std::atomic<bool> mEnabled = false;
+
+    mutable std::mutex mMutex;
+    int mFd = -1;
+    size_t mWrittenBytes = 0;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -29,7 +29,12 @@
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
+
+#include "SocketPayloadCapture.h"
 #include "guardrail/StatsdStats.h"
+#include "utils/MemoryAccounting.h"
+#include "logd/LogEventPool.h"
 #include "logd/logevent_util.h"
 #include "stats_log_util.h"
 #include "statslog_statsd.h"
@@ -52,14 +57,29 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
         name_set = true;
     }
 
+    // Allocations on the ingestion thread (LogEvent bodies, queue growth) are
+    // charged to the queue subsystem when allocation accounting is enabled.
+    ScopedMemoryTag memoryTag(MemoryAccounting::kQueue);
+
+    // One receive buffer + control-message block per datagram in the batch.
+    // onDataAvailable() is only ever invoked from the single SocketListener
+    // thread (named "statsd.writer" above), so static reuse is safe and keeps
+    // the ~128KiB of receive buffers off the thread stack.
     // + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
-    char buffer[sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD + 1];
-    struct iovec iov = {buffer, sizeof(buffer) - 1};
+    static char buffers[kMaxBatchSize][sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD + 1];
+    alignas(4) static char controls[kMaxBatchSize][CMSG_SPACE(sizeof(struct ucred))];
+    static struct iovec iovs[kMaxBatchSize];
+    static struct mmsghdr msgs[kMaxBatchSize];
 
-    alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
-    struct msghdr hdr = {
-            NULL, 0, &iov, 1, control, sizeof(control), 0,
-    };
+    // recvmmsg() overwrites msg_len/msg_controllen, so the headers are
+    // re-initialized on every call.
+    for (uint32_t i = 0; i < kMaxBatchSize; i++) {
+        iovs[i] = {buffers[i], sizeof(buffers[i]) - 1};
+        msgs[i].msg_hdr = {
+                NULL, 0, &iovs[i], 1, controls[i], sizeof(controls[i]), 0,
+        };
+        msgs[i].msg_len = 0;
+    }
 
     int socket = cli->getSocket();
 
@@ -67,91 +87,214 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
     // overhead under logging load. We are safe because we check counts, but
     // still need to clear null terminator
     // memset(buffer, 0, sizeof(buffer));
-    ssize_t n = recvmsg(socket, &hdr, 0);
-    if (n <= (ssize_t)(sizeof(android_log_header_t))) {
+    //
+    // Drain up to kMaxBatchSize datagrams with a single syscall to amortize
+    // the per-datagram syscall cost during logging bursts. MSG_DONTWAIT keeps
+    // the call from blocking once the socket is empty; the poll loop in
+    // SocketListener will call back in when more data arrives.
+    int count = TEMP_FAILURE_RETRY(recvmmsg(socket, msgs, kMaxBatchSize, MSG_DONTWAIT, nullptr));
+    if (count <= 0) {
         return false;
     }
 
-    buffer[n] = 0;
+    std::vector<std::unique_ptr<LogEvent>> batch;
+    batch.reserve(count);
 
-    struct ucred* cred = NULL;
+    // One clock read covers token refill for the whole batch.
+    const int64_t nowNs = getElapsedRealtimeNs();
 
-    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
-    while (cmsg != NULL) {
-        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
-            cred = (struct ucred*)CMSG_DATA(cmsg);
-            break;
+    for (int i = 0; i < count; i++) {
+        char* buffer = buffers[i];
+        ssize_t n = msgs[i].msg_len;
+        if (n <= (ssize_t)(sizeof(android_log_header_t))) {
+            continue;
         }
-        cmsg = CMSG_NXTHDR(&hdr, cmsg);
-    }
 
-    struct ucred fake_cred;
-    if (cred == NULL) {
-        cred = &fake_cred;
-        cred->pid = 0;
-        cred->uid = DEFAULT_OVERFLOWUID;
-    }
+        buffer[n] = 0;
 
-    uint8_t* ptr = ((uint8_t*)buffer) + sizeof(android_log_header_t);
-    n -= sizeof(android_log_header_t);
+        // Debug capture of the raw datagram (including atoms the filter would
+        // reject below) so partner workloads can be replayed on a bench. The
+        // relaxed atomic gate keeps this free when no capture is running.
+        if (SocketPayloadCapture::getInstance().isEnabled()) {
+            SocketPayloadCapture::getInstance().capture((const uint8_t*)buffer, n,
+                                                        getElapsedRealtimeNs());
+        }
 
-    // When a log failed to write to statsd socket (e.g., due ot EBUSY), a special message would
-    // be sent to statsd when the socket communication becomes available again.
-    // The format is android_log_event_int_t with a single integer in the payload indicating the
-    // number of logs that failed. (*FORMAT MUST BE IN SYNC WITH system/core/libstats*)
-    // Note that all normal stats logs are in the format of event_list, so there won't be confusion.
-    //
-    // TODO(b/80538532): In addition to log it in StatsdStats, we should properly reset the config.
-    if (n == sizeof(android_log_event_long_t)) {
-        android_log_event_long_t* long_event = reinterpret_cast<android_log_event_long_t*>(ptr);
-        if (long_event->payload.type == EVENT_TYPE_LONG) {
-            int64_t composed_long = long_event->payload.data;
-
-            // format:
-            // |last_tag|dropped_count|
-            int32_t dropped_count = (int32_t)(0xffffffff & composed_long);
-            int32_t last_atom_tag = (int32_t)((0xffffffff00000000 & (uint64_t)composed_long) >> 32);
-
-            ALOGE("Found dropped events: %d error %d last atom tag %d from uid %d", dropped_count,
-                  long_event->header.tag, last_atom_tag, cred->uid);
-            StatsdStats::getInstance().noteLogLost((int32_t)getWallClockSec(), dropped_count,
-                                                   long_event->header.tag, last_atom_tag, cred->uid,
-                                                   cred->pid);
-            return true;
+        uint8_t* payload = ((uint8_t*)buffer) + sizeof(android_log_header_t);
+        const ssize_t payloadLen = n - sizeof(android_log_header_t);
+
+        // Fast reject: for filtered-out atoms (the common case with one slim
+        // config) peek the atom id at its fixed offset and drop the datagram
+        // before any CMSG walk or LogEvent construction. The dropped-count
+        // special message is excluded by its distinctive length.
+        if (payloadLen != (ssize_t)sizeof(android_log_event_long_t) &&
+            mLogEventFilter->getFilteringEnabled()) {
+            int64_t peekedTimestampNs = 0;
+            const int32_t peekedAtomId = peekAtomId(payload + sizeof(uint32_t),
+                                                    payloadLen - sizeof(uint32_t),
+                                                    &peekedTimestampNs);
+            if (peekedAtomId != 0 && !mLogEventFilter->isAtomInUse(peekedAtomId)) {
+                // keep the per-atom accounting the header-only parse used to do
+                StatsdStats::getInstance().noteAtomLogged(
+                        peekedAtomId, peekedTimestampNs / NS_PER_SEC, /*isSkipped=*/true);
+                StatsdStats::getInstance().noteEventFastRejected();
+                continue;
+            }
         }
-    }
 
-    // move past the 4-byte StatsEventTag
-    const uint8_t* msg = ptr + sizeof(uint32_t);
-    const uint32_t len = n - sizeof(uint32_t);
-    const uint32_t uid = cred->uid;
-    const uint32_t pid = cred->pid;
+        struct ucred* cred = NULL;
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+        while (cmsg != NULL) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
+                cred = (struct ucred*)CMSG_DATA(cmsg);
+                break;
+            }
+            cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg);
+        }
+
+        struct ucred fake_cred;
+        if (cred == NULL) {
+            cred = &fake_cred;
+            cred->pid = 0;
+            cred->uid = DEFAULT_OVERFLOWUID;
+        }
+
+        uint8_t* ptr = payload;
+        n = payloadLen;
+
+        // When a log failed to write to statsd socket (e.g., due ot EBUSY), a special message
+        // would be sent to statsd when the socket communication becomes available again.
+        // The format is android_log_event_int_t with a single integer in the payload indicating
+        // the number of logs that failed. (*FORMAT MUST BE IN SYNC WITH system/core/libstats*)
+        // Note that all normal stats logs are in the format of event_list, so there won't be
+        // confusion.
+        //
+        // TODO(b/80538532): In addition to log it in StatsdStats, we should properly reset the
+        // config.
+        if (n == sizeof(android_log_event_long_t)) {
+            android_log_event_long_t* long_event = reinterpret_cast<android_log_event_long_t*>(ptr);
+            if (long_event->payload.type == EVENT_TYPE_LONG) {
+                int64_t composed_long = long_event->payload.data;
+
+                // format:
+                // |last_tag|dropped_count|
+                int32_t dropped_count = (int32_t)(0xffffffff & composed_long);
+                int32_t last_atom_tag =
+                        (int32_t)((0xffffffff00000000 & (uint64_t)composed_long) >> 32);
+
+                ALOGE("Found dropped events: %d error %d last atom tag %d from uid %d",
+                      dropped_count, long_event->header.tag, last_atom_tag, cred->uid);
+                StatsdStats::getInstance().noteLogLost((int32_t)getWallClockSec(), dropped_count,
+                                                       long_event->header.tag, last_atom_tag,
+                                                       cred->uid, cred->pid);
+                continue;
+            }
+        }
 
-    processMessage(msg, len, uid, pid, mQueue, mLogEventFilter);
+        // move past the 4-byte StatsEventTag
+        const uint8_t* msg = ptr + sizeof(uint32_t);
+        const uint32_t len = n - sizeof(uint32_t);
+        const uint32_t uid = cred->uid;
+        const uint32_t pid = cred->pid;
+
+        // A single runaway app can push tens of thousands of atoms per second
+        // through the socket and starve every other client of queue space.
+        // Charge the datagram against the sender's token bucket and drop it
+        // here, before LogEvent construction, once the uid exceeds its rate.
+        if (isUidThrottled(uid, nowNs)) {
+            StatsdStats::getInstance().noteEventThrottled();
+            continue;
+        }
+
+        // A group datagram (root byte LIST_TYPE rather than OBJECT_TYPE)
+        // carries several correlated events; it is parsed and queued as a
+        // unit so overflow can never split the group.
+        if (processGroupMessage(msg, len, uid, pid, mQueue, mLogEventFilter)) {
+            continue;
+        }
+
+        batch.push_back(createLogEvent(msg, len, uid, pid, mLogEventFilter));
+    }
+
+    if (!batch.empty()) {
+        pushToQueue(batch, mQueue);
+    }
 
     return true;
 }
 
-void StatsSocketListener::processMessage(const uint8_t* msg, uint32_t len, uint32_t uid,
-                                         uint32_t pid, const std::shared_ptr<LogEventQueue>& queue,
-                                         const std::shared_ptr<LogEventFilter>& filter) {
-    std::unique_ptr<LogEvent> logEvent = std::make_unique<LogEvent>(uid, pid);
+bool StatsSocketListener::isUidThrottled(uint32_t uid, int64_t nowNs) {
+    if (uid < kFirstApplicationUid) {
+        // Platform telemetry is never throttled.
+        return false;
+    }
+    UidTokenBucket& bucket = mUidBuckets[uid % kThrottleSlots];
+    if (bucket.uid != uid) {
+        // First sighting of this uid, or a collision evicting the previous
+        // occupant: hand the slot over with a full burst allowance.
+        bucket.uid = uid;
+        bucket.tokens = kThrottleBurstTokens;
+        bucket.lastRefillNs = nowNs;
+    } else if (nowNs > bucket.lastRefillNs) {
+        const int64_t refill =
+                (nowNs - bucket.lastRefillNs) * kThrottleTokensPerSec / NS_PER_SEC;
+        // Only advance the refill timestamp when whole tokens accrued, so
+        // sub-token elapsed intervals are not truncated away.
+        if (refill > 0) {
+            bucket.tokens = std::min(kThrottleBurstTokens, bucket.tokens + refill);
+            bucket.lastRefillNs = nowNs;
+        }
+    }
+    if (bucket.tokens <= 0) {
+        return true;
+    }
+    bucket.tokens--;
+    return false;
+}
 
-    if (filter->getFilteringEnabled()) {
-        const LogEvent::BodyBufferInfo bodyInfo = logEvent->parseHeader(msg, len);
-        if (filter->isAtomInUse(logEvent->GetTagId())) {
+int32_t StatsSocketListener::peekAtomId(const uint8_t* msg, uint32_t len,
+                                        int64_t* elapsedTimestampNs) {
+    // Mirrors the fixed prefix layout parsed by LogEvent::parseHeader:
+    // OBJECT_TYPE | numElements | INT64_TYPE | timestamp | INT32_TYPE | atomId
+    constexpr uint32_t kTimestampOffset = 3;
+    constexpr uint32_t kAtomIdOffset = kTimestampOffset + sizeof(int64_t) + 1;
+    if (len < kAtomIdOffset + sizeof(int32_t)) {
+        return 0;
+    }
+    if ((msg[0] & 0x0F) != OBJECT_TYPE || (msg[2] & 0x0F) != INT64_TYPE ||
+        (msg[kAtomIdOffset - 1] & 0x0F) != INT32_TYPE) {
+        return 0;
+    }
+    int64_t timestampNs;
+    memcpy(&timestampNs, msg + kTimestampOffset, sizeof(timestampNs));
+    *elapsedTimestampNs = timestampNs;
+    int32_t atomId;
+    memcpy(&atomId, msg + kAtomIdOffset, sizeof(atomId));
+    return atomId;
+}
+
+std::unique_ptr<LogEvent> StatsSocketListener::createLogEvent(
+        const uint8_t* msg, uint32_t len, uint32_t uid, uint32_t pid,
+        const std::shared_ptr<LogEventFilter>& filter) {
+    std::unique_ptr<LogEvent> logEvent = LogEventPool::getInstance().acquire(uid, pid);
+
+    const LogEvent::BodyBufferInfo bodyInfo = logEvent->parseHeader(msg, len);
+    if (!filter->getFilteringEnabled() || filter->isAtomInUse(logEvent->GetTagId())) {
+        if (logEvent->GetTagId() == util::STATS_SOCKET_LOSS_REPORTED) {
+            // loss info accounting below needs the materialized values
             logEvent->parseBody(bodyInfo);
+        } else {
+            // Defer FieldValue/string materialization to the processor thread:
+            // the event keeps a refcounted copy of the body, so the ingestion
+            // thread pays one bounded memcpy instead of per-field work, and
+            // events dropped on queue overflow never materialize at all.
+            logEvent->retainBodyBuffer(bodyInfo);
         }
-    } else {
-        logEvent->parseBuffer(msg, len);
     }
 
-    const int32_t atomId = logEvent->GetTagId();
-    const bool isAtomSkipped = logEvent->isParsedHeaderOnly();
-    const int64_t atomTimestamp = logEvent->GetElapsedTimestampNs();
-
-    if (atomId == util::STATS_SOCKET_LOSS_REPORTED) {
-        if (isAtomSkipped) {
+    if (logEvent->GetTagId() == util::STATS_SOCKET_LOSS_REPORTED) {
+        if (logEvent->isParsedHeaderOnly()) {
             ALOGW("Atom STATS_SOCKET_LOSS_REPORTED should not be skipped");
         }
 
@@ -165,11 +308,98 @@ void StatsSocketListener::processMessage(const uint8_t* msg, uint32_t len, uint3
         }
     }
 
-    const auto [success, oldestTimestamp, queueSize] = queue->push(std::move(logEvent));
+    return logEvent;
+}
+
+bool StatsSocketListener::processGroupMessage(const uint8_t* msg, uint32_t len, uint32_t uid,
+                                              uint32_t pid,
+                                              const std::shared_ptr<LogEventQueue>& queue,
+                                              const std::shared_ptr<LogEventFilter>& filter) {
+    // Frame layout written by AStatsEvent_writeGroup:
+    // LIST_TYPE | event count | per event: uint32_t payload size + payload
+    if (len < 2 || (msg[0] & 0x0F) != LIST_TYPE) {
+        return false;
+    }
+    const uint8_t eventCount = msg[1];
+    std::vector<std::unique_ptr<LogEvent>> group;
+    group.reserve(eventCount);
+    uint32_t offset = 2;
+    for (uint8_t i = 0; i < eventCount; i++) {
+        uint32_t eventLen = 0;
+        if (offset + sizeof(eventLen) > len) {
+            ALOGE("Dropping truncated group datagram from uid %d", uid);
+            return true;
+        }
+        memcpy(&eventLen, msg + offset, sizeof(eventLen));
+        offset += sizeof(eventLen);
+        if (eventLen == 0 || eventLen > len - offset) {
+            ALOGE("Dropping malformed group datagram from uid %d", uid);
+            return true;
+        }
+        group.push_back(createLogEvent(msg + offset, eventLen, uid, pid, filter));
+        offset += eventLen;
+    }
+    if (!group.empty()) {
+        pushToQueue(group, queue, /*asGroup=*/true);
+    }
+    return true;
+}
+
+void StatsSocketListener::pushToQueue(std::vector<std::unique_ptr<LogEvent>>& events,
+                                      const std::shared_ptr<LogEventQueue>& queue, bool asGroup) {
+    struct EventInfo {
+        int32_t atomId;
+        bool isAtomSkipped;
+        int64_t atomTimestamp;
+    };
+
+    // The accounting info must be captured before the events are moved into
+    // the queue: once pushed, the consumer thread owns them.
+    std::vector<EventInfo> infos;
+    infos.reserve(events.size());
+    for (const auto& event : events) {
+        infos.push_back({event->GetTagId(), event->isParsedHeaderOnly(),
+                         event->GetElapsedTimestampNs()});
+    }
+
+    const std::vector<LogEventQueue::Result> results =
+            asGroup ? queue->pushGroup(events) : queue->pushBatch(events);
+    // One clock read covers the whole batch; the socket-to-queue latency of
+    // each event is measured against the event's own elapsed timestamp.
+    const int64_t nowNs = getElapsedRealtimeNs();
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& [success, oldestTimestamp, queueSize, highPriority] = results[i];
+        if (success) {
+            StatsdStats::getInstance().noteEventQueueSize(queueSize, infos[i].atomTimestamp);
+            StatsdStats::getInstance().noteSocketToQueueLatency(nowNs - infos[i].atomTimestamp);
+        } else {
+            StatsdStats::getInstance().noteEventQueueOverflow(oldestTimestamp, infos[i].atomId,
+                                                              infos[i].isAtomSkipped, highPriority);
+        }
+    }
+}
+
+void StatsSocketListener::processMessage(const uint8_t* msg, uint32_t len, uint32_t uid,
+                                         uint32_t pid, const std::shared_ptr<LogEventQueue>& queue,
+                                         const std::shared_ptr<LogEventFilter>& filter) {
+    if (processGroupMessage(msg, len, uid, pid, queue, filter)) {
+        return;
+    }
+
+    std::unique_ptr<LogEvent> logEvent = createLogEvent(msg, len, uid, pid, filter);
+
+    const int32_t atomId = logEvent->GetTagId();
+    const bool isAtomSkipped = logEvent->isParsedHeaderOnly();
+    const int64_t atomTimestamp = logEvent->GetElapsedTimestampNs();
+
+    const auto [success, oldestTimestamp, queueSize, highPriority] =
+            queue->push(std::move(logEvent));
     if (success) {
         StatsdStats::getInstance().noteEventQueueSize(queueSize, atomTimestamp);
+        StatsdStats::getInstance().noteSocketToQueueLatency(getElapsedRealtimeNs() - atomTimestamp);
     } else {
-        StatsdStats::getInstance().noteEventQueueOverflow(oldestTimestamp, atomId, isAtomSkipped);
+        StatsdStats::getInstance().noteEventQueueOverflow(oldestTimestamp, atomId, isAtomSkipped,
+                                                          highPriority);
     }
 }
 
@@ -47,8 +47,96 @@ protected:
     bool onDataAvailable(SocketClient* cli) override;
 
 private:
+    // Maximum number of datagrams drained from the socket per recvmmsg() call.
+    // Sized to amortize syscall overhead over logging bursts while keeping the
+    // per-listener receive buffer footprint modest (~128KiB).
+    static constexpr uint32_t kMaxBatchSize = 32;
+
+    // Per-uid ingestion throttle. App uids refill at kThrottleTokensPerSec
+    // with a burst allowance of kThrottleBurstTokens; the rates are generous
+    // multiples of any legitimate per-app logging volume and only engage for
+    // runaway clients. Uids below kFirstApplicationUid (platform services) are
+    // never throttled.
+    static constexpr uint32_t kThrottleSlots = 64;
+    static constexpr int64_t kThrottleTokensPerSec = 2000;
+    static constexpr int64_t kThrottleBurstTokens = 4000;
+    static constexpr uint32_t kFirstApplicationUid = 10000;  // AID_APP_START
+
+    struct UidTokenBucket {
+        uint32_t uid = 0;
+        int64_t tokens = 0;
+        int64_t lastRefillNs = 0;
+    };
+
     static int getLogSocket();
 
+    /**
+     * @brief Charges one datagram from uid against its token bucket.
+     * Only called from the single SocketListener thread.
+     *
+     * @param uid sender uid from the datagram's socket credentials
+     * @param nowNs current elapsed-realtime timestamp for token refill
+     * @return true if the datagram should be dropped
+     */
+    bool isUidThrottled(uint32_t uid, int64_t nowNs);
+
+    /**
+     * @brief Peeks the atom id at its fixed offset in the serialized event
+     * header without constructing a LogEvent, mirroring the prefix layout
+     * parsed by LogEvent::parseHeader. Used to reject filtered-out atoms
+     * before credential processing.
+     *
+     * @param msg buffer that begins at the start of the serialized atom
+     * @param len size of buffer in bytes
+     * @param elapsedTimestampNs output for the peeked event timestamp
+     * @return the atom id, or 0 when the prefix does not match the layout
+     */
+    static int32_t peekAtomId(const uint8_t* msg, uint32_t len, int64_t* elapsedTimestampNs);
+
+    /**
+     * @brief Parses the buffer into a LogEvent, evaluating it against the filter and
+     * performing socket loss accounting on the way
+     *
+     * @param msg buffer to parse
+     * @param len size of buffer in bytes
+     * @param uid arguments for LogEvent constructor
+     * @param pid arguments for LogEvent constructor
+     * @param filter to be used for event evaluation
+     */
+    static std::unique_ptr<LogEvent> createLogEvent(const uint8_t* msg, uint32_t len, uint32_t uid,
+                                                    uint32_t pid,
+                                                    const std::shared_ptr<LogEventFilter>& filter);
+
+    /**
+     * @brief Submits a batch of parsed LogEvents to the queue under a single lock
+     * acquisition and performs the per-event queue accounting
+     *
+     * @param events batch of events, consumed by the call
+     * @param queue queue to submit the events
+     * @param asGroup submit the events as one all-or-nothing transaction
+     *        instead of independently
+     */
+    static void pushToQueue(std::vector<std::unique_ptr<LogEvent>>& events,
+                            const std::shared_ptr<LogEventQueue>& queue, bool asGroup = false);
+
+    /**
+     * @brief Parses a transactional group datagram (several serialized events
+     * framed into one payload by AStatsEvent_writeGroup) and submits the whole
+     * group to the queue as one all-or-nothing transaction. A malformed frame
+     * drops the entire group to preserve that contract.
+     *
+     * @param msg buffer beginning at the group frame root byte
+     * @param len size of buffer in bytes
+     * @param uid arguments for LogEvent constructor
+     * @param pid arguments for LogEvent constructor
+     * @param queue queue to submit the events
+     * @param filter to be used for event evaluation
+     * @return true when the buffer carried a group frame (queued or dropped)
+     */
+    static bool processGroupMessage(const uint8_t* msg, uint32_t len, uint32_t uid, uint32_t pid,
+                                    const std::shared_ptr<LogEventQueue>& queue,
+                                    const std::shared_ptr<LogEventFilter>& filter);
+
     /**
      * @brief Helper API to parse buffer, make the LogEvent & submit it into the queue
      * Created as a separate API to be easily tested without StatsSocketListener instance
@@ -71,16 +159,26 @@ private:
 
     std::shared_ptr<LogEventFilter> mLogEventFilter;
 
+    // Fixed-size direct-mapped table covering the working set of actively
+    // logging uids. On an index collision the slot is handed to the new uid
+    // with a fresh burst allowance; occasional over-admission on collisions is
+    // acceptable, a table scan per datagram is not.
+    UidTokenBucket mUidBuckets[kThrottleSlots];
+
     friend class SocketParseMessageTest;
     friend void generateAtomLogging(const std::shared_ptr<LogEventQueue>& queue,
                                     const std::shared_ptr<LogEventFilter>& filter, int eventCount,
                                     int startAtomId);
+    friend void replayTraceThroughSocketParse(const std::shared_ptr<LogEventQueue>& queue,
+                                              const std::shared_ptr<LogEventFilter>& filter,
+                                              const std::vector<std::vector<uint8_t>>& trace);
 
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessage);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageEmptySetExplicitSet);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterCompleteSet);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterPartialSet);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterToggle);
+    FRIEND_TEST(SocketListenerTest, TestUidThrottleTokenBucket);
     FRIEND_TEST(LogEventQueue_test, TestQueueMaxSize);
 };
 
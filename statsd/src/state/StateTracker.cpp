@@ -31,6 +31,15 @@ StateTracker::StateTracker(int32_t atomId) : mField(atomId, 0) {
 void StateTracker::onLogEvent(const LogEvent& event) {
     const int64_t eventTimeNs = event.GetElapsedTimestampNs();
 
+    // Promote the listeners once for this event; every notification it produces (a reset
+    // touches all tracked keys) reuses the promoted pointers.
+    for (const auto& l : mListeners) {
+        sp<StateListener> sl = l.promote();
+        if (sl != nullptr) {
+            mPromotedListeners.push_back(sl);
+        }
+    }
+
     // Parse event for primary field values i.e. primary key.
     HashableDimensionKey primaryKey;
     filterPrimaryKey(event.getValues(), &primaryKey);
@@ -39,6 +48,7 @@ void StateTracker::onLogEvent(const LogEvent& event) {
     if (!getStateFieldValueFromLogEvent(event, &newState)) {
         ALOGE("StateTracker error extracting state from log event. Missing exclusive state field.");
         clearStateForPrimaryKey(eventTimeNs, primaryKey);
+        mPromotedListeners.clear();
         return;
     }
 
@@ -48,6 +58,7 @@ void StateTracker::onLogEvent(const LogEvent& event) {
         ALOGE("StateTracker error extracting state from log event. Type: %d",
               newState.mValue.getType());
         clearStateForPrimaryKey(eventTimeNs, primaryKey);
+        mPromotedListeners.clear();
         return;
     }
 
@@ -55,11 +66,23 @@ void StateTracker::onLogEvent(const LogEvent& event) {
         VLOG("StateTracker new reset state: %d", resetState);
         const FieldValue resetStateFieldValue(mField, Value(resetState));
         handleReset(eventTimeNs, resetStateFieldValue);
+        mPromotedListeners.clear();
         return;
     }
 
     const bool nested = newState.mAnnotations.isNested();
-    updateStateForPrimaryKey(eventTimeNs, primaryKey, newState, nested, mStateMap[primaryKey]);
+    if (isSingleIntKey(primaryKey)) {
+        mIntPrimaryField = primaryKey.getValues()[0].mField;
+        const int32_t intKey = primaryKey.getValues()[0].mValue.int_value;
+        if (updateStateForPrimaryKey(eventTimeNs, primaryKey, newState, nested,
+                                     mIntStateMap[intKey])) {
+            mIntStateMap.erase(mIntStateMap.find(intKey));
+        }
+    } else if (updateStateForPrimaryKey(eventTimeNs, primaryKey, newState, nested,
+                                        mStateMap[primaryKey])) {
+        mStateMap.erase(primaryKey);
+    }
+    mPromotedListeners.clear();
 }
 
 void StateTracker::registerListener(const wp<StateListener>& listener) {
@@ -70,10 +93,27 @@ void StateTracker::unregisterListener(const wp<StateListener>& listener) {
     mListeners.erase(listener);
 }
 
+bool StateTracker::isSingleIntKey(const HashableDimensionKey& primaryKey) {
+    const std::vector<FieldValue>& values = primaryKey.getValues();
+    return values.size() == 1 && values[0].mValue.getType() == INT;
+}
+
+HashableDimensionKey StateTracker::intPrimaryKey(int32_t intKey) const {
+    HashableDimensionKey primaryKey;
+    primaryKey.addValue(FieldValue(mIntPrimaryField, Value(intKey)));
+    return primaryKey;
+}
+
 bool StateTracker::getStateValue(const HashableDimensionKey& queryKey, FieldValue* output) const {
     output->mField = mField;
 
-    if (const auto it = mStateMap.find(queryKey); it != mStateMap.end()) {
+    if (isSingleIntKey(queryKey)) {
+        if (const auto it = mIntStateMap.find(queryKey.getValues()[0].mValue.int_value);
+            it != mIntStateMap.end()) {
+            output->mValue = it->second.state;
+            return true;
+        }
+    } else if (const auto it = mStateMap.find(queryKey); it != mStateMap.end()) {
         output->mValue = it->second.state;
         return true;
     }
@@ -91,25 +131,38 @@ void StateTracker::handleReset(const int64_t eventTimeNs, const FieldValue& newS
                                  false /* nested; treat this state change as not nested */,
                                  stateValueInfo);
     }
+    for (auto& [intKey, stateValueInfo] : mIntStateMap) {
+        updateStateForPrimaryKey(eventTimeNs, intPrimaryKey(intKey), newState,
+                                 false /* nested; treat this state change as not nested */,
+                                 stateValueInfo);
+    }
 }
 
 void StateTracker::clearStateForPrimaryKey(const int64_t eventTimeNs,
                                            const HashableDimensionKey& primaryKey) {
     VLOG("StateTracker clear state for primary key");
-    const std::unordered_map<HashableDimensionKey, StateValueInfo>::iterator it =
-            mStateMap.find(primaryKey);
 
-    // If there is no entry for the primaryKey in mStateMap, then the state is already
-    // kStateUnknown.
+    // If there is no entry for the primaryKey, then the state is already kStateUnknown.
     const FieldValue state(mField, Value(kStateUnknown));
-    if (it != mStateMap.end()) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, state,
-                                 false /* nested; treat this state change as not nested */,
-                                 it->second);
+    if (isSingleIntKey(primaryKey)) {
+        const int32_t intKey = primaryKey.getValues()[0].mValue.int_value;
+        if (const auto it = mIntStateMap.find(intKey); it != mIntStateMap.end()) {
+            if (updateStateForPrimaryKey(eventTimeNs, primaryKey, state,
+                                         false /* nested; treat this state change as not nested */,
+                                         it->second)) {
+                mIntStateMap.erase(it);
+            }
+        }
+    } else if (const auto it = mStateMap.find(primaryKey); it != mStateMap.end()) {
+        if (updateStateForPrimaryKey(eventTimeNs, primaryKey, state,
+                                     false /* nested; treat this state change as not nested */,
+                                     it->second)) {
+            mStateMap.erase(it);
+        }
     }
 }
 
-void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
+bool StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
                                             const HashableDimensionKey& primaryKey,
                                             const FieldValue& newState, const bool nested,
                                             StateValueInfo& stateValueInfo) {
@@ -154,22 +207,16 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
         notifyListeners(eventTimeNs, primaryKey, oldState, newState);
     }
 
-    // Clear primary key entry from state map if state is now unknown.
-    // stateValueInfo points to a value in mStateMap and should not be accessed after erasing the
-    // entry
-    if (newStateValue == kStateUnknown) {
-        mStateMap.erase(primaryKey);
-    }
+    // The caller erases the entry from its map when the state is now unknown;
+    // stateValueInfo must not be accessed after that.
+    return newStateValue == kStateUnknown;
 }
 
 void StateTracker::notifyListeners(const int64_t eventTimeNs,
                                    const HashableDimensionKey& primaryKey,
                                    const FieldValue& oldState, const FieldValue& newState) {
-    for (const auto& l : mListeners) {
-        auto sl = l.promote();
-        if (sl != nullptr) {
-            sl->onStateChanged(eventTimeNs, mField.getTag(), primaryKey, oldState, newState);
-        }
+    for (const sp<StateListener>& listener : mPromotedListeners) {
+        listener->onStateChanged(eventTimeNs, mField.getTag(), primaryKey, oldState, newState);
     }
 }
 
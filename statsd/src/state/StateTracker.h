@@ -20,8 +20,10 @@
 #include "logd/LogEvent.h"
 
 #include "state/StateListener.h"
+#include "utils/FlatHashMap.h"
 
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 namespace os {
@@ -65,20 +67,43 @@ private:
 
     Field mField;
 
-    // Maps primary key to state value info
+    // Maps primary key to state value info. Only used for atoms whose primary key is not a
+    // single int; the high-rate single-int-key atoms (uid keyed) go through mIntStateMap.
     std::unordered_map<HashableDimensionKey, StateValueInfo> mStateMap;
 
+    // Fast path for atoms whose primary key is exactly one int field (e.g. uid): keyed by
+    // the raw int, which skips the dimension key construction and FieldValue hashing that
+    // the generic map pays per event. A given atom's primary key layout is fixed, so each
+    // tracker consistently uses one of the two maps.
+    FlatHashMap<int32_t, StateValueInfo> mIntStateMap;
+
+    // Field of the single-int primary key; recorded from the first event taking the fast
+    // path so full keys can be rebuilt for listener notifications and queries.
+    Field mIntPrimaryField;
+
     // Set of all StateListeners (objects listening for state changes)
     std::set<wp<StateListener>> mListeners;
 
+    // Listeners promoted once per incoming event and reused for every notification that
+    // event produces (a reset fans out across all tracked keys), then released. Member
+    // only to retain its capacity between events.
+    std::vector<sp<StateListener>> mPromotedListeners;
+
+    // True if the primary key is exactly one int value.
+    static bool isSingleIntKey(const HashableDimensionKey& primaryKey);
+
+    // Rebuilds the full primary key for an mIntStateMap entry.
+    HashableDimensionKey intPrimaryKey(int32_t intKey) const;
+
     // Reset all state values in map to the given state.
     void handleReset(const int64_t eventTimeNs, const FieldValue& newState);
 
     // Clears the state value mapped to the given primary key by setting it to kStateUnknown.
     void clearStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey);
 
-    // Update the StateMap based on the received state value.
-    void updateStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
+    // Update the state value info based on the received state value. Returns true if the
+    // entry's state is now unknown and the caller should erase it from its map.
+    bool updateStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
                                   const FieldValue& newState, const bool nested,
                                   StateValueInfo& stateValueInfo);
 
@@ -23,6 +23,7 @@
 #include <utils/SystemClock.h>
 
 #include "statscompanion_util.h"
+#include "utils/AtomSerializationPlan.h"
 
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
@@ -336,6 +337,58 @@ void writeDimensionPathToProto(const std::vector<Matcher>& fieldMatchers,
 // }
 //
 //
+// Writes the atom in one simple pass when every field is a top-level primitive, which
+// covers most atoms. Flat atoms need neither the serialization-plan cache (and its
+// global lock) nor the recursive tree walk below. Returns false without writing
+// anything if a nested, repeated or unsupported field is found.
+static bool writeFlatAtomToStream(int tagId, const std::vector<FieldValue>& values,
+                                  ProtoOutputStream* protoOutput) {
+    for (const FieldValue& value : values) {
+        if (value.mField.getDepth() != 0) {
+            return false;
+        }
+        switch (value.mValue.getType()) {
+            case INT:
+            case LONG:
+            case FLOAT:
+            case STRING:
+            case STORAGE:
+                break;
+            default:
+                return false;
+        }
+    }
+
+    uint64_t atomToken = protoOutput->start(FIELD_TYPE_MESSAGE | tagId);
+    for (const FieldValue& value : values) {
+        const int fieldNum = value.mField.getPosAtDepth(0);
+        switch (value.mValue.getType()) {
+            case INT:
+                protoOutput->write(FIELD_TYPE_INT32 | fieldNum, value.mValue.int_value);
+                break;
+            case LONG:
+                protoOutput->write(FIELD_TYPE_INT64 | fieldNum,
+                                   (long long)value.mValue.long_value);
+                break;
+            case FLOAT:
+                protoOutput->write(FIELD_TYPE_FLOAT | fieldNum, value.mValue.float_value);
+                break;
+            case STRING:
+                protoOutput->write(FIELD_TYPE_STRING | fieldNum, value.mValue.str_value);
+                break;
+            case STORAGE:
+                protoOutput->write(FIELD_TYPE_MESSAGE | fieldNum,
+                                   (const char*)value.mValue.storage_value.data(),
+                                   value.mValue.storage_value.size());
+                break;
+            default:
+                break;
+        }
+    }
+    protoOutput->end(atomToken);
+    return true;
+}
+
 void writeFieldValueTreeToStreamHelper(int tagId, const std::vector<FieldValue>& dims,
                                        size_t* index, int depth, int prefix,
                                        ProtoOutputStream* protoOutput) {
@@ -401,6 +454,18 @@ void writeFieldValueTreeToStreamHelper(int tagId, const std::vector<FieldValue>&
 
 void writeFieldValueTreeToStream(int tagId, const std::vector<FieldValue>& values,
                                  util::ProtoOutputStream* protoOutput) {
+    // Flat atoms (only depth-0 primitives) take the lock-free single-loop path.
+    if (writeFlatAtomToStream(tagId, values, protoOutput)) {
+        return;
+    }
+
+    // Nested and repeated atoms are mostly covered by a precompiled serialization plan
+    // that encodes the wire bytes directly; the token-based tree walk below is the
+    // fallback.
+    if (writeAtomWithSerializationPlan(tagId, values, protoOutput)) {
+        return;
+    }
+
     uint64_t atomToken = protoOutput->start(FIELD_TYPE_MESSAGE | tagId);
 
     size_t index = 0;
@@ -570,6 +635,12 @@ int64_t getSystemUptimeMillis() {
     return ::android::uptimeMillis();
 }
 
+int64_t getThreadCpuTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
 int64_t getWallClockNs() {
     struct timespec ts;
     clock_gettime(CLOCK_REALTIME, &ts);
@@ -65,6 +65,9 @@ int64_t getElapsedRealtimeSec();
 // Gets the system uptime in millis.
 int64_t getSystemUptimeMillis();
 
+// Gets the calling thread's consumed CPU time in ns.
+int64_t getThreadCpuTimeNs();
+
 // Gets the wall clock timestamp in ns.
 int64_t getWallClockNs();
 
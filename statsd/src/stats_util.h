@@ -21,6 +21,7 @@
 #include <unordered_map>
 
 #include "HashableDimensionKey.h"
+#include "utils/FlatHashMap.h"
 
 namespace android {
 namespace os {
@@ -41,7 +42,10 @@ const MetricDimensionKey DEFAULT_METRIC_DIMENSION_KEY = MetricDimensionKey();
 
 typedef std::map<int64_t, HashableDimensionKey> ConditionKey;
 
-typedef std::unordered_map<MetricDimensionKey, int64_t> DimToValMap;
+// Flat open-addressing storage: the sliced counters backed by this map are hit on every
+// matched event, and the MetricDimensionKey hashes are memoized, so a lookup never
+// allocates or rehashes FieldValues.
+typedef FlatHashMap<MetricDimensionKey, int64_t> DimToValMap;
 
 using ConditionLinks = google::protobuf::RepeatedPtrField<MetricConditionLink>;
 
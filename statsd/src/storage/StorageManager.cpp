@@ -21,8 +21,13 @@
 
 #include <android-base/file.h>
 #include <private/android_filesystem_config.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 
 #include "android-base/stringprintf.h"
@@ -48,6 +53,65 @@ using std::map;
 // for ConfigMetricsReportList
 const int FIELD_ID_REPORTS = 2;
 
+// Compression level for report files. Report protos compress several times over
+// already at zlib's default trade-off, so the same disk guardrail retains
+// correspondingly more history and flash writes shrink to match.
+const int kReportCompressionLevel = Z_DEFAULT_COMPRESSION;
+
+// windowBits of 15 plus 16 selects the gzip wrapper, whose two magic bytes let
+// readers tell compressed files from raw protos written by older builds (0x1f is
+// not a valid leading proto tag for a report).
+const int kGzipWindowBits = 15 + 16;
+
+static bool isGzipped(const char* data, size_t size) {
+    return size >= 2 && static_cast<uint8_t>(data[0]) == 0x1f &&
+           static_cast<uint8_t>(data[1]) == 0x8b;
+}
+
+static bool gzipCompress(const void* buffer, int numBytes, string* out) {
+    z_stream strm = {};
+    if (deflateInit2(&strm, kReportCompressionLevel, Z_DEFLATED, kGzipWindowBits,
+                     8 /* memLevel */, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out->resize(deflateBound(&strm, numBytes));
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<void*>(buffer));
+    strm.avail_in = numBytes;
+    strm.next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+    strm.avail_out = out->size();
+    const int ret = deflate(&strm, Z_FINISH);
+    if (ret != Z_STREAM_END) {
+        deflateEnd(&strm);
+        return false;
+    }
+    out->resize(strm.total_out);
+    deflateEnd(&strm);
+    return true;
+}
+
+static bool gzipDecompress(const char* data, size_t size, string* out) {
+    z_stream strm = {};
+    if (inflateInit2(&strm, kGzipWindowBits) != Z_OK) {
+        return false;
+    }
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    strm.avail_in = size;
+    char chunk[32 * 1024];
+    int ret = Z_OK;
+    while (ret != Z_STREAM_END) {
+        strm.next_out = reinterpret_cast<Bytef*>(chunk);
+        strm.avail_out = sizeof(chunk);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            inflateEnd(&strm);
+            return false;
+        }
+        out->append(chunk, sizeof(chunk) - strm.avail_out);
+    }
+    inflateEnd(&strm);
+    return true;
+}
+
 std::mutex StorageManager::sTrainInfoMutex;
 
 using android::base::StringPrintf;
@@ -132,19 +196,294 @@ static ConfigKey parseDbName(char* name) {
     return ConfigKey(StrToInt64(uid), StrToInt64(configId));
 }
 
-void StorageManager::writeFile(const char* file, const void* buffer, int numBytes) {
-    int fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+// In-memory index of one stats directory: parsed file names and sizes, maintained on
+// StorageManager's own writes and deletions so report retrieval and trimming do not
+// opendir/readdir and re-parse every file name on every dump and disk write. The
+// index is validated against the directory's mtime, so a change made behind
+// StorageManager's back forces a rebuild on the next query.
+class DirectoryIndex {
+public:
+    explicit DirectoryIndex(const char* path) : mPath(path) {
+    }
+
+    struct Entry {
+        FileName mParsed;
+        int mFileSizeBytes;
+    };
+
+    using EntryMap = std::map<string, Entry>;
+
+    // Copies the current entries (file name to entry) into out, rebuilding the index
+    // from a directory scan first when it is stale. Returns false if the directory
+    // cannot be read. Files whose names do not parse are not indexed, matching the
+    // scans this replaces, which all skipped them.
+    bool getEntries(EntryMap* out) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!validateLocked()) {
+            return false;
+        }
+        *out = mEntries;
+        return true;
+    }
+
+    void onFileWritten(const string& name, int fileSizeBytes) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mValid) return;
+        FileName parsed;
+        parseFileNameCopy(name, &parsed);
+        if (parsed.mTimestampSec != -1) {
+            auto it = mEntries.find(name);
+            if (it != mEntries.end()) {
+                mTotalBytes -= it->second.mFileSizeBytes;
+            }
+            mEntries[name] = {parsed, fileSizeBytes};
+            mTotalBytes += fileSizeBytes;
+            mOldestTimestampSec = std::min<int64_t>(mOldestTimestampSec, parsed.mTimestampSec);
+            if (parsed.mIsHistory) {
+                mOldestHistoryTimestampSec =
+                        std::min<int64_t>(mOldestHistoryTimestampSec, parsed.mTimestampSec);
+            }
+        }
+        refreshDirMtimeLocked();
+    }
+
+    void onFileRemoved(const string& name) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mValid) return;
+        if (mEntries.erase(name) > 0) {
+            recomputeAggregatesLocked();
+        }
+        refreshDirMtimeLocked();
+    }
+
+    void onFileRenamed(const string& from, const string& to) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mValid) return;
+        auto it = mEntries.find(from);
+        if (it != mEntries.end()) {
+            Entry entry = it->second;
+            mEntries.erase(it);
+            parseFileNameCopy(to, &entry.mParsed);
+            if (entry.mParsed.mTimestampSec != -1) {
+                mEntries[to] = entry;
+            }
+            recomputeAggregatesLocked();
+        }
+        refreshDirMtimeLocked();
+    }
+
+    // Constant-time guardrail check against the running aggregates. Returns true
+    // when the directory may exceed a count, size or age limit and a full trim
+    // pass is warranted; returns false only when trimming certainly has nothing
+    // to delete. Costs one stat of the directory (the staleness check), never a
+    // per-file walk.
+    bool needsTrim(int64_t nowSec, size_t maxFiles, int64_t maxBytes, int64_t maxAgeSec,
+                   int64_t maxHistoryAgeSec) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!validateLocked()) {
+            return true;
+        }
+        if (mEntries.size() > maxFiles || mTotalBytes > maxBytes) {
+            return true;
+        }
+        if (mOldestTimestampSec != INT64_MAX && nowSec - mOldestTimestampSec > maxAgeSec) {
+            return true;
+        }
+        if (mOldestHistoryTimestampSec != INT64_MAX &&
+            nowSec - mOldestHistoryTimestampSec > maxHistoryAgeSec) {
+            return true;
+        }
+        mFastTrimSkips++;
+        return false;
+    }
+
+    void printStats(int outFd) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        dprintf(outFd, "\tDirectory index: %lld hits, %lld rebuilds, %lld trim fast-path skips\n",
+                (long long)mHits, (long long)mRebuilds, (long long)mFastTrimSkips);
+    }
+
+private:
+    // parseFileName tokenizes in place, so parse a copy.
+    static void parseFileNameCopy(const string& name, FileName* out) {
+        string copy(name);
+        parseFileName(copy.data(), out);
+    }
+
+    // Re-reads the directory mtime after one of our own changes, so the next query
+    // does not mistake it for an external modification. An external change racing
+    // this refresh goes unnoticed until the next one; that at worst makes a read
+    // fail softly on a missing file, and only statsd writes these SELinux-protected
+    // directories.
+    void refreshDirMtimeLocked() {
+        struct stat st;
+        if (stat(mPath, &st) == 0) {
+            mDirMtime = st.st_mtim;
+        } else {
+            mValid = false;
+        }
+    }
+
+    bool validateLocked() {
+        struct stat st;
+        if (stat(mPath, &st) != 0) {
+            mValid = false;
+            return false;
+        }
+        if (mValid && st.st_mtim.tv_sec == mDirMtime.tv_sec &&
+            st.st_mtim.tv_nsec == mDirMtime.tv_nsec) {
+            mHits++;
+            return true;
+        }
+        unique_ptr<DIR, decltype(&closedir)> dir(opendir(mPath), closedir);
+        if (dir == NULL) {
+            mValid = false;
+            return false;
+        }
+        mEntries.clear();
+        dirent* de;
+        while ((de = readdir(dir.get()))) {
+            char* name = de->d_name;
+            if (name[0] == '.' || de->d_type == DT_DIR) continue;
+            const string fileName(name);
+            FileName parsed;
+            parseFileName(name, &parsed);
+            if (parsed.mTimestampSec == -1) continue;
+            int fileSize = 0;
+            struct stat fileStat;
+            if (stat(parsed.getFullFileName(mPath).c_str(), &fileStat) == 0) {
+                fileSize = fileStat.st_size;
+            }
+            mEntries[fileName] = {parsed, fileSize};
+        }
+        mDirMtime = st.st_mtim;
+        mValid = true;
+        mRebuilds++;
+        recomputeAggregatesLocked();
+        return true;
+    }
+
+    // Rebuilds the running totals from the entries. Called after a full rescan
+    // and after removals and renames, which may have displaced the oldest entry;
+    // the entry count is bounded by the file-number guardrail, so this stays
+    // cheap and the aggregates stay exact.
+    void recomputeAggregatesLocked() {
+        mTotalBytes = 0;
+        mOldestTimestampSec = INT64_MAX;
+        mOldestHistoryTimestampSec = INT64_MAX;
+        for (const auto& [name, entry] : mEntries) {
+            mTotalBytes += entry.mFileSizeBytes;
+            mOldestTimestampSec =
+                    std::min<int64_t>(mOldestTimestampSec, entry.mParsed.mTimestampSec);
+            if (entry.mParsed.mIsHistory) {
+                mOldestHistoryTimestampSec =
+                        std::min<int64_t>(mOldestHistoryTimestampSec, entry.mParsed.mTimestampSec);
+            }
+        }
+    }
+
+    const char* const mPath;
+    std::mutex mMutex;
+    bool mValid = false;
+    struct timespec mDirMtime = {};
+    EntryMap mEntries;
+    // Running totals over mEntries so the trim guardrail check is O(1).
+    int64_t mTotalBytes = 0;
+    int64_t mOldestTimestampSec = INT64_MAX;
+    int64_t mOldestHistoryTimestampSec = INT64_MAX;
+    int64_t mHits = 0;
+    int64_t mRebuilds = 0;
+    int64_t mFastTrimSkips = 0;
+};
+
+static DirectoryIndex sDataDirIndex(STATS_DATA_DIR);
+static DirectoryIndex sServiceDirIndex(STATS_SERVICE_DIR);
+
+static DirectoryIndex* indexForDir(const char* path) {
+    if (strcmp(path, STATS_DATA_DIR) == 0) return &sDataDirIndex;
+    if (strcmp(path, STATS_SERVICE_DIR) == 0) return &sServiceDirIndex;
+    return nullptr;
+}
+
+// Maps a full file path to its directory index and file name, for the write and
+// delete funnels that only see the full path. Returns nullptr for unindexed
+// directories (train info and the like).
+static DirectoryIndex* indexForFullPath(const char* file, string* outName) {
+    for (const char* dir : {STATS_DATA_DIR, STATS_SERVICE_DIR}) {
+        const size_t dirLen = strlen(dir);
+        if (strncmp(file, dir, dirLen) == 0 && file[dirLen] == '/' &&
+            strchr(file + dirLen + 1, '/') == nullptr) {
+            *outName = file + dirLen + 1;
+            return indexForDir(dir);
+        }
+    }
+    return nullptr;
+}
+
+// Builds the dot-prefixed temp sibling for a file, e.g. dir/.name.tmp. Every
+// directory scan skips dot files, so in-flight (and crash-orphaned) temp files
+// are never mistaken for complete reports.
+static string tempFileNameFor(const char* file) {
+    const char* slash = strrchr(file, '/');
+    if (slash == nullptr) {
+        return StringPrintf(".%s.tmp", file);
+    }
+    return StringPrintf("%.*s.%s.tmp", (int)(slash - file + 1), file, slash + 1);
+}
+
+void StorageManager::writeFile(const char* file, const void* buffer, int numBytes,
+                               WriteDurability durability) {
+    // Commit the file atomically: write a temp sibling, make it durable, then
+    // rename it into place. A crash mid-write leaves at most an ignored temp
+    // file behind, never a truncated report under the real name.
+    const string tempName = tempFileNameFor(file);
+    int fd = open(tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
     if (fd == -1) {
-        VLOG("Attempt to access %s but failed", file);
+        VLOG("Attempt to access %s but failed", tempName.c_str());
         return;
     }
     trimToFit(STATS_SERVICE_DIR);
     trimToFit(STATS_DATA_DIR);
 
+    bool success = android::base::WriteFully(fd, buffer, numBytes);
+    if (success && durability == WriteDurability::CRITICAL && fdatasync(fd) != 0) {
+        // The data is still queued for write-back; only the durability-before-
+        // rename guarantee is weakened, so keep the report rather than drop it.
+        VLOG("Failed to sync %s", tempName.c_str());
+    }
+
+    int result = fchown(fd, AID_STATSD, AID_STATSD);
+    if (result) {
+        VLOG("Failed to chown %s to statsd", tempName.c_str());
+    }
+
+    close(fd);
+
+    if (!success || rename(tempName.c_str(), file) != 0) {
+        ALOGE("Failed to write %s", file);
+        unlink(tempName.c_str());
+        return;
+    }
+
+    VLOG("Successfully wrote %s", file);
+    string indexedName;
+    DirectoryIndex* index = indexForFullPath(file, &indexedName);
+    if (index != nullptr) {
+        index->onFileWritten(indexedName, numBytes);
+    }
+}
+
+void StorageManager::appendFile(const char* file, const void* buffer, int numBytes) {
+    int fd = open(file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        VLOG("Attempt to access %s but failed", file);
+        return;
+    }
+
     if (android::base::WriteFully(fd, buffer, numBytes)) {
-        VLOG("Successfully wrote %s", file);
+        VLOG("Successfully appended to %s", file);
     } else {
-        ALOGE("Failed to write %s", file);
+        ALOGE("Failed to append to %s", file);
     }
 
     int result = fchown(fd, AID_STATSD, AID_STATSD);
@@ -155,6 +494,31 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
     close(fd);
 }
 
+void StorageManager::writeCompressedFile(const char* file, const void* buffer, int numBytes,
+                                         WriteDurability durability) {
+    string compressed;
+    if (gzipCompress(buffer, numBytes, &compressed) &&
+        compressed.size() < static_cast<size_t>(numBytes)) {
+        writeFile(file, compressed.data(), compressed.size(), durability);
+    } else {
+        // Compression failed or did not help; the raw file stays readable since
+        // readers sniff the gzip magic.
+        writeFile(file, buffer, numBytes, durability);
+    }
+}
+
+void StorageManager::syncDataDirectory() {
+    int fd = open(STATS_DATA_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        VLOG("Failed to open %s for sync", STATS_DATA_DIR);
+        return;
+    }
+    if (fsync(fd) != 0) {
+        VLOG("Failed to sync %s", STATS_DATA_DIR);
+    }
+    close(fd);
+}
+
 bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     std::lock_guard<std::mutex> lock(sTrainInfoMutex);
 
@@ -464,6 +828,11 @@ void StorageManager::deleteFile(const char* file) {
     } else {
         VLOG("Successfully deleted %s", file);
     }
+    string indexedName;
+    DirectoryIndex* index = indexForFullPath(file, &indexedName);
+    if (index != nullptr) {
+        index->onFileRemoved(indexedName);
+    }
 }
 
 void StorageManager::deleteAllFiles(const char* path) {
@@ -481,6 +850,28 @@ void StorageManager::deleteAllFiles(const char* path) {
     }
 }
 
+void StorageManager::deleteOrphanedTempFiles() {
+    for (const char* path : {STATS_DATA_DIR, STATS_SERVICE_DIR}) {
+        unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
+        if (dir == NULL) {
+            VLOG("Directory does not exist: %s", path);
+            continue;
+        }
+
+        dirent* de;
+        while ((de = readdir(dir.get()))) {
+            char* name = de->d_name;
+            if (name[0] != '.' || de->d_type == DT_DIR) continue;
+            size_t nameLen = strlen(name);
+            if (nameLen > 4 && strcmp(name + nameLen - 4, ".tmp") == 0) {
+                // Left behind by a crash mid-commit; whatever is inside never
+                // made it to the real file name and may be truncated.
+                remove(StringPrintf("%s/%s", path, name).c_str());
+            }
+        }
+    }
+}
+
 void StorageManager::deleteSuffixedFiles(const char* path, const char* suffix) {
     unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
     if (dir == NULL) {
@@ -504,6 +895,19 @@ void StorageManager::deleteSuffixedFiles(const char* path, const char* suffix) {
 
 void StorageManager::sendBroadcast(const char* path,
                                    const std::function<void(const ConfigKey&)>& sendBroadcast) {
+    DirectoryIndex* index = indexForDir(path);
+    DirectoryIndex::EntryMap entries;
+    if (index != nullptr && index->getEntries(&entries)) {
+        // Only fresh (non-history) reports trigger a broadcast; history files stay
+        // untouched until an adb dump asks for them.
+        for (const auto& [fileName, entry] : entries) {
+            if (entry.mParsed.mIsHistory) continue;
+            VLOG("file %s", fileName.c_str());
+            sendBroadcast(ConfigKey((int)entry.mParsed.mUid, entry.mParsed.mConfigId));
+        }
+        return;
+    }
+
     unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
     if (dir == NULL) {
         VLOG("no stats-data directory on disk");
@@ -524,27 +928,15 @@ void StorageManager::sendBroadcast(const char* path,
 }
 
 bool StorageManager::hasConfigMetricsReport(const ConfigKey& key) {
-    unique_ptr<DIR, decltype(&closedir)> dir(opendir(STATS_DATA_DIR), closedir);
-    if (dir == NULL) {
+    DirectoryIndex::EntryMap entries;
+    if (!sDataDirIndex.getEntries(&entries)) {
         VLOG("Path %s does not exist", STATS_DATA_DIR);
         return false;
     }
 
-    string suffix = StringPrintf("%d_%lld", key.GetUid(), (long long)key.GetId());
-
-    dirent* de;
-    while ((de = readdir(dir.get()))) {
-        char* name = de->d_name;
-        if (name[0] == '.' || de->d_type == DT_DIR) continue;
-
-        size_t nameLen = strlen(name);
-        size_t suffixLen = suffix.length();
-        if (suffixLen <= nameLen &&
-            strncmp(name + nameLen - suffixLen, suffix.c_str(), suffixLen) == 0) {
-            // Check again that the file name is parseable.
-            FileName output;
-            parseFileName(name, &output);
-            if (output.mTimestampSec == -1 || output.mIsHistory) continue;
+    for (const auto& [fileName, entry] : entries) {
+        if (!entry.mParsed.mIsHistory && entry.mParsed.mUid == key.GetUid() &&
+            entry.mParsed.mConfigId == key.GetId()) {
             return true;
         }
     }
@@ -553,32 +945,48 @@ bool StorageManager::hasConfigMetricsReport(const ConfigKey& key) {
 
 void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto,
                                                bool erase_data, bool isAdb) {
-    unique_ptr<DIR, decltype(&closedir)> dir(opendir(STATS_DATA_DIR), closedir);
-    if (dir == NULL) {
+    DirectoryIndex::EntryMap entries;
+    if (!sDataDirIndex.getEntries(&entries)) {
         VLOG("Path %s does not exist", STATS_DATA_DIR);
         return;
     }
 
-    dirent* de;
-    while ((de = readdir(dir.get()))) {
-        char* name = de->d_name;
-        string fileName(name);
-        if (name[0] == '.' || de->d_type == DT_DIR) continue;
-        FileName output;
-        parseFileName(name, &output);
-
-        if (output.mTimestampSec == -1 || (output.mIsHistory && !isAdb) ||
-            output.mUid != key.GetUid() || output.mConfigId != key.GetId()) {
+    for (const auto& [fileName, entry] : entries) {
+        const FileName& output = entry.mParsed;
+        if ((output.mIsHistory && !isAdb) || output.mUid != key.GetUid() ||
+            output.mConfigId != key.GetId()) {
             continue;
         }
 
         auto fullPathName = StringPrintf("%s/%s", STATS_DATA_DIR, fileName.c_str());
         int fd = open(fullPathName.c_str(), O_RDONLY | O_CLOEXEC);
         if (fd != -1) {
-            string content;
-            if (android::base::ReadFdToString(fd, &content)) {
-                proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
-                             content.c_str(), content.size());
+            // Map the report instead of copying it into a string; raw protos are
+            // appended straight from the page cache and gzipped ones decompress
+            // from the mapping, so only the decompressed bytes are allocated.
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    const char* data = static_cast<const char*>(mapped);
+                    const size_t size = st.st_size;
+                    if (isGzipped(data, size)) {
+                        string decompressed;
+                        if (gzipDecompress(data, size, &decompressed)) {
+                            proto->write(
+                                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
+                                    decompressed.c_str(), decompressed.size());
+                        } else {
+                            ALOGE("Failed to decompress report file %s", fullPathName.c_str());
+                        }
+                    } else {
+                        proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
+                                     data, size);
+                    }
+                    munmap(mapped, st.st_size);
+                } else {
+                    ALOGE("Failed to mmap report file %s", fullPathName.c_str());
+                }
             }
             close(fd);
         } else {
@@ -587,6 +995,7 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
 
         if (erase_data) {
             remove(fullPathName.c_str());
+            sDataDirIndex.onFileRemoved(fileName);
         } else if (!output.mIsHistory && !isAdb) {
             // This means a real data owner has called to get this data. But the config says it
             // wants to keep a local history. So now this file must be renamed as a history file.
@@ -594,6 +1003,8 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
             // again. rename returns 0 on success
             if (rename(fullPathName.c_str(), (fullPathName + "_history").c_str())) {
                 ALOGE("Failed to rename file %s", fullPathName.c_str());
+            } else {
+                sDataDirIndex.onFileRenamed(fileName, fileName + "_history");
             }
         }
     }
@@ -632,20 +1043,57 @@ void StorageManager::readConfigFromDisk(map<ConfigKey, StatsdConfig>& configsMap
         string file_name = output.getFullFileName(STATS_SERVICE_DIR);
         int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
         if (fd != -1) {
-            string content;
-            if (android::base::ReadFdToString(fd, &content)) {
-                StatsdConfig config;
-                if (config.ParseFromString(content)) {
-                    configsMap[ConfigKey(output.mUid, output.mConfigId)] = config;
-                    VLOG("map key uid=%lld|configID=%lld", (long long)output.mUid,
-                         (long long)output.mConfigId);
+            StatsdConfig config;
+            bool parsed = false;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                // Map the file instead of copying it into a string; the proto
+                // parser reads straight from the page cache.
+                void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    parsed = config.ParseFromArray(mapped, st.st_size);
+                    munmap(mapped, st.st_size);
                 }
+            } else {
+                string content;
+                parsed = android::base::ReadFdToString(fd, &content) &&
+                         config.ParseFromString(content);
+            }
+            if (parsed) {
+                configsMap[ConfigKey(output.mUid, output.mConfigId)] = config;
+                VLOG("map key uid=%lld|configID=%lld", (long long)output.mUid,
+                     (long long)output.mConfigId);
             }
             close(fd);
         }
     }
 }
 
+void StorageManager::refreshConfigTimestamp(const ConfigKey& key) {
+    DirectoryIndex::EntryMap entries;
+    if (!sServiceDirIndex.getEntries(&entries)) {
+        return;
+    }
+    for (const auto& [fileName, entry] : entries) {
+        if (entry.mParsed.mUid != key.GetUid() || entry.mParsed.mConfigId != key.GetId()) {
+            continue;
+        }
+        const string newName = StringPrintf("%lld_%d_%lld", (long long)getWallClockSec(),
+                                            key.GetUid(), (long long)key.GetId());
+        if (newName == fileName) {
+            return;
+        }
+        const string oldPath = StringPrintf("%s/%s", STATS_SERVICE_DIR, fileName.c_str());
+        const string newPath = StringPrintf("%s/%s", STATS_SERVICE_DIR, newName.c_str());
+        if (rename(oldPath.c_str(), newPath.c_str()) == 0) {
+            sServiceDirIndex.onFileRenamed(fileName, newName);
+        } else {
+            ALOGE("Failed to refresh config file %s", oldPath.c_str());
+        }
+        return;
+    }
+}
+
 bool StorageManager::readConfigFromDisk(const ConfigKey& key, StatsdConfig* config) {
     string content;
     return config != nullptr &&
@@ -721,48 +1169,75 @@ void StorageManager::sortFiles(vector<FileInfo>* fileNames) {
 }
 
 void StorageManager::trimToFit(const char* path, bool parseTimestampOnly) {
-    unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
-    if (dir == NULL) {
-        VLOG("Path %s does not exist", path);
-        return;
-    }
-    dirent* de;
     int totalFileSize = 0;
     vector<FileInfo> fileNames;
     auto nowSec = getWallClockSec();
-    while ((de = readdir(dir.get()))) {
-        char* name = de->d_name;
-        if (name[0] == '.' || de->d_type == DT_DIR) continue;
+    DirectoryIndex* index = parseTimestampOnly ? nullptr : indexForDir(path);
+    if (index != nullptr &&
+        !index->needsTrim(nowSec, StatsdStats::kMaxFileNumber, StatsdStats::kMaxFileSize,
+                          StatsdStats::kMaxAgeSecond, StatsdStats::kMaxLocalHistoryAgeSecond)) {
+        // Every limit is certainly met per the running totals; skip the
+        // per-file pass entirely.
+        return;
+    }
+    DirectoryIndex::EntryMap entries;
+    if (index != nullptr && index->getEntries(&entries)) {
+        // Cached names and sizes; ages are recomputed from the parsed timestamps.
+        for (const auto& [name, entry] : entries) {
+            FileName output = entry.mParsed;
+            string file_name = output.getFullFileName(path);
+
+            long fileAge = nowSec - output.mTimestampSec;
+            if (fileAge > StatsdStats::kMaxAgeSecond ||
+                (output.mIsHistory && fileAge > StatsdStats::kMaxLocalHistoryAgeSecond)) {
+                deleteFile(file_name.c_str());
+                continue;
+            }
 
-        FileName output;
-        string file_name;
-        if (parseTimestampOnly) {
-            file_name = StringPrintf("%s/%s", path, name);
-            output.mTimestampSec = StrToInt64(strtok(name, "_"));
-            output.mIsHistory = false;
-        } else {
-            parseFileName(name, &output);
-            file_name = output.getFullFileName(path);
+            totalFileSize += entry.mFileSizeBytes;
+            fileNames.emplace_back(file_name, output.mIsHistory, entry.mFileSizeBytes, fileAge);
         }
-        if (output.mTimestampSec == -1) continue;
-
-        // Check for timestamp and delete if it's too old.
-        long fileAge = nowSec - output.mTimestampSec;
-        if (fileAge > StatsdStats::kMaxAgeSecond ||
-            (output.mIsHistory && fileAge > StatsdStats::kMaxLocalHistoryAgeSecond)) {
-            deleteFile(file_name.c_str());
-            continue;
+    } else {
+        unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
+        if (dir == NULL) {
+            VLOG("Path %s does not exist", path);
+            return;
         }
+        dirent* de;
+        while ((de = readdir(dir.get()))) {
+            char* name = de->d_name;
+            if (name[0] == '.' || de->d_type == DT_DIR) continue;
 
-        ifstream file(file_name.c_str(), ifstream::in | ifstream::binary);
-        int fileSize = 0;
-        if (file.is_open()) {
-            file.seekg(0, ios::end);
-            fileSize = file.tellg();
-            file.close();
-            totalFileSize += fileSize;
+            FileName output;
+            string file_name;
+            if (parseTimestampOnly) {
+                file_name = StringPrintf("%s/%s", path, name);
+                output.mTimestampSec = StrToInt64(strtok(name, "_"));
+                output.mIsHistory = false;
+            } else {
+                parseFileName(name, &output);
+                file_name = output.getFullFileName(path);
+            }
+            if (output.mTimestampSec == -1) continue;
+
+            // Check for timestamp and delete if it's too old.
+            long fileAge = nowSec - output.mTimestampSec;
+            if (fileAge > StatsdStats::kMaxAgeSecond ||
+                (output.mIsHistory && fileAge > StatsdStats::kMaxLocalHistoryAgeSecond)) {
+                deleteFile(file_name.c_str());
+                continue;
+            }
+
+            ifstream file(file_name.c_str(), ifstream::in | ifstream::binary);
+            int fileSize = 0;
+            if (file.is_open()) {
+                file.seekg(0, ios::end);
+                fileSize = file.tellg();
+                file.close();
+                totalFileSize += fileSize;
+            }
+            fileNames.emplace_back(file_name, output.mIsHistory, fileSize, fileAge);
         }
-        fileNames.emplace_back(file_name, output.mIsHistory, fileSize, fileAge);
     }
 
     if (fileNames.size() > StatsdStats::kMaxFileNumber ||
@@ -819,6 +1294,10 @@ void StorageManager::printDirStats(int outFd, const char* path) {
     }
     dprintf(outFd, "\tTotal number of files: %d, Total size of files: %d bytes.\n", fileCount,
             totalFileSize);
+    DirectoryIndex* index = indexForDir(path);
+    if (index != nullptr) {
+        index->printStats(outFd);
+    }
 }
 
 void StorageManager::enforceDbGuardrails(const char* path, const int64_t currWallClockSec,
@@ -848,13 +1327,24 @@ void StorageManager::enforceDbGuardrails(const char* path, const int64_t currWal
         }
         StatsdStats::getInstance().noteRestrictedConfigDbSize(key, currWallClockSec,
                                                               fileInfo.st_size);
+        // The main db file must be deleted through dbutils so its cached write
+        // connection is closed first; WAL side files are removed directly.
+        const bool isMainDb = fullPathName == dbutils::getDbName(key);
         if (fileInfo.st_mtime <= deleteThresholdSec) {
             StatsdStats::getInstance().noteDbTooOld(key);
-            remove(fullPathName.c_str());
+            if (isMainDb) {
+                dbutils::deleteDb(key);
+            } else {
+                remove(fullPathName.c_str());
+            }
         }
         if (fileInfo.st_size >= maxBytes) {
             StatsdStats::getInstance().noteDbSizeExceeded(key);
-            remove(fullPathName.c_str());
+            if (isMainDb) {
+                dbutils::deleteDb(key);
+            } else {
+                remove(fullPathName.c_str());
+            }
         }
         if (hasFile(dbutils::getDbName(key).c_str())) {
             dbutils::verifyIntegrityAndDeleteIfNecessary(key);
@@ -54,10 +54,51 @@ public:
         long mFileAgeSec;
     };
 
+    /**
+     * How durable a write must be before writeFile() returns.
+     */
+    enum class WriteDurability {
+        // fdatasync the file before renaming it into place. For files whose
+        // loss changes behavior, like train info and active configs.
+        CRITICAL,
+        // No per-file sync; the caller finishes the batch with one
+        // syncDataDirectory(), paying a single journal commit for the whole
+        // batch instead of one per file. For report files written in bulk.
+        BATCHED,
+        // No explicit sync at all; the kernel writes the data back on its own
+        // schedule. For local-history copies whose loss only costs debug data.
+        LAZY,
+    };
+
     /**
      * Writes a given byte array as a file to the specified file path.
      */
-    static void writeFile(const char* file, const void* buffer, int numBytes);
+    static void writeFile(const char* file, const void* buffer, int numBytes,
+                          WriteDurability durability = WriteDurability::CRITICAL);
+
+    /**
+     * Appends a given byte array to the file at the specified file path, creating
+     * the file if it does not exist yet.
+     */
+    static void appendFile(const char* file, const void* buffer, int numBytes);
+
+    /**
+     * Compresses a given byte array and writes it as a file to the specified file
+     * path, falling back to the raw bytes when compression does not help. Readers
+     * tell the two apart by the gzip magic, so files written by either method stay
+     * readable.
+     */
+    static void writeCompressedFile(const char* file, const void* buffer, int numBytes,
+                                    WriteDurability durability = WriteDurability::CRITICAL);
+
+    /**
+     * Group-commits every BATCHED write made to the stats data directory since
+     * the last sync, with a single directory fsync. On ordered-mode ext4/f2fs
+     * the one journal commit also flushes the renamed files' data blocks, so a
+     * shutdown writing one report per config pays commit latency once instead
+     * of per file.
+     */
+    static void syncDataDirectory();
 
     /**
      * Writes train info.
@@ -94,6 +135,13 @@ public:
      */
     static void deleteAllFiles(const char* path);
 
+    /**
+     * Deletes temp files orphaned by a crash during an atomic file commit.
+     * Run once at startup; live temp files only exist while writeFile() is
+     * in flight.
+     */
+    static void deleteOrphanedTempFiles();
+
     /**
      * Deletes all files whose name matches with a provided suffix.
      */
@@ -139,6 +187,13 @@ public:
     static bool readConfigFromDisk(const ConfigKey& key, StatsdConfig* config);
     static bool readConfigFromDisk(const ConfigKey& key, string* config);
 
+    /**
+     * Renames the saved config for the key so its file name carries the current
+     * timestamp. Used at startup instead of rewriting the file: the content is
+     * unchanged, but age-based trimming restarts from this boot.
+     */
+    static void refreshConfigTimestamp(const ConfigKey& key);
+
     /**
      * Trims files in the provided directory to limit the total size, number of
      * files, accumulation of outdated files.
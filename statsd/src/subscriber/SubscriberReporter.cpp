@@ -45,14 +45,23 @@ void SubscriberReporter::broadcastSubscriberDied(void* rawPir) {
                     thiz.mIntentMap.erase(subscriberMapIt);
                 }
                 // pirIt and subscriberMapIt are now invalid.
+                thiz.publishSnapshotLocked();
                 return;
             }
         }
     }
 }
 
-SubscriberReporter::SubscriberReporter() :
-    mBroadcastSubscriberDeathRecipient(AIBinder_DeathRecipient_new(broadcastSubscriberDied)) {
+SubscriberReporter::SubscriberReporter()
+    : mIntentMapSnapshot(std::make_shared<const SubscriberIntentMap>()),
+      mBroadcastSubscriberDeathRecipient(AIBinder_DeathRecipient_new(broadcastSubscriberDied)) {
+}
+
+void SubscriberReporter::publishSnapshotLocked() {
+    std::atomic_store_explicit(&mIntentMapSnapshot,
+                               std::shared_ptr<const SubscriberIntentMap>(
+                                       std::make_shared<const SubscriberIntentMap>(mIntentMap)),
+                               std::memory_order_release);
 }
 
 void SubscriberReporter::setBroadcastSubscriber(const ConfigKey& configKey,
@@ -64,6 +73,7 @@ void SubscriberReporter::setBroadcastSubscriber(const ConfigKey& configKey,
     {
         lock_guard<mutex> lock(mLock);
         mIntentMap[configKey][subscriberId] = pir;
+        publishSnapshotLocked();
     }
     // Pass the raw binder pointer address to be the cookie of the death recipient. While the death
     // notification is fired, the cookie is used for identifying which binder was died. Because
@@ -85,6 +95,7 @@ void SubscriberReporter::unsetBroadcastSubscriber(const ConfigKey& configKey,
         if (subscriberMapIt->second.empty()) {
             mIntentMap.erase(configKey);
         }
+        publishSnapshotLocked();
     }
 }
 
@@ -100,7 +111,6 @@ void SubscriberReporter::alertBroadcastSubscriber(const ConfigKey& configKey,
     //  config id - the name of this config (for this particular uid)
 
     VLOG("SubscriberReporter::alertBroadcastSubscriber called.");
-    lock_guard<mutex> lock(mLock);
 
     if (!subscription.has_broadcast_subscriber_details()
             || !subscription.broadcast_subscriber_details().has_subscriber_id()) {
@@ -115,8 +125,13 @@ void SubscriberReporter::alertBroadcastSubscriber(const ConfigKey& configKey,
         cookies.push_back(cookie);
     }
 
-    auto it1 = mIntentMap.find(configKey);
-    if (it1 == mIntentMap.end()) {
+    // Resolve the intent from the published snapshot so concurrent alerts for
+    // different subscribers neither serialize on mLock nor hold it across the
+    // broadcast binder call.
+    const std::shared_ptr<const SubscriberIntentMap> intentMap =
+            std::atomic_load_explicit(&mIntentMapSnapshot, std::memory_order_acquire);
+    auto it1 = intentMap->find(configKey);
+    if (it1 == intentMap->end()) {
         ALOGW("Cannot inform subscriber for missing config key %s ", configKey.ToString().c_str());
         return;
     }
@@ -126,15 +141,15 @@ void SubscriberReporter::alertBroadcastSubscriber(const ConfigKey& configKey,
                 configKey.ToString().c_str(), (long long)subscriberId);
         return;
     }
-    sendBroadcastLocked(it2->second, configKey, subscription, cookies, dimKey);
+    sendBroadcast(it2->second, configKey, subscription, cookies, dimKey);
 }
 
-void SubscriberReporter::sendBroadcastLocked(const shared_ptr<IPendingIntentRef>& pir,
-                                             const ConfigKey& configKey,
-                                             const Subscription& subscription,
-                                             const vector<string>& cookies,
-                                             const MetricDimensionKey& dimKey) const {
-    VLOG("SubscriberReporter::sendBroadcastLocked called.");
+void SubscriberReporter::sendBroadcast(const shared_ptr<IPendingIntentRef>& pir,
+                                       const ConfigKey& configKey,
+                                       const Subscription& subscription,
+                                       const vector<string>& cookies,
+                                       const MetricDimensionKey& dimKey) const {
+    VLOG("SubscriberReporter::sendBroadcast called.");
     pir->sendSubscriberBroadcast(
             configKey.GetUid(),
             configKey.GetId(),
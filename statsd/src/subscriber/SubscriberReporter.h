@@ -20,6 +20,7 @@
 #include <utils/RefBase.h>
 #include <utils/String16.h>
 
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -39,6 +40,10 @@ namespace android {
 namespace os {
 namespace statsd {
 
+/** Maps <ConfigKey, SubscriberId> -> IPendingIntentRef (which represents a PendingIntent). */
+using SubscriberIntentMap =
+        unordered_map<ConfigKey, unordered_map<int64_t, shared_ptr<IPendingIntentRef>>>;
+
 // Reports information to subscribers.
 // Single instance shared across the process. All methods are thread safe.
 class SubscriberReporter {
@@ -77,20 +82,28 @@ public:
 private:
     SubscriberReporter();
 
+    // Guards writes to mIntentMap and the republication of the snapshot. Alert
+    // delivery never takes it, so concurrent alerts do not serialize on it.
     mutable mutex mLock;
 
-    /** Maps <ConfigKey, SubscriberId> -> IPendingIntentRef (which represents a PendingIntent). */
-    unordered_map<ConfigKey, unordered_map<int64_t, shared_ptr<IPendingIntentRef>>> mIntentMap;
+    // Writer-side state; mutated under mLock only.
+    SubscriberIntentMap mIntentMap;
+
+    // Immutable copy of mIntentMap republished on every mutation and read with
+    // an atomic load by alertBroadcastSubscriber, so resolving a subscriber's
+    // intent is lock-free. Mutations are rare (config pushes, binder deaths).
+    std::shared_ptr<const SubscriberIntentMap> mIntentMapSnapshot;
+
+    // Re-publishes mIntentMapSnapshot from mIntentMap. Call with mLock held.
+    void publishSnapshotLocked();
 
     /**
      * Sends a broadcast via the given intentSender (using mStatsCompanionService), along
      * with the information in the other parameters.
      */
-    void sendBroadcastLocked(const shared_ptr<IPendingIntentRef>& pir,
-                             const ConfigKey& configKey,
-                             const Subscription& subscription,
-                             const vector<string>& cookies,
-                             const MetricDimensionKey& dimKey) const;
+    void sendBroadcast(const shared_ptr<IPendingIntentRef>& pir, const ConfigKey& configKey,
+                       const Subscription& subscription, const vector<string>& cookies,
+                       const MetricDimensionKey& dimKey) const;
 
     ::ndk::ScopedAIBinder_DeathRecipient mBroadcastSubscriberDeathRecipient;
 
@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AtomSerializationPlan.h"
+
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+#include "logd/AtomSchemaRegistry.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using util::FIELD_TYPE_MESSAGE;
+using util::ProtoOutputStream;
+
+namespace {
+
+// Protobuf wire types.
+constexpr uint32_t kWireVarint = 0;
+constexpr uint32_t kWireLengthDelimited = 2;
+constexpr uint32_t kWireFixed32 = 5;
+
+// Plans whose shape validation fails this many times are abandoned; the atom then always
+// takes the generic tree writer instead of recompiling on every event.
+constexpr int kMaxRecompiles = 2;
+
+struct PlanInstruction {
+    enum Op : uint8_t {
+        kInt32,
+        kInt64,
+        kFloat,
+        kString,
+        kBytes,
+        // Length-delimited submessage owning the following `leafCount` instructions.
+        kSubMessage,
+    };
+
+    Op op;
+    // Number of leaf instructions belonging to this submessage; 0 for leaves.
+    uint8_t leafCount;
+    // Precomputed wire tag: (field number << 3) | wire type.
+    uint32_t tag;
+};
+
+struct AtomPlan {
+    // One entry per FieldValue: (full field id << 3) | value type. Compared against the
+    // incoming event to confirm the plan still matches its field layout.
+    std::vector<int64_t> shape;
+    std::vector<PlanInstruction> instructions;
+    int recompiles = 0;
+    bool polymorphic = false;
+};
+
+std::mutex sPlanMutex;
+std::unordered_map<int, AtomPlan> sPlans;
+
+int64_t shapeEntry(const FieldValue& value) {
+    return (static_cast<int64_t>(value.mField.getField()) << 3) | value.mValue.getType();
+}
+
+bool compileLeaf(const FieldValue& value, int fieldNum, PlanInstruction* instruction) {
+    const uint32_t fieldBits = static_cast<uint32_t>(fieldNum) << 3;
+    switch (value.mValue.getType()) {
+        case INT:
+            *instruction = {PlanInstruction::kInt32, 0, fieldBits | kWireVarint};
+            return true;
+        case LONG:
+            *instruction = {PlanInstruction::kInt64, 0, fieldBits | kWireVarint};
+            return true;
+        case FLOAT:
+            *instruction = {PlanInstruction::kFloat, 0, fieldBits | kWireFixed32};
+            return true;
+        case STRING:
+            *instruction = {PlanInstruction::kString, 0, fieldBits | kWireLengthDelimited};
+            return true;
+        case STORAGE:
+            *instruction = {PlanInstruction::kBytes, 0, fieldBits | kWireLengthDelimited};
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool compilePlan(const std::vector<FieldValue>& values, AtomPlan* plan) {
+    plan->shape.clear();
+    plan->instructions.clear();
+    for (const FieldValue& value : values) {
+        plan->shape.push_back(shapeEntry(value));
+    }
+
+    size_t index = 0;
+    while (index < values.size()) {
+        const FieldValue& value = values[index];
+        const int depth = value.mField.getDepth();
+        PlanInstruction instruction;
+        if (depth <= 1) {
+            // A top-level primitive or one element of a repeated primitive field; both
+            // are tagged with the field number at depth 0.
+            if (!compileLeaf(value, value.mField.getPosAtDepth(0), &instruction)) {
+                return false;
+            }
+            plan->instructions.push_back(instruction);
+            index++;
+        } else if (depth == 2) {
+            // One element of a repeated submessage (e.g. an attribution node): the run
+            // of consecutive values sharing this prefix.
+            const int32_t prefix = value.mField.getPrefix(2);
+            const size_t subMessageAt = plan->instructions.size();
+            plan->instructions.push_back(
+                    {PlanInstruction::kSubMessage, 0,
+                     (static_cast<uint32_t>(value.mField.getPosAtDepth(0)) << 3) |
+                             kWireLengthDelimited});
+            size_t leafCount = 0;
+            while (index < values.size() && values[index].mField.getDepth() == 2 &&
+                   values[index].mField.getPrefix(2) == prefix) {
+                if (!compileLeaf(values[index], values[index].mField.getPosAtDepth(2),
+                                 &instruction)) {
+                    return false;
+                }
+                plan->instructions.push_back(instruction);
+                leafCount++;
+                index++;
+            }
+            if (leafCount > std::numeric_limits<uint8_t>::max()) {
+                return false;
+            }
+            plan->instructions[subMessageAt].leafCount = static_cast<uint8_t>(leafCount);
+        } else {
+            return false;
+        }
+    }
+    return !plan->instructions.empty();
+}
+
+// Builds the plan straight from the build-time schema table, so registered
+// atoms never pay the first-event shape discovery of compilePlan. Only flat
+// primitive schemas are registered, so every field maps to a depth-0 leaf.
+bool seedPlanFromSchema(int tagId, AtomPlan* plan) {
+    const AtomSchema* schema = findAtomSchema(tagId);
+    if (schema == nullptr) {
+        return false;
+    }
+    plan->shape.clear();
+    plan->instructions.clear();
+    for (uint8_t i = 0; i < schema->numFields; i++) {
+        const int fieldNum = i + 1;
+        const uint32_t fieldBits = static_cast<uint32_t>(fieldNum) << 3;
+        Type type;
+        PlanInstruction instruction;
+        switch (schema->fieldTypes[i]) {
+            case INT32_TYPE:
+            case BOOL_TYPE:  // parseBool stores bools as int32 FieldValues
+                type = INT;
+                instruction = {PlanInstruction::kInt32, 0, fieldBits | kWireVarint};
+                break;
+            case INT64_TYPE:
+                type = LONG;
+                instruction = {PlanInstruction::kInt64, 0, fieldBits | kWireVarint};
+                break;
+            case FLOAT_TYPE:
+                type = FLOAT;
+                instruction = {PlanInstruction::kFloat, 0, fieldBits | kWireFixed32};
+                break;
+            case STRING_TYPE:
+                type = STRING;
+                instruction = {PlanInstruction::kString, 0, fieldBits | kWireLengthDelimited};
+                break;
+            case BYTE_ARRAY_TYPE:
+                type = STORAGE;
+                instruction = {PlanInstruction::kBytes, 0, fieldBits | kWireLengthDelimited};
+                break;
+            default:
+                plan->shape.clear();
+                plan->instructions.clear();
+                return false;
+        }
+        plan->shape.push_back((static_cast<int64_t>(getSimpleField(fieldNum)) << 3) | type);
+        plan->instructions.push_back(instruction);
+    }
+    return !plan->instructions.empty();
+}
+
+size_t varintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+void emitVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Encoded size of one leaf including its tag. Int32 values are encoded from their raw
+// 32 bits, matching ProtoOutputStream.
+size_t leafSize(const PlanInstruction& instruction, const FieldValue& value) {
+    size_t size = varintSize(instruction.tag);
+    switch (instruction.op) {
+        case PlanInstruction::kInt32:
+            size += varintSize(static_cast<uint32_t>(value.mValue.int_value));
+            break;
+        case PlanInstruction::kInt64:
+            size += varintSize(static_cast<uint64_t>(value.mValue.long_value));
+            break;
+        case PlanInstruction::kFloat:
+            size += sizeof(uint32_t);
+            break;
+        case PlanInstruction::kString:
+            size += varintSize(value.mValue.str_value.size()) + value.mValue.str_value.size();
+            break;
+        case PlanInstruction::kBytes:
+            size += varintSize(value.mValue.storage_value.size()) +
+                    value.mValue.storage_value.size();
+            break;
+        default:
+            break;
+    }
+    return size;
+}
+
+void emitLeaf(const PlanInstruction& instruction, const FieldValue& value,
+              std::vector<uint8_t>& out) {
+    emitVarint(out, instruction.tag);
+    switch (instruction.op) {
+        case PlanInstruction::kInt32:
+            emitVarint(out, static_cast<uint32_t>(value.mValue.int_value));
+            break;
+        case PlanInstruction::kInt64:
+            emitVarint(out, static_cast<uint64_t>(value.mValue.long_value));
+            break;
+        case PlanInstruction::kFloat: {
+            uint32_t bits;
+            std::memcpy(&bits, &value.mValue.float_value, sizeof(bits));
+            for (int i = 0; i < 4; i++) {
+                out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+            }
+            break;
+        }
+        case PlanInstruction::kString: {
+            const std::string& str = value.mValue.str_value;
+            emitVarint(out, str.size());
+            out.insert(out.end(), str.begin(), str.end());
+            break;
+        }
+        case PlanInstruction::kBytes: {
+            const std::vector<uint8_t>& bytes = value.mValue.storage_value;
+            emitVarint(out, bytes.size());
+            out.insert(out.end(), bytes.begin(), bytes.end());
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void emitPlan(const AtomPlan& plan, const std::vector<FieldValue>& values,
+              std::vector<uint8_t>& out) {
+    size_t valueIndex = 0;
+    for (size_t i = 0; i < plan.instructions.size(); i++) {
+        const PlanInstruction& instruction = plan.instructions[i];
+        if (instruction.op == PlanInstruction::kSubMessage) {
+            size_t payloadSize = 0;
+            for (size_t leaf = 1; leaf <= instruction.leafCount; leaf++) {
+                payloadSize += leafSize(plan.instructions[i + leaf], values[valueIndex + leaf - 1]);
+            }
+            emitVarint(out, instruction.tag);
+            emitVarint(out, payloadSize);
+        } else {
+            emitLeaf(instruction, values[valueIndex], out);
+            valueIndex++;
+        }
+    }
+}
+
+}  // namespace
+
+bool writeAtomWithSerializationPlan(int tagId, const std::vector<FieldValue>& values,
+                                    ProtoOutputStream* protoOutput) {
+    if (values.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(sPlanMutex);
+    AtomPlan& plan = sPlans[tagId];
+    if (plan.polymorphic) {
+        return false;
+    }
+    if (plan.instructions.empty() && plan.recompiles == 0) {
+        // First sighting of this atom: registered schemas skip shape
+        // discovery. An event that still mismatches falls through to the
+        // normal recompile path below.
+        seedPlanFromSchema(tagId, &plan);
+    }
+
+    bool matches = plan.shape.size() == values.size();
+    for (size_t i = 0; matches && i < values.size(); i++) {
+        matches = plan.shape[i] == shapeEntry(values[i]);
+    }
+    if (!matches) {
+        const bool firstCompile = plan.instructions.empty();
+        if ((!firstCompile && ++plan.recompiles > kMaxRecompiles) || !compilePlan(values, &plan)) {
+            plan.polymorphic = true;
+            plan.shape = {};
+            plan.instructions = {};
+            return false;
+        }
+    }
+
+    // Reused wire-format scratch buffer; handed to the stream as a single message write.
+    static thread_local std::vector<uint8_t> buffer;
+    buffer.clear();
+    emitPlan(plan, values, buffer);
+    protoOutput->write(FIELD_TYPE_MESSAGE | tagId, reinterpret_cast<const char*>(buffer.data()),
+                       buffer.size());
+    return true;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+
+#include <vector>
+
+#include "FieldValue.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Serializes the parsed field values of an atom into the `tagId` submessage of
+ * `protoOutput` using a precompiled per-atom plan.
+ *
+ * The first event of an atom compiles its field layout into a flat instruction array
+ * (wire tag + value kind per field, submessage boundaries precomputed). Subsequent events
+ * with the same layout replay the instructions, encoding the wire bytes directly into a
+ * scratch buffer that is handed to the output stream as one message write — no nested
+ * token bookkeeping and no per-field depth/prefix recomputation. Atoms whose layout
+ * varies from event to event (e.g. variable-length repeated fields) stop using the cache
+ * after a few recompiles.
+ *
+ * Returns false when the values cannot be covered by a plan (nesting deeper than two
+ * levels, an unsupported value type, or a polymorphic layout); the caller must then fall
+ * back to the generic tree writer. The emitted bytes are identical on both paths.
+ */
+bool writeAtomWithSerializationPlan(int tagId, const std::vector<FieldValue>& values,
+                                    util::ProtoOutputStream* protoOutput);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
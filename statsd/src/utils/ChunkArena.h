@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Bump allocator handing out memory from large chunks, released wholesale.
+ *
+ * Past-bucket storage in the metric producers is append-only between dump reports: buckets
+ * accumulate for hours, then the whole container is cleared at once. Serving those
+ * allocations from the general heap fragments it — each per-dimension vector regrows in
+ * place amongst unrelated allocations, and freeing them at dump time returns little memory
+ * to the OS. An arena makes each allocation a pointer bump inside an 8KB chunk and reset()
+ * returns whole chunks, so the dump-time teardown gives the memory back in large blocks.
+ *
+ * Individual allocations are never freed; callers must only use the arena for storage whose
+ * lifetime ends at the next reset().
+ */
+class ChunkArena {
+public:
+    ChunkArena() = default;
+    ChunkArena(const ChunkArena&) = delete;
+    ChunkArena& operator=(const ChunkArena&) = delete;
+
+    ~ChunkArena() {
+        reset();
+    }
+
+    void* allocate(size_t bytes, size_t alignment) {
+        size_t offset = (mOffset + alignment - 1) & ~(alignment - 1);
+        if (mChunks.empty() || offset + bytes > mChunks.back().size) {
+            // Allocations larger than a chunk get a dedicated chunk of their own.
+            newChunk(bytes > kChunkBytes ? bytes : kChunkBytes);
+            offset = 0;
+        }
+        void* ptr = mChunks.back().data + offset;
+        mOffset = offset + bytes;
+        return ptr;
+    }
+
+    // Returns every chunk to the OS. Any container allocating from this arena must be
+    // destroyed or rebuilt empty before this is called.
+    void reset() {
+        for (const Chunk& chunk : mChunks) {
+            ::operator delete(chunk.data);
+        }
+        mChunks.clear();
+        mOffset = 0;
+    }
+
+    size_t chunkCount() const {
+        return mChunks.size();
+    }
+
+private:
+    struct Chunk {
+        char* data;
+        size_t size;
+    };
+
+    void newChunk(size_t size) {
+        mChunks.push_back(Chunk{static_cast<char*>(::operator new(size)), size});
+        mOffset = 0;
+    }
+
+    static constexpr size_t kChunkBytes = 8 * 1024;
+
+    std::vector<Chunk> mChunks;
+
+    // Bytes used in mChunks.back().
+    size_t mOffset = 0;
+};
+
+/**
+ * Standard allocator adapter over a ChunkArena. deallocate() is a no-op — memory only
+ * comes back when the arena is reset — which suits the append-then-clear-wholesale usage
+ * pattern of the past-bucket containers.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(ChunkArena* arena) : mArena(arena) {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.arena()) {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {
+    }
+
+    ChunkArena* arena() const {
+        return mArena;
+    }
+
+private:
+    ChunkArena* mArena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+    return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+    return lhs.arena() != rhs.arena();
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
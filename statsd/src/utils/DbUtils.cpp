@@ -22,6 +22,10 @@
 
 #include <android/api-level.h>
 
+#include <map>
+#include <mutex>
+#include <utility>
+
 #include "FieldValue.h"
 #include "android-base/properties.h"
 #include "android-base/stringprintf.h"
@@ -57,6 +61,45 @@ const string COLUMN_NAME_BRAND = "brand";
 const string COLUMN_NAME_MANUFACTURER = "manufacturer";
 const string COLUMN_NAME_BOARD = "board";
 
+// Checkpoints are batched: the WAL is folded back into the main db only once it
+// grows past this many pages, instead of after every flush transaction.
+const int32_t kWalAutocheckpointPages = 512;
+
+// Ttl sweeps delete in bounded batches so each transaction stays short and
+// readers (and the wal checkpointer) are never starved by one huge delete.
+const int32_t kTtlDeleteBatchSize = 500;
+
+// Page cache per cached connection, in KiB (negative values select KiB in
+// sqlite). Restricted dbs are small; this keeps the insert working set resident
+// while bounding memory across many restricted configs.
+const int32_t kDbCacheSizeKib = -256;
+
+// Streaming transactions are committed early once this many rows accumulate,
+// bounding the WAL growth and writer lock hold time under a chatty atom even if
+// the flush cadence is long.
+const int32_t kStreamAutoCommitRows = 512;
+
+// One cached write connection per restricted config, with its prepared insert
+// statements keyed by (metricId, parameter count). Statement compilation
+// dominates the cost of small flushes, so statements are compiled once per shape
+// and rebound per event.
+struct CachedConnection {
+    sqlite3* db = nullptr;
+    std::map<std::pair<int64_t, int32_t>, sqlite3_stmt*> insertStmts;
+    // Whether a streaming transaction is open on this connection, and how many
+    // rows it has accumulated so far.
+    bool streamTxnOpen = false;
+    int32_t streamTxnRows = 0;
+};
+
+static std::mutex sDbCacheMutex;
+static std::map<ConfigKey, CachedConnection> sDbCache;
+
+static sqlite3_stmt* getCachedInsertStmtLocked(CachedConnection& conn, int64_t metricId,
+                                               int32_t numParams, string& error);
+static int32_t countInsertParams(const LogEvent& event);
+static int32_t bindEventToInsertStmt(sqlite3_stmt* stmt, const LogEvent& event);
+
 static std::vector<std::string> getExpectedTableSchema(const LogEvent& logEvent) {
     vector<std::string> result;
     for (const FieldValue& fieldValue : logEvent.getValues()) {
@@ -205,9 +248,64 @@ bool deleteTable(const ConfigKey& key, const int64_t metricId) {
     return true;
 }
 
+static void closeCachedDbLocked(const ConfigKey& key) {
+    auto it = sDbCache.find(key);
+    if (it == sDbCache.end()) {
+        return;
+    }
+    if (it->second.streamTxnOpen) {
+        sqlite3_exec(it->second.db, "COMMIT", nullptr, nullptr, nullptr);
+    }
+    for (auto& [stmtKey, stmt] : it->second.insertStmts) {
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(it->second.db);
+    sDbCache.erase(it);
+}
+
+static CachedConnection* getCachedConnectionLocked(const ConfigKey& key, string& error) {
+    auto it = sDbCache.find(key);
+    if (it != sDbCache.end()) {
+        return &it->second;
+    }
+    const string dbName = getDbName(key);
+    sqlite3* db;
+    if (sqlite3_open(dbName.c_str(), &db) != SQLITE_OK) {
+        error = sqlite3_errmsg(db);
+        sqlite3_close(db);
+        return nullptr;
+    }
+    // WAL keeps flush appends sequential and lets the delegate's read-only
+    // queries see a consistent snapshot while a flush is in progress. The mode is
+    // persistent, so transient connections opened elsewhere inherit it.
+    // synchronous=NORMAL is the recommended pairing: commits no longer fsync, only
+    // checkpoints do, and WAL guarantees durability up to the last checkpoint.
+    const string pragmas = StringPrintf(
+            "PRAGMA journal_mode=WAL;"
+            "PRAGMA synchronous=NORMAL;"
+            "PRAGMA wal_autocheckpoint=%d;"
+            "PRAGMA cache_size=%d;",
+            kWalAutocheckpointPages, kDbCacheSizeKib);
+    sqlite3_exec(db, pragmas.c_str(), nullptr, nullptr, nullptr);
+    return &(sDbCache[key] = {.db = db});
+}
+
 void deleteDb(const ConfigKey& key) {
+    {
+        std::lock_guard<std::mutex> lock(sDbCacheMutex);
+        closeCachedDbLocked(key);
+    }
     const string dbName = getDbName(key);
     StorageManager::deleteFile(dbName.c_str());
+    // Closing the last connection checkpoints and unlinks the WAL side files, but
+    // they survive an unclean shutdown; remove strays so the db guardrail sweep
+    // does not keep re-counting them.
+    if (StorageManager::hasFile((dbName + "-wal").c_str())) {
+        StorageManager::deleteFile((dbName + "-wal").c_str());
+    }
+    if (StorageManager::hasFile((dbName + "-shm").c_str())) {
+        StorageManager::deleteFile((dbName + "-shm").c_str());
+    }
 }
 
 sqlite3* getDb(const ConfigKey& key) {
@@ -280,18 +378,370 @@ static bool getInsertSqlStmt(sqlite3* db, sqlite3_stmt** stmt, const int64_t met
     return true;
 }
 
+RowBatch::RowBatch(const LogEvent& event) {
+    for (const FieldValue& fieldValue : event.getValues()) {
+        if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
+            // Repeated fields and byte fields are not supported.
+            continue;
+        }
+        Column column;
+        switch (fieldValue.mValue.getType()) {
+            case INT:
+            case LONG:
+                column.type = ColumnType::INTEGER;
+                break;
+            case FLOAT:
+                column.type = ColumnType::REAL;
+                break;
+            case STRING:
+                column.type = ColumnType::TEXT;
+                break;
+            default:
+                continue;
+        }
+        mColumns.push_back(std::move(column));
+    }
+}
+
+bool RowBatch::eventMatchesSchema(const LogEvent& event) const {
+    size_t col = 0;
+    for (const FieldValue& fieldValue : event.getValues()) {
+        if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
+            continue;
+        }
+        ColumnType type;
+        switch (fieldValue.mValue.getType()) {
+            case INT:
+            case LONG:
+                type = ColumnType::INTEGER;
+                break;
+            case FLOAT:
+                type = ColumnType::REAL;
+                break;
+            case STRING:
+                type = ColumnType::TEXT;
+                break;
+            default:
+                continue;
+        }
+        if (col >= mColumns.size() || mColumns[col].type != type) {
+            return false;
+        }
+        ++col;
+    }
+    return col == mColumns.size();
+}
+
+int32_t RowBatch::internString(const string& value) {
+    auto [it, inserted] = mStringIds.try_emplace(value, (int32_t)mStringPool.size());
+    if (inserted) {
+        mStringPool.push_back(&it->first);
+        mByteSize += value.size() + sizeof(string);
+    }
+    return it->second;
+}
+
+bool RowBatch::addRow(const LogEvent& event) {
+    if (!eventMatchesSchema(event)) {
+        return false;
+    }
+    mTags.push_back(event.GetTagId());
+    mElapsedTimestampsNs.push_back(event.GetElapsedTimestampNs());
+    mWallTimestampsNs.push_back(event.GetLogdTimestampNs());
+    mByteSize += sizeof(int32_t) + 2 * sizeof(int64_t);
+    size_t col = 0;
+    for (const FieldValue& fieldValue : event.getValues()) {
+        if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
+            continue;
+        }
+        switch (fieldValue.mValue.getType()) {
+            case INT:
+                mColumns[col++].intValues.push_back(fieldValue.mValue.int_value);
+                mByteSize += sizeof(int64_t);
+                break;
+            case LONG:
+                mColumns[col++].intValues.push_back(fieldValue.mValue.long_value);
+                mByteSize += sizeof(int64_t);
+                break;
+            case FLOAT:
+                mColumns[col++].floatValues.push_back(fieldValue.mValue.float_value);
+                mByteSize += sizeof(float);
+                break;
+            case STRING:
+                mColumns[col++].stringIds.push_back(internString(fieldValue.mValue.str_value));
+                mByteSize += sizeof(int32_t);
+                break;
+            default:
+                // Field types without a column (e.g. double) are not staged.
+                break;
+        }
+    }
+    return true;
+}
+
+bool insert(const ConfigKey& key, const int64_t metricId, const RowBatch& batch, string& error) {
+    if (batch.numRows() == 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(sDbCacheMutex);
+    CachedConnection* conn = getCachedConnectionLocked(key, error);
+    if (conn == nullptr) {
+        return false;
+    }
+    sqlite3* db = conn->db;
+    const int32_t numParams = 3 + batch.mColumns.size();
+    sqlite3_stmt* stmt = getCachedInsertStmtLocked(*conn, metricId, numParams, error);
+    if (stmt == nullptr) {
+        ALOGW("Failed to generate prepared sql insert query %s", error.c_str());
+        return false;
+    }
+    if (sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(db);
+        return false;
+    }
+    for (size_t row = 0; row < batch.numRows(); ++row) {
+        // ? parameters start with an index of 1.
+        int32_t index = 1;
+        sqlite3_bind_int(stmt, index++, batch.mTags[row]);
+        sqlite3_bind_int64(stmt, index++, batch.mElapsedTimestampsNs[row]);
+        sqlite3_bind_int64(stmt, index++, batch.mWallTimestampsNs[row]);
+        for (const RowBatch::Column& column : batch.mColumns) {
+            switch (column.type) {
+                case RowBatch::ColumnType::INTEGER:
+                    sqlite3_bind_int64(stmt, index, column.intValues[row]);
+                    break;
+                case RowBatch::ColumnType::REAL:
+                    sqlite3_bind_double(stmt, index, column.floatValues[row]);
+                    break;
+                case RowBatch::ColumnType::TEXT:
+                    sqlite3_bind_text(stmt, index,
+                                      batch.mStringPool[column.stringIds[row]]->c_str(), -1,
+                                      SQLITE_STATIC);
+                    break;
+            }
+            ++index;
+        }
+        const int stepResult = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        if (stepResult != SQLITE_DONE) {
+            error = sqlite3_errmsg(db);
+            ALOGW("Failed to insert data to db: %s", error.c_str());
+            sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+            return false;
+        }
+    }
+    if (sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(db);
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+static bool beginEventStreamLocked(CachedConnection& conn, string& error) {
+    if (conn.streamTxnOpen) {
+        return true;
+    }
+    if (sqlite3_exec(conn.db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(conn.db);
+        return false;
+    }
+    conn.streamTxnOpen = true;
+    conn.streamTxnRows = 0;
+    return true;
+}
+
+static bool commitEventStreamLocked(CachedConnection& conn, string& error) {
+    if (!conn.streamTxnOpen) {
+        return true;
+    }
+    conn.streamTxnOpen = false;
+    conn.streamTxnRows = 0;
+    if (sqlite3_exec(conn.db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(conn.db);
+        sqlite3_exec(conn.db, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+bool createTableIfNeededStreamed(const ConfigKey& key, const int64_t metricId,
+                                 const LogEvent& event, string& error) {
+    std::lock_guard<std::mutex> lock(sDbCacheMutex);
+    CachedConnection* conn = getCachedConnectionLocked(key, error);
+    if (conn == nullptr) {
+        return false;
+    }
+    // Create the table inside the streaming transaction so it only becomes
+    // visible to readers once the streamed rows are committed, like the rows
+    // themselves.
+    if (!beginEventStreamLocked(*conn, error)) {
+        return false;
+    }
+    char* sqlError = nullptr;
+    const string zSql = getCreateSqlString(metricId, event);
+    sqlite3_exec(conn->db, zSql.c_str(), nullptr, nullptr, &sqlError);
+    if (sqlError) {
+        error = sqlError;
+        ALOGW("Failed to create table to db: %s", sqlError);
+        return false;
+    }
+    return true;
+}
+
+bool insertEventStreamed(const ConfigKey& key, const int64_t metricId, const LogEvent& event,
+                         string& error) {
+    std::lock_guard<std::mutex> lock(sDbCacheMutex);
+    CachedConnection* conn = getCachedConnectionLocked(key, error);
+    if (conn == nullptr) {
+        return false;
+    }
+    sqlite3* db = conn->db;
+    const int32_t numParams = countInsertParams(event);
+    sqlite3_stmt* stmt = getCachedInsertStmtLocked(*conn, metricId, numParams, error);
+    if (stmt == nullptr) {
+        ALOGW("Failed to generate prepared sql insert query %s", error.c_str());
+        return false;
+    }
+    if (!beginEventStreamLocked(*conn, error)) {
+        return false;
+    }
+    const int32_t numBound = bindEventToInsertStmt(stmt, event);
+    const int stepResult = numBound == numParams ? sqlite3_step(stmt) : SQLITE_MISMATCH;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (stepResult != SQLITE_DONE) {
+        error = sqlite3_errmsg(db);
+        ALOGW("Failed to insert data to db: %s", error.c_str());
+        return false;
+    }
+    if (++conn->streamTxnRows >= kStreamAutoCommitRows) {
+        return commitEventStreamLocked(*conn, error);
+    }
+    return true;
+}
+
+bool commitEventStream(const ConfigKey& key, string& error) {
+    std::lock_guard<std::mutex> lock(sDbCacheMutex);
+    auto it = sDbCache.find(key);
+    if (it == sDbCache.end()) {
+        return true;
+    }
+    return commitEventStreamLocked(it->second, error);
+}
+
+// Counts the bound parameters of one insert row: the three fixed columns plus
+// every supported atom field.
+static int32_t countInsertParams(const LogEvent& event) {
+    int32_t numParams = 3;
+    for (const auto& fieldValue : event.getValues()) {
+        if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
+            // Repeated fields and byte fields are not supported.
+            continue;
+        }
+        ++numParams;
+    }
+    return numParams;
+}
+
+static sqlite3_stmt* getCachedInsertStmtLocked(CachedConnection& conn, const int64_t metricId,
+                                               const int32_t numParams, string& error) {
+    auto it = conn.insertStmts.find({metricId, numParams});
+    if (it != conn.insertStmts.end()) {
+        return it->second;
+    }
+    string zSql = StringPrintf("INSERT INTO metric_%s VALUES(", reformatMetricId(metricId).c_str());
+    for (int32_t i = 0; i < numParams; ++i) {
+        zSql += "?,";
+    }
+    zSql.pop_back();
+    zSql += ");";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn.db, zSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(conn.db);
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    conn.insertStmts[{metricId, numParams}] = stmt;
+    return stmt;
+}
+
+// Binds one event to the cached single-row statement. Returns the number of
+// parameters bound. ? parameters start with an index of 1.
+static int32_t bindEventToInsertStmt(sqlite3_stmt* stmt, const LogEvent& event) {
+    int32_t index = 1;
+    sqlite3_bind_int(stmt, index++, event.GetTagId());
+    sqlite3_bind_int64(stmt, index++, event.GetElapsedTimestampNs());
+    sqlite3_bind_int64(stmt, index++, event.GetLogdTimestampNs());
+    for (const auto& fieldValue : event.getValues()) {
+        if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
+            // Repeated fields and byte fields are not supported.
+            continue;
+        }
+        switch (fieldValue.mValue.getType()) {
+            case INT:
+                sqlite3_bind_int(stmt, index, fieldValue.mValue.int_value);
+                break;
+            case LONG:
+                sqlite3_bind_int64(stmt, index, fieldValue.mValue.long_value);
+                break;
+            case STRING:
+                sqlite3_bind_text(stmt, index, fieldValue.mValue.str_value.c_str(), -1,
+                                  SQLITE_STATIC);
+                break;
+            case FLOAT:
+                sqlite3_bind_double(stmt, index, fieldValue.mValue.float_value);
+                break;
+            default:
+                // Byte array fields are not supported.
+                break;
+        }
+        ++index;
+    }
+    return index - 1;
+}
+
 bool insert(const ConfigKey& key, const int64_t metricId, const vector<LogEvent>& events,
             string& error) {
-    const string dbName = getDbName(key);
-    sqlite3* db;
-    if (sqlite3_open(dbName.c_str(), &db) != SQLITE_OK) {
+    std::lock_guard<std::mutex> lock(sDbCacheMutex);
+    CachedConnection* conn = getCachedConnectionLocked(key, error);
+    if (conn == nullptr) {
+        return false;
+    }
+    sqlite3* db = conn->db;
+    if (events.empty()) {
+        return true;
+    }
+    const int32_t numParams = countInsertParams(events[0]);
+    sqlite3_stmt* stmt = getCachedInsertStmtLocked(*conn, metricId, numParams, error);
+    if (stmt == nullptr) {
+        ALOGW("Failed to generate prepared sql insert query %s", error.c_str());
+        return false;
+    }
+    if (sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) {
         error = sqlite3_errmsg(db);
-        sqlite3_close(db);
         return false;
     }
-    bool success = insert(db, metricId, events, error);
-    sqlite3_close(db);
-    return success;
+    for (const auto& logEvent : events) {
+        const int32_t numBound = bindEventToInsertStmt(stmt, logEvent);
+        const int stepResult = numBound == numParams ? sqlite3_step(stmt) : SQLITE_MISMATCH;
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        if (stepResult != SQLITE_DONE) {
+            error = numBound == numParams ? sqlite3_errmsg(db)
+                                          : "event does not match the insert statement shape";
+            ALOGW("Failed to insert data to db: %s", error.c_str());
+            sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+            return false;
+        }
+    }
+    if (sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        error = sqlite3_errmsg(db);
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
 }
 
 bool insert(sqlite3* db, const int64_t metricId, const vector<LogEvent>& events, string& error) {
@@ -361,17 +811,98 @@ bool query(const ConfigKey& key, const string& zSql, vector<vector<string>>& row
     return true;
 }
 
-bool flushTtl(sqlite3* db, const int64_t metricId, const int64_t ttlWallClockNs) {
-    string zSql = StringPrintf("DELETE FROM %s%s WHERE %s <= %lld", TABLE_NAME_PREFIX.c_str(),
-                               reformatMetricId(metricId).c_str(),
-                               COLUMN_NAME_EVENT_WALL_CLOCK_NS.c_str(), (long long)ttlWallClockNs);
-
-    char* error = nullptr;
-    sqlite3_exec(db, zSql.c_str(), nullptr, nullptr, &error);
-    if (error) {
-        ALOGW("Failed to enforce ttl: %s", error);
+bool queryStreamed(const ConfigKey& key, const string& zSql, const size_t maxChunkBytes,
+                   const QueryChunkHandler& chunkHandler, vector<int32_t>& columnTypes,
+                   vector<string>& columnNames, string& err) {
+    const string dbName = getDbName(key);
+    sqlite3* db;
+    if (sqlite3_open_v2(dbName.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        err = sqlite3_errmsg(db);
+        sqlite3_close(db);
+        return false;
+    }
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, zSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        err = sqlite3_errmsg(db);
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        return false;
+    }
+    vector<string> queryData;
+    int32_t chunkRowCount = 0;
+    size_t chunkBytes = 0;
+    int result = sqlite3_step(stmt);
+    bool firstIter = true;
+    while (result == SQLITE_ROW) {
+        int colCount = sqlite3_column_count(stmt);
+        for (int i = 0; i < colCount; ++i) {
+            if (firstIter) {
+                int32_t columnType = sqlite3_column_type(stmt, i);
+                // Needed to convert to java compatible cursor types. See AbstractCursor#getType()
+                if (columnType == 5) {
+                    columnType = 0;  // Remap 5 (null type) to 0 for java cursor
+                }
+                columnTypes.push_back(columnType);
+                columnNames.push_back(reinterpret_cast<const char*>(sqlite3_column_name(stmt, i)));
+            }
+            const unsigned char* textResult = sqlite3_column_text(stmt, i);
+            string colData =
+                    textResult != nullptr ? string(reinterpret_cast<const char*>(textResult)) : "";
+            chunkBytes += colData.size();
+            queryData.push_back(std::move(colData));
+        }
+        firstIter = false;
+        chunkRowCount++;
+        result = sqlite3_step(stmt);
+        // Only flush on row boundaries, and only when more rows follow so the final chunk
+        // always carries isLastChunk.
+        if (result == SQLITE_ROW && chunkBytes >= maxChunkBytes) {
+            if (!chunkHandler(queryData, chunkRowCount, /*isLastChunk=*/false)) {
+                err = "query aborted by result consumer";
+                sqlite3_finalize(stmt);
+                sqlite3_close(db);
+                return false;
+            }
+            queryData.clear();
+            chunkRowCount = 0;
+            chunkBytes = 0;
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (result != SQLITE_DONE) {
+        err = sqlite3_errmsg(db);
+        sqlite3_close(db);
         return false;
     }
+    sqlite3_close(db);
+    if (!chunkHandler(queryData, chunkRowCount, /*isLastChunk=*/true)) {
+        err = "query aborted by result consumer";
+        return false;
+    }
+    return true;
+}
+
+bool flushTtl(sqlite3* db, const int64_t metricId, const int64_t ttlWallClockNs) {
+    // Delete in batches of kTtlDeleteBatchSize rows rather than in one statement,
+    // so a large backlog of expired rows never produces a single long-running
+    // transaction. The rowid subselect works without SQLITE_ENABLE_UPDATE_DELETE_LIMIT.
+    const string tableName = TABLE_NAME_PREFIX + reformatMetricId(metricId);
+    string zSql = StringPrintf("DELETE FROM %s WHERE rowid IN (SELECT rowid FROM %s WHERE %s <= "
+                               "%lld LIMIT %d)",
+                               tableName.c_str(), tableName.c_str(),
+                               COLUMN_NAME_EVENT_WALL_CLOCK_NS.c_str(), (long long)ttlWallClockNs,
+                               kTtlDeleteBatchSize);
+
+    int deletedRows;
+    do {
+        char* error = nullptr;
+        sqlite3_exec(db, zSql.c_str(), nullptr, nullptr, &error);
+        if (error) {
+            ALOGW("Failed to enforce ttl: %s", error);
+            return false;
+        }
+        deletedRows = sqlite3_changes(db);
+    } while (deletedRows >= kTtlDeleteBatchSize);
     return true;
 }
 
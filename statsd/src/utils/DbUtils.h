@@ -17,6 +17,9 @@
 
 #include <sqlite3.h>
 
+#include <functional>
+#include <map>
+
 #include "config/ConfigKey.h"
 #include "logd/LogEvent.h"
 
@@ -60,11 +63,94 @@ sqlite3* getDb(const ConfigKey& key);
 /* Closes the handle to the sqlite db. */
 void closeDb(sqlite3* db);
 
+/* Compact columnar staging for rows awaiting insertion into a metric data table.
+ * Events are decomposed into typed per-column pools when staged, with string
+ * values interned, so high-rate restricted atoms do not accumulate full LogEvent
+ * copies between flushes. The first event fixes the column layout; all staged
+ * rows must share it, mirroring the STRICT table schema they are inserted into.
+ */
+class RowBatch {
+public:
+    explicit RowBatch(const LogEvent& event);
+
+    /* Whether the event's supported fields match this batch's column layout. */
+    bool eventMatchesSchema(const LogEvent& event) const;
+
+    /* Decomposes the event into the column pools. Returns false, staging
+     * nothing, if the event does not match the column layout. */
+    bool addRow(const LogEvent& event);
+
+    inline size_t numRows() const {
+        return mTags.size();
+    }
+
+    /* Approximate heap footprint of the staged rows, for byte-size guardrails. */
+    inline size_t byteSize() const {
+        return mByteSize;
+    }
+
+private:
+    enum class ColumnType { INTEGER, REAL, TEXT };
+
+    struct Column {
+        ColumnType type;
+        vector<int64_t> intValues;     // INTEGER
+        vector<float> floatValues;     // REAL
+        vector<int32_t> stringIds;     // TEXT, indexes into the interned pool
+    };
+
+    int32_t internString(const string& value);
+
+    // Row-major fixed columns.
+    vector<int32_t> mTags;
+    vector<int64_t> mElapsedTimestampsNs;
+    vector<int64_t> mWallTimestampsNs;
+
+    // One entry per supported atom field, in field order.
+    vector<Column> mColumns;
+
+    // Interned string values shared by all TEXT columns. The pointers reference
+    // the map keys, which are stable.
+    std::map<string, int32_t> mStringIds;
+    vector<const string*> mStringPool;
+
+    size_t mByteSize = 0;
+
+    friend bool insert(const ConfigKey& key, int64_t metricId, const RowBatch& batch,
+                       string& error);
+};
+
 /* Inserts new data into the specified metric data table.
  * A temp sqlite handle is created using the ConfigKey.
  */
 bool insert(const ConfigKey& key, int64_t metricId, const vector<LogEvent>& events, string& error);
 
+/* Inserts a staged row batch into the specified metric data table, using the
+ * cached connection and prepared statement for the config.
+ */
+bool insert(const ConfigKey& key, int64_t metricId, const RowBatch& batch, string& error);
+
+/* Creates the metric's data table through the config's cached connection, so
+ * creation is not blocked by an open streaming transaction on that connection.
+ */
+bool createTableIfNeededStreamed(const ConfigKey& key, int64_t metricId, const LogEvent& event,
+                                 string& error);
+
+/* Streams a single event row into the metric's data table through the config's
+ * cached connection and prepared statement. The row is bound inside a
+ * long-lived transaction that is opened on the first streamed row and closed by
+ * commitEventStream(), so nothing is retained on the heap between flushes; the
+ * transaction is also committed automatically once it accumulates enough rows
+ * to bound the WAL footprint and writer lock hold time.
+ */
+bool insertEventStreamed(const ConfigKey& key, int64_t metricId, const LogEvent& event,
+                         string& error);
+
+/* Commits the open streaming transaction for the config, if there is one.
+ * Streamed rows are not visible to other connections until this is called.
+ */
+bool commitEventStream(const ConfigKey& key, string& error);
+
 /* Inserts new data into the specified sqlite db handle. */
 bool insert(sqlite3* db, int64_t metricId, const vector<LogEvent>& events, string& error);
 
@@ -74,6 +160,23 @@ bool insert(sqlite3* db, int64_t metricId, const vector<LogEvent>& events, strin
 bool query(const ConfigKey& key, const string& zSql, vector<vector<string>>& rows,
            vector<int32_t>& columnTypes, vector<string>& columnNames, string& err);
 
+/* Receives one chunk of a streamed query result. queryData holds the chunk's rows flattened
+ * row-major; rowCount is the number of rows in the chunk. Returns whether to keep streaming;
+ * the vector may be reused for the next chunk after the handler returns.
+ */
+using QueryChunkHandler =
+        std::function<bool(vector<string>& queryData, int32_t rowCount, bool isLastChunk)>;
+
+/* Executes a sql query on the specified SQLite db, streaming the results in chunks.
+ * The chunk handler is invoked each time the accumulated cell bytes reach maxChunkBytes and
+ * once more for the final (possibly empty) chunk, so peak memory is bounded by the chunk size
+ * regardless of the result size. Column types and names are filled before the first chunk is
+ * delivered.
+ */
+bool queryStreamed(const ConfigKey& key, const string& zSql, size_t maxChunkBytes,
+                   const QueryChunkHandler& chunkHandler, vector<int32_t>& columnTypes,
+                   vector<string>& columnNames, string& err);
+
 bool flushTtl(sqlite3* db, int64_t metricId, int64_t ttlWallClockNs);
 
 /* Checks for database corruption and deletes the db if it is corrupted. */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "DispatchQueue.h"
+
+#include "utils/ThreadPolicy.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+DispatchQueue::DispatchQueue() : mThread([this] { dispatchLoop(); }) {
+}
+
+DispatchQueue::~DispatchQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShuttingDown = true;
+    }
+    mTaskAdded.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void DispatchQueue::enqueue(Priority priority, std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (priority == Priority::kHigh) {
+            mHighTasks.push_back(std::move(task));
+        } else {
+            mDefaultTasks.push_back(std::move(task));
+        }
+    }
+    mTaskAdded.notify_one();
+}
+
+void DispatchQueue::waitForIdle() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock,
+               [this] { return mHighTasks.empty() && mDefaultTasks.empty() && !mTaskRunning; });
+}
+
+void DispatchQueue::dispatchLoop() {
+    ThreadPolicy::getInstance().applyRole(ThreadRole::BACKGROUND_WORKER);
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        while (mHighTasks.empty() && mDefaultTasks.empty() && !mShuttingDown) {
+            mTaskAdded.wait(lock);
+        }
+        // Queued tasks are drained before shutdown completes.
+        if (mHighTasks.empty() && mDefaultTasks.empty()) {
+            return;
+        }
+        std::deque<std::function<void()>>& tasks =
+                !mHighTasks.empty() ? mHighTasks : mDefaultTasks;
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        mTaskRunning = true;
+        lock.unlock();
+        task();
+        lock.lock();
+        mTaskRunning = false;
+        if (mHighTasks.empty() && mDefaultTasks.empty()) {
+            mIdle.notify_all();
+        }
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Single-threaded dispatch queue with two priority levels.
+ *
+ * Used to decouple binder entry points from statsd's internal locks: the
+ * binder thread enqueues the work and returns immediately, and the dispatch
+ * thread executes it in priority order. High priority tasks jump ahead of
+ * queued default ones; tasks of the same priority run in FIFO order.
+ */
+class DispatchQueue {
+public:
+    enum class Priority {
+        kHigh,
+        kDefault,
+    };
+
+    DispatchQueue();
+
+    DispatchQueue(const DispatchQueue&) = delete;
+    DispatchQueue& operator=(const DispatchQueue&) = delete;
+
+    // Drains any queued tasks before stopping the dispatch thread.
+    ~DispatchQueue();
+
+    // Schedules the task to run on the dispatch thread.
+    void enqueue(Priority priority, std::function<void()> task);
+
+    // Blocks until every task enqueued before this call has finished.
+    void waitForIdle();
+
+private:
+    void dispatchLoop();
+
+    mutable std::mutex mMutex;
+
+    std::condition_variable mTaskAdded;
+
+    std::condition_variable mIdle;
+
+    std::deque<std::function<void()>> mHighTasks;
+
+    std::deque<std::function<void()>> mDefaultTasks;
+
+    bool mTaskRunning = false;
+
+    bool mShuttingDown = false;
+
+    std::thread mThread;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Open-addressing hash table mapping a dimension key to a value.
+ *
+ * std::unordered_map pays a node allocation plus pointer chasing per lookup; the sliced
+ * counter and past-bucket maps in the metric producers are hit on every matched event, and
+ * for heavily sliced metrics hold hundreds of entries. Slots here live in one flat array
+ * with linear probing and the key hash precomputed per slot, so a lookup is a hash, a few
+ * contiguous probes comparing cached hashes, and at most a handful of full key comparisons.
+ *
+ * Keys are hashed through std::hash<Key>; the dimension key types memoize their hashes, so
+ * probing never rehashes FieldValues. Supports the subset of the std::unordered_map
+ * interface the metric producers and anomaly trackers use (find, operator[], insert,
+ * erase(iterator), iteration, size/empty/clear) plus reserve() so the capacity can be
+ * pre-sized from the metric's dimension guardrail. Iteration order is unspecified, as with
+ * std::unordered_map.
+ */
+template <typename Key, typename Mapped>
+class FlatHashMap {
+public:
+    using value_type = std::pair<Key, Mapped>;
+
+private:
+    enum class SlotState : uint8_t {
+        kEmpty = 0,
+        kOccupied = 1,
+        // Deleted slot; probe sequences continue through it.
+        kTombstone = 2,
+    };
+
+    struct Slot {
+        uint32_t hash = 0;
+        SlotState state = SlotState::kEmpty;
+        value_type kv;
+    };
+
+    template <typename SlotPtr, typename ValueRef>
+    class IteratorImpl {
+    public:
+        IteratorImpl(SlotPtr slot, SlotPtr end) : mSlot(slot), mEnd(end) {
+            skipToOccupied();
+        }
+
+        ValueRef operator*() const {
+            return mSlot->kv;
+        }
+
+        auto operator->() const {
+            return &mSlot->kv;
+        }
+
+        IteratorImpl& operator++() {
+            ++mSlot;
+            skipToOccupied();
+            return *this;
+        }
+
+        bool operator==(const IteratorImpl& that) const {
+            return mSlot == that.mSlot;
+        }
+
+        bool operator!=(const IteratorImpl& that) const {
+            return mSlot != that.mSlot;
+        }
+
+    private:
+        void skipToOccupied() {
+            while (mSlot != mEnd && mSlot->state != SlotState::kOccupied) {
+                ++mSlot;
+            }
+        }
+
+        SlotPtr mSlot;
+        SlotPtr mEnd;
+
+        friend class FlatHashMap;
+    };
+
+public:
+    using iterator = IteratorImpl<Slot*, value_type&>;
+    using const_iterator = IteratorImpl<const Slot*, const value_type&>;
+
+    iterator begin() {
+        return iterator(mSlots.data(), slotsEnd());
+    }
+
+    iterator end() {
+        return iterator(slotsEnd(), slotsEnd());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(mSlots.data(), slotsEnd());
+    }
+
+    const_iterator end() const {
+        return const_iterator(slotsEnd(), slotsEnd());
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+    bool empty() const {
+        return mSize == 0;
+    }
+
+    void clear() {
+        mSlots.clear();
+        mSize = 0;
+        mUsedSlots = 0;
+    }
+
+    // Pre-sizes the table so numEntries entries can be inserted without rehashing.
+    void reserve(size_t numEntries) {
+        size_t slotCount = kInitialSlots;
+        while (numEntries * 4 > slotCount * 3) {
+            slotCount *= 2;
+        }
+        if (slotCount > mSlots.size()) {
+            rehash(slotCount);
+        }
+    }
+
+    // Shrinks the slot table to the smallest size that holds the current entries
+    // within the load factor limit, dropping tombstones on the way. A no-op when
+    // the table is already tight; used by the idle memory trim pass to release
+    // capacity retained from dimension bursts.
+    void shrink_to_fit() {
+        if (mSize == 0) {
+            mSlots.clear();
+            mSlots.shrink_to_fit();
+            mUsedSlots = 0;
+            return;
+        }
+        size_t slotCount = kInitialSlots;
+        while (mSize * 4 > slotCount * 3) {
+            slotCount *= 2;
+        }
+        if (slotCount < mSlots.size()) {
+            rehash(slotCount);
+        } else if (mUsedSlots > mSize) {
+            // Same table size, but tombstones lengthen the probe chains.
+            rehash(mSlots.size());
+        }
+    }
+
+    iterator find(const Key& key) {
+        Slot* slot = findSlot(key, keyHash(key));
+        return slot != nullptr ? iterator(slot, slotsEnd()) : end();
+    }
+
+    const_iterator find(const Key& key) const {
+        const Slot* slot = const_cast<FlatHashMap*>(this)->findSlot(key, keyHash(key));
+        return slot != nullptr ? const_iterator(slot, slotsEnd()) : end();
+    }
+
+    Mapped& operator[](const Key& key) {
+        const uint32_t hash = keyHash(key);
+        Slot* slot = findSlot(key, hash);
+        if (slot != nullptr) {
+            return slot->kv.second;
+        }
+        reserveForInsert();
+        slot = insertSlot(key, hash);
+        mSize++;
+        return slot->kv.second;
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        const uint32_t hash = keyHash(value.first);
+        Slot* slot = findSlot(value.first, hash);
+        if (slot != nullptr) {
+            return {iterator(slot, slotsEnd()), false};
+        }
+        reserveForInsert();
+        slot = insertSlot(value.first, hash);
+        slot->kv.second = value.second;
+        mSize++;
+        return {iterator(slot, slotsEnd()), true};
+    }
+
+    void erase(iterator position) {
+        Slot* slot = position.mSlot;
+        slot->state = SlotState::kTombstone;
+        slot->kv = value_type();
+        mSize--;
+    }
+
+private:
+    static constexpr size_t kInitialSlots = 16;
+
+    static uint32_t keyHash(const Key& key) {
+        return static_cast<uint32_t>(std::hash<Key>()(key));
+    }
+
+    const Slot* slotsEnd() const {
+        return mSlots.data() + mSlots.size();
+    }
+
+    Slot* slotsEnd() {
+        return mSlots.data() + mSlots.size();
+    }
+
+    // Returns the occupied slot holding key, or nullptr when absent.
+    Slot* findSlot(const Key& key, uint32_t hash) {
+        if (mSlots.empty()) {
+            return nullptr;
+        }
+        const size_t mask = mSlots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot& slot = mSlots[i];
+            if (slot.state == SlotState::kEmpty) {
+                return nullptr;
+            }
+            if (slot.state == SlotState::kOccupied && slot.hash == hash && slot.kv.first == key) {
+                return &slot;
+            }
+        }
+    }
+
+    // Claims the first reusable slot on key's probe sequence. The key must not be
+    // present and capacity must already be ensured.
+    Slot* insertSlot(const Key& key, uint32_t hash) {
+        const size_t mask = mSlots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot& slot = mSlots[i];
+            if (slot.state != SlotState::kOccupied) {
+                if (slot.state == SlotState::kEmpty) {
+                    mUsedSlots++;
+                }
+                slot.state = SlotState::kOccupied;
+                slot.hash = hash;
+                slot.kv.first = key;
+                slot.kv.second = Mapped();
+                return &slot;
+            }
+        }
+    }
+
+    // Grows/rehashes so that one more insert keeps the load factor (including
+    // tombstones, which extend probe sequences) at or below 3/4.
+    void reserveForInsert() {
+        if (mSlots.empty()) {
+            mSlots.resize(kInitialSlots);
+            return;
+        }
+        if ((mUsedSlots + 1) * 4 <= mSlots.size() * 3) {
+            return;
+        }
+        // Double only when the table is actually full of live entries; otherwise rehash
+        // in place to shed tombstones.
+        rehash(((mSize + 1) * 4 > mSlots.size() * 3) ? mSlots.size() * 2 : mSlots.size());
+    }
+
+    void rehash(size_t newSlotCount) {
+        std::vector<Slot> oldSlots(newSlotCount);
+        oldSlots.swap(mSlots);
+        mUsedSlots = 0;
+        const size_t mask = mSlots.size() - 1;
+        for (Slot& oldSlot : oldSlots) {
+            if (oldSlot.state != SlotState::kOccupied) {
+                continue;
+            }
+            for (size_t i = oldSlot.hash & mask;; i = (i + 1) & mask) {
+                Slot& slot = mSlots[i];
+                if (slot.state == SlotState::kEmpty) {
+                    slot.state = SlotState::kOccupied;
+                    slot.hash = oldSlot.hash;
+                    slot.kv = std::move(oldSlot.kv);
+                    mUsedSlots++;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Slot count is always zero or a power of two.
+    std::vector<Slot> mSlots;
+
+    // Number of live entries.
+    size_t mSize = 0;
+
+    // Occupied plus tombstone slots; drives the rehash threshold.
+    size_t mUsedSlots = 0;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Process-wide refcounted table of interned payloads (string or byte-array field
+ * values). Each distinct live payload is stored exactly once and identified by a
+ * 32-bit id, so a handle is one word, copies are refcount bumps and equality of two
+ * ids is equality of two payloads.
+ *
+ * Entries live in fixed-size blocks hung off a preallocated spine of atomic block
+ * pointers, so an id can be dereferenced without taking the table lock while other
+ * threads intern new payloads. The lock only guards interning, freeing and the
+ * hash index.
+ *
+ * Id 0 is reserved for the default (empty) payload and is never refcounted.
+ */
+template <typename T>
+class InternTable {
+public:
+    static InternTable& getInstance() {
+        static InternTable* sTable = new InternTable();
+        return *sTable;
+    }
+
+    // Returns the id for value, adding it to the table if absent. The returned id
+    // carries one reference owned by the caller.
+    uint32_t intern(const T& value) {
+        if (value.empty()) {
+            return 0;
+        }
+        const size_t hash = hashOf(value);
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto range = mIndex.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            Entry* entry = entryFor(it->second);
+            if (entry->value == value) {
+                entry->refCount.fetch_add(1, std::memory_order_relaxed);
+                return it->second;
+            }
+        }
+        uint32_t id;
+        if (!mFreeIds.empty()) {
+            id = mFreeIds.back();
+            mFreeIds.pop_back();
+        } else {
+            if (mNextId >= kBlockSize * kMaxBlocks) {
+                // Millions of distinct live payloads; the data size guardrails trip long
+                // before this. Alias to the empty payload rather than crash.
+                return 0;
+            }
+            id = mNextId++;
+            const size_t block = id >> kBlockBits;
+            if (mBlocks[block].load(std::memory_order_relaxed) == nullptr) {
+                mBlocks[block].store(new Entry[kBlockSize], std::memory_order_release);
+            }
+        }
+        Entry* entry = entryFor(id);
+        entry->value = value;
+        entry->hash = hash;
+        entry->live = true;
+        entry->refCount.store(1, std::memory_order_relaxed);
+        mIndex.emplace(hash, id);
+        return id;
+    }
+
+    // Adds a reference to an id returned by intern(). Lock-free.
+    void acquire(uint32_t id) {
+        if (id != 0) {
+            entryFor(id)->refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Drops a reference; the entry is freed and its id recycled when the last
+    // reference goes away. Only the final release takes the lock.
+    void release(uint32_t id) {
+        if (id == 0) {
+            return;
+        }
+        Entry* entry = entryFor(id);
+        if (entry->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        // Between the decrement and the lock the entry may have been re-interned
+        // (refcount back above zero) or freed by another thread that raced through
+        // the same window (no longer live). Either way it is not ours to free.
+        if (!entry->live || entry->refCount.load(std::memory_order_acquire) != 0) {
+            return;
+        }
+        auto range = mIndex.equal_range(entry->hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                mIndex.erase(it);
+                break;
+            }
+        }
+        entry->value = T();  // give the payload's heap allocation back
+        entry->live = false;
+        mFreeIds.push_back(id);
+    }
+
+    // The payload for an id. The caller must hold a reference; the returned
+    // reference stays valid for as long as it does.
+    const T& get(uint32_t id) const {
+        return entryFor(id)->value;
+    }
+
+private:
+    // 1024 entries per block, 4096 blocks: ~4M concurrently live distinct payloads.
+    static constexpr size_t kBlockBits = 10;
+    static constexpr size_t kBlockSize = 1ull << kBlockBits;
+    static constexpr size_t kMaxBlocks = 1ull << 12;
+
+    struct Entry {
+        T value;
+        size_t hash = 0;
+        bool live = false;
+        std::atomic<uint32_t> refCount{0};
+    };
+
+    InternTable() {
+        // Block 0 always exists so id 0 (the empty payload) dereferences safely.
+        mBlocks[0].store(new Entry[kBlockSize], std::memory_order_release);
+    }
+
+    Entry* entryFor(uint32_t id) const {
+        return &mBlocks[id >> kBlockBits].load(std::memory_order_acquire)[id & (kBlockSize - 1)];
+    }
+
+    static size_t hashOf(const std::string& value) {
+        return std::hash<std::string_view>()(value);
+    }
+
+    static size_t hashOf(const std::vector<uint8_t>& value) {
+        return std::hash<std::string_view>()(
+                std::string_view(reinterpret_cast<const char*>(value.data()), value.size()));
+    }
+
+    mutable std::mutex mMutex;
+    std::atomic<Entry*> mBlocks[kMaxBlocks] = {};
+    uint32_t mNextId = 1;
+    std::vector<uint32_t> mFreeIds;
+    // hash -> id; collisions are resolved by comparing payloads under the lock.
+    std::unordered_multimap<size_t, uint32_t> mIndex;
+};
+
+/**
+ * One-word RAII handle to an entry in the InternTable. Converts implicitly to the
+ * underlying type and mirrors the few accessors Value call sites use, so swapping a
+ * std::string member for an InternedHandle<std::string> leaves readers unchanged
+ * while shrinking the member to 4 bytes and making copies refcount bumps.
+ */
+template <typename T>
+class InternedHandle {
+public:
+    InternedHandle() = default;
+
+    InternedHandle(const T& value) : mId(table().intern(value)) {
+    }
+
+    InternedHandle(const InternedHandle& other) : mId(other.mId) {
+        table().acquire(mId);
+    }
+
+    InternedHandle(InternedHandle&& other) noexcept : mId(other.mId) {
+        other.mId = 0;
+    }
+
+    ~InternedHandle() {
+        table().release(mId);
+    }
+
+    InternedHandle& operator=(const InternedHandle& other) {
+        if (mId != other.mId) {
+            table().release(mId);
+            mId = other.mId;
+            table().acquire(mId);
+        }
+        return *this;
+    }
+
+    InternedHandle& operator=(InternedHandle&& other) noexcept {
+        std::swap(mId, other.mId);
+        return *this;
+    }
+
+    InternedHandle& operator=(const T& value) {
+        const uint32_t newId = table().intern(value);
+        table().release(mId);
+        mId = newId;
+        return *this;
+    }
+
+    const T& value() const {
+        return table().get(mId);
+    }
+
+    operator const T&() const {
+        return value();
+    }
+
+    size_t size() const {
+        return value().size();
+    }
+
+    size_t length() const {
+        return value().size();
+    }
+
+    bool empty() const {
+        return mId == 0;
+    }
+
+    auto data() const {
+        return value().data();
+    }
+
+    const char* c_str() const {
+        return value().c_str();
+    }
+
+    // Interning guarantees equal ids iff equal payloads, so (in)equality is O(1).
+    bool operator==(const InternedHandle& that) const {
+        return mId == that.mId;
+    }
+    bool operator!=(const InternedHandle& that) const {
+        return mId != that.mId;
+    }
+    bool operator<(const InternedHandle& that) const {
+        return mId != that.mId && value() < that.value();
+    }
+    bool operator>(const InternedHandle& that) const {
+        return mId != that.mId && value() > that.value();
+    }
+    bool operator<=(const InternedHandle& that) const {
+        return mId == that.mId || value() <= that.value();
+    }
+    bool operator>=(const InternedHandle& that) const {
+        return mId == that.mId || value() >= that.value();
+    }
+
+    bool operator==(const T& that) const {
+        return value() == that;
+    }
+    bool operator!=(const T& that) const {
+        return value() != that;
+    }
+    bool operator==(const char* that) const {
+        return value() == that;
+    }
+    bool operator!=(const char* that) const {
+        return value() != that;
+    }
+
+    friend bool operator==(const T& lhs, const InternedHandle& rhs) {
+        return rhs.value() == lhs;
+    }
+    friend bool operator!=(const T& lhs, const InternedHandle& rhs) {
+        return rhs.value() != lhs;
+    }
+    friend bool operator==(const char* lhs, const InternedHandle& rhs) {
+        return rhs.value() == lhs;
+    }
+    friend bool operator!=(const char* lhs, const InternedHandle& rhs) {
+        return rhs.value() != lhs;
+    }
+
+private:
+    static InternTable<T>& table() {
+        return InternTable<T>::getInstance();
+    }
+
+    uint32_t mId = 0;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
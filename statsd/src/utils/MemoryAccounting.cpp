@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MemoryAccounting.h"
+
+#include <stdio.h>
+
+#ifdef STATSD_MALLOC_ACCOUNTING
+#include <malloc.h>
+
+#include <array>
+#include <new>
+#endif  // STATSD_MALLOC_ACCOUNTING
+
+namespace android {
+namespace os {
+namespace statsd {
+
+const char* MemoryAccounting::tagName(Tag tag) {
+    switch (tag) {
+        case kUntagged:
+            return "untagged";
+        case kMetrics:
+            return "metrics";
+        case kMatchers:
+            return "matchers";
+        case kUidMap:
+            return "uid-map";
+        case kQueue:
+            return "queue";
+        case kReports:
+            return "reports";
+        default:
+            return "unknown";
+    }
+}
+
+#ifdef STATSD_MALLOC_ACCOUNTING
+
+namespace {
+
+// Trivially-constructible thread-local so the hooks are safe to run during
+// thread start-up, before any dynamic TLS initialization.
+thread_local MemoryAccounting::Tag tCurrentTag = MemoryAccounting::kUntagged;
+
+struct TagCounters {
+    std::atomic<int64_t> liveBytes = 0;
+    std::atomic<int64_t> totalAllocations = 0;
+};
+
+std::array<TagCounters, MemoryAccounting::kNumTags> sCounters;
+
+}  // namespace
+
+MemoryAccounting::Tag MemoryAccounting::currentTag() {
+    return tCurrentTag;
+}
+
+MemoryAccounting::Tag MemoryAccounting::setTag(Tag tag) {
+    const Tag previous = tCurrentTag;
+    tCurrentTag = tag;
+    return previous;
+}
+
+void MemoryAccounting::onAlloc(Tag tag, size_t bytes) {
+    sCounters[tag].liveBytes.fetch_add(bytes, std::memory_order_relaxed);
+    sCounters[tag].totalAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryAccounting::onFree(Tag tag, size_t bytes) {
+    sCounters[tag].liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryAccounting::TagStats MemoryAccounting::getStats(Tag tag) {
+    TagStats stats;
+    stats.liveBytes = sCounters[tag].liveBytes.load(std::memory_order_relaxed);
+    stats.totalAllocations = sCounters[tag].totalAllocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MemoryAccounting::dump(int out) {
+    dprintf(out, "Allocation accounting (live bytes / total allocations):\n");
+    for (uint32_t tag = 0; tag < kNumTags; tag++) {
+        const TagStats stats = getStats(static_cast<Tag>(tag));
+        dprintf(out, "  %-10s %lld bytes / %lld allocations\n", tagName(static_cast<Tag>(tag)),
+                (long long)stats.liveBytes, (long long)stats.totalAllocations);
+    }
+}
+
+namespace {
+
+// Each allocation is prefixed with its charged size and tag so the matching
+// delete can release the bytes against the right subsystem even if it runs on
+// a differently-tagged thread. The header is max_align_t-sized to preserve
+// the alignment contract of operator new.
+struct AllocHeader {
+    size_t bytes;
+    MemoryAccounting::Tag tag;
+};
+constexpr size_t kHeaderSize =
+        (sizeof(AllocHeader) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+void* allocateTracked(size_t size) {
+    void* mem = malloc(size + kHeaderSize);
+    if (mem == nullptr) {
+        return nullptr;
+    }
+    AllocHeader* header = static_cast<AllocHeader*>(mem);
+    header->bytes = size;
+    header->tag = tCurrentTag;
+    MemoryAccounting::onAlloc(header->tag, size);
+    return static_cast<char*>(mem) + kHeaderSize;
+}
+
+void freeTracked(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    void* mem = static_cast<char*>(ptr) - kHeaderSize;
+    const AllocHeader* header = static_cast<AllocHeader*>(mem);
+    MemoryAccounting::onFree(header->tag, header->bytes);
+    free(mem);
+}
+
+}  // namespace
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+
+// Process-wide replacement of the throwing and non-throwing forms. Statsd is
+// built without aligned-new usage in its hot paths; the default aligned
+// operators fall through to libc and simply go unaccounted.
+void* operator new(size_t size) {
+    void* ptr = ::android::os::statsd::allocateTracked(size);
+    if (ptr == nullptr) {
+        abort();  // statsd builds with -fno-exceptions; match bionic OOM behavior
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return ::android::os::statsd::allocateTracked(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return ::android::os::statsd::allocateTracked(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    ::android::os::statsd::freeTracked(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    ::android::os::statsd::freeTracked(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    ::android::os::statsd::freeTracked(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    ::android::os::statsd::freeTracked(ptr);
+}
+
+#else  // STATSD_MALLOC_ACCOUNTING
+
+namespace android {
+namespace os {
+namespace statsd {
+
+void MemoryAccounting::dump(int out) {
+    dprintf(out, "Allocation accounting: disabled (build with -DSTATSD_MALLOC_ACCOUNTING)\n");
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+
+#endif  // STATSD_MALLOC_ACCOUNTING
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Opt-in per-subsystem heap accounting, so RSS growth can be attributed to a
+ * subsystem from dumpsys instead of pulling heap dumps off production devices.
+ *
+ * Enabled by building libstatsd with -DSTATSD_MALLOC_ACCOUNTING (debug builds
+ * only): global operator new/delete are replaced with hooks that prefix every
+ * allocation with its size and the subsystem tagged on the allocating thread,
+ * and maintain per-subsystem live-byte/allocation counters. Without the flag
+ * the scoped tags compile to empty objects and no hooks are installed, so
+ * production builds pay nothing.
+ *
+ * Tags are thread-local and scoped: the pipeline entry points (config build,
+ * per-config event processing, uid-map updates, socket ingestion, report
+ * dumps) establish a tag, and every allocation on that thread until the scope
+ * closes is charged to it. Worker threads spawned inside a scope start
+ * untagged.
+ */
+class MemoryAccounting {
+public:
+    enum Tag : uint32_t {
+        kUntagged = 0,
+        kMetrics,
+        kMatchers,
+        kUidMap,
+        kQueue,
+        kReports,
+        kNumTags,
+    };
+
+    struct TagStats {
+        int64_t liveBytes = 0;
+        int64_t totalAllocations = 0;
+    };
+
+#ifdef STATSD_MALLOC_ACCOUNTING
+    // Current thread's tag; read by the allocation hooks.
+    static Tag currentTag();
+
+    // Sets the current thread's tag and returns the previous one.
+    static Tag setTag(Tag tag);
+
+    // Called by the allocation hooks to charge/release bytes against a tag.
+    static void onAlloc(Tag tag, size_t bytes);
+    static void onFree(Tag tag, size_t bytes);
+
+    static TagStats getStats(Tag tag);
+#endif  // STATSD_MALLOC_ACCOUNTING
+
+    static const char* tagName(Tag tag);
+
+    // Human readable per-subsystem summary; prints a single "disabled" line
+    // when the build does not have the hooks compiled in.
+    static void dump(int out);
+};
+
+/**
+ * Tags every allocation made by the current thread, for the lifetime of the
+ * scope, with the given subsystem. Nests: the previous tag is restored on
+ * destruction.
+ */
+class ScopedMemoryTag {
+public:
+#ifdef STATSD_MALLOC_ACCOUNTING
+    explicit ScopedMemoryTag(MemoryAccounting::Tag tag)
+        : mPreviousTag(MemoryAccounting::setTag(tag)) {
+    }
+
+    ~ScopedMemoryTag() {
+        MemoryAccounting::setTag(mPreviousTag);
+    }
+
+private:
+    const MemoryAccounting::Tag mPreviousTag;
+#else
+    explicit ScopedMemoryTag(MemoryAccounting::Tag) {
+    }
+#endif  // STATSD_MALLOC_ACCOUNTING
+
+    ScopedMemoryTag(const ScopedMemoryTag&) = delete;
+    ScopedMemoryTag& operator=(const ScopedMemoryTag&) = delete;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
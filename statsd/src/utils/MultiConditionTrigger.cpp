@@ -18,6 +18,8 @@
 
 #include "MultiConditionTrigger.h"
 
+#include "utils/WorkerPool.h"
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -32,7 +34,7 @@ MultiConditionTrigger::MultiConditionTrigger(const set<string>& conditionNames,
       mTrigger(std::move(trigger)),
       mCompleted(mRemainingConditionNames.empty()) {
     if (mCompleted) {
-        startExecutorThread();
+        executeTrigger();
     }
 }
 
@@ -48,18 +50,28 @@ void MultiConditionTrigger::markComplete(const string& conditionName) {
         doTrigger = mCompleted;
     }
     if (doTrigger) {
-        startExecutorThread();
+        executeTrigger();
     }
 }
 
-void MultiConditionTrigger::startExecutorThread() {
-    mExecutorThread = std::make_unique<std::thread>([this] { mTrigger(); });
+void MultiConditionTrigger::executeTrigger() {
+    mExecutionState = std::make_shared<ExecutionState>();
+    // The task captures its own copies so it never touches this instance, which may
+    // be destroyed while the task is still queued.
+    WorkerPool::getInstance().enqueue(
+            [trigger = mTrigger, state = mExecutionState] {
+                trigger();
+                std::lock_guard<std::mutex> lg(state->mMutex);
+                state->mDone = true;
+                state->mDoneCV.notify_all();
+            });
 }
 
 MultiConditionTrigger::~MultiConditionTrigger() {
-    if (mExecutorThread != nullptr && mExecutorThread->joinable()) {
-        VLOG("MultiConditionTrigger waiting on execution thread termination");
-        mExecutorThread->join();
+    if (mExecutionState != nullptr) {
+        VLOG("MultiConditionTrigger waiting on trigger execution");
+        std::unique_lock<std::mutex> lock(mExecutionState->mMutex);
+        mExecutionState->mDoneCV.wait(lock, [this] { return mExecutionState->mDone; });
     }
 }
 
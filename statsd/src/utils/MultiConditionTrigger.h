@@ -17,9 +17,10 @@
 
 #include <gtest/gtest_prod.h>
 
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <set>
-#include <thread>
 
 namespace android {
 namespace os {
@@ -28,8 +29,8 @@ namespace statsd {
 /**
  * This class provides a utility to wait for a set of named conditions to occur.
  *
- * It will execute the trigger runnable in a separate thread (which will be joined at instance
- * destructor time) once all conditions have been marked true.
+ * It will execute the trigger runnable on the shared WorkerPool (the destructor waits for that
+ * execution to finish) once all conditions have been marked true.
  */
 class MultiConditionTrigger {
 public:
@@ -45,13 +46,21 @@ public:
     void markComplete(const std::string& conditionName);
 
 private:
-    void startExecutorThread();
+    // Signaled by the worker task once the trigger has run, so the destructor can
+    // wait for it without owning a dedicated thread.
+    struct ExecutionState {
+        std::mutex mMutex;
+        std::condition_variable mDoneCV;
+        bool mDone = false;
+    };
+
+    void executeTrigger();
 
     mutable std::mutex mMutex;
     std::set<std::string> mRemainingConditionNames;
     std::function<void()> mTrigger;
     bool mCompleted;
-    std::unique_ptr<std::thread> mExecutorThread;
+    std::shared_ptr<ExecutionState> mExecutionState;
 
     FRIEND_TEST(MultiConditionTriggerTest, TestCountDownCalledBySameEventName);
 };
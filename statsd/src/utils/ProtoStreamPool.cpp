@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "ProtoStreamPool.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+ProtoStreamPool& ProtoStreamPool::getInstance() {
+    static ProtoStreamPool sProtoStreamPool;
+    return sProtoStreamPool;
+}
+
+PooledProtoStream ProtoStreamPool::borrow() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mIdleStreams.empty()) {
+            std::unique_ptr<util::ProtoOutputStream> stream = std::move(mIdleStreams.back());
+            mIdleStreams.pop_back();
+            return PooledProtoStream(*this, std::move(stream));
+        }
+    }
+    return PooledProtoStream(*this, std::make_unique<util::ProtoOutputStream>());
+}
+
+void ProtoStreamPool::recycle(std::unique_ptr<util::ProtoOutputStream> stream) {
+    if (stream->size() > kMaxRetainedStreamBytes) {
+        return;
+    }
+    // Rewinds the write position but keeps the grown chunks, which is the point
+    // of pooling the stream.
+    stream->clear();
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mIdleStreams.size() < kMaxPooledStreams) {
+        mIdleStreams.push_back(std::move(stream));
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+class PooledProtoStream;
+
+/**
+ * Process-wide pool of reusable ProtoOutputStream objects.
+ *
+ * A ProtoOutputStream grows its backing buffer chunk by chunk and frees it all
+ * on destruction, so paths that build a stream per report or per atom pay the
+ * same grow/free cycle on every upload, right when the system is busiest.
+ * Streams borrowed from the pool keep their grown chunks across uses; clear()
+ * rewinds the write position without releasing memory.
+ *
+ * The pool is bounded twice over: at most kMaxPooledStreams idle streams are
+ * kept, and a stream that grew past kMaxRetainedStreamBytes is destroyed on
+ * return rather than pooled, so a one-off huge report does not pin its buffer
+ * for the lifetime of the process.
+ */
+class ProtoStreamPool {
+public:
+    static ProtoStreamPool& getInstance();
+
+    ProtoStreamPool(const ProtoStreamPool&) = delete;
+    ProtoStreamPool& operator=(const ProtoStreamPool&) = delete;
+
+    // Returns a cleared stream, reusing a pooled one when available. The stream
+    // goes back to the pool when the returned handle is destroyed.
+    PooledProtoStream borrow();
+
+private:
+    friend class PooledProtoStream;
+
+    ProtoStreamPool() = default;
+
+    void recycle(std::unique_ptr<util::ProtoOutputStream> stream);
+
+    // Enough for the report, active-config and per-atom serialization paths to
+    // each hold a stream concurrently without thrashing the pool.
+    static constexpr size_t kMaxPooledStreams = 4;
+
+    // Streams that wrote more than this are destroyed instead of pooled.
+    static constexpr size_t kMaxRetainedStreamBytes = 512 * 1024;
+
+    mutable std::mutex mMutex;
+
+    std::vector<std::unique_ptr<util::ProtoOutputStream>> mIdleStreams;
+};
+
+/**
+ * Move-only handle for a borrowed ProtoOutputStream; returns the stream to the
+ * pool on destruction.
+ */
+class PooledProtoStream {
+public:
+    PooledProtoStream(ProtoStreamPool& pool, std::unique_ptr<util::ProtoOutputStream> stream)
+        : mPool(pool), mStream(std::move(stream)) {
+    }
+
+    PooledProtoStream(PooledProtoStream&& that)
+        : mPool(that.mPool), mStream(std::move(that.mStream)) {
+    }
+
+    PooledProtoStream(const PooledProtoStream&) = delete;
+    PooledProtoStream& operator=(const PooledProtoStream&) = delete;
+    PooledProtoStream& operator=(PooledProtoStream&&) = delete;
+
+    ~PooledProtoStream() {
+        if (mStream != nullptr) {
+            mPool.recycle(std::move(mStream));
+        }
+    }
+
+    util::ProtoOutputStream& operator*() const {
+        return *mStream;
+    }
+
+    util::ProtoOutputStream* operator->() const {
+        return mStream.get();
+    }
+
+    util::ProtoOutputStream* get() const {
+        return mStream.get();
+    }
+
+private:
+    ProtoStreamPool& mPool;
+
+    std::unique_ptr<util::ProtoOutputStream> mStream;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -18,13 +18,26 @@
 
 #include <log/log.h>
 
+#include <mutex>
+#include <unordered_map>
+
 namespace android {
 namespace os {
 namespace statsd {
 
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 
+namespace {
+
+// ERE metacharacters; a pattern without any of these is a plain substring.
+bool isLiteralText(const string& text) {
+    return !text.empty() && text.find_first_of(".[]()*+?{}|^$\\") == string::npos;
+}
+
+}  // namespace
+
 Regex::Regex(regex_t impl) : mImpl(std::move(impl)) {
 }
 
@@ -52,11 +65,185 @@ unique_ptr<Regex> Regex::create(const string& pattern) {
         regfree(&impl);
         return nullptr;
     } else {
-        return std::make_unique<Regex>(impl);
+        unique_ptr<Regex> re = std::make_unique<Regex>(impl);
+        re->classify(pattern);
+        return re;
+    }
+}
+
+shared_ptr<Regex> Regex::createShared(const string& pattern) {
+    static std::mutex cacheMutex;
+    static std::unordered_map<string, std::weak_ptr<Regex>>* cache =
+            new std::unordered_map<string, std::weak_ptr<Regex>>();
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache->find(pattern);
+    if (it != cache->end()) {
+        if (shared_ptr<Regex> cached = it->second.lock()) {
+            return cached;
+        }
+    }
+    shared_ptr<Regex> re = create(pattern);
+    if (re == nullptr) {
+        // Do not cache failures; create() already logged the error.
+        return nullptr;
+    }
+    (*cache)[pattern] = re;
+    // Patterns come from configs, so the cache stays small; still drop entries
+    // whose last holder is gone whenever it grows past a handful.
+    if (cache->size() > 64) {
+        for (auto entry = cache->begin(); entry != cache->end();) {
+            entry = entry->second.expired() ? cache->erase(entry) : std::next(entry);
+        }
+    }
+    return re;
+}
+
+size_t Regex::parseCharClass(const string& pattern, size_t pos) {
+    // pos is at '['. A leading '^' negates the class.
+    size_t i = pos + 1;
+    bool negate = false;
+    if (i < pattern.size() && pattern[i] == '^') {
+        negate = true;
+        i++;
+    }
+    mClassBits.fill(0);
+    bool sawMember = false;
+    while (i < pattern.size() && (pattern[i] != ']' || !sawMember)) {
+        const char c = pattern[i];
+        if (c == '[' || c == '\\') {
+            // Nested bracket expressions ([:digit:] etc.) and escapes stay on POSIX.
+            return string::npos;
+        }
+        if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+            const uint8_t lo = static_cast<uint8_t>(c);
+            const uint8_t hi = static_cast<uint8_t>(pattern[i + 2]);
+            if (lo > hi) {
+                return string::npos;
+            }
+            for (int b = lo; b <= hi; b++) {
+                mClassBits[b >> 6] |= (uint64_t)1 << (b & 0x3f);
+            }
+            i += 3;
+        } else {
+            const uint8_t b = static_cast<uint8_t>(c);
+            mClassBits[b >> 6] |= (uint64_t)1 << (b & 0x3f);
+            i++;
+        }
+        sawMember = true;
+    }
+    if (i >= pattern.size() || !sawMember) {
+        return string::npos;
+    }
+    if (negate) {
+        for (uint64_t& word : mClassBits) {
+            word = ~word;
+        }
+        // A negated class never matches NUL in POSIX.
+        mClassBits[0] &= ~(uint64_t)1;
+    }
+    return i + 1;  // past ']'
+}
+
+void Regex::classify(const string& pattern) {
+    if (pattern.empty()) {
+        return;  // kPosix
+    }
+    if (pattern.front() == '^') {
+        const string body = pattern.substr(1);
+        if (isLiteralText(body)) {
+            mKind = Kind::kLiteralPrefix;
+            mLiteral = body;
+            return;
+        }
+        if (body.size() >= 2 && body.front() == '[' &&
+            (body.back() == '+' || body.back() == '*')) {
+            const size_t end = parseCharClass(body, 0);
+            if (end == body.size() - 1) {
+                mKind = Kind::kClassPrefix;
+                mClassMinOne = body.back() == '+';
+                return;
+            }
+        }
+        return;  // kPosix
+    }
+    if (pattern.back() == '$') {
+        const string body = pattern.substr(0, pattern.size() - 1);
+        if (isLiteralText(body)) {
+            mKind = Kind::kLiteralSuffix;
+            mLiteral = body;
+            return;
+        }
+        if (body.size() >= 2 && body.front() == '[' &&
+            (body.back() == '+' || body.back() == '*')) {
+            const size_t end = parseCharClass(body, 0);
+            if (end == body.size() - 1) {
+                mKind = Kind::kClassSuffix;
+                mClassMinOne = body.back() == '+';
+                return;
+            }
+        }
+        return;  // kPosix
+    }
+    if (isLiteralText(pattern)) {
+        mKind = Kind::kLiteral;
+        mLiteral = pattern;
     }
 }
 
 bool Regex::replace(string& str, const string& replacement) {
+    switch (mKind) {
+        case Kind::kLiteral: {
+            const size_t pos = str.find(mLiteral);
+            if (pos == string::npos) {
+                return false;
+            }
+            str.replace(pos, mLiteral.size(), replacement);
+            return true;
+        }
+        case Kind::kLiteralPrefix: {
+            if (str.compare(0, mLiteral.size(), mLiteral) != 0) {
+                return false;
+            }
+            str.replace(0, mLiteral.size(), replacement);
+            return true;
+        }
+        case Kind::kLiteralSuffix: {
+            if (str.size() < mLiteral.size() ||
+                str.compare(str.size() - mLiteral.size(), mLiteral.size(), mLiteral) != 0) {
+                return false;
+            }
+            str.replace(str.size() - mLiteral.size(), mLiteral.size(), replacement);
+            return true;
+        }
+        case Kind::kClassPrefix: {
+            size_t matchEnd = 0;
+            while (matchEnd < str.size() && inClass(str[matchEnd])) {
+                matchEnd++;
+            }
+            if (matchEnd == 0 && mClassMinOne) {
+                return false;
+            }
+            str.replace(0, matchEnd, replacement);
+            return true;
+        }
+        case Kind::kClassSuffix: {
+            // Scanning back from the end yields the same leftmost-longest match
+            // regexec() would find for an end-anchored class repetition.
+            size_t matchStart = str.size();
+            while (matchStart > 0 && inClass(str[matchStart - 1])) {
+                matchStart--;
+            }
+            if (matchStart == str.size() && mClassMinOne) {
+                return false;
+            }
+            str.replace(matchStart, str.size() - matchStart, replacement);
+            return true;
+        }
+        case Kind::kPosix:
+            break;
+    }
+
     regmatch_t match;
     int status = regexec(&mImpl, str.c_str(), 1 /* nmatch */, &match /* pmatch */, 0 /* flags */);
 
@@ -18,6 +18,7 @@
 
 #include <regex.h>
 
+#include <array>
 #include <memory>
 #include <string>
 
@@ -35,12 +36,55 @@ public:
     // Returns nullptr if pattern is not valid POSIX regex.
     static std::unique_ptr<Regex> create(const std::string& pattern);
 
+    // Same as create, but served from a process-wide cache keyed by the pattern
+    // string, so identical patterns across matchers and configs compile once.
+    // Entries are dropped once the last holder releases them.
+    static std::shared_ptr<Regex> createShared(const std::string& pattern);
+
     // Looks for a regex match in str and replaces the matched portion with replacement in-place.
     // Returns true if there was a match, false otherwise.
     bool replace(std::string& str, const std::string& replacement);
 
 private:
+    // The anchored and literal shapes that dominate the replace_string patterns in
+    // our configs. They are recognized at compile time and executed with a linear
+    // scan (the character class acting as a one-state automaton) instead of
+    // regexec(), which may backtrack. Anything else stays on kPosix.
+    enum class Kind {
+        kPosix,          // general pattern, evaluated with regexec()
+        kLiteral,        // plain substring, no metacharacters
+        kLiteralPrefix,  // ^literal
+        kLiteralSuffix,  // literal$
+        kClassPrefix,    // ^[set]+ or ^[set]*
+        kClassSuffix,    // [set]+$ or [set]*$
+    };
+
+    // Classifies pattern into one of the fast-path kinds, filling mLiteral or
+    // mClassBits. Leaves mKind at kPosix when the shape is not recognized.
+    void classify(const std::string& pattern);
+
+    // Parses a [...] character class starting at pos (at the '[') into mClassBits.
+    // Returns the index just past the closing ']', or std::string::npos if the
+    // class uses features the fast path does not handle.
+    size_t parseCharClass(const std::string& pattern, size_t pos);
+
+    inline bool inClass(char c) const {
+        const uint8_t uc = static_cast<uint8_t>(c);
+        return (mClassBits[uc >> 6] >> (uc & 0x3f)) & 1;
+    }
+
     regex_t mImpl;
+
+    Kind mKind = Kind::kPosix;
+
+    // For the literal kinds: the literal with escapes resolved.
+    std::string mLiteral;
+
+    // For the class kinds: 256-bit membership bitmap of the character class.
+    std::array<uint64_t, 4> mClassBits{};
+
+    // For the class kinds: true for '+' (at least one character), false for '*'.
+    bool mClassMinOne = false;
 };
 
 }  // namespace statsd
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Lightweight systrace/perfetto track-event annotations for statsd's hot
+// paths, so a main-thread stall can be attributed to a specific config,
+// puller or dump when correlated with an app jank trace.
+//
+// While tracing is off each annotation costs one relaxed atomic load; the
+// formatted variant only pays for the snprintf when the tag is actually being
+// recorded. Building with -DSTATSD_DISABLE_ATRACE compiles the annotations
+// out entirely.
+
+#ifndef STATSD_DISABLE_ATRACE
+
+// statsd has no dedicated atrace tag; the system_server ("ss") category is
+// the one enabled when investigating platform-side jank, which is when these
+// slices are wanted next to the framework's own.
+#define ATRACE_TAG ATRACE_TAG_SYSTEM_SERVER
+#include <cutils/compiler.h>
+#include <cutils/trace.h>
+#include <stdio.h>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Emits a track event (slice) covering the enclosing scope.
+class ScopedStatsTrace {
+public:
+    explicit ScopedStatsTrace(const char* name)
+        : mActive(CC_UNLIKELY(atrace_is_tag_enabled(ATRACE_TAG))) {
+        if (mActive) {
+            atrace_begin(ATRACE_TAG, name);
+        }
+    }
+
+    ScopedStatsTrace(const char* prefix, int64_t id)
+        : mActive(CC_UNLIKELY(atrace_is_tag_enabled(ATRACE_TAG))) {
+        if (mActive) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s %lld", prefix, (long long)id);
+            atrace_begin(ATRACE_TAG, name);
+        }
+    }
+
+    ~ScopedStatsTrace() {
+        if (mActive) {
+            atrace_end(ATRACE_TAG);
+        }
+    }
+
+    ScopedStatsTrace(const ScopedStatsTrace&) = delete;
+    ScopedStatsTrace& operator=(const ScopedStatsTrace&) = delete;
+
+private:
+    const bool mActive;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+
+#define STATSD_TRACE_PASTE2(a, b) a##b
+#define STATSD_TRACE_PASTE(a, b) STATSD_TRACE_PASTE2(a, b)
+
+// Slice with a constant name covering the enclosing scope.
+#define STATSD_TRACE_SCOPE(name) \
+    ::android::os::statsd::ScopedStatsTrace STATSD_TRACE_PASTE(statsTrace, __LINE__)(name)
+
+// Slice named "<prefix> <id>", e.g. per config id or per pulled atom id.
+#define STATSD_TRACE_SCOPE_ID(prefix, id) \
+    ::android::os::statsd::ScopedStatsTrace STATSD_TRACE_PASTE(statsTrace, __LINE__)(prefix, id)
+
+#else  // STATSD_DISABLE_ATRACE
+
+#define STATSD_TRACE_SCOPE(name)
+#define STATSD_TRACE_SCOPE_ID(prefix, id)
+
+#endif  // STATSD_DISABLE_ATRACE
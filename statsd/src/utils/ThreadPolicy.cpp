@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "ThreadPolicy.h"
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "flags/FlagProvider.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+// Baseline and escalated nice levels per role. The reader runs slightly above
+// default so bursts are drained promptly; background writes yield to everything.
+constexpr int kEventReaderNice = -2;
+constexpr int kEventReaderEscalatedNice = -10;
+constexpr int kParseWorkerNice = 0;
+constexpr int kBackgroundWorkerNice = 10;
+
+constexpr char kDefaultEscalateDepth[] = "500";
+
+}  // namespace
+
+ThreadPolicy& ThreadPolicy::getInstance() {
+    static ThreadPolicy* sPolicy = new ThreadPolicy();
+    return *sPolicy;
+}
+
+ThreadPolicy::ThreadPolicy() {
+    mEnabled = FlagProvider::getInstance().getBootFlagBool(THREAD_POLICY_ENABLED_FLAG, FLAG_FALSE);
+    uint32_t escalateDepth;
+    if (!android::base::ParseUint(FlagProvider::getInstance().getBootFlagString(
+                                          THREAD_POLICY_ESCALATE_DEPTH_FLAG, kDefaultEscalateDepth),
+                                  &escalateDepth) ||
+        escalateDepth == 0) {
+        android::base::ParseUint(kDefaultEscalateDepth, &escalateDepth);
+    }
+    mEscalateDepth = escalateDepth;
+    mRestoreDepth = std::max<size_t>(1, mEscalateDepth / 4);
+    if (mEnabled) {
+        readCoreTopology();
+    }
+}
+
+void ThreadPolicy::readCoreTopology() {
+    CPU_ZERO(&mBigCores);
+    CPU_ZERO(&mLittleCores);
+    CPU_ZERO(&mAllCores);
+
+    const long cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+    if (cpuCount <= 0 || cpuCount > CPU_SETSIZE) {
+        return;
+    }
+
+    std::vector<uint32_t> capacities((size_t)cpuCount, 0);
+    uint32_t maxCapacity = 0;
+    bool haveCapacities = true;
+    for (long cpu = 0; cpu < cpuCount; cpu++) {
+        CPU_SET(cpu, &mAllCores);
+        std::string contents;
+        if (!android::base::ReadFileToString(
+                    android::base::StringPrintf("/sys/devices/system/cpu/cpu%ld/cpu_capacity",
+                                                cpu),
+                    &contents) ||
+            !android::base::ParseUint(android::base::Trim(contents), &capacities[cpu])) {
+            haveCapacities = false;
+            break;
+        }
+        maxCapacity = std::max(maxCapacity, capacities[cpu]);
+    }
+    if (!haveCapacities) {
+        return;
+    }
+
+    for (long cpu = 0; cpu < cpuCount; cpu++) {
+        if (capacities[cpu] == maxCapacity) {
+            CPU_SET(cpu, &mBigCores);
+        } else {
+            CPU_SET(cpu, &mLittleCores);
+        }
+    }
+    // All cores equal (symmetric SoC): leave affinity alone entirely.
+    mHasAsymmetricCores = CPU_COUNT(&mLittleCores) > 0;
+}
+
+void ThreadPolicy::setAffinity(const cpu_set_t& cores) const {
+    if (sched_setaffinity(0 /* self */, sizeof(cpu_set_t), &cores) != 0) {
+        VLOG("sched_setaffinity failed: %s", strerror(errno));
+    }
+}
+
+void ThreadPolicy::setNice(int nice) const {
+    if (setpriority(PRIO_PROCESS, 0 /* self */, nice) != 0) {
+        VLOG("setpriority(%d) failed: %s", nice, strerror(errno));
+    }
+}
+
+void ThreadPolicy::applyRole(ThreadRole role) {
+    if (!mEnabled) {
+        return;
+    }
+    switch (role) {
+        case ThreadRole::EVENT_READER:
+            setNice(kEventReaderNice);
+            if (mHasAsymmetricCores) {
+                setAffinity(mAllCores);
+            }
+            break;
+        case ThreadRole::PARSE_WORKER:
+            setNice(kParseWorkerNice);
+            break;
+        case ThreadRole::BACKGROUND_WORKER:
+            setNice(kBackgroundWorkerNice);
+            if (mHasAsymmetricCores) {
+                setAffinity(mLittleCores);
+            }
+            break;
+    }
+}
+
+void ThreadPolicy::noteEventReaderQueueDepth(size_t depth) {
+    if (!mEnabled) {
+        return;
+    }
+    if (!mReaderEscalated && depth >= mEscalateDepth) {
+        setNice(kEventReaderEscalatedNice);
+        if (mHasAsymmetricCores) {
+            setAffinity(mBigCores);
+        }
+        mReaderEscalated = true;
+    } else if (mReaderEscalated && depth <= mRestoreDepth) {
+        setNice(kEventReaderNice);
+        if (mHasAsymmetricCores) {
+            setAffinity(mAllCores);
+        }
+        mReaderEscalated = false;
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sched.h>
+
+#include <cstddef>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Roles for statsd's long-lived threads. A role names what the thread does for
+ * the pipeline so scheduling policy can be decided in one place instead of at
+ * each std::thread call site.
+ */
+enum class ThreadRole {
+    // Drains the LogEventQueue and drives the metric pipeline (StatsService::readLogs).
+    EVENT_READER,
+    // LogEventParsePool workers materializing deferred event bodies.
+    PARSE_WORKER,
+    // WorkerPool / SubscriberDispatcher / DispatchQueue threads doing storage writes,
+    // fan-out and deferred binder work.
+    BACKGROUND_WORKER,
+};
+
+/**
+ * Registry applying core affinity and nice levels per thread role. On
+ * asymmetric (big.LITTLE) SoCs the default scheduler regularly parks the event
+ * reader on a little core during bursts, inflating queue latency; this pins
+ * background work to the little cores and lets the reader escalate onto the
+ * big cores while the ingestion backlog is deep.
+ *
+ * Core topology is read from /sys cpu_capacity at first use; on symmetric CPUs
+ * every affinity call is a no-op and only nice levels apply. The whole policy
+ * is behind the thread_policy_enabled boot flag and defaults to off.
+ */
+class ThreadPolicy {
+public:
+    static ThreadPolicy& getInstance();
+
+    // Applies the role's baseline policy to the calling thread. Call once from
+    // the thread's entry point.
+    void applyRole(ThreadRole role);
+
+    // Event-reader hook, called with the size of each drained batch: moves the
+    // calling thread onto the big cores while the backlog stays at or above the
+    // escalation threshold and restores the baseline once it subsides. Cheap
+    // when nothing changes state.
+    void noteEventReaderQueueDepth(size_t depth);
+
+private:
+    ThreadPolicy();
+
+    void readCoreTopology();
+    void setAffinity(const cpu_set_t& cores) const;
+    void setNice(int nice) const;
+
+    bool mEnabled = false;
+    size_t mEscalateDepth;
+    size_t mRestoreDepth;
+
+    // Populated by readCoreTopology(); mHasAsymmetricCores stays false on
+    // symmetric CPUs and affinity calls become no-ops.
+    bool mHasAsymmetricCores = false;
+    cpu_set_t mBigCores;
+    cpu_set_t mLittleCores;
+    cpu_set_t mAllCores;
+
+    // Only the single event-reader thread touches this.
+    bool mReaderEscalated = false;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// UTF-8 validation and sanitization for incoming string fields.
+//
+// String payloads are validated once at parse time; everything stored in a
+// FieldValue afterwards is guaranteed well-formed UTF-8, so serialization and
+// shell subscribers never need per-character checks. The common case - ASCII
+// package, class and tag names - is handled by a SWAR scan that tests eight
+// bytes per iteration for a set high bit.
+
+namespace internal {
+
+// Returns the length (1-4) of the well-formed UTF-8 sequence starting at
+// data[i], or 0 if the sequence is malformed or truncated. Rejects overlong
+// encodings, surrogate code points (U+D800..U+DFFF) and values above U+10FFFF.
+inline size_t utf8SequenceLength(const uint8_t* data, size_t len, size_t i) {
+    const uint8_t lead = data[i];
+    if (lead < 0x80) {
+        return 1;
+    }
+    if (lead < 0xc2) {
+        // 0x80..0xbf: stray continuation byte. 0xc0/0xc1: overlong 2-byte form.
+        return 0;
+    }
+    if (lead < 0xe0) {
+        if (i + 1 >= len || (data[i + 1] & 0xc0) != 0x80) return 0;
+        return 2;
+    }
+    if (lead < 0xf0) {
+        if (i + 2 >= len || (data[i + 1] & 0xc0) != 0x80 || (data[i + 2] & 0xc0) != 0x80) {
+            return 0;
+        }
+        if (lead == 0xe0 && data[i + 1] < 0xa0) return 0;  // overlong
+        if (lead == 0xed && data[i + 1] >= 0xa0) return 0;  // surrogate
+        return 3;
+    }
+    if (lead < 0xf5) {
+        if (i + 3 >= len || (data[i + 1] & 0xc0) != 0x80 || (data[i + 2] & 0xc0) != 0x80 ||
+            (data[i + 3] & 0xc0) != 0x80) {
+            return 0;
+        }
+        if (lead == 0xf0 && data[i + 1] < 0x90) return 0;  // overlong
+        if (lead == 0xf4 && data[i + 1] >= 0x90) return 0;  // above U+10FFFF
+        return 4;
+    }
+    return 0;  // 0xf5..0xff can never appear in UTF-8
+}
+
+}  // namespace internal
+
+// Returns true if [data, data + len) is well-formed UTF-8. Runs of ASCII are
+// skipped eight bytes at a time.
+inline bool isValidUtf8(const char* data, size_t len) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    size_t i = 0;
+    while (i < len) {
+        while (i + 8 <= len) {
+            uint64_t chunk;
+            memcpy(&chunk, bytes + i, 8);
+            if (chunk & 0x8080808080808080ull) break;
+            i += 8;
+        }
+        if (i >= len) break;
+        const size_t seqLen = internal::utf8SequenceLength(bytes, len, i);
+        if (seqLen == 0) return false;
+        i += seqLen;
+    }
+    return true;
+}
+
+// Replaces each byte that is not part of a well-formed UTF-8 sequence with
+// '?', in place. The result is always valid UTF-8 of the same length.
+inline void sanitizeUtf8(std::string& str) {
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(str.data());
+    const size_t len = str.size();
+    size_t i = 0;
+    while (i < len) {
+        const size_t seqLen = internal::utf8SequenceLength(bytes, len, i);
+        if (seqLen == 0) {
+            bytes[i] = '?';
+            i++;
+        } else {
+            i += seqLen;
+        }
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
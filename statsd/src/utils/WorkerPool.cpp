@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "WorkerPool.h"
+
+#include "guardrail/StatsdStats.h"
+#include "utils/ThreadPolicy.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+WorkerPool& WorkerPool::getInstance() {
+    static WorkerPool sWorkerPool;
+    return sWorkerPool;
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShuttingDown = true;
+    }
+    mTaskAdded.notify_all();
+    for (std::thread& worker : mWorkers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void WorkerPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back(std::move(task));
+        StatsdStats::getInstance().noteWorkerPoolQueueDepth(mTasks.size());
+        if (mIdleWorkers == 0 && mWorkers.size() < kMaxWorkers) {
+            VLOG("WorkerPool starting worker %zu", mWorkers.size());
+            mWorkers.emplace_back([this] { workerLoop(); });
+        }
+    }
+    mTaskAdded.notify_one();
+}
+
+void WorkerPool::workerLoop() {
+    ThreadPolicy::getInstance().applyRole(ThreadRole::BACKGROUND_WORKER);
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        while (mTasks.empty() && !mShuttingDown) {
+            mIdleWorkers++;
+            mTaskAdded.wait(lock);
+            mIdleWorkers--;
+        }
+        if (mTasks.empty()) {
+            return;
+        }
+        std::function<void()> task = std::move(mTasks.front());
+        mTasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Small shared worker pool for short-lived background tasks, such as trigger
+ * execution and write-behind disk flushes.
+ *
+ * Worker threads are started lazily on first use and kept for the lifetime of
+ * the process, so scheduling a task is a queue push instead of a std::thread
+ * spawn on the caller's critical path.
+ */
+class WorkerPool {
+public:
+    static WorkerPool& getInstance();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool();
+
+    // Schedules the task to run on a worker thread. Tasks may run concurrently
+    // and complete in any order relative to each other; callers that need
+    // completion ordering must synchronize within their tasks.
+    void enqueue(std::function<void()> task);
+
+private:
+    WorkerPool() = default;
+
+    void workerLoop();
+
+    mutable std::mutex mMutex;
+
+    std::condition_variable mTaskAdded;
+
+    std::deque<std::function<void()>> mTasks;
+
+    std::vector<std::thread> mWorkers;
+
+    size_t mIdleWorkers = 0;
+
+    bool mShuttingDown = false;
+
+    // Tasks are rare and short; two workers keep one slow disk write from
+    // delaying a trigger without burning idle threads.
+    static constexpr size_t kMaxWorkers = 2;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
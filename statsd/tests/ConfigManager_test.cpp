@@ -132,6 +132,47 @@ TEST(ConfigManagerTest, TestAddUpdateRemove) {
     }
 }
 
+/**
+ * Test that a byte-identical re-push is recognized in memory as a duplicate
+ * and does not re-notify listeners.
+ */
+TEST(ConfigManagerTest, TestDuplicateConfigPushSkipsListeners) {
+    sp<MockListener> listener = new StrictMock<MockListener>();
+
+    sp<ConfigManager> manager = new ConfigManager();
+    manager->AddListener(listener);
+    manager->StartupForTest();
+
+    StatsdConfig config;
+    config.set_id(91);
+
+    EXPECT_CALL(*(listener.get()),
+                OnConfigUpdated(_, ConfigKeyEq(1, StringToId("zzz")), StatsdConfigEq(91), true))
+            .Times(1);
+    manager->UpdateConfig(ConfigKey(1, StringToId("zzz")), config);
+    // Identical bytes: the content hash matches, listeners are not re-notified.
+    manager->UpdateConfig(ConfigKey(1, StringToId("zzz")), config);
+
+    // Different bytes for the same key notify again.
+    config.set_id(92);
+    EXPECT_CALL(*(listener.get()),
+                OnConfigUpdated(_, ConfigKeyEq(1, StringToId("zzz")), StatsdConfigEq(92), true))
+            .Times(1);
+    manager->UpdateConfig(ConfigKey(1, StringToId("zzz")), config);
+
+    EXPECT_CALL(*(listener.get()), OnConfigRemoved(ConfigKeyEq(1, StringToId("zzz"))));
+    manager->RemoveConfig(ConfigKey(1, StringToId("zzz")));
+
+    // Removal forgets the hash, so a re-push of the same bytes notifies again.
+    EXPECT_CALL(*(listener.get()),
+                OnConfigUpdated(_, ConfigKeyEq(1, StringToId("zzz")), StatsdConfigEq(92), true))
+            .Times(1);
+    manager->UpdateConfig(ConfigKey(1, StringToId("zzz")), config);
+
+    EXPECT_CALL(*(listener.get()), OnConfigRemoved(ConfigKeyEq(1, StringToId("zzz"))));
+    manager->RemoveConfig(ConfigKey(1, StringToId("zzz")));
+}
+
 /**
  * Test removing all of the configs for a uid.
  */
@@ -479,6 +479,236 @@ TEST(AtomMatcherTest, TestMetric2ConditionLink) {
     EXPECT_EQ((int32_t)27, link.conditionFields[0].mMatcher.getTag());
 }
 
+TEST(AtomMatcherTest, TestFilterValuesFusedMatchesSeparatePasses) {
+    std::vector<int> attributionUids = {1111, 2222, 3333};
+    std::vector<string> attributionTags = {"location1", "location2", "location3"};
+
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event, 10 /*atomId*/, 12345, attributionUids, attributionTags, "some value");
+
+    FieldMatcher whatMatcher;
+    whatMatcher.set_field(10);
+    FieldMatcher* child = whatMatcher.add_child();
+    child->set_field(1);
+    child->set_position(Position::FIRST);
+    child->add_child()->set_field(1);
+
+    std::vector<Matcher> dimensionMatchers;
+    translateFieldMatcher(whatMatcher, &dimensionMatchers);
+
+    FieldMatcher conditionMatcher;
+    conditionMatcher.set_field(27);
+    FieldMatcher* conditionChild = conditionMatcher.add_child();
+    conditionChild->set_field(2);
+    conditionChild->set_position(Position::LAST);
+    conditionChild->add_child()->set_field(2);
+
+    Metric2Condition conditionLink;
+    conditionLink.conditionId = 0x1234567890;
+    translateFieldMatcher(whatMatcher, &conditionLink.metricFields);
+    translateFieldMatcher(conditionMatcher, &conditionLink.conditionFields);
+
+    Metric2State stateLink;
+    stateLink.stateAtomId = 27;
+    translateFieldMatcher(whatMatcher, &stateLink.metricFields);
+    FieldMatcher stateMatcher = whatMatcher;
+    stateMatcher.set_field(stateLink.stateAtomId);
+    translateFieldMatcher(stateMatcher, &stateLink.stateFields);
+
+    // Reference results from the per-pass helpers.
+    HashableDimensionKey expectedDimension;
+    filterValues(dimensionMatchers, event.getValues(), &expectedDimension);
+    HashableDimensionKey expectedConditionDimension;
+    getDimensionForCondition(event.getValues(), conditionLink, &expectedConditionDimension);
+    HashableDimensionKey expectedStatePrimaryKey;
+    getDimensionForState(event.getValues(), stateLink, &expectedStatePrimaryKey);
+
+    HashableDimensionKey dimension;
+    std::map<int64_t, HashableDimensionKey> conditionDimensions;
+    std::map<int32_t, HashableDimensionKey> statePrimaryKeys;
+    filterValuesFused(dimensionMatchers, {conditionLink}, {stateLink}, event.getValues(),
+                      &dimension, &conditionDimensions, &statePrimaryKeys);
+
+    EXPECT_EQ(expectedDimension, dimension);
+    ASSERT_EQ((size_t)1, conditionDimensions.size());
+    EXPECT_EQ(expectedConditionDimension, conditionDimensions[conditionLink.conditionId]);
+    ASSERT_EQ((size_t)1, statePrimaryKeys.size());
+    EXPECT_EQ(expectedStatePrimaryKey, statePrimaryKeys[stateLink.stateAtomId]);
+
+    // Empty link lists with null output maps are a no-op for the maps.
+    HashableDimensionKey dimensionOnly;
+    filterValuesFused(dimensionMatchers, {}, {}, event.getValues(), &dimensionOnly, nullptr,
+                      nullptr);
+    EXPECT_EQ(expectedDimension, dimensionOnly);
+}
+
+TEST(AtomMatcherTest, TestFieldExtractionPlanMatchesFilterValues) {
+    std::vector<int> attributionUids = {1111, 2222, 3333};
+    std::vector<string> attributionTags = {"location1", "location2", "location3"};
+
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event, 10 /*atomId*/, 12345, attributionUids, attributionTags, "some value");
+
+    // Top level field: cacheable, so the second extract replays the recorded indices.
+    FieldMatcher topLevelMatcher;
+    topLevelMatcher.set_field(10);
+    topLevelMatcher.add_child()->set_field(2);
+
+    std::vector<Matcher> matchers;
+    translateFieldMatcher(topLevelMatcher, &matchers);
+
+    HashableDimensionKey expected;
+    EXPECT_TRUE(filterValues(matchers, event.getValues(), &expected));
+
+    FieldExtractionPlan plan(matchers);
+    HashableDimensionKey firstPass;
+    EXPECT_TRUE(plan.extract(event.getValues(), &firstPass));
+    EXPECT_EQ(expected, firstPass);
+
+    HashableDimensionKey replayed;
+    EXPECT_TRUE(plan.extract(event.getValues(), &replayed));
+    EXPECT_EQ(expected, replayed);
+
+    // An event of another atom has a different layout; the plan must not replay across tags.
+    LogEvent otherEvent(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&otherEvent, 4 /*atomId*/, 12345, attributionUids, attributionTags, 999);
+    HashableDimensionKey noMatch;
+    EXPECT_FALSE(plan.extract(otherEvent.getValues(), &noMatch));
+    ASSERT_EQ((size_t)0, noMatch.getValues().size());
+
+    // Attribution chain positions vary per event, so this matcher set always scans generically.
+    FieldMatcher chainMatcher;
+    chainMatcher.set_field(10);
+    FieldMatcher* child = chainMatcher.add_child();
+    child->set_field(1);
+    child->set_position(Position::FIRST);
+    child->add_child()->set_field(1);
+
+    std::vector<Matcher> chainMatchers;
+    translateFieldMatcher(chainMatcher, &chainMatchers);
+
+    HashableDimensionKey expectedChain;
+    EXPECT_TRUE(filterValues(chainMatchers, event.getValues(), &expectedChain));
+
+    FieldExtractionPlan chainPlan(chainMatchers);
+    HashableDimensionKey chainOutput;
+    EXPECT_TRUE(chainPlan.extract(event.getValues(), &chainOutput));
+    EXPECT_EQ(expectedChain, chainOutput);
+}
+
+TEST(AtomMatcherTest, TestValueIndexPlanResolvesDirectIndices) {
+    std::vector<int> attributionUids = {1111, 2222, 3333};
+    std::vector<string> attributionTags = {"location1", "location2", "location3"};
+
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event, 10 /*atomId*/, 12345, attributionUids, attributionTags, "some value");
+
+    // Top level field: cacheable, so the second resolve replays the recorded indices.
+    FieldMatcher topLevelMatcher;
+    topLevelMatcher.set_field(10);
+    topLevelMatcher.add_child()->set_field(2);
+
+    std::vector<Matcher> matchers;
+    translateFieldMatcher(topLevelMatcher, &matchers);
+
+    // Reference index from the generic scan.
+    const std::vector<FieldValue>& values = event.getValues();
+    int32_t expectedIndex = -1;
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i].mField.matches(matchers[0])) {
+            expectedIndex = (int32_t)i;
+            break;
+        }
+    }
+    ASSERT_NE(-1, expectedIndex);
+
+    ValueIndexPlan plan(matchers);
+    std::vector<int32_t> indices;
+    plan.resolve(values, indices);
+    ASSERT_EQ((size_t)1, indices.size());
+    EXPECT_EQ(expectedIndex, indices[0]);
+
+    std::vector<int32_t> replayed;
+    plan.resolve(values, replayed);
+    ASSERT_EQ((size_t)1, replayed.size());
+    EXPECT_EQ(expectedIndex, replayed[0]);
+
+    // An event of another atom has a different layout; the plan must not replay across tags.
+    LogEvent otherEvent(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&otherEvent, 4 /*atomId*/, 12345, attributionUids, attributionTags, 999);
+    std::vector<int32_t> noMatch;
+    plan.resolve(otherEvent.getValues(), noMatch);
+    ASSERT_EQ((size_t)1, noMatch.size());
+    EXPECT_EQ(-1, noMatch[0]);
+}
+
+TEST(AtomMatcherTest, TestConditionLinkPlanMatchesGetDimensionForCondition) {
+    std::vector<int> attributionUids = {1111, 2222, 3333};
+    std::vector<string> attributionTags = {"location1", "location2", "location3"};
+
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event, 10 /*atomId*/, 12345, attributionUids, attributionTags, "some value");
+
+    // Top level link field: cacheable, so the second resolve replays the gather plan.
+    FieldMatcher whatMatcher;
+    whatMatcher.set_field(10);
+    whatMatcher.add_child()->set_field(2);
+
+    FieldMatcher conditionMatcher;
+    conditionMatcher.set_field(27);
+    conditionMatcher.add_child()->set_field(2);
+
+    Metric2Condition link;
+    link.conditionId = 0x1234567890;
+    translateFieldMatcher(whatMatcher, &link.metricFields);
+    translateFieldMatcher(conditionMatcher, &link.conditionFields);
+
+    HashableDimensionKey expected;
+    getDimensionForCondition(event.getValues(), link, &expected);
+
+    ConditionLinkPlan plan(link);
+    HashableDimensionKey firstPass;
+    plan.resolve(event.getValues(), &firstPass);
+    EXPECT_EQ(expected, firstPass);
+
+    HashableDimensionKey replayed;
+    plan.resolve(event.getValues(), &replayed);
+    EXPECT_EQ(expected, replayed);
+    ASSERT_EQ((size_t)1, replayed.getValues().size());
+    EXPECT_EQ(27, replayed.getValues()[0].mField.getTag());
+
+    // An event of another atom has a different layout; the plan must not replay across tags.
+    LogEvent otherEvent(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&otherEvent, 4 /*atomId*/, 12345, attributionUids, attributionTags, 999);
+    HashableDimensionKey noMatch;
+    plan.resolve(otherEvent.getValues(), &noMatch);
+    ASSERT_EQ((size_t)0, noMatch.getValues().size());
+
+    // Attribution chain link fields sit below the top level, so the plan always
+    // delegates to the generic resolution.
+    FieldMatcher chainWhatMatcher;
+    chainWhatMatcher.set_field(10);
+    FieldMatcher* child = chainWhatMatcher.add_child();
+    child->set_field(1);
+    child->set_position(Position::FIRST);
+    child->add_child()->set_field(1);
+
+    Metric2Condition chainLink;
+    chainLink.conditionId = 0x1234567891;
+    translateFieldMatcher(chainWhatMatcher, &chainLink.metricFields);
+    FieldMatcher chainConditionMatcher = chainWhatMatcher;
+    chainConditionMatcher.set_field(27);
+    translateFieldMatcher(chainConditionMatcher, &chainLink.conditionFields);
+
+    HashableDimensionKey expectedChain;
+    getDimensionForCondition(event.getValues(), chainLink, &expectedChain);
+
+    ConditionLinkPlan chainPlan(chainLink);
+    HashableDimensionKey chainOutput;
+    chainPlan.resolve(event.getValues(), &chainOutput);
+    EXPECT_EQ(expectedChain, chainOutput);
+}
+
 TEST(AtomMatcherTest, TestWriteDimensionPath) {
     for (auto position : {Position::ALL, Position::FIRST, Position::LAST}) {
         FieldMatcher matcher1;
@@ -1200,6 +1430,47 @@ TEST(FieldValueTest, TestShouldKeepSampleByteArray) {
     EXPECT_TRUE(shouldKeepSample(fieldValue2, shardOffset, shardCount));
 }
 
+TEST(FieldValueTest, TestInternedStringValueSemantics) {
+    Value value("some string");
+    EXPECT_EQ(STRING, value.getType());
+    EXPECT_EQ("some string", value.mValue.str_value);
+
+    // Copies compare equal to each other and to the payload, and survive the
+    // original going away.
+    Value copy(value);
+    EXPECT_EQ(value, copy);
+    {
+        Value scoped("scoped string");
+        copy = scoped;
+    }
+    EXPECT_EQ("scoped string", copy.mValue.str_value);
+    EXPECT_NE(value, copy);
+
+    // Ordering still follows the payload, not the intern ids.
+    Value apple("apple");
+    Value banana("banana");
+    EXPECT_TRUE(apple < banana);
+    EXPECT_TRUE(banana > apple);
+
+    // Values parsed from different events with equal payloads compare equal.
+    Value other("some string");
+    EXPECT_EQ(value, other);
+}
+
+TEST(FieldValueTest, TestInternedStorageValueSemantics) {
+    vector<uint8_t> bytes = {1, 2, 3, 0, 5};
+    Value value(bytes);
+    EXPECT_EQ(STORAGE, value.getType());
+    EXPECT_EQ(bytes, value.mValue.storage_value);
+
+    Value copy(value);
+    EXPECT_EQ(value, copy);
+    EXPECT_EQ(bytes.size(), value.mValue.storage_value.size());
+
+    Value different(vector<uint8_t>{1, 2, 3});
+    EXPECT_NE(value, different);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
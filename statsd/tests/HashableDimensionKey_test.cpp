@@ -17,6 +17,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "src/statsd_config.pb.h"
 #include "statsd_test_util.h"
 
@@ -164,6 +166,137 @@ TEST(HashableDimensionKeyTest, TestHashDimensionDouble) {
               std::hash<HashableDimensionKey>{}(dimKey2));
 }
 
+/**
+ * Test that the memoized hash matches hashDimension and is invalidated by mutation.
+ */
+TEST(HashableDimensionKeyTest, TestCachedHashInvalidatedOnMutation) {
+    int pos[] = {1, 1, 1};
+    Field field(1, pos, 1);
+    HashableDimensionKey dimKey;
+    dimKey.addValue(FieldValue(field, Value((int32_t)1000)));
+
+    EXPECT_EQ(dimKey.getHash(), hashDimension(dimKey));
+    // A second call returns the memoized value.
+    EXPECT_EQ(dimKey.getHash(), hashDimension(dimKey));
+
+    // Mutating the key through any of the mutable accessors must invalidate the cache.
+    dimKey.mutableValue(0)->mValue.setInt(2000);
+    EXPECT_EQ(dimKey.getHash(), hashDimension(dimKey));
+
+    dimKey.addValue(FieldValue(field, Value((int32_t)3000)));
+    EXPECT_EQ(dimKey.getHash(), hashDimension(dimKey));
+
+    // Equal keys with memoized hashes still compare equal.
+    HashableDimensionKey copy(dimKey);
+    EXPECT_EQ(copy.getHash(), dimKey.getHash());
+    EXPECT_TRUE(copy == dimKey);
+}
+
+/**
+ * Test that interning makes equal keys share storage and that mutation copies on write.
+ */
+TEST(HashableDimensionKeyTest, TestInternSharesStorage) {
+    int pos[] = {1, 1, 1};
+    Field field(1, pos, 1);
+
+    HashableDimensionKey key1;
+    key1.addValue(FieldValue(field, Value((int32_t)1000)));
+    HashableDimensionKey key2;
+    key2.addValue(FieldValue(field, Value((int32_t)1000)));
+
+    // Independently built keys have separate storage.
+    EXPECT_NE(&key1.getValues(), &key2.getValues());
+
+    key1.intern();
+    key2.intern();
+    EXPECT_EQ(&key1.getValues(), &key2.getValues());
+    EXPECT_TRUE(key1 == key2);
+
+    // Copies of an interned key keep sharing the canonical storage.
+    HashableDimensionKey copy(key1);
+    EXPECT_EQ(&copy.getValues(), &key1.getValues());
+
+    // Mutation detaches the mutated key without touching the other users.
+    copy.mutableValue(0)->mValue.setInt(2000);
+    EXPECT_NE(&copy.getValues(), &key1.getValues());
+    EXPECT_EQ(1000, key1.getValues()[0].mValue.int_value);
+    EXPECT_EQ(2000, copy.getValues()[0].mValue.int_value);
+
+    // An empty key interns to no storage and stays equal to the default key.
+    HashableDimensionKey emptyKey;
+    emptyKey.intern();
+    EXPECT_TRUE(emptyKey == DEFAULT_DIMENSION_KEY);
+}
+
+/**
+ * Test that typed comparator bundles exist exactly for all-INT keys of supported arity.
+ */
+TEST(HashableDimensionKeyTest, TestSelectDimensionKeyOps) {
+    int pos[] = {1, 1, 1};
+    Field field(1, pos, 1);
+
+    HashableDimensionKey intKey;
+    for (size_t arity = 1; arity <= kMaxTypedDimensionOpsArity; arity++) {
+        intKey.addValue(FieldValue(field, Value((int32_t)arity)));
+        EXPECT_NE(nullptr, selectDimensionKeyOps(intKey.getTypeSignature()));
+    }
+    // One value beyond the instantiated arities falls back to the generic path.
+    intKey.addValue(FieldValue(field, Value((int32_t)0)));
+    EXPECT_EQ(nullptr, selectDimensionKeyOps(intKey.getTypeSignature()));
+
+    // Any non-INT value disqualifies the key.
+    HashableDimensionKey mixedKey;
+    mixedKey.addValue(FieldValue(field, Value((int32_t)1000)));
+    mixedKey.addValue(FieldValue(field, Value(std::string("proc"))));
+    EXPECT_EQ(nullptr, selectDimensionKeyOps(mixedKey.getTypeSignature()));
+
+    // The empty key has no bundle either.
+    EXPECT_EQ(nullptr, selectDimensionKeyOps(DEFAULT_DIMENSION_KEY.getTypeSignature()));
+}
+
+/**
+ * Test that typed comparisons of all-INT keys agree with the generic FieldValue ordering.
+ */
+TEST(HashableDimensionKeyTest, TestTypedIntKeyOpsMatchGenericSemantics) {
+    int pos[] = {1, 1, 1};
+    Field field(1, pos, 1);
+
+    for (size_t arity = 1; arity <= kMaxTypedDimensionOpsArity + 1; arity++) {
+        HashableDimensionKey key;
+        HashableDimensionKey sameKey;
+        HashableDimensionKey biggerKey;
+        for (size_t i = 0; i < arity; i++) {
+            const int32_t value = (int32_t)(1000 + i);
+            key.addValue(FieldValue(field, Value(value)));
+            sameKey.addValue(FieldValue(field, Value(value)));
+            biggerKey.addValue(
+                    FieldValue(field, Value(i == arity - 1 ? (int32_t)9999 : value)));
+        }
+
+        EXPECT_TRUE(key == sameKey);
+        EXPECT_EQ(key.getHash(), sameKey.getHash());
+        EXPECT_FALSE(key == biggerKey);
+        EXPECT_FALSE(key < sameKey);
+        EXPECT_FALSE(sameKey < key);
+        EXPECT_TRUE(key < biggerKey);
+        EXPECT_FALSE(biggerKey < key);
+        EXPECT_EQ(key < biggerKey,
+                  std::lexicographical_compare(key.getValues().begin(), key.getValues().end(),
+                                               biggerKey.getValues().begin(),
+                                               biggerKey.getValues().end()));
+    }
+
+    // Mutating a value's type must reroute the key off the typed path.
+    HashableDimensionKey key;
+    key.addValue(FieldValue(field, Value((int32_t)1000)));
+    EXPECT_NE(nullptr, selectDimensionKeyOps(key.getTypeSignature()));
+    key.mutableValue(0)->mValue = Value(std::string("proc"));
+    EXPECT_EQ(nullptr, selectDimensionKeyOps(key.getTypeSignature()));
+    HashableDimensionKey stringKey;
+    stringKey.addValue(FieldValue(field, Value(std::string("proc"))));
+    EXPECT_TRUE(key == stringKey);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -159,6 +159,48 @@ TEST(AtomMatcherTest, TestSimpleMatcher) {
     EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
 }
 
+TEST(AtomMatcherTest, TestPositionalIndexMatchesUncachedResults) {
+    sp<UidMap> uidMap = new UidMap();
+
+    // Set up a positional matcher on the first attribution node's tag.
+    AtomMatcher matcher;
+    auto simpleMatcher = matcher.mutable_simple_atom_matcher();
+    simpleMatcher->set_atom_id(TAG_ID);
+    auto attributionMatcher = simpleMatcher->add_field_value_matcher();
+    attributionMatcher->set_field(FIELD_ID_1);
+    attributionMatcher->set_position(Position::FIRST);
+    attributionMatcher->mutable_matches_tuple()->add_field_value_matcher()->set_field(
+            ATTRIBUTION_TAG_FIELD_ID);
+    attributionMatcher->mutable_matches_tuple()->mutable_field_value_matcher(0)->set_eq_string(
+            "location1");
+
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeAttributionLogEvent(&event, TAG_ID, 0, {1111, 2222, 3333},
+                            {"location1", "location2", "location3"}, "some value");
+
+    PositionalIndex positionalIndex;
+    // First evaluation populates the index, the second replays it.
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event, nullptr, &positionalIndex).matched);
+    EXPECT_FALSE(positionalIndex.entries.empty());
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event, nullptr, &positionalIndex).matched);
+
+    // An event with the same layout but different values reuses the cached ranges.
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeAttributionLogEvent(&event2, TAG_ID, 0, {4444, 5555, 6666},
+                            {"location2", "location3", "location1"}, "some value");
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event2, nullptr, &positionalIndex).matched);
+
+    // A shorter attribution chain changes the layout; the index must repopulate and
+    // agree with the uncached evaluation.
+    LogEvent event3(/*uid=*/0, /*pid=*/0);
+    makeAttributionLogEvent(&event3, TAG_ID, 0, {1111}, {"location1"}, "some value");
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event3).matched);
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event3, nullptr, &positionalIndex).matched);
+
+    // And back to the original layout.
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event, nullptr, &positionalIndex).matched);
+}
+
 TEST(AtomMatcherTest, TestAttributionMatcher) {
     sp<UidMap> uidMap = new UidMap();
     std::vector<int> attributionUids = {1111, 2222, 3333};
@@ -638,6 +680,77 @@ TEST(AtomMatcherTest, TestEqAnyStringMatcher) {
     EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
 }
 
+TEST(AtomMatcherTest, TestEqAnyStringMatcherHashSetAcceleration) {
+    sp<UidMap> uidMap = new UidMap();
+
+    std::vector<int> attributionUids = {1067};
+    std::vector<string> attributionTags = {"location1"};
+
+    // Set up the event
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeAttributionLogEvent(&event, TAG_ID, 0, attributionUids, attributionTags, "some value");
+
+    // Set up a matcher whose eq_any_string list is large enough to get a hash set.
+    AtomMatcher matcher;
+    auto simpleMatcher = matcher.mutable_simple_atom_matcher();
+    simpleMatcher->set_atom_id(TAG_ID);
+    auto fieldMatcher = simpleMatcher->add_field_value_matcher();
+    fieldMatcher->set_field(FIELD_ID_2);
+    auto eqStringList = fieldMatcher->mutable_eq_any_string();
+    for (int i = 0; i < kMinStringsForHashSet - 1; i++) {
+        eqStringList->add_str_value("package.name." + std::to_string(i));
+    }
+    eqStringList->add_str_value("some value");
+
+    StringMatcherIndex index = buildStringMatcherIndex(*simpleMatcher);
+    ASSERT_EQ(1u, index.size());
+
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event, &index).matched);
+
+    // The hash set path and the linear fallback must agree on misses too.
+    eqStringList->set_str_value(kMinStringsForHashSet - 1, "some other value");
+    index = buildStringMatcherIndex(*simpleMatcher);
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event, &index).matched);
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+
+    // Lists below the threshold are not indexed and take the linear path.
+    eqStringList->Clear();
+    eqStringList->add_str_value("some value");
+    index = buildStringMatcherIndex(*simpleMatcher);
+    EXPECT_EQ(0u, index.size());
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event, &index).matched);
+}
+
+TEST(AtomMatcherTest, TestNeqAnyStringMatcherHashSetAcceleration) {
+    sp<UidMap> uidMap = new UidMap();
+
+    std::vector<int> attributionUids = {1067};
+    std::vector<string> attributionTags = {"location1"};
+
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeAttributionLogEvent(&event, TAG_ID, 0, attributionUids, attributionTags, "some value");
+
+    AtomMatcher matcher;
+    auto simpleMatcher = matcher.mutable_simple_atom_matcher();
+    simpleMatcher->set_atom_id(TAG_ID);
+    auto fieldMatcher = simpleMatcher->add_field_value_matcher();
+    fieldMatcher->set_field(FIELD_ID_2);
+    auto neqStringList = fieldMatcher->mutable_neq_any_string();
+    for (int i = 0; i < kMinStringsForHashSet; i++) {
+        neqStringList->add_str_value("package.name." + std::to_string(i));
+    }
+
+    StringMatcherIndex index = buildStringMatcherIndex(*simpleMatcher);
+    ASSERT_EQ(1u, index.size());
+
+    // "some value" is not in the deny list.
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event, &index).matched);
+
+    neqStringList->add_str_value("some value");
+    index = buildStringMatcherIndex(*simpleMatcher);
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event, &index).matched);
+}
+
 TEST(AtomMatcherTest, TestBoolMatcher) {
     sp<UidMap> uidMap = new UidMap();
     // Set up the matcher
@@ -1099,7 +1212,7 @@ TEST(AtomMatcherTest, TestAndMatcher) {
     children.push_back(1);
     children.push_back(2);
 
-    vector<MatchingState> matcherResults;
+    MatchingStateBitset matcherResults;
     matcherResults.push_back(MatchingState::kMatched);
     matcherResults.push_back(MatchingState::kNotMatched);
     matcherResults.push_back(MatchingState::kMatched);
@@ -1123,7 +1236,7 @@ TEST(AtomMatcherTest, TestOrMatcher) {
     children.push_back(1);
     children.push_back(2);
 
-    vector<MatchingState> matcherResults;
+    MatchingStateBitset matcherResults;
     matcherResults.push_back(MatchingState::kMatched);
     matcherResults.push_back(MatchingState::kNotMatched);
     matcherResults.push_back(MatchingState::kMatched);
@@ -1145,7 +1258,7 @@ TEST(AtomMatcherTest, TestNotMatcher) {
     vector<int> children;
     children.push_back(0);
 
-    vector<MatchingState> matcherResults;
+    MatchingStateBitset matcherResults;
     matcherResults.push_back(MatchingState::kMatched);
 
     EXPECT_FALSE(combinationMatch(children, operation, matcherResults));
@@ -1163,7 +1276,7 @@ TEST(AtomMatcherTest, TestNandMatcher) {
     children.push_back(0);
     children.push_back(1);
 
-    vector<MatchingState> matcherResults;
+    MatchingStateBitset matcherResults;
     matcherResults.push_back(MatchingState::kMatched);
     matcherResults.push_back(MatchingState::kNotMatched);
 
@@ -1188,7 +1301,7 @@ TEST(AtomMatcherTest, TestNorMatcher) {
     children.push_back(0);
     children.push_back(1);
 
-    vector<MatchingState> matcherResults;
+    MatchingStateBitset matcherResults;
     matcherResults.push_back(MatchingState::kMatched);
     matcherResults.push_back(MatchingState::kNotMatched);
 
@@ -2064,6 +2177,23 @@ TEST(AtomMatcherTest, TestStringReplaceNoop) {
     ASSERT_EQ(transformedEvent, nullptr);
 }
 
+TEST(AtomMatcherTest, TestMatchesTrivially) {
+    // A matcher on the atom id alone matches every event of that atom trivially.
+    sp<EventMatcherWizard> wizard = createEventMatcherWizard(TAG_ID, /*matcherIndex=*/0);
+    EXPECT_TRUE(wizard->matchesTrivially(/*matcherIndex=*/0, TAG_ID));
+    EXPECT_FALSE(wizard->matchesTrivially(/*matcherIndex=*/0, TAG_ID + 1));
+    // Out-of-range matcher indices are conservatively non-trivial.
+    EXPECT_FALSE(wizard->matchesTrivially(/*matcherIndex=*/1, TAG_ID));
+
+    // Any field value matcher forces per-event evaluation.
+    FieldValueMatcher fvm;
+    fvm.set_field(FIELD_ID_1);
+    fvm.set_eq_int(3);
+    sp<EventMatcherWizard> fieldWizard =
+            createEventMatcherWizard(TAG_ID, /*matcherIndex=*/0, {fvm});
+    EXPECT_FALSE(fieldWizard->matchesTrivially(/*matcherIndex=*/0, TAG_ID));
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
@@ -61,10 +61,10 @@ TEST(LogEventFilterTest, TestRemoveNonExistingEmptyFilter) {
     EXPECT_FALSE(filter.isAtomInUse(1));
     LogEventFilter::AtomIdSet emptyAtomIdsSet;
     EXPECT_EQ(0, filter.mTagIdsPerConsumer.size());
-    EXPECT_EQ(0, filter.mLocalTagIds.size());
+    EXPECT_EQ(0, filter.localSetSizeForTest());
     filter.setAtomIds(std::move(emptyAtomIdsSet), reinterpret_cast<LogEventFilter::ConsumerId>(0));
     EXPECT_FALSE(filter.isAtomInUse(1));
-    EXPECT_EQ(0, filter.mLocalTagIds.size());
+    EXPECT_EQ(0, filter.localSetSizeForTest());
     EXPECT_EQ(0, filter.mTagIdsPerConsumer.size());
 }
 
@@ -84,12 +84,12 @@ TEST(LogEventFilterTest, TestNonEmptyFilterFullOverlap) {
     EXPECT_EQ(1, filter.mTagIdsPerConsumer.size());
 
     // inner copy updated only during fetch if required
-    EXPECT_EQ(0, filter.mLocalTagIds.size());
+    EXPECT_EQ(0, filter.localSetSizeForTest());
     const auto sampleIds = generateAtomIds(1, kAtomIdsCount);
     for (const auto& atomId : sampleIds) {
         EXPECT_TRUE(filter.isAtomInUse(atomId));
     }
-    EXPECT_EQ(kAtomIdsCount, filter.mLocalTagIds.size());
+    EXPECT_EQ(kAtomIdsCount, filter.localSetSizeForTest());
 }
 
 TEST(LogEventFilterTest, TestNonEmptyFilterPartialOverlap) {
@@ -124,23 +124,23 @@ TEST(LogEventFilterTest, TestMultipleConsumerOverlapIdsRemoved) {
     filter.setAtomIds(std::move(filterIds1), reinterpret_cast<LogEventFilter::ConsumerId>(0));
     filter.setAtomIds(std::move(filterIds2), reinterpret_cast<LogEventFilter::ConsumerId>(1));
     // inner copy updated only during fetch if required
-    EXPECT_EQ(0, filter.mLocalTagIds.size());
+    EXPECT_EQ(0, filter.localSetSizeForTest());
     const auto sampleIds = generateAtomIds(1, kAtomIdsCount * 2);
     for (const auto& atomId : sampleIds) {
         EXPECT_TRUE(filter.isAtomInUse(atomId));
     }
-    EXPECT_EQ(kAtomIdsCount * 2, filter.mLocalTagIds.size());
+    EXPECT_EQ(kAtomIdsCount * 2, filter.localSetSizeForTest());
     EXPECT_TRUE(testGuaranteedUnusedAtomsNotInUse(filter));
 
     // set empty filter for second consumer
     LogEventFilter::AtomIdSet emptyAtomIdsSet;
     filter.setAtomIds(std::move(emptyAtomIdsSet), reinterpret_cast<LogEventFilter::ConsumerId>(1));
-    EXPECT_EQ(kAtomIdsCount * 2, filter.mLocalTagIds.size());
+    EXPECT_EQ(kAtomIdsCount * 2, filter.localSetSizeForTest());
     for (const auto& atomId : sampleIds) {
         bool const atomInUse = atomId <= kAtomIdsCount;
         EXPECT_EQ(atomInUse, filter.isAtomInUse(atomId));
     }
-    EXPECT_EQ(kAtomIdsCount, filter.mLocalTagIds.size());
+    EXPECT_EQ(kAtomIdsCount, filter.localSetSizeForTest());
     EXPECT_TRUE(testGuaranteedUnusedAtomsNotInUse(filter));
 }
 
@@ -152,34 +152,34 @@ TEST(LogEventFilterTest, TestMultipleConsumerEmptyFilter) {
     filter.setAtomIds(std::move(filterIds2), reinterpret_cast<LogEventFilter::ConsumerId>(1));
     EXPECT_EQ(2, filter.mTagIdsPerConsumer.size());
     // inner copy updated only during fetch if required
-    EXPECT_EQ(0, filter.mLocalTagIds.size());
+    EXPECT_EQ(0, filter.localSetSizeForTest());
     const auto sampleIds = generateAtomIds(1, kAtomIdsCount * 2);
     for (const auto& atomId : sampleIds) {
         EXPECT_TRUE(filter.isAtomInUse(atomId));
     }
-    EXPECT_EQ(kAtomIdsCount * 2, filter.mLocalTagIds.size());
+    EXPECT_EQ(kAtomIdsCount * 2, filter.localSetSizeForTest());
     EXPECT_TRUE(testGuaranteedUnusedAtomsNotInUse(filter));
 
     // set empty filter for first consumer
     LogEventFilter::AtomIdSet emptyAtomIdsSet;
     filter.setAtomIds(emptyAtomIdsSet, reinterpret_cast<LogEventFilter::ConsumerId>(0));
     EXPECT_EQ(1, filter.mTagIdsPerConsumer.size());
-    EXPECT_EQ(kAtomIdsCount * 2, filter.mLocalTagIds.size());
+    EXPECT_EQ(kAtomIdsCount * 2, filter.localSetSizeForTest());
     for (const auto& atomId : sampleIds) {
         bool const atomInUse = atomId > kAtomIdsCount;
         EXPECT_EQ(atomInUse, filter.isAtomInUse(atomId));
     }
-    EXPECT_EQ(kAtomIdsCount, filter.mLocalTagIds.size());
+    EXPECT_EQ(kAtomIdsCount, filter.localSetSizeForTest());
     EXPECT_TRUE(testGuaranteedUnusedAtomsNotInUse(filter));
 
     // set empty filter for second consumer
     filter.setAtomIds(emptyAtomIdsSet, reinterpret_cast<LogEventFilter::ConsumerId>(1));
     EXPECT_EQ(0, filter.mTagIdsPerConsumer.size());
-    EXPECT_EQ(kAtomIdsCount, filter.mLocalTagIds.size());
+    EXPECT_EQ(kAtomIdsCount, filter.localSetSizeForTest());
     for (const auto& atomId : sampleIds) {
         EXPECT_FALSE(filter.isAtomInUse(atomId));
     }
-    EXPECT_EQ(0, filter.mLocalTagIds.size());
+    EXPECT_EQ(0, filter.localSetSizeForTest());
     EXPECT_TRUE(testGuaranteedUnusedAtomsNotInUse(filter));
 }
 
@@ -368,6 +368,30 @@ TEST_P(LogEventTest, TestEmptyString) {
     AStatsEvent_release(event);
 }
 
+TEST_P(LogEventTest, TestMalformedUtf8StringSanitized) {
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, 100);
+    // 0xc3 starts a 2-byte sequence but 0x28 is not a continuation byte.
+    AStatsEvent_writeString(event, "bad\xc3\x28str");
+    AStatsEvent_build(event);
+
+    size_t size;
+    const uint8_t* buf = AStatsEvent_getBuffer(event, &size);
+
+    LogEvent logEvent(/*uid=*/1000, /*pid=*/1001);
+    EXPECT_TRUE(ParseBuffer(logEvent, buf, size));
+
+    const vector<FieldValue>& values = logEvent.getValues();
+    ASSERT_EQ(1, values.size());
+
+    const FieldValue& item = values[0];
+    EXPECT_EQ(Type::STRING, item.mValue.getType());
+    // The invalid lead byte is replaced at parse time; the rest is untouched.
+    EXPECT_EQ("bad?(str", item.mValue.str_value);
+
+    AStatsEvent_release(event);
+}
+
 TEST_P(LogEventTest, TestByteArrayWithNullCharacter) {
     AStatsEvent* event = AStatsEvent_obtain();
     AStatsEvent_setAtomId(event, 100);
@@ -715,6 +739,23 @@ TEST_P(LogEventTest, TestAnnotationIdIsUid) {
     EXPECT_TRUE(isUidField(values.at(0)));
 }
 
+TEST_P(LogEventTest, TestAnnotationIdIsUid_SchemaReplay) {
+    // The second identical event replays the cached annotation schema instead
+    // of decoding the annotations and must produce the same result.
+    for (int i = 0; i < 2; i++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        EXPECT_TRUE(createFieldWithBoolAnnotationLogEvent(&event, INT32_TYPE,
+                                                          ASTATSLOG_ANNOTATION_ID_IS_UID, true,
+                                                          /*doHeaderPrefetch=*/GetParam()));
+
+        ASSERT_EQ(event.getNumUidFields(), 1);
+
+        const vector<FieldValue>& values = event.getValues();
+        ASSERT_EQ(values.size(), 1);
+        EXPECT_TRUE(isUidField(values.at(0)));
+    }
+}
+
 TEST_P(LogEventTest, TestAnnotationIdIsUid_RepeatedIntAndOtherFields) {
     size_t numElements = 2;
     int32_t int32Array[2] = {3, 6};
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "matchers/MatcherResultCache.h"
+
+#include <gtest/gtest.h>
+
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+constexpr uint64_t kMatcherHash = 0x1234567890abcdefull;
+constexpr uint64_t kOtherMatcherHash = 0xfedcba0987654321ull;
+
+}  // anonymous namespace
+
+TEST(MatcherResultCache_test, TestStoreAndLookup) {
+    MatcherResultCache cache;
+    std::shared_ptr<LogEvent> event = CreateNoValuesLogEvent(/*atomId=*/10, /*eventTimeNs=*/1000);
+
+    bool matched = false;
+    std::shared_ptr<LogEvent> transformedEvent;
+    EXPECT_FALSE(cache.lookup(kMatcherHash, *event, &matched, &transformedEvent));
+
+    cache.store(kMatcherHash, *event, /*matched=*/true, /*transformedEvent=*/nullptr);
+    EXPECT_TRUE(cache.lookup(kMatcherHash, *event, &matched, &transformedEvent));
+    EXPECT_TRUE(matched);
+    EXPECT_EQ(transformedEvent, nullptr);
+
+    // A different matcher evaluated against the same event has its own slot.
+    EXPECT_FALSE(cache.lookup(kOtherMatcherHash, *event, &matched, &transformedEvent));
+    cache.store(kOtherMatcherHash, *event, /*matched=*/false, /*transformedEvent=*/nullptr);
+    EXPECT_TRUE(cache.lookup(kOtherMatcherHash, *event, &matched, &transformedEvent));
+    EXPECT_FALSE(matched);
+}
+
+TEST(MatcherResultCache_test, TestInvalidatedByNewEvent) {
+    MatcherResultCache cache;
+    std::shared_ptr<LogEvent> event1 = CreateNoValuesLogEvent(/*atomId=*/10, /*eventTimeNs=*/1000);
+    std::shared_ptr<LogEvent> event2 = CreateNoValuesLogEvent(/*atomId=*/10, /*eventTimeNs=*/2000);
+
+    cache.store(kMatcherHash, *event1, /*matched=*/true, /*transformedEvent=*/nullptr);
+
+    bool matched = false;
+    std::shared_ptr<LogEvent> transformedEvent;
+    // Results cached for event1 must not leak into the evaluation of event2.
+    EXPECT_FALSE(cache.lookup(kMatcherHash, *event2, &matched, &transformedEvent));
+    EXPECT_EQ(0u, cache.mResults.size());
+
+    // Looking up event1 again after the invalidation misses as well.
+    EXPECT_FALSE(cache.lookup(kMatcherHash, *event1, &matched, &transformedEvent));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
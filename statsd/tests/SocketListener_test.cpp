@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 #include <gtest/gtest.h>
+#include <private/android_filesystem_config.h>
 
+#include "socket/SocketPayloadCapture.h"
 #include "socket/StatsSocketListener.h"
 #include "tests/statsd_test_util.h"
 
@@ -53,6 +55,23 @@ public:
     }
 };
 
+// Builds a transactional group datagram with the frame layout produced by
+// AStatsEvent_writeGroup: LIST_TYPE | count | per event uint32_t size + payload.
+std::vector<uint8_t> makeGroupPayload(const std::vector<int>& atomIds) {
+    std::vector<uint8_t> payload;
+    payload.push_back(LIST_TYPE);
+    payload.push_back(static_cast<uint8_t>(atomIds.size()));
+    for (const int atomId : atomIds) {
+        AStatsEventWrapper event(atomId);
+        auto [buf, size] = event.getBuffer();
+        const uint32_t eventSize = static_cast<uint32_t>(size);
+        const uint8_t* sizeBytes = reinterpret_cast<const uint8_t*>(&eventSize);
+        payload.insert(payload.end(), sizeBytes, sizeBytes + sizeof(eventSize));
+        payload.insert(payload.end(), buf, buf + size);
+    }
+    return payload;
+}
+
 }  //  namespace
 
 void generateAtomLogging(const std::shared_ptr<LogEventQueue>& queue,
@@ -93,7 +112,7 @@ TEST_P(SocketParseMessageTest, TestProcessMessage) {
 
     int64_t lastEventTs = 0;
     // check content of the queue
-    EXPECT_EQ(kEventCount, mEventQueue->mQueue.size());
+    EXPECT_EQ(kEventCount, mEventQueue->size());
     for (int i = 0; i < kEventCount; i++) {
         auto logEvent = mEventQueue->waitPop();
         EXPECT_TRUE(logEvent->isValid());
@@ -112,7 +131,7 @@ TEST_P(SocketParseMessageTest, TestProcessMessageEmptySetExplicitSet) {
     generateAtomLogging(mEventQueue, mLogEventFilter, kEventCount, kAtomId);
 
     // check content of the queue
-    EXPECT_EQ(kEventCount, mEventQueue->mQueue.size());
+    EXPECT_EQ(kEventCount, mEventQueue->size());
     for (int i = 0; i < kEventCount; i++) {
         auto logEvent = mEventQueue->waitPop();
         EXPECT_TRUE(logEvent->isValid());
@@ -136,7 +155,7 @@ TEST(SocketParseMessageTest, TestProcessMessageFilterCompleteSet) {
     generateAtomLogging(eventQueue, logEventFilter, kEventCount, kAtomId);
 
     // check content of the queue
-    EXPECT_EQ(kEventCount, eventQueue->mQueue.size());
+    EXPECT_EQ(kEventCount, eventQueue->size());
     for (int i = 0; i < kEventCount; i++) {
         auto logEvent = eventQueue->waitPop();
         EXPECT_TRUE(logEvent->isValid());
@@ -160,7 +179,7 @@ TEST(SocketParseMessageTest, TestProcessMessageFilterPartialSet) {
     generateAtomLogging(eventQueue, logEventFilter, kEventCount, kAtomId);
 
     // check content of the queue
-    EXPECT_EQ(kEventCount, eventQueue->mQueue.size());
+    EXPECT_EQ(kEventCount, eventQueue->size());
     for (int i = 0; i < kEventFilteredCount; i++) {
         auto logEvent = eventQueue->waitPop();
         EXPECT_TRUE(logEvent->isValid());
@@ -208,7 +227,7 @@ TEST(SocketParseMessageTest, TestProcessMessageFilterToggle) {
     generateAtomLogging(eventQueue, logEventFilter, kEventCount, kAtomId + kEventCount * 2);
 
     // check content of the queue
-    EXPECT_EQ(kEventCount * 3, eventQueue->mQueue.size());
+    EXPECT_EQ(kEventCount * 3, eventQueue->size());
     // events with ids from kAtomId to kAtomId + kEventFilteredCount should not be skipped
     for (int i = 0; i < kEventFilteredCount; i++) {
         auto logEvent = eventQueue->waitPop();
@@ -253,9 +272,147 @@ TEST(SocketParseMessageTest, TestProcessMessageFilterToggle) {
     }
 }
 
+TEST(SocketParseMessageTest, TestProcessGroupMessage) {
+    std::shared_ptr<LogEventQueue> eventQueue =
+            std::make_shared<LogEventQueue>(kEventCount /*buffer limit*/);
+    std::shared_ptr<LogEventFilter> logEventFilter = std::make_shared<LogEventFilter>();
+    logEventFilter->setFilteringEnabled(false);
+
+    const std::vector<uint8_t> payload = makeGroupPayload({kAtomId, kAtomId + 1, kAtomId + 2});
+    StatsSocketListener::processMessage(payload.data(), payload.size(), kTestUid, kTestPid,
+                                        eventQueue, logEventFilter);
+
+    // The whole group is queued, in logging order.
+    EXPECT_EQ(3, eventQueue->size());
+    for (int i = 0; i < 3; i++) {
+        auto logEvent = eventQueue->waitPop();
+        EXPECT_TRUE(logEvent->isValid());
+        EXPECT_EQ(kAtomId + i, logEvent->GetTagId());
+        EXPECT_FALSE(logEvent->isParsedHeaderOnly());
+    }
+}
+
+TEST(SocketParseMessageTest, TestGroupOverflowIsAllOrNothing) {
+    std::shared_ptr<LogEventQueue> eventQueue =
+            std::make_shared<LogEventQueue>(2 /*buffer limit*/);
+    std::shared_ptr<LogEventFilter> logEventFilter = std::make_shared<LogEventFilter>();
+    logEventFilter->setFilteringEnabled(false);
+
+    // One single event occupies the first slot.
+    AStatsEventWrapper single(kAtomId);
+    auto [buf, size] = single.getBuffer();
+    StatsSocketListener::processMessage(buf, size, kTestUid, kTestPid, eventQueue, logEventFilter);
+    EXPECT_EQ(1, eventQueue->size());
+
+    // A group of three cannot fit: no part of it may be enqueued.
+    const std::vector<uint8_t> bigGroup =
+            makeGroupPayload({kAtomId + 1, kAtomId + 2, kAtomId + 3});
+    StatsSocketListener::processMessage(bigGroup.data(), bigGroup.size(), kTestUid, kTestPid,
+                                        eventQueue, logEventFilter);
+    EXPECT_EQ(1, eventQueue->size());
+
+    // A group of one still fits and is queued behind the single event.
+    const std::vector<uint8_t> smallGroup = makeGroupPayload({kAtomId + 4});
+    StatsSocketListener::processMessage(smallGroup.data(), smallGroup.size(), kTestUid, kTestPid,
+                                        eventQueue, logEventFilter);
+    EXPECT_EQ(2, eventQueue->size());
+    EXPECT_EQ(kAtomId, eventQueue->waitPop()->GetTagId());
+    EXPECT_EQ(kAtomId + 4, eventQueue->waitPop()->GetTagId());
+}
+
+TEST(SocketParseMessageTest, TestMalformedGroupMessageDropped) {
+    std::shared_ptr<LogEventQueue> eventQueue =
+            std::make_shared<LogEventQueue>(kEventCount /*buffer limit*/);
+    std::shared_ptr<LogEventFilter> logEventFilter = std::make_shared<LogEventFilter>();
+    logEventFilter->setFilteringEnabled(false);
+
+    // Truncating the frame mid-way drops the entire group rather than queueing
+    // the events that happened to parse.
+    std::vector<uint8_t> payload = makeGroupPayload({kAtomId, kAtomId + 1});
+    payload.resize(payload.size() - 4);
+    StatsSocketListener::processMessage(payload.data(), payload.size(), kTestUid, kTestPid,
+                                        eventQueue, logEventFilter);
+    EXPECT_EQ(0, eventQueue->size());
+}
+
+TEST(SocketListenerTest, TestUidThrottleTokenBucket) {
+    sp<StatsSocketListener> listener =
+            new StatsSocketListener(std::make_shared<LogEventQueue>(kEventCount /*buffer limit*/),
+                                    std::make_shared<LogEventFilter>());
+
+    const int64_t startNs = 1000000000LL;
+
+    // Platform uids are exempt regardless of volume.
+    for (int64_t i = 0; i < StatsSocketListener::kThrottleBurstTokens * 2; i++) {
+        EXPECT_FALSE(listener->isUidThrottled(AID_SYSTEM, startNs));
+    }
+
+    // An app uid gets the burst allowance, then throttles.
+    const uint32_t appUid = StatsSocketListener::kFirstApplicationUid + 123;
+    for (int64_t i = 0; i < StatsSocketListener::kThrottleBurstTokens; i++) {
+        EXPECT_FALSE(listener->isUidThrottled(appUid, startNs));
+    }
+    EXPECT_TRUE(listener->isUidThrottled(appUid, startNs));
+
+    // One second later the bucket has refilled at the steady-state rate.
+    const int64_t laterNs = startNs + 1000000000LL;
+    for (int64_t i = 0; i < StatsSocketListener::kThrottleTokensPerSec; i++) {
+        EXPECT_FALSE(listener->isUidThrottled(appUid, laterNs));
+    }
+    EXPECT_TRUE(listener->isUidThrottled(appUid, laterNs));
+
+    // A uid that collides on the same slot evicts it and starts with a fresh
+    // burst allowance.
+    const uint32_t collidingUid = appUid + StatsSocketListener::kThrottleSlots;
+    EXPECT_FALSE(listener->isUidThrottled(collidingUid, laterNs));
+}
+
 // TODO: tests for setAtomIds() with multiple consumers
 // TODO: use MockLogEventFilter to test different sets from different consumers
 
+TEST(SocketPayloadCaptureTest, TestCaptureRoundTrip) {
+    const std::string path = "/data/local/tmp/socket_capture_test.bin";
+    SocketPayloadCapture& capture = SocketPayloadCapture::getInstance();
+    ASSERT_TRUE(capture.start(path));
+    EXPECT_TRUE(capture.isEnabled());
+    // Starting twice must fail without disturbing the running capture.
+    EXPECT_FALSE(capture.start(path));
+
+    const uint8_t payload1[] = {0x01, 0x02, 0x03};
+    const uint8_t payload2[] = {0x04, 0x05};
+    capture.capture(payload1, sizeof(payload1), /*elapsedRealtimeNs=*/111);
+    capture.capture(payload2, sizeof(payload2), /*elapsedRealtimeNs=*/222);
+    capture.stop();
+    EXPECT_FALSE(capture.isEnabled());
+
+    FILE* file = fopen(path.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    uint32_t magic = 0;
+    ASSERT_EQ(fread(&magic, 1, sizeof(magic), file), sizeof(magic));
+    EXPECT_EQ(magic, SocketPayloadCapture::kFileMagic);
+
+    int64_t timestampNs = 0;
+    uint32_t len = 0;
+    uint8_t buf[8];
+    ASSERT_EQ(fread(&timestampNs, 1, sizeof(timestampNs), file), sizeof(timestampNs));
+    EXPECT_EQ(timestampNs, 111);
+    ASSERT_EQ(fread(&len, 1, sizeof(len), file), sizeof(len));
+    ASSERT_EQ(len, sizeof(payload1));
+    ASSERT_EQ(fread(buf, 1, len, file), len);
+    EXPECT_EQ(memcmp(buf, payload1, len), 0);
+
+    ASSERT_EQ(fread(&timestampNs, 1, sizeof(timestampNs), file), sizeof(timestampNs));
+    EXPECT_EQ(timestampNs, 222);
+    ASSERT_EQ(fread(&len, 1, sizeof(len), file), sizeof(len));
+    ASSERT_EQ(len, sizeof(payload2));
+    ASSERT_EQ(fread(buf, 1, len, file), len);
+    EXPECT_EQ(memcmp(buf, payload2, len), 0);
+
+    EXPECT_EQ(fread(buf, 1, 1, file), 0u);
+    fclose(file);
+    unlink(path.c_str());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -133,7 +133,7 @@ TEST(StatsLogProcessorTest, TestRateLimitBroadcast) {
 
     // b/73089712
     // This next call to flush should not trigger a broadcast.
-    // p.mLastByteSizeTimes.clear();  // Force another check for byte size.
+    // p.mConfigBookkeeping.clear();  // Force another check for byte size.
     // p.flushIfNecessaryLocked(2, key, mockMetricsManager);
     // EXPECT_EQ(1, broadcastCount);
 }
@@ -949,6 +949,77 @@ TEST(StatsLogProcessorTest, TestActivationOnBoot) {
     EXPECT_EQ(kActive, activation1001->state);
 }
 
+TEST(StatsLogProcessorTest, TestActiveConfigSegmentCacheInvalidatedOnActivation) {
+    int uid = 1111;
+
+    StatsdConfig config1;
+    config1.set_id(12341);
+    auto wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config1.add_atom_matcher() = wakelockAcquireMatcher;
+
+    long metricId1 = 1234561;
+    auto countMetric1 = config1.add_count_metric();
+    countMetric1->set_id(metricId1);
+    countMetric1->set_what(wakelockAcquireMatcher.id());
+    countMetric1->set_bucket(FIVE_MINUTES);
+
+    auto metric1Activation = config1.add_metric_activation();
+    metric1Activation->set_metric_id(metricId1);
+    metric1Activation->set_activation_type(ACTIVATE_ON_BOOT);
+    auto metric1ActivationTrigger = metric1Activation->add_event_activation();
+    metric1ActivationTrigger->set_atom_matcher_id(wakelockAcquireMatcher.id());
+    metric1ActivationTrigger->set_ttl_seconds(100);
+
+    ConfigKey cfgKey1(uid, 12341);
+    long timeBase1 = 1;
+    sp<StatsLogProcessor> processor =
+            CreateStatsLogProcessor(timeBase1, timeBase1, config1, cfgKey1);
+
+    // Two consecutive writes with unchanged (inactive) activation state must produce
+    // identical bytes: the second one replays the cached segment.
+    ProtoOutputStream protoOut1;
+    processor->WriteActiveConfigsToProtoOutputStream(timeBase1 + 100, DEVICE_SHUTDOWN,
+                                                     &protoOut1);
+    std::string bytes1;
+    EXPECT_TRUE(protoOut1.serializeToString(&bytes1));
+
+    ProtoOutputStream protoOut2;
+    processor->WriteActiveConfigsToProtoOutputStream(timeBase1 + 200, DEVICE_SHUTDOWN,
+                                                     &protoOut2);
+    std::string bytes2;
+    EXPECT_TRUE(protoOut2.serializeToString(&bytes2));
+    EXPECT_EQ(bytes1, bytes2);
+
+    ActiveConfigList list1;
+    EXPECT_TRUE(list1.ParseFromString(bytes1));
+    ASSERT_EQ(1, list1.config_size());
+    ASSERT_EQ(1, list1.config(0).metric_size());
+    ASSERT_EQ(0, list1.config(0).metric(0).activation_size());
+
+    // Trigger the activation; the cached segment must not be replayed afterwards.
+    std::vector<int> attributionUids = {111};
+    std::vector<string> attributionTags = {"App1"};
+    std::unique_ptr<LogEvent> event =
+            CreateAcquireWakelockEvent(timeBase1 + 300, attributionUids, attributionTags, "wl1");
+    processor->OnLogEvent(event.get());
+
+    ProtoOutputStream protoOut3;
+    processor->WriteActiveConfigsToProtoOutputStream(timeBase1 + 400, DEVICE_SHUTDOWN,
+                                                     &protoOut3);
+    std::string bytes3;
+    EXPECT_TRUE(protoOut3.serializeToString(&bytes3));
+
+    ActiveConfigList list3;
+    EXPECT_TRUE(list3.ParseFromString(bytes3));
+    ASSERT_EQ(1, list3.config_size());
+    ASSERT_EQ(1, list3.config(0).metric_size());
+    ASSERT_EQ(1, list3.config(0).metric(0).activation_size());
+    // At shutdown an ACTIVATE_ON_BOOT activation is persisted as ACTIVE with the full ttl.
+    EXPECT_EQ(ActiveEventActivation::ACTIVE, list3.config(0).metric(0).activation(0).state());
+    EXPECT_EQ(metric1ActivationTrigger->ttl_seconds() * NS_PER_SEC,
+              list3.config(0).metric(0).activation(0).remaining_ttl_nanos());
+}
+
 TEST(StatsLogProcessorTest, TestActivationOnBootMultipleActivations) {
     int uid = 1111;
 
@@ -1849,6 +1920,7 @@ TEST(StatsLogProcessorTest, TestActivationsPersistAcrossSystemServerRestart) {
                             &buffer);
 
     service->removeConfiguration(configId, uid);
+    service->waitForServiceDispatcher();
     service->mProcessor->onDumpReport(cfgKey1, getElapsedRealtimeNs(),
                                       false /* include_current_bucket*/, true /* erase_data */,
                                       ADB_DUMP, NO_TIME_CONSTRAINTS, nullptr);
@@ -1928,6 +2000,37 @@ TEST(StatsLogProcessorTest_mapIsolatedUidToHostUid, LogIsolatedUid) {
     EXPECT_EQ(field2, actualFieldValues->at(2).mValue.int_value);
 }
 
+TEST(StatsLogProcessorTest_mapIsolatedUidToHostUid, LogIsolatedUidAfterRemoval) {
+    int hostUid = 20;
+    int isolatedUid = 30;
+    uint64_t eventTimeNs = 12355;
+    int atomId = 89;
+    int field1 = 90;
+    int field2 = 28;
+    // Real UidMap: exercises the ingestion-side translation cache, which must drop
+    // its entries when the isolated uid map changes.
+    sp<UidMap> uidMap = new UidMap();
+    uidMap->assignIsolatedUid(isolatedUid, hostUid);
+
+    ConfigKey cfgKey;
+    StatsdConfig config = MakeConfig(false);
+    sp<StatsLogProcessor> processor =
+            CreateStatsLogProcessor(1, 1, config, cfgKey, nullptr, 0, uidMap);
+
+    shared_ptr<LogEvent> logEvent =
+            makeUidLogEvent(atomId, eventTimeNs, isolatedUid, field1, field2);
+    processor->OnLogEvent(logEvent.get());
+    EXPECT_EQ(hostUid, logEvent->getValues().at(0).mValue.int_value);
+
+    uidMap->removeIsolatedUid(isolatedUid);
+
+    // The cached isolated-to-host translation must not survive the removal.
+    shared_ptr<LogEvent> logEvent2 =
+            makeUidLogEvent(atomId, eventTimeNs + 10, isolatedUid, field1, field2);
+    processor->OnLogEvent(logEvent2.get());
+    EXPECT_EQ(isolatedUid, logEvent2->getValues().at(0).mValue.int_value);
+}
+
 TEST(StatsLogProcessorTest_mapIsolatedUidToHostUid, LogThreeIsolatedUids) {
     int hostUid = 20;
     int isolatedUid = 30;
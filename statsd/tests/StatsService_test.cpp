@@ -77,6 +77,7 @@ TEST(StatsServiceTest, TestAddConfig_simple) {
     EXPECT_TRUE(service->addConfigurationChecked(kCallingUid, kConfigKey,
                                                  {serialized.begin(), serialized.end()}));
     service->removeConfiguration(kConfigKey, kCallingUid);
+    service->waitForServiceDispatcher();
     ConfigKey configKey(kCallingUid, kConfigKey);
     service->mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(),
                                       false /* include_current_bucket*/, true /* erase_data */,
@@ -93,6 +94,7 @@ TEST(StatsServiceTest, TestAddConfig_empty) {
     EXPECT_TRUE(service->addConfigurationChecked(kCallingUid, kConfigKey,
                                                  {serialized.begin(), serialized.end()}));
     service->removeConfiguration(kConfigKey, kCallingUid);
+    service->waitForServiceDispatcher();
     ConfigKey configKey(kCallingUid, kConfigKey);
     service->mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(),
                                       false /* include_current_bucket*/, true /* erase_data */,
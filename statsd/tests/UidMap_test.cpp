@@ -311,9 +311,42 @@ TEST(UidMapTest, TestUpdateApp) {
                 UnorderedPointwise(EqPackageInfo(), expectedPackageInfos));
 }
 
-// Test that uid map returns at least one snapshot even if we already obtained
-// this snapshot from a previous call to getData.
-TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot) {
+// Certificate hashes from a bulk update are filled in by a worker thread; uid and
+// version data must be queryable before that work lands, and a report that includes
+// hashes must see them.
+TEST(UidMapTest, TestCertificateHashesAppliedInBackground) {
+    UidMap m;
+    ConfigKey config1(1, StringToId("config1"));
+    m.OnConfigUpdated(config1);
+
+    UidData uidData;
+    ApplicationInfo* appInfo = uidData.add_app_info();
+    *appInfo = createApplicationInfo(/*uid*/ 1000, /*version*/ 5, "v1", kApp1);
+    appInfo->set_certificate_hash(kCertificateHashes[0].data(), kCertificateHashes[0].size());
+
+    m.updateMap(1 /* timestamp */, uidData);
+
+    // The uid/version half of the update is published synchronously.
+    EXPECT_TRUE(m.hasApp(1000, kApp1));
+    EXPECT_EQ(5, m.getAppVersion(1000, kApp1));
+
+    // appendUidMap drains the pending hash batch before writing the snapshot.
+    ProtoOutputStream proto;
+    m.appendUidMap(/* timestamp */ 3, config1, /* includeVersionStrings */ true,
+                   /* includeInstaller */ true, /* truncatedCertificateHashSize */ UINT8_MAX,
+                   /* str_set */ nullptr, &proto);
+    UidMapping results;
+    outputStreamToProto(&proto, &results);
+    ASSERT_EQ(1, results.snapshots_size());
+    ASSERT_EQ(1, results.snapshots(0).package_info_size());
+    const string expectedHash(kCertificateHashes[0].begin(), kCertificateHashes[0].end());
+    EXPECT_EQ(expectedHash, results.snapshots(0).package_info(0).truncated_certificate_hash());
+}
+
+// Test that the first report for a config carries a full snapshot, subsequent reports
+// omit the snapshot while the change-record chain is intact, and the map re-bases with
+// a full snapshot after kMaxUidMapDeltaReports delta reports.
+TEST(UidMapTest, TestDeltaReportsAndRebase) {
     UidMap m;
     // Initialize single config key.
     ConfigKey config1(1, StringToId("config1"));
@@ -324,19 +357,36 @@ TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot) {
 
     m.updateMap(1 /* timestamp */, uidData);
 
-    // Set the last timestamp for this config key to be newer.
-    m.mLastUpdatePerConfigKey[config1] = 2;
-
+    // The first report establishes the base snapshot.
     ProtoOutputStream proto;
     m.appendUidMap(/* timestamp */ 3, config1, /* includeVersionStrings */ true,
                    /* includeInstaller */ true, /* truncatedCertificateHashSize */ 0,
                    /* str_set */ nullptr, &proto);
-
-    // Check there's still a uidmap attached this one.
     UidMapping results;
     outputStreamToProto(&proto, &results);
     ASSERT_EQ(1, results.snapshots_size());
     EXPECT_EQ("v1", results.snapshots(0).package_info(0).version_string());
+
+    // Following reports carry only the change records.
+    for (int i = 0; i < StatsdStats::kMaxUidMapDeltaReports; i++) {
+        m.updateApp(/* timestamp */ 10 + 2 * i, kApp2, /* uid */ 1000, /* versionCode */ 6 + i,
+                    "v2", /* installer */ "", /* certificateHash */ {});
+        proto.clear();
+        m.appendUidMap(/* timestamp */ 11 + 2 * i, config1, /* includeVersionStrings */ true,
+                       /* includeInstaller */ true, /* truncatedCertificateHashSize */ 0,
+                       /* str_set */ nullptr, &proto);
+        outputStreamToProto(&proto, &results);
+        ASSERT_EQ(0, results.snapshots_size());
+        ASSERT_EQ(1, results.changes_size());
+    }
+
+    // After kMaxUidMapDeltaReports delta reports, a full snapshot is written again.
+    proto.clear();
+    m.appendUidMap(/* timestamp */ 100, config1, /* includeVersionStrings */ true,
+                   /* includeInstaller */ true, /* truncatedCertificateHashSize */ 0,
+                   /* str_set */ nullptr, &proto);
+    outputStreamToProto(&proto, &results);
+    ASSERT_EQ(1, results.snapshots_size());
 }
 
 TEST(UidMapTest, TestRemovedAppRetained) {
@@ -385,8 +435,9 @@ TEST(UidMapTest, TestRemovedAppOverGuardrail) {
     outputStreamToProto(&proto, &results);
     ASSERT_EQ(maxDeletedApps + 10, results.snapshots(0).package_info_size());
 
-    // Now remove all the apps.
-    m.updateMap(1 /* timestamp */, uidData);
+    // Now remove all the apps. The bulk update also forces the next report to
+    // carry a full snapshot again.
+    m.updateMap(4 /* timestamp */, uidData);
     for (int j = 0; j < maxDeletedApps + 10; j++) {
         m.removeApp(4, kApp1, j);
     }
@@ -421,13 +472,13 @@ TEST(UidMapTest, TestClearingOutput) {
     outputStreamToProto(&proto, &results);
     ASSERT_EQ(1, results.snapshots_size());
 
-    // We have to keep at least one snapshot in memory at all times.
+    // The receiver already has the base snapshot, so the next report is a delta.
     proto.clear();
     m.appendUidMap(/* timestamp */ 2, config1, /* includeVersionStrings */ true,
                    /* includeInstaller */ true, /* truncatedCertificateHashSize */ 0,
                    /* str_set */ nullptr, &proto);
     outputStreamToProto(&proto, &results);
-    ASSERT_EQ(1, results.snapshots_size());
+    ASSERT_EQ(0, results.snapshots_size());
 
     // Now add another configuration.
     m.OnConfigUpdated(config2);
@@ -438,7 +489,7 @@ TEST(UidMapTest, TestClearingOutput) {
                    /* includeInstaller */ true, /* truncatedCertificateHashSize */ 0,
                    /* str_set */ nullptr, &proto);
     outputStreamToProto(&proto, &results);
-    ASSERT_EQ(1, results.snapshots_size());
+    ASSERT_EQ(0, results.snapshots_size());
     ASSERT_EQ(1, results.changes_size());
     ASSERT_EQ(1U, m.mChanges.size());
 
@@ -452,7 +503,7 @@ TEST(UidMapTest, TestClearingOutput) {
                    /* includeInstaller */ true, /* truncatedCertificateHashSize */ 0,
                    /* str_set */ nullptr, &proto);
     outputStreamToProto(&proto, &results);
-    ASSERT_EQ(1, results.snapshots_size());
+    ASSERT_EQ(0, results.snapshots_size());
     ASSERT_EQ(1, results.changes_size());
     ASSERT_EQ(2U, m.mChanges.size());
 
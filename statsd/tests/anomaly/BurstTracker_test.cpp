@@ -0,0 +1,165 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/anomaly/BurstTracker.h"
+
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include "tests/statsd_test_util.h"
+
+using namespace testing;
+using android::sp;
+using std::shared_ptr;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const ConfigKey kConfigKey(0, 12345);
+const int kAtomId = 10;
+const int64_t kMatcherId = 678;
+const int64_t kAlertId = 1111;
+const int64_t kStartTimeNs = 1000 * NS_PER_SEC;
+
+Alert createBurstAlert(int numOccurrences, int64_t windowMillis) {
+    Alert alert;
+    alert.set_id(kAlertId);
+    alert.set_atom_matcher_id(kMatcherId);
+    alert.set_num_occurrences(numOccurrences);
+    alert.set_window_millis(windowMillis);
+    alert.set_refractory_period_secs(30);
+    return alert;
+}
+
+}  // anonymous namespace
+
+TEST(BurstTrackerTest, TestBurstWithinWindow) {
+    BurstTracker tracker(createBurstAlert(/*numOccurrences=*/3, /*windowMillis=*/100), kConfigKey);
+
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, kStartTimeNs));
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, kStartTimeNs + 50 * 1000000));
+    EXPECT_EQ(0U, tracker.getRefractoryPeriodEndsSec(DEFAULT_METRIC_DIMENSION_KEY));
+
+    // Third event within 100ms of the first completes the burst.
+    const int64_t burstTimeNs = kStartTimeNs + 90 * 1000000;
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, burstTimeNs));
+    EXPECT_EQ((uint64_t)std::ceil(1.0 * burstTimeNs / NS_PER_SEC) + 30,
+              tracker.getRefractoryPeriodEndsSec(DEFAULT_METRIC_DIMENSION_KEY));
+}
+
+TEST(BurstTrackerTest, TestNoBurstOutsideWindow) {
+    BurstTracker tracker(createBurstAlert(/*numOccurrences=*/3, /*windowMillis=*/100), kConfigKey);
+
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, kStartTimeNs));
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, kStartTimeNs + 60 * 1000000));
+    // 130ms after the first event: only 2 events fall inside any 100ms window.
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, kStartTimeNs + 130 * 1000000));
+    EXPECT_EQ(0U, tracker.getRefractoryPeriodEndsSec(DEFAULT_METRIC_DIMENSION_KEY));
+
+    // A fourth event at 140ms forms a burst with the events at 60ms and 130ms.
+    const int64_t burstTimeNs = kStartTimeNs + 140 * 1000000;
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, burstTimeNs));
+    EXPECT_EQ((uint64_t)std::ceil(1.0 * burstTimeNs / NS_PER_SEC) + 30,
+              tracker.getRefractoryPeriodEndsSec(DEFAULT_METRIC_DIMENSION_KEY));
+}
+
+TEST(BurstTrackerTest, TestSlicedBursts) {
+    Alert alert = createBurstAlert(/*numOccurrences=*/3, /*windowMillis=*/100);
+    *alert.mutable_burst_dimensions() = CreateDimensions(kAtomId, {1 /*uid*/});
+    BurstTracker tracker(alert, kConfigKey);
+
+    // Interleave 3 events for uid 111 with 2 events for uid 222 within the window.
+    shared_ptr<LogEvent> uid1Event =
+            CreateTwoValueLogEvent(kAtomId, kStartTimeNs, 111 /*uid*/, 5 /*value*/);
+    shared_ptr<LogEvent> uid2Event =
+            CreateTwoValueLogEvent(kAtomId, kStartTimeNs + 10 * 1000000, 222 /*uid*/, 5 /*value*/);
+    tracker.noteMatchedEvent(*uid1Event);
+    tracker.noteMatchedEvent(*uid2Event);
+    tracker.noteMatchedEvent(*CreateTwoValueLogEvent(kAtomId, kStartTimeNs + 20 * 1000000, 111, 5));
+    tracker.noteMatchedEvent(*CreateTwoValueLogEvent(kAtomId, kStartTimeNs + 30 * 1000000, 222, 5));
+    const int64_t burstTimeNs = kStartTimeNs + 40 * 1000000;
+    tracker.noteMatchedEvent(*CreateTwoValueLogEvent(kAtomId, burstTimeNs, 111, 5));
+
+    // Only uid 111's slice reached 3 events.
+    EXPECT_EQ((uint64_t)std::ceil(1.0 * burstTimeNs / NS_PER_SEC) + 30,
+              tracker.getRefractoryPeriodEndsSec(tracker.extractDimensionKey(*uid1Event)));
+    EXPECT_EQ(0U, tracker.getRefractoryPeriodEndsSec(tracker.extractDimensionKey(*uid2Event)));
+}
+
+TEST(BurstTrackerTest, TestRefractoryPeriod) {
+    BurstTracker tracker(createBurstAlert(/*numOccurrences=*/2, /*windowMillis=*/100), kConfigKey);
+
+    const int64_t firstBurstTimeNs = kStartTimeNs + 50 * 1000000;
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, kStartTimeNs));
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, firstBurstTimeNs));
+    const uint64_t refractoryEndSec =
+            (uint64_t)std::ceil(1.0 * firstBurstTimeNs / NS_PER_SEC) + 30;
+    EXPECT_EQ(refractoryEndSec,
+              tracker.getRefractoryPeriodEndsSec(DEFAULT_METRIC_DIMENSION_KEY));
+
+    // A second burst 5 seconds later is still inside the 30s refractory period,
+    // so the refractory end time must not move.
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, kStartTimeNs + 5 * NS_PER_SEC));
+    tracker.noteMatchedEvent(
+            *CreateNoValuesLogEvent(kAtomId, kStartTimeNs + 5 * NS_PER_SEC + 10 * 1000000));
+    EXPECT_EQ(refractoryEndSec,
+              tracker.getRefractoryPeriodEndsSec(DEFAULT_METRIC_DIMENSION_KEY));
+
+    // A burst after the refractory period ends is declared again.
+    const int64_t secondBurstTimeNs = kStartTimeNs + 40 * NS_PER_SEC;
+    tracker.noteMatchedEvent(
+            *CreateNoValuesLogEvent(kAtomId, secondBurstTimeNs - 10 * 1000000));
+    tracker.noteMatchedEvent(*CreateNoValuesLogEvent(kAtomId, secondBurstTimeNs));
+    EXPECT_EQ((uint64_t)std::ceil(1.0 * secondBurstTimeNs / NS_PER_SEC) + 30,
+              tracker.getRefractoryPeriodEndsSec(DEFAULT_METRIC_DIMENSION_KEY));
+}
+
+TEST(BurstTrackerTest, TestDimensionGuardrail) {
+    Alert alert = createBurstAlert(/*numOccurrences=*/2, /*windowMillis=*/100);
+    *alert.mutable_burst_dimensions() = CreateDimensions(kAtomId, {1 /*uid*/});
+    BurstTracker tracker(alert, kConfigKey);
+
+    // Fill up the dimension cap with one event per uid.
+    for (int uid = 1; uid <= 500; uid++) {
+        tracker.noteMatchedEvent(*CreateTwoValueLogEvent(kAtomId, kStartTimeNs, uid, 5));
+    }
+    ASSERT_EQ(500U, tracker.mRings.size());
+
+    // Events for a new slice are dropped: no ring is created and no burst fires.
+    shared_ptr<LogEvent> overflowEvent =
+            CreateTwoValueLogEvent(kAtomId, kStartTimeNs + 10 * 1000000, 501 /*uid*/, 5);
+    tracker.noteMatchedEvent(*overflowEvent);
+    tracker.noteMatchedEvent(*CreateTwoValueLogEvent(kAtomId, kStartTimeNs + 20 * 1000000, 501, 5));
+    EXPECT_EQ(500U, tracker.mRings.size());
+    EXPECT_EQ(0U, tracker.getRefractoryPeriodEndsSec(tracker.extractDimensionKey(*overflowEvent)));
+
+    // Existing slices keep working at the cap.
+    const int64_t burstTimeNs = kStartTimeNs + 30 * 1000000;
+    shared_ptr<LogEvent> trackedEvent = CreateTwoValueLogEvent(kAtomId, burstTimeNs, 1 /*uid*/, 5);
+    tracker.noteMatchedEvent(*trackedEvent);
+    EXPECT_EQ((uint64_t)std::ceil(1.0 * burstTimeNs / NS_PER_SEC) + 30,
+              tracker.getRefractoryPeriodEndsSec(tracker.extractDimensionKey(*trackedEvent)));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -13,6 +13,8 @@
 // limitations under the License.
 
 #include "condition/condition_util.h"
+#include "src/condition/CombinationConditionTracker.h"
+#include "src/condition/SimpleConditionTracker.h"
 #include "src/statsd_config.pb.h"
 
 #include <gtest/gtest.h>
@@ -21,6 +23,8 @@
 #include <vector>
 
 using namespace android::os::statsd;
+using android::sp;
+using std::unordered_map;
 using std::vector;
 
 #ifdef __ANDROID__
@@ -162,6 +166,109 @@ TEST(ConditionTrackerTest, TestNorCondition) {
     EXPECT_FALSE(evaluateCombinationCondition(children, operation, conditionResults));
 }
 
+TEST(ConditionTrackerTest, TestDirtyFlagSkipsCleanSubtree) {
+    const int64_t screenOnMatcherId = 111;
+    const int64_t screenOffMatcherId = 112;
+    const int64_t plugInMatcherId = 221;
+    const int64_t plugOutMatcherId = 222;
+    const int64_t screenOnPredicateId = 1;
+    const int64_t pluggedInPredicateId = 2;
+    const int64_t combinationPredicateId = 3;
+
+    const unordered_map<int64_t, int> atomMatchingTrackerMap = {{screenOnMatcherId, 0},
+                                                                {screenOffMatcherId, 1},
+                                                                {plugInMatcherId, 2},
+                                                                {plugOutMatcherId, 3}};
+
+    Predicate screenOnPredicate;
+    screenOnPredicate.set_id(screenOnPredicateId);
+    screenOnPredicate.mutable_simple_predicate()->set_start(screenOnMatcherId);
+    screenOnPredicate.mutable_simple_predicate()->set_stop(screenOffMatcherId);
+
+    Predicate pluggedInPredicate;
+    pluggedInPredicate.set_id(pluggedInPredicateId);
+    pluggedInPredicate.mutable_simple_predicate()->set_start(plugInMatcherId);
+    pluggedInPredicate.mutable_simple_predicate()->set_stop(plugOutMatcherId);
+
+    Predicate combinationPredicate;
+    combinationPredicate.set_id(combinationPredicateId);
+    combinationPredicate.mutable_combination()->set_operation(LogicalOperation::AND);
+    combinationPredicate.mutable_combination()->add_predicate(screenOnPredicateId);
+    combinationPredicate.mutable_combination()->add_predicate(pluggedInPredicateId);
+
+    ::google::protobuf::RepeatedPtrField<Predicate> allPredicates;
+    *allPredicates.Add() = screenOnPredicate;
+    *allPredicates.Add() = pluggedInPredicate;
+    *allPredicates.Add() = combinationPredicate;
+    const unordered_map<int64_t, int> conditionIdIndexMap = {{screenOnPredicateId, 0},
+                                                             {pluggedInPredicateId, 1},
+                                                             {combinationPredicateId, 2}};
+
+    vector<sp<ConditionTracker>> allTrackers;
+    allTrackers.push_back(new SimpleConditionTracker(ConfigKey(0, 12345), screenOnPredicateId,
+                                                     /*protoHash=*/0x1, /*index=*/0,
+                                                     screenOnPredicate.simple_predicate(),
+                                                     atomMatchingTrackerMap));
+    allTrackers.push_back(new SimpleConditionTracker(ConfigKey(0, 12345), pluggedInPredicateId,
+                                                     /*protoHash=*/0x2, /*index=*/1,
+                                                     pluggedInPredicate.simple_predicate(),
+                                                     atomMatchingTrackerMap));
+    sp<CombinationConditionTracker> combinationTracker =
+            new CombinationConditionTracker(combinationPredicateId, /*index=*/2, /*protoHash=*/0x3);
+    allTrackers.push_back(combinationTracker);
+
+    vector<uint8_t> stack(3, false);
+    vector<ConditionState> initCache(3, ConditionState::kNotEvaluated);
+    EXPECT_FALSE(combinationTracker
+                         ->init(allPredicates, allTrackers, conditionIdIndexMap, stack, initCache)
+                         .has_value());
+
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+
+    // Screen turns on. Plugged-in has never been evaluated, so AND is unknown.
+    MatchingStateBitset matcherState(4, MatchingState::kNotMatched);
+    matcherState[0] = MatchingState::kMatched;
+    vector<ConditionState> conditionCache(3, ConditionState::kNotEvaluated);
+    vector<uint8_t> changedCache(3, false);
+    combinationTracker->evaluateCondition(event, matcherState, allTrackers, conditionCache,
+                                          changedCache);
+    EXPECT_EQ(conditionCache[2], ConditionState::kUnknown);
+
+    // Device plugs in. The screen-on child is clean and is served from its cached value.
+    matcherState.assign(4, MatchingState::kNotMatched);
+    matcherState[2] = MatchingState::kMatched;
+    conditionCache.assign(3, ConditionState::kNotEvaluated);
+    changedCache.assign(3, false);
+    combinationTracker->evaluateCondition(event, matcherState, allTrackers, conditionCache,
+                                          changedCache);
+    EXPECT_EQ(conditionCache[2], ConditionState::kTrue);
+    EXPECT_TRUE(changedCache[2]);
+    EXPECT_EQ(combinationTracker->getLastConditionCache(), ConditionState::kTrue);
+
+    // An event matching none of the tracked matchers must not recurse into the tree: the
+    // children's cache slots stay untouched and the cached combination value is reported.
+    matcherState.assign(4, MatchingState::kNotMatched);
+    conditionCache.assign(3, ConditionState::kNotEvaluated);
+    changedCache.assign(3, false);
+    combinationTracker->evaluateCondition(event, matcherState, allTrackers, conditionCache,
+                                          changedCache);
+    EXPECT_EQ(conditionCache[2], ConditionState::kTrue);
+    EXPECT_FALSE(changedCache[2]);
+    EXPECT_EQ(conditionCache[0], ConditionState::kNotEvaluated);
+    EXPECT_EQ(conditionCache[1], ConditionState::kNotEvaluated);
+
+    // Screen turns off. Only the dirty branch is re-evaluated and the result updates.
+    matcherState.assign(4, MatchingState::kNotMatched);
+    matcherState[1] = MatchingState::kMatched;
+    conditionCache.assign(3, ConditionState::kNotEvaluated);
+    changedCache.assign(3, false);
+    combinationTracker->evaluateCondition(event, matcherState, allTrackers, conditionCache,
+                                          changedCache);
+    EXPECT_EQ(conditionCache[2], ConditionState::kFalse);
+    EXPECT_TRUE(changedCache[2]);
+    EXPECT_EQ(combinationTracker->getLastConditionCache(), ConditionState::kFalse);
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
@@ -0,0 +1,141 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/condition/ConditionTimeline.h"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+constexpr int64_t time_base = 10;
+constexpr int64_t ct_start_time = 200;
+
+}  // namespace
+
+TEST(ConditionTimelineTest, TestLazyReplayMatchesEagerTimer) {
+    ConditionTimer eager(false, time_base);
+
+    LazyConditionTimer lazy(false, time_base);
+    std::shared_ptr<ConditionTimeline> timeline = std::make_shared<ConditionTimeline>(false);
+    lazy.attach(timeline);
+
+    eager.onConditionChanged(true, ct_start_time + 5);
+    eager.onConditionChanged(false, ct_start_time + 40);
+    eager.onConditionChanged(true, ct_start_time + 70);
+    timeline->onConditionChanged(true, ct_start_time + 5);
+    timeline->onConditionChanged(false, ct_start_time + 40);
+    timeline->onConditionChanged(true, ct_start_time + 70);
+
+    // Attached, the per-event updates are no-ops on the wrapped timer.
+    lazy.onConditionChanged(true, ct_start_time + 5);
+    const ConditionTimer& wrapped = lazy;
+    EXPECT_EQ(false, wrapped.mCondition);
+    EXPECT_EQ(0, wrapped.mTimerNs);
+
+    // Closing the bucket catches up from the shared log first.
+    EXPECT_EQ(eager.newBucketStart(ct_start_time + 100, ct_start_time + 100),
+              lazy.newBucketStart(ct_start_time + 100, ct_start_time + 100));
+    EXPECT_EQ(eager.mCondition, wrapped.mCondition);
+    EXPECT_EQ(eager.mTimerNs, wrapped.mTimerNs);
+}
+
+TEST(ConditionTimelineTest, TestDelayedBucketCloseCorrection) {
+    ConditionTimer eager(true, time_base);
+
+    LazyConditionTimer lazy(true, time_base);
+    std::shared_ptr<ConditionTimeline> timeline = std::make_shared<ConditionTimeline>(true);
+    lazy.attach(timeline);
+
+    // Condition falls 5ns after the expected bucket boundary; the edge is in
+    // the log before the delayed close happens.
+    eager.onConditionChanged(false, ct_start_time + 105);
+    timeline->onConditionChanged(false, ct_start_time + 105);
+
+    EXPECT_EQ(eager.newBucketStart(ct_start_time + 110, ct_start_time + 100),
+              lazy.newBucketStart(ct_start_time + 110, ct_start_time + 100));
+    const ConditionTimer& wrapped = lazy;
+    EXPECT_EQ(eager.mTimerNs, wrapped.mTimerNs);
+    EXPECT_EQ(eager.mCurrentBucketStartDelayNs, wrapped.mCurrentBucketStartDelayNs);
+}
+
+TEST(ConditionTimelineTest, TestReplayStopsAtUpToNs) {
+    ConditionTimer timer(false, time_base);
+    ConditionTimeline timeline(false);
+    const int cursor = timeline.createCursor();
+
+    timeline.onConditionChanged(true, ct_start_time + 5);
+    timeline.onConditionChanged(false, ct_start_time + 20);
+    timeline.onConditionChanged(true, ct_start_time + 50);
+
+    timeline.replayInto(cursor, ct_start_time + 30, timer);
+    EXPECT_EQ(false, timer.mCondition);
+    EXPECT_EQ(15, timer.mTimerNs);
+
+    timeline.replayInto(cursor, ct_start_time + 60, timer);
+    EXPECT_EQ(true, timer.mCondition);
+    EXPECT_EQ(ct_start_time + 50, timer.mLastConditionChangeTimestampNs);
+}
+
+TEST(ConditionTimelineTest, TestCursorsConsumeIndependently) {
+    ConditionTimer fast(false, time_base);
+    ConditionTimer slow(false, time_base);
+    ConditionTimeline timeline(false);
+    const int fastCursor = timeline.createCursor();
+    const int slowCursor = timeline.createCursor();
+
+    timeline.onConditionChanged(true, ct_start_time + 5);
+    timeline.replayInto(fastCursor, ct_start_time + 10, fast);
+
+    timeline.onConditionChanged(false, ct_start_time + 25);
+    timeline.replayInto(fastCursor, ct_start_time + 30, fast);
+    // The slow subscriber still sees both edges even though the fast one is
+    // already past them.
+    timeline.replayInto(slowCursor, ct_start_time + 30, slow);
+
+    EXPECT_EQ(fast.mTimerNs, slow.mTimerNs);
+    EXPECT_EQ(20, slow.mTimerNs);
+    EXPECT_EQ(fast.mCondition, slow.mCondition);
+}
+
+TEST(ConditionTimelineTest, TestDetachCatchesUp) {
+    LazyConditionTimer lazy(false, time_base);
+    std::shared_ptr<ConditionTimeline> timeline = std::make_shared<ConditionTimeline>(false);
+    lazy.attach(timeline);
+
+    timeline->onConditionChanged(true, ct_start_time + 5);
+    timeline->onConditionChanged(false, ct_start_time + 30);
+    lazy.detach();
+
+    const ConditionTimer& wrapped = lazy;
+    EXPECT_EQ(false, wrapped.mCondition);
+    EXPECT_EQ(25, wrapped.mTimerNs);
+
+    // Detached, updates apply eagerly again.
+    lazy.onConditionChanged(true, ct_start_time + 50);
+    EXPECT_EQ(true, wrapped.mCondition);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,161 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/condition/ConditionWizard.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "src/condition/SimpleConditionTracker.h"
+#include "stats_event.h"
+#include "tests/statsd_test_util.h"
+
+using std::unordered_map;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const ConfigKey kConfigKey(0, 12345);
+
+const int ATTRIBUTION_NODE_FIELD_ID = 1;
+const int ATTRIBUTION_UID_FIELD_ID = 1;
+const int TAG_ID = 1;
+const uint64_t protoHash = 0x123456789;
+
+SimplePredicate getWakeLockHeldCondition() {
+    SimplePredicate simplePredicate;
+    simplePredicate.set_start(StringToId("WAKE_LOCK_ACQUIRE"));
+    simplePredicate.set_stop(StringToId("WAKE_LOCK_RELEASE"));
+    simplePredicate.set_stop_all(StringToId("RELEASE_ALL"));
+    simplePredicate.mutable_dimensions()->set_field(TAG_ID);
+    simplePredicate.mutable_dimensions()->add_child()->set_field(ATTRIBUTION_NODE_FIELD_ID);
+    simplePredicate.mutable_dimensions()->mutable_child(0)->set_position(Position::FIRST);
+    simplePredicate.mutable_dimensions()->mutable_child(0)->add_child()->set_field(
+            ATTRIBUTION_UID_FIELD_ID);
+    simplePredicate.set_count_nesting(false);
+    simplePredicate.set_initial_value(SimplePredicate_InitialValue_FALSE);
+    return simplePredicate;
+}
+
+unordered_map<int64_t, int> getWakeLockTrackerNameIndexMap() {
+    unordered_map<int64_t, int> trackerNameIndexMap;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_ACQUIRE")] = 0;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_RELEASE")] = 1;
+    trackerNameIndexMap[StringToId("RELEASE_ALL")] = 2;
+    return trackerNameIndexMap;
+}
+
+void makeWakeLockEvent(LogEvent* logEvent, const vector<int>& uids, const string& wl,
+                       int acquire) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, TAG_ID);
+    AStatsEvent_overwriteTimestamp(statsEvent, 0);
+
+    vector<std::string> tags(uids.size());  // vector of empty strings
+    writeAttribution(statsEvent, uids, tags);
+
+    AStatsEvent_writeString(statsEvent, wl.c_str());
+    AStatsEvent_writeInt32(statsEvent, acquire);
+
+    parseStatsEventToLogEvent(statsEvent, logEvent);
+}
+
+ConditionKey getWakeLockQueryKey(int uid) {
+    int pos[] = {1, 1, 1};
+    Field field(TAG_ID, pos, 2 /*depth*/);
+    HashableDimensionKey dim;
+    dim.addValue(FieldValue(field, Value((int32_t)uid)));
+
+    ConditionKey queryKey;
+    queryKey[StringToId("WAKE_LOCK_HELD")] = dim;
+    return queryKey;
+}
+
+// Feeds one wakelock event through the tracker; matcherIndex is 0 for acquire, 1 for
+// release.
+void evaluateWakeLockEvent(SimpleConditionTracker& tracker, int uid, int matcherIndex) {
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeWakeLockEvent(&event, {uid}, "wl", matcherIndex == 0 ? 1 : 0);
+
+    MatchingStateBitset matcherState;
+    matcherState.push_back(matcherIndex == 0 ? MatchingState::kMatched
+                                             : MatchingState::kNotMatched);
+    matcherState.push_back(matcherIndex == 1 ? MatchingState::kMatched
+                                             : MatchingState::kNotMatched);
+    matcherState.push_back(MatchingState::kNotMatched);
+
+    vector<sp<ConditionTracker>> allPredicates;
+    vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+    vector<uint8_t> changedCache(1, false);
+    tracker.evaluateCondition(event, matcherState, allPredicates, conditionCache, changedCache);
+}
+
+}  // anonymous namespace
+
+TEST(ConditionWizardTest, TestBatchProbeMatchesQuery) {
+    sp<SimpleConditionTracker> tracker = new SimpleConditionTracker(
+            kConfigKey, StringToId("WAKE_LOCK_HELD"), protoHash, 0 /*tracker index*/,
+            getWakeLockHeldCondition(), getWakeLockTrackerNameIndexMap());
+
+    evaluateWakeLockEvent(*tracker, /*uid=*/111, /*matcherIndex=*/0);
+
+    vector<sp<ConditionTracker>> allConditions({tracker});
+    sp<ConditionWizard> wizard = new ConditionWizard(allConditions);
+    ConditionBatchProbe probe = wizard->batchQuery(0, /*isPartialLink=*/false);
+
+    const ConditionKey heldKey = getWakeLockQueryKey(111);
+    EXPECT_EQ(ConditionState::kTrue, probe.query(heldKey));
+    EXPECT_EQ(wizard->query(0, heldKey, /*isPartialLink=*/false), probe.query(heldKey));
+
+    // Keys absent from the sliced state report the initial value.
+    const ConditionKey otherKey = getWakeLockQueryKey(222);
+    EXPECT_EQ(ConditionState::kFalse, probe.query(otherKey));
+    EXPECT_EQ(wizard->query(0, otherKey, /*isPartialLink=*/false), probe.query(otherKey));
+}
+
+TEST(ConditionWizardTest, TestBatchProbeInvalidatedByConditionChange) {
+    sp<SimpleConditionTracker> tracker = new SimpleConditionTracker(
+            kConfigKey, StringToId("WAKE_LOCK_HELD"), protoHash, 0 /*tracker index*/,
+            getWakeLockHeldCondition(), getWakeLockTrackerNameIndexMap());
+
+    evaluateWakeLockEvent(*tracker, /*uid=*/111, /*matcherIndex=*/0);
+
+    vector<sp<ConditionTracker>> allConditions({tracker});
+    sp<ConditionWizard> wizard = new ConditionWizard(allConditions);
+    ConditionBatchProbe probe = wizard->batchQuery(0, /*isPartialLink=*/false);
+
+    const ConditionKey heldKey = getWakeLockQueryKey(111);
+    EXPECT_EQ(ConditionState::kTrue, probe.query(heldKey));
+
+    // The release bumps the condition-state generation; the stale snapshot must fall
+    // back to a full query and see the new state.
+    evaluateWakeLockEvent(*tracker, /*uid=*/111, /*matcherIndex=*/1);
+    EXPECT_EQ(ConditionState::kFalse, probe.query(heldKey));
+    EXPECT_EQ(wizard->query(0, heldKey, /*isPartialLink=*/false), probe.query(heldKey));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -145,7 +145,7 @@ TEST(SimpleConditionTrackerTest, TestNonSlicedInitialValueFalse) {
     conditionTracker.isConditionMet(queryKey, allPredicates, false, conditionCache);
     EXPECT_EQ(ConditionState::kFalse, conditionCache[0]);
 
-    vector<MatchingState> matcherState;
+    MatchingStateBitset matcherState;
     vector<uint8_t> changedCache(1, false);
 
     // Matched stop event.
@@ -199,7 +199,7 @@ TEST(SimpleConditionTrackerTest, TestNonSlicedInitialValueUnknown) {
     conditionTracker.isConditionMet(queryKey, allPredicates, false, conditionCache);
     EXPECT_EQ(ConditionState::kUnknown, conditionCache[0]);
 
-    vector<MatchingState> matcherState;
+    MatchingStateBitset matcherState;
     vector<uint8_t> changedCache(1, false);
 
     // Matched stop event.
@@ -250,7 +250,7 @@ TEST(SimpleConditionTrackerTest, TestNonSlicedCondition) {
     // This is technically an invalid LogEvent because we do not call parseBuffer.
     LogEvent event(/*uid=*/0, /*pid=*/0);
 
-    vector<MatchingState> matcherState;
+    MatchingStateBitset matcherState;
     matcherState.push_back(MatchingState::kNotMatched);
     matcherState.push_back(MatchingState::kNotMatched);
 
@@ -338,7 +338,7 @@ TEST(SimpleConditionTrackerTest, TestNonSlicedConditionNestCounting) {
     LogEvent event(/*uid=*/0, /*pid=*/0);
 
     // one matched start
-    vector<MatchingState> matcherState;
+    MatchingStateBitset matcherState;
     matcherState.push_back(MatchingState::kMatched);
     matcherState.push_back(MatchingState::kNotMatched);
     vector<sp<ConditionTracker>> allPredicates;
@@ -413,7 +413,7 @@ TEST_P(SimpleConditionTrackerTest, TestSlicedCondition) {
         makeWakeLockEvent(&event1, uids, "wl1", /*acquire=*/1);
 
         // one matched start
-        vector<MatchingState> matcherState;
+        MatchingStateBitset matcherState;
         matcherState.push_back(MatchingState::kMatched);
         matcherState.push_back(MatchingState::kNotMatched);
         matcherState.push_back(MatchingState::kNotMatched);
@@ -518,7 +518,7 @@ TEST(SimpleConditionTrackerTest, TestSlicedWithNoOutputDim) {
     makeWakeLockEvent(&event1, uids1, uid1_wl1, /*acquire=*/1);
 
     // one matched start for uid1
-    vector<MatchingState> matcherState;
+    MatchingStateBitset matcherState;
     matcherState.push_back(MatchingState::kMatched);
     matcherState.push_back(MatchingState::kNotMatched);
     matcherState.push_back(MatchingState::kNotMatched);
@@ -610,7 +610,7 @@ TEST_P(SimpleConditionTrackerTest, TestStopAll) {
         makeWakeLockEvent(&event1, uids1, "wl1", /*acquire=*/1);
 
         // one matched start
-        vector<MatchingState> matcherState;
+        MatchingStateBitset matcherState;
         matcherState.push_back(MatchingState::kMatched);
         matcherState.push_back(MatchingState::kNotMatched);
         matcherState.push_back(MatchingState::kNotMatched);
@@ -709,7 +709,7 @@ TEST(SimpleConditionTrackerTest, TestGuardrailNotHitWhenDefaultFalse) {
         makeWakeLockEvent(&event, /*uids=*/{i}, "wl", /*acquire=*/1);
 
         // acquire, followed by release.
-        vector<MatchingState> matcherState;
+        MatchingStateBitset matcherState;
         matcherState.push_back(MatchingState::kMatched);
         matcherState.push_back(MatchingState::kNotMatched);
         vector<sp<ConditionTracker>> allPredicates;
@@ -756,7 +756,7 @@ TEST(SimpleConditionTrackerTest, TestGuardrailHitWhenDefaultUnknown) {
         makeWakeLockEvent(&event, /*uids=*/{i}, "wl", /*acquire=*/1);
 
         // acquire, followed by release.
-        vector<MatchingState> matcherState;
+        MatchingStateBitset matcherState;
         matcherState.push_back(MatchingState::kMatched);
         matcherState.push_back(MatchingState::kNotMatched);
         vector<sp<ConditionTracker>> allPredicates;
@@ -786,7 +786,7 @@ TEST(SimpleConditionTrackerTest, TestGuardrailHitWhenDefaultUnknown) {
     // one more acquire after the guardrail is hit.
     LogEvent event3(/*uid=*/0, /*pid=*/0);
     makeWakeLockEvent(&event3, /*uids=*/{i}, "wl", /*acquire=*/1);
-    vector<MatchingState> matcherState;
+    MatchingStateBitset matcherState;
     matcherState.push_back(MatchingState::kMatched);
     matcherState.push_back(MatchingState::kNotMatched);
     vector<sp<ConditionTracker>> allPredicates;
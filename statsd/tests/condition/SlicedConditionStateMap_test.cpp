@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/condition/SlicedConditionStateMap.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+HashableDimensionKey makeKey(int value) {
+    HashableDimensionKey key;
+    int pos[] = {1, 0, 0};
+    key.addValue(FieldValue(Field(1, pos, 0), Value(value)));
+    return key;
+}
+
+}  // anonymous namespace
+
+TEST(SlicedConditionStateMapTest, TestInsertFindErase) {
+    SlicedConditionStateMap slicedState;
+    EXPECT_TRUE(slicedState.empty());
+
+    slicedState[makeKey(1)] = 1;
+    slicedState[makeKey(2)] = 2;
+    ASSERT_EQ(2u, slicedState.size());
+
+    auto it = slicedState.find(makeKey(1));
+    ASSERT_NE(it, slicedState.end());
+    EXPECT_EQ(1, it->second);
+    EXPECT_EQ(slicedState.find(makeKey(3)), slicedState.end());
+
+    // operator[] on an existing key updates in place.
+    slicedState[makeKey(1)]++;
+    EXPECT_EQ(2, slicedState.find(makeKey(1))->second);
+    ASSERT_EQ(2u, slicedState.size());
+
+    slicedState.erase(slicedState.find(makeKey(1)));
+    ASSERT_EQ(1u, slicedState.size());
+    EXPECT_EQ(slicedState.find(makeKey(1)), slicedState.end());
+    EXPECT_NE(slicedState.find(makeKey(2)), slicedState.end());
+
+    // A key can be reinserted after erase (its slot was tombstoned).
+    slicedState[makeKey(1)] = 5;
+    EXPECT_EQ(5, slicedState.find(makeKey(1))->second);
+    ASSERT_EQ(2u, slicedState.size());
+
+    slicedState.clear();
+    EXPECT_TRUE(slicedState.empty());
+    EXPECT_EQ(slicedState.find(makeKey(2)), slicedState.end());
+}
+
+TEST(SlicedConditionStateMapTest, TestGrowthKeepsEntries) {
+    SlicedConditionStateMap slicedState;
+    constexpr int kNumKeys = 5000;  // Forces several rehashes.
+    for (int i = 0; i < kNumKeys; i++) {
+        slicedState[makeKey(i)] = i;
+    }
+    ASSERT_EQ(static_cast<size_t>(kNumKeys), slicedState.size());
+    for (int i = 0; i < kNumKeys; i++) {
+        auto it = slicedState.find(makeKey(i));
+        ASSERT_NE(it, slicedState.end());
+        EXPECT_EQ(i, it->second);
+    }
+}
+
+TEST(SlicedConditionStateMapTest, TestIterationVisitsAllLiveEntries) {
+    SlicedConditionStateMap slicedState;
+    for (int i = 0; i < 100; i++) {
+        slicedState[makeKey(i)] = i;
+    }
+    // Erase the even keys, leaving tombstones behind.
+    for (int i = 0; i < 100; i += 2) {
+        slicedState.erase(slicedState.find(makeKey(i)));
+    }
+
+    std::map<int, int> seen;
+    for (const auto& [key, count] : slicedState) {
+        seen[key.getValues()[0].mValue.int_value] = count;
+    }
+    ASSERT_EQ(50u, seen.size());
+    for (int i = 1; i < 100; i += 2) {
+        auto it = seen.find(i);
+        ASSERT_NE(it, seen.end());
+        EXPECT_EQ(i, it->second);
+    }
+}
+
+TEST(SlicedConditionStateMapTest, TestTombstoneHeavyChurn) {
+    SlicedConditionStateMap slicedState;
+    // Repeated start/stop cycles on disjoint keys; tombstone accumulation must not
+    // degrade correctness or strand entries.
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < 100; i++) {
+            slicedState[makeKey(round * 100 + i)]++;
+        }
+        for (int i = 0; i < 100; i++) {
+            slicedState.erase(slicedState.find(makeKey(round * 100 + i)));
+        }
+    }
+    EXPECT_TRUE(slicedState.empty());
+    EXPECT_EQ(slicedState.begin(), slicedState.end());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
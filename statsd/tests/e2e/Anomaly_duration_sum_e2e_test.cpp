@@ -596,6 +596,47 @@ TEST_F(AnomalyDurationDetectionE2eTest, TestDurationMetric_SUM_long_refractory_p
               anomalyTracker->getAlarmTimestampSec(dimensionKey1));
 }
 
+TEST_F(AnomalyDurationDetectionE2eTest, TestAnomalyAlarmRidesCoalescedWakeup) {
+    const int num_buckets = 1;
+    const uint64_t threshold_ns = NS_PER_SEC;
+    auto config = CreateStatsdConfig(num_buckets, threshold_ns, DurationMetric::SUM, true);
+
+    sendConfig(config);
+
+    auto processor = service->mProcessor;
+    ASSERT_EQ(processor->mMetricsManagers.size(), 1u);
+    ASSERT_EQ(1u, processor->mMetricsManagers.begin()->second->mAllAnomalyTrackers.size());
+
+    int64_t bucketStartTimeNs = processor->mTimeBaseNs;
+    sp<AnomalyTracker> anomalyTracker =
+            processor->mMetricsManagers.begin()->second->mAllAnomalyTrackers[0];
+
+    auto screen_off_event = CreateScreenStateChangedEvent(
+            bucketStartTimeNs + 10, android::view::DisplayStateEnum::DISPLAY_STATE_OFF);
+    processor->OnLogEvent(screen_off_event.get());
+
+    // Acquire wakelock wl1; an anomaly alarm is projected at acquire + threshold.
+    auto acquire_event = CreateAcquireWakelockEvent(bucketStartTimeNs + 11, attributionUids1,
+                                                    attributionTags1, "wl1");
+    processor->OnLogEvent(acquire_event.get());
+    const uint32_t alarmTimestampSec = anomalyTracker->getAlarmTimestampSec(dimensionKey1);
+    EXPECT_EQ((bucketStartTimeNs + 11 + threshold_ns) / NS_PER_SEC + 1, alarmTimestampSec);
+
+    // A wakeup well before the alarm, with the alarm outside the slack window:
+    // nothing fires.
+    processor->serviceDueAnomalyAlarms((int64_t)(alarmTimestampSec - 10) * NS_PER_SEC,
+                                       /*slackSec=*/5);
+    EXPECT_EQ(alarmTimestampSec, anomalyTracker->getAlarmTimestampSec(dimensionKey1));
+    EXPECT_EQ(0u, anomalyTracker->getRefractoryPeriodEndsSec(dimensionKey1));
+
+    // A wakeup within the slack window of the alarm: the anomaly alarm rides the
+    // wakeup and the anomaly is declared without waiting for the next event.
+    processor->serviceDueAnomalyAlarms((int64_t)(alarmTimestampSec - 3) * NS_PER_SEC,
+                                       /*slackSec=*/5);
+    EXPECT_EQ(0u, anomalyTracker->getAlarmTimestampSec(dimensionKey1));
+    EXPECT_GT(anomalyTracker->getRefractoryPeriodEndsSec(dimensionKey1), 0u);
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
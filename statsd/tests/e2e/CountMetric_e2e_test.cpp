@@ -2008,6 +2008,68 @@ TEST(CountMetricE2eTest, TestDimensionalSampling) {
                         2);
 }
 
+TEST(CountMetricE2eTest, TestPersistStringDictionaryInReport) {
+    // Initialize config. hash_strings_in_metric_report defaults to true.
+    StatsdConfig config;
+    config.set_persist_string_dictionary_in_report(true);
+
+    AtomMatcher testAtomMatcher =
+            CreateSimpleAtomMatcher("TestAtomMatcher", util::TEST_ATOM_REPORTED);
+    *config.add_atom_matcher() = testAtomMatcher;
+
+    CountMetric countMetric =
+            createCountMetric("CountTestAtomsPerString", testAtomMatcher.id(), nullopt, {});
+    *countMetric.mutable_dimensions_in_what() =
+            CreateDimensions(util::TEST_ATOM_REPORTED, {5 /*string_field*/});
+    *config.add_count_metric() = countMetric;
+
+    // Initialize StatsLogProcessor.
+    const uint64_t bucketStartTimeNs = 10000000000;  // 0:10
+    const uint64_t bucketSizeNs =
+            TimeUnitToBucketSizeInMillis(config.count_metric(0).bucket()) * 1000000LL;
+    ConfigKey cfgKey(12345, 98765);
+
+    sp<StatsLogProcessor> processor =
+            CreateStatsLogProcessor(bucketStartTimeNs, bucketStartTimeNs, config, cfgKey);
+
+    auto logStringDim = [&](uint64_t timestampNs, const string& stringField) {
+        auto event = CreateTestAtomReportedEventWithPrimitives(
+                timestampNs, 0 /* intField */, 0l /* longField */, 0.0f /* floatField */,
+                stringField, false /* boolField */, TestAtomReported::OFF /* enumField */);
+        processor->OnLogEvent(event.get());
+    };
+
+    logStringDim(bucketStartTimeNs + 20 * NS_PER_SEC, "dimA");
+    logStringDim(bucketStartTimeNs + 40 * NS_PER_SEC, "dimB");
+
+    // The first report uploads every referenced string.
+    vector<uint8_t> buffer;
+    ConfigMetricsReportList reports;
+    processor->onDumpReport(cfgKey, bucketStartTimeNs + bucketSizeNs + 1, false, true, ADB_DUMP,
+                            FAST, &buffer);
+    ASSERT_GT(buffer.size(), 0);
+    EXPECT_TRUE(reports.ParseFromArray(&buffer[0], buffer.size()));
+    ASSERT_EQ(1, reports.reports_size());
+    ASSERT_EQ(2, reports.reports(0).strings_size());
+    EXPECT_EQ("dimA", reports.reports(0).strings(0));
+    EXPECT_EQ("dimB", reports.reports(0).strings(1));
+
+    // The second report only carries the dictionary delta: "dimA" repeats and
+    // is referenced by hash alone, "dimC" is new.
+    logStringDim(bucketStartTimeNs + bucketSizeNs + 20 * NS_PER_SEC, "dimA");
+    logStringDim(bucketStartTimeNs + bucketSizeNs + 40 * NS_PER_SEC, "dimC");
+
+    buffer.clear();
+    reports.Clear();
+    processor->onDumpReport(cfgKey, bucketStartTimeNs + 2 * bucketSizeNs + 1, false, true,
+                            ADB_DUMP, FAST, &buffer);
+    ASSERT_GT(buffer.size(), 0);
+    EXPECT_TRUE(reports.ParseFromArray(&buffer[0], buffer.size()));
+    ASSERT_EQ(1, reports.reports_size());
+    ASSERT_EQ(1, reports.reports(0).strings_size());
+    EXPECT_EQ("dimC", reports.reports(0).strings(0));
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
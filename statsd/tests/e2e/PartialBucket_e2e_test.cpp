@@ -34,8 +34,10 @@ namespace statsd {
 #ifdef __ANDROID__
 namespace {
 const string kApp1 = "app1.sharing.1";
+const string kApp2 = "app2.sharing.2";
 
-StatsdConfig MakeCountMetricConfig(const std::optional<bool> splitBucket) {
+StatsdConfig MakeCountMetricConfig(const std::optional<bool> splitBucket,
+                                   const bool sliceByUid = true) {
     StatsdConfig config;
 
     auto appCrashMatcher = CreateProcessCrashAtomMatcher();
@@ -44,6 +46,12 @@ StatsdConfig MakeCountMetricConfig(const std::optional<bool> splitBucket) {
     countMetric->set_id(StringToId("AppCrashes"));
     countMetric->set_what(appCrashMatcher.id());
     countMetric->set_bucket(FIVE_MINUTES);
+    if (sliceByUid) {
+        // Sliced by the crashing uid, so an app change is relevant to this metric and
+        // a partial-bucket split is expected.
+        *countMetric->mutable_dimensions_in_what() = CreateDimensions(
+                util::PROCESS_LIFE_CYCLE_STATE_CHANGED, {1 /* uid field */});
+    }
     if (splitBucket.has_value()) {
         countMetric->set_split_bucket_for_app_upgrade(splitBucket.value());
     }
@@ -166,6 +174,40 @@ TEST_F(PartialBucketE2eTest, TestCountMetricSplitOnUpgrade) {
     EXPECT_EQ(1, report.metrics(0).count_metrics().data(0).bucket_info(0).count());
 }
 
+TEST_F(PartialBucketE2eTest, TestCountMetricSplitOnCoalescedUpgradeBurst) {
+    sendConfig(MakeCountMetricConfig({true}));
+    int64_t start = getElapsedRealtimeNs();  // This is the start-time the metrics producers are
+                                             // initialized with.
+    UidData uidData;
+    *uidData.add_app_info() = createApplicationInfo(/*uid*/ 1, /*version*/ 1, "v1", kApp1);
+    *uidData.add_app_info() = createApplicationInfo(/*uid*/ 2, /*version*/ 1, "v1", kApp2);
+    service->mUidMap->updateMap(start, uidData);
+
+    service->mProcessor->OnLogEvent(CreateAppCrashEvent(start + 1, 100).get());
+    // The first upgrade of a burst is applied immediately; the second lands inside the
+    // coalescing window and is queued.
+    service->mUidMap->updateApp(start + 2, kApp1, 1, 2, "v2", "", /* certificateHash */ {});
+    service->mUidMap->updateApp(start + 3, kApp2, 2, 2, "v2", "", /* certificateHash */ {});
+    // Ingested while the window is still open, so this lands in the bucket the queued
+    // split will close.
+    service->mProcessor->OnLogEvent(CreateAppCrashEvent(start + 4, 100).get());
+
+    // The dump flushes the queued upgrade, whose split keeps its own timestamp.
+    ConfigMetricsReport report =
+            getReports(service->mProcessor, start + 5, /*include_current=*/true);
+    backfillStartEndTimestamp(&report);
+
+    ASSERT_EQ(1, report.metrics_size());
+    ASSERT_EQ(1, report.metrics(0).count_metrics().data_size());
+    ASSERT_EQ(2, report.metrics(0).count_metrics().data(0).bucket_info_size());
+    const CountBucketInfo& firstBucket = report.metrics(0).count_metrics().data(0).bucket_info(0);
+    EXPECT_EQ(firstBucket.end_bucket_elapsed_nanos(), MillisToNano(NanoToMillis(start + 2)));
+    EXPECT_EQ(firstBucket.count(), 1);
+    const CountBucketInfo& secondBucket = report.metrics(0).count_metrics().data(0).bucket_info(1);
+    EXPECT_EQ(secondBucket.end_bucket_elapsed_nanos(), MillisToNano(NanoToMillis(start + 3)));
+    EXPECT_EQ(secondBucket.count(), 1);
+}
+
 TEST_F(PartialBucketE2eTest, TestCountMetricSplitOnRemoval) {
     sendConfig(MakeCountMetricConfig({true}));
     int64_t start = getElapsedRealtimeNs();  // This is the start-time the metrics producers are
@@ -254,6 +296,35 @@ TEST_F(PartialBucketE2eTest, TestCountMetricNoSplitOnUpgradeWhenDisabled) {
     EXPECT_EQ(bucketInfo.count(), 2);
 }
 
+TEST_F(PartialBucketE2eTest, TestCountMetricNoSplitOnUpgradeWhenNotSliced) {
+    // Not sliced by anything: the upgrade cannot change what this metric's data means,
+    // so no partial-bucket split should happen.
+    StatsdConfig config = MakeCountMetricConfig({true}, /*sliceByUid=*/false);
+    sendConfig(config);
+    int64_t start = getElapsedRealtimeNs();  // This is the start-time the metrics producers are
+                                             // initialized with.
+    UidData uidData;
+    *uidData.add_app_info() = createApplicationInfo(/*uid*/ 1, /*version*/ 1, "v1", kApp1);
+    service->mUidMap->updateMap(start, uidData);
+
+    // Force the uidmap to update at timestamp 2.
+    service->mProcessor->OnLogEvent(CreateAppCrashEvent(start + 1, 100).get());
+    service->mUidMap->updateApp(start + 2, kApp1, 1, 2, "v2", "", /* certificateHash */ {});
+    // Still goes into the first bucket.
+    service->mProcessor->OnLogEvent(CreateAppCrashEvent(start + 3, 100).get());
+
+    ConfigMetricsReport report =
+            getReports(service->mProcessor, start + 4, /*include_current=*/true);
+    backfillStartEndTimestamp(&report);
+
+    ASSERT_EQ(1, report.metrics_size());
+    ASSERT_EQ(1, report.metrics(0).count_metrics().data_size());
+    ASSERT_EQ(1, report.metrics(0).count_metrics().data(0).bucket_info_size());
+    const CountBucketInfo& bucketInfo = report.metrics(0).count_metrics().data(0).bucket_info(0);
+    EXPECT_EQ(bucketInfo.end_bucket_elapsed_nanos(), MillisToNano(NanoToMillis(start + 4)));
+    EXPECT_EQ(bucketInfo.count(), 2);
+}
+
 TEST_F(PartialBucketE2eTest, TestValueMetricWithoutMinPartialBucket) {
     service->mPullerManager->RegisterPullAtomCallback(
             /*uid=*/0, util::SUBSYSTEM_SLEEP_STATE, NS_PER_SEC, NS_PER_SEC * 10, {},
@@ -347,6 +347,7 @@ TEST_F(RestrictedConfigE2ETest, TestSendRestrictedMetricsChangedBroadcast) {
 
     // Remove the config and verify an empty list is received
     service->removeConfiguration(kConfigKey, kCallingUid);
+    service->waitForServiceDispatcher();
     EXPECT_EQ(receiveCount, 7);
     EXPECT_THAT(receivedMetricIds, IsEmpty());
 
@@ -448,6 +449,7 @@ TEST_F(RestrictedConfigE2ETest, TestSendRestrictedMetricsChangedBroadcastMultipl
     config.SerializeToString(&str);
     std::vector<uint8_t> configAsVec(str.begin(), str.end());
     service->addConfiguration(kConfigKey, configAsVec, callingUid2);
+    service->waitForServiceDispatcher();
 
     // Set the operation. Matches multiple configs so a union of metrics are returned.
     shared_ptr<MockPendingIntentRef> pir = SharedRefBase::make<StrictMock<MockPendingIntentRef>>();
@@ -461,6 +463,7 @@ TEST_F(RestrictedConfigE2ETest, TestSendRestrictedMetricsChangedBroadcastMultipl
 
     ConfigKey cfgKey(callingUid2, kConfigKey);
     service->removeConfiguration(kConfigKey, callingUid2);
+    service->waitForServiceDispatcher();
     service->mProcessor->onDumpReport(cfgKey, getElapsedRealtimeNs(),
                                       false /* include_current_bucket*/, true /* erase_data */,
                                       ADB_DUMP, NO_TIME_CONSTRAINTS, nullptr);
@@ -794,6 +794,8 @@ TEST_F(RestrictedEventMetricE2eTest, TestLogEventsEnforceTtls) {
     processor->OnLogEvent(event1.get(), originalEventElapsedTime);
     processor->OnLogEvent(event2.get(), newEventElapsedTime);
     processor->OnLogEvent(event3.get(), newEventElapsedTime + 100);
+    // The ttl sweep triggered by event2 runs on the WorkerPool.
+    processor->waitForPendingDbMaintenance();
     processor->flushRestrictedDataLocked(newEventElapsedTime);
 
     std::stringstream query;
@@ -1028,6 +1030,8 @@ TEST_F(RestrictedEventMetricE2eTest, TestOnLogEventMalformedDbNameDeleted) {
     processor->mLastTtlTime = originalEventElapsedTime;
     // Send log events to StatsLogProcessor.
     processor->OnLogEvent(event2.get(), newEventElapsedTime);
+    // The guardrail sweep that deletes the malformed db runs on the WorkerPool.
+    processor->waitForPendingDbMaintenance();
 
     EXPECT_FALSE(StorageManager::hasFile(fileName.c_str()));
     StorageManager::deleteFile(fileName.c_str());
@@ -231,6 +231,88 @@ TEST_F(StatsPullerTest, PullFailsAndTooFast) {
     ASSERT_EQ(0, dataHolder.size());
 }
 
+TEST_F(StatsPullerTest, PullWithStalenessToleranceReusesSnapshot) {
+    pullData.push_back(createSimpleEvent(1111L, 33));
+
+    pullSuccess = true;
+
+    vector<std::shared_ptr<LogEvent>> dataHolder;
+    EXPECT_EQ(puller.Pull(getElapsedRealtimeNs(), &dataHolder), PULL_SUCCESS);
+    ASSERT_EQ(1, dataHolder.size());
+    const int64_t generation = puller.getCacheGeneration();
+
+    // Sleep past the cool down but within the declared staleness tolerance.
+    sleep_for(std::chrono::milliseconds(11));
+
+    pullData.clear();
+    pullData.push_back(createSimpleEvent(2222L, 44));
+
+    dataHolder.clear();
+    EXPECT_EQ(puller.Pull(getElapsedRealtimeNs(), &dataHolder,
+                          /*stalenessToleranceNs=*/MillisToNano(100)),
+              PULL_SUCCESS);
+    // Served from the snapshot: old data, no new pull.
+    ASSERT_EQ(1, dataHolder.size());
+    EXPECT_EQ(1111L, dataHolder[0]->GetElapsedTimestampNs());
+    ASSERT_EQ(1, dataHolder[0]->size());
+    EXPECT_EQ(33, dataHolder[0]->getValues()[0].mValue.int_value);
+    EXPECT_EQ(generation, puller.getCacheGeneration());
+
+    // A pull without a tolerance still honors only the cool down.
+    dataHolder.clear();
+    EXPECT_EQ(puller.Pull(getElapsedRealtimeNs(), &dataHolder), PULL_SUCCESS);
+    ASSERT_EQ(1, dataHolder.size());
+    EXPECT_EQ(2222L, dataHolder[0]->GetElapsedTimestampNs());
+    EXPECT_EQ(generation + 1, puller.getCacheGeneration());
+}
+
+TEST_F(StatsPullerTest, PullWithStalenessToleranceAfterClearCache) {
+    pullData.push_back(createSimpleEvent(1111L, 33));
+
+    pullSuccess = true;
+
+    vector<std::shared_ptr<LogEvent>> dataHolder;
+    EXPECT_EQ(puller.Pull(getElapsedRealtimeNs(), &dataHolder), PULL_SUCCESS);
+    ASSERT_EQ(1, dataHolder.size());
+
+    puller.ForceClearCache();
+
+    pullData.clear();
+    pullData.push_back(createSimpleEvent(2222L, 44));
+
+    // The snapshot was invalidated, so even a tolerant pull goes to the source.
+    dataHolder.clear();
+    EXPECT_EQ(puller.Pull(getElapsedRealtimeNs(), &dataHolder,
+                          /*stalenessToleranceNs=*/MillisToNano(100)),
+              PULL_SUCCESS);
+    ASSERT_EQ(1, dataHolder.size());
+    EXPECT_EQ(2222L, dataHolder[0]->GetElapsedTimestampNs());
+}
+
+TEST_F(StatsPullerTest, PullWithStalenessToleranceDoesNotExtendFailureCache) {
+    pullData.push_back(createSimpleEvent(1111L, 33));
+
+    pullSuccess = false;
+
+    vector<std::shared_ptr<LogEvent>> dataHolder;
+    EXPECT_EQ(puller.Pull(getElapsedRealtimeNs(), &dataHolder), PULL_FAIL);
+    ASSERT_EQ(0, dataHolder.size());
+
+    // Sleep past the cool down; the failed result must not be held for the
+    // longer tolerance window.
+    sleep_for(std::chrono::milliseconds(11));
+
+    pullData.clear();
+    pullData.push_back(createSimpleEvent(2222L, 44));
+
+    pullSuccess = true;
+    EXPECT_EQ(puller.Pull(getElapsedRealtimeNs(), &dataHolder,
+                          /*stalenessToleranceNs=*/MillisToNano(100)),
+              PULL_SUCCESS);
+    ASSERT_EQ(1, dataHolder.size());
+    EXPECT_EQ(2222L, dataHolder[0]->GetElapsedTimestampNs());
+}
+
 TEST_F(StatsPullerTest, PullSameEventTime) {
     pullData.push_back(createSimpleEvent(1111L, 33));
 
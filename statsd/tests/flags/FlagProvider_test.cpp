@@ -99,24 +99,40 @@ INSTANTIATE_TEST_SUITE_P(DefaultValues, FlagProviderTest_SPlus_RealValues,
 
 TEST_P(FlagProviderTest_SPlus_RealValues, TestGetFlagBoolServerFlagTrue) {
     writeFlag(TEST_FLAG, FLAG_TRUE);
+    FlagProvider::getInstance().refreshServerFlagCache();
     EXPECT_TRUE(FlagProvider::getInstance().getFlagBool(TEST_FLAG, GetParam().flagValue));
 }
 
 TEST_P(FlagProviderTest_SPlus_RealValues, TestGetFlagBoolServerFlagFalse) {
     writeFlag(TEST_FLAG, FLAG_FALSE);
+    FlagProvider::getInstance().refreshServerFlagCache();
     EXPECT_FALSE(FlagProvider::getInstance().getFlagBool(TEST_FLAG, GetParam().flagValue));
 }
 
 TEST_F(FlagProviderTest_SPlus_RealValues, TestGetFlagBoolServerFlagEmptyDefaultFalse) {
     writeFlag(TEST_FLAG, FLAG_EMPTY);
+    FlagProvider::getInstance().refreshServerFlagCache();
     EXPECT_FALSE(FlagProvider::getInstance().getFlagBool(TEST_FLAG, FLAG_FALSE));
 }
 
 TEST_F(FlagProviderTest_SPlus_RealValues, TestGetFlagBoolServerFlagEmptyDefaultTrue) {
     writeFlag(TEST_FLAG, FLAG_EMPTY);
+    FlagProvider::getInstance().refreshServerFlagCache();
     EXPECT_TRUE(FlagProvider::getInstance().getFlagBool(TEST_FLAG, FLAG_TRUE));
 }
 
+TEST_F(FlagProviderTest_SPlus_RealValues, TestServerFlagCachedUntilRefresh) {
+    writeFlag(TEST_FLAG, FLAG_FALSE);
+    FlagProvider::getInstance().refreshServerFlagCache();
+    EXPECT_FALSE(FlagProvider::getInstance().getFlagBool(TEST_FLAG, FLAG_FALSE));
+
+    // A flag change only becomes visible at the next refresh trigger.
+    writeFlag(TEST_FLAG, FLAG_TRUE);
+    EXPECT_FALSE(FlagProvider::getInstance().getFlagBool(TEST_FLAG, FLAG_FALSE));
+    FlagProvider::getInstance().refreshServerFlagCache();
+    EXPECT_TRUE(FlagProvider::getInstance().getFlagBool(TEST_FLAG, FLAG_FALSE));
+}
+
 TEST_P(FlagProviderTest_SPlus_RealValues, TestGetBootFlagBoolServerFlagTrue) {
     writeBootFlag(TEST_FLAG, FLAG_TRUE);
     FlagProvider::getInstance().initBootFlags({TEST_FLAG});
@@ -760,6 +760,128 @@ TEST(StatsdStatsTest, TestQueueStats) {
     ASSERT_EQ(1000, report.event_queue_stats().max_size_observed_elapsed_nanos());
 }
 
+TEST(StatsdStatsTest, TestInternalAtomLoadShedding) {
+    StatsdStats stats;
+    const int atomId = 44;  // ANOMALY_DETECTED
+
+    // Normal load: every occurrence passes.
+    EXPECT_EQ(1, stats.getInternalAtomSamplingInterval());
+    EXPECT_TRUE(stats.shouldLogInternalAtom(atomId));
+    EXPECT_TRUE(stats.shouldLogInternalAtom(atomId));
+
+    // A backed-up queue doubles the sampling interval per step of depth.
+    stats.noteEventQueueSize(StatsdStats::kInternalAtomShedStartQueueSize, 1000);
+    EXPECT_EQ(2, stats.getInternalAtomSamplingInterval());
+    stats.noteEventQueueSize(
+            StatsdStats::kInternalAtomShedStartQueueSize + StatsdStats::kInternalAtomShedStepSize,
+            1000);
+    EXPECT_EQ(4, stats.getInternalAtomSamplingInterval());
+
+    // At interval 4, three occurrences are shed and the fourth is written.
+    EXPECT_FALSE(stats.shouldLogInternalAtom(atomId));
+    EXPECT_FALSE(stats.shouldLogInternalAtom(atomId));
+    EXPECT_FALSE(stats.shouldLogInternalAtom(atomId));
+    EXPECT_TRUE(stats.shouldLogInternalAtom(atomId));
+
+    // The interval never exceeds the cap, however deep the queue gets.
+    stats.noteEventQueueSize(1000000, 1000);
+    EXPECT_EQ(StatsdStats::kInternalAtomMaxSamplingInterval,
+              stats.getInternalAtomSamplingInterval());
+
+    // Occurrences, written count and the max interval are all reported, so
+    // aggregation can rescale the written counts.
+    stats.noteEventQueueSize(0, 1000);
+    StatsdStatsReport report = getStatsdStatsReport(stats, /* reset stats */ true);
+    ASSERT_EQ(1, report.internal_atom_sampling_stats_size());
+    const auto& samplingStats = report.internal_atom_sampling_stats(0);
+    EXPECT_EQ(atomId, samplingStats.atom_id());
+    EXPECT_EQ(6, samplingStats.occurrence_count());
+    EXPECT_EQ(3, samplingStats.written_count());
+    EXPECT_EQ(4, samplingStats.max_sampling_interval());
+}
+
+TEST(StatsdStatsTest, TestPipelineLatencyHistograms) {
+    StatsdStats stats;
+
+    stats.noteSocketToQueueLatency(1);
+    stats.noteSocketToQueueLatency(1000);
+    stats.noteQueueWaitLatency(1000);
+    stats.noteOnLogEventLatency(1 << 20);
+    stats.noteDumpReportLatency(0);
+
+    StatsdStatsReport report = getStatsdStatsReport(stats, /* reset stats */ true);
+    const auto& histograms = report.pipeline_latency_histograms();
+
+    // 1ns lands in bucket 0, 1000ns in bucket 9 ([512, 1024)); trailing empty
+    // buckets are trimmed from the report.
+    ASSERT_EQ(10, histograms.socket_to_queue_bucket_count_size());
+    EXPECT_EQ(1, histograms.socket_to_queue_bucket_count(0));
+    EXPECT_EQ(0, histograms.socket_to_queue_bucket_count(5));
+    EXPECT_EQ(1, histograms.socket_to_queue_bucket_count(9));
+
+    ASSERT_EQ(10, histograms.queue_wait_bucket_count_size());
+    EXPECT_EQ(1, histograms.queue_wait_bucket_count(9));
+
+    ASSERT_EQ(21, histograms.on_log_event_bucket_count_size());
+    EXPECT_EQ(1, histograms.on_log_event_bucket_count(20));
+
+    // Non-positive samples are clamped into bucket 0.
+    ASSERT_EQ(1, histograms.dump_report_bucket_count_size());
+    EXPECT_EQ(1, histograms.dump_report_bucket_count(0));
+
+    // The first dump requested a reset, so the histograms start over.
+    report = getStatsdStatsReport(stats, /* reset stats */ true);
+    EXPECT_FALSE(report.has_pipeline_latency_histograms());
+}
+
+TEST(StatsdStatsTest, TestSelfProfileSnapshotOnQueueOverflow) {
+    StatsdStats stats;
+    const int atomId = 100;
+
+    for (int i = 0; i < StatsdStats::kSelfProfileOverflowCountThreshold; i++) {
+        stats.noteEventQueueOverflow(/*oldestEventTimestampNs=*/1000, atomId,
+                                     /*isSkipped=*/false);
+    }
+
+    StatsdStatsReport report = getStatsdStatsReport(stats, /* reset stats */ false);
+    ASSERT_EQ(1, report.self_profile_snapshot_size());
+    const auto& snapshot = report.self_profile_snapshot(0);
+    EXPECT_EQ(StatsdStatsReport::SelfProfileSnapshot::TRIGGER_QUEUE_OVERFLOW, snapshot.trigger());
+    EXPECT_EQ(StatsdStats::kSelfProfileOverflowCountThreshold, snapshot.overflow_count());
+    ASSERT_EQ(1, snapshot.top_atoms_size());
+    EXPECT_EQ(atomId, snapshot.top_atoms(0).atom_id());
+    EXPECT_EQ(StatsdStats::kSelfProfileOverflowCountThreshold, snapshot.top_atoms(0).log_count());
+
+    // Captures are rate limited: a second overflow burst inside the minimum
+    // interval does not add another snapshot.
+    for (int i = 0; i < StatsdStats::kSelfProfileOverflowCountThreshold; i++) {
+        stats.noteEventQueueOverflow(/*oldestEventTimestampNs=*/1000, atomId,
+                                     /*isSkipped=*/false);
+    }
+    report = getStatsdStatsReport(stats, /* reset stats */ true);
+    ASSERT_EQ(1, report.self_profile_snapshot_size());
+
+    // The ring buffer was cleared by the reset above.
+    report = getStatsdStatsReport(stats, /* reset stats */ false);
+    EXPECT_EQ(0, report.self_profile_snapshot_size());
+}
+
+TEST(StatsdStatsTest, TestSelfProfileSnapshotOnSlowOnLogEvent) {
+    StatsdStats stats;
+
+    for (int i = 0; i < StatsdStats::kSelfProfileSlowEventCountThreshold; i++) {
+        stats.noteOnLogEventLatency(StatsdStats::kSelfProfileSlowEventThresholdNs);
+    }
+
+    StatsdStatsReport report = getStatsdStatsReport(stats, /* reset stats */ true);
+    ASSERT_EQ(1, report.self_profile_snapshot_size());
+    const auto& snapshot = report.self_profile_snapshot(0);
+    EXPECT_EQ(StatsdStatsReport::SelfProfileSnapshot::TRIGGER_ON_LOG_EVENT_LATENCY,
+              snapshot.trigger());
+    EXPECT_EQ(0, snapshot.overflow_count());
+    EXPECT_GT(snapshot.on_log_event_p99_ns(), 0);
+}
+
 TEST(StatsdStatsTest, TestAtomLoggedAndDroppedStats) {
     StatsdStats stats;
 
@@ -35,16 +35,16 @@ using std::unique_ptr;
 
 namespace {
 
-AStatsEvent* makeStatsEvent(uint64_t timestampNs) {
+AStatsEvent* makeStatsEvent(uint64_t timestampNs, int atomId = 10) {
     AStatsEvent* statsEvent = AStatsEvent_obtain();
-    AStatsEvent_setAtomId(statsEvent, 10);
+    AStatsEvent_setAtomId(statsEvent, atomId);
     AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
     AStatsEvent_build(statsEvent);
     return statsEvent;
 }
 
-std::unique_ptr<LogEvent> makeLogEvent(uint64_t timestampNs) {
-    AStatsEvent* statsEvent = makeStatsEvent(timestampNs);
+std::unique_ptr<LogEvent> makeLogEvent(uint64_t timestampNs, int atomId = 10) {
+    AStatsEvent* statsEvent = makeStatsEvent(timestampNs, atomId);
     std::unique_ptr<LogEvent> logEvent = std::make_unique<LogEvent>(/*uid=*/0, /*pid=*/0);
     parseStatsEventToLogEvent(statsEvent, logEvent.get());
     EXPECT_EQ(logEvent->GetElapsedTimestampNs(), timestampNs);
@@ -115,6 +115,134 @@ TEST(LogEventQueue_test, TestSlowConsumer) {
     writer.join();
 }
 
+TEST(LogEventQueue_test, TestPushBatch) {
+    LogEventQueue queue(5);
+    int64_t eventTimeNs = 100;
+
+    std::vector<std::unique_ptr<LogEvent>> batch;
+    for (int i = 0; i < 7; i++) {
+        batch.push_back(makeLogEvent(eventTimeNs + i * 1000));
+    }
+
+    auto results = queue.pushBatch(batch);
+    ASSERT_EQ(results.size(), 7);
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(results[i].success);
+        EXPECT_EQ(results[i].size, i + 1);
+    }
+    // Events past the queue limit are rejected with the oldest event timestamp.
+    for (int i = 5; i < 7; i++) {
+        EXPECT_FALSE(results[i].success);
+        EXPECT_EQ(results[i].oldestTimestampNs, eventTimeNs);
+        EXPECT_EQ(results[i].size, 5);
+    }
+
+    // Accepted events come out in the order they were pushed.
+    for (int i = 0; i < 5; i++) {
+        auto event = queue.waitPop();
+        EXPECT_TRUE(event != nullptr);
+        EXPECT_EQ(eventTimeNs + i * 1000, event->GetElapsedTimestampNs());
+    }
+}
+
+TEST(LogEventQueue_test, TestHighPriorityHeadroom) {
+    constexpr int kNormalAtomId = 10;
+    constexpr int kImportantAtomId = 42;
+
+    LogEventQueue queue(10);
+    queue.setHighPriorityAtomIds({kImportantAtomId});
+
+    int64_t eventTimeNs = 100;
+    // fill the base limit with normal-priority events
+    for (int i = 0; i < 10; i++, eventTimeNs++) {
+        auto result = queue.push(makeLogEvent(eventTimeNs, kNormalAtomId));
+        EXPECT_TRUE(result.success);
+        EXPECT_FALSE(result.highPriority);
+    }
+
+    // another normal push is rejected at the base limit
+    auto normalResult = queue.push(makeLogEvent(eventTimeNs++, kNormalAtomId));
+    EXPECT_FALSE(normalResult.success);
+    EXPECT_FALSE(normalResult.highPriority);
+
+    // a high-priority push still lands in the reserved headroom
+    auto importantResult = queue.push(makeLogEvent(eventTimeNs++, kImportantAtomId));
+    EXPECT_TRUE(importantResult.success);
+    EXPECT_TRUE(importantResult.highPriority);
+}
+
+TEST(LogEventQueue_test, TestWaitPopAll) {
+    LogEventQueue queue(50);
+    int64_t eventTimeNs = 100;
+    for (int i = 0; i < 10; i++) {
+        auto result = queue.push(makeLogEvent(eventTimeNs + i * 1000));
+        EXPECT_TRUE(result.success);
+    }
+
+    auto events = queue.waitPopAll();
+    ASSERT_EQ(events.size(), 10);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(events[i] != nullptr);
+        // All events are in right order.
+        EXPECT_EQ(eventTimeNs + i * 1000, events[i]->GetElapsedTimestampNs());
+    }
+    EXPECT_EQ(queue.size(), 0);
+}
+
+TEST(LogEventQueue_test, TestAdaptiveGrowth) {
+    LogEventQueue queue(/*initialSize=*/2, /*maxSize=*/16);
+    int64_t eventTimeNs = 100;
+
+    EXPECT_TRUE(queue.push(makeLogEvent(eventTimeNs)).success);
+    EXPECT_TRUE(queue.push(makeLogEvent(eventTimeNs + 1)).success);
+    // The initial limit is 2, so the queue is full now.
+    EXPECT_FALSE(queue.push(makeLogEvent(eventTimeNs + 2)).success);
+
+    // The consumer applies the requested growth at its next pop.
+    auto event = queue.waitPop();
+    EXPECT_TRUE(event != nullptr);
+    EXPECT_EQ(eventTimeNs, event->GetElapsedTimestampNs());
+
+    // One event is still queued; the doubled limit admits three more.
+    EXPECT_TRUE(queue.push(makeLogEvent(eventTimeNs + 3)).success);
+    EXPECT_TRUE(queue.push(makeLogEvent(eventTimeNs + 4)).success);
+    EXPECT_TRUE(queue.push(makeLogEvent(eventTimeNs + 5)).success);
+    EXPECT_FALSE(queue.push(makeLogEvent(eventTimeNs + 6)).success);
+
+    // Everything admitted comes out in push order across the resize.
+    EXPECT_EQ(eventTimeNs + 1, queue.waitPop()->GetElapsedTimestampNs());
+    EXPECT_EQ(eventTimeNs + 3, queue.waitPop()->GetElapsedTimestampNs());
+    EXPECT_EQ(eventTimeNs + 4, queue.waitPop()->GetElapsedTimestampNs());
+    EXPECT_EQ(eventTimeNs + 5, queue.waitPop()->GetElapsedTimestampNs());
+}
+
+TEST(LogEventQueue_test, TestIdleShrink) {
+    LogEventQueue queue(/*initialSize=*/2, /*maxSize=*/16);
+    int64_t eventTimeNs = 100;
+
+    // Grow once: fill the initial limit, overflow, let the consumer resize.
+    EXPECT_TRUE(queue.push(makeLogEvent(eventTimeNs)).success);
+    EXPECT_TRUE(queue.push(makeLogEvent(eventTimeNs + 1)).success);
+    EXPECT_FALSE(queue.push(makeLogEvent(eventTimeNs + 2)).success);
+    EXPECT_EQ(eventTimeNs, queue.waitPop()->GetElapsedTimestampNs());
+    EXPECT_EQ(eventTimeNs + 1, queue.waitPop()->GetElapsedTimestampNs());
+
+    // Pretend the last pressure was long ago; the consumer then shrinks back
+    // at its about-to-block point before waiting for the delayed producer.
+    queue.mLastPressureElapsedNs.store(0, std::memory_order_relaxed);
+    std::thread writer([&queue] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        queue.push(makeLogEvent(500));
+    });
+    EXPECT_EQ(500, queue.waitPop()->GetElapsedTimestampNs());
+    writer.join();
+
+    // The admission limit is back at the initial size.
+    EXPECT_TRUE(queue.push(makeLogEvent(501)).success);
+    EXPECT_TRUE(queue.push(makeLogEvent(502)).success);
+    EXPECT_FALSE(queue.push(makeLogEvent(503)).success);
+}
+
 TEST(LogEventQueue_test, TestQueueMaxSize) {
     StatsdStats::getInstance().reset();
 
@@ -147,6 +147,43 @@ TEST(CountMetricProducerTest, TestNonDimensionalEvents) {
     ASSERT_EQ(2UL, buckets3.size());
 }
 
+TEST(CountMetricProducerTest, TestFrozenBucketSegments) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    CountMetricProducer countProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, bucketStartTimeNs, bucketStartTimeNs);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event1, bucketStartTimeNs + 1, tagId);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event2, bucketStartTimeNs + 2, tagId);
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event1);
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
+    countProducer.flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+
+    const auto& buckets = countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY];
+    ASSERT_EQ(1UL, buckets.size());
+
+    // The bucket was frozen into its final CountBucketInfo bytes at flush time,
+    // and byteSizeLocked() reports their exact size.
+    ASSERT_FALSE(buckets[0].mFrozenBytes.empty());
+    EXPECT_EQ(buckets[0].mFrozenBytes.size(), countProducer.byteSizeLocked());
+
+    CountBucketInfo bucketInfo;
+    ASSERT_TRUE(bucketInfo.ParseFromString(buckets[0].mFrozenBytes));
+    EXPECT_EQ(0, bucketInfo.bucket_num());
+    EXPECT_EQ(2LL, bucketInfo.count());
+    EXPECT_FALSE(bucketInfo.has_condition_true_nanos());
+}
+
 TEST(CountMetricProducerTest, TestEventsWithNonSlicedCondition) {
     int64_t bucketStartTimeNs = 10000000000;
     int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
@@ -614,6 +614,54 @@ TEST(DurationMetricProducerTest, TestClearCurrentSlicedTrackerMapWhenStop) {
     EXPECT_EQ(1, durationProducer.getCurrentBucketNum());
 }
 
+TEST(DurationMetricProducerTest, TestHardDimensionLimitEvictsIdleTrackers) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int tagId = 1;
+
+    DurationMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+    metric.set_aggregation_type(DurationMetric_AggregationType_SUM);
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    FieldMatcher dimensions;
+
+    DurationMetricProducer durationProducer(
+            kConfigKey, metric, -1 /*no condition*/, {}, -1 /*what index not needed*/,
+            1 /* start index */, 2 /* stop index */, 3 /* stop_all index */, false /*nesting*/,
+            wizard, protoHash, dimensions, bucketStartTimeNs, bucketStartTimeNs);
+
+    // Fill the tracker map to the hard limit with dimensions that start and then stop.
+    const size_t hardLimit = durationProducer.mDimensionHardLimit;
+    for (size_t i = 0; i < hardLimit; i++) {
+        const MetricDimensionKey key = getMockedMetricDimensionKey(tagId, 1, std::to_string(i));
+        const int64_t startTimeNs = bucketStartTimeNs + 2 * i;
+        durationProducer.handleStartEvent(key, ConditionKey(), true /*condition*/, startTimeNs,
+                                          {});
+        auto whatIt = durationProducer.mCurrentSlicedDurationTrackerMap.find(
+                key.getDimensionKeyInWhat());
+        ASSERT_NE(whatIt, durationProducer.mCurrentSlicedDurationTrackerMap.end());
+        whatIt->second->noteStop(key.getDimensionKeyInWhat(), startTimeNs + 1, false /*stopAll*/);
+    }
+    ASSERT_EQ(hardLimit, durationProducer.mCurrentSlicedDurationTrackerMap.size());
+
+    // A fresh dimension arriving at the hard limit triggers a partial-bucket flush: the
+    // stopped trackers emit their durations to past buckets and are evicted, so the new
+    // dimension gets a slot instead of being dropped for the rest of the bucket.
+    const MetricDimensionKey freshKey = getMockedMetricDimensionKey(tagId, 1, "fresh");
+    const int64_t freshStartTimeNs = bucketStartTimeNs + 10000;
+    durationProducer.handleStartEvent(freshKey, ConditionKey(), true /*condition*/,
+                                      freshStartTimeNs, {});
+
+    ASSERT_EQ(1UL, durationProducer.mCurrentSlicedDurationTrackerMap.size());
+    EXPECT_NE(durationProducer.mCurrentSlicedDurationTrackerMap.find(
+                      freshKey.getDimensionKeyInWhat()),
+              durationProducer.mCurrentSlicedDurationTrackerMap.end());
+    EXPECT_EQ(hardLimit, durationProducer.mPastBuckets.size());
+    // The eviction flush forms a partial bucket; the bucket number does not advance.
+    EXPECT_EQ(0, durationProducer.getCurrentBucketNum());
+    EXPECT_EQ(freshStartTimeNs, durationProducer.mCurrentBucketStartTimeNs);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
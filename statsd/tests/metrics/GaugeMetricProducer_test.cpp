@@ -765,6 +765,64 @@ TEST(GaugeMetricProducerTest, TestPullNWithoutTrigger) {
     EXPECT_THAT(atomValues, UnorderedElementsAre(4, 5, 6));
 }
 
+TEST(GaugeMetricProducerTest, TestPullRandomNSamples) {
+    GaugeMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    metric.set_sampling_type(GaugeMetric::RANDOM_N_SAMPLES);
+    metric.set_max_pull_delay_sec(INT_MAX);
+    metric.set_max_num_gauge_atoms_per_bucket(3);
+    auto gaugeFieldMatcher = metric.mutable_gauge_fields_filter()->mutable_fields();
+    gaugeFieldMatcher->set_field(tagId);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    sp<EventMatcherWizard> eventMatcherWizard =
+            createEventMatcherWizard(tagId, logEventMatcherIndex);
+
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    EXPECT_CALL(*pullerManager, RegisterReceiver(tagId, kConfigKey, _, _, _)).WillOnce(Return());
+    EXPECT_CALL(*pullerManager, UnRegisterReceiver(tagId, kConfigKey, _)).WillOnce(Return());
+    EXPECT_CALL(*pullerManager, Pull(tagId, kConfigKey, _, _))
+            .WillOnce(Invoke([](int tagId, const ConfigKey&, const int64_t eventTimeNs,
+                                vector<std::shared_ptr<LogEvent>>* data) {
+                EXPECT_EQ(eventTimeNs, bucketStartTimeNs);
+                data->clear();
+                for (int value = 4; value <= 10; value++) {
+                    data->push_back(CreateRepeatedValueLogEvent(tagId, eventTimeNs, value));
+                }
+                return true;
+            }));
+
+    GaugeMetricProducer gaugeProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, logEventMatcherIndex, eventMatcherWizard,
+                                      tagId, /*triggerId=*/-1, tagId, bucketStartTimeNs,
+                                      bucketStartTimeNs, pullerManager);
+
+    EXPECT_EQ(0UL, gaugeProducer.mCurrentSlicedBucket->size());
+    gaugeProducer.prepareFirstBucket();
+    ASSERT_EQ(1UL, gaugeProducer.mCurrentSlicedBucket->size());
+    // Only max_num_gauge_atoms_per_bucket atoms are kept, but all 7 were seen by the reservoir.
+    EXPECT_EQ(3UL, gaugeProducer.mCurrentSlicedBucket->begin()->second.size());
+    EXPECT_EQ(7, gaugeProducer.mCurrentBucketAtomsSeen.begin()->second);
+
+    vector<std::shared_ptr<LogEvent>> allData;
+    allData.push_back(CreateNoValuesLogEvent(tagId, bucket2StartTimeNs + 10));
+    gaugeProducer.onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket2StartTimeNs + 30);
+    // The seen-atom counters were reset at the bucket flush; only the new pull is counted.
+    ASSERT_EQ(1UL, gaugeProducer.mCurrentBucketAtomsSeen.size());
+    EXPECT_EQ(1, gaugeProducer.mCurrentBucketAtomsSeen.begin()->second);
+
+    ASSERT_EQ(1UL, gaugeProducer.mPastBuckets.size());
+    ASSERT_EQ(3UL, gaugeProducer.mPastBuckets.begin()->second.back().mAggregatedAtoms.size());
+    for (const auto& [key, timestamps] :
+         gaugeProducer.mPastBuckets.begin()->second.back().mAggregatedAtoms) {
+        const int value = key.getAtomFieldValues().getValues().begin()->mValue.int_value;
+        EXPECT_GE(value, 4);
+        EXPECT_LE(value, 10);
+    }
+}
+
 TEST(GaugeMetricProducerTest, TestRemoveDimensionInOutput) {
     GaugeMetric metric;
     metric.set_id(metricId);
@@ -999,6 +1057,93 @@ TEST(GaugeMetricProducerTest, TestPullDimensionalSampling) {
                              {bucketStartTimeNs + 10, bucketStartTimeNs + 20});
 }
 
+TEST(GaugeMetricProducerTest, TestReportChangedSlicesOnly) {
+    int triggerId = 5;
+    GaugeMetric metric = createGaugeMetric("GaugeDeltaReport", metricId,
+                                           GaugeMetric::FIRST_N_SAMPLES, nullopt, triggerId);
+    metric.set_max_pull_delay_sec(INT_MAX);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1});
+    metric.set_report_changed_slices_only(true);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    sp<EventMatcherWizard> eventMatcherWizard =
+            createEventMatcherWizard(tagId, logEventMatcherIndex);
+
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+
+    EXPECT_CALL(*pullerManager, Pull(tagId, kConfigKey, _, _))
+            .WillOnce(Invoke([](int tagId, const ConfigKey&, const int64_t eventTimeNs,
+                                vector<std::shared_ptr<LogEvent>>* data) {
+                data->clear();
+                data->push_back(makeUidLogEvent(tagId, eventTimeNs, 1001, 5, 10));
+                data->push_back(makeUidLogEvent(tagId, eventTimeNs, 1002, 10, 10));
+                return true;
+            }))
+            .WillOnce(Invoke([](int tagId, const ConfigKey&, const int64_t eventTimeNs,
+                                vector<std::shared_ptr<LogEvent>>* data) {
+                // Uid 1001 reads the same value; uid 1002 changed.
+                data->clear();
+                data->push_back(makeUidLogEvent(tagId, eventTimeNs, 1001, 5, 10));
+                data->push_back(makeUidLogEvent(tagId, eventTimeNs, 1002, 12, 10));
+                return true;
+            }))
+            .WillOnce(Invoke([](int tagId, const ConfigKey&, const int64_t eventTimeNs,
+                                vector<std::shared_ptr<LogEvent>>* data) {
+                // Both slices unchanged.
+                data->clear();
+                data->push_back(makeUidLogEvent(tagId, eventTimeNs, 1001, 5, 10));
+                data->push_back(makeUidLogEvent(tagId, eventTimeNs, 1002, 12, 10));
+                return true;
+            }));
+
+    GaugeMetricProducer gaugeProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, logEventMatcherIndex, eventMatcherWizard,
+                                      tagId, triggerId, tagId, bucketStartTimeNs, bucketStartTimeNs,
+                                      pullerManager);
+    gaugeProducer.prepareFirstBucket();
+
+    LogEvent triggerEvent(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&triggerEvent, triggerId, bucketStartTimeNs + 10, 5);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, triggerEvent);
+
+    // The first data-erasing dump is always a full report.
+    ProtoOutputStream output1;
+    std::set<string> strSet;
+    int64_t dump1TimeNs = bucketStartTimeNs + 10 * NS_PER_SEC;
+    gaugeProducer.onDumpReport(dump1TimeNs, true /* include current buckets */, true,
+                               NO_TIME_CONSTRAINTS /* dumpLatency */, &strSet, &output1);
+    StatsLogReport report = outputStreamToProto(&output1);
+    EXPECT_FALSE(report.delta_report());
+    ASSERT_EQ(2, report.gauge_metrics().data_size());
+
+    triggerEvent.setElapsedTimestampNs(dump1TimeNs + 10);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, triggerEvent);
+
+    // The second dump only carries the slice whose values changed.
+    ProtoOutputStream output2;
+    int64_t dump2TimeNs = dump1TimeNs + 10 * NS_PER_SEC;
+    gaugeProducer.onDumpReport(dump2TimeNs, true /* include current buckets */, true,
+                               NO_TIME_CONSTRAINTS /* dumpLatency */, &strSet, &output2);
+    report = outputStreamToProto(&output2);
+    backfillDimensionPath(&report);
+    backfillAggregatedAtoms(&report);
+    EXPECT_TRUE(report.delta_report());
+    ASSERT_EQ(1, report.gauge_metrics().data_size());
+    ValidateUidDimension(report.gauge_metrics().data(0).dimensions_in_what(), tagId, 1002);
+
+    triggerEvent.setElapsedTimestampNs(dump2TimeNs + 10);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, triggerEvent);
+
+    // Nothing changed since the last report: the delta report is empty.
+    ProtoOutputStream output3;
+    gaugeProducer.onDumpReport(dump2TimeNs + 10 * NS_PER_SEC, true /* include current buckets */,
+                               true, NO_TIME_CONSTRAINTS /* dumpLatency */, &strSet, &output3);
+    report = outputStreamToProto(&output3);
+    EXPECT_TRUE(report.delta_report());
+    ASSERT_EQ(0, report.gauge_metrics().data_size());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -0,0 +1,85 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/HistogramValue.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace testing;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+TEST(HistogramValueTest, TestAddValueBinAssignment) {
+    const BinStarts bins = {0.0f, 10.0f, 20.0f};
+    HistogramValue histogram;
+    histogram.addValue(-1.0f, bins);  // underflow
+    histogram.addValue(0.0f, bins);   // first finite bin: [0, 10)
+    histogram.addValue(9.9f, bins);
+    histogram.addValue(10.0f, bins);  // second finite bin: [10, 20)
+    histogram.addValue(25.0f, bins);  // overflow
+
+    EXPECT_THAT(histogram.getCompactedBinCounts(), ElementsAre(1, 2, 1, 1));
+}
+
+TEST(HistogramValueTest, TestCompactedBinCountsCollapseEmptyRuns) {
+    const BinStarts bins = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f};
+    HistogramValue histogram;
+    histogram.addValue(0.5f, bins);
+    histogram.addValue(4.5f, bins);
+    histogram.addValue(4.5f, bins);
+
+    // underflow empty, bin 1 has one value, bins [1, 4) empty, bin 5 has two
+    // values, overflow empty and therefore dropped.
+    EXPECT_THAT(histogram.getCompactedBinCounts(), ElementsAre(-1, 1, -3, 2));
+}
+
+TEST(HistogramValueTest, TestEmptyHistogram) {
+    const BinStarts bins = {0.0f, 10.0f};
+    HistogramValue histogram;
+    EXPECT_TRUE(histogram.isEmpty());
+    EXPECT_THAT(histogram.getCompactedBinCounts(), IsEmpty());
+
+    histogram.addValue(5.0f, bins);
+    EXPECT_FALSE(histogram.isEmpty());
+}
+
+TEST(HistogramValueTest, TestGenerateLinearBins) {
+    const BinStarts bins = generateLinearBins(0.0f, 50.0f, 5);
+    EXPECT_THAT(bins, ElementsAre(0.0f, 10.0f, 20.0f, 30.0f, 40.0f, 50.0f));
+}
+
+TEST(HistogramValueTest, TestGenerateExponentialBins) {
+    const BinStarts bins = generateExponentialBins(1.0f, 16.0f, 4);
+    ASSERT_EQ(bins.size(), 5u);
+    EXPECT_FLOAT_EQ(bins[0], 1.0f);
+    EXPECT_FLOAT_EQ(bins[1], 2.0f);
+    EXPECT_FLOAT_EQ(bins[2], 4.0f);
+    EXPECT_FLOAT_EQ(bins[3], 8.0f);
+    EXPECT_FLOAT_EQ(bins[4], 16.0f);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
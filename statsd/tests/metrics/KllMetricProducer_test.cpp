@@ -61,8 +61,7 @@ const int64_t bucket5StartTimeNs = bucketStartTimeNs + 4 * bucketSizeNs;
 const int64_t bucket6StartTimeNs = bucketStartTimeNs + 5 * bucketSizeNs;
 
 static void assertPastBucketsSingleKey(
-        const std::unordered_map<MetricDimensionKey,
-                                 std::vector<PastBucket<unique_ptr<KllQuantile>>>>& mPastBuckets,
+        const PastBucketMap<unique_ptr<KllQuantile>>& mPastBuckets,
         const std::initializer_list<int>& expectedKllCountsList,
         const std::initializer_list<int64_t>& expectedDurationNsList,
         const std::initializer_list<int64_t>& expectedStartTimeNsList,
@@ -82,7 +81,7 @@ static void assertPastBucketsSingleKey(
     }
 
     ASSERT_EQ(1, mPastBuckets.size());
-    const vector<PastBucket<unique_ptr<KllQuantile>>>& buckets = mPastBuckets.begin()->second;
+    const PastBucketColumns<unique_ptr<KllQuantile>>& buckets = mPastBuckets.begin()->second;
     ASSERT_EQ(expectedKllCounts.size(), buckets.size());
 
     for (int i = 0; i < expectedKllCounts.size(); i++) {
@@ -454,8 +453,9 @@ TEST(KllMetricProducerTest, TestByteSize) {
     kllProducer->onMatchedLogEvent(1 /*log matcher index*/, event2);
     kllProducer->flushIfNeededLocked(bucket2StartTimeNs);
 
-    const size_t expectedSize = kllProducer->kBucketSize + 4 /* one int aggIndex entry */ +
-                                16 /* two int64_t entries in KllQuantile object */;
+    const size_t expectedSize =
+            kllProducer->kBucketSize + 4 /* one int aggIndex entry */ +
+            kllProducer->mPastBuckets.begin()->second.back().aggregates[0]->MemoryFootprint();
 
     EXPECT_EQ(expectedSize, kllProducer->byteSize());
 }
@@ -226,7 +226,7 @@ TEST(MaxDurationTrackerTest, TestMaxDurationWithCondition) {
     int64_t metricId = 1;
     MaxDurationTracker tracker(kConfigKey, metricId, eventKey, wizard, 1, false, bucketStartTimeNs,
                                0, bucketStartTimeNs, bucketSizeNs, true, false, {});
-    EXPECT_TRUE(tracker.mAnomalyTrackers.empty());
+    EXPECT_TRUE(tracker.mContext->anomalyTrackers.empty());
 
     tracker.noteStart(key1, false, eventStartTimeNs, conditionKey1,
                       StatsdStats::kDimensionKeySizeHardLimitMin);
@@ -61,7 +61,7 @@ const int64_t bucket6StartTimeNs = bucketStartTimeNs + 5 * bucketSizeNs;
 double epsilon = 0.001;
 
 static void assertPastBucketValuesSingleKey(
-        const std::unordered_map<MetricDimensionKey, std::vector<PastBucket<Value>>>& mPastBuckets,
+        const PastBucketMap<Value>& mPastBuckets,
         const std::initializer_list<int>& expectedValuesList,
         const std::initializer_list<int64_t>& expectedDurationNsList,
         const std::initializer_list<int64_t>& expectedCorrectionNsList,
@@ -86,7 +86,7 @@ static void assertPastBucketValuesSingleKey(
     ASSERT_EQ(1, mPastBuckets.size());
     ASSERT_EQ(expectedValues.size(), mPastBuckets.begin()->second.size());
 
-    const vector<PastBucket<Value>>& buckets = mPastBuckets.begin()->second;
+    const PastBucketColumns<Value>& buckets = mPastBuckets.begin()->second;
     for (int i = 0; i < expectedValues.size(); i++) {
         EXPECT_EQ(expectedValues[i], buckets[i].aggregates[0].long_value)
                 << "Values differ at index " << i;
@@ -401,6 +401,105 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsNoCondition) {
                                     {bucket2StartTimeNs, bucket3StartTimeNs, bucket4StartTimeNs});
 }
 
+TEST(NumericValueMetricProducerTest, TestScheduledPullAtRegisteredBoundary) {
+    ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    EXPECT_CALL(*pullerManager, Pull(tagId, kConfigKey, bucketStartTimeNs, _))
+            .WillOnce(Invoke([](int tagId, const ConfigKey&, const int64_t,
+                                vector<std::shared_ptr<LogEvent>>* data) {
+                data->clear();
+                data->push_back(CreateRepeatedValueLogEvent(tagId, bucketStartTimeNs, 3));
+                return true;
+            }));
+
+    sp<NumericValueMetricProducer> valueProducer =
+            NumericValueMetricProducerTestHelper::createValueProducerNoConditions(pullerManager,
+                                                                                  metric);
+
+    // Delivery for the registered boundary, with the alarm a little late: the
+    // data is attributed to that boundary directly.
+    vector<shared_ptr<LogEvent>> allData;
+    allData.push_back(CreateRepeatedValueLogEvent(tagId, bucket2StartTimeNs + 1, 11));
+    valueProducer->onScheduledDataPulled(allData, PullResult::PULL_RESULT_SUCCESS,
+                                         bucket2StartTimeNs + 3, bucket2StartTimeNs);
+    ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
+    ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
+    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    EXPECT_EQ(true, curBase.has_value());
+    EXPECT_EQ(11, curBase.value().long_value);
+    assertPastBucketValuesSingleKey(valueProducer->mPastBuckets, {8}, {bucketSizeNs}, {0},
+                                    {bucketStartTimeNs}, {bucket2StartTimeNs});
+
+    // A scheduled time that does not match the current bucket end falls back to
+    // the snapping path, which attributes the data to the previous boundary.
+    allData.clear();
+    allData.push_back(CreateRepeatedValueLogEvent(tagId, bucket3StartTimeNs + 1, 23));
+    valueProducer->onScheduledDataPulled(allData, PullResult::PULL_RESULT_SUCCESS,
+                                         bucket3StartTimeNs + 5, bucket2StartTimeNs);
+    ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
+    ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
+    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    EXPECT_EQ(true, curBase.has_value());
+    EXPECT_EQ(23, curBase.value().long_value);
+    assertPastBucketValuesSingleKey(
+            valueProducer->mPastBuckets, {8, 12}, {bucketSizeNs, bucketSizeNs}, {0, 0},
+            {bucketStartTimeNs, bucket2StartTimeNs}, {bucket2StartTimeNs, bucket3StartTimeNs});
+    EXPECT_EQ(bucket3StartTimeNs, valueProducer->mCurrentBucketStartTimeNs);
+}
+
+TEST(NumericValueMetricProducerTest, TestPulledRateAggregation) {
+    ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
+    metric.set_aggregation_type(ValueMetric::RATE);
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    EXPECT_CALL(*pullerManager, Pull(tagId, kConfigKey, bucketStartTimeNs, _))
+            .WillOnce(Invoke([](int tagId, const ConfigKey&, const int64_t,
+                                vector<std::shared_ptr<LogEvent>>* data) {
+                data->clear();
+                data->push_back(CreateRepeatedValueLogEvent(tagId, bucketStartTimeNs, 3));
+                return true;
+            }));
+
+    sp<NumericValueMetricProducer> valueProducer =
+            NumericValueMetricProducerTestHelper::createValueProducerNoConditions(pullerManager,
+                                                                                  metric);
+
+    // The initial pull seeds the base and the rate window but produces no sample.
+    EXPECT_EQ(bucketStartTimeNs, valueProducer->mPrevPullElapsedTimeNs);
+
+    // A mid-bucket pull yields one rate sample: diff 6 over half a bucket.
+    const int64_t midBucketTimeNs = bucketStartTimeNs + bucketSizeNs / 2;
+    vector<shared_ptr<LogEvent>> allData;
+    allData.push_back(CreateRepeatedValueLogEvent(tagId, midBucketTimeNs, 9));
+    valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, midBucketTimeNs);
+
+    const double rate1 = 6.0 * NS_PER_SEC / (midBucketTimeNs - bucketStartTimeNs);
+    ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
+    const auto& intervals = valueProducer->mCurrentSlicedBucket.begin()->second.intervals;
+    ASSERT_EQ(3UL, intervals.size());
+    EXPECT_NEAR(rate1, intervals[0].aggregate.double_value, epsilon);
+    EXPECT_NEAR(rate1, intervals[1].aggregate.double_value, epsilon);
+    EXPECT_NEAR(rate1, intervals[2].aggregate.double_value, epsilon);
+
+    // The bucket boundary pull yields a second, slower sample: diff 2 over the
+    // remaining half bucket. Bucket boundary pulls snap to bucket end - 1.
+    allData.clear();
+    allData.push_back(CreateRepeatedValueLogEvent(tagId, bucket2StartTimeNs + 1, 11));
+    valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket2StartTimeNs);
+
+    const double rate2 = 2.0 * NS_PER_SEC / (bucket2StartTimeNs - 1 - midBucketTimeNs);
+    ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
+    ASSERT_EQ(1UL, valueProducer->mPastBuckets.size());
+    const PastBucketColumns<Value>& buckets = valueProducer->mPastBuckets.begin()->second;
+    ASSERT_EQ(1UL, buckets.size());
+    ASSERT_EQ(3UL, buckets[0].aggregates.size());
+    EXPECT_EQ(0, buckets[0].aggIndex[0]);
+    EXPECT_EQ(1, buckets[0].aggIndex[1]);
+    EXPECT_EQ(2, buckets[0].aggIndex[2]);
+    EXPECT_NEAR(rate2, buckets[0].aggregates[0].double_value, epsilon);           // min
+    EXPECT_NEAR(rate1, buckets[0].aggregates[1].double_value, epsilon);           // max
+    EXPECT_NEAR((rate1 + rate2) / 2, buckets[0].aggregates[2].double_value, epsilon);  // avg
+}
+
 TEST_P(NumericValueMetricProducerTest_PartialBucket, TestPartialBucketCreated) {
     ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
     sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
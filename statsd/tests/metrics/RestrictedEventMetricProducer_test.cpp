@@ -159,6 +159,35 @@ TEST_F(RestrictedEventMetricProducerTest, TestOnMatchedLogEventWithCondition) {
                 ElementsAre("atomId", "elapsedTimestampNs", "wallTimestampNs", "field_1"));
 }
 
+TEST_F(RestrictedEventMetricProducerTest, TestEventsNotVisibleUntilFlush) {
+    EventMetric metric;
+    metric.set_id(metricId1);
+    RestrictedEventMetricProducer producer(configKey, metric,
+                                           /*conditionIndex=*/-1,
+                                           /*initialConditionCache=*/{}, new ConditionWizard(),
+                                           /*protoHash=*/0x1234567890,
+                                           /*startTimeNs=*/0);
+    std::unique_ptr<LogEvent> event1 = CreateRestrictedLogEvent(/*atomTag=*/123, /*timestampNs=*/1);
+
+    producer.onMatchedLogEvent(/*matcherIndex=*/1, *event1);
+
+    // The event is streamed into the db immediately, but stays invisible to
+    // readers until the streaming transaction is committed by the flush.
+    EXPECT_FALSE(metricTableExist(metricId1));
+
+    producer.flushRestrictedData();
+
+    stringstream query;
+    query << "SELECT * FROM metric_" << metricId1;
+    string err;
+    vector<int32_t> columnTypes;
+    vector<string> columnNames;
+    vector<vector<string>> rows;
+    EXPECT_TRUE(dbutils::query(configKey, query.str(), rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0][1], to_string(event1->GetElapsedTimestampNs()));
+}
+
 TEST_F(RestrictedEventMetricProducerTest, TestOnDumpReportNoOp) {
     EventMetric metric;
     metric.set_id(metricId1);
@@ -42,6 +42,11 @@ public:
                             vector<std::shared_ptr<LogEvent>>* data));
     MOCK_METHOD4(Pull, bool(const int pullCode, const vector<int32_t>& uids,
                             const int64_t eventTimeNs, vector<std::shared_ptr<LogEvent>>* data));
+    MOCK_METHOD5(Pull, bool(const int pullCode, const ConfigKey& key, int64_t eventTimeNs,
+                            vector<std::shared_ptr<LogEvent>>* data, int64_t stalenessToleranceNs));
+    MOCK_METHOD5(Pull,
+                 bool(const int pullCode, const vector<int32_t>& uids, const int64_t eventTimeNs,
+                      vector<std::shared_ptr<LogEvent>>* data, int64_t stalenessToleranceNs));
     MOCK_METHOD2(RegisterPullUidProvider,
                  void(const ConfigKey& configKey, const wp<PullUidProvider>& provider));
     MOCK_METHOD2(UnregisterPullUidProvider,
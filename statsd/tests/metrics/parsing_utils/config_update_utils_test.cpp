@@ -74,6 +74,7 @@ unordered_map<int64_t, int> oldMetricProducerMap;
 vector<sp<AnomalyTracker>> oldAnomalyTrackers;
 unordered_map<int64_t, int> oldAlertTrackerMap;
 vector<sp<AlarmTracker>> oldAlarmTrackers;
+unordered_map<int, vector<sp<BurstTracker>>> oldMatcherToBurstTrackers;
 unordered_map<int, vector<int>> tmpConditionToMetricMap;
 unordered_map<int, vector<int>> tmpTrackerToMetricMap;
 unordered_map<int, vector<int>> tmpTrackerToConditionMap;
@@ -92,7 +93,8 @@ bool initConfig(const StatsdConfig& config) {
                     oldMetricProducers, oldMetricProducerMap, oldAnomalyTrackers, oldAlarmTrackers,
                     tmpConditionToMetricMap, tmpTrackerToMetricMap, tmpTrackerToConditionMap,
                     tmpActivationAtomTrackerToMetricMap, tmpDeactivationAtomTrackerToMetricMap,
-                    oldAlertTrackerMap, metricsWithActivation, oldStateHashes, noReportMetricIds)
+                    oldAlertTrackerMap, oldMatcherToBurstTrackers, metricsWithActivation,
+                    oldStateHashes, noReportMetricIds)
                     .has_value();
 }
 
@@ -123,6 +125,7 @@ public:
         oldMetricProducerMap.clear();
         oldAnomalyTrackers.clear();
         oldAlarmTrackers.clear();
+        oldMatcherToBurstTrackers.clear();
         tmpConditionToMetricMap.clear();
         tmpTrackerToMetricMap.clear();
         tmpTrackerToConditionMap.clear();
@@ -806,7 +809,7 @@ TEST_F(ConfigUpdateTest, TestUpdateConditions) {
     ASSERT_EQ(oldConditionTrackers[0]->getConditionId(), simple1Id);
     LogEvent event(/*uid=*/0, /*pid=*/0);  // Empty event is fine since there are no dimensions.
     // Mark the stop matcher as matched, condition should be false.
-    vector<MatchingState> eventMatcherValues(6, MatchingState::kNotMatched);
+    MatchingStateBitset eventMatcherValues(6, MatchingState::kNotMatched);
     eventMatcherValues[1] = MatchingState::kMatched;
     vector<ConditionState> tmpConditionCache(6, ConditionState::kNotEvaluated);
     vector<uint8_t> conditionChangeCache(6, false);
@@ -2621,7 +2624,7 @@ TEST_F(ConfigUpdateTest, TestUpdateDurationMetrics) {
     // Make some sliced conditions true.
     int uid1 = 10;
     int uid2 = 11;
-    vector<MatchingState> matchingStates(8, MatchingState::kNotMatched);
+    MatchingStateBitset matchingStates(8, MatchingState::kNotMatched);
     matchingStates[2] = kMatched;
     vector<ConditionState> conditionCache(5, ConditionState::kNotEvaluated);
     vector<uint8_t> changedCache(5, false);
@@ -2692,8 +2695,10 @@ TEST_F(ConfigUpdateTest, TestUpdateDurationMetrics) {
     vector<sp<ConditionTracker>> newConditionTrackers(5);
     reverse_copy(oldConditionTrackers.begin(), oldConditionTrackers.end(),
                  newConditionTrackers.begin());
-    vector<Predicate> conditionProtos(5);
-    reverse_copy(config.predicate().begin(), config.predicate().end(), conditionProtos.begin());
+    ::google::protobuf::RepeatedPtrField<Predicate> conditionProtos;
+    for (auto it = config.predicate().rbegin(); it != config.predicate().rend(); ++it) {
+        *conditionProtos.Add() = *it;
+    }
     for (int i = 0; i < newConditionTrackers.size(); i++) {
         EXPECT_EQ(newConditionTrackers[i]->onConfigUpdated(conditionProtos, i, newConditionTrackers,
                                                            newAtomMatchingTrackerMap,
@@ -2820,7 +2825,7 @@ TEST_F(ConfigUpdateTest, TestUpdateDurationMetrics) {
     EXPECT_EQ(durationProducer1->mStopAllIndex, matcher7Index);
     EXPECT_EQ(durationProducer1->mCurrentSlicedDurationTrackerMap.size(), 2);
     for (const auto& durationTrackerIt : durationProducer1->mCurrentSlicedDurationTrackerMap) {
-        EXPECT_EQ(durationTrackerIt.second->mConditionTrackerIndex, predicate4Index);
+        EXPECT_EQ(durationTrackerIt.second->mContext->conditionTrackerIndex, predicate4Index);
     }
     DurationMetricProducer* durationProducer2 =
             static_cast<DurationMetricProducer*>(newMetricProducers[duration2Index].get());
@@ -3810,9 +3815,11 @@ TEST_F(ConfigUpdateTest, TestUpdateAlerts) {
 
     unordered_map<int64_t, int> newAlertTrackerMap;
     vector<sp<AnomalyTracker>> newAnomalyTrackers;
-    EXPECT_EQ(updateAlerts(config, currentTimeNs, newMetricProducerMap, replacedMetrics,
+    unordered_map<int, vector<sp<BurstTracker>>> newMatcherToBurstTrackers;
+    EXPECT_EQ(updateAlerts(config, key, currentTimeNs, newMetricProducerMap, replacedMetrics,
                            oldAlertTrackerMap, oldAnomalyTrackers, anomalyAlarmMonitor,
-                           newMetricProducers, newAlertTrackerMap, newAnomalyTrackers),
+                           oldAtomMatchingTrackerMap, newMetricProducers, newAlertTrackerMap,
+                           newAnomalyTrackers, newMatcherToBurstTrackers),
               nullopt);
 
     unordered_map<int64_t, int> expectedAlertMap = {
@@ -3847,7 +3854,8 @@ TEST_F(ConfigUpdateTest, TestUpdateAlerts) {
                                  newAnomalyTrackers[alert4Index]));
     ASSERT_EQ(durationProducer->mCurrentSlicedDurationTrackerMap.size(), 1);
     for (const auto& durationTrackerIt : durationProducer->mCurrentSlicedDurationTrackerMap) {
-        EXPECT_EQ(durationTrackerIt.second->mAnomalyTrackers, durationProducer->mAnomalyTrackers);
+        EXPECT_EQ(durationTrackerIt.second->mContext->anomalyTrackers,
+                  durationProducer->mAnomalyTrackers);
     }
 
     // Verify alerts have the correct subscriptions. Use subscription id as proxy for equivalency.
@@ -76,6 +76,7 @@ unordered_map<int, vector<int>> trackerToConditionMap;
 unordered_map<int, vector<int>> activationAtomTrackerToMetricMap;
 unordered_map<int, vector<int>> deactivationAtomTrackerToMetricMap;
 vector<int> metricsWithActivation;
+unordered_map<int, vector<sp<BurstTracker>>> matcherToBurstTrackers;
 map<int64_t, uint64_t> stateProtoHashes;
 set<int64_t> noReportMetricIds;
 
@@ -87,8 +88,8 @@ optional<InvalidConfigReason> initConfig(const StatsdConfig& config) {
             atomMatchingTrackerMap, allConditionTrackers, conditionTrackerMap, allMetricProducers,
             metricProducerMap, allAnomalyTrackers, allAlarmTrackers, conditionToMetricMap,
             trackerToMetricMap, trackerToConditionMap, activationAtomTrackerToMetricMap,
-            deactivationAtomTrackerToMetricMap, alertTrackerMap, metricsWithActivation,
-            stateProtoHashes, noReportMetricIds);
+            deactivationAtomTrackerToMetricMap, alertTrackerMap, matcherToBurstTrackers,
+            metricsWithActivation, stateProtoHashes, noReportMetricIds);
 }
 
 StatsdConfig buildCircleMatchers() {
@@ -1363,9 +1364,11 @@ TEST_F(MetricsManagerUtilTest, TestCreateAnomalyTrackerInvalidMetric) {
     sp<AlarmMonitor> anomalyAlarmMonitor;
     vector<sp<MetricProducer>> metricProducers;
     optional<InvalidConfigReason> invalidConfigReason;
+    unordered_map<int, vector<sp<BurstTracker>>> burstTrackers;
     // Pass in empty metric producers, causing an error.
-    EXPECT_EQ(createAnomalyTracker(alert, anomalyAlarmMonitor, UPDATE_NEW, /*updateTime=*/123, {},
-                                   metricProducers, invalidConfigReason),
+    EXPECT_EQ(createAnomalyTracker(alert, kConfigKey, anomalyAlarmMonitor, UPDATE_NEW,
+                                   /*updateTime=*/123, {}, {}, metricProducers, burstTrackers,
+                                   invalidConfigReason),
               nullopt);
     EXPECT_EQ(invalidConfigReason,
               createInvalidConfigReasonWithAlert(INVALID_CONFIG_REASON_ALERT_METRIC_NOT_FOUND,
@@ -1387,8 +1390,10 @@ TEST_F(MetricsManagerUtilTest, TestCreateAnomalyTrackerNoThreshold) {
             kConfigKey, metric, 0, {ConditionState::kUnknown}, wizard, 0x0123456789, 0, 0)});
     sp<AlarmMonitor> anomalyAlarmMonitor;
     optional<InvalidConfigReason> invalidConfigReason;
-    EXPECT_EQ(createAnomalyTracker(alert, anomalyAlarmMonitor, UPDATE_NEW, /*updateTime=*/123,
-                                   {{1, 0}}, metricProducers, invalidConfigReason),
+    unordered_map<int, vector<sp<BurstTracker>>> burstTrackers;
+    EXPECT_EQ(createAnomalyTracker(alert, kConfigKey, anomalyAlarmMonitor, UPDATE_NEW,
+                                   /*updateTime=*/123, {{1, 0}}, {}, metricProducers, burstTrackers,
+                                   invalidConfigReason),
               nullopt);
     EXPECT_EQ(invalidConfigReason,
               createInvalidConfigReasonWithAlert(INVALID_CONFIG_REASON_ALERT_THRESHOLD_MISSING,
@@ -1410,8 +1415,10 @@ TEST_F(MetricsManagerUtilTest, TestCreateAnomalyTrackerMissingBuckets) {
             kConfigKey, metric, 0, {ConditionState::kUnknown}, wizard, 0x0123456789, 0, 0)});
     sp<AlarmMonitor> anomalyAlarmMonitor;
     optional<InvalidConfigReason> invalidConfigReason;
-    EXPECT_EQ(createAnomalyTracker(alert, anomalyAlarmMonitor, UPDATE_NEW, /*updateTime=*/123,
-                                   {{1, 0}}, metricProducers, invalidConfigReason),
+    unordered_map<int, vector<sp<BurstTracker>>> burstTrackers;
+    EXPECT_EQ(createAnomalyTracker(alert, kConfigKey, anomalyAlarmMonitor, UPDATE_NEW,
+                                   /*updateTime=*/123, {{1, 0}}, {}, metricProducers, burstTrackers,
+                                   invalidConfigReason),
               nullopt);
     EXPECT_EQ(invalidConfigReason,
               createInvalidConfigReasonWithAlert(
@@ -1434,8 +1441,10 @@ TEST_F(MetricsManagerUtilTest, TestCreateAnomalyTrackerGood) {
             kConfigKey, metric, 0, {ConditionState::kUnknown}, wizard, 0x0123456789, 0, 0)});
     sp<AlarmMonitor> anomalyAlarmMonitor;
     optional<InvalidConfigReason> invalidConfigReason;
-    EXPECT_NE(createAnomalyTracker(alert, anomalyAlarmMonitor, UPDATE_NEW, /*updateTime=*/123,
-                                   {{1, 0}}, metricProducers, invalidConfigReason),
+    unordered_map<int, vector<sp<BurstTracker>>> burstTrackers;
+    EXPECT_NE(createAnomalyTracker(alert, kConfigKey, anomalyAlarmMonitor, UPDATE_NEW,
+                                   /*updateTime=*/123, {{1, 0}}, {}, metricProducers, burstTrackers,
+                                   invalidConfigReason),
               nullopt);
     EXPECT_EQ(invalidConfigReason, nullopt);
 }
@@ -1461,8 +1470,10 @@ TEST_F(MetricsManagerUtilTest, TestCreateAnomalyTrackerDurationTooLong) {
             wizard, 0x0123456789, dimensions, 0, 0)});
     sp<AlarmMonitor> anomalyAlarmMonitor;
     optional<InvalidConfigReason> invalidConfigReason;
-    EXPECT_EQ(createAnomalyTracker(alert, anomalyAlarmMonitor, UPDATE_NEW, /*updateTime=*/123,
-                                   {{1, 0}}, metricProducers, invalidConfigReason),
+    unordered_map<int, vector<sp<BurstTracker>>> burstTrackers;
+    EXPECT_EQ(createAnomalyTracker(alert, kConfigKey, anomalyAlarmMonitor, UPDATE_NEW,
+                                   /*updateTime=*/123, {{1, 0}}, {}, metricProducers, burstTrackers,
+                                   invalidConfigReason),
               nullopt);
     EXPECT_EQ(invalidConfigReason,
               createInvalidConfigReasonWithAlert(INVALID_CONFIG_REASON_ALERT_CANNOT_ADD_ANOMALY,
@@ -748,6 +748,60 @@ TEST(ShellSubscriberTest, testPushedSubscription) {
     TRACE_CALL(runShellTest, config, uidMap, pullerManager, pushedList, expectedData, kNumClients);
 }
 
+TEST(ShellSubscriberTest, testRetentionReplay) {
+    sp<MockUidMap> uidMap = new NaggyMock<MockUidMap>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<ShellSubscriber> shellManager =
+            new ShellSubscriber(uidMap, pullerManager, std::make_shared<LogEventFilter>());
+
+    // Config asking for screen events with retention enabled.
+    ShellSubscription config;
+    config.add_pushed()->set_atom_id(SCREEN_STATE_CHANGED);
+    config.mutable_retention()->set_retention_time_millis(60'000);
+
+    size_t bufferSize = config.ByteSize();
+    vector<uint8_t> buffer(bufferSize);
+    config.SerializeToArray(&buffer[0], bufferSize);
+
+    const int numClients = 2;
+    int fds_configs[numClients][2];
+    int fds_datas[numClients][2];
+    for (int i = 0; i < numClients; i++) {
+        ASSERT_EQ(0, pipe2(fds_configs[i], O_CLOEXEC));
+        ASSERT_EQ(0, pipe2(fds_datas[i], O_CLOEXEC));
+        write(fds_configs[i][1], &bufferSize, sizeof(bufferSize));
+        write(fds_configs[i][1], buffer.data(), bufferSize);
+        close(fds_configs[i][1]);
+    }
+
+    // Only the first client subscribes before the event arrives. Use a current
+    // timestamp so the event stays within the retention window.
+    shellManager->startNewSubscription(fds_configs[0][0], fds_datas[0][1], /*timeoutSec=*/-1);
+    std::unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+            getElapsedRealtimeNs(), ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    shellManager->onLogEvent(*event);
+
+    // The second client subscribes late and should have the retained event replayed.
+    shellManager->startNewSubscription(fds_configs[1][0], fds_datas[1][1], /*timeoutSec=*/-1);
+
+    for (int i = 0; i < numClients; i++) {
+        close(fds_configs[i][0]);
+        close(fds_datas[i][1]);
+    }
+
+    ShellData expected;
+    expected.add_atom()->mutable_screen_state_changed()->set_state(
+            ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    expected.add_elapsed_timestamp_nanos(event->GetElapsedTimestampNs());
+
+    for (int i = 0; i < numClients; i++) {
+        vector<ShellData> actualData = {readData(fds_datas[i][0])};
+        EXPECT_THAT(vector<ShellData>{expected}, UnorderedPointwise(EqShellData(), actualData));
+    }
+
+    // Not closing fds_datas[i][0] because this causes writes within ShellSubscriberClient to hang
+}
+
 TEST(ShellSubscriberTest, testPulledSubscription) {
     sp<MockUidMap> uidMap = new NaggyMock<MockUidMap>();
     sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <utility>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Deterministic virtual-time scheduler for concurrency-sensitive tests.
+ *
+ * The components whose threading we tune for performance (LogEventQueue,
+ * StatsLogProcessor, StatsPullerManager, AlarmMonitor) all take explicit
+ * elapsed-realtime timestamps, so a test can stand in for their threads by
+ * expressing every "thread step" as a task on this scheduler. All tasks run
+ * on the test thread in a fully specified order - by virtual time, with ties
+ * broken by posting order - so a scripted interleaving replays identically
+ * on every run. A test can then sweep every permutation of a small step set
+ * instead of hoping a rare interleaving shows up under real threads.
+ *
+ * Tasks may post further tasks; a task posted at or before the current
+ * virtual time still runs in the current drain (the clock never moves
+ * backwards). This is a test-only utility and is not thread safe: all calls
+ * must come from the test thread.
+ */
+class VirtualTimeScheduler {
+public:
+    explicit VirtualTimeScheduler(int64_t startTimeNs = 0) : mNowNs(startTimeNs) {
+    }
+
+    /** Current virtual elapsed-realtime time, in nanoseconds. */
+    int64_t nowNs() const {
+        return mNowNs;
+    }
+
+    /**
+     * Schedules a task at the given virtual time. A time in the past is
+     * clamped to now. Tasks with equal times run in posting order.
+     */
+    void runAt(int64_t timeNs, std::function<void()> task) {
+        mTasks.emplace(timeNs < mNowNs ? mNowNs : timeNs, std::move(task));
+    }
+
+    /**
+     * Runs every task scheduled at or before timeNs, including tasks posted
+     * while draining, then advances the clock to timeNs. Returns the number
+     * of tasks executed.
+     */
+    size_t runUntil(int64_t timeNs) {
+        size_t executed = 0;
+        while (!mTasks.empty() && mTasks.begin()->first <= timeNs) {
+            auto it = mTasks.begin();
+            mNowNs = it->first;
+            std::function<void()> task = std::move(it->second);
+            mTasks.erase(it);
+            task();
+            executed++;
+        }
+        if (timeNs > mNowNs) {
+            mNowNs = timeNs;
+        }
+        return executed;
+    }
+
+    /** Runs every scheduled task, in order. Returns the number executed. */
+    size_t runUntilIdle() {
+        size_t executed = 0;
+        while (!mTasks.empty()) {
+            executed += runUntil(mTasks.begin()->first);
+        }
+        return executed;
+    }
+
+    bool isIdle() const {
+        return mTasks.empty();
+    }
+
+private:
+    int64_t mNowNs;
+
+    // multimap keeps equal-time tasks in insertion order, which is what makes
+    // tie-breaking by posting order hold.
+    std::multimap<int64_t, std::function<void()>> mTasks;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
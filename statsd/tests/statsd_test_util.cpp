@@ -37,7 +37,11 @@ bool StatsServiceConfigTest::sendConfig(const StatsdConfig& config) {
     string str;
     config.SerializeToString(&str);
     std::vector<uint8_t> configAsVec(str.begin(), str.end());
-    return service->addConfiguration(kConfigKey, configAsVec, kCallingUid).isOk();
+    const bool ok = service->addConfiguration(kConfigKey, configAsVec, kCallingUid).isOk();
+    // addConfiguration applies the config asynchronously; drain so the config
+    // is live before the test logs events against it.
+    service->waitForServiceDispatcher();
+    return ok;
 }
 
 ConfigMetricsReport StatsServiceConfigTest::getReports(sp<StatsLogProcessor> processor,
@@ -2123,6 +2127,8 @@ void writeBootFlag(const string& flagName, const string& flagValue) {
 }
 
 PackageInfoSnapshot getPackageInfoSnapshot(const sp<UidMap> uidMap) {
+    // Certificate hashes from updateMap() are filled in on a worker thread.
+    uidMap->waitForPendingCertificateHashes();
     ProtoOutputStream protoOutputStream;
     uidMap->writeUidMapSnapshot(/* timestamp */ 1, /* includeVersionStrings */ true,
                                 /* includeInstaller */ true, /* certificateHashSize */ UINT8_MAX,
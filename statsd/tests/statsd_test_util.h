@@ -110,6 +110,9 @@ public:
     MOCK_METHOD4(sendResults,
                  Status(const vector<string>& queryData, const vector<string>& columnNames,
                         const vector<int32_t>& columnTypes, int32_t rowCount));
+    MOCK_METHOD5(sendResultChunk,
+                 Status(const vector<string>& queryData, const vector<string>& columnNames,
+                        const vector<int32_t>& columnTypes, int32_t rowCount, bool isLastChunk));
     MOCK_METHOD1(sendFailure, Status(const string& in_error));
 };
 
@@ -132,6 +135,7 @@ protected:
         // Removing config file from data/misc/stats-service and data/misc/stats-data if present
         ConfigKey configKey(kCallingUid, kConfigKey);
         service->removeConfiguration(kConfigKey, kCallingUid);
+        service->waitForServiceDispatcher();
         service->mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(),
                                           false /* include_current_bucket*/, true /* erase_data */,
                                           ADB_DUMP, NO_TIME_CONSTRAINTS, nullptr);
@@ -141,6 +145,7 @@ protected:
         // Cleaning up data/misc/stats-service and data/misc/stats-data
         ConfigKey configKey(kCallingUid, kConfigKey);
         service->removeConfiguration(kConfigKey, kCallingUid);
+        service->waitForServiceDispatcher();
         service->mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(),
                                           false /* include_current_bucket*/, true /* erase_data */,
                                           ADB_DUMP, NO_TIME_CONSTRAINTS, nullptr);
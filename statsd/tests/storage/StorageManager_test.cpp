@@ -203,6 +203,99 @@ TEST(StorageManagerTest, AppendConfigReportTest4) {
     clearLocalHistoryTestFiles();
 }
 
+TEST(StorageManagerTest, DirectoryIndexTracksExternalChanges) {
+    // Files created behind StorageManager's back must show up: the directory
+    // mtime change invalidates the index and forces a rescan.
+    EXPECT_TRUE(prepareLocalHistoryTestFiles());
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(ConfigKey(1066, 1)));
+
+    // The rename to history files is StorageManager's own change, so the index
+    // is maintained in place; history files do not count as pending reports.
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(ConfigKey(1066, 1), &out, false /*erase?*/,
+                                              false /*isAdb?*/);
+    EXPECT_FALSE(StorageManager::hasConfigMetricsReport(ConfigKey(1066, 1)));
+
+    // A file written through StorageManager is indexed without a rescan.
+    const string content = "content";
+    StorageManager::writeFile(file2.c_str(), content.data(), content.size());
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(ConfigKey(1066, 1)));
+
+    // External deletion is picked up the same way external creation is.
+    clearLocalHistoryTestFiles();
+    EXPECT_FALSE(StorageManager::hasConfigMetricsReport(ConfigKey(1066, 1)));
+}
+
+TEST(StorageManagerTest, WriteFileCommitsAtomically) {
+    const string content = "content";
+    const string tempName = testDir + ".2557169349_1066_1.tmp";
+
+    StorageManager::writeFile(file2.c_str(), content.data(), content.size());
+
+    // The committed file is in place and the temp sibling is gone.
+    EXPECT_TRUE(fileExist(file2));
+    EXPECT_FALSE(fileExist(tempName));
+    string onDisk;
+    EXPECT_TRUE(StorageManager::readFileToString(file2.c_str(), &onDisk));
+    EXPECT_EQ(content, onDisk);
+
+    // A temp file orphaned by a crash mid-commit is swept at startup and is
+    // never visible as a report.
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+            open(tempName.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR)));
+    ASSERT_NE(fd, -1);
+    dprintf(fd, "truncated");
+    StorageManager::deleteOrphanedTempFiles();
+    EXPECT_FALSE(fileExist(tempName));
+    EXPECT_TRUE(fileExist(file2));
+
+    clearLocalHistoryTestFiles();
+}
+
+TEST(StorageManagerTest, WriteFileDurabilityClassesCommitTheFile) {
+    // BATCHED and LAZY only change when the bytes are synced, never whether
+    // the file lands; the atomic temp-then-rename commit is identical.
+    const string content = "content";
+    for (const StorageManager::WriteDurability durability :
+         {StorageManager::WriteDurability::BATCHED, StorageManager::WriteDurability::LAZY}) {
+        StorageManager::writeFile(file2.c_str(), content.data(), content.size(), durability);
+        string onDisk;
+        EXPECT_TRUE(StorageManager::readFileToString(file2.c_str(), &onDisk));
+        EXPECT_EQ(content, onDisk);
+        clearLocalHistoryTestFiles();
+    }
+    // Group-committing with no batch outstanding is a harmless no-op.
+    StorageManager::syncDataDirectory();
+}
+
+TEST(StorageManagerTest, CompressedReportRoundTrip) {
+    // Repetitive content, like a real report, so the compressed form is the one written.
+    string content;
+    for (int i = 0; i < 100; i++) {
+        content += "config metrics report payload ";
+    }
+
+    StorageManager::writeCompressedFile(file1.c_str(), content.data(), content.size());
+    EXPECT_TRUE(fileExist(file1));
+
+    string onDisk;
+    EXPECT_TRUE(StorageManager::readFileToString(file1.c_str(), &onDisk));
+    EXPECT_LT(onDisk.size(), content.size());
+
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(ConfigKey(1066, 1), &out, true /*erase?*/,
+                                              true /*isAdb?*/);
+    EXPECT_FALSE(fileExist(file1));
+
+    // The report field must carry the original decompressed bytes.
+    vector<uint8_t> bytes;
+    out.serializeToVector(&bytes);
+    const string serialized(bytes.begin(), bytes.end());
+    EXPECT_NE(serialized.find(content), string::npos);
+
+    clearLocalHistoryTestFiles();
+}
+
 TEST(StorageManagerTest, TrainInfoReadWrite32To64BitTest) {
     InstallTrainInfo trainInfo;
     trainInfo.trainVersionCode = 12345;
@@ -64,6 +64,7 @@ public:
         EXPECT_EQ(pir2.use_count(), 1);
         EXPECT_EQ(pir3.use_count(), 1);
         ASSERT_TRUE(SubscriberReporter::getInstance().mIntentMap.empty());
+        ASSERT_TRUE(SubscriberReporter::getInstance().mIntentMapSnapshot->empty());
     }
 };
 
@@ -75,6 +76,8 @@ TEST_F(SubscriberReporterTest, TestBroadcastSubscriberDeathRemovesPir) {
             expectedIntentMap = {{configKey1, {{subscriptionId2, pir2}}},
                                  {configKey2, {{subscriptionId1, pir3}}}};
     EXPECT_THAT(SubscriberReporter::getInstance().mIntentMap, ContainerEq(expectedIntentMap));
+    EXPECT_THAT(*SubscriberReporter::getInstance().mIntentMapSnapshot,
+                ContainerEq(expectedIntentMap));
 }
 
 TEST_F(SubscriberReporterTest, TestBroadcastSubscriberDeathRemovesPirAndConfigKey) {
@@ -84,6 +87,8 @@ TEST_F(SubscriberReporterTest, TestBroadcastSubscriberDeathRemovesPirAndConfigKe
     unordered_map<ConfigKey, unordered_map<int64_t, shared_ptr<IPendingIntentRef>>>
             expectedIntentMap = {{configKey1, {{subscriptionId1, pir1}, {subscriptionId2, pir2}}}};
     EXPECT_THAT(SubscriberReporter::getInstance().mIntentMap, ContainerEq(expectedIntentMap));
+    EXPECT_THAT(*SubscriberReporter::getInstance().mIntentMapSnapshot,
+                ContainerEq(expectedIntentMap));
 }
 
 TEST_F(SubscriberReporterTest, TestBroadcastSubscriberDeathKeepsReplacedPir) {
@@ -98,6 +103,8 @@ TEST_F(SubscriberReporterTest, TestBroadcastSubscriberDeathKeepsReplacedPir) {
             expectedIntentMap = {{configKey1, {{subscriptionId1, pir4}, {subscriptionId2, pir2}}},
                                  {configKey2, {{subscriptionId1, pir3}}}};
     EXPECT_THAT(SubscriberReporter::getInstance().mIntentMap, ContainerEq(expectedIntentMap));
+    EXPECT_THAT(*SubscriberReporter::getInstance().mIntentMapSnapshot,
+                ContainerEq(expectedIntentMap));
 }
 }  // namespace statsd
 }  // namespace os
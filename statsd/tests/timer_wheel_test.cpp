@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "src/anomaly/timer_wheel.h"
+
+#include <gtest/gtest.h>
+
+using namespace android::os::statsd;
+
+/** struct for template in timer_wheel */
+struct WheelTest : public RefBase {
+    explicit WheelTest(uint32_t timestampSec) : timestampSec(timestampSec) {
+    }
+
+    const uint32_t timestampSec;
+};
+
+#ifdef __ANDROID__
+
+TEST(timer_wheel, push_remove_contains) {
+    timer_wheel<WheelTest> wheel;
+    sp<const WheelTest> a = new WheelTest(100);
+    sp<const WheelTest> b = new WheelTest(100);
+
+    ASSERT_EQ(0u, wheel.size());
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(nullptr, wheel.top());
+
+    wheel.push(a);
+    wheel.push(a);  // duplicate push is a no-op
+    ASSERT_EQ(1u, wheel.size());
+    EXPECT_TRUE(wheel.contains(a));
+    EXPECT_FALSE(wheel.contains(b));
+
+    wheel.push(b);
+    ASSERT_EQ(2u, wheel.size());
+
+    EXPECT_TRUE(wheel.remove(a));
+    EXPECT_FALSE(wheel.remove(a));
+    ASSERT_EQ(1u, wheel.size());
+    EXPECT_FALSE(wheel.contains(a));
+    EXPECT_TRUE(wheel.contains(b));
+    EXPECT_EQ(b, wheel.top());
+}
+
+TEST(timer_wheel, top_across_levels) {
+    timer_wheel<WheelTest> wheel;
+    // Base is set by the first push; spread the rest over every wheel level.
+    sp<const WheelTest> base = new WheelTest(1000000);
+    sp<const WheelTest> nearby = new WheelTest(1000000 + 100);        // level 0
+    sp<const WheelTest> midway = new WheelTest(1000000 + 5000);      // level 1
+    sp<const WheelTest> distant = new WheelTest(1000000 + 100000);    // level 2
+    sp<const WheelTest> faraway = new WheelTest(1000000 + 20000000);  // level 3
+
+    wheel.push(base);
+    wheel.push(nearby);
+    wheel.push(midway);
+    wheel.push(distant);
+    wheel.push(faraway);
+
+    EXPECT_EQ(base, wheel.top());
+    wheel.remove(base);
+    EXPECT_EQ(nearby, wheel.top());
+    wheel.remove(nearby);
+    EXPECT_EQ(midway, wheel.top());
+    wheel.remove(midway);
+    EXPECT_EQ(distant, wheel.top());
+    wheel.remove(distant);
+    EXPECT_EQ(faraway, wheel.top());
+}
+
+TEST(timer_wheel, pop_sooner_than_expires_in_batches) {
+    timer_wheel<WheelTest> wheel;
+    sp<const WheelTest> a = new WheelTest(1000010);
+    sp<const WheelTest> b = new WheelTest(1000020);
+    sp<const WheelTest> c = new WheelTest(1000020);
+    sp<const WheelTest> d = new WheelTest(1000030);
+    sp<const WheelTest> e = new WheelTest(1001000);
+    sp<const WheelTest> f = new WheelTest(1100000);
+
+    for (const auto& alarm : {a, b, c, d, e, f}) {
+        wheel.push(alarm);
+    }
+
+    std::unordered_set<sp<const WheelTest>, SpHash<WheelTest>> fired;
+    wheel.pop_sooner_than(1000005, &fired);
+    EXPECT_TRUE(fired.empty());
+
+    wheel.pop_sooner_than(1000030, &fired);
+    ASSERT_EQ(4u, fired.size());
+    EXPECT_EQ(1u, fired.count(a));
+    EXPECT_EQ(1u, fired.count(b));
+    EXPECT_EQ(1u, fired.count(c));
+    EXPECT_EQ(1u, fired.count(d));
+    EXPECT_FALSE(wheel.contains(a));
+    EXPECT_EQ(e, wheel.top());
+
+    // Elements at coarser levels cascade down and fire at the right time.
+    fired.clear();
+    wheel.pop_sooner_than(1001000, &fired);
+    ASSERT_EQ(1u, fired.size());
+    EXPECT_EQ(1u, fired.count(e));
+
+    fired.clear();
+    wheel.pop_sooner_than(1100000, &fired);
+    ASSERT_EQ(1u, fired.size());
+    EXPECT_EQ(1u, fired.count(f));
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(timer_wheel, overdue_push_fires_on_next_pop) {
+    timer_wheel<WheelTest> wheel;
+    sp<const WheelTest> future = new WheelTest(2000000);
+    wheel.push(future);
+
+    std::unordered_set<sp<const WheelTest>, SpHash<WheelTest>> fired;
+    wheel.pop_sooner_than(1500000, &fired);
+    EXPECT_TRUE(fired.empty());
+
+    // An alarm whose time already passed still reports as top() and fires immediately.
+    sp<const WheelTest> late = new WheelTest(1400000);
+    wheel.push(late);
+    EXPECT_EQ(late, wheel.top());
+
+    wheel.pop_sooner_than(1500001, &fired);
+    ASSERT_EQ(1u, fired.size());
+    EXPECT_EQ(1u, fired.count(late));
+    EXPECT_EQ(future, wheel.top());
+}
+
+TEST(timer_wheel, many_elements_across_windows) {
+    timer_wheel<WheelTest> wheel;
+    std::vector<sp<const WheelTest>> alarms;
+    constexpr uint32_t kBaseSec = 1700000000;
+    constexpr int kNumAlarms = 2000;
+    for (int i = 0; i < kNumAlarms; i++) {
+        alarms.push_back(new WheelTest(kBaseSec + i * 37));
+        wheel.push(alarms.back());
+    }
+    ASSERT_EQ(static_cast<size_t>(kNumAlarms), wheel.size());
+
+    // Remove every third alarm, then expire the rest in a few large steps.
+    size_t remaining = kNumAlarms;
+    for (int i = 0; i < kNumAlarms; i += 3) {
+        EXPECT_TRUE(wheel.remove(alarms[i]));
+        remaining--;
+    }
+    ASSERT_EQ(remaining, wheel.size());
+
+    std::unordered_set<sp<const WheelTest>, SpHash<WheelTest>> fired;
+    size_t totalFired = 0;
+    for (uint32_t t = kBaseSec; t <= kBaseSec + kNumAlarms * 37; t += 10000) {
+        fired.clear();
+        wheel.pop_sooner_than(t, &fired);
+        for (const auto& alarm : fired) {
+            EXPECT_LE(alarm->timestampSec, t);
+        }
+        totalFired += fired.size();
+    }
+    EXPECT_EQ(remaining, totalFired);
+    EXPECT_TRUE(wheel.empty());
+}
+
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
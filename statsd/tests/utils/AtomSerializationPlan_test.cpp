@@ -0,0 +1,137 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/utils/AtomSerializationPlan.h"
+
+#include <gtest/gtest.h>
+
+#include "frameworks/proto_logging/stats/atoms.pb.h"
+#include "src/logd/AtomSchemaRegistry.h"
+#include "src/logd/LogEvent.h"
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+std::vector<uint8_t> serializeWithPlan(const LogEvent& event, bool* usedPlan) {
+    android::util::ProtoOutputStream protoOutput;
+    *usedPlan =
+            writeAtomWithSerializationPlan(event.GetTagId(), event.getValues(), &protoOutput);
+    std::vector<uint8_t> bytes;
+    protoOutput.serializeToVector(&bytes);
+    return bytes;
+}
+
+}  // anonymous namespace
+
+TEST(AtomSerializationPlanTest, TestAttributionChainAtom) {
+    std::unique_ptr<LogEvent> event =
+            CreateAcquireWakelockEvent(1000, {1111, 2222}, {"tag1", "tag2"}, "wakelock");
+
+    bool usedPlan = false;
+    std::vector<uint8_t> bytes = serializeWithPlan(*event, &usedPlan);
+    EXPECT_TRUE(usedPlan);
+
+    Atom atom;
+    ASSERT_TRUE(atom.ParseFromArray(bytes.data(), bytes.size()));
+    EXPECT_EQ(Atom::PushedCase::kWakelockStateChanged, atom.pushed_case());
+    ASSERT_EQ(2, atom.wakelock_state_changed().attribution_node_size());
+    EXPECT_EQ(1111, atom.wakelock_state_changed().attribution_node(0).uid());
+    EXPECT_EQ("tag1", atom.wakelock_state_changed().attribution_node(0).tag());
+    EXPECT_EQ(2222, atom.wakelock_state_changed().attribution_node(1).uid());
+    EXPECT_EQ("tag2", atom.wakelock_state_changed().attribution_node(1).tag());
+    EXPECT_EQ("wakelock", atom.wakelock_state_changed().tag());
+
+    // The second serialization replays the compiled plan and must produce the same bytes.
+    std::vector<uint8_t> replayedBytes = serializeWithPlan(*event, &usedPlan);
+    EXPECT_TRUE(usedPlan);
+    EXPECT_EQ(bytes, replayedBytes);
+}
+
+TEST(AtomSerializationPlanTest, TestNegativeValuesRoundTrip) {
+    // Negative int32/int64 values exercise the varint encoding edge cases.
+    std::unique_ptr<LogEvent> event = CreateTestAtomReportedEventWithPrimitives(
+            1000, /*intField=*/-3, /*longField=*/-4L, /*floatField=*/-5.5f, "str",
+            /*boolField=*/true, TestAtomReported::ON);
+
+    bool usedPlan = false;
+    std::vector<uint8_t> bytes = serializeWithPlan(*event, &usedPlan);
+    EXPECT_TRUE(usedPlan);
+
+    Atom atom;
+    ASSERT_TRUE(atom.ParseFromArray(bytes.data(), bytes.size()));
+    EXPECT_EQ(Atom::PushedCase::kTestAtomReported, atom.pushed_case());
+    EXPECT_EQ(-3, atom.test_atom_reported().int_field());
+    EXPECT_EQ(-4L, atom.test_atom_reported().long_field());
+    EXPECT_EQ(-5.5f, atom.test_atom_reported().float_field());
+    EXPECT_EQ("str", atom.test_atom_reported().string_field());
+    EXPECT_EQ(true, atom.test_atom_reported().boolean_field());
+    EXPECT_EQ(TestAtomReported::ON, atom.test_atom_reported().state());
+}
+
+TEST(AtomSerializationPlanTest, TestPolymorphicLayoutFallsBack) {
+    // Use an atom id no other test serializes so the cached plan state is predictable.
+    const int atomId = 10000001;
+    bool usedPlan = false;
+
+    // Alternate between one- and two-value layouts: after a few recompiles the plan is
+    // abandoned and the writer reports that the generic path must be used.
+    for (int i = 0; i < 4; i++) {
+        LogEvent eventA(/*uid=*/0, /*pid=*/0);
+        CreateTwoValueLogEvent(&eventA, atomId, 1000, 1, 2);
+        serializeWithPlan(eventA, &usedPlan);
+
+        LogEvent eventB(/*uid=*/0, /*pid=*/0);
+        CreateThreeValueLogEvent(&eventB, atomId, 1000, 1, 2, 3);
+        serializeWithPlan(eventB, &usedPlan);
+    }
+    EXPECT_FALSE(usedPlan);
+}
+
+TEST(AtomSerializationPlanTest, TestRegisteredSchemaSeedsPlan) {
+    // The registry lookups resolve at compile time for registered atoms.
+    static_assert(findAtomSchema(util::ISOLATED_UID_CHANGED) != nullptr);
+    static_assert(findAtomSchema(/*atomId=*/-1) == nullptr);
+    static_assert(schemaMatches<INT32_TYPE, INT32_TYPE, INT32_TYPE>(util::ISOLATED_UID_CHANGED));
+    static_assert(!schemaMatches<INT32_TYPE, INT32_TYPE>(util::ISOLATED_UID_CHANGED));
+
+    // A registered atom serializes through the plan on its very first sighting; the
+    // schema-seeded plan must produce the same wire format as the proto definition.
+    std::unique_ptr<LogEvent> event =
+            CreateIsolatedUidChangedEvent(/*timestampNs=*/1000, /*hostUid=*/1111,
+                                          /*isolatedUid=*/2222, /*is_create=*/true);
+
+    bool usedPlan = false;
+    std::vector<uint8_t> bytes = serializeWithPlan(*event, &usedPlan);
+    EXPECT_TRUE(usedPlan);
+
+    Atom atom;
+    ASSERT_TRUE(atom.ParseFromArray(bytes.data(), bytes.size()));
+    EXPECT_EQ(Atom::PushedCase::kIsolatedUidChanged, atom.pushed_case());
+    EXPECT_EQ(1111, atom.isolated_uid_changed().parent_uid());
+    EXPECT_EQ(2222, atom.isolated_uid_changed().isolated_uid());
+    EXPECT_EQ(1, atom.isolated_uid_changed().event());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/utils/ChunkArena.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+TEST(ChunkArenaTest, TestAllocationsAreAlignedAndPacked) {
+    ChunkArena arena;
+
+    void* a = arena.allocate(1, 1);
+    void* b = arena.allocate(8, alignof(int64_t));
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(b) % alignof(int64_t));
+
+    // Small allocations share one chunk; only an overflow opens another.
+    EXPECT_EQ(1u, arena.chunkCount());
+    arena.allocate(16 * 1024, alignof(int64_t));
+    EXPECT_EQ(2u, arena.chunkCount());
+
+    arena.reset();
+    EXPECT_EQ(0u, arena.chunkCount());
+}
+
+TEST(ChunkArenaTest, TestVectorOnArenaAllocatorKeepsValues) {
+    ChunkArena arena;
+    {
+        std::vector<int64_t, ArenaAllocator<int64_t>> values{ArenaAllocator<int64_t>(&arena)};
+        for (int64_t i = 0; i < 1000; i++) {
+            values.push_back(i * 3);
+        }
+        ASSERT_EQ(1000u, values.size());
+        for (int64_t i = 0; i < 1000; i++) {
+            ASSERT_EQ(i * 3, values[i]);
+        }
+        EXPECT_GT(arena.chunkCount(), 0u);
+    }
+    // The vector is gone; its storage only comes back with the arena.
+    arena.reset();
+    EXPECT_EQ(0u, arena.chunkCount());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -233,6 +233,246 @@ TEST_F(DbUtilsTest, TestInsertTwoEvents) {
                 ElementsAre("atomId", "elapsedTimestampNs", "wallTimestampNs", "field_1"));
 }
 
+TEST_F(DbUtilsTest, TestQueryStreamedSingleChunk) {
+    int64_t eventElapsedTimeNs = 10000000000;
+
+    AStatsEvent* statsEvent1 = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent1, "111");
+    LogEvent logEvent1 = makeLogEvent(statsEvent1);
+
+    AStatsEvent* statsEvent2 = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeString(statsEvent2, "222");
+    LogEvent logEvent2 = makeLogEvent(statsEvent2);
+
+    vector<LogEvent> events{logEvent1, logEvent2};
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent1));
+    string err;
+    EXPECT_TRUE(insert(key, metricId, events, err));
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<string> queryData;
+    int32_t numChunks = 0;
+    int32_t totalRows = 0;
+    bool lastChunkSeen = false;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_TRUE(queryStreamed(
+            key, zSql, /*maxChunkBytes=*/1024 * 1024,
+            [&](vector<string>& chunkData, int32_t rowCount, bool isLastChunk) {
+                numChunks++;
+                totalRows += rowCount;
+                lastChunkSeen = isLastChunk;
+                queryData.insert(queryData.end(), chunkData.begin(), chunkData.end());
+                return true;
+            },
+            columnTypes, columnNames, err));
+
+    EXPECT_EQ(numChunks, 1);
+    EXPECT_EQ(totalRows, 2);
+    EXPECT_TRUE(lastChunkSeen);
+    EXPECT_THAT(queryData, ElementsAre("1", to_string(eventElapsedTimeNs + 10), _, "111",  //
+                                       "1", to_string(eventElapsedTimeNs + 20), _, "222"));
+    EXPECT_THAT(columnTypes,
+                ElementsAre(SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_TEXT));
+    EXPECT_THAT(columnNames,
+                ElementsAre("atomId", "elapsedTimestampNs", "wallTimestampNs", "field_1"));
+}
+
+TEST_F(DbUtilsTest, TestQueryStreamedMultipleChunks) {
+    int64_t eventElapsedTimeNs = 10000000000;
+
+    AStatsEvent* statsEvent1 = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent1, "111");
+    LogEvent logEvent1 = makeLogEvent(statsEvent1);
+
+    AStatsEvent* statsEvent2 = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeString(statsEvent2, "222");
+    LogEvent logEvent2 = makeLogEvent(statsEvent2);
+
+    vector<LogEvent> events{logEvent1, logEvent2};
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent1));
+    string err;
+    EXPECT_TRUE(insert(key, metricId, events, err));
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<string> queryData;
+    std::vector<int32_t> chunkRowCounts;
+    std::vector<bool> chunkIsLast;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    // A 1-byte cap forces a flush after every row.
+    EXPECT_TRUE(queryStreamed(
+            key, zSql, /*maxChunkBytes=*/1,
+            [&](vector<string>& chunkData, int32_t rowCount, bool isLastChunk) {
+                chunkRowCounts.push_back(rowCount);
+                chunkIsLast.push_back(isLastChunk);
+                queryData.insert(queryData.end(), chunkData.begin(), chunkData.end());
+                return true;
+            },
+            columnTypes, columnNames, err));
+
+    EXPECT_THAT(chunkRowCounts, ElementsAre(1, 1));
+    EXPECT_THAT(chunkIsLast, ElementsAre(false, true));
+    EXPECT_THAT(queryData, ElementsAre("1", to_string(eventElapsedTimeNs + 10), _, "111",  //
+                                       "1", to_string(eventElapsedTimeNs + 20), _, "222"));
+    EXPECT_THAT(columnTypes,
+                ElementsAre(SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_TEXT));
+    EXPECT_THAT(columnNames,
+                ElementsAre("atomId", "elapsedTimestampNs", "wallTimestampNs", "field_1"));
+}
+
+TEST_F(DbUtilsTest, TestQueryStreamedAbortedByHandler) {
+    int64_t eventElapsedTimeNs = 10000000000;
+
+    AStatsEvent* statsEvent1 = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent1, "111");
+    LogEvent logEvent1 = makeLogEvent(statsEvent1);
+
+    AStatsEvent* statsEvent2 = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeString(statsEvent2, "222");
+    LogEvent logEvent2 = makeLogEvent(statsEvent2);
+
+    vector<LogEvent> events{logEvent1, logEvent2};
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent1));
+    string err;
+    EXPECT_TRUE(insert(key, metricId, events, err));
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    int32_t numChunks = 0;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_FALSE(queryStreamed(
+            key, zSql, /*maxChunkBytes=*/1,
+            [&](vector<string>& chunkData, int32_t rowCount, bool isLastChunk) {
+                numChunks++;
+                return false;
+            },
+            columnTypes, columnNames, err));
+
+    EXPECT_EQ(numChunks, 1);
+    EXPECT_FALSE(err.empty());
+}
+
+TEST_F(DbUtilsTest, TestRepeatedInsertsUseWalMode) {
+    int64_t eventElapsedTimeNs = 10000000000;
+
+    AStatsEvent* statsEvent1 = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent1, "111");
+    LogEvent logEvent1 = makeLogEvent(statsEvent1);
+
+    AStatsEvent* statsEvent2 = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeString(statsEvent2, "222");
+    LogEvent logEvent2 = makeLogEvent(statsEvent2);
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent1));
+    string err;
+    // Two separate flushes: the second reuses the cached connection and statement.
+    vector<LogEvent> firstFlush{logEvent1};
+    EXPECT_TRUE(insert(key, metricId, firstFlush, err));
+    vector<LogEvent> secondFlush{logEvent2};
+    EXPECT_TRUE(insert(key, metricId, secondFlush, err));
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+
+    ASSERT_EQ(rows.size(), 2);
+    EXPECT_THAT(rows[0], ElementsAre("1", to_string(eventElapsedTimeNs + 10), _, "111"));
+    EXPECT_THAT(rows[1], ElementsAre("1", to_string(eventElapsedTimeNs + 20), _, "222"));
+
+    rows.clear();
+    columnTypes.clear();
+    columnNames.clear();
+    zSql = "PRAGMA journal_mode";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_THAT(rows[0], ElementsAre("wal"));
+}
+
+TEST_F(DbUtilsTest, TestRowBatchInsert) {
+    int64_t eventElapsedTimeNs = 10000000000;
+
+    AStatsEvent* statsEvent1 = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent1, "111");
+    LogEvent logEvent1 = makeLogEvent(statsEvent1);
+
+    AStatsEvent* statsEvent2 = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeString(statsEvent2, "111");  // Duplicate value, interned once.
+    LogEvent logEvent2 = makeLogEvent(statsEvent2);
+
+    AStatsEvent* statsEvent3 = makeAStatsEvent(tagId, eventElapsedTimeNs + 30);
+    AStatsEvent_writeInt32(statsEvent3, 5);
+    LogEvent logEvent3 = makeLogEvent(statsEvent3);
+
+    RowBatch batch(logEvent1);
+    EXPECT_TRUE(batch.addRow(logEvent1));
+    EXPECT_TRUE(batch.addRow(logEvent2));
+    // A different event shape cannot join the batch.
+    EXPECT_FALSE(batch.eventMatchesSchema(logEvent3));
+    EXPECT_FALSE(batch.addRow(logEvent3));
+    ASSERT_EQ(batch.numRows(), 2);
+    EXPECT_GT(batch.byteSize(), 0);
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent1));
+    string err;
+    EXPECT_TRUE(insert(key, metricId, batch, err));
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+
+    ASSERT_EQ(rows.size(), 2);
+    EXPECT_THAT(rows[0], ElementsAre("1", to_string(eventElapsedTimeNs + 10), _, "111"));
+    EXPECT_THAT(rows[1], ElementsAre("1", to_string(eventElapsedTimeNs + 20), _, "111"));
+    EXPECT_THAT(columnTypes,
+                ElementsAre(SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_TEXT));
+}
+
+TEST_F(DbUtilsTest, TestStreamedInsertVisibleAfterCommit) {
+    int64_t eventElapsedTimeNs = 10000000000;
+
+    AStatsEvent* statsEvent1 = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent1, "111");
+    LogEvent logEvent1 = makeLogEvent(statsEvent1);
+
+    AStatsEvent* statsEvent2 = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeString(statsEvent2, "222");
+    LogEvent logEvent2 = makeLogEvent(statsEvent2);
+
+    string err;
+    EXPECT_TRUE(createTableIfNeededStreamed(key, metricId, logEvent1, err));
+    EXPECT_TRUE(insertEventStreamed(key, metricId, logEvent1, err));
+    EXPECT_TRUE(insertEventStreamed(key, metricId, logEvent2, err));
+
+    // Neither the table nor the streamed rows are visible to readers until the
+    // streaming transaction is committed.
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_FALSE(query(key, zSql, rows, columnTypes, columnNames, err));
+
+    EXPECT_TRUE(commitEventStream(key, err));
+
+    rows.clear();
+    columnTypes.clear();
+    columnNames.clear();
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 2);
+    EXPECT_THAT(rows[0], ElementsAre("1", to_string(eventElapsedTimeNs + 10), _, "111"));
+    EXPECT_THAT(rows[1], ElementsAre("1", to_string(eventElapsedTimeNs + 20), _, "222"));
+
+    // Committing with no open transaction is a no-op.
+    EXPECT_TRUE(commitEventStream(key, err));
+}
+
 TEST_F(DbUtilsTest, TestInsertTwoEventsEnforceTtl) {
     int64_t eventElapsedTimeNs = 10000000000;
     int64_t eventWallClockNs = 50000000000;
@@ -270,6 +510,45 @@ TEST_F(DbUtilsTest, TestInsertTwoEventsEnforceTtl) {
                 ElementsAre("atomId", "elapsedTimestampNs", "wallTimestampNs", "field_1"));
 }
 
+TEST_F(DbUtilsTest, TestEnforceTtlDeletesAcrossBatches) {
+    int64_t eventElapsedTimeNs = 10000000000;
+    int64_t eventWallClockNs = 50000000000;
+    // More expired rows than one delete batch (500) holds, so the ttl sweep has to
+    // loop.
+    const int32_t numExpiredEvents = 1200;
+
+    vector<LogEvent> events;
+    for (int32_t i = 0; i < numExpiredEvents; i++) {
+        AStatsEvent* statsEvent = makeAStatsEvent(tagId, eventElapsedTimeNs + i);
+        AStatsEvent_writeString(statsEvent, "111");
+        LogEvent logEvent = makeLogEvent(statsEvent);
+        logEvent.setLogdWallClockTimestampNs(eventWallClockNs - i);
+        events.push_back(logEvent);
+    }
+    AStatsEvent* liveStatsEvent = makeAStatsEvent(tagId, eventElapsedTimeNs + numExpiredEvents);
+    AStatsEvent_writeString(liveStatsEvent, "222");
+    LogEvent liveLogEvent = makeLogEvent(liveStatsEvent);
+    liveLogEvent.setLogdWallClockTimestampNs(eventWallClockNs + 1);
+    events.push_back(liveLogEvent);
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, events[0]));
+    sqlite3* db = getDb(key);
+    string err;
+    EXPECT_TRUE(insert(db, metricId, events, err));
+    EXPECT_TRUE(flushTtl(db, metricId, eventWallClockNs));
+    closeDb(db);
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_THAT(rows[0], ElementsAre("1", to_string(eventElapsedTimeNs + numExpiredEvents), _,
+                                     "222"));
+}
+
 TEST_F(DbUtilsTest, TestMaliciousQuery) {
     int64_t eventElapsedTimeNs = 10000000000;
 
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/DispatchQueue.h"
+
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#ifdef __ANDROID__
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+TEST(DispatchQueueTest, TestTasksRunInFifoOrder) {
+    const int numTasks = 10;
+    vector<int> order;
+
+    DispatchQueue queue;
+    for (int i = 0; i < numTasks; i++) {
+        queue.enqueue(DispatchQueue::Priority::kDefault, [&order, i] { order.push_back(i); });
+    }
+    queue.waitForIdle();
+
+    ASSERT_EQ((int)order.size(), numTasks);
+    for (int i = 0; i < numTasks; i++) {
+        EXPECT_EQ(order[i], i);
+    }
+}
+
+TEST(DispatchQueueTest, TestHighPriorityJumpsAheadOfQueuedDefaultTasks) {
+    mutex lock;
+    condition_variable cv;
+    bool blockerStarted = false;
+    bool release = false;
+    vector<int> order;
+
+    DispatchQueue queue;
+    // Park the dispatch thread so the remaining tasks queue up behind it.
+    queue.enqueue(DispatchQueue::Priority::kDefault, [&] {
+        unique_lock<mutex> unique_lk(lock);
+        blockerStarted = true;
+        cv.notify_all();
+        cv.wait(unique_lk, [&release] { return release; });
+    });
+    {
+        unique_lock<mutex> unique_lk(lock);
+        cv.wait(unique_lk, [&blockerStarted] { return blockerStarted; });
+    }
+
+    queue.enqueue(DispatchQueue::Priority::kDefault, [&order] { order.push_back(1); });
+    queue.enqueue(DispatchQueue::Priority::kDefault, [&order] { order.push_back(2); });
+    queue.enqueue(DispatchQueue::Priority::kHigh, [&order] { order.push_back(3); });
+    {
+        lock_guard<mutex> lg(lock);
+        release = true;
+    }
+    cv.notify_all();
+    queue.waitForIdle();
+
+    ASSERT_EQ(order.size(), 3u);
+    EXPECT_EQ(order[0], 3);
+    EXPECT_EQ(order[1], 1);
+    EXPECT_EQ(order[2], 2);
+}
+
+TEST(DispatchQueueTest, TestDestructorDrainsQueuedTasks) {
+    const int numTasks = 5;
+    int completed = 0;
+    {
+        DispatchQueue queue;
+        for (int i = 0; i < numTasks; i++) {
+            queue.enqueue(DispatchQueue::Priority::kDefault, [&completed] { completed++; });
+        }
+    }
+    EXPECT_EQ(completed, numTasks);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/utils/FlatHashMap.h"
+
+#include <gtest/gtest.h>
+
+#include "src/HashableDimensionKey.h"
+#include "src/stats_util.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+MetricDimensionKey makeMetricKey(int value) {
+    HashableDimensionKey dim;
+    int pos[] = {1, 0, 0};
+    dim.addValue(FieldValue(Field(1, pos, 0), Value(value)));
+    return MetricDimensionKey(dim, DEFAULT_DIMENSION_KEY);
+}
+
+}  // anonymous namespace
+
+TEST(FlatHashMapTest, TestInsertReportsWhetherKeyWasNew) {
+    DimToValMap counter;
+
+    auto [it, inserted] = counter.insert({makeMetricKey(1), 10});
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(10, it->second);
+
+    // Inserting an existing key leaves the stored value untouched.
+    auto [it2, inserted2] = counter.insert({makeMetricKey(1), 99});
+    EXPECT_FALSE(inserted2);
+    EXPECT_EQ(10, it2->second);
+    ASSERT_EQ(1u, counter.size());
+}
+
+TEST(FlatHashMapTest, TestReserveAvoidsRehashAndKeepsEntries) {
+    constexpr int kNumKeys = 800;
+    DimToValMap counter;
+    counter.reserve(kNumKeys);
+
+    for (int i = 0; i < kNumKeys; i++) {
+        counter[makeMetricKey(i)] = i;
+        // A reserved table must keep entries stable while filling to the reserved size;
+        // spot-check that earlier entries stay reachable.
+        if (i % 100 == 0) {
+            ASSERT_NE(counter.find(makeMetricKey(i / 2)), counter.end());
+        }
+    }
+    ASSERT_EQ(static_cast<size_t>(kNumKeys), counter.size());
+    for (int i = 0; i < kNumKeys; i++) {
+        auto it = counter.find(makeMetricKey(i));
+        ASSERT_NE(it, counter.end());
+        EXPECT_EQ(i, it->second);
+    }
+}
+
+TEST(FlatHashMapTest, TestShrinkToFitKeepsEntries) {
+    constexpr int kBurstKeys = 1000;
+    constexpr int kSurvivingKeys = 10;
+    DimToValMap counter;
+
+    // Grow through a burst, then erase down to a small surviving set.
+    for (int i = 0; i < kBurstKeys; i++) {
+        counter[makeMetricKey(i)] = i;
+    }
+    for (int i = kSurvivingKeys; i < kBurstKeys; i++) {
+        counter.erase(counter.find(makeMetricKey(i)));
+    }
+    ASSERT_EQ(static_cast<size_t>(kSurvivingKeys), counter.size());
+
+    counter.shrink_to_fit();
+
+    // Every survivor stays reachable with its value after compaction.
+    ASSERT_EQ(static_cast<size_t>(kSurvivingKeys), counter.size());
+    for (int i = 0; i < kSurvivingKeys; i++) {
+        auto it = counter.find(makeMetricKey(i));
+        ASSERT_NE(it, counter.end());
+        EXPECT_EQ(i, it->second);
+    }
+    // And new inserts still work against the compacted table.
+    counter[makeMetricKey(kBurstKeys + 1)] = kBurstKeys + 1;
+    EXPECT_EQ(static_cast<size_t>(kSurvivingKeys) + 1, counter.size());
+
+    // An emptied map releases its table entirely.
+    counter.clear();
+    counter.shrink_to_fit();
+    EXPECT_TRUE(counter.empty());
+    EXPECT_EQ(counter.find(makeMetricKey(1)), counter.end());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
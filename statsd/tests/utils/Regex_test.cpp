@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/utils/Regex.h"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+// Runs replace() and returns the resulting string, or nullopt on no match.
+std::optional<std::string> doReplace(const std::string& pattern, const std::string& input,
+                                     const std::string& replacement) {
+    std::unique_ptr<Regex> re = Regex::create(pattern);
+    EXPECT_NE(re, nullptr) << "pattern failed to compile: " << pattern;
+    std::string str = input;
+    if (!re->replace(str, replacement)) {
+        return std::nullopt;
+    }
+    return str;
+}
+
+}  // anonymous namespace
+
+TEST(RegexTest, TestClassSuffixFastPath) {
+    EXPECT_EQ(doReplace("[0-9]+$", "wakelock123", ""), "wakelock");
+    EXPECT_EQ(doReplace("[0-9]+$", "wake1lock23", ""), "wake1lock");
+    EXPECT_EQ(doReplace("[0-9]+$", "123", ""), "");
+    EXPECT_EQ(doReplace("[0-9]+$", "wakelock", ""), std::nullopt);
+    // '*' matches empty at the end of the string, like regexec().
+    EXPECT_EQ(doReplace("[0-9]*$", "wakelock", "#"), "wakelock#");
+}
+
+TEST(RegexTest, TestClassPrefixFastPath) {
+    EXPECT_EQ(doReplace("^[0-9]+", "123wakelock", ""), "wakelock");
+    EXPECT_EQ(doReplace("^[0-9]+", "wakelock", ""), std::nullopt);
+    EXPECT_EQ(doReplace("^[a-z]+", "wakelock123", "X"), "X123");
+}
+
+TEST(RegexTest, TestNegatedClass) {
+    EXPECT_EQ(doReplace("[^0-9]+$", "123abc", ""), "123");
+    EXPECT_EQ(doReplace("[^0-9]+$", "123", ""), std::nullopt);
+}
+
+TEST(RegexTest, TestLiteralKinds) {
+    EXPECT_EQ(doReplace("lock", "wakelocklock", "-"), "wake-lock");
+    EXPECT_EQ(doReplace("^wake", "wakelock", ""), "lock");
+    EXPECT_EQ(doReplace("^wake", "awake", ""), std::nullopt);
+    EXPECT_EQ(doReplace("lock$", "wakelock", ""), "wake");
+    EXPECT_EQ(doReplace("lock$", "lockwake", ""), std::nullopt);
+}
+
+TEST(RegexTest, TestPosixFallbackMatchesFastPath) {
+    // Interval bounds are not recognized by the fast path; results must agree.
+    EXPECT_EQ(doReplace("[0-9]{1,}$", "wakelock123", ""), "wakelock");
+    // Subexpressions are rejected at compile time.
+    EXPECT_EQ(Regex::create("(ab)+"), nullptr);
+}
+
+TEST(RegexTest, TestCreateSharedReturnsCachedInstance) {
+    std::shared_ptr<Regex> first = Regex::createShared("[0-9]+$");
+    std::shared_ptr<Regex> second = Regex::createShared("[0-9]+$");
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_NE(first, Regex::createShared("[a-z]+$"));
+    EXPECT_EQ(Regex::createShared("(invalid"), nullptr);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
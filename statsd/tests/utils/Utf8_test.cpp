@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2025, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/utils/Utf8.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+bool isValid(const std::string& s) {
+    return isValidUtf8(s.data(), s.size());
+}
+
+std::string sanitized(std::string s) {
+    sanitizeUtf8(s);
+    return s;
+}
+
+}  // anonymous namespace
+
+TEST(Utf8Test, TestValidStrings) {
+    EXPECT_TRUE(isValid(""));
+    EXPECT_TRUE(isValid("com.android.statsd"));
+    // Long ASCII exercising the 8-byte SWAR path across chunk boundaries.
+    EXPECT_TRUE(isValid(std::string(100, 'a')));
+    EXPECT_TRUE(isValid("caf\xc3\xa9"));                       // 2-byte sequence
+    EXPECT_TRUE(isValid("\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e"));  // 3-byte sequences
+    EXPECT_TRUE(isValid("\xf0\x9f\x98\x80"));                  // 4-byte sequence (emoji)
+    // Embedded NUL is a valid one-byte code point.
+    EXPECT_TRUE(isValid(std::string("a\0b", 3)));
+}
+
+TEST(Utf8Test, TestInvalidStrings) {
+    EXPECT_FALSE(isValid("\x80"));              // stray continuation byte
+    EXPECT_FALSE(isValid("\xc3\x28"));          // bad continuation byte
+    EXPECT_FALSE(isValid("\xc0\xaf"));          // overlong 2-byte encoding
+    EXPECT_FALSE(isValid("\xe0\x80\xaf"));      // overlong 3-byte encoding
+    EXPECT_FALSE(isValid("\xed\xa0\x80"));      // UTF-16 surrogate
+    EXPECT_FALSE(isValid("\xf0\x80\x80\x80"));  // overlong 4-byte encoding
+    EXPECT_FALSE(isValid("\xf4\x90\x80\x80"));  // above U+10FFFF
+    EXPECT_FALSE(isValid("\xf5\x80\x80\x80"));  // lead byte can never occur
+    EXPECT_FALSE(isValid("abc\xc3"));           // truncated tail
+    // A high bit in the middle of an otherwise-ASCII run must not be skipped.
+    EXPECT_FALSE(isValid("aaaaaaaaaaaa\xffzzzzzzzzzzzz"));
+}
+
+TEST(Utf8Test, TestSanitizePreservesValidContent) {
+    EXPECT_EQ("com.android.statsd", sanitized("com.android.statsd"));
+    EXPECT_EQ("caf\xc3\xa9", sanitized("caf\xc3\xa9"));
+}
+
+TEST(Utf8Test, TestSanitizeReplacesInvalidBytes) {
+    EXPECT_EQ("?", sanitized("\x80"));
+    EXPECT_EQ("a??b", sanitized("a\xc0\xaf"
+                                "b"));
+    EXPECT_EQ("abc?", sanitized("abc\xc3"));
+    // Valid sequences around the bad bytes are untouched, length is preserved.
+    const std::string fixed = sanitized("ok\xed\xa0\x80\xc3\xa9");
+    EXPECT_TRUE(isValid(fixed));
+    EXPECT_EQ(std::string("ok???\xc3\xa9"), fixed);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/WorkerPool.h"
+
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __ANDROID__
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+TEST(WorkerPoolTest, TestEnqueuedTasksExecute) {
+    const int numTasks = 10;
+
+    mutex lock;
+    condition_variable cv;
+    int completed = 0;
+
+    for (int i = 0; i < numTasks; i++) {
+        WorkerPool::getInstance().enqueue([&lock, &cv, &completed] {
+            lock_guard<mutex> lg(lock);
+            completed++;
+            cv.notify_all();
+        });
+    }
+
+    unique_lock<mutex> unique_lk(lock);
+    cv.wait(unique_lk, [&completed] { return completed == numTasks; });
+    EXPECT_EQ(completed, numTasks);
+}
+
+TEST(WorkerPoolTest, TestConcurrentEnqueue) {
+    const int numThreads = 5;
+    const int tasksPerThread = 20;
+
+    mutex lock;
+    condition_variable cv;
+    int completed = 0;
+
+    vector<thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&lock, &cv, &completed] {
+            for (int j = 0; j < tasksPerThread; j++) {
+                WorkerPool::getInstance().enqueue([&lock, &cv, &completed] {
+                    lock_guard<mutex> lg(lock);
+                    completed++;
+                    cv.notify_all();
+                });
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    unique_lock<mutex> unique_lk(lock);
+    cv.wait(unique_lk, [&completed] { return completed == numThreads * tasksPerThread; });
+    EXPECT_EQ(completed, numThreads * tasksPerThread);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2025 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a socket trace captured with "adb shell cmd stats log-capture" back
+// into the statsd socket, so performance reports from the field can be
+// reproduced on a bench against a live statsd.
+//
+// Each trace record holds the full datagram (android_log_header_t included) plus
+// the elapsed-realtime timestamp at capture; replay preserves the recorded
+// inter-arrival gaps, optionally scaled with --speed.
+//
+// Usage: statsd_trace_replay FILE [--speed N] [--no-pacing]
+//   --speed N     replay N times faster than recorded (default 1)
+//   --no-pacing   replay as fast as the socket accepts
+
+#include <cutils/sockets.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kFileMagic = 0x31435453;  // "STC1", must match SocketPayloadCapture
+
+struct TraceRecord {
+    int64_t captureElapsedRealtimeNs;
+    std::vector<uint8_t> payload;
+};
+
+bool readExact(FILE* file, void* buf, size_t len) {
+    return fread(buf, 1, len, file) == len;
+}
+
+bool readTrace(const char* path, std::vector<TraceRecord>& records) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    uint32_t magic = 0;
+    if (!readExact(file, &magic, sizeof(magic)) || magic != kFileMagic) {
+        fprintf(stderr, "%s is not a statsd socket capture file\n", path);
+        fclose(file);
+        return false;
+    }
+    while (true) {
+        TraceRecord record;
+        if (!readExact(file, &record.captureElapsedRealtimeNs,
+                       sizeof(record.captureElapsedRealtimeNs))) {
+            break;  // clean end of file
+        }
+        uint32_t len = 0;
+        if (!readExact(file, &len, sizeof(len))) {
+            fprintf(stderr, "Truncated record header; replaying %zu records\n", records.size());
+            break;
+        }
+        record.payload.resize(len);
+        if (!readExact(file, record.payload.data(), len)) {
+            fprintf(stderr, "Truncated record payload; replaying %zu records\n", records.size());
+            break;
+        }
+        records.push_back(std::move(record));
+    }
+    fclose(file);
+    return true;
+}
+
+int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void sleepNs(int64_t ns) {
+    if (ns <= 0) {
+        return;
+    }
+    struct timespec ts = {(time_t)(ns / 1000000000LL), (long)(ns % 1000000000LL)};
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    int64_t speed = 1;
+    bool pacing = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = atoll(argv[++i]);
+            if (speed <= 0) {
+                fprintf(stderr, "--speed must be a positive integer\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--no-pacing") == 0) {
+            pacing = false;
+        } else if (path == nullptr) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s FILE [--speed N] [--no-pacing]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (path == nullptr) {
+        fprintf(stderr, "Usage: %s FILE [--speed N] [--no-pacing]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<TraceRecord> records;
+    if (!readTrace(path, records) || records.empty()) {
+        return 1;
+    }
+
+    const int sock =
+            socket_local_client("statsdw", ANDROID_SOCKET_NAMESPACE_RESERVED, SOCK_DGRAM);
+    if (sock < 0) {
+        fprintf(stderr, "Cannot connect to statsdw socket: %s\n", strerror(errno));
+        return 1;
+    }
+
+    const int64_t replayStartNs = nowNs();
+    const int64_t traceStartNs = records.front().captureElapsedRealtimeNs;
+    size_t sent = 0;
+    size_t dropped = 0;
+    for (const TraceRecord& record : records) {
+        if (pacing) {
+            const int64_t targetOffsetNs =
+                    (record.captureElapsedRealtimeNs - traceStartNs) / speed;
+            sleepNs(targetOffsetNs - (nowNs() - replayStartNs));
+        }
+        // Datagrams are recorded verbatim, so a plain write reproduces exactly
+        // what statsd's socket listener saw at capture time.
+        if (write(sock, record.payload.data(), record.payload.size()) < 0) {
+            dropped++;
+        } else {
+            sent++;
+        }
+    }
+    close(sock);
+
+    const double elapsedSec = (nowNs() - replayStartNs) / 1e9;
+    printf("Replayed %zu/%zu datagrams in %.3fs (%.0f events/sec), %zu dropped\n", sent,
+           records.size(), elapsedSec, elapsedSec > 0 ? sent / elapsedSec : 0.0, dropped);
+    return 0;
+}